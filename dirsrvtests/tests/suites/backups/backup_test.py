@@ -15,6 +15,7 @@ from lib389._constants import DEFAULT_SUFFIX, INSTALL_LATEST_CONFIG
 from lib389.properties import BACKEND_SAMPLE_ENTRIES, TASK_WAIT
 from lib389.topologies import topology_st as topo, topology_m2 as topo_m2
 from lib389.backend import Backend
+from lib389.idm.user import UserAccounts
 from lib389.tasks import BackupTask, RestoreTask
 from lib389.config import BDB_LDBMConfig
 from lib389 import DSEldif
@@ -80,6 +81,103 @@ def test_missing_backend(topo):
     assert restore_task.get_exit_code() != 0
 
 
+@pytest.mark.skipif(get_default_db_lib() != "mdb", reason="Incremental backups are only supported over mdb")
+def test_incremental_online_backup(topo):
+    """Test that an incremental backup only stores the changes done since
+    its base backup and restores the database in the latest state
+
+    :id: 6f0c2d4e-9b7a-4c1e-8e53-1d2f7a9b3c64
+    :setup: Standalone Instance
+    :steps:
+        1. Perform a full online backup
+        2. Add a user
+        3. Perform an incremental backup based on the full backup
+        4. Delete the user
+        5. Restore the incremental backup
+        6. Check the user is back
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success and the backup holds a delta instead of data.mdb
+        4. Success
+        5. Success
+        6. Success
+    """
+    inst = topo.standalone
+    full_dir = os.path.join(inst.ds_paths.backup_dir, 'incr_full')
+    incr_dir = os.path.join(inst.ds_paths.backup_dir, 'incr_delta')
+
+    task = inst.backup_online(archive=full_dir)
+    task.wait()
+    assert task.get_exit_code() == 0
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=4242)
+
+    task = inst.backup_online(archive=incr_dir, base_dir=full_dir)
+    task.wait()
+    assert task.get_exit_code() == 0
+    assert os.path.exists(os.path.join(incr_dir, 'data.mdb.delta'))
+    assert not os.path.exists(os.path.join(incr_dir, 'data.mdb'))
+
+    user.delete()
+
+    task = inst.restore_online(archive=incr_dir)
+    task.wait()
+    assert task.get_exit_code() == 0
+    assert users.get('test_user_4242')
+
+
+@pytest.mark.skipif(get_default_db_lib() != "mdb", reason="Incremental backups are only supported over mdb")
+def test_incremental_backup_other_base(topo):
+    """Test that an incremental backup is not restored when its base
+    directory holds another backup than the one it was taken on
+
+    :id: a5ac5e7f-4702-48c4-af2e-bc92d098cb29
+    :setup: Standalone Instance
+    :steps:
+        1. Perform a full online backup
+        2. Perform an incremental backup based on the full backup
+        3. Add a user and perform another full backup
+        4. Replace the base backup of the incremental backup by the new full backup
+        5. Restore the incremental backup
+        6. Check the database was left untouched
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. Success
+        5. The restore is refused
+        6. The user still exists
+    """
+    inst = topo.standalone
+    full_dir = os.path.join(inst.ds_paths.backup_dir, 'other_base_full')
+    incr_dir = os.path.join(inst.ds_paths.backup_dir, 'other_base_delta')
+    other_dir = os.path.join(inst.ds_paths.backup_dir, 'other_base_other')
+
+    task = inst.backup_online(archive=full_dir)
+    task.wait()
+    assert task.get_exit_code() == 0
+    task = inst.backup_online(archive=incr_dir, base_dir=full_dir)
+    task.wait()
+    assert task.get_exit_code() == 0
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=4343)
+    task = inst.backup_online(archive=other_dir)
+    task.wait()
+    assert task.get_exit_code() == 0
+
+    shutil.rmtree(full_dir)
+    shutil.copytree(other_dir, full_dir)
+
+    task = inst.restore_online(archive=incr_dir)
+    task.wait()
+    assert task.get_exit_code() != 0
+    assert users.get('test_user_4343')
+    user.delete()
+
+
 @pytest.mark.skipif(ds_is_older('1.4.1'), reason="Not implemented")
 @pytest.mark.skipif(get_default_db_lib() == "mdb", reason="Not supported over mdb")
 def test_db_home_dir_online_backup(topo):
@@ -10,13 +10,14 @@ import os
 import logging
 import pytest
 import time
+from ldap.controls import SimplePagedResultsControl
 from lib389.utils import *
 from lib389.dseldif import DSEldif
 from lib389.config import BDB_LDBMConfig, LDBMConfig, Config
 from lib389.backend import Backends
 from lib389.topologies import topology_st as topo
 from lib389.idm.user import UserAccounts, TEST_USER_PROPERTIES
-from lib389._constants import DEFAULT_SUFFIX, PASSWORD, DN_DM
+from lib389._constants import DEFAULT_SUFFIX, DEFAULT_BENAME, PASSWORD, DN_DM
 
 pytestmark = pytest.mark.tier0
 
@@ -26,6 +27,7 @@ log = logging.getLogger(__name__)
 DEBUGGING = os.getenv("DEBUGGING", default=False)
 CUSTOM_MEM = '9100100100'
 IDLETIMEOUT = 5
+BUFFER_MAX = 16384
 DN_TEST_USER = f'uid={TEST_USER_PROPERTIES["uid"]},ou=People,{DEFAULT_SUFFIX}'
 
 
@@ -188,3 +190,127 @@ def test_idletimeout(idletimeout_topo, dn, expected_result):
     except ldap.SERVER_DOWN:
         result = True
     assert expected_result == result
+
+
+@pytest.mark.parametrize("conn_buffer", ['1', '2'])
+def test_pipelined_requests(topo, conn_buffer):
+    """Check that pipelined requests are all processed when several PDUs
+    are read at once from the connection buffer
+
+    :id: cfc471cc-db71-4056-b027-82e62ad25a3a
+    :parametrized: yes
+    :setup: Standalone Instance
+    :steps:
+        1. Set nsslapd-connection-buffer and nsslapd-connection-buffer-max
+        2. Restart the instance
+        3. Send many modify requests without waiting for the results
+        4. Collect the results
+        5. Check the final value of the modified attribute
+        6. Send pipelined modify requests larger than the maximum buffer
+        7. Collect the results
+        8. Check the final value of the modified attribute
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. Every request succeeded
+        5. The description was replaced
+        6. Success
+        7. Every request was answered and succeeded
+        8. The description is the last large value
+    """
+
+    inst = topo.standalone
+    config = Config(inst)
+    config.replace('nsslapd-connection-buffer', conn_buffer)
+    config.replace('nsslapd-connection-buffer-max', str(BUFFER_MAX))
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.ensure_state(properties=TEST_USER_PROPERTIES)
+
+    l = ldap.initialize(f'ldap://localhost:{inst.port}')
+    l.simple_bind_s(DN_DM, PASSWORD)
+    msgids = [l.modify(user.dn, [(ldap.MOD_REPLACE, 'description', f'pipelined {i}'.encode())])
+              for i in range(200)]
+    for msgid in msgids:
+        rtype, rdata = l.result(msgid)
+        assert rtype == ldap.RES_MODIFY
+
+    assert user.get_attr_val_utf8('description').startswith('pipelined ')
+
+    # PDUs bigger than nsslapd-connection-buffer-max, interleaved with
+    # small ones, must not be lost when the buffer stops growing
+    values = [(f'{i} ' + 'x' * (BUFFER_MAX * (1 + i % 3) if i % 2 else 10)).encode()
+              for i in range(50)]
+    msgids = [l.modify(user.dn, [(ldap.MOD_REPLACE, 'description', value)])
+              for value in values]
+    for msgid in msgids:
+        rtype, rdata = l.result(msgid, timeout=30)
+        assert rtype == ldap.RES_MODIFY
+    l.unbind_s()
+
+    assert user.get_attr_val_bytes('description') == values[-1]
+
+    config.reset('nsslapd-connection-buffer-max')
+    config.replace('nsslapd-connection-buffer', '1')
+    user.delete()
+
+
+def test_search_prefetch_depth(topo, request):
+    """Check that searches return the same entries with and without
+    candidate prefetching, and that the entries are read ahead
+
+    :id: 5b0d7e42-6c3a-4b9e-9f1d-0f3f5a0c8e17
+    :setup: Standalone Instance
+    :steps:
+        1. Add some users
+        2. Search them with nsslapd-search-prefetch-depth set to 0
+        3. Set nsslapd-search-prefetch-depth to 16 and restart to empty
+           the entry cache
+        4. Search them again, with and without paged results
+        5. Check the backend monitor
+        6. Set an invalid nsslapd-search-prefetch-depth
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. The same entries are returned
+        5. Entries were read ahead and found in the entry cache
+        6. The value is rejected
+    """
+
+    inst = topo.standalone
+    ldbm_config = LDBMConfig(inst)
+    be = Backends(inst).get(DEFAULT_BENAME)
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    orig_depth = ldbm_config.get_attr_val_utf8('nsslapd-search-prefetch-depth')
+    created = [users.create_test_user(uid=5000 + i) for i in range(100)]
+
+    def fin():
+        ldbm_config.replace('nsslapd-search-prefetch-depth', orig_depth)
+        for user in created:
+            if user.exists():
+                user.delete()
+
+    request.addfinalizer(fin)
+
+    ldbm_config.replace('nsslapd-search-prefetch-depth', '0')
+    expected = sorted(u.dn for u in users.list())
+
+    ldbm_config.replace('nsslapd-search-prefetch-depth', '16')
+    inst.restart()
+    before = be.get_monitor().get_status()
+    assert int(before['searchprefetchcount'][0]) == 0
+    assert sorted(u.dn for u in users.list()) == expected
+    after = be.get_monitor().get_status()
+    assert int(after['searchprefetchcount'][0]) > 0
+    assert int(after['entrycachehits'][0]) > int(before['entrycachehits'][0])
+
+    req_ctrl = SimplePagedResultsControl(True, size=7, cookie='')
+    found = inst.search_ext_s(users._basedn, ldap.SCOPE_SUBTREE, '(uid=test_user_5*)',
+                              ['uid'], serverctrls=[req_ctrl])
+    assert len(found) == 7
+
+    with pytest.raises(ldap.UNWILLING_TO_PERFORM):
+        ldbm_config.replace('nsslapd-search-prefetch-depth', '100000')
@@ -144,6 +144,86 @@ def test_vattr_on_cos_definition(topo, reset_ignore_vattr):
     topo.standalone.restart()
     assert topo.standalone.config.get_attr_val_utf8('nsslapd-ignore-virtual-attrs') == "on"
 
+def test_cos_template_updates(topo):
+    """Check that template and definition changes are applied to the CoS cache
+
+    :id: 4c1f2e8a-93b6-4f0d-a7c5-1e6d2b9f8a37
+    :setup: Standalone instance
+    :steps:
+         1. Add two cos templates and a classic cos definition using them
+         2. Add users with the specifier of each template
+         3. Modify a template
+         4. Add a template for a new specifier value
+         5. Delete a template
+         6. Delete the definition
+    :expectedresults:
+         1. Success
+         2. Both users get the value of their template
+         3. The user gets the new value, the other one is unchanged
+         4. The user with the new specifier value gets the new template value
+         5. The user of the deleted template gets no value, the other one is unchanged
+         6. No user gets a value
+    """
+
+    inst = topo.standalone
+    tmpl_parent = 'cn=cosUpdateTemplates,{}'.format(DEFAULT_SUFFIX)
+    nsContainer(inst, tmpl_parent).create(properties={'cn': 'cosUpdateTemplates'})
+
+    templates = {}
+    for grade, value in (('eng', 'EngType'), ('sales', 'SalesType')):
+        templates[grade] = CosTemplate(inst, 'cn={},{}'.format(grade, tmpl_parent))
+        templates[grade].create(properties={'cn': grade, 'employeeType': value})
+
+    cosdef = CosClassicDefinition(inst, 'cn=cosUpdateDefinition,{}'.format(DEFAULT_SUFFIX))
+    cosdef.create(properties={'cn': 'cosUpdateDefinition',
+                              'cosTemplateDn': tmpl_parent,
+                              'cosAttribute': 'employeeType',
+                              'cosSpecifier': 'departmentNumber'})
+
+    users = {}
+    for grade in ('eng', 'sales', 'support'):
+        users[grade] = UserAccount(inst, 'uid=cos_{},{}'.format(grade, DEFAULT_SUFFIX))
+        users[grade].create(properties={'uid': 'cos_' + grade,
+                                        'cn': 'cos_' + grade,
+                                        'sn': grade,
+                                        'uidNumber': '1000',
+                                        'gidNumber': '2000',
+                                        'homeDirectory': '/home/cos_' + grade,
+                                        'departmentNumber': grade})
+
+    def wait_for(grade, value):
+        for _ in range(20):
+            if users[grade].get_attr_val_utf8('employeeType') == value:
+                return True
+            time.sleep(0.5)
+        return False
+
+    assert wait_for('eng', 'EngType')
+    assert wait_for('sales', 'SalesType')
+    assert wait_for('support', None)
+
+    templates['eng'].replace('employeeType', 'EngType2')
+    assert wait_for('eng', 'EngType2')
+    assert wait_for('sales', 'SalesType')
+
+    templates['support'] = CosTemplate(inst, 'cn=support,{}'.format(tmpl_parent))
+    templates['support'].create(properties={'cn': 'support', 'employeeType': 'SupportType'})
+    assert wait_for('support', 'SupportType')
+
+    templates['sales'].delete()
+    assert wait_for('sales', None)
+    assert wait_for('eng', 'EngType2')
+
+    cosdef.delete()
+    assert wait_for('eng', None)
+    assert wait_for('support', None)
+
+    for user in users.values():
+        user.delete()
+    for grade in ('eng', 'support'):
+        templates[grade].delete()
+
+
 if __name__ == "__main__":
     CURRENT_FILE = os.path.realpath(__file__)
     pytest.main("-s -v %s" % CURRENT_FILE)
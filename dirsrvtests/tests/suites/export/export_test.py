@@ -7,6 +7,7 @@
 # --- END COPYRIGHT BLOCK ---
 
 import os
+import gzip
 import pytest
 import subprocess
 from lib389.topologies import topology_st as topo
@@ -15,6 +16,8 @@ from lib389.utils import *
 from lib389.paths import Paths
 from lib389.cli_base import FakeArgs
 from lib389.cli_ctl.dbtasks import dbtasks_db2ldif
+from lib389.backend import DatabaseConfig
+from lib389.idm.user import UserAccounts
 
 pytestmark = pytest.mark.tier1
 
@@ -133,3 +136,47 @@ def test_dbtasks_db2ldif_with_non_accessible_ldif_file_path_output(topo):
 
     log.info("Restarting the instance...")
     topo.standalone.start()
+
+
+def test_db2ldif_parallel_and_gzip(topo):
+    """Check that a parallel export, and a compressed one, produce the same
+    LDIF as a sequential export
+
+    :id: 3f0c2a6e-5b1d-4c8e-9a47-d2b6e81f4c05
+    :setup: Standalone Instance
+    :steps:
+        1. Add 2500 users
+        2. Export the suffix with nsslapd-export-threads set to 1
+        3. Export the suffix with nsslapd-export-threads set to 4
+        4. Export the suffix to a .gz file with nsslapd-export-threads set to 4
+        5. Compare the exports
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. Success
+        5. The three exports have the same content
+    """
+    inst = topo.standalone
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    for i in range(2500):
+        users.create_test_user(uid=10000 + i)
+
+    db_cfg = DatabaseConfig(inst)
+    ldif_dir = inst.get_ldif_dir()
+    exports = {}
+    for name, threads in (('seq.ldif', '1'), ('par.ldif', '4'), ('par.ldif.gz', '4')):
+        db_cfg.set([('nsslapd-export-threads', threads)])
+        inst.stop()
+        path = os.path.join(ldif_dir, name)
+        assert inst.db2ldif(bename=DEFAULT_BENAME, suffixes=[DEFAULT_SUFFIX], excludeSuffixes=None,
+                            encrypt=False, repl_data=False, outputfile=path)
+        inst.start()
+        opener = gzip.open if name.endswith('.gz') else open
+        with opener(path, 'rb') as f:
+            exports[name] = f.read()
+
+    assert exports['seq.ldif'].count(b'\ndn: ') >= 2500
+    assert exports['par.ldif'] == exports['seq.ldif']
+    assert exports['par.ldif.gz'] == exports['seq.ldif']
+    db_cfg.set([('nsslapd-export-threads', '0')])
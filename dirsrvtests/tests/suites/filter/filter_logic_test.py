@@ -14,6 +14,7 @@ from lib389.topologies import topology_st
 from lib389._constants import DEFAULT_SUFFIX
 
 from lib389.idm.user import UserAccount, UserAccounts
+from lib389.backend import DatabaseConfig
 
 pytestmark = pytest.mark.tier1
 
@@ -449,3 +450,44 @@ def test_or_and_eq(topology_st_f):
     _check_filter(topology_st_f, '(|(&(uid=user1)(sn=1))(uid=user0))', 2, [USER0_DN, USER1_DN])
 
 
+
+
+def test_filter_cost_optimizer(topology_st_f):
+    """Test that ordering the filter components by estimated cost
+    does not change the result of the search
+
+    :id: 4e0c2b7a-8d51-4f6e-9a3c-1b5d7e9f2c84
+    :setup: Standalone instance with 20 test users added
+            from uid=user0 to uid=user20
+    :steps:
+         1. Enable nsslapd-filter-cost-optimizer
+         2. Search with AND and OR filters mixing selective, unselective
+            and unindexed components
+         3. Disable nsslapd-filter-cost-optimizer
+    :expectedresults:
+         1. Success
+         2. The same entries are returned as without the optimizer
+         3. Success
+    """
+    dbconfig = DatabaseConfig(topology_st_f)
+    dbconfig.set([('nsslapd-filter-cost-optimizer', 'on')])
+    try:
+        _check_filter(topology_st_f, '(&(objectClass=*)(uid=user0))', 1, [USER0_DN])
+        _check_filter(topology_st_f, '(&(cn=user*)(sn=1)(uid=user1))', 1, [USER1_DN])
+        _check_filter(topology_st_f, '(&(uidNumber=2)(objectClass=posixAccount)(uid=user2))', 1, [USER2_DN])
+        _check_filter(topology_st_f, '(&(gidNumber=3)(sn=3))', 1, [USER3_DN])
+        _check_filter(topology_st_f, '(&(objectClass=posixAccount)(!(sn=0))(uid=user1))', 1, [USER1_DN])
+        _check_filter(topology_st_f, '(&(objectClass=*)(cn=*)(sn=*))', 20, [
+            USER0_DN, USER1_DN, USER2_DN, USER3_DN, USER4_DN, USER5_DN,
+            USER6_DN, USER7_DN, USER8_DN, USER9_DN, USER10_DN, USER11_DN,
+            USER12_DN, USER13_DN, USER14_DN, USER15_DN, USER16_DN, USER17_DN,
+            USER18_DN, USER19_DN])
+        _check_filter(topology_st_f, '(|(uid=user0)(objectClass=*)(sn=1))', 20, [
+            USER0_DN, USER1_DN, USER2_DN, USER3_DN, USER4_DN, USER5_DN,
+            USER6_DN, USER7_DN, USER8_DN, USER9_DN, USER10_DN, USER11_DN,
+            USER12_DN, USER13_DN, USER14_DN, USER15_DN, USER16_DN, USER17_DN,
+            USER18_DN, USER19_DN])
+        _check_filter(topology_st_f, '(|(&(uid=user0)(sn=0))(&(cn=user1)(uidNumber=1)))', 2, [USER0_DN, USER1_DN])
+        _check_filter(topology_st_f, '(&(|(uid=user0)(sn=1))(cn=user*))', 2, [USER0_DN, USER1_DN])
+    finally:
+        dbconfig.set([('nsslapd-filter-cost-optimizer', 'off')])
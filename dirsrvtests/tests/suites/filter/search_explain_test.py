@@ -0,0 +1,130 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+
+import os
+import json
+import logging
+import ldap
+import pytest
+from ldap.controls import LDAPControl
+from lib389._constants import DEFAULT_SUFFIX
+from lib389.rootdse import RootDSE
+from lib389.topologies import topology_st as topo
+from lib389.idm.user import UserAccounts
+
+log = logging.getLogger(__name__)
+
+pytestmark = pytest.mark.tier1
+
+EXPLAIN_OID = '2.16.840.1.113730.3.4.21'
+# ExplainRequestValue ::= SEQUENCE { dryRun BOOLEAN DEFAULT FALSE }
+DRY_RUN_VALUE = b'\x30\x03\x01\x01\xff'
+USER_PW = 'password'
+NB_USERS = 10
+
+
+@pytest.fixture(scope="module")
+def users(topo):
+    accounts = UserAccounts(topo.standalone, DEFAULT_SUFFIX)
+    users = [accounts.create_test_user(uid=i) for i in range(NB_USERS)]
+    users[0].replace('userPassword', USER_PW)
+    return users
+
+
+def _explain_search(conn, filterstr, value=None, criticality=False):
+    ctrl = LDAPControl(EXPLAIN_OID, criticality, value)
+    msgid = conn.search_ext(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, filterstr, ['uid'], serverctrls=[ctrl])
+    rtype, rdata, rmsgid, resp_ctrls = conn.result3(msgid)
+    plans = [json.loads(c.encodedControlValue) for c in resp_ctrls if c.controlType == EXPLAIN_OID]
+    return rdata, plans
+
+
+def test_search_explain(topo, users):
+    """Check the search plan returned by the search explain control
+
+    :id: 6b4c8f1e-2d0a-4e57-9c3b-7a1f0e5d2c84
+    :setup: Standalone instance with a few users
+    :steps:
+        1. Check the control is advertised in the root DSE
+        2. Search an indexed equality filter with the control
+        3. Check the plan: index lookup, candidates and entries
+        4. Search an unindexed filter with the control
+    :expectedresults:
+        1. Success
+        2. The entry and one plan are returned
+        3. The uid index gave one candidate, tested and returned
+        4. The plan tells the search is unindexed and the presence lookup returned ALLIDS
+    """
+    assert EXPLAIN_OID in RootDSE(topo.standalone).get_supported_ctrls()
+
+    rdata, plans = _explain_search(topo.standalone, '(uid=test_user_5)')
+    assert len(rdata) == 1
+    assert len(plans) == 1
+    plan = plans[0]
+    log.info('plan: %s', plan)
+    assert plan['dry_run'] is False
+    assert plan['allids'] is False
+    assert plan['candidates'] == 1
+    assert {'attribute': 'uid', 'index': 'eq', 'key': 'test_user_5', 'ids': 1, 'allids': False} in plan['index_lookups']
+    assert plan['entries'] == {'tested': 1, 'matched': 1, 'returned': 1}
+    assert plan['entry_cache']['hits'] + plan['entry_cache']['misses'] == 1
+    assert plan['time_usec']['total'] >= plan['time_usec']['candidates'] >= plan['time_usec']['index']
+
+    rdata, plans = _explain_search(topo.standalone, '(description=*)')
+    plan = plans[0]
+    log.info('plan: %s', plan)
+    assert plan['allids'] is True
+    assert plan['unindexed'] is True
+    assert {'attribute': 'description', 'index': 'pres', 'key': '', 'ids': 0, 'allids': True} in plan['index_lookups']
+
+
+def test_search_explain_dry_run(topo, users):
+    """Check a dry run returns the plan without the entries
+
+    :id: 1f8e3a52-9b6d-4c07-a2e4-5d9c0b7f3e61
+    :setup: Standalone instance with a few users
+    :steps:
+        1. Search with the control and dryRun set
+    :expectedresults:
+        1. No entry is returned, the plan counts the matching entries
+    """
+    rdata, plans = _explain_search(topo.standalone, '(uid=test_user_*)', DRY_RUN_VALUE)
+    assert len(rdata) == 0
+    plan = plans[0]
+    assert plan['dry_run'] is True
+    assert plan['entries']['matched'] == NB_USERS
+    assert plan['entries']['returned'] == 0
+
+
+def test_search_explain_not_root(topo, users):
+    """Check the search explain control is for the directory manager only
+
+    :id: c2d7a9e4-5f31-4b8c-8e06-3a4b1d9f7c25
+    :setup: Standalone instance with a few users
+    :steps:
+        1. Bind as a regular user and search with the control, not critical
+        2. Search with the control, critical
+    :expectedresults:
+        1. The entries are returned without a plan
+        2. The search fails with unavailableCriticalExtension
+    """
+    conn = users[0].bind(USER_PW)
+
+    rdata, plans = _explain_search(conn, '(uid=test_user_5)')
+    assert len(rdata) == 1
+    assert plans == []
+
+    with pytest.raises(ldap.UNAVAILABLE_CRITICAL_EXTENSION):
+        _explain_search(conn, '(uid=test_user_5)', criticality=True)
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main("-s %s" % CURRENT_FILE)
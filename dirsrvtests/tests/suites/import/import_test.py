@@ -625,6 +625,27 @@ def test_crash_on_ldif2db_with_lmdb(topo, _import_clean):
     __check_for_core(now)
 
 
+@pytest.mark.skipif(os.cpu_count() < 8, reason="LDIF is scanned by a single thread on small hosts")
+def test_import_big_ldif_with_parallel_scan(topo, _import_clean):
+    """Check that a big LDIF file is parsed by several threads and that
+    all its entries are imported
+
+    :id: 2b7e0c84-9a5d-4f31-b6c2-8e1d3f4a7c59
+    :setup: Standalone Instance
+    :steps:
+        1. Generate an LDIF file with 20K users (bigger than two scan segments)
+        2. Import it offline
+        3. Check the error log
+    :expectedresults:
+        1. Success
+        2. All the users are imported
+        3. The LDIF file was scanned by several threads
+    """
+    inst = topo.standalone
+    _import_offline(topo, 20000)
+    assert inst.ds_error_log.match('.*Scanning the LDIF file with [0-9]+ threads.*')
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
@@ -23,7 +23,7 @@ from lib389.plugins import MemberOfPlugin
 from lib389.properties import TASK_WAIT
 from lib389.tasks import Tasks, Task
 from lib389.topologies import topology_st as topo
-from lib389.utils import ds_is_older
+from lib389.utils import ds_is_older, get_default_db_lib
 
 pytestmark = pytest.mark.tier1
 
@@ -411,6 +411,200 @@ def test_task_and_be(topo, add_backend_and_ldif_50K_users):
     assert user.get_attr_val_utf8_l('description') == descval
 
 
+def test_migrate_substr_index(topo):
+    """Check that the positional substring index returns the same entries
+    as the substring index, and is maintained by updates
+
+    :id: 6a1e3f52-0c8d-4b7e-9e21-d4f7a3b8c915
+    :setup: Standalone instance
+    :steps:
+        1. Add users with various description values
+        2. Add a substring index on description and reindex it
+        3. Search with substring filters on description
+        4. Migrate the description index to subpos
+        5. Search with the same filters
+        6. Migrate the description index again, dropping sub
+        7. Search with the same filters
+        8. Add, modify and delete description values
+        9. Search with the same filters
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. The index has the subpos type and still the sub type
+        5. The same entries are returned
+        6. The index has the subpos type and no longer the sub type
+        7. The same entries are returned
+        8. Success
+        9. The index follows the updates
+    """
+    inst = topo.standalone
+    be = Backends(inst).get(DEFAULT_BENAME)
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    descriptions = ['helpdesk smith', 'John Smithson', 'blacksmith',
+                    'ith smi', 'smi', 'Smith', 'mist home', 'the  smith  family']
+    created = []
+    for i, desc in enumerate(descriptions):
+        created.append(users.create_test_user(uid=5000 + i))
+        created[-1].replace('description', desc)
+
+    filters = ['(description=*smith*)', '(description=smith*)', '(description=*smith)',
+               '(description=*ith*smi*)', '(description=bla*mith)', '(description=*SMI*)',
+               '(description=*th sm*)', '(description=*m*)', '(description=*o*e*)']
+
+    def _search():
+        results = {}
+        for filt in filters:
+            ents = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, filt, ['dn'])
+            results[filt] = sorted([ent.dn.lower() for ent in ents])
+        return results
+
+    try:
+        be.add_index('description', ['eq', 'sub'])
+        assert be.reindex(attrs=['description'], wait=True) == 0
+        expected = _search()
+        assert len(expected['(description=*smith*)']) == 5
+        assert len(expected['(description=*ith*smi*)']) == 1
+
+        assert be.migrate_substr_index(attrs=['description']) == ['description']
+        types = [t.lower() for t in be.get_index('description').get_attr_vals_utf8('nsIndexType')]
+        assert 'subpos' in types
+        assert 'sub' in types
+        assert _search() == expected
+
+        assert be.migrate_substr_index(attrs=['description'], drop_sub=True) == ['description']
+        types = [t.lower() for t in be.get_index('description').get_attr_vals_utf8('nsIndexType')]
+        assert 'subpos' in types
+        assert 'sub' not in types
+        assert _search() == expected
+
+        created[0].replace('description', 'blacksmith shop')
+        created[1].add('description', 'Jo Smith')
+        created[1].remove('description', 'John Smithson')
+        created[2].remove('description', 'blacksmith')
+        created.append(users.create_test_user(uid=5000 + len(descriptions)))
+        created[-1].replace('description', 'goldsmith')
+        results = _search()
+        assert results['(description=*smith*)'] == sorted([created[i].dn.lower() for i in (0, 1, 5, 7, 8)])
+        assert results['(description=bla*mith)'] == []
+        assert results['(description=*ith*smi*)'] == [created[3].dn.lower()]
+    finally:
+        for user in created:
+            user.delete()
+        be.del_index('description')
+
+
+def test_substr_search_during_subpos_migration(topo):
+    """Check that substring searches keep returning entries while the
+    positional substring index is being built
+
+    :id: 9f3c2d71-5b4e-4a6f-8c1d-2e7b0a9f4c58
+    :setup: Standalone instance
+    :steps:
+        1. Add users with a description, add a substring index on description and reindex it
+        2. Add the subpos type to the index, without reindexing
+        3. Search with substring filters on description
+        4. Start the reindex task and search while it runs
+        5. Wait for the task and search again
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The entries are still found with the sub keys
+        4. The entries are found while the subpos keys are built
+        5. The entries are found with the subpos keys
+    """
+    inst = topo.standalone
+    be = Backends(inst).get(DEFAULT_BENAME)
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    created = []
+    for i in range(200):
+        created.append(users.create_test_user(uid=7000 + i))
+        created[-1].replace('description', 'migrating smith %d' % i)
+    filters = ['(description=*smith*)', '(description=migr*)', '(description=*ing*ith*)']
+
+    def _check():
+        for filt in filters:
+            ents = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, filt, ['dn'])
+            assert len(ents) == len(created), filt
+
+    try:
+        be.add_index('description', ['eq', 'sub'])
+        assert be.reindex(attrs=['description'], wait=True) == 0
+        _check()
+
+        be.get_index('description').add('nsIndexType', 'subpos')
+        _check()
+
+        tasks = Tasks(inst)
+        assert tasks.reindex(benamebase=DEFAULT_BENAME, attrname=['description']) == 0
+        _check()
+        (done, exitcode, warningcode) = inst.tasks.checkTask(tasks.entry, True)
+        assert exitcode == 0
+        _check()
+    finally:
+        for user in created:
+            user.delete()
+        be.del_index('description')
+
+
+@pytest.mark.skipif(get_default_db_lib() != "mdb", reason="Online reindex is only supported over mdb")
+def test_online_reindex(topo):
+    """Check that an online reindex keeps the backend writable and that
+    the rebuilt index includes the updates done while it runs
+
+    :id: 0d6b7a4e-3f1c-4a85-b2d9-5c8e1f7a9b36
+    :setup: Standalone instance
+    :steps:
+        1. Add users with a description
+        2. Enable the online reindex with a low rate, add an equality index on description
+        3. Start the reindex task and update some users while it runs
+        4. Wait for the reindex to complete
+        5. Search on description
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The updates succeed while the task runs
+        4. The task reports an online reindex
+        5. The results include the updates
+    """
+    inst = topo.standalone
+    be = Backends(inst).get(DEFAULT_BENAME)
+    dbconfig = DatabaseConfig(inst)
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    created = []
+    for i in range(300):
+        created.append(users.create_test_user(uid=6000 + i))
+        created[-1].replace('description', 'online %d' % (i % 3))
+
+    try:
+        dbconfig.set([('nsslapd-mdb-online-reindex', 'on'),
+                      ('nsslapd-mdb-online-reindex-rate', '100')])
+        be.add_index('description', ['eq'])
+        assert be.reindex(attrs=['description']) == 0
+
+        for user in created[:10]:
+            user.replace('description', 'online updated')
+        created[10].delete()
+        created.append(users.create_test_user(uid=6300))
+        created[-1].replace('description', 'online updated')
+
+        for _ in range(60):
+            if inst.ds_error_log.match('.*Finished online reindexing.*'):
+                break
+            time.sleep(1)
+        assert inst.ds_error_log.match('.*Finished online reindexing.*')
+
+        ents = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, '(description=online updated)', ['dn'])
+        assert len(ents) == 11
+        ents = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, '(description=online 0)', ['dn'])
+        assert len(ents) == len([i for i in range(11, 300) if i % 3 == 0])
+    finally:
+        for user in created[:10] + created[11:]:
+            user.delete()
+        be.del_index('description')
+        dbconfig.set([('nsslapd-mdb-online-reindex', 'off'),
+                      ('nsslapd-mdb-online-reindex-rate', '0')])
+
 if __name__ == "__main__":
     # Run isolated
     # -s for DEBUG mode
@@ -8,12 +8,16 @@
 #
 import logging
 import pytest
+import ldap
 import os
+import time
 from lib389.monitor import *
 from lib389.backend import Backends, DatabaseConfig
 from lib389._constants import *
 from lib389.topologies import topology_st as topo
 from lib389._mapped_object import DSLdapObjects
+from lib389.idm.user import UserAccounts
+from lib389.idm.organizationalunit import OrganizationalUnits
 
 pytestmark = pytest.mark.tier1
 
@@ -178,6 +182,180 @@ def test_num_subordinates_with_monitor_suffix(topo):
     assert len(filter2) == num_subordinates_val
 
 
+def test_entry_cache_scan_resistance(topo):
+    """Check that an unindexed search does not evict the frequently used
+    entries from the entry cache
+
+    :id: 8e1c2a6d-4f0b-4f55-a3f4-7d9b1f6e2c30
+    :setup: Single instance
+    :steps:
+        1. Limit the entry cache to 100 entries and add 400 users
+        2. Read 20 users several times
+        3. Run an unindexed search over all the users
+        4. Read the 20 users again
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. The 20 users are found in the entry cache
+    """
+
+    inst = topo.standalone
+    be = Backends(inst).get(DEFAULT_BENAME)
+    be.replace('nsslapd-cachesize', '100')
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    created = [users.create_test_user(uid=7000 + i) for i in range(400)]
+    hot = created[:20]
+    for _ in range(3):
+        for user in hot:
+            user.get_attr_val_utf8('uid')
+
+    inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, '(description=scan*)')
+
+    before = be.get_monitor().get_status()
+    for user in hot:
+        user.get_attr_val_utf8('uid')
+    after = be.get_monitor().get_status()
+    hits = int(after['entrycachehits'][0]) - int(before['entrycachehits'][0])
+    tries = int(after['entrycachetries'][0]) - int(before['entrycachetries'][0])
+    assert tries - hits < len(hot)
+
+    for user in created:
+        user.delete()
+    be.replace('nsslapd-cachesize', '-1')
+
+
+def test_entry_cache_preload(topo):
+    """Check that the entry cache content is reloaded after a restart
+    when nsslapd-cache-preload is on
+
+    :id: 2b7f4d1e-93a6-4c1e-b0d4-5e8a6c3f9a17
+    :setup: Single instance
+    :steps:
+        1. Enable nsslapd-cache-preload and add 50 users
+        2. Read the users and restart the instance
+        3. Wait for the preload to complete
+        4. Read the users again
+    :expectedresults:
+        1. Success
+        2. Success
+        3. cachePreloadStatus is done and cachePreloadCount is not 0
+        4. The users are found in the entry cache
+    """
+
+    inst = topo.standalone
+    db_config = DatabaseConfig(inst)
+    db_config.set([('nsslapd-cache-preload', 'on')])
+    be = Backends(inst).get(DEFAULT_BENAME)
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    created = [users.create_test_user(uid=8000 + i) for i in range(50)]
+    for user in created:
+        user.get_attr_val_utf8('uid')
+    inst.restart()
+
+    for _ in range(30):
+        status = be.get_monitor().get_status()
+        if status['cachepreloadstatus'][0] != 'running':
+            break
+        time.sleep(1)
+    assert status['cachepreloadstatus'][0] == 'done'
+    assert int(status['cachepreloadcount'][0]) > 0
+
+    before = be.get_monitor().get_status()
+    for user in created:
+        user.get_attr_val_utf8('uid')
+    after = be.get_monitor().get_status()
+    hits = int(after['entrycachehits'][0]) - int(before['entrycachehits'][0])
+    tries = int(after['entrycachetries'][0]) - int(before['entrycachetries'][0])
+    assert tries - hits < len(created) // 2
+
+    for user in created:
+        user.delete()
+    db_config.set([('nsslapd-cache-preload', 'off')])
+
+
+def test_dn_tree_cache(topo):
+    """Check that the DN tree cache serves the DN resolutions and follows
+    the renames
+
+    :id: 6c1d0e3a-5f2b-4d8e-9a7c-3b4e1f0d2a96
+    :setup: Single instance
+    :steps:
+        1. Create a branch of nested organizational units with users below it
+        2. Restart, read a user, then the organizational unit above it
+        3. Rename an organizational unit of the branch
+        4. Search the branch under its new DN, and under the old one
+    :expectedresults:
+        1. Success
+        2. Resolving the DN of the user cached its ancestors: the second
+           read gets dnTreeCacheHits
+        3. Success
+        4. The users are found under the new DN only
+    """
+
+    inst = topo.standalone
+    be = Backends(inst).get(DEFAULT_BENAME)
+    parent = DEFAULT_SUFFIX
+    created = []
+    for level in range(5):
+        ou = OrganizationalUnits(inst, parent).create(properties={'ou': 'dntree%d' % level})
+        created.append(ou)
+        parent = ou.dn
+    users = UserAccounts(inst, parent, rdn=None)
+    for i in range(10):
+        created.append(users.create_test_user(uid=9000 + i))
+
+    top = created[0].dn
+    # Empty the entry and DN caches, so that the DNs come from entryrdn
+    inst.restart()
+    assert len(inst.search_s(created[5].dn, ldap.SCOPE_BASE, '(objectclass=*)', ['uid'])) == 1
+    before = be.get_monitor().get_status()
+    assert len(inst.search_s(created[3].dn, ldap.SCOPE_BASE, '(objectclass=*)', ['ou'])) == 1
+    after = be.get_monitor().get_status()
+    assert int(after['dntreecachehits'][0]) > int(before['dntreecachehits'][0])
+
+    created[2].rename('ou=dntree2-renamed')
+    renamed = 'ou=dntree2-renamed,%s' % created[1].dn
+    assert len(inst.search_s(renamed, ldap.SCOPE_SUBTREE, '(uid=*)', ['uid'])) == 10
+    with pytest.raises(ldap.NO_SUCH_OBJECT):
+        inst.search_s('ou=dntree2,%s' % created[1].dn, ldap.SCOPE_SUBTREE, '(uid=*)')
+
+    inst.delete_branch_s(top, ldap.SCOPE_SUBTREE)
+
+
+def test_latency_histograms(topo):
+    """Check that the operations latency is published in cn=latency,cn=monitor
+
+    :id: 0b6b6f4e-3c2a-4d8e-9d0b-7e5f1c2a9b34
+    :setup: Single instance
+    :steps:
+        1. Read the subtree search statistics
+        2. Run subtree searches on the suffix
+        3. Read the statistics again, globally and for userRoot
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The counts increased and the percentiles are ordered
+    """
+    inst = topo.standalone
+    latency = MonitorLatency(inst)
+    before = latency.get_latency().get('search-subtree-optime', {}).get('count', 0)
+
+    for _ in range(20):
+        inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, '(uid=*)', ['uid'])
+
+    stats = latency.get_latency()['search-subtree-optime']
+    log.info(f'search-subtree-optime: {stats}')
+    assert stats['count'] >= before + 20
+    assert stats['p50'] <= stats['p90'] <= stats['p99'] <= stats['p999'] <= stats['max']
+    assert 'search-subtree-wtime' in latency.get_latency()
+
+    be_stats = latency.get_latency(backend='userRoot')['search-subtree-optime']
+    assert be_stats['count'] >= 20
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
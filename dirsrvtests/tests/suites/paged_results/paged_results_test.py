@@ -25,6 +25,7 @@ from lib389.idm.organization import Organization
 from lib389.idm.organizationalunit import OrganizationalUnit
 from lib389.backend import Backends
 from lib389._mapped_object import DSLdapObject
+from lib389.monitor import Monitor
 
 pytestmark = pytest.mark.tier1
 
@@ -442,6 +443,133 @@ def test_search_sort_success(topology_st, create_user):
         del_users(users_list)
 
 
+def sorted_search(conn, sort_keys, sizelimit=0):
+    """Search the test users with a server side sort control, return the
+    numbers of the user DNs in the order they were returned"""
+
+    sort_ctrl = SSSRequestControl(True, sort_keys)
+    msgid = conn.search_ext(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, r'(uid=test*)', ['sn'],
+                            serverctrls=[sort_ctrl], sizelimit=sizelimit)
+    results = []
+    try:
+        while True:
+            rtype, rdata, rmsgid, rctrls = conn.result3(msgid, all=0)
+            if rtype == ldap.RES_SEARCH_RESULT:
+                break
+            results.extend(rdata)
+    except ldap.SIZELIMIT_EXCEEDED:
+        pass
+    return [int(dn[8:13]) for dn, attrs in results]
+
+
+def test_search_sort_sizelimit(topology_st, create_user):
+    """Verify that a server side sorted search with a size limit
+    returns the first entries of the fully sorted result
+
+    :id: 3b8e6f0d-5c2a-4e71-9a4f-1d7c8b2e9f60
+    :setup: Standalone instance, test user for binding,
+            varying number of users for the search base
+    :steps:
+        1. Bind as test user
+        2. Search the users with a sort control, without size limit
+        3. Search the users with a sort control and a size limit
+        4. Do the same in reverse order
+    :expectedresults:
+        1. Bind should be successful
+        2. All users should be found and sorted
+        3. The first users of the full sort should be returned, in order
+        4. The first users of the full reverse sort should be returned, in order
+    """
+
+    users_num = 50
+    sizelimit = 7
+    users_list = add_users(topology_st, users_num, DEFAULT_SUFFIX)
+
+    try:
+        conn = create_user.bind(TEST_USER_PWD)
+
+        for sort_key in ['sn', '-sn']:
+            log.info('Sort on %s without size limit' % sort_key)
+            r_all = sorted_search(conn, [sort_key])
+            assert len(r_all) == users_num
+            assert r_all == sorted(r_all, reverse=sort_key.startswith('-'))
+
+            log.info('Sort on %s with size limit %d' % (sort_key, sizelimit))
+            r_top = sorted_search(conn, [sort_key], sizelimit)
+            assert r_top == r_all[:sizelimit]
+    finally:
+        del_users(users_list)
+
+
+@pytest.mark.parametrize('cache_size', ['10000000', '1'])
+def test_search_cursor_cache_cross_connection(topology_st, create_user, cache_size):
+    """Verify that with the paged results cursor cache, the next page
+    can be requested on another connection of the same identity
+
+    :id: 6f0b2c1e-8d4a-4b7e-9c35-2e1f7a9d0c48
+    :setup: Standalone instance, test user for binding,
+            varying number of users for the search base
+    :parametrized: yes
+    :steps:
+        1. Set nsslapd-pagedresults-cursor-cache-size
+        2. Bind as test user on two connections
+        3. Search with a simple paged control, requesting each
+           page on the other connection
+        4. Check the cursor counters of cn=monitor
+        5. Use a cookie of the test user as Directory Manager
+    :expectedresults:
+        1. Operation should be successful
+        2. Bind should be successful
+        3. All users should be found, once
+        4. The cursors should be resumed on another connection,
+           and packed with the smallest cache
+        5. The critical paged control should be rejected
+    """
+
+    users_num = 30
+    page_size = 4
+    users_list = add_users(topology_st, users_num, DEFAULT_SUFFIX)
+    search_flt = r'(uid=test*)'
+    searchreq_attrlist = ['dn', 'sn']
+    inst = topology_st.standalone
+
+    try:
+        inst.config.set('nsslapd-pagedresults-cursor-cache-size', cache_size)
+        conns = [create_user.bind(TEST_USER_PWD), create_user.bind(TEST_USER_PWD)]
+
+        req_ctrl = SimplePagedResultsControl(True, size=page_size, cookie='')
+        all_results = []
+        pages = 0
+        while True:
+            conn = conns[pages % 2]
+            msgid = conn.search_ext(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, search_flt,
+                                    searchreq_attrlist, serverctrls=[req_ctrl])
+            rtype, rdata, rmsgid, rctrls = conn.result3(msgid)
+            all_results.extend(rdata)
+            pages += 1
+            pctrls = [c for c in rctrls
+                      if c.controlType == SimplePagedResultsControl.controlType]
+            if not pctrls[0].cookie:
+                break
+            req_ctrl.cookie = pctrls[0].cookie
+            if pages == 2:
+                log.info('A cookie can not be used by another identity')
+                with pytest.raises(ldap.UNAVAILABLE_CRITICAL_EXTENSION):
+                    inst.search_ext_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, search_flt,
+                                      searchreq_attrlist, serverctrls=[req_ctrl])
+
+        assert len(all_results) == users_num
+        assert len(set(dn for dn, _ in all_results)) == users_num
+
+        monitor = Monitor(inst)
+        assert monitor.get_attr_val_int('pagedresultscursorsmoved') > 0
+        if cache_size == '1':
+            assert monitor.get_attr_val_int('pagedresultscursorspacked') > 0
+    finally:
+        inst.config.set('nsslapd-pagedresults-cursor-cache-size', '0')
+        del_users(users_list)
+
+
 def test_search_abandon(topology_st, create_user):
     """Verify that search with simple paged results control
     can be abandon
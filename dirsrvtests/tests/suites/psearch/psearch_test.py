@@ -8,10 +8,12 @@
 #
 import ldap
 import os
+import time
 import pytest
-from lib389._constants import DEFAULT_SUFFIX
+from lib389._constants import DEFAULT_SUFFIX, DN_DM, PASSWORD
 from lib389.topologies import topology_st
 from lib389.idm.group import Groups
+from lib389.idm.user import UserAccounts
 from ldap.controls.psearch import PersistentSearchControl,EntryChangeNotificationControl
 
 pytestmark = pytest.mark.tier1
@@ -68,6 +70,107 @@ def test_psearch(topology_st):
     assert(group.dn == results[0])
 
 
+def test_psearch_base_and_filter(topology_st):
+    """Check that changes are only sent to the persistent searches they match
+
+    :id: 0c7d5b8e-2f41-4a36-9d1e-6b3f8c2a9e57
+    :setup: Standalone instance
+    :steps:
+        1. Run more persistent searches than dispatcher threads, on the
+           people and groups subtrees, with and without an attribute in
+           their filter
+        2. Add a user with a description, a user without, and a group
+        3. Check the changes each persistent search received
+    :expectedresults:
+        1. Operations should be successful
+        2. Entries should be successfully created
+        3. Each persistent search receives the changes in its scope
+           that match its filter, and only those
+    """
+
+    inst = topology_st.standalone
+    psc = PersistentSearchControl()
+    people = 'ou=people,%s' % DEFAULT_SUFFIX
+    groups_base = 'ou=groups,%s' % DEFAULT_SUFFIX
+    searches = []
+    for i in range(8):
+        for base, filterstr in ((people, '(description=*)'),
+                                (people, '(objectClass=*)'),
+                                (groups_base, '(objectClass=*)')):
+            msg_id = inst.search_ext(base=base, scope=ldap.SCOPE_SUBTREE, filterstr=filterstr,
+                                     attrlist=['*'], serverctrls=[psc])
+            _run_psearch(inst, msg_id)
+            searches.append((base, filterstr, msg_id))
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    described = users.create_test_user(uid=2001)
+    described.replace('description', 'watched')
+    plain = users.create_test_user(uid=2002)
+    group = Groups(inst, DEFAULT_SUFFIX).create(properties={'cn': 'psearch_group'})
+
+    for base, filterstr, msg_id in searches:
+        results = set(_run_psearch(inst, msg_id))
+        if base == groups_base:
+            assert results == {group.dn}
+        elif filterstr == '(description=*)':
+            assert results == {described.dn}
+        else:
+            assert results == {described.dn, plain.dn}
+        inst.abandon(msg_id)
+
+
+
+def test_psearch_client_not_reading(topology_st):
+    """Check that a client which stops reading its changes does not hold
+    up the other persistent searches
+
+    :id: 5e2a9c1f-7d4b-4f08-b3a6-1c8e0d7f2b94
+    :setup: Standalone instance
+    :steps:
+        1. Use a single dispatcher thread and restart the server
+        2. Run a persistent search on a connection which never reads
+        3. Run a persistent search on another connection
+        4. Make large changes, more than the connection buffers can hold
+        5. Check the changes received by the reading client
+        6. Check the connection which does not read is closed
+    :expectedresults:
+        1. Success
+        2. Operation should be successful
+        3. Operation should be successful
+        4. Success
+        5. All the changes are received without waiting for the other client
+        6. The connection is closed after nsslapd-ioblocktimeout (10s)
+    """
+
+    inst = topology_st.standalone
+    inst.config.replace('nsslapd-psearch-threads', '1')
+    inst.restart()
+    psc = PersistentSearchControl()
+    stalled = ldap.initialize(inst.toLDAPURL())
+    stalled.simple_bind_s(DN_DM, PASSWORD)
+    stalled.search_ext(base=DEFAULT_SUFFIX, scope=ldap.SCOPE_SUBTREE, attrlist=['*'], serverctrls=[psc])
+    msg_id = inst.search_ext(base=DEFAULT_SUFFIX, scope=ldap.SCOPE_SUBTREE, attrlist=['*'], serverctrls=[psc])
+    _run_psearch(inst, msg_id)
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=3001)
+    try:
+        for i in range(300):
+            user.replace('description', '%03d' % i + 'x' * 65536)
+        results = _run_psearch(inst, msg_id)
+        assert results.count(user.dn) == 301
+
+        for _ in range(30):
+            if inst.ds_error_log.match('.*does not read the changes, the connection is closed.*'):
+                break
+            time.sleep(1)
+        assert inst.ds_error_log.match('.*does not read the changes, the connection is closed.*')
+    finally:
+        inst.abandon(msg_id)
+        user.delete()
+        inst.config.replace('nsslapd-psearch-threads', '4')
+        inst.restart()
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
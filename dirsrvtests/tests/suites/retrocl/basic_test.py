@@ -329,6 +329,50 @@ def test_retrocl_trimming(topology_st):
     # Clean up
     inst.config.set('nsslapd-errorlog-level', '0')
 
+
+def test_retrocl_trimming_batch(topology_st, request):
+    """Test retrocl trimming in batches keeps the last change record
+
+    :id: 0a3e1d5c-7b2f-4e8a-9c61-5f4d2b8e7a13
+    :setup: Standalone Instance
+    :steps:
+        1. Enable Retro changelog with a trim batch size of 3
+        2. Add more changes than a batch
+        3. Configure trimming and wait for the changes to be trimmed
+        4. Check that only the last change record is left
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. Success
+    """
+
+    inst = topology_st.standalone
+    rcl = RetroChangelogPlugin(inst)
+    rcl.replace('nsslapd-changelog-trim-batch', '3')
+    rcl.enable()
+    inst.restart()
+
+    suffix = Domain(inst, DEFAULT_SUFFIX)
+    for idx in range(0, 10):
+        suffix.replace('description', str(idx))
+
+    rcl.replace('nsslapd-changelog-trim-interval', '2')
+    rcl.replace('nsslapd-changelogmaxage', '5s')
+    inst.restart()
+
+    time.sleep(10)
+    retro_changelog_suffix = DSLdapObjects(inst, basedn=RETROCL_SUFFIX)
+    cllist = retro_changelog_suffix.filter('(changeNumber=*)')
+    assert len(cllist) == 1
+
+    def fin():
+        rcl.remove_all('nsslapd-changelog-trim-batch')
+        inst.restart()
+
+    request.addfinalizer(fin)
+
+
 def test_retrocl_trimming_interval(topology_st, request):
     """Test retrocl trimming interval works
 
@@ -29,6 +29,8 @@ from lib389.tasks import ImportTask
 from lib389.utils import get_default_db_lib
 from lib389.rewriters import *
 from lib389.backend import Backends
+from lib389.cos import CosPointerDefinition, CosTemplate
+from lib389.idm.nscontainer import nsContainer
 
 logging.getLogger(__name__).setLevel(logging.INFO)
 log = logging.getLogger(__name__)
@@ -646,7 +648,7 @@ def test_managed_and_filtered_role_rewrite(topo, request):
 def test_not_such_entry_role_rewrite(topo, request):
     """Test that filter components containing 'nsrole=xxx'
        ,where xxx does not refer to any role definition,
-       replace the component by 'nsuniqueid=-1'
+       replace the component by the empty filter '(|)'
 
     :id: b098dda5-fc77-46c4-84a7-5d0c7035bb77
     :setup: server
@@ -660,7 +662,7 @@ def test_not_such_entry_role_rewrite(topo, request):
         6. Enable plugin log level to capture role plugin message
         7. Check that a search is fast "(OR(nsrole=managed_role)(nsrole=not_existing_role))"
         8. Stop the instance
-        9. Check that a message like this was logged: replace (nsrole=not_existing_role) by (nsuniqueid=-1)
+        9. Check that a message like this was logged: replace (nsrole=not_existing_role) by (|)
     :expectedresults:
         1. Operation should  succeed
         2. Operation should  succeed
@@ -753,8 +755,8 @@ def test_not_such_entry_role_rewrite(topo, request):
     # Restart server to refresh entrycache
     topo.standalone.stop()
 
-    # Check that when the role does not exist it is translated into 'nsuniqueid=-1'
-    pattern = ".*replace \(nsRole=cn=not_such_entry_role,dc=example,dc=com\) by \(nsuniqueid=-1\).*"
+    # Check that when the role does not exist it is translated into '(|)'
+    pattern = ".*replace \(nsRole=cn=not_such_entry_role,dc=example,dc=com\) by \(\|\).*"
     assert topo.standalone.ds_error_log.match(pattern)
 
     def fin():
@@ -769,6 +771,168 @@ def test_not_such_entry_role_rewrite(topo, request):
 
     request.addfinalizer(fin)
 
+def test_nested_role_rewrite_and_cache(topo, request):
+    """Test that nsrole values follow the changes of the roles and of the
+       entries, and that a nested role in a filter is rewritten
+
+    :id: 5c0f7d3e-8a61-4c5b-9e0a-3f9d6a2b1c47
+    :setup: Standalone instance
+    :steps:
+        1. Setup nsrole rewriter
+        2. Create two managed roles, a filtered role and a nested role of the three
+        3. Create users, two in the managed roles and one in the filtered role
+        4. Check the nsrole values of the users
+        5. Search with (nsrole=<nested role>)
+        6. Remove a user from its managed role
+        7. Check its nsrole values and the search again
+        8. Remove a managed role from the nested role
+        9. Check the nsrole values and the search again
+        10. Check that the nested role component was rewritten
+    :expectedresults:
+        1. Operation should succeed
+        2. Operation should succeed
+        3. Operation should succeed
+        4. Each user has the nested role
+        5. The three users are returned
+        6. Operation should succeed
+        7. The user no longer has the roles and is not returned
+        8. Operation should succeed
+        9. The user of that managed role no longer has the nested role
+        10. A message like 'replace (nsRole=<nested role>) by (|...)' is logged
+    """
+    # Setup nsrole rewriter
+    rewriters = Rewriters(topo.standalone)
+    rewriter = rewriters.ensure_state(properties={"cn": "nsrole", "nsslapd-libpath": 'libroles-plugin'})
+    try:
+        rewriter.add('nsslapd-filterrewriter', "role_nsRole_filter_rewriter")
+    except:
+        pass
+
+    managed_roles = ManagedRoles(topo.standalone, DEFAULT_SUFFIX)
+    managed1 = managed_roles.create(properties={"cn": 'rewrite_managed1'})
+    managed2 = managed_roles.create(properties={"cn": 'rewrite_managed2'})
+    filtered_roles = FilteredRoles(topo.standalone, DEFAULT_SUFFIX)
+    filtered = filtered_roles.create(properties={"cn": 'rewrite_filtered',
+                                                 "nsRoleFilter": '(description=rewrite_filtered)'})
+    nested_roles = NestedRoles(topo.standalone, DEFAULT_SUFFIX)
+    nested = nested_roles.create(properties={"cn": 'rewrite_nested',
+                                             "nsRoleDN": [managed1.dn, managed2.dn, filtered.dn]})
+
+    users = UserAccounts(topo.standalone, DEFAULT_SUFFIX)
+    user1 = users.create_test_user(uid=101, gid=101)
+    user1.set('nsRoleDN', managed1.dn)
+    user2 = users.create_test_user(uid=102, gid=102)
+    user2.set('nsRoleDN', managed2.dn)
+    user3 = users.create_test_user(uid=103, gid=103)
+    user3.set('description', 'rewrite_filtered')
+
+    def nsroles(user):
+        return [r.lower() for r in user.get_attr_vals_utf8('nsrole')]
+
+    def members(role):
+        entries = topo.standalone.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, "(nsrole=%s)" % role.dn, ['uid'])
+        return sorted([e.dn.lower() for e in entries])
+
+    for user in (user1, user2, user3):
+        assert nested.dn.lower() in nsroles(user)
+    assert members(nested) == sorted([user1.dn.lower(), user2.dn.lower(), user3.dn.lower()])
+
+    topo.standalone.config.loglevel(vals=(ErrorLog.DEFAULT, ErrorLog.PLUGIN))
+
+    # The nsrole values of a modified entry are computed again
+    user1.remove('nsRoleDN', managed1.dn)
+    assert nsroles(user1) == []
+    assert members(nested) == sorted([user2.dn.lower(), user3.dn.lower()])
+
+    # So are the nsrole values of all the entries when a role changes
+    nested.remove('nsRoleDN', managed2.dn)
+    assert nsroles(user2) == [managed2.dn.lower()]
+    assert nested.dn.lower() in nsroles(user3)
+    assert members(nested) == [user3.dn.lower()]
+
+    pattern = r".*replace \(nsRole=%s\) by \(\|.*" % nested.dn
+    assert topo.standalone.ds_error_log.match(pattern)
+
+    def fin():
+        topo.standalone.config.loglevel(vals=(ErrorLog.DEFAULT,))
+        for user in (user1, user2, user3):
+            user.delete()
+        for role in (nested, filtered, managed1, managed2):
+            role.delete()
+
+    request.addfinalizer(fin)
+
+def test_filtered_role_on_cos_attribute(topo, request):
+    """Test that nsrole follows a CoS template used by a filtered role
+
+    :id: aade96c6-3d95-4c9c-92ad-f420d824d283
+    :setup: Standalone instance
+    :steps:
+        1. Add a pointer CoS generating employeeType from a template
+        2. Add a filtered role on employeeType, and a nested role containing it
+        3. Add a user and read its nsrole twice
+        4. Modify the CoS template
+        5. Read the nsrole of the user
+        6. Restore the CoS template
+        7. Read the nsrole of the user
+    :expectedresults:
+        1. Operation should succeed
+        2. Operation should succeed
+        3. The user has both roles
+        4. Operation should succeed
+        5. The user no longer has the roles
+        6. Operation should succeed
+        7. The user has both roles again
+    """
+    inst = topo.standalone
+    tmpl_parent = 'cn=cosRoleTemplates,{}'.format(DEFAULT_SUFFIX)
+    container = nsContainer(inst, tmpl_parent)
+    container.create(properties={'cn': 'cosRoleTemplates'})
+    template = CosTemplate(inst, 'cn=cosRoleTemplate,{}'.format(tmpl_parent))
+    template.create(properties={'cn': 'cosRoleTemplate', 'employeeType': 'cosrole_member'})
+    cosdef = CosPointerDefinition(inst, 'cn=cosRoleDefinition,{}'.format(DEFAULT_SUFFIX))
+    cosdef.create(properties={'cn': 'cosRoleDefinition',
+                              'cosTemplateDn': template.dn,
+                              'cosAttribute': 'employeeType'})
+
+    filtered = FilteredRoles(inst, DEFAULT_SUFFIX).create(properties={"cn": 'cos_filtered',
+                                                                      "nsRoleFilter": '(employeeType=cosrole_member)'})
+    nested = NestedRoles(inst, DEFAULT_SUFFIX).create(properties={"cn": 'cos_nested',
+                                                                  "nsRoleDN": filtered.dn})
+    user = UserAccounts(inst, DEFAULT_SUFFIX).create_test_user(uid=201, gid=201)
+
+    def fin():
+        for entry in (user, nested, filtered, cosdef, template, container):
+            if entry.exists():
+                entry.delete()
+
+    request.addfinalizer(fin)
+
+    def wait_for(value):
+        for _ in range(20):
+            if user.get_attr_val_utf8('employeeType') == value:
+                return True
+            time.sleep(0.5)
+        return False
+
+    def nsroles():
+        return sorted([r.lower() for r in user.get_attr_vals_utf8('nsrole')])
+
+    roles = sorted([filtered.dn.lower(), nested.dn.lower()])
+    assert wait_for('cosrole_member')
+    assert nsroles() == roles
+    # The second read is answered from the nsrole result cache
+    assert nsroles() == roles
+
+    template.replace('employeeType', 'cosrole_other')
+    assert wait_for('cosrole_other')
+    assert nsroles() == []
+
+    template.replace('employeeType', 'cosrole_member')
+    assert wait_for('cosrole_member')
+    assert nsroles() == roles
+
+
 if __name__ == "__main__":
     CURRENT_FILE = os.path.realpath(__file__)
     pytest.main("-s -v %s" % CURRENT_FILE)
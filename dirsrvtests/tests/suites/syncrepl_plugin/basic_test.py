@@ -732,3 +732,64 @@ def test_sync_repl_invalid_cookie(topology, request):
             pass
 
     request.addfinalizer(fin)
+
+
+@pytest.mark.skipif(ldap.__version__ < '3.3.1',
+    reason="python ldap versions less that 3.3.1 have bugs in sync repl that will cause this to fail!")
+def test_sync_repl_trimmed_cookie(topology, request):
+    """Test that a cookie only brings the changes since it was issued,
+    unless they were trimmed from the retro changelog
+
+    :id: 3e9b7d2a-5c14-4f86-a0d1-8b6e2f4c7a93
+    :setup: Standalone instance
+    :steps:
+        1. Enable retroCL/content_sync and run an initial refresh
+        2. Add a user and refresh with the cookie
+        3. Add two users, trim the changelog up to the first of them
+           and refresh with the cookie
+    :expectedresults:
+        1. Success
+        2. Only the added user is sent
+        3. The changes are no longer in the changelog, the whole
+           content is sent
+    """
+    inst = topology.standalone
+    rcl = RetroChangelogPlugin(inst)
+    rcl.enable()
+    rcl.replace('nsslapd-attribute', 'nsuniqueid:targetUniqueId')
+    ContentSyncPlugin(inst).enable()
+    inst.restart()
+
+    sync = ISyncRepl(inst)
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user1 = users.create_test_user(uid=3001)
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+    assert list(sync.entries.keys()) == [user1.dn]
+
+    user2 = users.create_test_user(uid=3002)
+    user3 = users.create_test_user(uid=3003)
+    changes = inst.search_s('cn=changelog', ldap.SCOPE_ONELEVEL,
+                            '(targetDn=%s)' % user2.dn, ['changenumber'])
+    last_trimmed = int(changes[0][1]['changenumber'][0])
+    for dn, _ in inst.search_s('cn=changelog', ldap.SCOPE_ONELEVEL,
+                               '(changenumber<=%d)' % last_trimmed, ['1.1']):
+        inst.delete_s(dn)
+
+    sync.syncrepl_search(base=DEFAULT_SUFFIX)
+    sync.syncrepl_complete()
+    assert user1.dn in sync.entries
+    assert user2.dn in sync.entries
+    assert user3.dn in sync.entries
+
+    def fin():
+        for user in (user1, user2, user3):
+            try:
+                user.delete()
+            except:
+                pass
+
+    request.addfinalizer(fin)
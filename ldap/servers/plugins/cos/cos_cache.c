@@ -17,20 +17,24 @@
     very fast lookups at the expense of RAM.
     All meta data is indexed, allowing fast
     binary search lookups.
-    The cache is not dynamic, in the sense
-    that it does not iteratively modify
-    itself as changes are made to the cos
-    meta-data.  Rather, it is designed to
-    be fast to read, with non-locking
-    multiple thread access to the cache,
-    at the expense of modification speed.
-    This means that when changes do occur,
-    the cache must be rebuilt from scratch.
-    However, this is achieved in such a way,
-    so as to allow cache queries during the
-    building of the new cache - so once a
-    cache has been built, there is no down
-    time.
+    The cache is designed to be fast to
+    read, with non-locking multiple thread
+    access to the cache: a cache is never
+    modified once it is published.  When
+    changes do occur, a new version of the
+    cache is made and swapped for the current
+    one, readers keep using the version they
+    hold a reference to until they release it.
+    The new version is a copy of the current
+    one where only the changed definitions and
+    templates are read again from the DIT, the
+    cache is rebuilt from scratch only when
+    the changes cannot be tracked (backend
+    state changes, too many changes at once).
+    Either way, cache queries are allowed
+    during the building of the new cache - so
+    once a cache has been built, there is no
+    down time.
     Of course, the configuration of the cos meta
     data is likely to be a thing which does not
     happen often.  Any other use, is probably a
@@ -109,9 +113,29 @@ void *cos_get_plugin_identity(void);
 #define COSTYPE_INDIRECT 3
 #define COS_DEF_ERROR_NO_TEMPLATES -2
 
-/* both variables are protected by change_lock */
+/* kinds of changes, see cos_cache_entry_is_cos_related */
+#define COS_CHANGE_DEFINITION 0x1
+#define COS_CHANGE_TEMPLATE 0x2
+#define COS_CHANGE_UNKNOWN 0x4
+
+/* past that many pending changes the cache is rebuilt from scratch */
+#define COS_CACHE_MAX_PENDING 512
+
+/* a change to apply to the cache */
+struct _cosChange
+{
+    struct _cosChange *pNext;
+    int type;
+    Slapi_DN *sdn;
+};
+typedef struct _cosChange cosChange;
+
+/* all these variables are protected by change_lock */
 static int cos_cache_notify_flag = 0;
 static PRBool cos_cache_at_work = PR_FALSE;
+static cosChange *cos_cache_pending = NULL;
+static int cos_cache_pending_count = 0;
+static int cos_cache_full_rebuild = 0;
 
 /* service definition cache structs */
 
@@ -200,7 +224,11 @@ static cosCache *pCache; /* always the current global cache, only use getref to
 
 /* the place to start if you want a new cache */
 static int cos_cache_create_unlock(void);
-static int cos_cache_creation_lock(void);
+static int cos_cache_update_unlock(cosChange *pChanges);
+static int cos_cache_creation_lock(cosChange *pChanges);
+static void cos_cache_publish(cosCache *pNewCache);
+static void cos_cache_queue_change(int type, const Slapi_DN *sdn);
+static void cos_cache_free_changes(cosChange **ppChanges);
 
 /* cache index related functions */
 static int cos_cache_index_all(cosCache *pCache);
@@ -228,13 +256,23 @@ static int cos_cache_cmp_attr(cosAttributes *pAttr, Slapi_Value *test_this, int
 
 /* cosTemplates manipulation */
 static int cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls);
+static int cos_cache_search_tmpls(const char *dn, int scope, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls);
+static void cos_cache_del_tmpl(cosTemplates *pTmpl);
+static int cos_cache_tmpl_matches(cosAttrValue *pTmplDn, cosAttrValue *pCosSpecifier, int cosType, const Slapi_DN *sdn);
 static int cos_cache_add_tmpl(cosTemplates **pTemplates, cosAttrValue *dn, cosAttrValue *objclasses, cosAttrValue *pCosSpecifier, cosAttributes *pAttrs, cosAttrValue *cosPriority);
 
 /* cosDefinitions manipulation */
 static int cos_cache_build_definition_list(cosDefinitions **pDefs, int *vattr_cacheable);
-static int cos_cache_add_dn_defs(char *dn, cosDefinitions **pDefs);
+static int cos_cache_add_dn_defs(const char *dn, cosDefinitions **pDefs, int scope, const Slapi_DN *tmpl_sdn);
 static int cos_cache_add_defn(cosDefinitions **pDefs, cosAttrValue **dn, int cosType, cosAttrValue **tree, cosAttrValue **tmpDn, cosAttrValue **spec, cosAttrValue **pAttrs, cosAttrValue **pOverrides, cosAttrValue **pOperational, cosAttrValue **pCosMerge, cosAttrValue **pCosOpDefault);
 static int cos_cache_entry_is_cos_related(Slapi_Entry *e);
+static void cos_cache_del_defn(cosDefinitions *pDef);
+
+/* copies of the cache contents, for a new version of the cache */
+static cosAttrValue *cos_cache_dup_attrval_list(cosAttrValue *pVal);
+static cosAttributes *cos_cache_dup_attr_list(cosAttributes *pAttrs);
+static cosTemplates *cos_cache_dup_tmpl_list(cosTemplates *pTmpls);
+static cosDefinitions *cos_cache_dup_defn_list(cosDefinitions *pDefs);
 
 /* schema checking */
 static int cos_cache_schema_check(cosCache *pCache, int cache_attr_index, Slapi_Attr *pObjclasses);
@@ -384,7 +422,7 @@ cos_cache_wait_on_change(void *arg __attribute__((unused)))
     pCache = 0;
 
     /* create initial cache */
-    cos_cache_creation_lock();
+    cos_cache_creation_lock(NULL);
 
     slapi_lock_mutex(start_lock);
     started = 1;
@@ -416,10 +454,24 @@ cos_cache_wait_on_change(void *arg __attribute__((unused)))
          * before we go running off doing lots of stuff lets check if we should stop
         */
         if (keeprunning) {
-            cos_cache_creation_lock();
+            /*
+             * Take the pending changes now: the changes notified while
+             * the cache is updated are dealt with on the next round.
+             */
+            cosChange *pChanges = cos_cache_pending;
+            int full_rebuild = cos_cache_full_rebuild;
+
+            cos_cache_pending = NULL;
+            cos_cache_pending_count = 0;
+            cos_cache_full_rebuild = 0;
+            cos_cache_notify_flag = 0; /* Dealt with it */
+
+            if (full_rebuild || pChanges) {
+                cos_cache_creation_lock(full_rebuild ? NULL : pChanges);
+            }
+            cos_cache_free_changes(&pChanges);
         }
-        cos_cache_notify_flag = 0; /* Dealt with it */
-    }                              /* while */
+    } /* while */
 
     /* shut down the cache */
     slapi_unlock_mutex(change_lock);
@@ -467,35 +519,7 @@ cos_cache_create_unlock(void)
                 ret = cos_cache_schema_build(pNewCache);
                 if (ret == 0) {
                     /* now to swap the new cache for the old cache */
-                    cosCache *pOldCache;
-
-                    slapi_lock_mutex(cache_lock);
-
-                    /* turn off caching until the old cache is done */
-                    if (pCache) {
-                        slapi_vattrcache_cache_none();
-
-                        /*
-                         * be sure not to uncache other stuff
-                         * like roles if there is no change in
-                         * state
-                         */
-                        if (pCache->vattr_cacheable)
-                            slapi_entrycache_vattrcache_watermark_invalidate();
-                    } else {
-                        if (pNewCache && pNewCache->vattr_cacheable) {
-                            slapi_vattrcache_cache_all();
-                        }
-                    }
-
-                    pOldCache = pCache;
-                    pCache = pNewCache;
-
-                    slapi_unlock_mutex(cache_lock);
-
-                    if (pOldCache)
-                        cos_cache_release(pOldCache);
-
+                    cos_cache_publish(pNewCache);
                     cache_built = 1;
                 } else {
                     /* we should not go on without proper schema checking */
@@ -539,6 +563,9 @@ cos_cache_create_unlock(void)
 
         pOldCache = pCache;
         pCache = NULL;
+        if (pOldCache) {
+            slapi_vattr_generation_bump();
+        }
 
         slapi_unlock_mutex(cache_lock);
 
@@ -550,9 +577,215 @@ cos_cache_create_unlock(void)
     return ret;
 }
 
+/*
+    cos_cache_publish
+    -----------------
+    swaps the new cache for the current one, releasing its refcount
+    to the old cache.  Readers holding a reference to the old cache
+    keep using it, it is destroyed with the last reference.
+*/
+static void
+cos_cache_publish(cosCache *pNewCache)
+{
+    cosCache *pOldCache;
+
+    slapi_lock_mutex(cache_lock);
+
+    /* turn off caching until the old cache is done */
+    if (pCache) {
+        slapi_vattrcache_cache_none();
+
+        /*
+         * be sure not to uncache other stuff
+         * like roles if there is no change in
+         * state
+         */
+        if (pCache->vattr_cacheable)
+            slapi_entrycache_vattrcache_watermark_invalidate();
+    } else {
+        if (pNewCache && pNewCache->vattr_cacheable) {
+            slapi_vattrcache_cache_all();
+        }
+    }
+
+    pOldCache = pCache;
+    pCache = pNewCache;
+    /* after the swap: a value computed with the old cache is then outdated */
+    slapi_vattr_generation_bump();
+
+    slapi_unlock_mutex(cache_lock);
+
+    if (pOldCache)
+        cos_cache_release(pOldCache);
+}
+
+/*
+    cos_cache_apply_defn_change
+    ---------------------------
+    a definition entry was added, modified, renamed or deleted:
+    drop it from the list and read it again with its templates
+*/
+static void
+cos_cache_apply_defn_change(cosDefinitions **pDefs, const Slapi_DN *sdn)
+{
+    cosDefinitions **ppDef = pDefs;
+
+    while (*ppDef) {
+        cosDefinitions *pDef = *ppDef;
+        Slapi_DN *def_sdn = slapi_sdn_new_dn_byref(pDef->pDn->val);
+        int match = (slapi_sdn_compare(def_sdn, sdn) == 0);
+
+        slapi_sdn_free(&def_sdn);
+        if (match) {
+            *ppDef = pDef->list.pNext;
+            cos_cache_del_defn(pDef);
+        } else {
+            ppDef = (cosDefinitions **)&(pDef->list.pNext);
+        }
+    }
+
+    cos_cache_add_dn_defs(slapi_sdn_get_dn(sdn), pDefs, LDAP_SCOPE_BASE, NULL);
+}
+
+/*
+    cos_cache_apply_tmpl_change
+    ---------------------------
+    a template entry was added, modified, renamed or deleted:
+    read it again for each definition it belongs to.  If it belongs
+    to none, it may be the first template of a definition which is
+    not cached yet, look for such definitions.
+*/
+static void
+cos_cache_apply_tmpl_change(cosDefinitions **pDefs, const Slapi_DN *sdn)
+{
+    cosDefinitions **ppDef = pDefs;
+    int matched = 0;
+
+    while (*ppDef) {
+        cosDefinitions *pDef = *ppDef;
+
+        if (cos_cache_tmpl_matches(pDef->pCosTemplateDn, pDef->pCosSpecifier, pDef->cosType, sdn)) {
+            cosTemplates **ppTmpl = &(pDef->pCosTmps);
+
+            matched = 1;
+            while (*ppTmpl) {
+                cosTemplates *pTmpl = *ppTmpl;
+                Slapi_DN *tmpl_sdn = slapi_sdn_new_dn_byref(pTmpl->pDn->val);
+                int match = (slapi_sdn_compare(tmpl_sdn, sdn) == 0);
+
+                slapi_sdn_free(&tmpl_sdn);
+                if (match) {
+                    *ppTmpl = pTmpl->list.pNext;
+                    cos_cache_del_tmpl(pTmpl);
+                } else {
+                    ppTmpl = (cosTemplates **)&(pTmpl->list.pNext);
+                }
+            }
+            cos_cache_search_tmpls(slapi_sdn_get_dn(sdn), LDAP_SCOPE_BASE,
+                                   pDef->pCosSpecifier, pDef->pCosAttrs, &(pDef->pCosTmps));
+
+            if (pDef->pCosTmps == NULL) {
+                /* without our golden templates we are nothing */
+                slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM, "cos_cache_apply_tmpl_change - "
+                                                                      "No templates left for cos definition %s, discarding from cache.\n",
+                              pDef->pDn->val);
+                *ppDef = pDef->list.pNext;
+                cos_cache_del_defn(pDef);
+                continue;
+            }
+        }
+        ppDef = (cosDefinitions **)&(pDef->list.pNext);
+    }
+
+    if (!matched) {
+        void *node = NULL;
+        Slapi_DN *suffix = slapi_get_first_suffix(&node, 0);
+
+        while (suffix) {
+            cos_cache_add_dn_defs(slapi_sdn_get_dn(suffix), pDefs, LDAP_SCOPE_SUBTREE, sdn);
+            suffix = slapi_get_next_suffix(&node, 0);
+        }
+    }
+}
+
+/*
+    cos_cache_update_unlock
+    -----------------------
+    Copies the current cache, applies the changes to the copy and
+    swaps it for the current cache.  Only the changed definitions and
+    templates are read from the DIT.
+
+    returns non-zero when the cache must be rebuilt from scratch
+
+        called while change_lock is NOT held
+*/
+static int
+cos_cache_update_unlock(cosChange *pChanges)
+{
+    cosCache *pOldCache;
+    cosCache *pNewCache;
+    cosChange *pChange;
+
+    slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "--> cos_cache_update_unlock\n");
+
+    /* not cos_cache_getref(), we are the one building the cache */
+    slapi_lock_mutex(cache_lock);
+    pOldCache = pCache;
+    if (pOldCache)
+        pOldCache->refCount++;
+    slapi_unlock_mutex(cache_lock);
+
+    if (pOldCache == NULL) {
+        /* nothing to start from */
+        slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "<-- cos_cache_update_unlock\n");
+        return -1;
+    }
+
+    pNewCache = (cosCache *)slapi_ch_calloc(1, sizeof(cosCache));
+    pNewCache->refCount = 1; /* 1 is for us */
+    pNewCache->vattr_cacheable = pOldCache->vattr_cacheable;
+    pNewCache->pDefs = cos_cache_dup_defn_list(pOldCache->pDefs);
+    cos_cache_release(pOldCache);
+
+    for (pChange = pChanges; pChange; pChange = pChange->pNext) {
+        if (pChange->type & COS_CHANGE_DEFINITION) {
+            cos_cache_apply_defn_change(&(pNewCache->pDefs), pChange->sdn);
+        }
+        if (pChange->type & COS_CHANGE_TEMPLATE) {
+            cos_cache_apply_tmpl_change(&(pNewCache->pDefs), pChange->sdn);
+        }
+    }
+
+    /*
+     * Without definitions the full rebuild disables cos, and it is cheap.
+     * As for the full rebuild, we cannot go on without the indexes and the
+     * schema.
+     */
+    if (pNewCache->pDefs == NULL ||
+        cos_cache_index_all(pNewCache) ||
+        cos_cache_schema_build(pNewCache)) {
+        cos_cache_release(pNewCache);
+        slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM, "cos_cache_update_unlock - "
+                                                              "Cannot update the cache, rebuilding it\n");
+        slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "<-- cos_cache_update_unlock\n");
+        return -1;
+    }
+
+    cos_cache_publish(pNewCache);
+    slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM, "cos_cache_update_unlock - "
+                                                          "Class of service cache updated.\n");
+
+    slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "<-- cos_cache_update_unlock\n");
+    return 0;
+}
+
 /* cos_cache_creation_lock is called with change_lock being hold:
  *    slapi_lock_mutex(change_lock)
  *
+ * pChanges are the changes to apply to the current cache, NULL to rebuild
+ * the cache from scratch.  The cache is also rebuilt if the changes cannot
+ * be applied.
+ *
  * To rebuild the cache cos_cache_creation gets cos definitions from backend, that
  * means change_lock is held then cos_cache_creation will acquire some backend pages.
  *
@@ -563,11 +796,11 @@ cos_cache_create_unlock(void)
  * A solution is to use a flag 'cos_cache_at_work' protected by change_lock,
  * release change_lock, recreate the cos_cache, acquire change_lock reset the flag.
  *
- * returned value: result of cos_cache_create_unlock
+ * returned value: result of cos_cache_update_unlock or cos_cache_create_unlock
  *
  */
 static int
-cos_cache_creation_lock(void)
+cos_cache_creation_lock(cosChange *pChanges)
 {
     int ret = -1;
     int max_tries = 10;
@@ -583,13 +816,18 @@ cos_cache_creation_lock(void)
         }
         cos_cache_at_work = PR_TRUE;
         slapi_unlock_mutex(change_lock);
-        ret = cos_cache_create_unlock();
+        if (pChanges == NULL || (ret = cos_cache_update_unlock(pChanges)) != 0) {
+            ret = cos_cache_create_unlock();
+        }
         slapi_lock_mutex(change_lock);
         cos_cache_at_work = PR_FALSE;
         break;
     }
     if (!max_tries) {
         slapi_log_err(SLAPI_LOG_FATAL, COS_PLUGIN_SUBSYSTEM, "--> cos_cache_creation_lock  rebuilt was to long, skip this rebuild\n");
+        /* the changes are lost, rebuild on the next round */
+        cos_cache_full_rebuild = 1;
+        cos_cache_notify_flag = 1;
     }
 
     return ret;
@@ -663,7 +901,7 @@ cos_cache_build_definition_list(cosDefinitions **pDefs, int *vattr_cacheable)
                             while (suffixVals[valIndex]) {
                                 /* here's a suffix, lets search it... */
                                 if (suffixVals[valIndex]->bv_val) {
-                                    if (!cos_cache_add_dn_defs(suffixVals[valIndex]->bv_val, pDefs)) {
+                                    if (!cos_cache_add_dn_defs(suffixVals[valIndex]->bv_val, pDefs, LDAP_SCOPE_SUBTREE, NULL)) {
                                         *vattr_cacheable = -1;
                                         cos_def_available = 1;
                                     }
@@ -709,6 +947,7 @@ struct dn_defs_info
     cosDefinitions **pDefs;
     int vattr_cacheable;
     int ret;
+    const Slapi_DN *tmpl_sdn; /* if set, only the definitions of this template */
 };
 
 /*
@@ -933,6 +1172,21 @@ cos_dn_defs_cb(Slapi_Entry *e, void *callback_data)
             cosType = COSTYPE_BADTYPE;
     }
 
+    if (info->tmpl_sdn &&
+        !cos_cache_tmpl_matches(pCosTemplateDn, pCosSpecifier, cosType, info->tmpl_sdn)) {
+        /* not a definition of this template, leave it alone */
+        cos_cache_del_attrval_list(&pCosTargetTree);
+        cos_cache_del_attrval_list(&pCosTemplateDn);
+        cos_cache_del_attrval_list(&pCosSpecifier);
+        cos_cache_del_attrval_list(&pCosAttribute);
+        cos_cache_del_attrval_list(&pCosOverrides);
+        cos_cache_del_attrval_list(&pCosOperational);
+        cos_cache_del_attrval_list(&pCosMerge);
+        cos_cache_del_attrval_list(&pCosOpDefault);
+        cos_cache_del_attrval_list(&pDn);
+        goto bail;
+    }
+
     /*
     we should now have a full definition,
     do some sanity checks because we don't
@@ -1028,6 +1282,7 @@ bail:
     -------------------------
     takes a dn as argument and searches the dn for cos definitions,
     adding any found to the definition list. Change to use search callback API.
+    If tmpl_sdn is set, only the definitions using this template are added.
 
     Returns: 0: found at least one definition entry that got added to the
         cache successfully.
@@ -1037,15 +1292,16 @@ bail:
 #define DN_DEF_FILTER "(&(|(objectclass=cosSuperDefinition)(objectclass=cosDefinition))(objectclass=ldapsubentry))"
 
 static int
-cos_cache_add_dn_defs(char *dn, cosDefinitions **pDefs)
+cos_cache_add_dn_defs(const char *dn, cosDefinitions **pDefs, int scope, const Slapi_DN *tmpl_sdn)
 {
     Slapi_PBlock *pDnSearch = 0;
-    struct dn_defs_info info = {NULL, 0, 0};
+    struct dn_defs_info info = {NULL, 0, 0, NULL};
     pDnSearch = slapi_pblock_new();
     if (pDnSearch) {
         info.ret = -1; /* assume no good defs */
         info.pDefs = pDefs;
-        slapi_search_internal_set_pb(pDnSearch, dn, LDAP_SCOPE_SUBTREE,
+        info.tmpl_sdn = tmpl_sdn;
+        slapi_search_internal_set_pb(pDnSearch, dn, scope,
                                      DN_DEF_FILTER, NULL, 0,
                                      NULL, NULL, cos_get_plugin_identity(), 0);
         slapi_search_internal_callback_pb(pDnSearch,
@@ -1239,10 +1495,8 @@ cos_dn_tmpl_entries_cb(Slapi_Entry *e, void *callback_data)
 static int
 cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls)
 {
-    void *plugin_id;
     int scope;
-    struct tmpl_info info = {NULL, 0, 0, 0};
-    Slapi_PBlock *pDnSearch = 0;
+    int ret;
 
     slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "--> cos_cache_add_dn_tmpls\n");
 
@@ -1252,6 +1506,28 @@ cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAtt
     else
         scope = LDAP_SCOPE_BASE;
 
+    ret = cos_cache_search_tmpls(dn, scope, pCosSpecifier, pAttrs, pTmpls);
+
+    slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "<-- cos_cache_add_dn_tmpls\n");
+    return ret;
+}
+
+/*
+    cos_cache_search_tmpls
+    ----------------------
+    searches dn with the given scope for the cos templates of a
+    definition, adding any found to the template list
+
+    Returns: zero for success--found at least one good tmpl.
+            non-zero: failed to add any tmpl.
+*/
+static int
+cos_cache_search_tmpls(const char *dn, int scope, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls)
+{
+    void *plugin_id;
+    struct tmpl_info info = {NULL, 0, 0, 0};
+    Slapi_PBlock *pDnSearch = 0;
+
     /* Use new internal operation API */
     pDnSearch = slapi_pblock_new();
     plugin_id = cos_get_plugin_identity();
@@ -1277,6 +1553,34 @@ cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAtt
     return (info.ret);
 }
 
+/*
+    cos_cache_tmpl_matches
+    ----------------------
+    returns non-zero if the entry sdn is read as a template by a
+    definition with these template dns, specifier and type, see
+    cos_cache_add_dn_tmpls.  Indirect schemes have no templates.
+*/
+static int
+cos_cache_tmpl_matches(cosAttrValue *pTmplDn, cosAttrValue *pCosSpecifier, int cosType, const Slapi_DN *sdn)
+{
+    int ret = 0;
+
+    if (cosType == COSTYPE_INDIRECT)
+        return 0;
+
+    for (; pTmplDn && !ret; pTmplDn = pTmplDn->list.pNext) {
+        Slapi_DN *tmpl_sdn = slapi_sdn_new_dn_byref(pTmplDn->val);
+
+        if (pCosSpecifier)
+            ret = slapi_sdn_isparent(tmpl_sdn, sdn);
+        else
+            ret = (slapi_sdn_compare(tmpl_sdn, sdn) == 0);
+
+        slapi_sdn_free(&tmpl_sdn);
+    }
+    return ret;
+}
+
 /*
     cos_cache_add_defn
     ------------------
@@ -1604,7 +1908,7 @@ cos_cache_getref(cos_cache **pptheCache)
         /* first customer, create the cache */
         slapi_lock_mutex(change_lock);
         if (pCache == NULL) {
-            if (cos_cache_creation_lock()) {
+            if (cos_cache_creation_lock(NULL)) {
                 /* there was a problem or no COS definitions were found */
                 slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM, "cos_cache_getref - No cos cache created\n");
             }
@@ -1695,32 +1999,9 @@ cos_cache_release(cos_cache *ptheCache)
 
         while (pDef) {
             cosDefinitions *pTmpD = pDef;
-            cosTemplates *pCosTmps = pDef->pCosTmps;
-
-            while (pCosTmps) {
-                cosTemplates *pTmpT = pCosTmps;
-
-                pCosTmps = pCosTmps->list.pNext;
-
-                cos_cache_del_attr_list(&(pTmpT->pAttrs));
-                cos_cache_del_attrval_list(&(pTmpT->pObjectclasses));
-                cos_cache_del_attrval_list(&(pTmpT->pDn));
-                slapi_ch_free((void **)&(pTmpT->cosGrade));
-                slapi_ch_free((void **)&pTmpT);
-            }
 
             pDef = pDef->list.pNext;
-
-            cos_cache_del_attrval_list(&(pTmpD->pDn));
-            cos_cache_del_attrval_list(&(pTmpD->pCosTargetTree));
-            cos_cache_del_attrval_list(&(pTmpD->pCosTemplateDn));
-            cos_cache_del_attrval_list(&(pTmpD->pCosSpecifier));
-            cos_cache_del_attrval_list(&(pTmpD->pCosAttrs));
-            cos_cache_del_attrval_list(&(pTmpD->pCosOverrides));
-            cos_cache_del_attrval_list(&(pTmpD->pCosOperational));
-            cos_cache_del_attrval_list(&(pTmpD->pCosMerge));
-            cos_cache_del_attrval_list(&(pTmpD->pCosOpDefault));
-            slapi_ch_free((void **)&pTmpD);
+            cos_cache_del_defn(pTmpD);
         }
 
         if (pOldCache->ppAttrIndex)
@@ -1736,6 +2017,153 @@ cos_cache_release(cos_cache *ptheCache)
 }
 
 
+/*
+    cos_cache_del_tmpl
+    ------------------
+    delete a template
+*/
+static void
+cos_cache_del_tmpl(cosTemplates *pTmpl)
+{
+    cos_cache_del_attr_list(&(pTmpl->pAttrs));
+    cos_cache_del_attrval_list(&(pTmpl->pObjectclasses));
+    cos_cache_del_attrval_list(&(pTmpl->pDn));
+    slapi_ch_free((void **)&(pTmpl->cosGrade));
+    slapi_ch_free((void **)&pTmpl);
+}
+
+/*
+    cos_cache_del_defn
+    ------------------
+    delete a definition and its templates
+*/
+static void
+cos_cache_del_defn(cosDefinitions *pDef)
+{
+    cosTemplates *pCosTmps = pDef->pCosTmps;
+
+    while (pCosTmps) {
+        cosTemplates *pTmpT = pCosTmps;
+
+        pCosTmps = pCosTmps->list.pNext;
+        cos_cache_del_tmpl(pTmpT);
+    }
+
+    cos_cache_del_attrval_list(&(pDef->pDn));
+    cos_cache_del_attrval_list(&(pDef->pCosTargetTree));
+    cos_cache_del_attrval_list(&(pDef->pCosTemplateDn));
+    cos_cache_del_attrval_list(&(pDef->pCosSpecifier));
+    cos_cache_del_attrval_list(&(pDef->pCosAttrs));
+    cos_cache_del_attrval_list(&(pDef->pCosOverrides));
+    cos_cache_del_attrval_list(&(pDef->pCosOperational));
+    cos_cache_del_attrval_list(&(pDef->pCosMerge));
+    cos_cache_del_attrval_list(&(pDef->pCosOpDefault));
+    slapi_ch_free((void **)&pDef);
+}
+
+/*
+    cos_cache_dup_attrval_list
+    --------------------------
+    copies a value list, keeping its order
+*/
+static cosAttrValue *
+cos_cache_dup_attrval_list(cosAttrValue *pVal)
+{
+    cosAttrValue *pHead = NULL;
+    cosAttrValue **ppTail = &pHead;
+
+    for (; pVal; pVal = pVal->list.pNext) {
+        cosAttrValue *theVal = (cosAttrValue *)slapi_ch_calloc(1, sizeof(cosAttrValue));
+
+        theVal->val = slapi_ch_strdup(pVal->val);
+        *ppTail = theVal;
+        ppTail = (cosAttrValue **)&(theVal->list.pNext);
+    }
+    return pHead;
+}
+
+/*
+    cos_cache_dup_attr_list
+    -----------------------
+    copies an attribute list, the flags, parents and objectclasses
+    are set again when the new cache is indexed and its schema built
+*/
+static cosAttributes *
+cos_cache_dup_attr_list(cosAttributes *pAttrs)
+{
+    cosAttributes *pHead = NULL;
+    cosAttributes **ppTail = &pHead;
+
+    for (; pAttrs; pAttrs = pAttrs->list.pNext) {
+        cosAttributes *theAttr = (cosAttributes *)slapi_ch_calloc(1, sizeof(cosAttributes));
+
+        theAttr->pAttrName = slapi_ch_strdup(pAttrs->pAttrName);
+        theAttr->pAttrValue = cos_cache_dup_attrval_list(pAttrs->pAttrValue);
+        *ppTail = theAttr;
+        ppTail = (cosAttributes **)&(theAttr->list.pNext);
+    }
+    return pHead;
+}
+
+/*
+    cos_cache_dup_tmpl_list
+    -----------------------
+    copies a template list
+*/
+static cosTemplates *
+cos_cache_dup_tmpl_list(cosTemplates *pTmpls)
+{
+    cosTemplates *pHead = NULL;
+    cosTemplates **ppTail = &pHead;
+
+    for (; pTmpls; pTmpls = pTmpls->list.pNext) {
+        cosTemplates *theTemp = (cosTemplates *)slapi_ch_calloc(1, sizeof(cosTemplates));
+
+        theTemp->pDn = cos_cache_dup_attrval_list(pTmpls->pDn);
+        theTemp->pObjectclasses = cos_cache_dup_attrval_list(pTmpls->pObjectclasses);
+        theTemp->pAttrs = cos_cache_dup_attr_list(pTmpls->pAttrs);
+        theTemp->cosGrade = slapi_ch_strdup(pTmpls->cosGrade);
+        theTemp->template_default = pTmpls->template_default;
+        theTemp->cosPriority = pTmpls->cosPriority;
+        *ppTail = theTemp;
+        ppTail = (cosTemplates **)&(theTemp->list.pNext);
+    }
+    return pHead;
+}
+
+/*
+    cos_cache_dup_defn_list
+    -----------------------
+    copies the definitions of a cache, with their templates.
+    This is all in memory: no definition nor template is read
+    from the DIT.
+*/
+static cosDefinitions *
+cos_cache_dup_defn_list(cosDefinitions *pDefs)
+{
+    cosDefinitions *pHead = NULL;
+    cosDefinitions **ppTail = &pHead;
+
+    for (; pDefs; pDefs = pDefs->list.pNext) {
+        cosDefinitions *theDef = (cosDefinitions *)slapi_ch_calloc(1, sizeof(cosDefinitions));
+
+        theDef->cosType = pDefs->cosType;
+        theDef->pDn = cos_cache_dup_attrval_list(pDefs->pDn);
+        theDef->pCosTargetTree = cos_cache_dup_attrval_list(pDefs->pCosTargetTree);
+        theDef->pCosTemplateDn = cos_cache_dup_attrval_list(pDefs->pCosTemplateDn);
+        theDef->pCosSpecifier = cos_cache_dup_attrval_list(pDefs->pCosSpecifier);
+        theDef->pCosAttrs = cos_cache_dup_attrval_list(pDefs->pCosAttrs);
+        theDef->pCosOverrides = cos_cache_dup_attrval_list(pDefs->pCosOverrides);
+        theDef->pCosOperational = cos_cache_dup_attrval_list(pDefs->pCosOperational);
+        theDef->pCosOpDefault = cos_cache_dup_attrval_list(pDefs->pCosOpDefault);
+        theDef->pCosMerge = cos_cache_dup_attrval_list(pDefs->pCosMerge);
+        theDef->pCosTmps = cos_cache_dup_tmpl_list(pDefs->pCosTmps);
+        *ppTail = theDef;
+        ppTail = (cosDefinitions **)&(theDef->list.pNext);
+    }
+    return pHead;
+}
+
 /*
     cos_cache_del_attr_list
     -----------------------
@@ -3144,7 +3572,7 @@ bail:
     cos_cache_change_notify
     -----------------------
     determines if the change effects the cache and if so
-    signals a rebuild.
+    queues it and signals an update.
 
     XXXrbyrne This whole mechanism needs to be revisited--it means that
     the modifying client gets his LDAP response, and an unspecified and
@@ -3152,21 +3580,19 @@ bail:
     period of time later, his mods get taken into account in the cos cache.
     This makes it hard to program reliable admin tools for COS--DSAME
     has already indicated this is an issue for them.
-    Additionally, it regenerates the _whole_ cache even for eeny weeny mods--
-    does it really neeed to ?  Additionally, in order to ensure we
-    do not miss any mods, we may tend to regen the cache, even if we've already
-    taken a mod into account in an earlier regeneration--currently there is no
-    way to know we've already dealt with the mod.
-    The right thing is something like: figure out what's being changed
-    and change only that in the cos cache and do it _before_ the response
-    goes to the client....or do a task that he can poll.
+    Only the changed definitions and templates are read again
+    (see cos_cache_update_unlock), still the update should be done
+    _before_ the response goes to the client....or do a task that he can poll.
 */
 void
 cos_cache_change_notify(Slapi_PBlock *pb)
 {
-    const char *dn;
     Slapi_DN *sdn = NULL;
-    int do_update = 0;
+    const Slapi_DN *pre_sdn = NULL;
+    const Slapi_DN *post_sdn = NULL;
+    int pre_type = 0;
+    int post_type = 0;
+    int tmpl_type = 0;
     struct slapi_entry *e;
     Slapi_Backend *be = NULL;
     int rc = 0;
@@ -3187,7 +3613,6 @@ cos_cache_change_notify(Slapi_PBlock *pb)
                                                            "Failed to get dn of changed entry\n");
         goto bail;
     }
-    dn = slapi_sdn_get_dn(sdn);
 
     slapi_pblock_get(pb, SLAPI_PLUGIN_OPRETURN, &rc);
     if (0 != rc) {
@@ -3198,8 +3623,8 @@ cos_cache_change_notify(Slapi_PBlock *pb)
     /*
      * For DELETE, MODIFY, MODRDN: see if the pre-op entry was cos significant.
      * For ADD, MODIFY, MODRDN: see if the post-op was cos significant.
-     * Touching a cos significant entry triggers the update
-     * of the whole cache.
+     * Touching a cos significant entry triggers the update of the
+     * definition or the template, under its old and new dn.
     */
     slapi_pblock_get(pb, SLAPI_OPERATION_TYPE, &optype);
     if (optype == SLAPI_OPERATION_DELETE ||
@@ -3207,19 +3632,20 @@ cos_cache_change_notify(Slapi_PBlock *pb)
         optype == SLAPI_OPERATION_MODRDN) {
 
         slapi_pblock_get(pb, SLAPI_ENTRY_PRE_OP, &e);
-        if (cos_cache_entry_is_cos_related(e)) {
-            do_update = 1;
+        pre_type = cos_cache_entry_is_cos_related(e);
+        if (e) {
+            pre_sdn = slapi_entry_get_sdn_const(e);
         }
     }
-    if (!do_update &&
-        (optype == SLAPI_OPERATION_ADD ||
-         optype == SLAPI_OPERATION_MODIFY ||
-         optype == SLAPI_OPERATION_MODRDN)) {
+    if (optype == SLAPI_OPERATION_ADD ||
+        optype == SLAPI_OPERATION_MODIFY ||
+        optype == SLAPI_OPERATION_MODRDN) {
 
         /* Adds have null pre-op entries */
         slapi_pblock_get(pb, SLAPI_ENTRY_POST_OP, &e);
-        if (cos_cache_entry_is_cos_related(e)) {
-            do_update = 1;
+        post_type = cos_cache_entry_is_cos_related(e);
+        if (e) {
+            post_sdn = slapi_entry_get_sdn_const(e);
         }
     }
 
@@ -3237,16 +3663,28 @@ cos_cache_change_notify(Slapi_PBlock *pb)
      * definitions that have _valid_ templates--the active cache
      * stays lean in the face of errors.
     */
-    if (!do_update && cos_cache_template_index_bsearch(dn)) {
+    if (!pre_type && !post_type && cos_cache_template_index_bsearch(slapi_sdn_get_dn(sdn))) {
         slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM, "cos_cache_change_notify - "
                                                               "Updating due to indirect template change(%s)\n",
-                      dn);
-        do_update = 1;
+                      slapi_sdn_get_dn(sdn));
+        tmpl_type = COS_CHANGE_TEMPLATE;
     }
 
     /* Do the update if required */
-    if (do_update) {
+    if (pre_type || post_type || tmpl_type) {
         slapi_lock_mutex(change_lock);
+        if (pre_type) {
+            cos_cache_queue_change(pre_type, pre_sdn);
+        }
+        if (post_type && (!pre_sdn || !post_sdn || slapi_sdn_compare(pre_sdn, post_sdn))) {
+            cos_cache_queue_change(post_type, post_sdn);
+        } else if (post_type & ~pre_type) {
+            /* same entry, it became cos significant in another way */
+            cos_cache_queue_change(post_type & ~pre_type, post_sdn);
+        }
+        if (tmpl_type) {
+            cos_cache_queue_change(tmpl_type, sdn);
+        }
         slapi_notify_condvar(something_changed, 1);
         cos_cache_notify_flag = 1;
         slapi_unlock_mutex(change_lock);
@@ -3256,6 +3694,51 @@ bail:
     slapi_log_err(SLAPI_LOG_TRACE, COS_PLUGIN_SUBSYSTEM, "<-- cos_cache_change_notify\n");
 }
 
+/*
+    cos_cache_queue_change
+    ----------------------
+    adds a change to the pending changes.  A change which cannot be
+    tracked, or too many pending changes, trigger a full rebuild instead.
+
+        called while change_lock is held
+*/
+static void
+cos_cache_queue_change(int type, const Slapi_DN *sdn)
+{
+    cosChange *pChange;
+
+    if (cos_cache_full_rebuild) {
+        return;
+    }
+    if ((type & COS_CHANGE_UNKNOWN) || sdn == NULL ||
+        cos_cache_pending_count >= COS_CACHE_MAX_PENDING) {
+        cos_cache_free_changes(&cos_cache_pending);
+        cos_cache_pending_count = 0;
+        cos_cache_full_rebuild = 1;
+        return;
+    }
+
+    /* the changes are applied by reading the entries again, order does not matter */
+    pChange = (cosChange *)slapi_ch_malloc(sizeof(cosChange));
+    pChange->type = type;
+    pChange->sdn = slapi_sdn_dup(sdn);
+    pChange->pNext = cos_cache_pending;
+    cos_cache_pending = pChange;
+    cos_cache_pending_count++;
+}
+
+static void
+cos_cache_free_changes(cosChange **ppChanges)
+{
+    while (*ppChanges) {
+        cosChange *pChange = *ppChanges;
+
+        *ppChanges = pChange->pNext;
+        slapi_sdn_free(&(pChange->sdn));
+        slapi_ch_free((void **)&pChange);
+    }
+}
+
 /*
     cos_cache_stop
     --------------
@@ -3279,6 +3762,8 @@ cos_cache_stop(void)
 
     /* release the caches reference to the cache */
     cos_cache_release(pCache);
+    cos_cache_free_changes(&cos_cache_pending);
+    cos_cache_pending_count = 0;
     slapi_destroy_mutex(cache_lock);
     cache_lock = NULL;
     slapi_destroy_mutex(change_lock);
@@ -3433,13 +3918,16 @@ cos_cache_backend_state_change(void *handle __attribute__((unused)),
                                int new_be_state __attribute__((unused)))
 {
     slapi_lock_mutex(change_lock);
+    cos_cache_full_rebuild = 1;
     slapi_notify_condvar(something_changed, 1);
     slapi_unlock_mutex(change_lock);
 }
 
 /*
  * returns non-zero: entry is cos significant (note does not detect indirect
- *                    template entries).
+ *                    template entries): COS_CHANGE_DEFINITION and/or
+ *                    COS_CHANGE_TEMPLATE, COS_CHANGE_UNKNOWN if there is
+ *                    no entry.
  *             0       : entry is not cos significant.
  */
 static int
@@ -3452,7 +3940,7 @@ cos_cache_entry_is_cos_related(Slapi_Entry *e)
     if (e == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM, "cos_cache_entry_is_cos_related - "
                                                            "Modified entry is NULL--updating cache just in case\n");
-        rc = 1;
+        rc = COS_CHANGE_UNKNOWN;
     } else {
 
         if (slapi_entry_attr_find(e, "objectclass", &pObjclasses)) {
@@ -3469,13 +3957,14 @@ cos_cache_entry_is_cos_related(Slapi_Entry *e)
             /* check out the object classes to see if this was a cosDefinition */
 
             index = slapi_attr_first_value(pObjclasses, &val);
-            while (!rc && val) {
+            while (val) {
                 pObj = (char *)slapi_value_get_string(val);
 
                 if (!strcasecmp(pObj, "cosdefinition") ||
-                    !strcasecmp(pObj, "cossuperdefinition") ||
-                    !strcasecmp(pObj, "costemplate")) {
-                    rc = 1;
+                    !strcasecmp(pObj, "cossuperdefinition")) {
+                    rc |= COS_CHANGE_DEFINITION;
+                } else if (!strcasecmp(pObj, "costemplate")) {
+                    rc |= COS_CHANGE_TEMPLATE;
                 }
 
                 index = slapi_attr_next_value(pObjclasses, index, &val);
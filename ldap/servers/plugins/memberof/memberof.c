@@ -3078,11 +3078,12 @@ memberof_fix_memberof(MemberOfConfig *config, Slapi_Task *task, task_data *td)
     int rc = 0;
     Slapi_PBlock *search_pb = slapi_pblock_new();
 
+    /* The fixup walks the whole subtree: keep it from flushing the entry cache */
     slapi_search_internal_set_pb(search_pb, td->dn,
                                  LDAP_SCOPE_SUBTREE, td->filter_str, 0, 0,
                                  0, 0,
                                  memberof_get_plugin_id(),
-                                 0);
+                                 SLAPI_OP_FLAG_SCAN);
 
     rc = slapi_search_internal_callback_pb(search_pb,
                                            config,
@@ -55,6 +55,16 @@ typedef struct _cnumRet
 
 #define CONFIG_CHANGELOG_TRIM_INTERVAL "nsslapd-changelog-trim-interval"
 
+/*
+ * How many change records are deleted in one backend transaction.  The
+ * changelog backend lock is held for the whole batch, and the updates of
+ * the other backends that write to the changelog wait for it: keep it small.
+ */
+#define DEFAULT_CHANGELOGDB_TRIM_BATCH 50
+#define MAX_CHANGELOGDB_TRIM_BATCH 1000
+
+#define CONFIG_CHANGELOG_TRIM_BATCH "nsslapd-changelog-trim-batch"
+
 #if defined(__hpux) && defined(__ia64)
 #define RETROCL_DLL_DEFAULT_THREAD_STACKSIZE 524288L
 #else
@@ -18,6 +18,7 @@ typedef struct _trim_status
 {
     time_t ts_c_max_age;     /* Constraint  - max age of a changelog entry */
     int ts_c_trim_interval;  /* Constraint  - interval to evaluate the need to trim */
+    int ts_c_trim_batch;     /* Constraint  - changes deleted per backend transaction */
     time_t ts_s_last_trim;   /* Status - last time we trimmed */
     int ts_s_initialized;    /* Status - non-zero if initialized */
     int ts_s_trimming;       /* non-zero if trimming in progress */
@@ -70,8 +71,9 @@ get_cleattrs(void)
  *
  * Arguments: the number of the change to delete
  *
- * Description:
- *
+ * Description: the delete is not written to the audit log nor to the
+ * changelogs.  When called from trim_changelog it is nested in the backend
+ * transaction of the batch.  A record deleted over protocol is not an error.
  */
 
 static int
@@ -85,12 +87,15 @@ delete_changerecord(changeNumber cnum)
                               RETROCL_CHANGELOG_DN);
     pb = slapi_pblock_new();
     slapi_delete_internal_set_pb(pb, dnbuf, NULL /*controls*/, NULL /* uniqueid */,
-                                 g_plg_identity[PLUGIN_RETROCL], 0 /* actions */);
+                                 g_plg_identity[PLUGIN_RETROCL], OP_FLAG_ACTION_NOLOG);
     slapi_delete_internal_pb(pb);
     slapi_pblock_get(pb, SLAPI_PLUGIN_INTOP_RESULT, &delrc);
     slapi_pblock_destroy(pb);
 
-    if (delrc != LDAP_SUCCESS) {
+    if (delrc == LDAP_NO_SUCH_OBJECT) {
+        slapi_log_err(SLAPI_LOG_PLUGIN, RETROCL_PLUGIN_NAME,
+                      "delete_changerecord: change record %lu already deleted\n", cnum);
+    } else if (delrc != LDAP_SUCCESS) {
         slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
                       "delete_changerecord: could not delete change record %lu (rc: %d)\n",
                       cnum, delrc);
@@ -174,6 +179,7 @@ handle_getchangetime_search(Slapi_Entry *e, void *callback_data)
 /*
  * Function: get_changetime
  * Arguments: cnum - number of change record to retrieve
+ *            found - if not NULL, set to non-zero if the record exists
  * Returns: Taking the retrocl_changetime of the 'cnum' entry,
  * it converts it into time_t (parse_localTime) and returns this time value.
  * It returns 0 in the following cases:
@@ -184,12 +190,15 @@ handle_getchangetime_search(Slapi_Entry *e, void *callback_data)
  * Description: Retrieve retrocl_changetime ("changetime") from a changerecord whose number is "cnum".
  */
 static time_t
-get_changetime(changeNumber cnum, int *err)
+get_changetime(changeNumber cnum, int *err, int *found)
 {
     cnum_result_t crt, *crtp = &crt;
     char fstr[16 + CNUMSTR_LEN + 2];
     Slapi_PBlock *pb;
 
+    if (found != NULL) {
+        *found = 0;
+    }
     if (cnum == 0UL) {
         if (err != NULL) {
             *err = LDAP_PARAM_ERROR;
@@ -215,12 +224,143 @@ get_changetime(changeNumber cnum, int *err)
     if (err != NULL) {
         *err = crtp->crt_err;
     }
+    if (found != NULL) {
+        *found = crtp->crt_nentries > 0;
+    }
 
     slapi_pblock_destroy(pb);
 
     return (crtp->crt_time);
 }
 
+/*
+ * Function: trim_probe
+ *
+ * Arguments: cnum - in: the first change number to look at
+ *                   out: the change number of the record found, 0 if none
+ *            last - the last change number to look at
+ *            err - the error of the search
+ *
+ * Returns: the changetime of the record found
+ *
+ * Description: Records can be missing, a client may have deleted them
+ * over protocol: the changenumber index is probed forward until a record
+ * is found.
+ */
+static time_t
+trim_probe(changeNumber *cnum, changeNumber last, int *err)
+{
+    for (changeNumber c = *cnum; c <= last && retrocl_trimming == 1; c++) {
+        int found = 0;
+        time_t change_time = get_changetime(c, err, &found);
+
+        if (*err != LDAP_SUCCESS) {
+            break;
+        }
+        if (found) {
+            *cnum = c;
+            return change_time;
+        }
+    }
+    *cnum = 0UL;
+    return 0;
+}
+
+/*
+ * Function: trim_find_cutoff
+ *
+ * Arguments: first, last - the change numbers to look at
+ *            now - the current time
+ *            max_age - the maximum age of a change record
+ *
+ * Returns: the last change number that is too old, 0 if none
+ *
+ * Description: The changetimes grow with the change numbers, so the cutoff
+ * is found with a binary search over the changenumber index instead of
+ * reading every change record.  As before, a record without timestamp is
+ * trimmed.
+ */
+static changeNumber
+trim_find_cutoff(changeNumber first, changeNumber last, time_t now, time_t max_age)
+{
+    changeNumber lo = first;
+    changeNumber hi = last;
+    changeNumber cutoff = 0UL;
+
+    while (lo <= hi && retrocl_trimming == 1) {
+        changeNumber mid = lo + (hi - lo) / 2;
+        changeNumber cnum = mid;
+        int ldrc = LDAP_SUCCESS;
+        time_t change_time = trim_probe(&cnum, hi, &ldrc);
+
+        if (ldrc != LDAP_SUCCESS) {
+            slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                          "trim_find_cutoff: could not read change record %lu (rc: %d)\n",
+                          mid, ldrc);
+            break;
+        }
+        if (cnum != 0UL && (change_time == 0 || (change_time + max_age) < now)) {
+            cutoff = cnum;
+            lo = cnum + 1;
+        } else {
+            /* no record in [mid, hi], or the records from mid are recent */
+            hi = mid - 1;
+        }
+    }
+    return cutoff;
+}
+
+/*
+ * Function: trim_delete_batch
+ *
+ * Arguments: first, last - the change numbers to delete
+ *
+ * Returns: the number of change records deleted, -1 on failure
+ *
+ * Description: Deletes the change records [first, last] in a single
+ * backend transaction.  If a delete fails the whole batch is aborted and
+ * the first change number is restored.
+ */
+static int
+trim_delete_batch(changeNumber first, changeNumber last)
+{
+    Slapi_PBlock *txn_pb;
+    int num_deleted = 0;
+    int rc = LDAP_SUCCESS;
+
+    txn_pb = slapi_pblock_new();
+    slapi_pblock_set(txn_pb, SLAPI_BACKEND, retrocl_be_changelog);
+    if (slapi_back_transaction_begin(txn_pb) != LDAP_SUCCESS) {
+        slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                      "trim_delete_batch: failed to start transaction\n");
+        slapi_pblock_destroy(txn_pb);
+        return -1;
+    }
+
+    /* Readers must not ask for the records being deleted */
+    retrocl_set_first_changenumber(last + 1);
+    for (changeNumber cnum = first; cnum <= last; cnum++) {
+        rc = delete_changerecord(cnum);
+        if (rc == LDAP_SUCCESS) {
+            num_deleted++;
+        } else if (rc == LDAP_NO_SUCH_OBJECT) {
+            rc = LDAP_SUCCESS;
+        } else {
+            break;
+        }
+    }
+
+    if (rc == LDAP_SUCCESS) {
+        slapi_back_transaction_commit(txn_pb);
+    } else {
+        slapi_back_transaction_abort(txn_pb);
+        retrocl_set_first_changenumber(first);
+        num_deleted = -1;
+    }
+    slapi_pblock_destroy(txn_pb);
+    return num_deleted;
+}
+
 /*
  * Function: trim_changelog
  *
@@ -229,71 +369,60 @@ get_changetime(changeNumber cnum, int *err)
  * Returns: 0 on success, -1 on failure
  *
  * Description: Trims the changelog, according to the constraints
- * described by the ts structure.
+ * described by the ts structure.  The last change record too old to be
+ * kept is looked up first, then the records up to it are deleted in
+ * batches of ts_c_trim_batch changes, each batch in one backend transaction.
+ * The thread yields between two batches, so that the updates waiting for
+ * the changelog backend get a chance to go first.
  */
 static int
 trim_changelog(void)
 {
-    int rc = 0, ldrc, done;
+    int rc = 0;
     time_t now_interval; /* used for checking the trim interval */
     time_t now_maxage; /* used for checking if the changelog entry can be trimmed */
-    changeNumber first_in_log = 0, last_in_log = 0;
+    changeNumber first_in_log = 0, last_in_log = 0, cutoff = 0;
     int num_deleted = 0;
-    int max_age, last_trim, trim_interval;
+    int max_age, last_trim, trim_interval, trim_batch;
 
     now_interval = slapi_current_rel_time_t(); /* monotonic time for interval */
 
     PR_Lock(ts.ts_s_trim_mutex);
     max_age = ts.ts_c_max_age;
     trim_interval = ts.ts_c_trim_interval;
+    trim_batch = ts.ts_c_trim_batch;
     last_trim = ts.ts_s_last_trim;
     PR_Unlock(ts.ts_s_trim_mutex);
 
     if (now_interval - last_trim >= trim_interval) {
-        /*
-         * Trim the changelog.  Read sequentially through all the
-         * entries, deleting any which do not meet the criteria
-         * described in the ts structure.
-         */
-        done = 0;
         now_maxage = slapi_current_utc_time(); /* real time for trim candidates */
-        while (!done && retrocl_trimming == 1) {
-            int did_delete;
-
-            did_delete = 0;
-            first_in_log = retrocl_get_first_changenumber();
-            if (0UL == first_in_log) {
-                slapi_log_err(SLAPI_LOG_PLUGIN, RETROCL_PLUGIN_NAME,
-                              "trim_changelog: no changelog records "
-                              "to trim\n");
-                /* Bail out - we can't do any useful work */
-                break;
-            }
+        first_in_log = retrocl_get_first_changenumber();
+        last_in_log = retrocl_get_last_changenumber();
+        if (0UL == first_in_log) {
+            slapi_log_err(SLAPI_LOG_PLUGIN, RETROCL_PLUGIN_NAME,
+                          "trim_changelog: no changelog records "
+                          "to trim\n");
+        } else if (max_age > 0L && last_in_log > first_in_log) {
+            /* Always leave at least one entry in the change log */
+            cutoff = trim_find_cutoff(first_in_log, last_in_log - 1, now_maxage, max_age);
+        }
 
-            last_in_log = retrocl_get_last_changenumber();
-            if (last_in_log == first_in_log) {
-                /* Always leave at least one entry in the change log */
-                break;
+        while (cutoff >= first_in_log && cutoff != 0UL && retrocl_trimming == 1) {
+            changeNumber batch_end = first_in_log + trim_batch - 1;
+            int deleted;
+
+            if (batch_end > cutoff || batch_end < first_in_log) {
+                batch_end = cutoff;
             }
-            if (max_age > 0L) {
-                time_t change_time = get_changetime(first_in_log, &ldrc);
-                if (change_time) {
-                    if ((change_time + max_age) < now_maxage) {
-                        retrocl_set_first_changenumber(first_in_log + 1);
-                        ldrc = delete_changerecord(first_in_log);
-                        num_deleted++;
-                        did_delete = 1;
-                    }
-                } else {
-                    /* What to do if there's no timestamp? Just delete it. */
-                    retrocl_set_first_changenumber(first_in_log + 1);
-                    ldrc = delete_changerecord(first_in_log);
-                    num_deleted++;
-                    did_delete = 1;
-                }
+            deleted = trim_delete_batch(first_in_log, batch_end);
+            if (deleted < 0) {
+                rc = -1;
+                break;
             }
-            if (!did_delete) {
-                done = 1;
+            num_deleted += deleted;
+            first_in_log = batch_end + 1;
+            if (cutoff >= first_in_log) {
+                DS_Sleep(PR_MillisecondsToInterval(1));
             }
         }
     } else {
@@ -424,6 +553,8 @@ retrocl_init_trimming(void)
     time_t ageval = 0; /* Don't trim, by default */
     const char *cl_trim_interval;
     int trim_interval = DEFAULT_CHANGELOGDB_TRIM_INTERVAL;
+    const char *cl_trim_batch;
+    int trim_batch = DEFAULT_CHANGELOGDB_TRIM_BATCH;
 
     cl_maxage = retrocl_get_config_str(CONFIG_CHANGELOG_MAXAGE_ATTRIBUTE);
     if (cl_maxage) {
@@ -454,8 +585,23 @@ retrocl_init_trimming(void)
         slapi_ch_free_string((char **)&cl_trim_interval);
     }
 
+    cl_trim_batch = retrocl_get_config_str(CONFIG_CHANGELOG_TRIM_BATCH);
+    if (cl_trim_batch) {
+        trim_batch = strtol(cl_trim_batch, (char **)NULL, 10);
+        if (0 >= trim_batch || trim_batch > MAX_CHANGELOGDB_TRIM_BATCH) {
+            slapi_log_err(SLAPI_LOG_ERR, RETROCL_PLUGIN_NAME,
+                          "retrocl_init_trimming: ignoring invalid %s value %s (1 to %d); "
+                          "resetting the default %d\n",
+                          CONFIG_CHANGELOG_TRIM_BATCH, cl_trim_batch,
+                          MAX_CHANGELOGDB_TRIM_BATCH, DEFAULT_CHANGELOGDB_TRIM_BATCH);
+            trim_batch = DEFAULT_CHANGELOGDB_TRIM_BATCH;
+        }
+        slapi_ch_free_string((char **)&cl_trim_batch);
+    }
+
     ts.ts_c_max_age = ageval;
     ts.ts_c_trim_interval = trim_interval;
+    ts.ts_c_trim_batch = trim_batch;
     ts.ts_s_last_trim = (time_t)0L;
     ts.ts_s_trimming = 0;
     if ((ts.ts_s_trim_mutex = PR_NewLock()) == NULL) {
@@ -40,6 +40,13 @@
 
 #define MAX_NESTED_ROLES 30
 
+/* Filter matching no entry: an empty OR is false without being evaluated */
+#define ROLE_EMPTY_FILTER "(|)"
+
+/* nsrole result cache: slots per suffix, and locks protecting them */
+#define ROLES_RESULT_CACHE_SIZE 4096
+#define ROLES_RESULT_CACHE_LOCKS 64
+
 static char *allUserAttributes[] = {
     LDAP_ALL_USER_ATTRS,
     NULL};
@@ -60,9 +67,25 @@ typedef struct _role_object
     Slapi_DN *rolescopedn; /* if set, this role will apply to any entry in the scope of this dn */
     int type;              /* ROLE_TYPE_MANAGED|ROLE_TYPE_FILTERED|ROLE_TYPE_NESTED */
     Slapi_Filter *filter;  /* if ROLE_TYPE_FILTERED */
+    char *filter_str;      /* if ROLE_TYPE_FILTERED: value of nsRoleFilter */
     Avlnode *avl_tree;     /* if ROLE_TYPE_NESTED: tree of nested DNs (avl_data is a role_object_nested struct) */
 } role_object;
 
+/* One slot of the nsrole result cache.
+   The result is valid as long as the roles definitions did not change
+   (generation), the virtual attributes a filtered role may test did not
+   change (vattr_generation) and the entry was not modified (version) */
+typedef struct _roles_result_slot
+{
+    Slapi_Backend *be;             /* backend of the entry */
+    unsigned long id;              /* entryid of the entry, 0 if the slot is empty */
+    uint64_t generation;           /* roles_cache_generation of the result */
+    uint64_t vattr_generation;     /* slapi_vattr_generation of the result */
+    uint64_t epoch;                /* incremented each time the slot is invalidated */
+    char *version;                 /* modifytimestamp of the entry */
+    Slapi_ValueSet *nsrole_values; /* the nsrole values, NULL if the entry has no role */
+} roles_result_slot;
+
 /* Structure containing the roles definitions for a given suffix */
 typedef struct _roles_cache_def
 {
@@ -89,6 +112,11 @@ typedef struct _roles_cache_def
      */
     Avlnode *avl_tree;
 
+    /* nsrole values already computed for the entries of the suffix,
+       indexed by entryid */
+    roles_result_slot *results;
+    Slapi_Mutex *results_lock[ROLES_RESULT_CACHE_LOCKS];
+
     /* Next roles suffix definitions */
     struct _roles_cache_def *next;
 
@@ -105,6 +133,10 @@ static roles_cache_def *roles_list = NULL;
 
 static Slapi_RWLock *global_lock = NULL;
 
+/* Incremented each time a role definition is added, modified or deleted,
+   which invalidates all the cached nsrole values */
+static uint64_t roles_cache_generation = 1;
+
 /* Structure holding the nsrole values */
 typedef struct _roles_cache_build_result
 {
@@ -113,6 +145,7 @@ typedef struct _roles_cache_build_result
     int has_value;                  /* flag to determine if a new value has been added to the result */
     int need_value;                 /* flag to determine if we need the result */
     vattr_context *context;         /* vattr context */
+    int loop_detected;              /* flag set if the evaluation of a role hit a loop */
 } roles_cache_build_result;
 
 /* Structure used to check if is_entry_member_of is part of a role defined in its suffix */
@@ -162,6 +195,12 @@ static int roles_cache_dump(caddr_t data, caddr_t arg);
 static int roles_cache_add_entry_cb(Slapi_Entry *e, void *callback_data);
 static void roles_cache_result_cb(int rc, void *callback_data);
 static Slapi_DN *roles_cache_get_top_suffix(Slapi_DN *suffix);
+static unsigned long roles_result_key(Slapi_Entry *entry, const char **version);
+static int roles_result_get(roles_cache_def *suffix_def, Slapi_Backend *be, unsigned long id, const char *version, uint64_t generation, uint64_t vattr_generation, uint64_t *epoch, Slapi_ValueSet **valueset_out);
+static void roles_result_put(roles_cache_def *suffix_def, Slapi_Backend *be, unsigned long id, const char *version, uint64_t generation, uint64_t vattr_generation, uint64_t epoch, Slapi_ValueSet *values);
+static void roles_result_invalidate(Slapi_DN *sdn, Slapi_Entry *entry);
+static void roles_result_free(roles_cache_def *suffix_def);
+static char *roles_cache_rewrite_role(Slapi_DN *role_dn, int hint, int *empty);
 
 /*     ============== FUNCTIONS ================ */
 
@@ -285,6 +324,16 @@ roles_cache_create_suffix(Slapi_DN *sdn)
         return (NULL);
     }
 
+    new_suffix->results = (roles_result_slot *)slapi_ch_calloc(ROLES_RESULT_CACHE_SIZE, sizeof(roles_result_slot));
+    for (size_t i = 0; i < ROLES_RESULT_CACHE_LOCKS; i++) {
+        if ((new_suffix->results_lock[i] = slapi_new_mutex()) == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, ROLES_PLUGIN_SUBSYSTEM,
+                          "roles_cache_create_suffix - Lock creation failed\n");
+            roles_cache_role_def_free(new_suffix);
+            return (NULL);
+        }
+    }
+
     new_suffix->something_changed = slapi_new_condvar(new_suffix->change_lock);
     if (new_suffix->something_changed == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, ROLES_PLUGIN_SUBSYSTEM,
@@ -589,6 +638,8 @@ roles_cache_update(roles_cache_def *suffix_to_update)
             (operation == SLAPI_OPERATION_ADD)) {
             rc = roles_cache_create_role_under(&suffix_to_update, entry);
         }
+        /* the nsrole values computed so far may no longer be valid */
+        slapi_atomic_incr_64(&roles_cache_generation, __ATOMIC_RELEASE);
         if (entry != NULL) {
             slapi_entry_free(entry);
         }
@@ -800,6 +851,14 @@ roles_cache_change_notify(Slapi_PBlock *pb)
         return;
     }
 
+    /* The nsrole values of the entry may have changed, and renaming an
+       entry may move its whole subtree in or out of the scope of a role */
+    if (operation_get_type(pb_operation) == SLAPI_OPERATION_MODRDN) {
+        slapi_atomic_incr_64(&roles_cache_generation, __ATOMIC_RELEASE);
+    } else if (operation != SLAPI_OPERATION_ADD) {
+        roles_result_invalidate(sdn, pre ? pre : e);
+    }
+
     if (operation != SLAPI_OPERATION_MODIFY) {
         if (roles_cache_is_role_entry(e) != 1) {
             slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM, "<-- roles_cache_change_notify - Not a role entry\n");
@@ -1234,7 +1293,7 @@ roles_cache_create_object_from_entry(Slapi_Entry *role_entry, role_object **resu
         }
         /* Store on the object */
         this_role->filter = filter;
-        slapi_ch_free_string(&filter_attr_value);
+        this_role->filter_str = filter_attr_value;
         break;
     }
 
@@ -1475,6 +1534,12 @@ roles_cache_listroles_ext(vattr_context *c, Slapi_Entry *entry, int return_value
     int rc = 0;
     roles_cache_build_result arg;
     Slapi_Backend *be = NULL;
+    const char *version = NULL;
+    unsigned long id = 0;
+    uint64_t generation;
+    uint64_t vattr_generation;
+    uint64_t epoch = 0;
+    int cached;
 
     slapi_log_err(SLAPI_LOG_PLUGIN,
                   ROLES_PLUGIN_SUBSYSTEM, "--> roles_cache_listroles\n");
@@ -1506,11 +1571,31 @@ roles_cache_listroles_ext(vattr_context *c, Slapi_Entry *entry, int return_value
             arg.requested_entry = entry;
             arg.has_value = 0;
             arg.context = c;
+            arg.loop_detected = 0;
+
+            /* Read the generations before evaluating the roles, a result
+               computed while a role definition or a virtual attribute
+               (e.g. a CoS template) changes is then ignored */
+            generation = slapi_atomic_load_64(&roles_cache_generation, __ATOMIC_ACQUIRE);
+            vattr_generation = slapi_vattr_generation();
+            id = roles_result_key(entry, &version);
 
             /* XXX really need a mutex for this read operation ? */
             slapi_rwlock_rdlock(roles_cache->cache_lock);
 
-            avl_apply(roles_cache->avl_tree, (IFP)roles_cache_build_nsrole, &arg, -1, AVL_INORDER);
+            cached = roles_result_get(roles_cache, be, id, version, generation, vattr_generation, &epoch,
+                                      return_values ? valueset_out : NULL);
+            if (cached >= 0) {
+                arg.has_value = cached;
+            } else {
+                avl_apply(roles_cache->avl_tree, (IFP)roles_cache_build_nsrole, &arg, -1, AVL_INORDER);
+
+                /* without the values, the traversal stops at the first role */
+                if (return_values && !arg.loop_detected) {
+                    roles_result_put(roles_cache, be, id, version, generation, vattr_generation, epoch,
+                                     arg.has_value ? *valueset_out : NULL);
+                }
+            }
 
             slapi_rwlock_unlock(roles_cache->cache_lock);
 
@@ -1571,6 +1656,7 @@ roles_cache_build_nsrole(caddr_t data, caddr_t arg)
     if (SLAPI_VIRTUALATTRS_LOOP_DETECTED == tmprc) {
         /* all we want to detect and return is loop/stack overflow */
         rc = tmprc;
+        result->loop_detected = 1;
     }
 
     /* If so, add its DN to the attribute */
@@ -1596,6 +1682,166 @@ roles_cache_build_nsrole(caddr_t data, caddr_t arg)
 }
 
 
+/* roles_result_key
+   ----------------
+   Get the entryid and the version (modifytimestamp) of an entry, used to
+   find its nsrole values in the result cache.
+   Return 0 if the entry can not be cached
+ */
+static unsigned long
+roles_result_key(Slapi_Entry *entry, const char **version)
+{
+    *version = slapi_entry_attr_get_ref(entry, "modifytimestamp");
+    if (*version == NULL) {
+        *version = slapi_entry_attr_get_ref(entry, "createtimestamp");
+        if (*version == NULL) {
+            return 0;
+        }
+    }
+    return slapi_entry_attr_get_ulong(entry, "entryid");
+}
+
+static void
+roles_result_slot_clear(roles_result_slot *slot)
+{
+    slot->be = NULL;
+    slot->id = 0;
+    slapi_ch_free_string(&slot->version);
+    if (slot->nsrole_values) {
+        slapi_valueset_free(slot->nsrole_values);
+        slot->nsrole_values = NULL;
+    }
+}
+
+/* roles_result_get
+   ----------------
+   Look for the nsrole values of an entry in the result cache.
+   If valueset_out is set, the cached values are copied into it.
+   epoch is set to the epoch of the slot, to be given back to roles_result_put
+    Return 1: the entry has nsrole
+    Return 0: the entry has no nsrole
+    Return -1: the entry is not cached
+ */
+static int
+roles_result_get(roles_cache_def *suffix_def, Slapi_Backend *be, unsigned long id, const char *version, uint64_t generation, uint64_t vattr_generation, uint64_t *epoch, Slapi_ValueSet **valueset_out)
+{
+    roles_result_slot *slot = NULL;
+    size_t idx = id % ROLES_RESULT_CACHE_SIZE;
+    int rc = -1;
+
+    if (id == 0) {
+        return rc;
+    }
+    slot = &suffix_def->results[idx];
+
+    slapi_lock_mutex(suffix_def->results_lock[idx % ROLES_RESULT_CACHE_LOCKS]);
+    *epoch = slot->epoch;
+    if ((slot->id == id) && (slot->be == be) && (slot->generation == generation) &&
+        (slot->vattr_generation == vattr_generation) && (strcmp(slot->version, version) == 0)) {
+        if (slot->nsrole_values) {
+            if (valueset_out) {
+                slapi_valueset_set_valueset(*valueset_out, slot->nsrole_values);
+            }
+            rc = 1;
+        } else {
+            rc = 0;
+        }
+    }
+    slapi_unlock_mutex(suffix_def->results_lock[idx % ROLES_RESULT_CACHE_LOCKS]);
+
+    return rc;
+}
+
+/* roles_result_put
+   ----------------
+   Store the nsrole values of an entry in the result cache, replacing the
+   entry previously cached in the slot.
+   The values are not stored if the slot was invalidated since epoch was
+   read, or if a role definition or a virtual attribute changed since the
+   generations were read.
+ */
+static void
+roles_result_put(roles_cache_def *suffix_def, Slapi_Backend *be, unsigned long id, const char *version, uint64_t generation, uint64_t vattr_generation, uint64_t epoch, Slapi_ValueSet *values)
+{
+    roles_result_slot *slot = NULL;
+    size_t idx = id % ROLES_RESULT_CACHE_SIZE;
+
+    if (id == 0) {
+        return;
+    }
+    slot = &suffix_def->results[idx];
+
+    slapi_lock_mutex(suffix_def->results_lock[idx % ROLES_RESULT_CACHE_LOCKS]);
+    if ((slot->epoch == epoch) &&
+        (generation == slapi_atomic_load_64(&roles_cache_generation, __ATOMIC_ACQUIRE)) &&
+        (vattr_generation == slapi_vattr_generation())) {
+        roles_result_slot_clear(slot);
+        slot->be = be;
+        slot->id = id;
+        slot->generation = generation;
+        slot->vattr_generation = vattr_generation;
+        slot->version = slapi_ch_strdup(version);
+        if (values) {
+            slot->nsrole_values = slapi_valueset_new();
+            slapi_valueset_set_valueset(slot->nsrole_values, values);
+        }
+    }
+    slapi_unlock_mutex(suffix_def->results_lock[idx % ROLES_RESULT_CACHE_LOCKS]);
+}
+
+/* roles_result_invalidate
+   -----------------------
+   Called when an entry is modified or deleted, drop its nsrole values
+   from the result cache
+ */
+static void
+roles_result_invalidate(Slapi_DN *sdn, Slapi_Entry *entry)
+{
+    roles_cache_def *roles_cache = NULL;
+    unsigned long id = slapi_entry_attr_get_ulong(entry, "entryid");
+    roles_result_slot *slot = NULL;
+    size_t idx = id % ROLES_RESULT_CACHE_SIZE;
+
+    if (id == 0) {
+        return;
+    }
+
+    slapi_rwlock_rdlock(global_lock);
+    if (roles_cache_find_roles_in_suffix(sdn, &roles_cache) == 0) {
+        slot = &roles_cache->results[idx];
+
+        slapi_lock_mutex(roles_cache->results_lock[idx % ROLES_RESULT_CACHE_LOCKS]);
+        /* prevents a result computed on the old entry from being stored */
+        slot->epoch++;
+        if (slot->id == id) {
+            roles_result_slot_clear(slot);
+        }
+        slapi_unlock_mutex(roles_cache->results_lock[idx % ROLES_RESULT_CACHE_LOCKS]);
+    }
+    slapi_rwlock_unlock(global_lock);
+}
+
+/* roles_result_free
+   -----------------
+   Free the result cache of a suffix
+ */
+static void
+roles_result_free(roles_cache_def *suffix_def)
+{
+    if (suffix_def->results) {
+        for (size_t i = 0; i < ROLES_RESULT_CACHE_SIZE; i++) {
+            roles_result_slot_clear(&suffix_def->results[i]);
+        }
+        slapi_ch_free((void **)&suffix_def->results);
+    }
+    for (size_t i = 0; i < ROLES_RESULT_CACHE_LOCKS; i++) {
+        if (suffix_def->results_lock[i]) {
+            slapi_destroy_mutex(suffix_def->results_lock[i]);
+            suffix_def->results_lock[i] = NULL;
+        }
+    }
+}
+
 /* roles_check
    -----------
    Checks if an entry has a presented role, assuming that we've already verified
@@ -2027,6 +2273,7 @@ roles_cache_role_def_free(roles_cache_def *role_def)
     slapi_lock_mutex(role_def->stop_lock);
 
     avl_free(role_def->avl_tree, (IFP)roles_cache_role_object_free);
+    roles_result_free(role_def);
     slapi_sdn_free(&(role_def->suffix_dn));
     slapi_destroy_rwlock(role_def->cache_lock);
     role_def->cache_lock = NULL;
@@ -2077,6 +2324,7 @@ roles_cache_role_object_free(role_object *this_role)
             slapi_filter_free(this_role->filter, 1);
             this_role->filter = NULL;
         }
+        slapi_ch_free_string(&this_role->filter_str);
         break;
     case ROLE_TYPE_NESTED:
         /* Free the list of nested roles */
@@ -2145,6 +2393,107 @@ typedef struct {
     char *attrtype_to;
 } role_substitute_type_arg_t;
 
+/* Structure used to rewrite the nested roles of a role */
+typedef struct _roles_cache_rewrite_nested
+{
+    Slapi_DN **members; /* copies of the dn of the nested roles */
+    size_t count;
+} roles_cache_rewrite_nested_arg;
+
+static int
+roles_cache_rewrite_nested(caddr_t data, caddr_t arg)
+{
+    role_object_nested *nested_role = (role_object_nested *)data;
+    roles_cache_rewrite_nested_arg *nested = (roles_cache_rewrite_nested_arg *)arg;
+
+    nested->members = (Slapi_DN **)slapi_ch_realloc((char *)nested->members,
+                                                    (nested->count + 1) * sizeof(Slapi_DN *));
+    nested->members[nested->count++] = slapi_sdn_dup(nested_role->dn);
+    return 0;
+}
+
+/* roles_cache_rewrite_role
+   ------------------------
+   Build from the roles cache a filter selecting the members of a role:
+     - managed role: (nsRoleDN=<role dn>)
+     - filtered role: the nsRoleFilter of the role
+     - nested role: the union of the filters of its nested roles
+   The caller must hold global_lock, the cache_lock of the suffix of the
+   role is taken here: the definition is copied under that lock and the
+   nested roles are rewritten once it is released.
+   Return NULL if the role is not in the cache, or if the role has no
+   member, in which case *empty is set.
+ */
+static char *
+roles_cache_rewrite_role(Slapi_DN *role_dn, int hint, int *empty)
+{
+    roles_cache_def *roles_cache = NULL;
+    role_object *this_role = NULL;
+    roles_cache_rewrite_nested_arg nested = {NULL, 0};
+    char *filter = NULL;
+    char *members = NULL;
+    char *tmp = NULL;
+    int found = 0;
+
+    *empty = 0;
+    if ((hint > MAX_NESTED_ROLES) ||
+        (roles_cache_find_roles_in_suffix(role_dn, &roles_cache) != 0)) {
+        return NULL;
+    }
+
+    slapi_rwlock_rdlock(roles_cache->cache_lock);
+    this_role = (role_object *)avl_find(roles_cache->avl_tree, role_dn, (IFP)roles_cache_find_node);
+    if (this_role) {
+        found = 1;
+        switch (this_role->type) {
+        case ROLE_TYPE_MANAGED:
+            filter = slapi_filter_escape_filter_value(ROLE_MANAGED_ATTR_NAME,
+                                                      (char *)slapi_sdn_get_dn(this_role->dn));
+            break;
+        case ROLE_TYPE_FILTERED:
+            if (*this_role->filter_str == '(') {
+                filter = slapi_ch_strdup(this_role->filter_str);
+            } else {
+                filter = slapi_ch_smprintf("(%s)", this_role->filter_str);
+            }
+            break;
+        case ROLE_TYPE_NESTED:
+            avl_apply(this_role->avl_tree, (IFP)roles_cache_rewrite_nested, &nested, -1, AVL_INORDER);
+            break;
+        }
+    }
+    slapi_rwlock_unlock(roles_cache->cache_lock);
+
+    if (!found) {
+        return NULL;
+    }
+
+    /* an unknown or empty nested role has no member, skip it */
+    for (size_t i = 0; i < nested.count; i++) {
+        int member_empty;
+        char *member_filter = roles_cache_rewrite_role(nested.members[i], hint + 1, &member_empty);
+
+        if (member_filter) {
+            tmp = members;
+            members = slapi_ch_smprintf("%s%s", tmp ? tmp : "", member_filter);
+            slapi_ch_free_string(&tmp);
+            slapi_ch_free_string(&member_filter);
+        }
+        slapi_sdn_free(&nested.members[i]);
+    }
+    slapi_ch_free((void **)&nested.members);
+
+    if (members) {
+        filter = slapi_ch_smprintf("(|%s)", members);
+        slapi_ch_free_string(&members);
+    }
+    if (filter == NULL) {
+        /* nested role without any member */
+        *empty = 1;
+    }
+    return filter;
+}
+
 
 static void
 _rewrite_nsrole_component(Slapi_Filter *f, role_substitute_type_arg_t *substitute_arg)
@@ -2182,22 +2531,39 @@ _rewrite_nsrole_component(Slapi_Filter *f, role_substitute_type_arg_t *substitut
         return;
     }
     sdn = slapi_sdn_new_dn_byref(bval->bv_val);
+
+    /* The roles cache gives the definition of the role without an internal
+     * search, and allows to rewrite the nested roles as well
+     */
+    if (global_lock) {
+        int empty = 0;
+
+        slapi_rwlock_rdlock(global_lock);
+        rolefilter = roles_cache_rewrite_role(sdn, 0, &empty);
+        slapi_rwlock_unlock(global_lock);
+        if (empty) {
+            /* a role without member: no entry matches this component */
+            rolefilter = slapi_ch_strdup(ROLE_EMPTY_FILTER);
+        }
+        if (rolefilter) {
+            slapi_filter_replace_strfilter(f, rolefilter);
+            slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM, "_rewrite_nsrole_component: replace (%s=%s) by %s\n",
+                          substitute_arg->attrtype_from, (char *)slapi_sdn_get_ndn(sdn), rolefilter);
+            goto bail;
+        }
+    }
+
     rc = slapi_search_internal_get_entry(sdn, attrs, &nsrole_entry, roles_get_plugin_identity());
     if (rc != LDAP_SUCCESS) {
         if (rc == LDAP_NO_SUCH_OBJECT) {
             /* the role does not exist (nsrole=<unknown role>)
-             * that means no entry match this component. To speed up
-             * the built of candidate list we may replace this component
-             * with an indexed component that return empty IDL.
-             * nsuniqueid is indexed and -1 is an invalid value.
+             * that means no entry match this component: replace it with
+             * the empty OR, it builds an empty candidate list and never
+             * matches without looking at an index or at the entry.
              */
-            char *empty_IDL_filter;
-            empty_IDL_filter = slapi_ch_smprintf("(%s=-1)", SLAPI_ATTR_UNIQUEID);
-            slapi_filter_replace_strfilter(f, empty_IDL_filter);
+            slapi_filter_replace_strfilter(f, (char *)ROLE_EMPTY_FILTER);
             slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM, "_rewrite_nsrole_component: replace (%s=%s) by %s\n",
-                          substitute_arg->attrtype_from, (char *)slapi_sdn_get_ndn(sdn), empty_IDL_filter);
-            slapi_ch_free_string(&empty_IDL_filter);
-
+                          substitute_arg->attrtype_from, (char *)slapi_sdn_get_ndn(sdn), ROLE_EMPTY_FILTER);
         }
         goto bail;
     }
@@ -2288,7 +2654,8 @@ role_substitute_type(Slapi_Filter *f, void *arg)
  * The role rewriter supports:
  *   - 'nsrole' attribute type
  *   - LDAP_FILTER_EQUALITY filter choice
- *   - assertion being a managed/filtered role DN
+ *   - assertion being a managed/filtered/nested role DN
+ *     (a nested role is replaced by the union of its nested roles)
  *
  *   - Input  '(nsrole=cn=admin1,dc=example,dc=com)'
  *     Output '(nsroleDN=cn=admin1,dc=example,dc=com)'
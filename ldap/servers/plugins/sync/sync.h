@@ -70,6 +70,9 @@ typedef struct sync_callback
     unsigned long change_start;
     int cb_err;
     Sync_UpdateNode *cb_updates;
+    int cb_nupdates;       /* nodes used in cb_updates */
+    int cb_maxupdates;     /* nodes allocated in cb_updates */
+    PLHashTable *cb_uuids; /* nsuniqueid -> index in cb_updates + 1 */
     PRBool openldap_compat;
 } Sync_CallBackData;
 
@@ -139,6 +142,7 @@ Sync_Cookie *sync_cookie_create(Slapi_PBlock *pb, Sync_Cookie *client_cookie);
 void sync_cookie_update(Sync_Cookie *cookie, Slapi_Entry *ec);
 Sync_Cookie *sync_cookie_parse(char *cookie, PRBool *cookie_refresh, PRBool *allow_openldap_compat);
 int sync_cookie_isvalid(Sync_Cookie *testcookie, Sync_Cookie *refcookie);
+int sync_cookie_state_available(Sync_Cookie *testcookie, Sync_Cookie *refcookie);
 void sync_cookie_free(Sync_Cookie **freecookie);
 char *sync_cookie2str(Sync_Cookie *cookie);
 int sync_number2int(char *nrstr);
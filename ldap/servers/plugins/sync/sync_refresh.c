@@ -16,7 +16,7 @@ static PRBool allow_openldap_compat;
 
 static SyncOpInfo *sync_get_operation_extension(Slapi_PBlock *pb);
 static void sync_set_operation_extension(Slapi_PBlock *pb, SyncOpInfo *spec);
-static int sync_find_ref_by_uuid(Sync_UpdateNode *updates, int stop, char *uniqueid);
+static int sync_find_ref_by_uuid(Sync_CallBackData *cb, char *uniqueid);
 static void sync_free_update_nodes(Sync_UpdateNode **updates, int count);
 Slapi_Entry *sync_deleted_entry_from_changelog(Slapi_Entry *cl_entry);
 static int sync_feature_allowed(Slapi_PBlock *pb);
@@ -143,9 +143,17 @@ sync_srch_refresh_pre_search(Slapi_PBlock *pb)
              * 1. no cookie is provided this means send all entries matching the search request
              * 2. a cookie is provided: send all entries changed since the cookie was issued
              *     -- return an error if the cookie is invalid
-             *     -- return e-syncRefreshRequired if the data referenced in the cookie are no
-             *         longer in the history
+             *     -- if the changes following the cookie were trimmed from the retro
+             *         changelog, send all entries matching the search request as in 1.
             */
+            if (!cookie_refresh && sync_cookie_isvalid(client_cookie, session_cookie) &&
+                !sync_cookie_state_available(client_cookie, session_cookie)) {
+                slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM,
+                              "sync_srch_refresh_pre_search - changes following cookie state %lu "
+                              "were trimmed from the changelog, sending the full content\n",
+                              client_cookie->cookie_change_info);
+                cookie_refresh = PR_TRUE;
+            }
             if (!cookie_refresh) {
                 if (sync_cookie_isvalid(client_cookie, session_cookie)) {
                     rc = sync_refresh_update_content(pb, client_cookie, session_cookie);
@@ -179,7 +187,8 @@ sync_srch_refresh_pre_search(Slapi_PBlock *pb)
                 Slapi_Operation *operation;
 
                 slapi_pblock_get(pb, SLAPI_OPERATION, &operation);
-                if (client_cookie) {
+                if (client_cookie && !cookie_refresh) {
+                    /* else started once the initial content is sent */
                     rc = sync_persist_startup(tid, session_cookie);
                 }
                 if (rc == 0) {
@@ -343,10 +352,13 @@ sync_refresh_update_content(Slapi_PBlock *pb, Sync_Cookie *client_cookie, Sync_C
         return rc;
     }
 
-    int chg_count = (server_cookie->cookie_change_info - client_cookie->cookie_change_info) + 1;
-    PR_ASSERT(chg_count > 0);
-
-    cb_data.cb_updates = (Sync_UpdateNode *)slapi_ch_calloc(chg_count, sizeof(Sync_UpdateNode));
+    /*
+     * Only the entries changed since the cookie are collected, once each:
+     * a client coming back after a while does not search its whole scope.
+     */
+    memset(&cb_data, 0, sizeof(cb_data));
+    cb_data.cb_uuids = PL_NewHashTable(0, PL_HashString, PL_CompareStrings,
+                                       PL_CompareValues, NULL, NULL);
 
     seq_pb = slapi_pblock_new();
     slapi_pblock_init(seq_pb);
@@ -400,10 +412,11 @@ sync_refresh_update_content(Slapi_PBlock *pb, Sync_Cookie *client_cookie, Sync_C
     /* Now send the deleted entries in a sync info message
      * and the modified entries as single entries
      */
-    sync_send_deleted_entries(pb, cb_data.cb_updates, chg_count, server_cookie);
-    sync_send_modified_entries(pb, cb_data.cb_updates, chg_count, server_cookie);
+    sync_send_deleted_entries(pb, cb_data.cb_updates, cb_data.cb_nupdates, server_cookie);
+    sync_send_modified_entries(pb, cb_data.cb_updates, cb_data.cb_nupdates, server_cookie);
 
-    sync_free_update_nodes(&cb_data.cb_updates, chg_count);
+    PL_HashTableDestroy(cb_data.cb_uuids);
+    sync_free_update_nodes(&cb_data.cb_updates, cb_data.cb_nupdates);
     slapi_ch_free((void **)&filter);
     return (rc);
 }
@@ -507,18 +520,71 @@ sync_get_attr_value_from_entry(Slapi_Entry *cl_entry, char *attrtype)
     return (strvalue);
 }
 
+/*
+ * Index of the update of an entry, or -1 if it has none yet
+ */
 static int
-sync_find_ref_by_uuid(Sync_UpdateNode *updates, int stop, char *uniqueid)
+sync_find_ref_by_uuid(Sync_CallBackData *cb, char *uniqueid)
 {
-    int rc = -1;
-    int i;
-    for (i = 0; i < stop; i++) {
-        if (updates[i].upd_uuid && (0 == strcmp(uniqueid, updates[i].upd_uuid))) {
-            rc = i;
-            break;
-        }
+    intptr_t ref = (intptr_t)PL_HashTableLookup(cb->cb_uuids, uniqueid);
+
+    return ((int)ref - 1);
+}
+
+/*
+ * Append the update of an entry, the update takes the uuids
+ */
+static int
+sync_add_update(Sync_CallBackData *cb, int chgtype, char *uniqueid, char *entryuuid)
+{
+    Sync_UpdateNode *upd;
+
+    if (cb->cb_nupdates == cb->cb_maxupdates) {
+        cb->cb_maxupdates = cb->cb_maxupdates ? 2 * cb->cb_maxupdates : 64;
+        cb->cb_updates = (Sync_UpdateNode *)slapi_ch_realloc((char *)cb->cb_updates,
+                                                             cb->cb_maxupdates * sizeof(Sync_UpdateNode));
     }
-    return (rc);
+    upd = &cb->cb_updates[cb->cb_nupdates];
+    upd->upd_chgtype = chgtype;
+    upd->upd_uuid = uniqueid;
+    upd->upd_euuid = entryuuid;
+    upd->upd_e = NULL;
+    PL_HashTableAdd(cb->cb_uuids, upd->upd_uuid, (void *)(intptr_t)(cb->cb_nupdates + 1));
+
+    return (cb->cb_nupdates++);
+}
+
+/*
+ * The changes cancel each other, nothing is sent for the entry
+ */
+static void
+sync_cancel_update(Sync_CallBackData *cb, int index)
+{
+    Sync_UpdateNode *upd = &cb->cb_updates[index];
+
+    PL_HashTableRemove(cb->cb_uuids, upd->upd_uuid);
+    slapi_ch_free_string(&upd->upd_uuid);
+    slapi_ch_free_string(&upd->upd_euuid);
+    if (upd->upd_e) {
+        slapi_entry_free(upd->upd_e);
+        upd->upd_e = NULL;
+    }
+    upd->upd_chgtype = 0;
+}
+
+/*
+ * The entry was deleted, or moved out of scope
+ */
+static void
+sync_delete_update(Sync_CallBackData *cb, int index, Slapi_Entry *cl_entry)
+{
+    Sync_UpdateNode *upd = &cb->cb_updates[index];
+
+    upd->upd_chgtype = LDAP_REQ_DELETE;
+    if (upd->upd_e) {
+        slapi_entry_free(upd->upd_e);
+    }
+    upd->upd_e = sync_deleted_entry_from_changelog(cl_entry);
 }
 
 static int
@@ -566,7 +632,6 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
     char *chgnr = NULL;
     int chg_req;
     int prev = 0;
-    int index = 0;
     unsigned long chgnum = 0;
     Sync_CallBackData *cb = (Sync_CallBackData *)cb_data;
 
@@ -613,48 +678,43 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
         slapi_ch_free_string(&entryuuid);
         return (1);
     }
-    index = chgnum - cb->change_start;
     chgtype = sync_get_attr_value_from_entry(cl_entry, CL_ATTR_CHGTYPE);
     chg_req = sync_str2chgreq(chgtype);
+    prev = sync_find_ref_by_uuid(cb, uniqueid);
     switch (chg_req) {
     case LDAP_REQ_ADD:
         slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_ADD\n", uniqueid);
-        /* nsuniqueid cannot exist, just add reference */
-        cb->cb_updates[index].upd_chgtype = LDAP_REQ_ADD;
-        cb->cb_updates[index].upd_uuid = uniqueid;
-        cb->cb_updates[index].upd_euuid = entryuuid;
+        if (prev != -1) {
+            /* the uniqueid of a deleted entry is reused, keep the last change */
+            sync_cancel_update(cb, prev);
+        }
+        sync_add_update(cb, LDAP_REQ_ADD, uniqueid, entryuuid);
         break;
     case LDAP_REQ_MODIFY:
         /* check if we have seen this uuid already */
-        prev = sync_find_ref_by_uuid(cb->cb_updates, index, uniqueid);
         if (prev == -1) {
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODIFY\n", uniqueid);
-            cb->cb_updates[index].upd_chgtype = LDAP_REQ_MODIFY;
-            cb->cb_updates[index].upd_uuid = uniqueid;
-            cb->cb_updates[index].upd_euuid = entryuuid;
+            sync_add_update(cb, LDAP_REQ_MODIFY, uniqueid, entryuuid);
         } else {
             /* was add or mod, keep it */
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODIFY (already queued)\n", uniqueid);
-            cb->cb_updates[index].upd_uuid = NULL;
-            cb->cb_updates[index].upd_euuid = NULL;
-            cb->cb_updates[index].upd_chgtype = 0;
             slapi_ch_free_string(&uniqueid);
             slapi_ch_free_string(&entryuuid);
         }
         break;
     case LDAP_REQ_MODRDN: {
         /* if it is a modrdn, we finally need to decide if this will
-                 * trigger a present or delete state, keep the info that
-                 * the entry was subject to a modrdn
-                 */
+         * trigger a present or delete state, keep the info that
+         * the entry was subject to a modrdn
+         */
         int new_scope = 0;
         int old_scope = 0;
         Slapi_DN *original_dn;
         char *newsuperior = sync_get_attr_value_from_entry(cl_entry, CL_ATTR_NEWSUPERIOR);
         char *entrydn = sync_get_attr_value_from_entry(cl_entry, CL_ATTR_ENTRYDN);
         /* if newsuperior is set we need to checkif the entry has been moved into
-             * or moved out of the scope of the synchronization request
-             */
+         * or moved out of the scope of the synchronization request
+         */
         original_dn = slapi_sdn_new_dn_byref(entrydn);
         old_scope = sync_is_active_scope(original_dn, cb->orig_pb);
         slapi_sdn_free(&original_dn);
@@ -669,19 +729,13 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
             /* scope didn't change */
             new_scope = old_scope;
         }
-        prev = sync_find_ref_by_uuid(cb->cb_updates, index, uniqueid);
         if (old_scope && new_scope) {
             /* nothing changed, it's just a MOD */
             if (prev == -1) {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN\n", uniqueid);
-                cb->cb_updates[index].upd_chgtype = LDAP_REQ_MODIFY;
-                cb->cb_updates[index].upd_uuid = uniqueid;
-                cb->cb_updates[index].upd_euuid = entryuuid;
+                sync_add_update(cb, LDAP_REQ_MODIFY, uniqueid, entryuuid);
             } else {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN (already queued)\n", uniqueid);
-                cb->cb_updates[index].upd_uuid = NULL;
-                cb->cb_updates[index].upd_euuid = NULL;
-                cb->cb_updates[index].upd_chgtype = 0;
                 slapi_ch_free_string(&uniqueid);
                 slapi_ch_free_string(&entryuuid);
             }
@@ -689,57 +743,51 @@ sync_read_entry_from_changelog(Slapi_Entry *cl_entry, void *cb_data)
             /* it was moved out of scope, handle as DEL */
             if (prev == -1) {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN -> LDAP_REQ_DELETE\n", uniqueid);
-                cb->cb_updates[index].upd_chgtype = LDAP_REQ_DELETE;
-                cb->cb_updates[index].upd_uuid = uniqueid;
-                cb->cb_updates[index].upd_euuid = entryuuid;
-                cb->cb_updates[index].upd_e = sync_deleted_entry_from_changelog(cl_entry);
+                prev = sync_add_update(cb, LDAP_REQ_DELETE, uniqueid, entryuuid);
             } else {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN -> LDAP_REQ_DELETE (already queued)\n", uniqueid);
-                cb->cb_updates[prev].upd_chgtype = LDAP_REQ_DELETE;
-                cb->cb_updates[prev].upd_e = sync_deleted_entry_from_changelog(cl_entry);
                 slapi_ch_free_string(&uniqueid);
                 slapi_ch_free_string(&entryuuid);
             }
+            sync_delete_update(cb, prev, cl_entry);
         } else if (new_scope) {
             /* moved into scope, handle as ADD */
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_MODRDN -> LDAP_REQ_ADD\n", uniqueid);
-            cb->cb_updates[index].upd_chgtype = LDAP_REQ_ADD;
-            cb->cb_updates[index].upd_uuid = uniqueid;
-            cb->cb_updates[index].upd_euuid = entryuuid;
+            if (prev == -1) {
+                sync_add_update(cb, LDAP_REQ_ADD, uniqueid, entryuuid);
+            } else {
+                /* moved out, then back in */
+                cb->cb_updates[prev].upd_chgtype = LDAP_REQ_ADD;
+                if (cb->cb_updates[prev].upd_e) {
+                    slapi_entry_free(cb->cb_updates[prev].upd_e);
+                    cb->cb_updates[prev].upd_e = NULL;
+                }
+                slapi_ch_free_string(&uniqueid);
+                slapi_ch_free_string(&entryuuid);
+            }
         } else {
             /* nothing to do */
             slapi_ch_free_string(&uniqueid);
             slapi_ch_free_string(&entryuuid);
         }
-        slapi_sdn_free(&original_dn);
         break;
     }
     case LDAP_REQ_DELETE:
         /* check if we have seen this uuid already */
-        prev = sync_find_ref_by_uuid(cb->cb_updates, index, uniqueid);
         if (prev == -1) {
             slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_DELETE\n", uniqueid);
-            cb->cb_updates[index].upd_chgtype = LDAP_REQ_DELETE;
-            cb->cb_updates[index].upd_uuid = uniqueid;
-            cb->cb_updates[index].upd_euuid = entryuuid;
-            cb->cb_updates[index].upd_e = sync_deleted_entry_from_changelog(cl_entry);
+            prev = sync_add_update(cb, LDAP_REQ_DELETE, uniqueid, entryuuid);
+            sync_delete_update(cb, prev, cl_entry);
         } else {
             /* if it was added since last cookie state, we
              * can ignore it */
             if (cb->cb_updates[prev].upd_chgtype == LDAP_REQ_ADD) {
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_DELETE -> NO-OP\n", uniqueid);
-                slapi_ch_free_string(&(cb->cb_updates[prev].upd_uuid));
-                cb->cb_updates[prev].upd_uuid = NULL;
-                cb->cb_updates[prev].upd_euuid = NULL;
-                cb->cb_updates[index].upd_uuid = NULL;
-                cb->cb_updates[index].upd_euuid = NULL;
+                sync_cancel_update(cb, prev);
             } else {
                 /* ignore previous mod */
                 slapi_log_err(SLAPI_LOG_PLUGIN, SYNC_PLUGIN_SUBSYSTEM, "sync_read_entry_from_changelog - %s LDAP_REQ_DELETE (already queued, updating)\n", uniqueid);
-                cb->cb_updates[index].upd_uuid = NULL;
-                cb->cb_updates[index].upd_euuid = NULL;
-                cb->cb_updates[prev].upd_chgtype = LDAP_REQ_DELETE;
-                cb->cb_updates[prev].upd_e = sync_deleted_entry_from_changelog(cl_entry);
+                sync_delete_update(cb, prev, cl_entry);
             }
             slapi_ch_free_string(&uniqueid);
             slapi_ch_free_string(&entryuuid);
@@ -589,8 +589,12 @@ sync_cookie_get_change_number(int lastnr, const char *uniqueid)
     return (newnr);
 }
 
+/*
+ * Read the first (SLAPI_SEQ_FIRST) or last (SLAPI_SEQ_LAST) change number
+ * of the retro changelog into scbd->changenr.
+ */
 static int
-sync_cookie_get_change_info(Sync_CallBackData *scbd)
+sync_cookie_get_change_info(Sync_CallBackData *scbd, int type)
 {
     Slapi_PBlock *seq_pb;
     char *base;
@@ -603,7 +607,7 @@ sync_cookie_get_change_info(Sync_CallBackData *scbd)
     seq_pb = slapi_pblock_new();
     slapi_pblock_init(seq_pb);
 
-    slapi_seq_internal_set_pb(seq_pb, base, SLAPI_SEQ_LAST, attrname, NULL, NULL, 0, 0,
+    slapi_seq_internal_set_pb(seq_pb, base, type, attrname, NULL, NULL, 0, 0,
                               plugin_get_default_component_id(), 0);
 
     rc = slapi_seq_internal_callback_pb(seq_pb, scbd, NULL, sync_handle_cnum_entry, NULL);
@@ -623,7 +627,7 @@ sync_cookie_create(Slapi_PBlock *pb, Sync_Cookie *client_cookie)
     Sync_Cookie *sc = (Sync_Cookie *)slapi_ch_calloc(1, sizeof(Sync_Cookie));
 
     scbd.cb_err = SYNC_CALLBACK_PREINIT;
-    rc = sync_cookie_get_change_info(&scbd);
+    rc = sync_cookie_get_change_info(&scbd, SLAPI_SEQ_LAST);
 
     if (rc == 0) {
         /* If the client is in openldap compat, we need to generate the same. */
@@ -811,12 +815,35 @@ sync_cookie_isvalid(Sync_Cookie *testcookie, Sync_Cookie *refcookie)
             return 0;
         }
     }
-    /* could add an additional check if the requested state in client cookie is still
-     * available. Accept any state request for now.
+    /* whether the requested state is still in the retro changelog is
+     * checked by sync_cookie_state_available()
      */
     return 1;
 }
 
+/*
+ * Are the changes following the state of a valid client cookie still in
+ * the retro changelog?  If the oldest ones were trimmed, the client can
+ * only be brought up to date by a full refresh.
+ */
+int
+sync_cookie_state_available(Sync_Cookie *testcookie, Sync_Cookie *refcookie)
+{
+    Sync_CallBackData scbd = {0};
+
+    if (testcookie->cookie_change_info >= refcookie->cookie_change_info) {
+        /* nothing changed since the cookie */
+        return 1;
+    }
+
+    scbd.cb_err = SYNC_CALLBACK_PREINIT;
+    if (sync_cookie_get_change_info(&scbd, SLAPI_SEQ_FIRST) != 0 ||
+        scbd.cb_err == SYNC_CALLBACK_PREINIT) {
+        return 0;
+    }
+    return (scbd.changenr <= testcookie->cookie_change_info + 1);
+}
+
 void
 sync_cookie_free(Sync_Cookie **freecookie)
 {
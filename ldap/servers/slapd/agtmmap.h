@@ -138,12 +138,31 @@ struct int_stats_t
     char dsURL[SNMP_FIELD_LENGTH];
 };
 
+/*
+ * Latency percentiles, in microseconds, of one operation type:
+ * bind, search base, search one level, search subtree, add, modify,
+ * delete, modrdn, compare and extended operations, in that order.
+ */
+#define NUM_SNMP_LATENCY_OPS 10
+
+struct latency_stats_t
+{
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
 struct agt_stats_t
 {
     struct hdr_stats_t hdr_stats;
     struct ops_stats_t ops_stats;
     struct entries_stats_t entries_stats;
     struct int_stats_t int_stats[NUM_SNMP_INT_TBL_ROWS];
+    struct latency_stats_t wtime_stats[NUM_SNMP_LATENCY_OPS];
+    struct latency_stats_t optime_stats[NUM_SNMP_LATENCY_OPS];
 };
 
 extern agt_mmap_context_t mmap_tbl[];
@@ -265,6 +265,8 @@ ldbm_back_ldbm2archive(Slapi_PBlock *pb)
     char *rawdirectory = NULL; /* -a <directory> */
     char *directory = NULL;    /* normalized */
     char *dir_bak = NULL;
+    char *rawbasedirectory = NULL; /* full backup to compare with */
+    char *base_directory = NULL;
     int return_value = -1;
     int task_flags = 0;
     int run_from_cmdline = 0;
@@ -277,11 +279,21 @@ ldbm_back_ldbm2archive(Slapi_PBlock *pb)
     li->li_flags = run_from_cmdline = (task_flags & SLAPI_TASK_RUNNING_FROM_COMMANDLINE);
 
     slapi_pblock_get(pb, SLAPI_BACKEND_TASK, &task);
+    slapi_pblock_get(pb, SLAPI_DB2ARCHIVE_BASE_DIR, &rawbasedirectory);
 
     if (!rawdirectory || !*rawdirectory) {
         slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_ldbm2archive", "No archive name\n");
         return -1;
     }
+    if (rawbasedirectory && *rawbasedirectory &&
+        (!li->li_backend_implement || strcasecmp(li->li_backend_implement, "mdb") != 0)) {
+        slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_ldbm2archive",
+                      "Incremental backups are only supported with the mdb database.\n");
+        if (task) {
+            slapi_task_log_notice(task, "Incremental backups are only supported with the mdb database.");
+        }
+        return -1;
+    }
 
     /* start the database code up, do not attempt to perform recovery */
     if (run_from_cmdline) {
@@ -309,6 +321,19 @@ ldbm_back_ldbm2archive(Slapi_PBlock *pb)
 
     /* Initialize directory */
     directory = rel2abspath(rawdirectory);
+    if (rawbasedirectory && *rawbasedirectory) {
+        base_directory = rel2abspath(rawbasedirectory);
+        if (slapd_comp_path(base_directory, directory) == 0) {
+            slapi_log_err(SLAPI_LOG_ERR,
+                          "ldbm_back_ldbm2archive", "Cannot archive to the directory of the base backup.\n");
+            if (task) {
+                slapi_task_log_notice(task,
+                                      "Cannot archive to the directory of the base backup.");
+            }
+            return_value = -1;
+            goto out;
+        }
+    }
 
     if (stat(directory, &sbuf) == 0) {
         if (slapd_comp_path(directory, li->li_directory) == 0) {
@@ -420,7 +445,9 @@ ldbm_back_ldbm2archive(Slapi_PBlock *pb)
     }
 
     /* tell it to archive */
+    li->li_backup_base_dir = base_directory;
     return_value = dblayer_backup(li, directory, task);
+    li->li_backup_base_dir = NULL;
     if (return_value) {
         slapi_log_err(SLAPI_LOG_BACKLDBM,
                       "ldbm_back_ldbm2archive", "dblayer_backup failed (%d).\n", return_value);
@@ -488,6 +515,7 @@ out:
 
     slapi_ch_free_string(&dir_bak);
     slapi_ch_free_string(&directory);
+    slapi_ch_free_string(&base_directory);
     return return_value;
 }
 
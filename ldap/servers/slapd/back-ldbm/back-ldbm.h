@@ -148,6 +148,8 @@ typedef unsigned short u_int16_t;
 #define DEFAULT_DNCACHE_SIZE     (uint64_t)16777216
 #define DEFAULT_DNCACHE_SIZE_STR "16777216"
 #define DEFAULT_DNCACHE_MAXCOUNT -1 /* no limit */
+#define DEFAULT_DNTREE_SIZE      (uint64_t)8388608
+#define DEFAULT_DNTREE_SIZE_STR  "8388608"
 #define DEFAULT_DBCACHE_SIZE     33554432
 #define DEFAULT_DBCACHE_SIZE_STR "33554432"
 #define DEFAULT_DBLOCK_PAUSE     500
@@ -176,6 +178,7 @@ extern int ldbm_warn_if_no_db;
 #define EQ_PREFIX     '='  /* prefix for equality keys     */
 #define APPROX_PREFIX '~'  /* prefix for approx keys       */
 #define SUB_PREFIX    '*'  /* prefix for substring keys    */
+#define SUBPOS_PREFIX '%'  /* prefix for positional substring keys */
 #define CONT_PREFIX   '\\' /* prefix for continuation keys */
 #define RULE_PREFIX   ':'  /* prefix for matchingRule keys */
 #define PRES_PREFIX   '+'
@@ -225,6 +228,12 @@ typedef u_int32_t ID;
 #define NEW_IDL_NO_ALLID 2 /* force to return full idl (no allids) */
 #define NEW_IDL_DEFAULT  0
 
+/*
+ * special results of idl_estimate / index_estimate
+ */
+#define IDL_ESTIMATE_ALLIDS  UINT64_MAX       /* the lookup would return allids */
+#define IDL_ESTIMATE_UNKNOWN (UINT64_MAX - 1) /* no cheap way to tell */
+
 /*
  * if the id of any backend instance is above the threshold, then warning
  * message will be logged about the need of rebuilding the database in question
@@ -319,6 +328,9 @@ struct backcommon
 #define ENTRY_STATE_CREATING   0x2  /* entry is being created; don't touch it */
 #define ENTRY_STATE_NOTINCACHE 0x4  /* cache_add failed; not in the cache */
 #define ENTRY_STATE_INVALID    0x8  /* cache entry is invalid and needs to be removed */
+    uint8_t ep_lruflags;            /* replacement policy state (entry cache) */
+#define ENTRY_LRU_PROTECTED    0x1  /* entry belongs to the protected LRU segment */
+#define ENTRY_LRU_PREFETCHED   0x2  /* read ahead, its first hit is already counted */
     int32_t ep_refcnt;              /* entry reference cnt */
     size_t ep_size;                 /* for cache tracking */
     struct timespec ep_create_time; /* the time the entry was added to the cache */
@@ -332,6 +344,7 @@ struct backentry
     struct backcommon *ep_lruprev;  /* for the cache */
     ID ep_id;                       /* entry id */
     uint8_t ep_state;               /* state in the cache */
+    uint8_t ep_lruflags;            /* replacement policy state */
     int32_t ep_refcnt;              /* entry reference cnt */
     size_t ep_size;                 /* for cache tracking */
     struct timespec ep_create_time; /* the time the entry was added to the cache */
@@ -351,6 +364,7 @@ struct backdn
     struct backcommon *ep_lruprev;  /* for the cache */
     ID ep_id;                       /* entry id */
     uint8_t ep_state;               /* state in the cache; share ENTRY_STATE_* */
+    uint8_t ep_lruflags;            /* unused, the dn cache is a plain LRU */
     int32_t ep_refcnt;              /* entry reference cnt */
     uint64_t ep_size;               /* for cache tracking */
     struct timespec ep_create_time; /* the time the entry was added to the cache */
@@ -374,12 +388,24 @@ struct cache
     Slapi_Counter *c_tries;
     struct backcommon *c_lruhead; /* add entries here */
     struct backcommon *c_lrutail; /* remove entries here */
+    /* The entry cache is a segmented LRU: entries start on the probation
+     * list above and move to the protected list once they are seen again.
+     * A frequency sketch of the recently accessed ids decides promotion
+     * and admission, see cache.c */
+    struct backcommon *c_prothead;
+    struct backcommon *c_prottail;
+    uint64_t c_protsize;    /* bytes on the protected list */
+    uint64_t c_protentries; /* entries on the protected list */
+    uint8_t *c_freq;        /* frequency sketch counters */
+    uint64_t c_freqmask;
+    uint64_t c_freqops;     /* increments since the sketch was last aged */
     PRMonitor *c_mutex;           /* lock for cache operations */
     PRLock *c_emutexalloc_mutex;
 };
 
 #define CACHE_ADD(cache, p, a) cache_add((cache), (void *)(p), (void **)(a))
 #define CACHE_RETURN(cache, p) cache_return((cache), (void **)(p))
+#define CACHE_RETURN_SCAN(cache, p) cache_return_scan((cache), (void **)(p))
 #define CACHE_REMOVE(cache, p) cache_remove((cache), (void *)(p))
 #define CACHE_LOCK(cache)      cache_lock((cache))
 #define CACHE_UNLOCK(cache)    cache_unlock((cache))
@@ -452,11 +478,16 @@ struct attrinfo
 #define INDEX_RULES     0x40
 #define INDEX_VLV       0x80
 #define INDEX_SUBTREE  0x100
-#define INDEX_ANY (INDEX_PRESENCE | INDEX_EQUALITY | INDEX_APPROX | INDEX_SUB | INDEX_RULES | INDEX_VLV | INDEX_SUBTREE)
+#define INDEX_SUBPOS   0x200
+#define INDEX_ANY (INDEX_PRESENCE | INDEX_EQUALITY | INDEX_APPROX | INDEX_SUB | INDEX_RULES | INDEX_VLV | INDEX_SUBTREE | INDEX_SUBPOS)
 
 #define INDEX_OFFLINE 0x1000 /* index is being generated, or     \
                               * has been created but not indexed \
                               * yet. */
+#define INDEX_SUBPOS_OFFLINE 0x2000 /* subpos was added to an existing \
+                                     * index and its keys are not     \
+                                     * generated yet: substring       \
+                                     * lookups keep using "sub". */
 
 #define IS_INDEXED(a) (a & INDEX_ANY)
     char **ai_index_rules;               /* matching rule OIDs */
@@ -492,6 +523,10 @@ struct attrinfo
                              */
     Slapi_Attr ai_sattr;                 /* interface to syntax and matching rule plugins */
     DataList *ai_idlistinfo;             /* fine grained id list */
+    struct attrinfo *ai_shadow;          /* index being rebuilt online side by side
+                                          * (see dbmdb_online_reindex) */
+    ID ai_shadow_next_id;                /* entries below this id are already in the
+                                          * shadow index and must be kept up to date */
 };
 
 struct id_array
@@ -568,6 +603,7 @@ struct ldbminfo
     dblayer_private *li_dblayer_private; /* session ptr for databases */
     void *li_dblayer_config;             /* pointer to specific backend implementation */
     char *li_backend_implement;          /* low layer backend implementation */
+    char *li_backup_base_dir;            /* backup the running db2archive is based on (incremental backup) */
     int li_noparentcheck;                /* check if parent exists on add */
 
     /* db lock monitoring */
@@ -636,6 +672,13 @@ struct ldbminfo
 #define BACKEND_OPT_MANAGE_ENTRY_BEFORE_DBLOCK 0x04
     int li_backend_opt_level;
     size_t li_max_key_len;
+    int li_search_prefetch_depth; /* candidates read ahead by a search (0 = off) */
+    int li_cache_preload;         /* save the hot cache ids and reload them at startup */
+    int li_cache_preload_rate;    /* entries per second loaded at startup (0 = no limit) */
+    int li_cache_snapshot_interval; /* seconds between cache snapshots (0 = at shutdown only) */
+    Slapi_Eq_Context li_cache_snapshot_ctx;
+    int li_filter_cost_optimizer; /* order AND/OR components by estimated cost */
+    int li_export_threads;        /* db2ldif formatting threads (0 = auto, 1 = sequential) */
 };
 
 
@@ -786,8 +829,31 @@ typedef struct ldbm_instance
     int require_index;               /* set to 1 to require an index be used in search */
     int require_internalop_index;    /* set to 1 to require an index be used in an internal search */
     struct cache inst_dncache;       /* The dn cache for this instance. */
+    PRThread *inst_preload_tid;      /* warms up the caches at startup */
+    int32_t inst_preload_state;      /* see cache_snapshot.c */
+    uint64_t inst_preload_loaded;    /* ids loaded so far */
+    uint64_t inst_preload_total;     /* ids found in the snapshot */
+    uint64_t inst_prefetch_loaded;   /* entries read ahead, see prefetch.c */
+    struct dntree *inst_dntree;      /* cache of the entryrdn tree, see dntree.c */
 } ldbm_instance;
 
+/* Nodes read from the entryrdn index, to be added to the DN tree (dntree.c) */
+typedef struct _dntree_batch dntree_batch;
+
+/* Ordered, parallel db2ldif output (export.c) */
+typedef struct _export_pipeline export_pipeline;
+typedef char *(*export_format_fn)(void *arg, struct backentry *ep, int *len);
+typedef void (*export_progress_fn)(void *arg, int cnt, int percent);
+
+/* Read ahead state of a search result set (prefetch.c) */
+typedef struct _ldbm_prefetch ldbm_prefetch;
+
+/* Sort keys of the candidates left unsorted by a top-K sort (sort.c) */
+typedef struct _ldbm_sort_keys ldbm_sort_keys;
+
+/* Candidates of a parked paged results cursor (ldbm_search.c) */
+typedef struct _ldbm_packed_candidates ldbm_packed_candidates;
+
 /*
  * This structure is passed through the PBlock from ldbm_back_search to
  * ldbm_back_next_search_entry.  It contains the candidate result set
@@ -806,8 +872,12 @@ typedef struct _back_search_result_set
     int sr_current_sizelimit;     /* Current sizelimit */
     Slapi_Filter *sr_norm_filter; /* search filter pre-normalized */
     Slapi_Filter *sr_norm_filter_intent; /* intended search filter pre-normalized */
+    ldbm_prefetch *sr_prefetch;          /* entries being read ahead, see prefetch.c */
+    ldbm_sort_keys *sr_sort_tail;        /* candidates not sorted yet, see sort.c */
+    ldbm_packed_candidates *sr_packed;   /* sr_candidates while a paged cursor is parked */
 } back_search_result_set;
 #define SR_FLAG_MUST_APPLY_FILTER_TEST 1 /* If set in sr_flags, means that we MUST apply the filter test */
+#define SR_FLAG_SCAN 2                   /* entries are returned to the cache with CACHE_RETURN_SCAN */
 
 #include "proto-back-ldbm.h"
 #include "ldbm_config.h"
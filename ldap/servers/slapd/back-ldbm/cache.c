@@ -68,11 +68,34 @@ typedef enum {
 #define BACK_LRU_NEXT(entry, type) ((type)((entry)->ep_lrunext))
 #define BACK_LRU_PREV(entry, type) ((type)((entry)->ep_lruprev))
 
+/*
+ * The entry cache replacement policy is a segmented LRU with a TinyLFU
+ * style admission.  Entries enter the probation list (c_lruhead) and are
+ * moved to the protected list (c_prothead) once they have been accessed
+ * CACHE_FREQ_PROMOTE times.  Eviction takes the probation tail first, so
+ * a large scan only churns the probation list and leaves the working set
+ * alone.  The access counts live in a small count-min sketch keyed by
+ * entry id: it remembers entries after they have been evicted and is
+ * periodically aged so that old popularity fades away.
+ */
+#define CACHE_PROTECTED_PCT 80 /* share of the cache given to the protected list */
+#define CACHE_FREQ_PROMOTE 2   /* accesses needed to enter the protected list */
+#define CACHE_FREQ_MAX 15      /* sketch counters saturate here */
+#define CACHE_FREQ_ROWS 4
+#define CACHE_FREQ_MIN_COUNTERS 1024
+#define CACHE_FREQ_MAX_COUNTERS (1UL << 22)
+#define CACHE_FREQ_AGING 10 /* halve the counters every AGING * counters accesses */
+
+/* hints given when the last reference to an entry is returned */
+#define CACHE_HINT_NONE 0
+#define CACHE_HINT_SCAN 1     /* read by a scan: never promote, evict first */
+#define CACHE_HINT_PREFETCH 2 /* read ahead: the access is already counted */
+
 /* static functions */
 static void entrycache_clear_int(struct cache *cache);
 static void entrycache_set_max_size(struct cache *cache, uint64_t bytes);
 static int entrycache_remove_int(struct cache *cache, struct backentry *e);
-static void entrycache_return(struct cache *cache, struct backentry **bep, PRBool locked);
+static void entrycache_return(struct cache *cache, struct backentry **bep, PRBool locked, int hint);
 static int entrycache_replace(struct cache *cache, struct backentry *olde, struct backentry *newe);
 static int entrycache_add_int(struct cache *cache, struct backentry *e, int state, struct backentry **alt);
 static struct backentry *entrycache_flush(struct cache *cache);
@@ -367,7 +390,11 @@ entry_lru_verify(struct cache *cache, struct backentry *e, int in)
     int count = 0;
     struct backentry *ep;
 
-    ep = CACHE_LRU_HEAD(cache, struct backentry *);
+    if (e->ep_lruflags & ENTRY_LRU_PROTECTED) {
+        ep = (struct backentry *)cache->c_prothead;
+    } else {
+        ep = CACHE_LRU_HEAD(cache, struct backentry *);
+    }
     while (ep) {
         count++;
         if (ep == e) {
@@ -376,12 +403,14 @@ entry_lru_verify(struct cache *cache, struct backentry *e, int in)
         if (ep->ep_lruprev) {
             ASSERT(BACK_LRU_NEXT(BACK_LRU_PREV(ep, struct backentry *), struct backentry *) == ep);
         } else {
-            ASSERT(ep == CACHE_LRU_HEAD(cache, struct backentry *));
+            ASSERT(ep == CACHE_LRU_HEAD(cache, struct backentry *) ||
+                   ep == (struct backentry *)cache->c_prothead);
         }
         if (ep->ep_lrunext) {
             ASSERT(BACK_LRU_PREV(BACK_LRU_NEXT(ep, struct backentry *), struct backentry *) == ep);
         } else {
-            ASSERT(ep == CACHE_LRU_TAIL(cache, struct backentry *));
+            ASSERT(ep == CACHE_LRU_TAIL(cache, struct backentry *) ||
+                   ep == (struct backentry *)cache->c_prottail);
         }
 
         ep = BACK_LRU_NEXT(ep, struct backentry *);
@@ -420,6 +449,8 @@ static void
 lru_delete(struct cache *cache, void *ptr)
 {
     struct backcommon *e;
+    struct backcommon **head = &cache->c_lruhead;
+    struct backcommon **tail = &cache->c_lrutail;
     if (NULL == ptr) {
         LOG("=> lru_delete\n<= lru_delete (null entry)\n");
         return;
@@ -428,45 +459,164 @@ lru_delete(struct cache *cache, void *ptr)
 #ifdef LDAP_CACHE_DEBUG_LRU
     lru_verify(cache, e, 1);
 #endif
+    if (e->ep_lruflags & ENTRY_LRU_PROTECTED) {
+        head = &cache->c_prothead;
+        tail = &cache->c_prottail;
+        cache->c_protsize -= e->ep_size;
+        cache->c_protentries--;
+    }
     if (e->ep_lruprev)
         e->ep_lruprev->ep_lrunext = e->ep_lrunext;
     else
-        cache->c_lruhead = e->ep_lrunext;
+        *head = e->ep_lrunext;
     if (e->ep_lrunext)
         e->ep_lrunext->ep_lruprev = e->ep_lruprev;
     else
-        cache->c_lrutail = e->ep_lruprev;
+        *tail = e->ep_lruprev;
 #ifdef LDAP_CACHE_DEBUG_LRU
     e->ep_lrunext = e->ep_lruprev = NULL;
     lru_verify(cache, e, 0);
 #endif
 }
 
-/* assume lock is held */
+/* assume lock is held
+ * insert at the head (or the tail) of the probation or the protected list */
 static void
-lru_add(struct cache *cache, void *ptr)
+lru_insert(struct cache *cache, struct backcommon *e, int protected, int at_tail)
 {
-    struct backcommon *e;
-    if (NULL == ptr) {
-        LOG("=> lru_add\n<= lru_add (null entry)\n");
-        return;
+    struct backcommon **head = &cache->c_lruhead;
+    struct backcommon **tail = &cache->c_lrutail;
+
+    if (protected) {
+        e->ep_lruflags |= ENTRY_LRU_PROTECTED;
+        head = &cache->c_prothead;
+        tail = &cache->c_prottail;
+        cache->c_protsize += e->ep_size;
+        cache->c_protentries++;
+    } else {
+        e->ep_lruflags &= ~ENTRY_LRU_PROTECTED;
     }
-    e = (struct backcommon *)ptr;
 #ifdef LDAP_CACHE_DEBUG_LRU
     lru_verify(cache, e, 0);
 #endif
-    e->ep_lruprev = NULL;
-    e->ep_lrunext = cache->c_lruhead;
-    cache->c_lruhead = e;
-    if (e->ep_lrunext)
-        e->ep_lrunext->ep_lruprev = e;
-    if (!cache->c_lrutail)
-        cache->c_lrutail = e;
+    if (at_tail) {
+        e->ep_lrunext = NULL;
+        e->ep_lruprev = *tail;
+        *tail = e;
+        if (e->ep_lruprev)
+            e->ep_lruprev->ep_lrunext = e;
+        if (!*head)
+            *head = e;
+    } else {
+        e->ep_lruprev = NULL;
+        e->ep_lrunext = *head;
+        *head = e;
+        if (e->ep_lrunext)
+            e->ep_lrunext->ep_lruprev = e;
+        if (!*tail)
+            *tail = e;
+    }
 #ifdef LDAP_CACHE_DEBUG_LRU
     lru_verify(cache, e, 1);
 #endif
 }
 
+/* assume lock is held */
+static void
+lru_add(struct cache *cache, void *ptr)
+{
+    if (NULL == ptr) {
+        LOG("=> lru_add\n<= lru_add (null entry)\n");
+        return;
+    }
+    lru_insert(cache, (struct backcommon *)ptr, 0, 0);
+}
+
+/***** access frequency sketch of the entry cache *****/
+
+static const uint64_t cache_freq_seeds[CACHE_FREQ_ROWS] = {
+    0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+    0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL};
+
+static void
+cache_freq_init(struct cache *cache, u_long hashsize)
+{
+    uint64_t size = CACHE_FREQ_MIN_COUNTERS;
+
+    while (size < hashsize && size < CACHE_FREQ_MAX_COUNTERS) {
+        size <<= 1;
+    }
+    slapi_ch_free((void **)&cache->c_freq);
+    cache->c_freq = (uint8_t *)slapi_ch_calloc(size, sizeof(uint8_t));
+    cache->c_freqmask = size - 1;
+    cache->c_freqops = 0;
+}
+
+static inline uint64_t
+cache_freq_slot(struct cache *cache, ID id, int row)
+{
+    uint64_t h = ((uint64_t)id + 1) * cache_freq_seeds[row];
+
+    return (h >> 32) & cache->c_freqmask;
+}
+
+/* assume lock is held */
+static uint8_t
+cache_freq_get(struct cache *cache, ID id)
+{
+    uint8_t freq = CACHE_FREQ_MAX;
+
+    if (NULL == cache->c_freq) {
+        return 0;
+    }
+    for (int row = 0; row < CACHE_FREQ_ROWS; row++) {
+        uint8_t c = cache->c_freq[cache_freq_slot(cache, id, row)];
+        if (c < freq) {
+            freq = c;
+        }
+    }
+    return freq;
+}
+
+/* assume lock is held */
+static void
+cache_freq_incr(struct cache *cache, ID id)
+{
+    uint8_t freq;
+
+    if (NULL == cache->c_freq) {
+        return;
+    }
+    /* conservative update: only raise the counters holding the minimum */
+    freq = cache_freq_get(cache, id);
+    if (freq < CACHE_FREQ_MAX) {
+        for (int row = 0; row < CACHE_FREQ_ROWS; row++) {
+            uint8_t *c = &cache->c_freq[cache_freq_slot(cache, id, row)];
+            if (*c == freq) {
+                (*c)++;
+            }
+        }
+    }
+    if (++cache->c_freqops >= (cache->c_freqmask + 1) * CACHE_FREQ_AGING) {
+        for (uint64_t i = 0; i <= cache->c_freqmask; i++) {
+            cache->c_freq[i] >>= 1;
+        }
+        cache->c_freqops = 0;
+    }
+}
+
+/* assume lock is held -- an entry found in the cache is being handed out */
+static void
+entrycache_count_access(struct cache *cache, struct backentry *e)
+{
+    if (e->ep_lruflags & ENTRY_LRU_PREFETCHED) {
+        /* the read ahead already counted this access */
+        e->ep_lruflags &= ~ENTRY_LRU_PREFETCHED;
+    } else {
+        cache_freq_incr(cache, e->ep_id);
+    }
+}
+
 
 /***** cache overhead *****/
 
@@ -482,6 +632,7 @@ cache_make_hashes(struct cache *cache, int type)
         cache->c_idtable = new_hash(hashsize,
                                     HASHLOC(struct backentry, ep_id_link),
                                     NULL, entry_same_id);
+        cache_freq_init(cache, hashsize);
 #ifdef UUIDCACHE_ON
         cache->c_uuidtable = new_hash(hashsize,
                                       HASHLOC(struct backentry, ep_uuid_link),
@@ -588,7 +739,7 @@ flush_hash(struct cache *cache, struct timespec *start_time, int32_t type)
                     lru_delete(cache, laste);
                     if (type == ENTRY_CACHE) {
                         entrycache_remove_int(cache, laste);
-                        entrycache_return(cache, (struct backentry **)&laste, PR_TRUE);
+                        entrycache_return(cache, (struct backentry **)&laste, PR_TRUE, CACHE_HINT_NONE);
                     } else {
                         dncache_remove_int(cache, laste);
                         dncache_return(cache, (struct backdn **)&laste);
@@ -630,7 +781,7 @@ flush_hash(struct cache *cache, struct timespec *start_time, int32_t type)
                         entry->ep_refcnt++;
                         lru_delete(cache, laste);
                         entrycache_remove_int(cache, laste);
-                        entrycache_return(cache, (struct backentry **)&laste, PR_TRUE);
+                        entrycache_return(cache, (struct backentry **)&laste, PR_TRUE, CACHE_HINT_NONE);
                     } else {
                         /* Entry flagged for removal */
                         slapi_log_err(SLAPI_LOG_CACHE, "flush_hash",
@@ -690,6 +841,10 @@ cache_init(struct cache *cache, uint64_t maxsize, int64_t maxentries, int type)
         cache->c_tries = NULL;
     }
     cache->c_lruhead = cache->c_lrutail = NULL;
+    cache->c_prothead = cache->c_prottail = NULL;
+    cache->c_protsize = 0;
+    cache->c_protentries = 0;
+    cache->c_freq = NULL;
     cache_make_hashes(cache, type);
 
     if (((cache->c_mutex = PR_NewMonitor()) == NULL) ||
@@ -717,36 +872,40 @@ static struct backentry *
 entrycache_flush(struct cache *cache)
 {
     struct backentry *e = NULL;
+    struct backentry *eflush = NULL;
 
     LOG("=> entrycache_flush\n");
 
-    /* all entries on the LRU list are guaranteed to have a refcnt = 0
-     * (iow, nobody's using them), so just delete from the tail down
-     * until the cache is a managable size again.
+    /* all entries on the LRU lists are guaranteed to have a refcnt = 0
+     * (iow, nobody's using them), so just delete from the tail of the
+     * probation list, then from the tail of the protected list, until the
+     * cache is a managable size again.  The evicted entries are chained
+     * through ep_lrunext.
      * (cache->c_mutex is locked when we enter this)
      */
-    while ((cache->c_lrutail != NULL) && CACHE_FULL(cache)) {
-        if (e == NULL) {
+    while (CACHE_FULL(cache)) {
+        if (cache->c_lrutail != NULL) {
             e = CACHE_LRU_TAIL(cache, struct backentry *);
+        } else if (cache->c_prottail != NULL) {
+            e = (struct backentry *)cache->c_prottail;
         } else {
-            e = BACK_LRU_PREV(e, struct backentry *);
+            break;
         }
         ASSERT(e->ep_refcnt == 0);
+        lru_delete(cache, (void *)e);
         e->ep_refcnt++;
+        e->ep_lruprev = NULL;
+        e->ep_lrunext = (struct backcommon *)eflush;
+        eflush = e;
         if (entrycache_remove_int(cache, e) < 0) {
             slapi_log_err(SLAPI_LOG_ERR,
                           "entrycache_flush", "Unable to delete entry\n");
             break;
         }
-        if (e == CACHE_LRU_HEAD(cache, struct backentry *)) {
-            break;
-        }
     }
-    if (e)
-        LRU_DETACH(cache, e);
     LOG("<= entrycache_flush (down to %lu entries, %lu bytes)\n",
         cache->c_curentries, slapi_counter_get_value(cache->c_cursize));
-    return e;
+    return eflush;
 }
 
 /* remove everything from the cache */
@@ -799,6 +958,7 @@ erase_cache(struct cache *cache, int type)
     }
     slapi_ch_free((void **)&cache->c_dntable);
     slapi_ch_free((void **)&cache->c_idtable);
+    slapi_ch_free((void **)&cache->c_freq);
 #ifdef UUIDCACHE_ON
     slapi_ch_free((void **)&cache->c_uuidtable);
 #endif
@@ -1293,14 +1453,90 @@ cache_return(struct cache *cache, void **ptr)
     }
     bep = *(struct backcommon **)ptr;
     if (CACHE_TYPE_ENTRY == bep->ep_type) {
-        entrycache_return(cache, (struct backentry **)ptr, PR_FALSE);
+        entrycache_return(cache, (struct backentry **)ptr, PR_FALSE, CACHE_HINT_NONE);
     } else if (CACHE_TYPE_DN == bep->ep_type) {
         dncache_return(cache, (struct backdn **)ptr);
     }
 }
 
+/* same as cache_return() for an entry read by a scan (unindexed search,
+ * bulk task): it is not promoted and it is the first one to be evicted.
+ */
+void
+cache_return_scan(struct cache *cache, void **ptr)
+{
+    if (NULL == ptr || NULL == *ptr) {
+        return;
+    }
+    if (CACHE_TYPE_ENTRY == (*(struct backcommon **)ptr)->ep_type) {
+        entrycache_return(cache, (struct backentry **)ptr, PR_FALSE, CACHE_HINT_SCAN);
+    } else {
+        cache_return(cache, ptr);
+    }
+}
+
+/* same as cache_return() for an entry read ahead of a search: the access
+ * made by the search itself will not be counted a second time.
+ */
+void
+cache_return_prefetch(struct cache *cache, void **ptr)
+{
+    if (NULL == ptr || NULL == *ptr) {
+        return;
+    }
+    if (CACHE_TYPE_ENTRY == (*(struct backcommon **)ptr)->ep_type) {
+        entrycache_return(cache, (struct backentry **)ptr, PR_FALSE, CACHE_HINT_PREFETCH);
+    } else {
+        cache_return(cache, ptr);
+    }
+}
+
+/* assume lock is held -- keep the protected list within its share */
 static void
-entrycache_return(struct cache *cache, struct backentry **bep, PRBool locked)
+entrycache_trim_protected(struct cache *cache)
+{
+    uint64_t maxsize = cache->c_maxsize / 100 * CACHE_PROTECTED_PCT;
+    int64_t maxentries = (cache->c_maxentries > 0) ? (cache->c_maxentries * CACHE_PROTECTED_PCT) / 100 : -1;
+
+    while (cache->c_prottail &&
+           ((cache->c_protsize > maxsize) ||
+            ((maxentries >= 0) && (cache->c_protentries > (uint64_t)maxentries)))) {
+        struct backcommon *e = cache->c_prottail;
+        /* demoted entries get a last chance at the head of probation */
+        lru_delete(cache, (void *)e);
+        lru_insert(cache, e, 0, 0);
+    }
+}
+
+/* assume lock is held -- the last reference to the entry was released */
+static void
+entrycache_lru_return(struct cache *cache, struct backentry *e, int hint)
+{
+    struct backcommon *be = (struct backcommon *)e;
+
+    if (e->ep_lruflags & ENTRY_LRU_PROTECTED) {
+        /* a hot entry stays hot, even when a scan went through it */
+        lru_insert(cache, be, 1, 0);
+    } else if (hint == CACHE_HINT_SCAN) {
+        lru_insert(cache, be, 0, 1);
+    } else if (hint == CACHE_HINT_PREFETCH) {
+        e->ep_lruflags |= ENTRY_LRU_PREFETCHED;
+        lru_insert(cache, be, 0, 0);
+    } else if (cache_freq_get(cache, e->ep_id) >= CACHE_FREQ_PROMOTE) {
+        lru_insert(cache, be, 1, 0);
+        entrycache_trim_protected(cache);
+    } else if (CACHE_FULL(cache) && cache->c_lrutail &&
+               cache_freq_get(cache, e->ep_id) < cache_freq_get(cache, cache->c_lrutail->ep_id)) {
+        /* admission: a newcomer less popular than the next victim is
+         * evicted in its place */
+        lru_insert(cache, be, 0, 1);
+    } else {
+        lru_insert(cache, be, 0, 0);
+    }
+}
+
+static void
+entrycache_return(struct cache *cache, struct backentry **bep, PRBool locked, int hint)
 {
     struct backentry *eflush = NULL;
     struct backentry *eflushtemp = NULL;
@@ -1343,7 +1579,7 @@ entrycache_return(struct cache *cache, struct backentry **bep, PRBool locked)
                 }
                 backentry_free(bep);
             } else {
-                lru_add(cache, e);
+                entrycache_lru_return(cache, e, hint);
                 /* the cache might be overfull... */
                 if (CACHE_FULL(cache))
                     eflush = entrycache_flush(cache);
@@ -1383,6 +1619,7 @@ cache_find_dn(struct cache *cache, const char *dn, unsigned long ndnlen)
         if (e->ep_refcnt == 0)
             lru_delete(cache, (void *)e);
         e->ep_refcnt++;
+        entrycache_count_access(cache, e);
         cache_unlock(cache);
         slapi_counter_increment(cache->c_hits);
     } else {
@@ -1415,9 +1652,12 @@ cache_find_id(struct cache *cache, ID id)
         if (e->ep_refcnt == 0)
             lru_delete(cache, (void *)e);
         e->ep_refcnt++;
+        entrycache_count_access(cache, e);
         cache_unlock(cache);
         slapi_counter_increment(cache->c_hits);
     } else {
+        /* the caller is about to load it: that is an access too */
+        cache_freq_incr(cache, id);
         cache_unlock(cache);
     }
     slapi_counter_increment(cache->c_tries);
@@ -1426,6 +1666,53 @@ cache_find_id(struct cache *cache, ID id)
     return e;
 }
 
+/* check whether an entry is in the cache, without taking a reference
+ * or counting an access */
+int
+cache_has_id(struct cache *cache, ID id)
+{
+    struct backentry *e;
+    int found;
+
+    cache_lock(cache);
+    found = find_hash(cache->c_idtable, &id, sizeof(ID), (void **)&e);
+    cache_unlock(cache);
+    return found;
+}
+
+/* collect the ids of the entries sitting on the LRU lists, hottest first:
+ * the protected list, then the probation list, each from head to tail.
+ * Entries in use are not on the LRU and are not reported.  At most max
+ * ids are returned in *ids, which the caller must free. */
+size_t
+cache_get_lru_ids(struct cache *cache, ID **ids, size_t max)
+{
+    struct backcommon *heads[2];
+    struct backcommon *e;
+    size_t count = 0;
+    size_t size;
+
+    *ids = NULL;
+    cache_lock(cache);
+    size = (cache->c_curentries < max) ? cache->c_curentries : max;
+    if (size == 0) {
+        cache_unlock(cache);
+        return 0;
+    }
+    *ids = (ID *)slapi_ch_malloc(size * sizeof(ID));
+    heads[0] = cache->c_prothead;
+    heads[1] = cache->c_lruhead;
+    for (size_t i = 0; i < 2 && count < size; i++) {
+        for (e = heads[i]; e && count < size; e = e->ep_lrunext) {
+            if (e->ep_state == 0) {
+                (*ids)[count++] = e->ep_id;
+            }
+        }
+    }
+    cache_unlock(cache);
+    return count;
+}
+
 #ifdef UUIDCACHE_ON
 /* lookup an entry in the cache by it's uuid (you must return it later) */
 struct backentry *
@@ -1447,6 +1734,7 @@ cache_find_uuid(struct cache *cache, const char *uuid)
         if (e->ep_refcnt == 0)
             lru_delete(cache, (void *)e);
         e->ep_refcnt++;
+        entrycache_count_access(cache, e);
         cache_unlock(cache);
         slapi_counter_increment(cache->c_hits);
     } else {
@@ -1623,6 +1911,7 @@ entrycache_add_int(struct cache *cache, struct backentry *e, int state, struct b
     if (!already_in) {
         e->ep_refcnt = 1;
         e->ep_size = entry_size;
+        e->ep_lruflags = 0;
         slapi_counter_add(cache->c_cursize, e->ep_size);
         cache->c_curentries++;
         /* don't add to lru since refcnt = 1 */
@@ -0,0 +1,483 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* cache_snapshot.c - save the hot cache ids and reload them at startup */
+
+/*
+ * A freshly started server has empty entry and dn caches and serves from
+ * the database until the working set has been read again, which takes a
+ * long time with large caches.  When nsslapd-cache-preload is on, the ids
+ * of the entries on the LRU lists of both caches are saved, hottest first,
+ * to <nsslapd-directory>/<instance>.cachesnapshot at shutdown (and every
+ * nsslapd-cache-snapshot-interval seconds if it is set).
+ *
+ * At startup a thread per instance reads the snapshot back and loads the
+ * ids in batches: the hottest batch first, and within a batch in id order,
+ * which is the id2entry key order.  Loading stops as soon as the cache is
+ * full, and is throttled by nsslapd-cache-preload-rate (entries/second).
+ * The progress is reported in the backend monitor entry.
+ *
+ * The snapshot only holds ids.  An id that no longer exists is skipped, and
+ * since ids are never reused the worst case for an outdated snapshot is to
+ * preload entries that are not hot anymore.  A snapshot taken when the next
+ * id was higher than the current one comes from another database (e.g. one
+ * that has been re-imported since) and is ignored.
+ */
+
+#include "back-ldbm.h"
+
+#define CACHE_SNAPSHOT_MAGIC   0x4c435331 /* "LCS1" */
+#define CACHE_SNAPSHOT_VERSION 1
+#define CACHE_SNAPSHOT_SUFFIX  ".cachesnapshot"
+#define CACHE_SNAPSHOT_MAX_IDS (1 << 28)
+#define CACHE_PRELOAD_BATCH    4096
+
+/* inst_preload_state */
+#define CACHE_PRELOAD_NONE    0 /* no preload was done (off or no snapshot) */
+#define CACHE_PRELOAD_RUNNING 1
+#define CACHE_PRELOAD_DONE    2
+#define CACHE_PRELOAD_ABORTED 3 /* interrupted by a shutdown */
+#define CACHE_PRELOAD_OFFLINE 4 /* interrupted by the backend going offline */
+
+typedef struct cache_snapshot_header
+{
+    uint32_t cs_magic;
+    uint32_t cs_version;
+    uint64_t cs_nextid;
+    uint64_t cs_nentries; /* entry cache ids that follow the header */
+    uint64_t cs_ndns;     /* dn cache ids that follow the entry cache ids */
+} cache_snapshot_header;
+
+/* serializes the periodic and the shutdown snapshots */
+static pthread_mutex_t cache_snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *
+cache_snapshot_path(ldbm_instance *inst)
+{
+    return slapi_ch_smprintf("%s/%s%s", inst->inst_li->li_directory,
+                             inst->inst_name, CACHE_SNAPSHOT_SUFFIX);
+}
+
+static int
+cache_snapshot_write(PRFileDesc *fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+
+    while (len > 0) {
+        PRInt32 n = PR_Write(fd, p, (PRInt32)len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int
+cache_snapshot_read(PRFileDesc *fd, void *buf, size_t len)
+{
+    char *p = (char *)buf;
+
+    while (len > 0) {
+        PRInt32 n = PR_Read(fd, p, (PRInt32)len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int
+cache_snapshot_save_instance(ldbm_instance *inst)
+{
+    cache_snapshot_header hdr = {0};
+    ID *eids = NULL;
+    ID *dids = NULL;
+    size_t neids;
+    size_t ndids = 0;
+    char *path = NULL;
+    char *tmppath = NULL;
+    PRFileDesc *fd = NULL;
+    int rc = -1;
+
+    neids = cache_get_lru_ids(&inst->inst_cache, &eids, CACHE_SNAPSHOT_MAX_IDS);
+    if (entryrdn_get_switch()) {
+        ndids = cache_get_lru_ids(&inst->inst_dncache, &dids, CACHE_SNAPSHOT_MAX_IDS);
+    }
+
+    hdr.cs_magic = CACHE_SNAPSHOT_MAGIC;
+    hdr.cs_version = CACHE_SNAPSHOT_VERSION;
+    PR_Lock(inst->inst_nextid_mutex);
+    hdr.cs_nextid = inst->inst_nextid;
+    PR_Unlock(inst->inst_nextid_mutex);
+    hdr.cs_nentries = neids;
+    hdr.cs_ndns = ndids;
+
+    /* Write a new file and rename it so that a crash never leaves a
+     * truncated snapshot behind */
+    path = cache_snapshot_path(inst);
+    tmppath = slapi_ch_smprintf("%s.tmp", path);
+    fd = PR_Open(tmppath, PR_WRONLY | PR_CREATE_FILE | PR_TRUNCATE, SLAPD_DEFAULT_FILE_MODE);
+    if (fd == NULL) {
+        PRErrorCode prerr = PR_GetError();
+        slapi_log_err(SLAPI_LOG_ERR, "cache_snapshot_save_instance",
+                      "%s: Unable to create %s, " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                      inst->inst_name, tmppath, prerr, slapd_pr_strerror(prerr));
+        goto done;
+    }
+    if (cache_snapshot_write(fd, &hdr, sizeof(hdr)) ||
+        (neids && cache_snapshot_write(fd, eids, neids * sizeof(ID))) ||
+        (ndids && cache_snapshot_write(fd, dids, ndids * sizeof(ID)))) {
+        PRErrorCode prerr = PR_GetError();
+        slapi_log_err(SLAPI_LOG_ERR, "cache_snapshot_save_instance",
+                      "%s: Unable to write %s, " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                      inst->inst_name, tmppath, prerr, slapd_pr_strerror(prerr));
+        PR_Close(fd);
+        PR_Delete(tmppath);
+        goto done;
+    }
+    PR_Close(fd);
+    if (PR_Rename(tmppath, path) != PR_SUCCESS) {
+        /* PR_Rename does not replace an existing file */
+        PR_Delete(path);
+        if (PR_Rename(tmppath, path) != PR_SUCCESS) {
+            PRErrorCode prerr = PR_GetError();
+            slapi_log_err(SLAPI_LOG_ERR, "cache_snapshot_save_instance",
+                          "%s: Unable to rename %s, " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                          inst->inst_name, tmppath, prerr, slapd_pr_strerror(prerr));
+            PR_Delete(tmppath);
+            goto done;
+        }
+    }
+    slapi_log_err(SLAPI_LOG_INFO, "cache_snapshot_save_instance",
+                  "%s: Saved %lu entry cache and %lu dn cache ids\n",
+                  inst->inst_name, (u_long)neids, (u_long)ndids);
+    rc = 0;
+
+done:
+    slapi_ch_free_string(&tmppath);
+    slapi_ch_free_string(&path);
+    slapi_ch_free((void **)&eids);
+    slapi_ch_free((void **)&dids);
+    return rc;
+}
+
+static void
+cache_snapshot_save_all(struct ldbminfo *li)
+{
+    Object *inst_obj;
+    ldbm_instance *inst;
+
+    pthread_mutex_lock(&cache_snapshot_mutex);
+    for (inst_obj = objset_first_obj(li->li_instance_set); inst_obj;
+         inst_obj = objset_next_obj(li->li_instance_set, inst_obj)) {
+        inst = (ldbm_instance *)object_get_data(inst_obj);
+        if (inst->inst_be->be_state != BE_STATE_STARTED) {
+            /* Offline for an import or a restore, the ids are meaningless */
+            continue;
+        }
+        if (slapi_atomic_load_32(&inst->inst_preload_state, __ATOMIC_ACQUIRE) == CACHE_PRELOAD_RUNNING ||
+            slapi_atomic_load_32(&inst->inst_preload_state, __ATOMIC_ACQUIRE) == CACHE_PRELOAD_ABORTED) {
+            /* The caches only hold part of the previous snapshot: keep it.
+             * A preload interrupted by the backend going offline does not
+             * count: the caches were emptied and the previous snapshot is
+             * meaningless once the backend is back online. */
+            continue;
+        }
+        cache_snapshot_save_instance(inst);
+    }
+    pthread_mutex_unlock(&cache_snapshot_mutex);
+}
+
+static void
+cache_snapshot_event(time_t when __attribute__((unused)), void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    if (li->li_shutdown || !li->li_cache_preload) {
+        return;
+    }
+    cache_snapshot_save_all(li);
+}
+
+/*
+ * Read the snapshot of the instance: *neids entry cache ids followed by
+ * *ndids dn cache ids are returned in *ids.  Returns 0 on success.
+ */
+static int
+cache_snapshot_load_instance(ldbm_instance *inst, ID **ids, size_t *neids, size_t *ndids)
+{
+    cache_snapshot_header hdr = {0};
+    char *path = cache_snapshot_path(inst);
+    PRFileDesc *fd = NULL;
+    ID nextid;
+    int rc = -1;
+
+    *ids = NULL;
+    *neids = *ndids = 0;
+    fd = PR_Open(path, PR_RDONLY, SLAPD_DEFAULT_FILE_MODE);
+    if (fd == NULL) {
+        slapi_log_err(SLAPI_LOG_INFO, "cache_snapshot_load_instance",
+                      "%s: No cache snapshot to preload\n", inst->inst_name);
+        goto done;
+    }
+    if (cache_snapshot_read(fd, &hdr, sizeof(hdr)) ||
+        hdr.cs_magic != CACHE_SNAPSHOT_MAGIC ||
+        hdr.cs_version != CACHE_SNAPSHOT_VERSION ||
+        hdr.cs_nentries > CACHE_SNAPSHOT_MAX_IDS ||
+        hdr.cs_ndns > CACHE_SNAPSHOT_MAX_IDS) {
+        slapi_log_err(SLAPI_LOG_WARNING, "cache_snapshot_load_instance",
+                      "%s: Ignoring invalid cache snapshot %s\n", inst->inst_name, path);
+        goto done;
+    }
+    PR_Lock(inst->inst_nextid_mutex);
+    nextid = inst->inst_nextid;
+    PR_Unlock(inst->inst_nextid_mutex);
+    if (hdr.cs_nextid > nextid) {
+        slapi_log_err(SLAPI_LOG_WARNING, "cache_snapshot_load_instance",
+                      "%s: Ignoring cache snapshot %s, it was taken from another database\n",
+                      inst->inst_name, path);
+        goto done;
+    }
+    if (hdr.cs_nentries + hdr.cs_ndns > 0) {
+        *ids = (ID *)slapi_ch_malloc((hdr.cs_nentries + hdr.cs_ndns) * sizeof(ID));
+        if (cache_snapshot_read(fd, *ids, (hdr.cs_nentries + hdr.cs_ndns) * sizeof(ID))) {
+            slapi_log_err(SLAPI_LOG_WARNING, "cache_snapshot_load_instance",
+                          "%s: Ignoring truncated cache snapshot %s\n", inst->inst_name, path);
+            slapi_ch_free((void **)ids);
+            goto done;
+        }
+    }
+    *neids = hdr.cs_nentries;
+    *ndids = hdr.cs_ndns;
+    rc = 0;
+
+done:
+    if (fd) {
+        PR_Close(fd);
+    }
+    slapi_ch_free_string(&path);
+    return rc;
+}
+
+static int
+cache_preload_cmp(const void *a, const void *b)
+{
+    ID ia = *(const ID *)a;
+    ID ib = *(const ID *)b;
+
+    return (ia > ib) - (ia < ib);
+}
+
+static int
+cache_preload_is_full(struct cache *cache)
+{
+    uint64_t entries, size, maxsize;
+    int64_t maxentries;
+
+    cache_get_stats(cache, NULL, NULL, &entries, &maxentries, &size, &maxsize);
+    return (size >= maxsize) || ((maxentries > 0) && (entries >= (uint64_t)maxentries));
+}
+
+static int
+cache_preload_should_stop(ldbm_instance *inst)
+{
+    return inst->inst_li->li_shutdown || (inst->inst_be->be_state != BE_STATE_STARTED);
+}
+
+/*
+ * Load ids[0..count[ into the entry cache (dn == 0) or into the dn cache
+ * (dn == 1).  Returns non zero if the preload was interrupted.
+ */
+static int
+cache_preload_ids(ldbm_instance *inst, ID *ids, size_t count, int dn, struct timespec *window, int *inwindow)
+{
+    backend *be = inst->inst_be;
+    struct cache *cache = dn ? &inst->inst_dncache : &inst->inst_cache;
+
+    for (size_t start = 0; start < count; start += CACHE_PRELOAD_BATCH) {
+        size_t end = (count - start > CACHE_PRELOAD_BATCH) ? start + CACHE_PRELOAD_BATCH : count;
+
+        qsort(ids + start, end - start, sizeof(ID), cache_preload_cmp);
+        for (size_t i = start; i < end; i++) {
+            int rate = inst->inst_li->li_cache_preload_rate;
+
+            /* Like an operation, hold the backend lock so that the backend
+             * cannot be taken offline under our feet */
+            slapi_be_Rlock(be);
+            if (cache_preload_should_stop(inst)) {
+                slapi_be_Unlock(be);
+                return 1;
+            }
+            if (cache_preload_is_full(cache)) {
+                /* Going on would only evict what was just loaded */
+                slapi_be_Unlock(be);
+                return 0;
+            }
+            if (dn) {
+                id2entry_cache_dn(be, ids[i]);
+            } else if (!cache_has_id(cache, ids[i])) {
+                struct backentry *e;
+                int err = 0;
+                if ((e = id2entry(be, ids[i], NULL, &err)) != NULL) {
+                    CACHE_RETURN(cache, &e);
+                }
+            }
+            slapi_be_Unlock(be);
+            slapi_atomic_incr_64(&inst->inst_preload_loaded, __ATOMIC_RELAXED);
+
+            if (rate > 0 && ++(*inwindow) >= rate) {
+                /* Wait for the end of the current second */
+                struct timespec now, elapsed;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                slapi_timespec_diff(&now, window, &elapsed);
+                if (elapsed.tv_sec == 0) {
+                    DS_Sleep(PR_MillisecondsToInterval(1000 - elapsed.tv_nsec / 1000000));
+                }
+                clock_gettime(CLOCK_MONOTONIC, window);
+                *inwindow = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+static void
+cache_preload_thread(void *arg)
+{
+    ldbm_instance *inst = (ldbm_instance *)arg;
+    ID *ids = NULL;
+    size_t neids = 0;
+    size_t ndids = 0;
+    struct timespec start, window, elapsed;
+    int inwindow = 0;
+    int aborted = 0;
+
+    if (cache_snapshot_load_instance(inst, &ids, &neids, &ndids)) {
+        slapi_atomic_store_32(&inst->inst_preload_state, CACHE_PRELOAD_NONE, __ATOMIC_RELEASE);
+        return;
+    }
+    slapi_atomic_store_64(&inst->inst_preload_total, neids + ndids, __ATOMIC_RELEASE);
+    slapi_log_err(SLAPI_LOG_INFO, "cache_preload_thread",
+                  "%s: Preloading %lu entry cache and %lu dn cache ids\n",
+                  inst->inst_name, (u_long)neids, (u_long)ndids);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    window = start;
+    aborted = cache_preload_ids(inst, ids, neids, 0, &window, &inwindow);
+    if (!aborted && ndids && entryrdn_get_switch()) {
+        aborted = cache_preload_ids(inst, ids + neids, ndids, 1, &window, &inwindow);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &elapsed);
+    slapi_timespec_diff(&elapsed, &start, &elapsed);
+
+    slapi_log_err(SLAPI_LOG_INFO, "cache_preload_thread",
+                  "%s: Cache preload %s, %lu ids loaded in %ld seconds\n",
+                  inst->inst_name, aborted ? "aborted" : "done",
+                  (u_long)slapi_atomic_load_64(&inst->inst_preload_loaded, __ATOMIC_ACQUIRE),
+                  (long)elapsed.tv_sec);
+    if (!aborted) {
+        slapi_atomic_store_32(&inst->inst_preload_state, CACHE_PRELOAD_DONE, __ATOMIC_RELEASE);
+    } else if (inst->inst_li->li_shutdown) {
+        /* Only the shutdown snapshot, that would follow, must be skipped */
+        slapi_atomic_store_32(&inst->inst_preload_state, CACHE_PRELOAD_ABORTED, __ATOMIC_RELEASE);
+    } else {
+        slapi_atomic_store_32(&inst->inst_preload_state, CACHE_PRELOAD_OFFLINE, __ATOMIC_RELEASE);
+    }
+    slapi_ch_free((void **)&ids);
+}
+
+/*
+ * Start warming up the caches of a freshly started instance.
+ * Called from ldbm_instance_startall.
+ */
+void
+ldbm_cache_preload_start(ldbm_instance *inst)
+{
+    if (!inst->inst_li->li_cache_preload || inst->inst_preload_tid) {
+        return;
+    }
+    slapi_atomic_store_64(&inst->inst_preload_loaded, 0, __ATOMIC_RELEASE);
+    slapi_atomic_store_64(&inst->inst_preload_total, 0, __ATOMIC_RELEASE);
+    slapi_atomic_store_32(&inst->inst_preload_state, CACHE_PRELOAD_RUNNING, __ATOMIC_RELEASE);
+    inst->inst_preload_tid = PR_CreateThread(PR_USER_THREAD, cache_preload_thread, inst,
+                                             PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                             PR_JOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+    if (inst->inst_preload_tid == NULL) {
+        PRErrorCode prerr = PR_GetError();
+        slapi_log_err(SLAPI_LOG_ERR, "ldbm_cache_preload_start",
+                      "%s: Unable to spawn cache preload thread, " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                      inst->inst_name, prerr, slapd_pr_strerror(prerr));
+        slapi_atomic_store_32(&inst->inst_preload_state, CACHE_PRELOAD_NONE, __ATOMIC_RELEASE);
+    }
+}
+
+const char *
+ldbm_cache_preload_status(ldbm_instance *inst)
+{
+    switch (slapi_atomic_load_32(&inst->inst_preload_state, __ATOMIC_ACQUIRE)) {
+    case CACHE_PRELOAD_RUNNING:
+        return "running";
+    case CACHE_PRELOAD_DONE:
+        return "done";
+    case CACHE_PRELOAD_ABORTED:
+    case CACHE_PRELOAD_OFFLINE:
+        return "aborted";
+    default:
+        return "none";
+    }
+}
+
+/*
+ * Schedule the periodic snapshots.  Called once from ldbm_back_start.
+ */
+void
+ldbm_cache_snapshot_start(struct ldbminfo *li)
+{
+    if (li->li_cache_snapshot_interval > 0 && li->li_cache_snapshot_ctx == NULL) {
+        li->li_cache_snapshot_ctx =
+            slapi_eq_repeat_rel(cache_snapshot_event, li,
+                                slapi_current_rel_time_t() + li->li_cache_snapshot_interval,
+                                li->li_cache_snapshot_interval * 1000);
+    }
+}
+
+/*
+ * Stop the preload threads and save the snapshots.  Called from
+ * ldbm_back_close, after li_shutdown is set and before the databases are
+ * closed.
+ */
+void
+ldbm_cache_snapshot_stop(struct ldbminfo *li)
+{
+    Object *inst_obj;
+    ldbm_instance *inst;
+
+    if (li->li_cache_snapshot_ctx) {
+        slapi_eq_cancel_rel(li->li_cache_snapshot_ctx);
+        li->li_cache_snapshot_ctx = NULL;
+    }
+    for (inst_obj = objset_first_obj(li->li_instance_set); inst_obj;
+         inst_obj = objset_next_obj(li->li_instance_set, inst_obj)) {
+        inst = (ldbm_instance *)object_get_data(inst_obj);
+        if (inst->inst_preload_tid) {
+            PR_JoinThread(inst->inst_preload_tid);
+            inst->inst_preload_tid = NULL;
+        }
+    }
+    if (li->li_cache_preload) {
+        cache_snapshot_save_all(li);
+    }
+}
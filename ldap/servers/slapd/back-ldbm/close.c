@@ -28,6 +28,12 @@ ldbm_back_close(Slapi_PBlock *pb)
     li->li_shutdown = 1;
     PR_Unlock(li->li_shutdown_mutex);
 
+    /* Stop reading ahead for searches */
+    ldbm_prefetch_stop(li);
+
+    /* Stop warming up the caches and save what they hold for the next start */
+    ldbm_cache_snapshot_stop(li);
+
     /* close down all the ldbm instances */
     dblayer_close(li, DBLAYER_NORMAL_MODE);
 
@@ -335,10 +335,103 @@ bdb_import_add_created_attrs(Slapi_Entry *e)
     }
 }
 
+#define BDB_IMPORT_STR2ENTRY_OK 0
+#define BDB_IMPORT_STR2ENTRY_NODN 1    /* entry does not start with "dn: " */
+#define BDB_IMPORT_STR2ENTRY_EMPTYDN 2 /* dn has no value */
+
+/* Parse an LDIF entry. Returns NULL if the entry is invalid, *rc tells why
+ * the dn could not be read.
+ */
+static Slapi_Entry *
+bdb_import_str2entry(char *estr, int lines_in_entry, int str2entry_flags, int *rc)
+{
+    Slapi_Entry *e = NULL;
+    int flags = 0;
+
+    *rc = BDB_IMPORT_STR2ENTRY_OK;
+    /* If there are more than so many lines in the entry, we tell
+     * str2entry to optimize for a large entry.
+     */
+    if (lines_in_entry > STR2ENTRY_ATTRIBUTE_PRESENCE_CHECK_THRESHOLD) {
+        flags = str2entry_flags | SLAPI_STR2ENTRY_BIGENTRY;
+    } else {
+        flags = str2entry_flags;
+    }
+    if (!(str2entry_flags & SLAPI_STR2ENTRY_INCLUDE_VERSION_STR) &&
+        entryrdn_get_switch()) { /* subtree-rename: on */
+        char *dn = NULL;
+        char *normdn = NULL;
+        /* estr should start with "dn: " or "dn:: " */
+        if (strncmp(estr, "dn: ", 4) &&
+            NULL == strstr(estr, "\ndn: ") && /* in case comments precedes
+                                                 the entry */
+            strncmp(estr, "dn:: ", 5) &&
+            NULL == strstr(estr, "\ndn:: ")) { /* ditto */
+            *rc = BDB_IMPORT_STR2ENTRY_NODN;
+            return NULL;
+        }
+        /* get_value_from_string decodes base64 if it is encoded. */
+        if (get_value_from_string((const char *)estr, "dn", &dn)) {
+            *rc = BDB_IMPORT_STR2ENTRY_EMPTYDN;
+            return NULL;
+        }
+        normdn = slapi_create_dn_string("%s", dn);
+        slapi_ch_free_string(&dn);
+        e = slapi_str2entry_ext(normdn, NULL, estr,
+                                flags | SLAPI_STR2ENTRY_NO_ENTRYDN);
+        slapi_ch_free_string(&normdn);
+    } else {
+        e = slapi_str2entry(estr, flags);
+    }
+    return e;
+}
+
+/* Entry parsed by the ldif scanner threads */
+typedef struct
+{
+    Slapi_Entry *e;
+    int rc;
+} bdb_scanned_entry;
+
+#define BDB_IMPORT_STR2ENTRY_FLAGS (SLAPI_STR2ENTRY_TOMBSTONE_CHECK |   \
+                                    SLAPI_STR2ENTRY_REMOVEDUPVALS |     \
+                                    SLAPI_STR2ENTRY_EXPAND_OBJECTCLASSES | \
+                                    SLAPI_STR2ENTRY_ADDRDNVALS |        \
+                                    SLAPI_STR2ENTRY_NOT_WELL_FORMED_LDIF)
+
+/* ldif scanner callback: parse the entry (the version string is left to
+ * the producer)
+ */
+static void
+bdb_import_prepare_ldifentry(ImportJob *job __attribute__((unused)), ImportLdifRecord *rec)
+{
+    bdb_scanned_entry *se = NULL;
+
+    if (strncmp(rec->data, "version:", 8) == 0) {
+        return;
+    }
+    se = CALLOC(bdb_scanned_entry);
+    se->e = bdb_import_str2entry(rec->data, rec->nblines, BDB_IMPORT_STR2ENTRY_FLAGS, &se->rc);
+    rec->prepared = se;
+}
+
+static void
+bdb_import_release_ldifentry(ImportLdifRecord *rec)
+{
+    bdb_scanned_entry *se = rec->prepared;
+
+    if (se) {
+        slapi_entry_free(se->e);
+        slapi_ch_free(&rec->prepared);
+    }
+}
+
 /* producer thread:
  * read through the given file list, parsing entries (str2entry), assigning
  * them IDs and queueing them on the entry FIFO.  other threads will do
  * the indexing.
+ * Big files are parsed by the ldif scanner threads, the producer still
+ * assigns the IDs in the ldif order.
  */
 void
 bdb_import_producer(void *param)
@@ -359,6 +452,7 @@ bdb_import_producer(void *param)
     char *curr_filename = NULL;
     int idx;
     ldif_context c;
+    ImportLdifScan *scan = NULL;
     int my_version = 0;
     size_t newesize = 0;
     Slapi_Attr *attr = NULL;
@@ -392,10 +486,11 @@ bdb_import_producer(void *param)
      * as we read it.
      */
     while (!finished) {
-        int flags = 0;
+        bdb_scanned_entry *scanned = NULL;
         int prev_lineno = 0;
         int lines_in_entry = 0;
         int syntax_err = 0;
+        int rc = 0;
 
         if (job->flags & FLAG_ABORT) {
             goto error;
@@ -404,7 +499,7 @@ bdb_import_producer(void *param)
         /* move on to next file? */
         if (detected_eof) {
             /* check if the file can still be read, whine if so... */
-            if (read(fd, (void *)&idx, 1) > 0) {
+            if (!scan && read(fd, (void *)&idx, 1) > 0) {
                 import_log_notice(job, SLAPI_LOG_WARNING, "bdb_import_producer", "Unexpected end of file found "
                                                                              "at line %d of file \"%s\"",
                                   curr_lineno,
@@ -420,6 +515,7 @@ bdb_import_producer(void *param)
                                                                           "entries)",
                                   curr_filename, (u_long)(id - id_filestart));
             }
+            import_ldif_scan_stop(&scan);
             close(fd);
             fd = -1;
             detected_eof = 0;
@@ -459,17 +555,16 @@ bdb_import_producer(void *param)
             } else {
                 import_log_notice(job, SLAPI_LOG_INFO, "bdb_import_producer",
                                   "Processing file \"%s\"", curr_filename);
+                /* Split the parsing of big files among several threads */
+                scan = import_ldif_scan_start(job, fd, bdb_import_prepare_ldifentry,
+                                              bdb_import_release_ldifentry);
             }
         }
         if (job->flags & FLAG_ABORT) {
             goto error;
         }
 
-        str2entry_flags = SLAPI_STR2ENTRY_TOMBSTONE_CHECK |
-                          SLAPI_STR2ENTRY_REMOVEDUPVALS |
-                          SLAPI_STR2ENTRY_EXPAND_OBJECTCLASSES |
-                          SLAPI_STR2ENTRY_ADDRDNVALS |
-                          SLAPI_STR2ENTRY_NOT_WELL_FORMED_LDIF;
+        str2entry_flags = BDB_IMPORT_STR2ENTRY_FLAGS;
 
         while ((info->command == PAUSE) && !(job->flags & FLAG_ABORT)) {
             info->state = WAITING;
@@ -477,10 +572,24 @@ bdb_import_producer(void *param)
         }
         info->state = RUNNING;
 
-        prev_lineno = curr_lineno;
-        estr = bdb_import_get_entry(&c, fd, &curr_lineno);
+        if (scan) {
+            ImportLdifRecord rec = {0};
 
-        lines_in_entry = curr_lineno - prev_lineno;
+            if (import_ldif_scan_next(scan, &rec) < 0) {
+                import_log_notice(job, SLAPI_LOG_ERR, "bdb_import_producer",
+                                  "Could not read LDIF file \"%s\", errno %d (%s)",
+                                  curr_filename, errno, slapd_system_strerror(errno));
+                goto error;
+            }
+            estr = rec.data;
+            scanned = rec.prepared;
+            curr_lineno = rec.lineno + rec.nblines - 1;
+            lines_in_entry = rec.nblines;
+        } else {
+            prev_lineno = curr_lineno;
+            estr = bdb_import_get_entry(&c, fd, &curr_lineno);
+            lines_in_entry = curr_lineno - prev_lineno;
+        }
         if (!estr) {
             /* error reading entry, or end of file */
             detected_eof = 1;
@@ -492,45 +601,24 @@ bdb_import_producer(void *param)
             str2entry_flags |= SLAPI_STR2ENTRY_INCLUDE_VERSION_STR;
         }
 
-        /* If there are more than so many lines in the entry, we tell
-         * str2entry to optimize for a large entry.
-         */
-        if (lines_in_entry > STR2ENTRY_ATTRIBUTE_PRESENCE_CHECK_THRESHOLD) {
-            flags = str2entry_flags | SLAPI_STR2ENTRY_BIGENTRY;
-        } else {
-            flags = str2entry_flags;
-        }
-        if (!(str2entry_flags & SLAPI_STR2ENTRY_INCLUDE_VERSION_STR) &&
-            entryrdn_get_switch()) { /* subtree-rename: on */
-            char *dn = NULL;
-            char *normdn = NULL;
-            int rc = 0; /* estr should start with "dn: " or "dn:: " */
-            if (strncmp(estr, "dn: ", 4) &&
-                NULL == strstr(estr, "\ndn: ") && /* in case comments precedes
-                                                     the entry */
-                strncmp(estr, "dn:: ", 5) &&
-                NULL == strstr(estr, "\ndn:: ")) { /* ditto */
-                import_log_notice(job, SLAPI_LOG_WARNING, "bdb_import_producer",
-                                  "Skipping bad LDIF entry (not starting with \"dn: \") ending line %d of file \"%s\"",
-                                  curr_lineno, curr_filename);
-                FREE(estr);
-                continue;
-            }
-            /* get_value_from_string decodes base64 if it is encoded. */
-            rc = get_value_from_string((const char *)estr, "dn", &dn);
-            if (rc) {
-                import_log_notice(job, SLAPI_LOG_WARNING, "bdb_import_producer",
-                                  "Skipping bad LDIF entry (dn has no value\n");
-                FREE(estr);
-                continue;
-            }
-            normdn = slapi_create_dn_string("%s", dn);
-            slapi_ch_free_string(&dn);
-            e = slapi_str2entry_ext(normdn, NULL, estr,
-                                    flags | SLAPI_STR2ENTRY_NO_ENTRYDN);
-            slapi_ch_free_string(&normdn);
+        if (scanned) {
+            e = scanned->e;
+            rc = scanned->rc;
+            slapi_ch_free((void **)&scanned);
         } else {
-            e = slapi_str2entry(estr, flags);
+            e = bdb_import_str2entry(estr, lines_in_entry, str2entry_flags, &rc);
+        }
+        if (rc == BDB_IMPORT_STR2ENTRY_NODN) {
+            import_log_notice(job, SLAPI_LOG_WARNING, "bdb_import_producer",
+                              "Skipping bad LDIF entry (not starting with \"dn: \") ending line %d of file \"%s\"",
+                              curr_lineno, curr_filename);
+            FREE(estr);
+            continue;
+        } else if (rc == BDB_IMPORT_STR2ENTRY_EMPTYDN) {
+            import_log_notice(job, SLAPI_LOG_WARNING, "bdb_import_producer",
+                              "Skipping bad LDIF entry (dn has no value\n");
+            FREE(estr);
+            continue;
         }
         FREE(estr);
         if (!e) {
@@ -744,6 +832,7 @@ bdb_import_producer(void *param)
             goto error;
         }
         if (info->command == STOP) {
+            import_ldif_scan_stop(&scan);
             if (fd >= 0)
                 close(fd);
             finished = 1;
@@ -761,6 +850,7 @@ bdb_import_producer(void *param)
     return;
 
 error:
+    import_ldif_scan_stop(&scan);
     slapi_value_free(&(job->usn_value));
     info->state = ABORTED;
 }
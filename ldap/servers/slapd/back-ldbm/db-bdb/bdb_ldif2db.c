@@ -32,6 +32,9 @@
 
 typedef struct _export_args
 {
+    struct ldbminfo *li;
+    ldbm_instance *inst;
+    export_pipeline *pipeline;
     struct backentry *ep;
     int decrypt;
     int options;
@@ -43,7 +46,6 @@ typedef struct _export_args
     Slapi_Task *task;
     char **include_suffix;
     char **exclude_suffix;
-    int *cnt;
     int *lastcnt;
     IDList *pre_exported_idl; /* exported IDList, which ID is larger than
                                  its children's ID.  It happens when an entry
@@ -564,51 +566,53 @@ bdb_fetch_subtrees(backend *be, char **include, int *err)
 }
 
 
-static int
-bdb_export_one_entry(struct ldbminfo *li,
-                 ldbm_instance *inst,
-                 export_args *expargs)
+/*
+ * Format an entry for the export pipeline, in any thread.  Returns its LDIF
+ * text, or NULL if the entry is not exported.
+ */
+static char *
+bdb_export_format_entry(void *arg, struct backentry *ep, int *outlen)
 {
-    backend *be = inst->inst_be;
+    export_args *expargs = (export_args *)arg;
+    backend *be = expargs->inst->inst_be;
     int rc = 0;
     Slapi_Attr *this_attr = NULL, *next_attr = NULL;
     char *type = NULL;
-    DBT data = {0};
+    char *str = NULL;
     int len = 0;
 
-    if (!bdb_back_ok_to_dump(backentry_get_ndn(expargs->ep),
+    if (!bdb_back_ok_to_dump(backentry_get_ndn(ep),
                               expargs->include_suffix,
                               expargs->exclude_suffix)) {
-        goto bail; /* go to next loop */
+        return NULL; /* go to next loop */
     }
     if (!(expargs->options & SLAPI_DUMP_STATEINFO) &&
-        slapi_entry_flag_is_set(expargs->ep->ep_entry,
+        slapi_entry_flag_is_set(ep->ep_entry,
                                 SLAPI_ENTRY_FLAG_TOMBSTONE)) {
         /* We only dump the tombstones if the user needs to create
          * a replica from the ldif */
-        goto bail; /* go to next loop */
+        return NULL; /* go to next loop */
     }
-    (*expargs->cnt)++;
 
     /* do not output attributes that are in the "exclude" list */
     /* Also, decrypt any encrypted attributes, if we're asked to */
-    rc = slapi_entry_first_attr(expargs->ep->ep_entry, &this_attr);
+    rc = slapi_entry_first_attr(ep->ep_entry, &this_attr);
     while (0 == rc) {
         int dump_uniqueid = (expargs->options & SLAPI_DUMP_UNIQUEID) ? 1 : 0;
-        rc = slapi_entry_next_attr(expargs->ep->ep_entry,
+        rc = slapi_entry_next_attr(ep->ep_entry,
                                    this_attr, &next_attr);
         slapi_attr_get_type(this_attr, &type);
-        if (bdb_ldbm_exclude_attr_from_export(li, type, dump_uniqueid)) {
-            slapi_entry_delete_values(expargs->ep->ep_entry, type, NULL);
+        if (bdb_ldbm_exclude_attr_from_export(expargs->li, type, dump_uniqueid)) {
+            slapi_entry_delete_values(ep->ep_entry, type, NULL);
         }
         this_attr = next_attr;
     }
     if (expargs->decrypt) {
         /* Decrypt in place */
-        rc = attrcrypt_decrypt_entry(be, expargs->ep);
+        rc = attrcrypt_decrypt_entry(be, ep);
         if (rc) {
-            slapi_log_err(SLAPI_LOG_ERR, "bdb_export_one_entry", "Failed to decrypt entry [%s] : %d\n",
-                          slapi_sdn_get_dn(&expargs->ep->ep_entry->e_sdn), rc);
+            slapi_log_err(SLAPI_LOG_ERR, "bdb_export_format_entry", "Failed to decrypt entry [%s] : %d\n",
+                          slapi_sdn_get_dn(&ep->ep_entry->e_sdn), rc);
         }
     }
     /*
@@ -616,7 +620,7 @@ bdb_export_one_entry(struct ldbminfo *li,
      * If it is not, put "{CLEAR}" in front of the password value.
      */
     {
-        char *pw = slapi_entry_attr_get_charptr(expargs->ep->ep_entry,
+        char *pw = slapi_entry_attr_get_charptr(ep->ep_entry,
                                                 "userpassword");
         if (pw && !slapi_is_encoded(pw)) {
             /* clear password does not have {CLEAR} storage scheme */
@@ -626,56 +630,77 @@ bdb_export_one_entry(struct ldbminfo *li,
             val.bv_len = strlen(val.bv_val);
             vals[0] = &val;
             vals[1] = NULL;
-            rc = slapi_entry_attr_replace(expargs->ep->ep_entry,
+            rc = slapi_entry_attr_replace(ep->ep_entry,
                                           "userpassword", vals);
             if (rc) {
                 slapi_log_err(SLAPI_LOG_ERR,
-                              "bdb_export_one_entry", "%s: Failed to add clear password storage scheme: %d\n",
-                              slapi_sdn_get_dn(&expargs->ep->ep_entry->e_sdn), rc);
+                              "bdb_export_format_entry", "%s: Failed to add clear password storage scheme: %d\n",
+                              slapi_sdn_get_dn(&ep->ep_entry->e_sdn), rc);
             }
             slapi_ch_free_string(&val.bv_val);
         }
         slapi_ch_free_string(&pw);
     }
-    data.data = slapi_entry2str_with_options(expargs->ep->ep_entry,
-                                             &len, expargs->options);
-    data.size = len + 1;
+    str = slapi_entry2str_with_options(ep->ep_entry, &len, expargs->options);
+    if (str == NULL) {
+        return NULL;
+    }
 
     if (expargs->printkey & EXPORT_PRINTKEY) {
-        char idstr[32];
-
-        sprintf(idstr, "# entry-id: %lu\n", (u_long)expargs->ep->ep_id);
-        rc = write(expargs->fd, idstr, strlen(idstr));
-        PR_ASSERT(rc > 0);
-    }
-    rc = write(expargs->fd, data.data, len);
-    PR_ASSERT(rc > 0);
-    rc = write(expargs->fd, "\n", 1);
-    PR_ASSERT(rc > 0);
-    rc = 0;
-    if ((*expargs->cnt) % 1000 == 0) {
-        int percent;
-
-        if (expargs->idl) {
-            percent = (expargs->idindex * 100 / expargs->idl->b_nids);
-        } else {
-            percent = (expargs->ep->ep_id * 100 / expargs->lastid);
-        }
-        if (expargs->task) {
-            slapi_task_log_status(expargs->task,
-                                  "%s: Processed %d entries (%d%%).",
-                                  inst->inst_name, *expargs->cnt, percent);
-            slapi_task_log_notice(expargs->task,
-                                  "%s: Processed %d entries (%d%%).",
-                                  inst->inst_name, *expargs->cnt, percent);
-        }
-        slapi_log_err(SLAPI_LOG_INFO, "bdb_export_one_entry", "export %s: Processed %d entries (%d%%).\n",
-                      inst->inst_name, *expargs->cnt, percent);
-        *expargs->lastcnt = *expargs->cnt;
+        char *keyed = slapi_ch_smprintf("# entry-id: %lu\n%s\n", (u_long)ep->ep_id, str);
+
+        slapi_ch_free_string(&str);
+        str = keyed;
+        len = strlen(str);
+    } else {
+        str = slapi_ch_realloc(str, len + 2);
+        str[len++] = '\n';
+        str[len] = '\0';
     }
-bail:
-    slapi_ch_free(&(data.data));
-    return rc;
+    *outlen = len;
+    return str;
+}
+
+/* Called by the export pipeline every 1000 exported entries */
+static void
+bdb_export_progress(void *arg, int cnt, int percent)
+{
+    export_args *expargs = (export_args *)arg;
+    ldbm_instance *inst = expargs->inst;
+
+    if (expargs->task) {
+        slapi_task_log_status(expargs->task,
+                              "%s: Processed %d entries (%d%%).",
+                              inst->inst_name, cnt, percent);
+        slapi_task_log_notice(expargs->task,
+                              "%s: Processed %d entries (%d%%).",
+                              inst->inst_name, cnt, percent);
+    }
+    slapi_log_err(SLAPI_LOG_INFO, "bdb_export_one_entry", "export %s: Processed %d entries (%d%%).\n",
+                  inst->inst_name, cnt, percent);
+    *expargs->lastcnt = cnt;
+}
+
+static int
+bdb_export_percent(export_args *expargs, ID id)
+{
+    if (expargs->idl) {
+        return expargs->idindex * 100 / expargs->idl->b_nids;
+    }
+    return id * 100 / expargs->lastid;
+}
+
+/*
+ * Hand expargs->ep to the export pipeline.  The entry belongs to the
+ * pipeline afterwards, even on error.
+ */
+static int
+bdb_export_one_entry(export_args *expargs)
+{
+    struct backentry *ep = expargs->ep;
+
+    expargs->ep = NULL;
+    return export_pipeline_submit(expargs->pipeline, ep, bdb_export_percent(expargs, ep->ep_id));
 }
 
 /*
@@ -981,6 +1006,26 @@ bdb_db2ldif(Slapi_PBlock *pb)
         idindex = 0;
     }
 
+    eargs.li = li;
+    eargs.inst = inst;
+    eargs.decrypt = decrypt;
+    eargs.options = options;
+    eargs.printkey = printkey;
+    eargs.idl = idl;
+    eargs.lastid = lastid;
+    eargs.fd = fd;
+    eargs.task = task;
+    eargs.include_suffix = include_suffix;
+    eargs.exclude_suffix = exclude_suffix;
+    eargs.lastcnt = &lastcnt;
+    eargs.pipeline = export_pipeline_new(inst, fd, fname, bdb_export_format_entry,
+                                         bdb_export_progress, &eargs);
+    if (eargs.pipeline == NULL) {
+        slapi_task_log_notice(task, "Backend %s: can't open the export stream on %s", inst->inst_name, fname);
+        return_value = -1;
+        goto bye;
+    }
+
     /* When user has specifically asked not to print the version
      * or when this is not the first backend that is append into
      * this file : don't print the version
@@ -993,21 +1038,13 @@ bdb_db2ldif(Slapi_PBlock *pb)
                  */
 
         sprintf(vstr, "version: %d\n\n", myversion);
-        rc = write(fd, vstr, strlen(vstr));
-        PR_ASSERT(rc > 0);
-        rc = 0;
+        rc = export_pipeline_write(eargs.pipeline, vstr, strlen(vstr));
+        if (rc) {
+            return_value = rc;
+            goto bye;
+        }
     }
 
-    eargs.decrypt = decrypt;
-    eargs.options = options;
-    eargs.printkey = printkey;
-    eargs.idl = idl;
-    eargs.lastid = lastid;
-    eargs.fd = fd;
-    eargs.task = task;
-    eargs.include_suffix = include_suffix;
-    eargs.exclude_suffix = exclude_suffix;
-
     while (keepgoing) {
         /*
          * All database operations in a transactional environment,
@@ -1071,10 +1108,11 @@ bdb_db2ldif(Slapi_PBlock *pb)
                 if (pending_ruv) {
                     eargs.ep = pending_ruv;
                     eargs.idindex = idindex;
-                    eargs.cnt = &cnt;
-                    eargs.lastcnt = &lastcnt;
-                    rc = bdb_export_one_entry(li, inst, &eargs);
-                    backentry_free(&pending_ruv);
+                    pending_ruv = NULL;
+                    rc = bdb_export_one_entry(&eargs);
+                    if (rc) {
+                        return_value = rc;
+                    }
                 }
                 break;
             }
@@ -1152,8 +1190,6 @@ bdb_db2ldif(Slapi_PBlock *pb)
                         !idl_id_is_in_idlist(eargs.pre_exported_idl, pid)) {
 
                         eargs.idindex = idindex;
-                        eargs.cnt = &cnt;
-                        eargs.lastcnt = &lastcnt;
 
                         rc = _export_or_index_parents(inst, db, NULL, temp_id,
                                                       rdn, temp_id, pid, run_from_cmdline,
@@ -1236,10 +1272,36 @@ bdb_db2ldif(Slapi_PBlock *pb)
                                       dn);
                     }
                 }
+                if (!skip_ruv && export_pipeline_is_parallel(eargs.pipeline)) {
+                    /* let an export thread parse the entry */
+                    eargs.idindex = idindex;
+                    rc = export_pipeline_submit_raw(eargs.pipeline, temp_id, dn, data.dptr, data.dsize,
+                                                    str2entry_options | SLAPI_STR2ENTRY_NO_ENTRYDN,
+                                                    bdb_export_percent(&eargs, temp_id));
+                    slapi_ch_free_string(&rdn);
+                    slapi_ch_free(&(data.data));
+                    backentry_free(&ep);
+                    if (rc) {
+                        return_value = rc;
+                        break;
+                    }
+                    continue;
+                }
                 ep->ep_entry = slapi_str2entry_ext(dn, NULL, data.dptr,
                                                    str2entry_options | SLAPI_STR2ENTRY_NO_ENTRYDN);
                 slapi_ch_free_string(&rdn);
             }
+        } else if (export_pipeline_is_parallel(eargs.pipeline)) {
+            eargs.idindex = idindex;
+            rc = export_pipeline_submit_raw(eargs.pipeline, temp_id, NULL, data.dptr, data.dsize,
+                                            str2entry_options, bdb_export_percent(&eargs, temp_id));
+            slapi_ch_free(&(data.data));
+            backentry_free(&ep);
+            if (rc) {
+                return_value = rc;
+                break;
+            }
+            continue;
         } else {
             ep->ep_entry = slapi_str2entry(data.dptr, str2entry_options);
         }
@@ -1267,15 +1329,23 @@ bdb_db2ldif(Slapi_PBlock *pb)
 
         eargs.ep = ep;
         eargs.idindex = idindex;
-        eargs.cnt = &cnt;
-        eargs.lastcnt = &lastcnt;
-        rc = bdb_export_one_entry(li, inst, &eargs);
-        backentry_free(&ep);
+        ep = NULL;
+        rc = bdb_export_one_entry(&eargs);
+        if (rc) {
+            return_value = rc;
+            break;
+        }
     }
     /* DB_NOTFOUND -> successful end */
     if (return_value == DB_NOTFOUND)
         return_value = 0;
 
+    /* wait for the entries still formatted or written */
+    rc = export_pipeline_done(&eargs.pipeline, &cnt);
+    if (rc && !return_value) {
+        return_value = rc;
+    }
+
     /* done cycling thru entries to write */
     if (lastcnt != cnt) {
         if (task) {
@@ -1297,6 +1367,7 @@ bdb_db2ldif(Slapi_PBlock *pb)
     }
 
 bye:
+    export_pipeline_done(&eargs.pipeline, NULL);
     if (idl) {
         idl_free(&idl);
     }
@@ -2157,7 +2228,7 @@ bdb_db2index(Slapi_PBlock *pb)
 
         ainfo_get(be, indexAttrs[i], &ai);
         PR_ASSERT(ai != NULL);
-        ai->ai_indexmask &= ~INDEX_OFFLINE;
+        ai->ai_indexmask &= ~(INDEX_OFFLINE | INDEX_SUBPOS_OFFLINE);
     }
     for (vlvidx = 0; vlvidx < numvlv; vlvidx++) {
         vlvIndex_go_online(pvlv[vlvidx], be);
@@ -2778,7 +2849,6 @@ _get_and_add_parent_rdns(backend *be,
     Slapi_RDN mysrdn = {0};
     struct backdn *bdn = NULL;
     ldbm_instance *inst = NULL;
-    struct ldbminfo *li = NULL;
     struct backentry *ep = NULL;
     char *rdn = NULL;
     DBT key, data;
@@ -2797,7 +2867,6 @@ _get_and_add_parent_rdns(backend *be,
     }
 
     inst = (ldbm_instance *)be->be_instance_info;
-    li = inst->inst_li;
     memset(&data, 0, sizeof(data));
 
     /* first, try the dn cache */
@@ -2965,11 +3034,11 @@ _get_and_add_parent_rdns(backend *be,
             goto bail;
         }
         eargs->ep = ep;
-        rc = bdb_export_one_entry(li, inst, eargs);
+        ep = NULL;
+        rc = bdb_export_one_entry(eargs);
         if (rc) {
             slapi_log_err(SLAPI_LOG_ERR, "_get_and_add_parent_rdns",
-                          "Failed to export an entry %s\n",
-                          slapi_sdn_get_dn(slapi_entry_get_sdn(ep->ep_entry)));
+                          "Failed to export the entry %d\n", id);
             goto bail;
         }
         rc = idl_append_extend(&(eargs->pre_exported_idl), id);
@@ -468,6 +468,57 @@ dbmdb_ctx_t_db_durable_transactions_set(void *arg, void *value, char *errorbuf _
     return retval;
 }
 
+static void *
+dbmdb_ctx_t_online_reindex_get(void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    return (void *)((uintptr_t)(MDB_CONFIG(li)->dsecfg.online_reindex));
+}
+
+static int
+dbmdb_ctx_t_online_reindex_set(void *arg, void *value, char *errorbuf __attribute__((unused)), int phase __attribute__((unused)), int apply)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+    int val = (int)((uintptr_t)value);
+
+    if (apply) {
+        MDB_CONFIG(li)->dsecfg.online_reindex = val;
+    }
+
+    return LDAP_SUCCESS;
+}
+
+static void *
+dbmdb_ctx_t_online_reindex_rate_get(void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    return (void *)((uintptr_t)(MDB_CONFIG(li)->dsecfg.online_reindex_rate));
+}
+
+static int
+dbmdb_ctx_t_online_reindex_rate_set(void *arg, void *value, char *errorbuf, int phase __attribute__((unused)), int apply)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+    int val = (int)((uintptr_t)value);
+
+    if (val < 0) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "Error: Invalid value for %s (%d). The value must be 0 (no limit) or a positive number of entries per second",
+                              CONFIG_MDB_ONLINE_REINDEX_RATE, val);
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_ctx_t_online_reindex_rate_set",
+                      "Invalid value for %s (%d). The value must be 0 (no limit) or a positive number of entries per second\n",
+                      CONFIG_MDB_ONLINE_REINDEX_RATE, val);
+        return LDAP_UNWILLING_TO_PERFORM;
+    }
+    if (apply) {
+        MDB_CONFIG(li)->dsecfg.online_reindex_rate = val;
+    }
+
+    return LDAP_SUCCESS;
+}
+
 static int
 dbmdb_ctx_t_set_bypass_filter_test(void *arg,
                                    void *value,
@@ -547,6 +598,8 @@ static config_info dbmdb_ctx_t_param[] = {
     {CONFIG_MDB_MAX_SIZE, CONFIG_TYPE_UINT64, "0", &dbmdb_ctx_t_db_max_size_get, &dbmdb_ctx_t_db_max_size_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {CONFIG_MDB_MAX_READERS, CONFIG_TYPE_INT, "0", &dbmdb_ctx_t_db_max_readers_get, &dbmdb_ctx_t_db_max_readers_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {CONFIG_MDB_MAX_DBS, CONFIG_TYPE_INT, "512", &dbmdb_ctx_t_db_max_dbs_get, &dbmdb_ctx_t_db_max_dbs_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
+    {CONFIG_MDB_ONLINE_REINDEX, CONFIG_TYPE_ONOFF, "off", &dbmdb_ctx_t_online_reindex_get, &dbmdb_ctx_t_online_reindex_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
+    {CONFIG_MDB_ONLINE_REINDEX_RATE, CONFIG_TYPE_INT, "0", &dbmdb_ctx_t_online_reindex_rate_get, &dbmdb_ctx_t_online_reindex_rate_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {CONFIG_MAXPASSBEFOREMERGE, CONFIG_TYPE_INT, "100", &dbmdb_ctx_t_maxpassbeforemerge_get, &dbmdb_ctx_t_maxpassbeforemerge_set, 0},
     {CONFIG_DB_DURABLE_TRANSACTIONS, CONFIG_TYPE_ONOFF, "on", &dbmdb_ctx_t_db_durable_transactions_get, &dbmdb_ctx_t_db_durable_transactions_set, CONFIG_FLAG_ALWAYS_SHOW},
     {CONFIG_BYPASS_FILTER_TEST, CONFIG_TYPE_STRING, "on", &dbmdb_ctx_t_get_bypass_filter_test, &dbmdb_ctx_t_set_bypass_filter_test, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
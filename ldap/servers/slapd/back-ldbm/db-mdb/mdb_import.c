@@ -726,7 +726,7 @@ dbmdb_import_all_done(ImportJob *job, int ret)
         */
         IndexInfo *index = job->index_list;
         while (index != NULL) {
-            index->ai->ai_indexmask &= ~INDEX_OFFLINE;
+            index->ai->ai_indexmask &= ~(INDEX_OFFLINE | INDEX_SUBPOS_OFFLINE);
             index = index->next;
         }
         /* start up the instance */
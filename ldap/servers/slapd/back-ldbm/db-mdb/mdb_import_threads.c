@@ -988,6 +988,27 @@ entryinfoparam_cleanup(EntryInfoParam_t *param)
     slapi_ch_free_string(&param->puuid);
 }
 
+/* Extract the dn and the uniqueids from an ldif entry
+ * (does not need the private db so it may be called by the ldif scanner threads)
+ */
+static dnrc_t
+dbmdb_import_ldifentry_param(const char *data, int first, EntryInfoParam_t *param, char **dn)
+{
+    if (get_value_from_string(data, "dn", dn)) {
+        if (strncmp(data, "version:", 8) == 0 && first) {
+            return DNRC_VERSION;
+        } else {
+            return DNRC_NODN;
+        }
+    }
+    get_value_from_string(data, SLAPI_ATTR_UNIQUEID, &param->uuid);
+    if (PL_strncasecmp(*dn, SLAPI_ATTR_UNIQUEID, SLAPI_ATTR_UNIQUEID_LENGTH) == 0) {
+        get_value_from_string(data, "nsparentuniqueid", &param->puuid);
+    }
+    slapi_sdn_init_dn_byval(&param->sdn, *dn);
+    return DNRC_OK;
+}
+
 /* Extract the dn from entry, compute nrdn, rdn, parent ndn and ancestors ids
  * store ndn -> entryinfo in a private db (to retrieve the parent infos)
  * Note: we just use raw ID without taking care of endianess as
@@ -1002,19 +1023,11 @@ dbmdb_import_entry_info_by_ldifentry(mdb_privdb_t *db, WorkerQueueData_t *wqelmt
 
     wqelmt->parent_info = NULL;
     wqelmt->entry_info = NULL;
-    if (get_value_from_string(wqelmt->data, "dn", &dn)) {
-        if (strncmp(wqelmt->data, "version:", 8) == 0 && wqelmt->lineno<=1) {
-            return DNRC_VERSION;
-        } else {
-            return DNRC_NODN;
-        }
-    }
-    get_value_from_string(wqelmt->data, SLAPI_ATTR_UNIQUEID, &param.uuid);
-    if (PL_strncasecmp(dn, SLAPI_ATTR_UNIQUEID, SLAPI_ATTR_UNIQUEID_LENGTH) == 0) {
-        get_value_from_string(wqelmt->data, "nsparentuniqueid", &param.puuid);
+    dnrc = dbmdb_import_ldifentry_param(wqelmt->data, wqelmt->lineno <= 1, &param, &dn);
+    if (dnrc != DNRC_OK) {
+        return dnrc;
     }
     param.db = db;
-    slapi_sdn_init_dn_byval(&param.sdn, dn);
     param.eid = wqelmt->wait_id;
     param.flags = EIP_NONE;
     wqelmt->dn = dn;
@@ -1023,6 +1036,55 @@ dbmdb_import_entry_info_by_ldifentry(mdb_privdb_t *db, WorkerQueueData_t *wqelmt
     return dnrc;
 }
 
+/* Entry info parameters prepared by the ldif scanner threads */
+typedef struct {
+    dnrc_t dnrc;
+    char *dn;
+    EntryInfoParam_t param;
+} LdifEntryParam_t;
+
+/* ldif scanner callback: extract the dn and normalize it */
+static void
+dbmdb_import_prepare_ldifentry(ImportJob *job __attribute__((unused)), ImportLdifRecord *rec)
+{
+    LdifEntryParam_t *lep = CALLOC(LdifEntryParam_t);
+
+    lep->dnrc = dbmdb_import_ldifentry_param(rec->data, rec->first, &lep->param, &lep->dn);
+    if (lep->dnrc == DNRC_OK) {
+        (void)slapi_sdn_get_ndn(&lep->param.sdn);
+    }
+    rec->prepared = lep;
+}
+
+static void
+dbmdb_import_release_ldifentry(ImportLdifRecord *rec)
+{
+    LdifEntryParam_t *lep = rec->prepared;
+
+    if (lep) {
+        entryinfoparam_cleanup(&lep->param);
+        slapi_ch_free_string(&lep->dn);
+        slapi_ch_free(&rec->prepared);
+    }
+}
+
+/* Same as dbmdb_import_entry_info_by_ldifentry for an entry prepared by the ldif scanner */
+static dnrc_t
+dbmdb_import_entry_info_by_scanned_entry(mdb_privdb_t *db, WorkerQueueData_t *wqelmt, LdifEntryParam_t *lep)
+{
+    wqelmt->parent_info = NULL;
+    wqelmt->entry_info = NULL;
+    if (lep->dnrc != DNRC_OK) {
+        return lep->dnrc;
+    }
+    lep->param.db = db;
+    lep->param.eid = wqelmt->wait_id;
+    lep->param.flags = EIP_NONE;
+    wqelmt->dn = lep->dn;
+    lep->dn = NULL;
+    return dbmdb_import_entry_info_by_param(&lep->param, wqelmt);
+}
+
 
 /* Extract the rdn and parentid from entry, compute nrdn, parent ndn and ancestors ids
  * store id -> entryinfo in a private db (to retrieve the parent infos)
@@ -1124,6 +1186,7 @@ dbmdb_import_producer(void *param)
     char *curr_filename = NULL;
     int idx;
     ldif_context c;
+    ImportLdifScan *scan = NULL;
     WorkerQueueData_t wqelmt = {0};
     mdb_privdb_t *dndb = NULL;
     WorkerQueueData_t ruvwqelmt = {0};
@@ -1160,7 +1223,7 @@ dbmdb_import_producer(void *param)
         /* move on to next file? */
         if (detected_eof) {
             /* check if the file can still be read, whine if so... */
-            if (read(fd, (void *)&idx, 1) > 0) {
+            if (!scan && read(fd, (void *)&idx, 1) > 0) {
                 import_log_notice(job, SLAPI_LOG_WARNING, "dbmdb_import_producer",
                                   "Unexpected end of file found at line %d of file \"%s\"",
                                   curr_lineno, curr_filename);
@@ -1175,6 +1238,7 @@ dbmdb_import_producer(void *param)
                                  "Finished scanning file \"%s\" (%lu entries)",
                                   curr_filename, (u_long)(id - id_filestart));
             }
+            import_ldif_scan_stop(&scan);
             close(fd);
             fd = -1;
             detected_eof = 0;
@@ -1215,22 +1279,50 @@ dbmdb_import_producer(void *param)
             } else {
                 import_log_notice(job, SLAPI_LOG_INFO, "dbmdb_import_producer",
                                   "Processing file \"%s\"", curr_filename);
+                /* Split the parsing of big files among several threads */
+                scan = import_ldif_scan_start(job, fd, dbmdb_import_prepare_ldifentry,
+                                              dbmdb_import_release_ldifentry);
             }
         }
         wait_for_starting(info);
         wqelmt.winfo.job = job;
         wqelmt.wait_id = id;
-        wqelmt.lineno = curr_lineno + 1;  /* Human tends to start counting from 1 rather than 0 */
-        wqelmt.data = dbmdb_import_get_entry(&c, fd, &curr_lineno);
-        wqelmt.nblines = curr_lineno - wqelmt.lineno;
-        wqelmt.datalen = 0;
-        if (!wqelmt.data) {
-            /* error reading entry, or end of file */
-            detected_eof = 1;
-            continue;
+        if (scan) {
+            ImportLdifRecord rec = {0};
+
+            if (import_ldif_scan_next(scan, &rec) < 0) {
+                import_log_notice(job, SLAPI_LOG_ERR, "dbmdb_import_producer",
+                                  "Could not read LDIF file \"%s\", errno %d (%s)",
+                                  curr_filename, errno, slapd_system_strerror(errno));
+                thread_abort(info);
+                break;
+            }
+            wqelmt.lineno = rec.lineno;
+            wqelmt.nblines = rec.nblines;
+            wqelmt.data = rec.data;
+            curr_lineno = rec.lineno + rec.nblines - 1;
+            wqelmt.datalen = 0;
+            if (!wqelmt.data) {
+                /* end of file */
+                detected_eof = 1;
+                continue;
+            }
+            wqelmt.datalen = rec.datalen;
+            wqelmt.dnrc = dbmdb_import_entry_info_by_scanned_entry(dndb, &wqelmt, rec.prepared);
+            dbmdb_import_release_ldifentry(&rec);
+        } else {
+            wqelmt.lineno = curr_lineno + 1;  /* Human tends to start counting from 1 rather than 0 */
+            wqelmt.data = dbmdb_import_get_entry(&c, fd, &curr_lineno);
+            wqelmt.nblines = curr_lineno - wqelmt.lineno;
+            wqelmt.datalen = 0;
+            if (!wqelmt.data) {
+                /* error reading entry, or end of file */
+                detected_eof = 1;
+                continue;
+            }
+            wqelmt.datalen = strlen(wqelmt.data);
+            wqelmt.dnrc = dbmdb_import_entry_info_by_ldifentry(dndb, &wqelmt);
         }
-        wqelmt.datalen = strlen(wqelmt.data);
-        wqelmt.dnrc = dbmdb_import_entry_info_by_ldifentry(dndb, &wqelmt);
         switch (wqelmt.dnrc) {
             default:
                 import_log_notice(job, SLAPI_LOG_ERR, "dbmdb_import_producer",
@@ -1338,6 +1430,7 @@ dbmdb_import_producer(void *param)
         slapi_task_set_warning(job->task, WARN_SKIPPED_IMPORT_ENTRY);
     }
 
+    import_ldif_scan_stop(&scan);
     if (fd >= 0)
         close(fd);
     slapi_value_free(&(job->usn_value));
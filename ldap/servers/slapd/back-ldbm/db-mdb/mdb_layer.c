@@ -18,6 +18,8 @@
 #include <assert.h>
 #include <prclist.h>
 #include <glob.h>
+#include <pk11pub.h>
+#include <sechash.h>
 
 Slapi_ComponentId *dbmdb_componentid;
 
@@ -83,6 +85,7 @@ static int dbmdb_force_checkpoint(struct ldbminfo *li);
 #define FLUSH_REMOTEOFF 0
 
 static const char *backupfilelists[] = { INFOFILE, DBMAPFILE, DSE_INSTANCE, DSE_INDEX, NULL };
+static const char *incrbackupfilelists[] = { DBMAPSUMS, DBMAPDELTA, DBMAPBASE, NULL };
 
 /*
  * return nsslapd-db-home-directory (dbmdb_dbhome_directory), if exists.
@@ -864,6 +867,419 @@ error:
     return return_value;
 }
 
+/*
+ * Incremental backups
+ *
+ * The map is not copied with mdb_env_copy but streamed through a pipe by
+ * mdb_env_copyfd2 (so LMDB still provides a consistent snapshot) and cut
+ * in chunks. The digest of every chunk is stored in DBMAPSUMS next to the
+ * backup. When a base backup is provided (nsArchiveBaseDir), the chunks
+ * whose digest did not change since that backup are skipped and the other
+ * ones are written in DBMAPDELTA, along with the digest of the DBMAPSUMS
+ * of the base backup. The restore checks that every delta of the chain
+ * still matches its base, then rebuilds the map from the base backup
+ * (which may itself be incremental) and applies the delta.
+ */
+#define BACKUP_CHUNK_SIZE   (256 * 1024)
+#define BACKUP_DIGEST_LEN   SHA256_LENGTH
+#define BACKUP_SUMS_MAGIC   "MDBSUMS1"
+#define BACKUP_DELTA_MAGIC  "MDBDELT2"
+#define BACKUP_MAX_CHAIN    64      /* max number of incremental backups in a chain */
+
+typedef struct
+{
+    char magic[8];
+    uint32_t chunk_size;
+    uint32_t reserved;
+    uint64_t map_size;      /* size of the map once restored */
+} dbmdb_backup_header_t;
+
+typedef struct
+{
+    dbmdb_backup_header_t hdr;
+    unsigned char base_digest[BACKUP_DIGEST_LEN]; /* digest of the DBMAPSUMS of the base backup */
+} dbmdb_delta_header_t;
+
+typedef struct
+{
+    uint64_t offset;
+    uint32_t len;
+    uint32_t reserved;
+} dbmdb_delta_record_t;
+
+typedef struct
+{
+    MDB_env *env;
+    int fd;
+    int rc;
+} dbmdb_backup_copy_t;
+
+static int
+dbmdb_write_all(int fd, const void *buf, size_t len)
+{
+    const char *pt = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, pt, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        pt += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Read len bytes unless end of file is reached. Returns the number of bytes read or -1 */
+static ssize_t
+dbmdb_read_all(int fd, void *buf, size_t len)
+{
+    char *pt = buf;
+    size_t total = 0;
+
+    while (total < len) {
+        ssize_t n = read(fd, pt + total, len - total);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+static void
+dbmdb_backup_copy_thread(void *arg)
+{
+    dbmdb_backup_copy_t *copy = arg;
+
+    copy->rc = mdb_env_copyfd2(copy->env, copy->fd, 0);
+    close(copy->fd);
+}
+
+/* Load the chunk digests of a backup. Returns NULL if the backup has none */
+static unsigned char *
+dbmdb_backup_read_sums(const char *dir, uint64_t *nbchunks)
+{
+    char *path = slapi_ch_smprintf("%s/%s", dir, DBMAPSUMS);
+    dbmdb_backup_header_t hdr = {0};
+    unsigned char *sums = NULL;
+    size_t len;
+    int fd;
+
+    *nbchunks = 0;
+    fd = open(path, O_RDONLY);
+    slapi_ch_free_string(&path);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (dbmdb_read_all(fd, &hdr, sizeof hdr) != sizeof hdr ||
+        memcmp(hdr.magic, BACKUP_SUMS_MAGIC, sizeof hdr.magic) != 0 ||
+        hdr.chunk_size != BACKUP_CHUNK_SIZE) {
+        close(fd);
+        return NULL;
+    }
+    *nbchunks = (hdr.map_size + BACKUP_CHUNK_SIZE - 1) / BACKUP_CHUNK_SIZE;
+    len = *nbchunks * BACKUP_DIGEST_LEN;
+    sums = (unsigned char *)slapi_ch_malloc(len ? len : 1);
+    if (dbmdb_read_all(fd, sums, len) != len) {
+        slapi_ch_free((void **)&sums);
+        *nbchunks = 0;
+    }
+    close(fd);
+    return sums;
+}
+
+/* Digest of the DBMAPSUMS of a backup, identifying the map a delta applies to */
+static int
+dbmdb_backup_sums_digest(const char *dir, unsigned char *digest)
+{
+    char *path = slapi_ch_smprintf("%s/%s", dir, DBMAPSUMS);
+    PK11Context *c = NULL;
+    char *buf = NULL;
+    unsigned int len = 0;
+    ssize_t n = -1;
+    int rc = -1;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    slapi_ch_free_string(&path);
+    if (fd < 0) {
+        return rc;
+    }
+    c = PK11_CreateDigestContext(SEC_OID_SHA256);
+    if (c != NULL && PK11_DigestBegin(c) == SECSuccess) {
+        buf = slapi_ch_malloc(BACKUP_CHUNK_SIZE);
+        while ((n = dbmdb_read_all(fd, buf, BACKUP_CHUNK_SIZE)) > 0 &&
+               PK11_DigestOp(c, (unsigned char *)buf, n) == SECSuccess)
+            ;
+        if (n == 0 && PK11_DigestFinal(c, digest, &len, BACKUP_DIGEST_LEN) == SECSuccess &&
+            len == BACKUP_DIGEST_LEN) {
+            rc = 0;
+        }
+    }
+    if (c != NULL) {
+        PK11_DestroyContext(c, PR_TRUE);
+    }
+    slapi_ch_free((void **)&buf);
+    close(fd);
+    return rc;
+}
+
+/*
+ * Write the map in dest_dir: either whole (DBMAPFILE) or, when base_dir
+ * is set, only the chunks that changed since that backup (DBMAPDELTA).
+ */
+static int
+dbmdb_backup_map(struct ldbminfo *li, const char *dest_dir, const char *base_dir, Slapi_Task *task)
+{
+    dbmdb_ctx_t *conf = MDB_CONFIG(li);
+    dbmdb_backup_copy_t copy = {0};
+    dbmdb_backup_header_t hdr = {0};
+    dbmdb_delta_header_t delta_hdr = {0};
+    unsigned char digest[BACKUP_DIGEST_LEN];
+    unsigned char *base_sums = NULL;
+    uint64_t base_nbchunks = 0;
+    uint64_t size = 0;
+    uint64_t written = 0;
+    uint64_t skipped = 0;
+    uint64_t chunk;
+    struct timespec start, end;
+    double elapsed;
+    PRThread *thread = NULL;
+    char *buf = NULL;
+    char *path = NULL;
+    int pipefd[2] = {-1, -1};
+    int sums_fd = -1;
+    int out_fd = -1;
+    int rc = -1;
+
+    if (base_dir) {
+        base_sums = dbmdb_backup_read_sums(base_dir, &base_nbchunks);
+        if (base_sums == NULL || dbmdb_backup_sums_digest(base_dir, delta_hdr.base_digest)) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup",
+                          "%s is not a backup that an incremental backup can be based on.\n", base_dir);
+            if (task) {
+                slapi_task_log_notice(task, "dbmdb_backup - %s is not a backup that an incremental backup can be based on.",
+                                      base_dir);
+            }
+            return -1;
+        }
+        path = slapi_ch_smprintf("%s/%s", dest_dir, DBMAPBASE);
+        out_fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, li->li_mode | 0400);
+        if (out_fd < 0 || dbmdb_write_all(out_fd, base_dir, strlen(base_dir)) ||
+            dbmdb_write_all(out_fd, "\n", 1)) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to write %s: %s\n", path, strerror(errno));
+            goto bail;
+        }
+        close(out_fd);
+        slapi_ch_free_string(&path);
+        path = slapi_ch_smprintf("%s/%s", dest_dir, DBMAPDELTA);
+    } else {
+        path = slapi_ch_smprintf("%s/%s", dest_dir, DBMAPFILE);
+    }
+    out_fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, li->li_mode | 0400);
+    if (out_fd < 0) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to open %s: %s\n", path, strerror(errno));
+        goto bail;
+    }
+    slapi_ch_free_string(&path);
+    path = slapi_ch_smprintf("%s/%s", dest_dir, DBMAPSUMS);
+    sums_fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, li->li_mode | 0400);
+    if (sums_fd < 0) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to open %s: %s\n", path, strerror(errno));
+        goto bail;
+    }
+    /* Headers are rewritten once the map size is known */
+    if (dbmdb_write_all(sums_fd, &hdr, sizeof hdr) ||
+        (base_dir && dbmdb_write_all(out_fd, &delta_hdr, sizeof delta_hdr))) {
+        goto bail;
+    }
+
+    if (pipe(pipefd) < 0) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to create pipe: %s\n", strerror(errno));
+        goto bail;
+    }
+    copy.env = conf->env;
+    copy.fd = pipefd[1];
+    thread = PR_CreateThread(PR_USER_THREAD, dbmdb_backup_copy_thread, &copy,
+                             PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD, PR_JOINABLE_THREAD,
+                             SLAPD_DEFAULT_THREAD_STACKSIZE);
+    if (thread == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to create the copy thread\n");
+        close(pipefd[1]);
+        goto bail;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    buf = slapi_ch_malloc(BACKUP_CHUNK_SIZE);
+    rc = 0;
+    for (chunk = 0; rc == 0; chunk++) {
+        ssize_t len = dbmdb_read_all(pipefd[0], buf, BACKUP_CHUNK_SIZE);
+        if (len <= 0) {
+            rc = len;
+            break;
+        }
+        if (g_get_shutdown() || c_get_shutdown()) {
+            slapi_log_err(SLAPI_LOG_WARNING, "dbmdb_backup", "Server shutting down, backup aborted\n");
+            rc = -1;
+            break;
+        }
+        PK11_HashBuf(SEC_OID_SHA256, digest, (unsigned char *)buf, len);
+        rc = dbmdb_write_all(sums_fd, digest, sizeof digest);
+        if (rc == 0 && base_dir && chunk < base_nbchunks &&
+            memcmp(digest, base_sums + chunk * BACKUP_DIGEST_LEN, BACKUP_DIGEST_LEN) == 0) {
+            skipped += len;
+        } else if (rc == 0 && base_dir) {
+            dbmdb_delta_record_t rec = {0};
+            rec.offset = size;
+            rec.len = len;
+            rc = dbmdb_write_all(out_fd, &rec, sizeof rec);
+            if (rc == 0) {
+                rc = dbmdb_write_all(out_fd, buf, len);
+            }
+            written += len;
+        } else if (rc == 0) {
+            rc = dbmdb_write_all(out_fd, buf, len);
+            written += len;
+        }
+        size += len;
+    }
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to write the backup of the map: %s\n", strerror(errno));
+    }
+    /* Unblocks the copy thread if we stopped early */
+    close(pipefd[0]);
+    pipefd[0] = -1;
+    PR_JoinThread(thread);
+    if (copy.rc) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to copy the mdb database. Error %d: %s\n",
+                      copy.rc, mdb_strerror(copy.rc));
+        rc = -1;
+    }
+    if (rc == 0) {
+        memcpy(hdr.magic, BACKUP_SUMS_MAGIC, sizeof hdr.magic);
+        hdr.chunk_size = BACKUP_CHUNK_SIZE;
+        hdr.map_size = size;
+        rc = (pwrite(sums_fd, &hdr, sizeof hdr, 0) != sizeof hdr);
+        if (rc == 0 && base_dir) {
+            delta_hdr.hdr = hdr;
+            memcpy(delta_hdr.hdr.magic, BACKUP_DELTA_MAGIC, sizeof delta_hdr.hdr.magic);
+            rc = (pwrite(out_fd, &delta_hdr, sizeof delta_hdr, 0) != sizeof delta_hdr);
+        }
+        if (rc == 0) {
+            rc = fsync(out_fd) || fsync(sums_fd);
+        }
+    }
+    if (rc == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (elapsed <= 0) {
+            elapsed = 1e-9;
+        }
+        slapi_log_err(SLAPI_LOG_INFO, "dbmdb_backup",
+                      "Backed up %" PRIu64 " MB of database map at %.1f MB/s: %" PRIu64 " MB written, %" PRIu64 " MB unchanged since %s\n",
+                      size >> 20, (size >> 20) / elapsed, written >> 20, skipped >> 20, base_dir ? base_dir : "-");
+        if (task) {
+            slapi_task_log_notice(task, "Backed up %" PRIu64 " MB of database map at %.1f MB/s: %" PRIu64 " MB written, %" PRIu64 " MB skipped (unchanged)",
+                                  size >> 20, (size >> 20) / elapsed, written >> 20, skipped >> 20);
+            slapi_task_log_status(task, "Backed up %" PRIu64 " MB of database map at %.1f MB/s: %" PRIu64 " MB written, %" PRIu64 " MB skipped (unchanged)",
+                                  size >> 20, (size >> 20) / elapsed, written >> 20, skipped >> 20);
+        }
+    }
+
+bail:
+    if (pipefd[0] >= 0) {
+        close(pipefd[0]);
+    }
+    if (sums_fd >= 0) {
+        close(sums_fd);
+    }
+    if (out_fd >= 0) {
+        close(out_fd);
+    }
+    slapi_ch_free_string(&path);
+    slapi_ch_free((void **)&buf);
+    slapi_ch_free((void **)&base_sums);
+    return rc ? -1 : 0;
+}
+
+/* Returns the directory of the backup that an incremental backup is based on */
+static char *
+dbmdb_backup_read_base(const char *dir)
+{
+    char *path = slapi_ch_smprintf("%s/%s", dir, DBMAPBASE);
+    char buf[MAXPATHLEN + 1];
+    ssize_t len = -1;
+    int fd = open(path, O_RDONLY);
+
+    slapi_ch_free_string(&path);
+    if (fd >= 0) {
+        len = dbmdb_read_all(fd, buf, sizeof buf - 1);
+        close(fd);
+    }
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) {
+        len--;
+    }
+    if (len <= 0) {
+        return NULL;
+    }
+    buf[len] = '\0';
+    return slapi_ch_strdup(buf);
+}
+
+/* Apply the chunks of an incremental backup on the restored map */
+static int
+dbmdb_restore_delta(const char *deltapath, const char *mappath)
+{
+    dbmdb_delta_header_t hdr = {0};
+    dbmdb_delta_record_t rec;
+    char *buf = slapi_ch_malloc(BACKUP_CHUNK_SIZE);
+    int delta_fd = open(deltapath, O_RDONLY);
+    int map_fd = open(mappath, O_WRONLY);
+    ssize_t len;
+    int rc = -1;
+
+    if (delta_fd < 0 || map_fd < 0 ||
+        dbmdb_read_all(delta_fd, &hdr, sizeof hdr) != sizeof hdr ||
+        memcmp(hdr.hdr.magic, BACKUP_DELTA_MAGIC, sizeof hdr.hdr.magic) != 0 ||
+        hdr.hdr.chunk_size != BACKUP_CHUNK_SIZE) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore", "Failed to open %s or %s, or invalid delta file\n",
+                      deltapath, mappath);
+        goto bail;
+    }
+    while ((len = dbmdb_read_all(delta_fd, &rec, sizeof rec)) == sizeof rec) {
+        if (rec.len > BACKUP_CHUNK_SIZE || dbmdb_read_all(delta_fd, buf, rec.len) != rec.len ||
+            pwrite(map_fd, buf, rec.len, rec.offset) != rec.len) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore", "Failed to apply %s at offset %" PRIu64 "\n",
+                          deltapath, rec.offset);
+            goto bail;
+        }
+    }
+    if (len != 0 || ftruncate(map_fd, hdr.hdr.map_size) || fsync(map_fd)) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore", "Failed to apply %s (truncated delta file?)\n", deltapath);
+        goto bail;
+    }
+    rc = 0;
+bail:
+    if (delta_fd >= 0) {
+        close(delta_fd);
+    }
+    if (map_fd >= 0) {
+        close(map_fd);
+    }
+    slapi_ch_free((void **)&buf);
+    return rc;
+}
+
 /* Destination Directory is an absolute pathname */
 int
 dbmdb_backup(struct ldbminfo *li, char *dest_dir, Slapi_Task *task)
@@ -923,8 +1339,8 @@ dbmdb_backup(struct ldbminfo *li, char *dest_dir, Slapi_Task *task)
         }
         goto error_out;
     }
-    /* Copy the mdb database */
-    return_value = mdb_env_copy(conf->env, dest_dir);
+    /* Copy the mdb database (or what changed since the base backup) */
+    return_value = dbmdb_backup_map(li, dest_dir, li->li_backup_base_dir, task);
     if (return_value) {
         slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to backup mdb database to %s.\n", dest_dir);
         if (task) {
@@ -978,6 +1394,11 @@ error_out:
         unlink(pathname2);
         slapi_ch_free_string(&pathname2);
     }
+    for (pt=incrbackupfilelists; *pt; pt++) {
+        pathname2 = slapi_ch_smprintf("%s/%s", dest_dir, *pt);
+        unlink(pathname2);
+        slapi_ch_free_string(&pathname2);
+    }
     rmdir(dest_dir);
     return_value = LDAP_UNWILLING_TO_PERFORM;
 bail:
@@ -1015,12 +1436,126 @@ dbmdb_restore_file(struct ldbminfo *li, Slapi_Task *task, const char *src_dir, c
     return 0;
 }
 
+/*
+ * Check that every incremental backup of the chain starting at src_dir
+ * was taken on top of the backup currently found in its base directory.
+ * Nothing may be restored otherwise: the deltas would be applied on
+ * another map.
+ */
+static int
+dbmdb_restore_check_chain(Slapi_Task *task, const char *src_dir)
+{
+    char *dir = slapi_ch_strdup(src_dir);
+    int depth;
+    int rc = 0;
+
+    for (depth = 0; rc == 0; depth++) {
+        char *deltapath = slapi_ch_smprintf("%s/%s", dir, DBMAPDELTA);
+        unsigned char digest[BACKUP_DIGEST_LEN];
+        dbmdb_delta_header_t hdr = {0};
+        char *base_dir = NULL;
+        int fd = open(deltapath, O_RDONLY);
+
+        slapi_ch_free_string(&deltapath);
+        if (fd < 0) {
+            /* A full backup ends the chain: its map must be readable */
+            char *mappath = slapi_ch_smprintf("%s/%s", dir, DBMAPFILE);
+            struct stat sbuf;
+
+            if (stat(mappath, &sbuf) < 0 || sbuf.st_size == 0 ||
+                (fd = open(mappath, O_RDONLY)) < 0) {
+                slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore",
+                              "Cannot read %s, the backup chain is incomplete.\n", mappath);
+                if (task) {
+                    slapi_task_log_notice(task, "Restore: cannot read %s, the backup chain is incomplete.", mappath);
+                }
+                rc = -1;
+            } else {
+                close(fd);
+            }
+            slapi_ch_free_string(&mappath);
+            break;
+        }
+        if (dbmdb_read_all(fd, &hdr, sizeof hdr) != sizeof hdr ||
+            memcmp(hdr.hdr.magic, BACKUP_DELTA_MAGIC, sizeof hdr.hdr.magic) != 0 ||
+            hdr.hdr.chunk_size != BACKUP_CHUNK_SIZE) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore", "Invalid delta file in %s\n", dir);
+            if (task) {
+                slapi_task_log_notice(task, "Restore: invalid delta file in %s.", dir);
+            }
+            rc = -1;
+        } else if (depth >= BACKUP_MAX_CHAIN || (base_dir = dbmdb_backup_read_base(dir)) == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore",
+                          "Cannot find the backup that %s is based on.\n", dir);
+            if (task) {
+                slapi_task_log_notice(task, "Restore: cannot find the backup that %s is based on.", dir);
+            }
+            rc = -1;
+        } else if (dbmdb_backup_sums_digest(base_dir, digest) ||
+                   memcmp(digest, hdr.base_digest, sizeof digest) != 0) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore",
+                          "%s is not the backup that %s is based on.\n", base_dir, dir);
+            if (task) {
+                slapi_task_log_notice(task, "Restore: %s is not the backup that %s is based on.", base_dir, dir);
+            }
+            rc = -1;
+        }
+        close(fd);
+        slapi_ch_free_string(&dir);
+        dir = base_dir;
+    }
+    slapi_ch_free_string(&dir);
+    return rc;
+}
+
+/*
+ * Restore the map of a backup: copy it, or for an incremental backup,
+ * restore the backup it is based on then apply the delta.
+ */
+static int
+dbmdb_restore_map(struct ldbminfo *li, Slapi_Task *task, const char *src_dir, int depth)
+{
+    char *deltapath = slapi_ch_smprintf("%s/%s", src_dir, DBMAPDELTA);
+    char *mappath = NULL;
+    char *base_dir = NULL;
+    struct stat sbuf;
+    int rc = -1;
+
+    if (stat(deltapath, &sbuf) < 0) {
+        slapi_ch_free_string(&deltapath);
+        return dbmdb_restore_file(li, task, src_dir, DBMAPFILE);
+    }
+    if (depth >= BACKUP_MAX_CHAIN || (base_dir = dbmdb_backup_read_base(src_dir)) == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore",
+                      "Cannot find the backup that %s is based on.\n", src_dir);
+        if (task) {
+            slapi_task_log_notice(task, "Restore: cannot find the backup that %s is based on.", src_dir);
+        }
+        goto bail;
+    }
+    rc = dbmdb_restore_map(li, task, base_dir, depth + 1);
+    if (rc == 0) {
+        mappath = slapi_ch_smprintf("%s/%s", MDB_CONFIG(li)->home, DBMAPFILE);
+        slapi_log_err(SLAPI_LOG_INFO, "dbmdb_restore", "Applying %s\n", deltapath);
+        if (task) {
+            slapi_task_log_notice(task, "Restore: applying %s", deltapath);
+        }
+        rc = dbmdb_restore_delta(deltapath, mappath);
+    }
+bail:
+    slapi_ch_free_string(&deltapath);
+    slapi_ch_free_string(&mappath);
+    slapi_ch_free_string(&base_dir);
+    return rc;
+}
+
 int
 dbmdb_restore(struct ldbminfo *li, char *src_dir, Slapi_Task *task)
 {
     int return_value = 0;
     int tmp_rval;
     int dbmode = DBLAYER_RESTORE_NO_RECOVERY_MODE;
+    int incremental = 0;
     struct stat sbuf;
     const char **pt;
     char *pathname;
@@ -1053,7 +1588,14 @@ dbmdb_restore(struct ldbminfo *li, char *src_dir, Slapi_Task *task)
     }
 
     /* Check that all files are present and not empty */
+    pathname = slapi_ch_smprintf("%s/%s", src_dir, DBMAPDELTA);
+    incremental = (stat(pathname, &sbuf) == 0);
+    slapi_ch_free_string(&pathname);
     for (pt=backupfilelists; *pt; pt++) {
+        if (incremental && strcmp(*pt, DBMAPFILE) == 0) {
+            /* The map is rebuilt from the base backup */
+            continue;
+        }
         pathname = slapi_ch_smprintf("%s/%s", src_dir, *pt);
         if (stat(pathname, &sbuf) < 0 || sbuf.st_size == 0) {
             slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore",
@@ -1081,12 +1623,16 @@ dbmdb_restore(struct ldbminfo *li, char *src_dir, Slapi_Task *task)
         return LDAP_UNWILLING_TO_PERFORM;
     }
 
+    if (incremental && dbmdb_restore_check_chain(task, src_dir)) {
+        return LDAP_UNWILLING_TO_PERFORM;
+    }
+
     /* We delete the existing database */
     dbmdb_ctx_close(li->li_dblayer_config);
     dbmdb_delete_db(li);
 
     /* Copy db and info files */
-    if (dbmdb_restore_file(li, task, src_dir, DBMAPFILE) ||
+    if (dbmdb_restore_map(li, task, src_dir, 0) ||
         dbmdb_restore_file(li, task, src_dir, INFOFILE)) {
         return_value = -1;
         goto error_out;
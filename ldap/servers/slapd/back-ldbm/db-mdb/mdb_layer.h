@@ -41,6 +41,8 @@
 #define CONFIG_MDB_MAX_SIZE       "nsslapd-mdb-max-size"
 #define CONFIG_MDB_MAX_READERS    "nsslapd-mdb-max-readers"
 #define CONFIG_MDB_MAX_DBS        "nsslapd-mdb-max-dbs"
+#define CONFIG_MDB_ONLINE_REINDEX "nsslapd-mdb-online-reindex"
+#define CONFIG_MDB_ONLINE_REINDEX_RATE "nsslapd-mdb-online-reindex-rate"
 
 #define DBMDB_DB_MINSIZE             ( 4LL * MEGABYTE )
 #define DBMDB_DISK_RESERVE(disksize) ((disksize)*2ULL/1000ULL)
@@ -62,6 +64,9 @@
 #define DSE_INSTANCE        "dse_instance.ldif"     /* dse file in backup */
 #define DSE_INDEX           "dse_index.ldif"        /* dse file in backup */
 #define DBMAPFILE           "data.mdb"
+#define DBMAPSUMS           "data.mdb.sums"         /* chunk digests of a backed up map */
+#define DBMAPDELTA          "data.mdb.delta"        /* changed chunks (incremental backup) */
+#define DBMAPBASE           "BASE.mdb"              /* backup a delta applies to */
 #define INFOFILE            "INFO.mdb"
 #define DBNAMES             "__DBNAMES"
 #define CHANGELOG_PATTERN   "changelog"   /* pattern in changelog dbi name */
@@ -76,6 +81,8 @@ typedef struct
     int max_readers;
     int max_dbs;
     uint64_t max_size;
+    int online_reindex;           /* reindex tasks keep the backend writable */
+    int online_reindex_rate;      /* online reindex budget in entries/s (0: no limit) */
 } dbmdb_cfg_t;
 
 /* config parameters limits */
@@ -478,6 +485,10 @@ void dbmdb_writer_cleanup(ImportJob *job);
 void dbmdb_writer_wakeup(ImportJob *job);
 double dbmdb_writer_get_progress(ImportJob *job);
 
+/* mdb_reindex.c */
+int dbmdb_online_reindex_allowed(backend *be, char **attrs);
+int dbmdb_online_reindex(backend *be, char **attrs, Slapi_Task *task);
+
 /* mdb_misc.c */
 int dbmdb_count_config_entries(char *filter, int *nbentries);
 
@@ -497,6 +508,7 @@ int dbmdb_dbi_reset(dbmdb_ctx_t *conf, dbi_db_t *db);
 int dbmdb_dbi_remove(dbmdb_ctx_t *conf, dbi_db_t **db);
 int dbmdb_dbi_rmdir(backend *be);
 int dbmdb_clear_dirty_flags(backend *be);
+int dbmdb_dbi_set_dirty(dbmdb_ctx_t *ctx, dbmdb_dbi_t *dbi, int dirty_flags);
 int dbmdb_recno_cache_get_mode(dbmdb_recno_cache_ctx_t *rcctx);
 char *dbmdb_recno_cache_get_dbname(const char *vlvdbiname);
 int dbmdb_cmp_vals(MDB_val *v1, MDB_val *v2);
@@ -30,6 +30,9 @@
 
 typedef struct _export_args
 {
+    struct ldbminfo *li;
+    ldbm_instance *inst;
+    export_pipeline *pipeline;
     struct backentry *ep;
     int decrypt;
     int options;
@@ -41,7 +44,6 @@ typedef struct _export_args
     Slapi_Task *task;
     char **include_suffix;
     char **exclude_suffix;
-    int *cnt;
     int *lastcnt;
     IDList *pre_exported_idl; /* exported IDList, which ID is larger than
                                  its children's ID.  It happens when an entry
@@ -433,52 +435,53 @@ dbmdb_fetch_subtrees(backend *be, char **include, int *err)
 }
 
 
-static int
-dbmdb_export_one_entry(struct ldbminfo *li,
-                 ldbm_instance *inst,
-                 export_args *expargs)
+/*
+ * Format an entry for the export pipeline, in any thread.  Returns its LDIF
+ * text, or NULL if the entry is not exported.
+ */
+static char *
+dbmdb_export_format_entry(void *arg, struct backentry *ep, int *outlen)
 {
-    backend *be = inst->inst_be;
+    export_args *expargs = (export_args *)arg;
+    backend *be = expargs->inst->inst_be;
     int rc = 0;
-    int wrc = 0;
     Slapi_Attr *this_attr = NULL, *next_attr = NULL;
     char *type = NULL;
-    MDB_val data = {0};
+    char *str = NULL;
     int len = 0;
 
-    if (!dbmdb_back_ok_to_dump(backentry_get_ndn(expargs->ep),
+    if (!dbmdb_back_ok_to_dump(backentry_get_ndn(ep),
                               expargs->include_suffix,
                               expargs->exclude_suffix)) {
-        goto bail; /* go to next loop */
+        return NULL; /* go to next loop */
     }
     if (!(expargs->options & SLAPI_DUMP_STATEINFO) &&
-        slapi_entry_flag_is_set(expargs->ep->ep_entry,
+        slapi_entry_flag_is_set(ep->ep_entry,
                                 SLAPI_ENTRY_FLAG_TOMBSTONE)) {
         /* We only dump the tombstones if the user needs to create
          * a replica from the ldif */
-        goto bail; /* go to next loop */
+        return NULL; /* go to next loop */
     }
-    (*expargs->cnt)++;
 
     /* do not output attributes that are in the "exclude" list */
     /* Also, decrypt any encrypted attributes, if we're asked to */
-    rc = slapi_entry_first_attr(expargs->ep->ep_entry, &this_attr);
+    rc = slapi_entry_first_attr(ep->ep_entry, &this_attr);
     while (0 == rc) {
         int dump_uniqueid = (expargs->options & SLAPI_DUMP_UNIQUEID) ? 1 : 0;
-        rc = slapi_entry_next_attr(expargs->ep->ep_entry,
+        rc = slapi_entry_next_attr(ep->ep_entry,
                                    this_attr, &next_attr);
         slapi_attr_get_type(this_attr, &type);
-        if (dbmdb_ldbm_exclude_attr_from_export(li, type, dump_uniqueid)) {
-            slapi_entry_delete_values(expargs->ep->ep_entry, type, NULL);
+        if (dbmdb_ldbm_exclude_attr_from_export(expargs->li, type, dump_uniqueid)) {
+            slapi_entry_delete_values(ep->ep_entry, type, NULL);
         }
         this_attr = next_attr;
     }
     if (expargs->decrypt) {
         /* Decrypt in place */
-        rc = attrcrypt_decrypt_entry(be, expargs->ep);
+        rc = attrcrypt_decrypt_entry(be, ep);
         if (rc) {
-            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_export_one_entry", "Failed to decrypt entry [%s] : %d\n",
-                          slapi_sdn_get_dn(&expargs->ep->ep_entry->e_sdn), rc);
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_export_format_entry", "Failed to decrypt entry [%s] : %d\n",
+                          slapi_sdn_get_dn(&ep->ep_entry->e_sdn), rc);
         }
     }
     /*
@@ -486,7 +489,7 @@ dbmdb_export_one_entry(struct ldbminfo *li,
      * If it is not, put "{CLEAR}" in front of the password value.
      */
     {
-        char *pw = slapi_entry_attr_get_charptr(expargs->ep->ep_entry,
+        char *pw = slapi_entry_attr_get_charptr(ep->ep_entry,
                                                 "userpassword");
         if (pw && !slapi_is_encoded(pw)) {
             /* clear password does not have {CLEAR} storage scheme */
@@ -496,67 +499,77 @@ dbmdb_export_one_entry(struct ldbminfo *li,
             val.bv_len = strlen(val.bv_val);
             vals[0] = &val;
             vals[1] = NULL;
-            rc = slapi_entry_attr_replace(expargs->ep->ep_entry,
+            rc = slapi_entry_attr_replace(ep->ep_entry,
                                           "userpassword", vals);
             if (rc) {
                 slapi_log_err(SLAPI_LOG_ERR,
-                              "dbmdb_export_one_entry", "%s: Failed to add clear password storage scheme: %d\n",
-                              slapi_sdn_get_dn(&expargs->ep->ep_entry->e_sdn), rc);
+                              "dbmdb_export_format_entry", "%s: Failed to add clear password storage scheme: %d\n",
+                              slapi_sdn_get_dn(&ep->ep_entry->e_sdn), rc);
             }
             slapi_ch_free_string(&val.bv_val);
         }
         slapi_ch_free_string(&pw);
     }
-    data.mv_data = slapi_entry2str_with_options(expargs->ep->ep_entry,
-                                             &len, expargs->options);
-    data.mv_size = len + 1;
+    str = slapi_entry2str_with_options(ep->ep_entry, &len, expargs->options);
+    if (str == NULL) {
+        return NULL;
+    }
 
     if (expargs->printkey & EXPORT_PRINTKEY) {
-        char idstr[32];
+        char *keyed = slapi_ch_smprintf("# entry-id: %lu\n%s\n", (u_long)ep->ep_id, str);
 
-        sprintf(idstr, "# entry-id: %lu\n", (u_long)expargs->ep->ep_id);
-        wrc = write(expargs->fd, idstr, strlen(idstr));
-        if (wrc < 0) {
-            goto bail;
-        }
-    }
-    wrc = write(expargs->fd, data.mv_data, len);
-    if (wrc < 0) {
-        goto bail;
-    }
-    wrc = write(expargs->fd, "\n", 1);
-    if (wrc < 0) {
-        goto bail;
+        slapi_ch_free_string(&str);
+        str = keyed;
+        len = strlen(str);
+    } else {
+        str = slapi_ch_realloc(str, len + 2);
+        str[len++] = '\n';
+        str[len] = '\0';
     }
-    slapi_ch_free(&data.mv_data);
-    data.mv_size = 0;
-    rc = 0;
-    if ((*expargs->cnt) % 1000 == 0) {
-        int percent;
+    *outlen = len;
+    return str;
+}
 
-        if (expargs->idl) {
-            percent = (expargs->idindex * 100 / expargs->idl->b_nids);
-        } else {
-            percent = (expargs->ep->ep_id * 100 / expargs->lastid);
-        }
-        if (expargs->task) {
-            slapi_task_log_status(expargs->task,
-                                  "%s: Processed %d entries (%d%%).",
-                                  inst->inst_name, *expargs->cnt, percent);
-            slapi_task_log_notice(expargs->task,
-                                  "%s: Processed %d entries (%d%%).",
-                                  inst->inst_name, *expargs->cnt, percent);
-        }
-        slapi_log_err(SLAPI_LOG_INFO, "dbmdb_export_one_entry", "export %s: Processed %d entries (%d%%).\n",
-                      inst->inst_name, *expargs->cnt, percent);
-        *expargs->lastcnt = *expargs->cnt;
-    }
-bail:
-    if (wrc < 0) {
-        slapi_log_err(SLAPI_LOG_INFO, "dbmdb_export_one_entry", "export %s: Failed to write in export file. errno=%d\n", inst->inst_name, errno);
-        rc = wrc;
+/* Called by the export pipeline every 1000 exported entries */
+static void
+dbmdb_export_progress(void *arg, int cnt, int percent)
+{
+    export_args *expargs = (export_args *)arg;
+    ldbm_instance *inst = expargs->inst;
+
+    if (expargs->task) {
+        slapi_task_log_status(expargs->task,
+                              "%s: Processed %d entries (%d%%).",
+                              inst->inst_name, cnt, percent);
+        slapi_task_log_notice(expargs->task,
+                              "%s: Processed %d entries (%d%%).",
+                              inst->inst_name, cnt, percent);
+    }
+    slapi_log_err(SLAPI_LOG_INFO, "dbmdb_export_one_entry", "export %s: Processed %d entries (%d%%).\n",
+                  inst->inst_name, cnt, percent);
+    *expargs->lastcnt = cnt;
+}
+
+static int
+dbmdb_export_percent(export_args *expargs, ID id)
+{
+    if (expargs->idl) {
+        return expargs->idindex * 100 / expargs->idl->b_nids;
     }
-    return rc;
+    return id * 100 / expargs->lastid;
+}
+
+/*
+ * Hand expargs->ep to the export pipeline.  The entry belongs to the
+ * pipeline afterwards, even on error.
+ */
+static int
+dbmdb_export_one_entry(export_args *expargs)
+{
+    struct backentry *ep = expargs->ep;
+
+    expargs->ep = NULL;
+    return export_pipeline_submit(expargs->pipeline, ep, dbmdb_export_percent(expargs, ep->ep_id));
 }
 
 /*
@@ -857,6 +870,26 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
         idindex = 0;
     }
 
+    eargs.li = li;
+    eargs.inst = inst;
+    eargs.decrypt = decrypt;
+    eargs.options = options;
+    eargs.printkey = printkey;
+    eargs.idl = idl;
+    eargs.lastid = lastid;
+    eargs.fd = fd;
+    eargs.task = task;
+    eargs.include_suffix = include_suffix;
+    eargs.exclude_suffix = exclude_suffix;
+    eargs.lastcnt = &lastcnt;
+    eargs.pipeline = export_pipeline_new(inst, fd, fname, dbmdb_export_format_entry,
+                                         dbmdb_export_progress, &eargs);
+    if (eargs.pipeline == NULL) {
+        slapi_task_log_notice(task, "Backend %s: can't open the export stream on %s", inst->inst_name, fname);
+        return_value = -1;
+        goto bye;
+    }
+
     /* When user has specifically asked not to print the version
      * or when this is not the first backend that is append into
      * this file : don't print the version
@@ -869,24 +902,12 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
                  */
 
         sprintf(vstr, "version: %d\n\n", myversion);
-        wrc = write(fd, vstr, strlen(vstr));
+        wrc = export_pipeline_write(eargs.pipeline, vstr, strlen(vstr));
         if (wrc < 0) {
             goto bye;
-        } else {
-            wrc = 0;
         }
     }
 
-    eargs.decrypt = decrypt;
-    eargs.options = options;
-    eargs.printkey = printkey;
-    eargs.idl = idl;
-    eargs.lastid = lastid;
-    eargs.fd = fd;
-    eargs.task = task;
-    eargs.include_suffix = include_suffix;
-    eargs.exclude_suffix = exclude_suffix;
-
     while (keepgoing) {
         /*
          * All database operations in a transactional environment,
@@ -935,12 +956,10 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
                 if (pending_ruv) {
                     eargs.ep = pending_ruv;
                     eargs.idindex = idindex;
-                    eargs.cnt = &cnt;
-                    eargs.lastcnt = &lastcnt;
-                    wrc = dbmdb_export_one_entry(li, inst, &eargs);
-                    backentry_free(&pending_ruv);
-                    if (wrc) {
-                        break;
+                    pending_ruv = NULL;
+                    rc = dbmdb_export_one_entry(&eargs);
+                    if (rc) {
+                        return_value = rc;
                     }
                 }
                 break;
@@ -1015,8 +1034,6 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
                         !idl_id_is_in_idlist(eargs.pre_exported_idl, pid)) {
 
                         eargs.idindex = idindex;
-                        eargs.cnt = &cnt;
-                        eargs.lastcnt = &lastcnt;
 
                         rc = _export_or_index_parents(inst, &cur, temp_id,
                                                       rdn, temp_id, pid, run_from_cmdline,
@@ -1099,10 +1116,34 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
                                       dn);
                     }
                 }
+                if (!skip_ruv && export_pipeline_is_parallel(eargs.pipeline)) {
+                    /* let an export thread parse the entry */
+                    eargs.idindex = idindex;
+                    rc = export_pipeline_submit_raw(eargs.pipeline, temp_id, dn, data.mv_data, data.mv_size,
+                                                    str2entry_options | SLAPI_STR2ENTRY_NO_ENTRYDN,
+                                                    dbmdb_export_percent(&eargs, temp_id));
+                    slapi_ch_free_string(&rdn);
+                    backentry_free(&ep);
+                    if (rc) {
+                        return_value = rc;
+                        break;
+                    }
+                    continue;
+                }
                 ep->ep_entry = slapi_str2entry_ext(dn, NULL, data.mv_data,
                                                    str2entry_options | SLAPI_STR2ENTRY_NO_ENTRYDN);
                 slapi_ch_free_string(&rdn);
             }
+        } else if (export_pipeline_is_parallel(eargs.pipeline)) {
+            eargs.idindex = idindex;
+            rc = export_pipeline_submit_raw(eargs.pipeline, temp_id, NULL, data.mv_data, data.mv_size,
+                                            str2entry_options, dbmdb_export_percent(&eargs, temp_id));
+            backentry_free(&ep);
+            if (rc) {
+                return_value = rc;
+                break;
+            }
+            continue;
         } else {
             ep->ep_entry = slapi_str2entry(data.mv_data, str2entry_options);
         }
@@ -1129,18 +1170,23 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
 
         eargs.ep = ep;
         eargs.idindex = idindex;
-        eargs.cnt = &cnt;
-        eargs.lastcnt = &lastcnt;
-        rc = dbmdb_export_one_entry(li, inst, &eargs);
-        backentry_free(&ep);
-        if (rc && !return_value) {
-            return_value = rc; 
+        ep = NULL;
+        rc = dbmdb_export_one_entry(&eargs);
+        if (rc) {
+            return_value = rc;
+            break;
         }
     }
     /* MDB_NOTFOUND -> successful end */
     if (return_value == MDB_NOTFOUND)
         return_value = 0;
 
+    /* wait for the entries still formatted or written */
+    rc = export_pipeline_done(&eargs.pipeline, &cnt);
+    if (rc && !return_value) {
+        return_value = rc;
+    }
+
     /* done cycling thru entries to write */
     if (lastcnt != cnt) {
         if (task) {
@@ -1162,6 +1208,7 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
     }
 
 bye:
+    export_pipeline_done(&eargs.pipeline, NULL);
     if (idl) {
         idl_free(&idl);
     }
@@ -1263,6 +1310,28 @@ dbmdb_db2index(Slapi_PBlock *pb)
         }
     }
 
+    if (!run_from_cmdline && task) {
+        char **attrs = NULL;
+
+        slapi_pblock_get(pb, SLAPI_DB2INDEX_ATTRS, &attrs);
+        if (dbmdb_online_reindex_allowed(be, attrs)) {
+            /* Keep the backend writable while the indexes are rebuilt */
+            if (instance_set_busy(inst) != 0) {
+                slapi_task_log_notice(task,
+                        "%s: is already in the middle of another task and cannot be disturbed.",
+                        inst->inst_name);
+                slapi_log_err(SLAPI_LOG_ERR, "dbmdb_db2index", "ldbm: '%s' is already in the middle of "
+                                                               "another task and cannot be disturbed.\n",
+                              inst->inst_name);
+                return return_value;
+            }
+            return_value = dbmdb_online_reindex(be, attrs, task);
+            instance_set_not_busy(inst);
+            slapi_log_err(SLAPI_LOG_TRACE, "dbmdb_db2index", "<=\n");
+            return return_value;
+        }
+    }
+
     /* make sure no other tasks are going, and set the backend readonly */
     if (instance_set_busy_and_readonly(inst) != 0) {
         slapi_task_log_notice(task,
@@ -1356,7 +1425,6 @@ _get_and_add_parent_rdns(backend *be,
     Slapi_RDN mysrdn = {0};
     struct backdn *bdn = NULL;
     ldbm_instance *inst = NULL;
-    struct ldbminfo *li = NULL;
     struct backentry *ep = NULL;
     char *rdn = NULL;
     MDB_val key, data;
@@ -1375,7 +1443,6 @@ _get_and_add_parent_rdns(backend *be,
     }
 
     inst = (ldbm_instance *)be->be_instance_info;
-    li = inst->inst_li;
     memset(&data, 0, sizeof(data));
 
     /* first, try the dn cache */
@@ -1507,11 +1574,11 @@ _get_and_add_parent_rdns(backend *be,
             goto bail;
         }
         eargs->ep = ep;
-        rc = dbmdb_export_one_entry(li, inst, eargs);
+        ep = NULL;
+        rc = dbmdb_export_one_entry(eargs);
         if (rc) {
             slapi_log_err(SLAPI_LOG_ERR, "_get_and_add_parent_rdns",
-                          "Failed to export an entry %s\n",
-                          slapi_sdn_get_dn(slapi_entry_get_sdn(ep->ep_entry)));
+                          "Failed to export the entry %d\n", id);
             goto bail;
         }
         rc = idl_append_extend(&(eargs->pre_exported_idl), id);
@@ -59,6 +59,7 @@ dbmdb_monitor_instance_search(Slapi_PBlock *pb __attribute__((unused)),
     uint64_t nentries;
     int64_t maxentries;
     uint64_t size, maxsize;
+    uint64_t count, evictions;
     dbmdb_stats_t *stats = NULL;
     int i, j, flags;
 
@@ -126,6 +127,39 @@ dbmdb_monitor_instance_search(Slapi_PBlock *pb __attribute__((unused)),
         MSET("currentDnCacheCount");
         sprintf(buf, "%" PRId64, maxentries);
         MSET("maxDnCacheCount");
+
+        /* DN tree, see dntree.c */
+        dntree_get_stats(inst->inst_dntree, &hits, &tries, &count, &size, &maxsize, &evictions);
+        sprintf(buf, "%" PRIu64, hits);
+        MSET("dnTreeCacheHits");
+        sprintf(buf, "%" PRIu64, tries);
+        MSET("dnTreeCacheTries");
+        sprintf(buf, "%" PRIu64, (uint64_t)(100.0 * (double)hits / (double)(tries > 0 ? tries : 1)));
+        MSET("dnTreeCacheHitRatio");
+        sprintf(buf, "%" PRIu64, size);
+        MSET("currentDnTreeCacheSize");
+        sprintf(buf, "%" PRIu64, maxsize);
+        MSET("maxDnTreeCacheSize");
+        sprintf(buf, "%" PRIu64, count);
+        MSET("currentDnTreeCacheCount");
+        sprintf(buf, "%" PRIu64, evictions);
+        MSET("dnTreeCacheEvictions");
+    }
+
+    if (li->li_cache_preload) {
+        /* cache warm up progress, see cache_snapshot.c */
+        PR_snprintf(buf, sizeof(buf), "%s", ldbm_cache_preload_status(inst));
+        MSET("cachePreloadStatus");
+        sprintf(buf, "%" PRIu64, slapi_atomic_load_64(&inst->inst_preload_loaded, __ATOMIC_ACQUIRE));
+        MSET("cachePreloadCount");
+        sprintf(buf, "%" PRIu64, slapi_atomic_load_64(&inst->inst_preload_total, __ATOMIC_ACQUIRE));
+        MSET("cachePreloadTotal");
+    }
+
+    if (li->li_search_prefetch_depth > 0) {
+        /* entries read ahead by the search prefetch helpers */
+        sprintf(buf, "%" PRIu64, slapi_atomic_load_64(&inst->inst_prefetch_loaded, __ATOMIC_ACQUIRE));
+        MSET("searchPrefetchCount");
     }
 
 #ifdef DEBUG
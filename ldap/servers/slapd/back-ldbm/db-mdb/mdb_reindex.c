@@ -0,0 +1,635 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2025 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* mdb_reindex.c - online reindex
+ *
+ * Rebuild some attribute indexes while the backend keeps serving
+ * updates (nsslapd-mdb-online-reindex: on).
+ *
+ * id2entry is read once, in small batches: each batch runs in its own
+ * write txn and feeds every requested index. The keys are written in a
+ * new database (<attr>.reindex.db) side by side with the live one, which
+ * keeps serving the searches. While the rebuild is in progress, the
+ * updates of the entries already read are applied to both databases
+ * (see index_addordel_values_ext_sv). Once id2entry has been fully read,
+ * every update is applied to both databases and the live one is made
+ * identical to the new one, a bounded number of records per txn: both
+ * databases are walked in order, the records missing from the new one are
+ * removed from the live one and the new records are added to it. While
+ * the live database is being merged, the index is offline: the searches
+ * do not use it (they are unindexed) until the last merge txn commits.
+ * If the reindex fails during the merge, the index stays offline.
+ *
+ * LMDB only allows a single write txn at a time, so the batches are
+ * serialized with the regular updates: the batch size and the optional
+ * entries/s budget (nsslapd-mdb-online-reindex-rate) bound how long the
+ * updates may have to wait.
+ */
+
+#include "mdb_layer.h"
+
+#define REINDEX_BATCH       256         /* max entries read in a single txn */
+#define REINDEX_MERGE_BATCH 1000        /* max records merged in a single txn */
+#define REINDEX_DBSUFFIX    ".reindex"  /* suffix of the database being built */
+#define REINDEX_LOG_STEP    10000       /* entries between two progress messages */
+
+typedef struct
+{
+    struct attrinfo *ai;     /* live index */
+    struct attrinfo shadow;  /* index being rebuilt */
+    dblayer_handle handle;   /* private handle of the shadow database */
+    char *filename;
+    MDB_val merged_key;      /* last record merged in the live database */
+    MDB_val merged_data;
+    int merged;              /* the live database is identical to the shadow one */
+} reindex_attr_t;
+
+/* These indexes are maintained by the ldbm code itself, or depend on the
+ * entry position in the tree, so they can only be rebuilt offline.
+ */
+static const char *reindex_offline_only[] = {
+    LDBM_ENTRYRDN_STR,
+    LDBM_ENTRYDN_STR,
+    LDBM_PARENTID_STR,
+    LDBM_ANCESTORID_STR,
+    LDBM_NUMSUBORDINATES_STR,
+    SLAPI_ATTR_NSCP_ENTRYDN,
+    SLAPI_ATTR_TOMBSTONE_CSN,
+    NULL
+};
+
+/*
+ * Tell whether the db2index task may run online: it must be enabled and
+ * only rebuild regular attribute indexes (no vlv, no system index).
+ */
+int
+dbmdb_online_reindex_allowed(backend *be, char **attrs)
+{
+    struct ldbminfo *li = (struct ldbminfo *)be->be_database->plg_private;
+    struct attrinfo *ai = NULL;
+    int i;
+
+    if (!MDB_CONFIG(li)->dsecfg.online_reindex || attrs == NULL || attrs[0] == NULL) {
+        return 0;
+    }
+    for (i = 0; attrs[i]; i++) {
+        if (attrs[i][0] != 't' || charray_inlist((char **)reindex_offline_only, attrs[i] + 1)) {
+            return 0;
+        }
+        ainfo_get(be, attrs[i] + 1, &ai);
+        if (ai == NULL || strcasecmp(ai->ai_type, attrs[i] + 1) != 0) {
+            /* Not configured: ainfo_get returned the default index */
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void
+reindex_task_log(Slapi_Task *task, int level, const char *fmt, ...)
+{
+    char buf[SLAPI_DSE_RETURNTEXT_SIZE];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    slapi_task_log_notice(task, "%s", buf);
+    slapi_task_log_status(task, "%s", buf);
+    slapi_log_err(level, "dbmdb_online_reindex", "%s\n", buf);
+}
+
+/* Add the keys of one attribute of the entry in the shadow index */
+static int
+reindex_add_values(backend *be, reindex_attr_t *ra, Slapi_Value **vals, ID id, back_txn *txn)
+{
+    if (vals == NULL || vals[0] == NULL) {
+        return 0;
+    }
+    return index_addordel_ainfo_values_sv(be, &ra->shadow, ra->ai->ai_type, vals, NULL,
+                                          id, BE_INDEX_ADD, txn, NULL, NULL);
+}
+
+/*
+ * Index a tombstone the way index_addordel_entry does: only the
+ * "nstombstone" objectclass value, the nsuniqueid and the entryusn.
+ */
+static int
+reindex_tombstone(backend *be, reindex_attr_t *ra, Slapi_Entry *e, ID id, back_txn *txn)
+{
+    const char *type = ra->ai->ai_type;
+    const char *str = NULL;
+    Slapi_Value *svals[2] = {0};
+    int rc = 0;
+
+    if (strcasecmp(type, SLAPI_ATTR_OBJECTCLASS) == 0) {
+        str = SLAPI_ATTR_VALUE_TOMBSTONE;
+    } else if (strcasecmp(type, SLAPI_ATTR_UNIQUEID) == 0) {
+        str = slapi_entry_get_uniqueid(e);
+    } else if (strcasecmp(type, SLAPI_ATTR_ENTRYUSN) == 0) {
+        str = slapi_entry_attr_get_ref(e, SLAPI_ATTR_ENTRYUSN);
+    }
+    if (str) {
+        svals[0] = slapi_value_new_string(str);
+        rc = reindex_add_values(be, ra, svals, id, txn);
+        slapi_value_free(&svals[0]);
+    }
+    return rc;
+}
+
+/* Parse an id2entry record and add its keys in every shadow index */
+static int
+reindex_entry(backend *be, reindex_attr_t *ras, int nbattrs, ID id, dbi_val_t *data, back_txn *txn)
+{
+    const char *suffix = slapi_sdn_get_dn(be->be_suffix);
+    struct backentry *ep = NULL;
+    Slapi_Entry *e = NULL;
+    uint len = data->size;
+    char *str = slapi_ch_malloc(len + 1);
+    char *normdn = NULL;
+    char *rdn = NULL;
+    int rc = 0;
+    int i;
+
+    memcpy(str, data->data, len);
+    str[len] = '\0';
+    plugin_call_entryfetch_plugins(&str, &len);
+
+    /* As in dbmdb_import_index_prepare_worker_entry, the dn does not
+     * matter for the attribute indexes: build one from the rdn.
+     */
+    if (get_value_from_string(str, "rdn", &rdn) == 0) {
+        if (strcasecmp(rdn, suffix) == 0) {
+            normdn = slapi_ch_strdup(rdn);
+        } else {
+            normdn = slapi_ch_smprintf("%s,%s", rdn, suffix);
+        }
+        e = slapi_str2entry_ext(normdn, NULL, str, SLAPI_STR2ENTRY_NO_ENTRYDN);
+    } else {
+        e = slapi_str2entry(str, SLAPI_STR2ENTRY_NO_ENTRYDN);
+    }
+    slapi_ch_free_string(&normdn);
+    slapi_ch_free_string(&rdn);
+    slapi_ch_free_string(&str);
+    if (e == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_online_reindex",
+                      "Invalid entry (conversion failed) in database for id %d. Skipping it.\n", id);
+        return 0;
+    }
+    ep = backentry_init(e);
+    ep->ep_id = id;
+    if (attrcrypt_decrypt_entry(be, ep)) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_online_reindex",
+                      "Failed to decrypt entry id %d\n", id);
+        backentry_free(&ep);
+        return -1;
+    }
+
+    for (i = 0; rc == 0 && i < nbattrs; i++) {
+        if (slapi_entry_flag_is_set(e, SLAPI_ENTRY_FLAG_TOMBSTONE) ||
+            slapi_entry_attr_hasvalue(e, SLAPI_ATTR_OBJECTCLASS, SLAPI_ATTR_VALUE_TOMBSTONE)) {
+            rc = reindex_tombstone(be, &ras[i], e, id, txn);
+        } else {
+            Slapi_Attr *attr = NULL;
+            int ret;
+            for (ret = slapi_entry_first_attr(e, &attr); rc == 0 && ret == 0;
+                 ret = slapi_entry_next_attr(e, attr, &attr)) {
+                char *type = NULL;
+                slapi_attr_get_type(attr, &type);
+                if (slapi_attr_type_cmp(ras[i].ai->ai_type, type, SLAPI_TYPE_CMP_BASE) == 0) {
+                    rc = reindex_add_values(be, &ras[i], attr_get_present_values(attr), id, txn);
+                }
+            }
+        }
+    }
+    backentry_free(&ep);
+    return rc;
+}
+
+/*
+ * Read the next batch of id2entry records, after lastid, and add their
+ * keys in the shadow indexes.
+ * Return DBI_RC_NOTFOUND once id2entry has been fully read.
+ */
+static int
+reindex_read_batch(backend *be, reindex_attr_t *ras, int nbattrs, back_txn *txn, int batch, ID *lastid, uint64_t *nbentries)
+{
+    dbi_cursor_t cursor = {0};
+    dbi_val_t key = {0};
+    dbi_val_t data = {0};
+    char keybuf[sizeof(ID)];
+    dbi_db_t *db = NULL;
+    int rc;
+    int n;
+    int i;
+
+    rc = dblayer_get_id2entry(be, &db);
+    if (rc == 0) {
+        rc = dblayer_new_cursor(be, db, txn->back_txn_txn, &cursor);
+    }
+    if (rc == 0) {
+        id_internal_to_stored(*lastid + 1, keybuf);
+        dblayer_value_set_buffer(be, &key, keybuf, sizeof(keybuf));
+        rc = dblayer_cursor_op(&cursor, DBI_OP_MOVE_NEAR_KEY, &key, &data);
+    }
+    for (n = 0; rc == 0 && n < batch; n++) {
+        ID id = id_stored_to_internal((char *)key.data);
+        /* From now on the updates of this entry must reach the shadow indexes */
+        for (i = 0; i < nbattrs; i++) {
+            ras[i].ai->ai_shadow_next_id = id + 1;
+        }
+        rc = reindex_entry(be, ras, nbattrs, id, &data, txn);
+        if (rc == 0) {
+            *lastid = id;
+            (*nbentries)++;
+            rc = dblayer_cursor_op(&cursor, DBI_OP_NEXT, &key, &data);
+        }
+    }
+    dblayer_cursor_op(&cursor, DBI_OP_CLOSE, NULL, NULL);
+    dblayer_value_free(be, &data);
+    if (db) {
+        dblayer_release_id2entry(be, db);
+    }
+    return rc;
+}
+
+/* Remember the last merged record, the next txn resumes after it */
+static void
+reindex_merge_save(reindex_attr_t *ra, MDB_val *key, MDB_val *data)
+{
+    ra->merged_key.mv_data = slapi_ch_realloc(ra->merged_key.mv_data, key->mv_size + 1);
+    memcpy(ra->merged_key.mv_data, key->mv_data, key->mv_size);
+    ra->merged_key.mv_size = key->mv_size;
+    ra->merged_data.mv_data = slapi_ch_realloc(ra->merged_data.mv_data, data->mv_size + 1);
+    memcpy(ra->merged_data.mv_data, data->mv_data, data->mv_size);
+    ra->merged_data.mv_size = data->mv_size;
+}
+
+/* Move the cursor on the first record following the last merged one */
+static int
+reindex_merge_seek(reindex_attr_t *ra, MDB_cursor *cur, int dupsort, MDB_val *key, MDB_val *data)
+{
+    MDB_txn *txn = mdb_cursor_txn(cur);
+    MDB_dbi dbi = mdb_cursor_dbi(cur);
+    int rc;
+
+    if (ra->merged_key.mv_data == NULL) {
+        return MDB_CURSOR_GET(cur, key, data, MDB_FIRST);
+    }
+    if (dupsort) {
+        *key = ra->merged_key;
+        *data = ra->merged_data;
+        rc = MDB_CURSOR_GET(cur, key, data, MDB_GET_BOTH_RANGE);
+        if (rc == 0 && mdb_dcmp(txn, dbi, data, &ra->merged_data) == 0) {
+            rc = MDB_CURSOR_GET(cur, key, data, MDB_NEXT);
+        }
+        if (rc != MDB_NOTFOUND) {
+            return rc;
+        }
+        /* No record left with that key */
+    }
+    *key = ra->merged_key;
+    rc = MDB_CURSOR_GET(cur, key, data, MDB_SET_RANGE);
+    if (rc == 0 && mdb_cmp(txn, dbi, key, &ra->merged_key) == 0) {
+        rc = MDB_CURSOR_GET(cur, key, data, MDB_NEXT_NODUP);
+    }
+    return rc;
+}
+
+/*
+ * Merge at most batch records of the shadow index into the live one,
+ * within the given txn. The updates are applied to both indexes, so the
+ * records already merged stay identical.
+ * Return DBI_RC_NOTFOUND once both indexes have been fully walked.
+ */
+static int
+reindex_merge(backend *be, reindex_attr_t *ra, back_txn *txn, int batch)
+{
+    MDB_txn *mtxn = TXN(txn->back_txn_txn);
+    dbmdb_dbi_t *shadow = (dbmdb_dbi_t *)ra->handle.dblayer_dbp;
+    dbmdb_dbi_t *live = NULL;
+    MDB_cursor *lcur = NULL;
+    MDB_cursor *scur = NULL;
+    MDB_val lkey = {0};
+    MDB_val ldata = {0};
+    MDB_val skey = {0};
+    MDB_val sdata = {0};
+    dbi_db_t *db = NULL;
+    int dupsort;
+    int lrc = 0;
+    int src = 0;
+    int rc;
+    int n;
+
+    rc = dblayer_get_index_file(be, ra->ai, &db, DBOPEN_CREATE);
+    if (rc) {
+        return rc;
+    }
+    live = (dbmdb_dbi_t *)db;
+    dupsort = live->state.flags & MDB_DUPSORT;
+    rc = MDB_CURSOR_OPEN(mtxn, live->dbi, &lcur);
+    if (rc == 0) {
+        rc = MDB_CURSOR_OPEN(mtxn, shadow->dbi, &scur);
+    }
+    if (rc == 0) {
+        lrc = reindex_merge_seek(ra, lcur, dupsort, &lkey, &ldata);
+        src = reindex_merge_seek(ra, scur, dupsort, &skey, &sdata);
+    }
+    for (n = 0; rc == 0 && n < batch; n++) {
+        int cmp;
+
+        if (lrc != 0 && lrc != MDB_NOTFOUND) {
+            rc = lrc;
+        } else if (src != 0 && src != MDB_NOTFOUND) {
+            rc = src;
+        } else if (lrc == MDB_NOTFOUND && src == MDB_NOTFOUND) {
+            rc = MDB_NOTFOUND;
+        }
+        if (rc) {
+            break;
+        }
+        if (lrc == MDB_NOTFOUND) {
+            cmp = 1;
+        } else if (src == MDB_NOTFOUND) {
+            cmp = -1;
+        } else {
+            cmp = mdb_cmp(mtxn, live->dbi, &lkey, &skey);
+            if (cmp == 0 && dupsort) {
+                cmp = mdb_dcmp(mtxn, live->dbi, &ldata, &sdata);
+            }
+        }
+        if (cmp < 0) {
+            /* Only in the live index: it is outdated */
+            reindex_merge_save(ra, &lkey, &ldata);
+            rc = mdb_cursor_del(lcur, 0);
+            if (rc == 0) {
+                lrc = MDB_CURSOR_GET(lcur, &lkey, &ldata, MDB_NEXT);
+            }
+        } else if (cmp > 0) {
+            /* Only in the shadow index: add it, the live cursor then moves
+             * on the record it was on */
+            reindex_merge_save(ra, &skey, &sdata);
+            rc = MDB_CURSOR_PUT(lcur, &skey, &sdata, 0);
+            if (rc == 0) {
+                lrc = MDB_CURSOR_GET(lcur, &lkey, &ldata, MDB_NEXT);
+                src = MDB_CURSOR_GET(scur, &skey, &sdata, MDB_NEXT);
+            }
+        } else {
+            reindex_merge_save(ra, &skey, &sdata);
+            if (!dupsort && dbmdb_cmp_vals(&ldata, &sdata) != 0) {
+                rc = MDB_CURSOR_PUT(lcur, &skey, &sdata, MDB_CURRENT);
+            }
+            if (rc == 0) {
+                lrc = MDB_CURSOR_GET(lcur, &lkey, &ldata, MDB_NEXT);
+                src = MDB_CURSOR_GET(scur, &skey, &sdata, MDB_NEXT);
+            }
+        }
+    }
+    if (scur) {
+        MDB_CURSOR_CLOSE(scur);
+    }
+    if (lcur) {
+        MDB_CURSOR_CLOSE(lcur);
+    }
+    dblayer_release_index_file(be, ra->ai, db);
+    rc = dbmdb_map_error(__FUNCTION__, rc);
+    if (rc && rc != DBI_RC_NOTFOUND) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_online_reindex",
+                      "Failed to replace %s index. Error %d: %s\n",
+                      ra->ai->ai_type, rc, dblayer_strerror(rc));
+    }
+    return rc;
+}
+
+/*
+ * Merge the next records of the first index not yet merged. Once all of
+ * them are merged, the updates stop reaching the shadow indexes within
+ * the same txn. The indexes are brought online once it is committed.
+ */
+static int
+reindex_merge_batch(backend *be, reindex_attr_t *ras, int nbattrs, back_txn *txn, int *done)
+{
+    int rc;
+    int i;
+
+    for (i = 0; i < nbattrs && ras[i].merged; i++)
+        ;
+    if (i < nbattrs) {
+        rc = reindex_merge(be, &ras[i], txn, REINDEX_MERGE_BATCH);
+        if (rc != DBI_RC_NOTFOUND) {
+            return rc;
+        }
+        ras[i].merged = 1;
+        if (i + 1 < nbattrs) {
+            return 0;
+        }
+    }
+    for (i = 0; i < nbattrs; i++) {
+        ras[i].ai->ai_shadow = NULL;
+        ras[i].ai->ai_shadow_next_id = 0;
+    }
+    *done = 1;
+    return 0;
+}
+
+/* Stop mirroring the updates in the shadow indexes */
+static void
+reindex_unpublish(backend *be, reindex_attr_t *ras, int nbattrs)
+{
+    back_txn txn = {0};
+    int rc;
+    int i;
+
+    /* The updates only read ai_shadow while holding the write txn */
+    rc = dblayer_txn_begin(be, NULL, &txn);
+    for (i = 0; i < nbattrs && ras[i].ai; i++) {
+        ras[i].ai->ai_shadow = NULL;
+        ras[i].ai->ai_shadow_next_id = 0;
+    }
+    if (rc == 0) {
+        dblayer_txn_abort(be, &txn);
+    }
+}
+
+/*
+ * Wait long enough to keep the average rate below the configured budget
+ * (in entries per second).
+ */
+static void
+reindex_throttle(struct timespec *start, uint64_t nbentries, int rate)
+{
+    struct timespec now;
+    int64_t expected_ms;
+    int64_t elapsed_ms;
+
+    if (rate <= 0) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ms = (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+    expected_ms = nbentries * 1000 / rate;
+    if (expected_ms > elapsed_ms) {
+        DS_Sleep(PR_MillisecondsToInterval(expected_ms - elapsed_ms));
+    }
+}
+
+int
+dbmdb_online_reindex(backend *be, char **attrs, Slapi_Task *task)
+{
+    ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
+    struct ldbminfo *li = inst->inst_li;
+    dbmdb_ctx_t *ctx = MDB_CONFIG(li);
+    reindex_attr_t *ras = NULL;
+    struct timespec start;
+    uint64_t nbentries = 0;
+    ID lastid = 0;
+    ID maxid;
+    int nbattrs = 0;
+    int merging = 0;
+    int done = 0;
+    int rc = 0;
+    int i;
+
+    for (nbattrs = 0; attrs[nbattrs]; nbattrs++)
+        ;
+    ras = (reindex_attr_t *)slapi_ch_calloc(nbattrs, sizeof(reindex_attr_t));
+
+    /* Open the databases before starting the first txn */
+    for (i = 0; rc == 0 && i < nbattrs; i++) {
+        reindex_attr_t *ra = &ras[i];
+        dbmdb_dbi_t *dbi = NULL;
+        dbi_db_t *db = NULL;
+
+        ainfo_get(be, attrs[i] + 1, &ra->ai);
+        rc = dblayer_get_index_file(be, ra->ai, &db, DBOPEN_CREATE);
+        dblayer_release_index_file(be, ra->ai, db);
+        if (rc) {
+            break;
+        }
+        ra->filename = slapi_ch_smprintf("%s%s", ra->ai->ai_type, REINDEX_DBSUFFIX);
+        rc = dbmdb_open_dbi_from_filename(&dbi, be, ra->filename, ra->ai, MDB_CREATE | MDB_TRUNCATE_DBI);
+        if (rc) {
+            break;
+        }
+        /* Same settings as the live index, but its own database */
+        ra->shadow = *ra->ai;
+        ra->shadow.ai_indexmask &= ~(INDEX_OFFLINE | INDEX_SUBPOS_OFFLINE);
+        ra->shadow.ai_dblayer = &ra->handle;
+        ra->shadow.ai_dblayer_count = 0;
+        ra->shadow.ai_shadow = NULL;
+        ra->handle.dblayer_dbp = dbi;
+        ra->ai->ai_shadow_next_id = 0;
+        ra->ai->ai_shadow = &ra->shadow;
+    }
+    if (rc) {
+        reindex_task_log(task, SLAPI_LOG_ERR, "%s: Failed to open the %s index database. Error %d: %s",
+                         inst->inst_name, attrs[i] + 1, rc, dblayer_strerror(rc));
+        goto done;
+    }
+
+    reindex_task_log(task, SLAPI_LOG_INFO, "%s: Online reindexing started.", inst->inst_name);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!done && rc == 0) {
+        back_txn txn = {0};
+        int rate = ctx->dsecfg.online_reindex_rate;
+        int batch = (rate > 0 && rate < REINDEX_BATCH) ? rate : REINDEX_BATCH;
+
+        if (g_get_shutdown() || c_get_shutdown() ||
+            slapi_task_get_state(task) == SLAPI_TASK_CANCELLED) {
+            reindex_task_log(task, SLAPI_LOG_WARNING, "%s: Online reindexing aborted.", inst->inst_name);
+            rc = -1;
+            break;
+        }
+        rc = dblayer_txn_begin(be, NULL, &txn);
+        if (rc) {
+            break;
+        }
+        if (merging) {
+            rc = reindex_merge_batch(be, ras, nbattrs, &txn, &done);
+        } else {
+            rc = reindex_read_batch(be, ras, nbattrs, &txn, batch, &lastid, &nbentries);
+            if (rc == DBI_RC_NOTFOUND) {
+                /* id2entry has been fully read: the new entries are indexed by
+                 * their own update, and from now on every update reaches the
+                 * shadow indexes while they are merged in the live ones. The
+                 * searches must not see a partially merged index.
+                 */
+                for (i = 0; i < nbattrs; i++) {
+                    ras[i].ai->ai_shadow_next_id = NOID;
+                    ras[i].ai->ai_indexmask |= INDEX_OFFLINE;
+                }
+                merging = 1;
+                rc = 0;
+            }
+        }
+        if (rc == 0) {
+            rc = dblayer_txn_commit(be, &txn);
+        } else {
+            dblayer_txn_abort(be, &txn);
+        }
+        if (rc == 0 && done) {
+            for (i = 0; i < nbattrs; i++) {
+                ras[i].ai->ai_indexmask &= ~(INDEX_OFFLINE | INDEX_SUBPOS_OFFLINE);
+            }
+        }
+        if (rc) {
+            done = 0;
+            if (merging) {
+                reindex_task_log(task, SLAPI_LOG_ERR, "%s: Online reindexing failed while replacing the indexes, "
+                                 "they are left offline until they are reindexed. Error %d: %s",
+                                 inst->inst_name, rc, dblayer_strerror(rc));
+            } else {
+                reindex_task_log(task, SLAPI_LOG_ERR, "%s: Online reindexing failed at entry id %d. Error %d: %s",
+                                 inst->inst_name, lastid + 1, rc, dblayer_strerror(rc));
+            }
+            break;
+        }
+        if (!merging) {
+            if ((nbentries % REINDEX_LOG_STEP) < (uint64_t)batch) {
+                maxid = next_id_get(be);
+                reindex_task_log(task, SLAPI_LOG_INFO, "%s: Indexed %" PRIu64 " entries (%d%%).",
+                                 inst->inst_name, nbentries, maxid > 1 ? (int)(lastid * 100 / (maxid - 1)) : 100);
+            }
+            reindex_throttle(&start, nbentries, rate);
+        }
+    }
+
+done:
+    if (!done) {
+        reindex_unpublish(be, ras, nbattrs);
+    }
+    for (i = 0; i < nbattrs; i++) {
+        if (ras[i].handle.dblayer_dbp) {
+            dbmdb_dbi_remove(ctx, &ras[i].handle.dblayer_dbp);
+        }
+        if (done) {
+            /* The live database may have been created dirty by the index configuration */
+            dbi_db_t *db = NULL;
+            if (dblayer_get_index_file(be, ras[i].ai, &db, DBOPEN_ALLOW_DIRTY) == 0) {
+                dbmdb_dbi_t *dbi = (dbmdb_dbi_t *)db;
+                if (dbi->state.state & DBIST_DIRTY) {
+                    dbmdb_dbi_set_dirty(ctx, dbi, dbi->state.state & ~DBIST_DIRTY);
+                }
+            }
+            dblayer_release_index_file(be, ras[i].ai, db);
+        }
+        slapi_ch_free_string(&ras[i].filename);
+        slapi_ch_free(&ras[i].merged_key.mv_data);
+        slapi_ch_free(&ras[i].merged_data.mv_data);
+    }
+    slapi_ch_free((void **)&ras);
+    if (done) {
+        reindex_task_log(task, SLAPI_LOG_INFO, "%s: Finished online reindexing of %" PRIu64 " entries.",
+                         inst->inst_name, nbentries);
+    }
+    return rc;
+}
@@ -67,6 +67,10 @@
 #include <prthread.h>
 #include <prclist.h>
 
+#ifdef SYSTEMTAP
+#include <sys/sdt.h>
+#endif
+
 #define NEWDIR_MODE 0755
 #define DB_REGION_PREFIX "__db."
 
@@ -455,6 +459,7 @@ dblayer_instance_close(backend *be)
                       inst->inst_name);
         cache_clear(&inst->inst_dncache, CACHE_TYPE_DN);
     }
+    dntree_clear(inst->inst_dntree);
 
     if (attrcrypt_cleanup_private(inst)) {
         slapi_log_err(SLAPI_LOG_ERR,
@@ -733,6 +738,9 @@ dblayer_txn_begin(backend *be, back_txnid parent_txn, back_txn *txn)
 {
     struct ldbminfo *li = (struct ldbminfo *)be->be_database->plg_private;
     int rc = 0;
+#ifdef SYSTEMTAP
+    STAP_PROBE1(ns-slapd, be_txn__begin, be->be_name);
+#endif
     if (DBLOCK_INSIDE_TXN(li)) {
         rc = dblayer_txn_begin_ext(li, parent_txn, txn, PR_TRUE);
         if (!rc && SERIALLOCK(li)) {
@@ -747,6 +755,10 @@ dblayer_txn_begin(backend *be, back_txnid parent_txn, back_txn *txn)
             dblayer_unlock_backend(be);
         }
     }
+#ifdef SYSTEMTAP
+    /* the time since be_txn__begin is the wait for the backend lock */
+    STAP_PROBE2(ns-slapd, be_txn__begun, be->be_name, rc);
+#endif
     return rc;
 }
 
@@ -755,12 +767,18 @@ int
 dblayer_txn_commit_ext(struct ldbminfo *li, back_txn *txn, PRBool use_lock)
 {
     dblayer_private *priv = NULL;
+    int rc;
     PR_ASSERT(NULL != li);
 
     priv = (dblayer_private *)li->li_dblayer_private;
     PR_ASSERT(NULL != priv);
 
-    return priv->dblayer_txn_commit_fn(li, txn, use_lock);
+    rc = priv->dblayer_txn_commit_fn(li, txn, use_lock);
+    if (NULL == dblayer_get_pvt_txn()) {
+        /* outermost transaction: the DN trees drop what it wrote, again */
+        dntree_txn_done();
+    }
+    return rc;
 }
 
 int
@@ -786,6 +804,9 @@ dblayer_txn_commit(backend *be, back_txn *txn)
             dblayer_unlock_backend(be);
         }
     }
+#ifdef SYSTEMTAP
+    STAP_PROBE2(ns-slapd, be_txn__commit, be->be_name, rc);
+#endif
     return rc;
 }
 
@@ -793,13 +814,18 @@ int
 dblayer_txn_abort_ext(struct ldbminfo *li, back_txn *txn, PRBool use_lock)
 {
     dblayer_private *priv = NULL;
+    int rc;
 
     PR_ASSERT(NULL != li);
 
     priv = (dblayer_private *)li->li_dblayer_private;
     PR_ASSERT(NULL != priv);
 
-    return priv->dblayer_txn_abort_fn(li, txn, use_lock);
+    rc = priv->dblayer_txn_abort_fn(li, txn, use_lock);
+    if (NULL == dblayer_get_pvt_txn()) {
+        dntree_txn_done();
+    }
+    return rc;
 }
 
 int
@@ -825,6 +851,9 @@ dblayer_txn_abort(backend *be, back_txn *txn)
             dblayer_unlock_backend(be);
         }
     }
+#ifdef SYSTEMTAP
+    STAP_PROBE2(ns-slapd, be_txn__abort, be->be_name, rc);
+#endif
     return rc;
 }
 
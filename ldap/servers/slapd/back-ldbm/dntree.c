@@ -0,0 +1,862 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* dntree.c - in memory copy of the entryrdn tree */
+
+/*
+ * The entryrdn index stores the DIT as a tree: the key "P<id>" of an entry
+ * holds its parent and "C<id>" its children.  Resolving a DN walks the index
+ * from the suffix down, and building the DN of an ID walks it up, one cursor
+ * operation per RDN: with a deep tree every DN resolution costs several
+ * database reads.
+ *
+ * The DN tree keeps the nodes of the entryrdn tree that have been read: the
+ * ID of an entry, the ID of its parent, its RDN and, once they have been
+ * enumerated, the IDs of its children.  entryrdn_index_read,
+ * entryrdn_lookup_dn, entryrdn_get_parent and entryrdn_get_subordinates look
+ * here first, and only read the index when a node on their path is missing.
+ * What they read from the index is then added to the tree.  The memory used
+ * by the tree is bounded by nsslapd-dntreecachememsize (0 disables it), the
+ * nodes that were not used recently are evicted first (clock algorithm).
+ *
+ * The tree is a cache of the committed index, so only the readers that are
+ * not part of a transaction use it.  Writing the entryrdn index of an entry
+ * removes its node and the children list of its parent, and does it again
+ * once the outermost transaction is over: meanwhile a reader could have read
+ * and added back what the index held before the commit.  A reader only adds
+ * what it has read if nothing was removed since it started (dt_seq).  The
+ * children of a removed node cannot be reached anymore, they are evicted in
+ * time.
+ *
+ * While the instance is busy (import, restore, reindex) the index is written
+ * outside of any transaction: the tree is emptied and disabled.
+ */
+
+#include "back-ldbm.h"
+#include "dblayer.h"
+
+#define DNTREE_MIN_BUCKETS 1024
+
+typedef struct dntree_node
+{
+    ID dn_id;
+    ID dn_pid;                      /* 0 for a suffix */
+    char *dn_nrdn;                  /* NULL when the RDN was not read */
+    char *dn_rdn;
+    ID *dn_children;                /* valid if dn_children_gen is current */
+    size_t dn_nchildren;
+    uint64_t dn_children_gen;       /* 0 when the children were not read */
+    size_t dn_size;
+    int32_t dn_referenced;          /* clock bit, set on each use */
+    struct dntree_node *dn_idnext;  /* dt_idtable chain */
+    struct dntree_node *dn_rdnnext; /* dt_rdntable chain */
+    struct dntree_node *dn_prev;    /* clock list */
+    struct dntree_node *dn_next;
+} dntree_node;
+
+struct dntree
+{
+    Slapi_RWLock *dt_lock;
+    int dt_enabled;           /* 0 while the instance is busy */
+    uint64_t dt_maxsize;      /* 0 when disabled */
+    uint64_t dt_cursize;
+    uint64_t dt_count;
+    uint64_t dt_seq;          /* bumped each time something is removed */
+    uint64_t dt_children_gen; /* bumped to forget all the children lists */
+    size_t dt_nbuckets;
+    dntree_node **dt_idtable;  /* by id */
+    dntree_node **dt_rdntable; /* by (parent id, normalized rdn) */
+    dntree_node dt_clock;      /* list head, the hand is dt_clock.dn_next */
+    Slapi_Counter *dt_tries;
+    Slapi_Counter *dt_hits;
+    Slapi_Counter *dt_evictions;
+};
+
+/* A node read from the index, see dntree_batch_add */
+typedef struct dntree_rec
+{
+    ID dr_id;
+    ID dr_pid;
+    char *dr_nrdn;
+    char *dr_rdn;
+    size_t dr_order;
+} dntree_rec;
+
+struct _dntree_batch
+{
+    struct dntree *db_tree;
+    uint64_t db_seq;
+    dntree_rec *db_recs;
+    size_t db_nrecs;
+    size_t db_maxrecs;
+    ID *db_parents; /* nodes whose children are all in db_recs */
+    size_t db_nparents;
+    size_t db_maxparents;
+};
+
+/*
+ * The removals done by the writes of the current thread, replayed when its
+ * outermost transaction is over (dntree_txn_done).
+ */
+typedef struct dntree_pending
+{
+    struct dntree *dp_tree;
+    ID dp_id;
+    ID dp_pid;
+    struct dntree_pending *dp_next;
+} dntree_pending;
+
+static pthread_once_t dntree_pending_once = PTHREAD_ONCE_INIT;
+static pthread_key_t dntree_pending_key;
+
+static void
+dntree_pending_init(void)
+{
+    pthread_key_create(&dntree_pending_key, NULL);
+}
+
+static size_t
+dntree_id_slot(struct dntree *tree, ID id)
+{
+    return ((uint64_t)id * 2654435761ULL) % tree->dt_nbuckets;
+}
+
+static size_t
+dntree_rdn_slot(struct dntree *tree, ID pid, const char *nrdn)
+{
+    uint64_t h = 14695981039346656037ULL ^ pid;
+
+    for (const unsigned char *p = (const unsigned char *)nrdn; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h % tree->dt_nbuckets;
+}
+
+static size_t
+dntree_node_size(dntree_node *node)
+{
+    size_t size = sizeof(dntree_node) + node->dn_nchildren * sizeof(ID);
+
+    if (node->dn_nrdn) {
+        size += strlen(node->dn_nrdn) + strlen(node->dn_rdn) + 2;
+    }
+    return size;
+}
+
+static void
+dntree_resize(struct dntree *tree, dntree_node *node)
+{
+    tree->dt_cursize -= node->dn_size;
+    node->dn_size = dntree_node_size(node);
+    tree->dt_cursize += node->dn_size;
+}
+
+static dntree_node *
+dntree_find_id(struct dntree *tree, ID id)
+{
+    dntree_node *node = tree->dt_idtable[dntree_id_slot(tree, id)];
+
+    while (node && node->dn_id != id) {
+        node = node->dn_idnext;
+    }
+    return node;
+}
+
+static dntree_node *
+dntree_find_rdn(struct dntree *tree, ID pid, const char *nrdn)
+{
+    dntree_node *node = tree->dt_rdntable[dntree_rdn_slot(tree, pid, nrdn)];
+
+    while (node && (node->dn_pid != pid || strcmp(node->dn_nrdn, nrdn))) {
+        node = node->dn_rdnnext;
+    }
+    return node;
+}
+
+static void
+dntree_link_rdn(struct dntree *tree, dntree_node *node)
+{
+    size_t slot = dntree_rdn_slot(tree, node->dn_pid, node->dn_nrdn);
+
+    node->dn_rdnnext = tree->dt_rdntable[slot];
+    tree->dt_rdntable[slot] = node;
+}
+
+static void
+dntree_unlink(struct dntree *tree, dntree_node *node)
+{
+    dntree_node **np;
+
+    for (np = &tree->dt_idtable[dntree_id_slot(tree, node->dn_id)]; *np; np = &(*np)->dn_idnext) {
+        if (*np == node) {
+            *np = node->dn_idnext;
+            break;
+        }
+    }
+    if (node->dn_nrdn) {
+        for (np = &tree->dt_rdntable[dntree_rdn_slot(tree, node->dn_pid, node->dn_nrdn)]; *np; np = &(*np)->dn_rdnnext) {
+            if (*np == node) {
+                *np = node->dn_rdnnext;
+                break;
+            }
+        }
+    }
+    node->dn_prev->dn_next = node->dn_next;
+    node->dn_next->dn_prev = node->dn_prev;
+}
+
+static void
+dntree_free_node(dntree_node **node)
+{
+    slapi_ch_free_string(&(*node)->dn_nrdn);
+    slapi_ch_free_string(&(*node)->dn_rdn);
+    slapi_ch_free((void **)&(*node)->dn_children);
+    slapi_ch_free((void **)node);
+}
+
+static void
+dntree_remove_node(struct dntree *tree, dntree_node *node)
+{
+    dntree_unlink(tree, node);
+    tree->dt_cursize -= node->dn_size;
+    tree->dt_count--;
+    dntree_free_node(&node);
+}
+
+static void
+dntree_forget_children(dntree_node *node)
+{
+    if (node) {
+        node->dn_children_gen = 0;
+    }
+}
+
+/* Called with the write lock */
+static void
+dntree_empty(struct dntree *tree)
+{
+    while (tree->dt_clock.dn_next != &tree->dt_clock) {
+        dntree_node *node = tree->dt_clock.dn_next;
+
+        node->dn_prev->dn_next = node->dn_next;
+        node->dn_next->dn_prev = node->dn_prev;
+        dntree_free_node(&node);
+    }
+    memset(tree->dt_idtable, 0, tree->dt_nbuckets * sizeof(dntree_node *));
+    memset(tree->dt_rdntable, 0, tree->dt_nbuckets * sizeof(dntree_node *));
+    tree->dt_cursize = 0;
+    tree->dt_count = 0;
+    slapi_atomic_incr_64(&tree->dt_seq, __ATOMIC_RELEASE);
+}
+
+/* Called with the write lock: keep about two nodes per bucket */
+static void
+dntree_grow(struct dntree *tree)
+{
+    if (tree->dt_count <= 2 * tree->dt_nbuckets) {
+        return;
+    }
+    slapi_ch_free((void **)&tree->dt_idtable);
+    slapi_ch_free((void **)&tree->dt_rdntable);
+    tree->dt_nbuckets *= 4;
+    tree->dt_idtable = (dntree_node **)slapi_ch_calloc(tree->dt_nbuckets, sizeof(dntree_node *));
+    tree->dt_rdntable = (dntree_node **)slapi_ch_calloc(tree->dt_nbuckets, sizeof(dntree_node *));
+    for (dntree_node *node = tree->dt_clock.dn_next; node != &tree->dt_clock; node = node->dn_next) {
+        size_t slot = dntree_id_slot(tree, node->dn_id);
+
+        node->dn_idnext = tree->dt_idtable[slot];
+        tree->dt_idtable[slot] = node;
+        if (node->dn_nrdn) {
+            dntree_link_rdn(tree, node);
+        }
+    }
+}
+
+/*
+ * Called with the write lock: the hand gives a second chance to the nodes
+ * used since it last passed, and evicts the others until the tree fits.
+ */
+static void
+dntree_evict(struct dntree *tree)
+{
+    uint64_t budget = 2 * tree->dt_count;
+
+    while (tree->dt_cursize > tree->dt_maxsize && tree->dt_count > 0 && budget-- > 0) {
+        dntree_node *node = tree->dt_clock.dn_next;
+
+        if (slapi_atomic_load_32(&node->dn_referenced, __ATOMIC_RELAXED)) {
+            slapi_atomic_store_32(&node->dn_referenced, 0, __ATOMIC_RELAXED);
+            /* move it behind the hand */
+            node->dn_prev->dn_next = node->dn_next;
+            node->dn_next->dn_prev = node->dn_prev;
+            node->dn_prev = tree->dt_clock.dn_prev;
+            node->dn_next = &tree->dt_clock;
+            tree->dt_clock.dn_prev->dn_next = node;
+            tree->dt_clock.dn_prev = node;
+            continue;
+        }
+        dntree_remove_node(tree, node);
+        slapi_counter_increment(tree->dt_evictions);
+    }
+}
+
+static void
+dntree_touch(dntree_node *node)
+{
+    if (!slapi_atomic_load_32(&node->dn_referenced, __ATOMIC_RELAXED)) {
+        slapi_atomic_store_32(&node->dn_referenced, 1, __ATOMIC_RELAXED);
+    }
+}
+
+struct dntree *
+dntree_new(void)
+{
+    struct dntree *tree = (struct dntree *)slapi_ch_calloc(1, sizeof(struct dntree));
+
+    pthread_once(&dntree_pending_once, dntree_pending_init);
+    tree->dt_lock = slapi_new_rwlock();
+    tree->dt_enabled = 1;
+    tree->dt_seq = 1;
+    tree->dt_children_gen = 1;
+    tree->dt_nbuckets = DNTREE_MIN_BUCKETS;
+    tree->dt_idtable = (dntree_node **)slapi_ch_calloc(tree->dt_nbuckets, sizeof(dntree_node *));
+    tree->dt_rdntable = (dntree_node **)slapi_ch_calloc(tree->dt_nbuckets, sizeof(dntree_node *));
+    tree->dt_clock.dn_next = tree->dt_clock.dn_prev = &tree->dt_clock;
+    tree->dt_tries = slapi_counter_new();
+    tree->dt_hits = slapi_counter_new();
+    tree->dt_evictions = slapi_counter_new();
+    return tree;
+}
+
+void
+dntree_destroy(struct dntree **tree)
+{
+    if (NULL == tree || NULL == *tree) {
+        return;
+    }
+    dntree_empty(*tree);
+    slapi_ch_free((void **)&(*tree)->dt_idtable);
+    slapi_ch_free((void **)&(*tree)->dt_rdntable);
+    slapi_counter_destroy(&(*tree)->dt_tries);
+    slapi_counter_destroy(&(*tree)->dt_hits);
+    slapi_counter_destroy(&(*tree)->dt_evictions);
+    slapi_destroy_rwlock((*tree)->dt_lock);
+    slapi_ch_free((void **)tree);
+}
+
+void
+dntree_set_max_size(struct dntree *tree, uint64_t size)
+{
+    slapi_rwlock_wrlock(tree->dt_lock);
+    tree->dt_maxsize = size;
+    if (0 == size) {
+        dntree_empty(tree);
+    } else {
+        dntree_evict(tree);
+    }
+    slapi_rwlock_unlock(tree->dt_lock);
+}
+
+uint64_t
+dntree_get_max_size(struct dntree *tree)
+{
+    return tree->dt_maxsize;
+}
+
+/* Empty the tree, and stop using it until it is enabled again */
+void
+dntree_set_enabled(struct dntree *tree, int enabled)
+{
+    if (NULL == tree) {
+        return;
+    }
+    slapi_rwlock_wrlock(tree->dt_lock);
+    dntree_empty(tree);
+    tree->dt_enabled = enabled;
+    slapi_rwlock_unlock(tree->dt_lock);
+}
+
+void
+dntree_clear(struct dntree *tree)
+{
+    if (NULL == tree) {
+        return;
+    }
+    slapi_rwlock_wrlock(tree->dt_lock);
+    dntree_empty(tree);
+    slapi_rwlock_unlock(tree->dt_lock);
+}
+
+void
+dntree_get_stats(struct dntree *tree, uint64_t *hits, uint64_t *tries, uint64_t *count, uint64_t *size, uint64_t *maxsize, uint64_t *evictions)
+{
+    slapi_rwlock_rdlock(tree->dt_lock);
+    *hits = slapi_counter_get_value(tree->dt_hits);
+    *tries = slapi_counter_get_value(tree->dt_tries);
+    *evictions = slapi_counter_get_value(tree->dt_evictions);
+    *count = tree->dt_count;
+    *size = tree->dt_cursize;
+    *maxsize = tree->dt_maxsize;
+    slapi_rwlock_unlock(tree->dt_lock);
+}
+
+/*
+ * Returns the tree of the instance if the calling thread may use it: a
+ * thread in a transaction must see its own writes.
+ */
+static struct dntree *
+dntree_get(ldbm_instance *inst)
+{
+    struct dntree *tree = inst ? inst->inst_dntree : NULL;
+
+    if (NULL == tree || 0 == tree->dt_maxsize || dblayer_get_pvt_txn()) {
+        return NULL;
+    }
+    return tree;
+}
+
+static int
+dntree_has_children(struct dntree *tree, dntree_node *node)
+{
+    return node->dn_children_gen && node->dn_children_gen == tree->dt_children_gen;
+}
+
+/*
+ * DN -> ID.  srdn holds all the RDNs of the DN, as given to
+ * entryrdn_index_read.  Returns 0 and sets *id when every RDN is in the tree.
+ */
+int
+dntree_dn2id(ldbm_instance *inst, Slapi_RDN *srdn, ID *id)
+{
+    struct dntree *tree = dntree_get(inst);
+    const char *nrdn = NULL;
+    dntree_node *node = NULL;
+    int rdnidx;
+
+    if (NULL == tree) {
+        return -1;
+    }
+    slapi_counter_increment(tree->dt_tries);
+    rdnidx = slapi_rdn_get_last_ext(srdn, &nrdn, FLAG_ALL_NRDNS);
+    if (rdnidx < 0 || NULL == nrdn) {
+        return -1;
+    }
+    slapi_rwlock_rdlock(tree->dt_lock);
+    if (tree->dt_enabled) {
+        /* the suffix, then its descendants */
+        node = dntree_find_rdn(tree, 0, nrdn);
+        while (node && rdnidx > 0) {
+            dntree_touch(node);
+            rdnidx = slapi_rdn_get_prev_ext(srdn, rdnidx, &nrdn, FLAG_ALL_NRDNS);
+            if (rdnidx < 0 || NULL == nrdn) {
+                node = NULL;
+                break;
+            }
+            node = dntree_find_rdn(tree, node->dn_id, nrdn);
+        }
+    }
+    if (node) {
+        dntree_touch(node);
+        *id = node->dn_id;
+    }
+    slapi_rwlock_unlock(tree->dt_lock);
+    if (NULL == node) {
+        return -1;
+    }
+    slapi_counter_increment(tree->dt_hits);
+    return 0;
+}
+
+/*
+ * ID -> DN, as entryrdn_lookup_dn: rdn is the RDN of the entry, the RDNs of
+ * its ancestors come from the tree.
+ */
+int
+dntree_id2dn(ldbm_instance *inst, ID id, const char *rdn, char **dn, Slapi_RDN **psrdn)
+{
+    struct dntree *tree = dntree_get(inst);
+    Slapi_RDN *srdn = NULL;
+    dntree_node *node = NULL;
+
+    if (NULL == tree) {
+        return -1;
+    }
+    slapi_counter_increment(tree->dt_tries);
+    srdn = slapi_rdn_new_all_dn(rdn);
+    slapi_rwlock_rdlock(tree->dt_lock);
+    if (tree->dt_enabled) {
+        node = dntree_find_id(tree, id);
+        while (node && node->dn_pid) {
+            dntree_touch(node);
+            node = dntree_find_id(tree, node->dn_pid);
+            if (node && NULL == node->dn_rdn) {
+                node = NULL;
+            }
+            if (node) {
+                /* 1 is byref, and the dup'ed rdn is freed with srdn */
+                slapi_rdn_add_rdn_to_all_rdns(srdn, slapi_ch_strdup(node->dn_rdn), 1);
+            }
+        }
+    }
+    if (node) {
+        dntree_touch(node);
+    }
+    slapi_rwlock_unlock(tree->dt_lock);
+    if (NULL == node) {
+        slapi_rdn_free(&srdn);
+        return -1;
+    }
+    slapi_counter_increment(tree->dt_hits);
+    slapi_rdn_get_dn(srdn, dn);
+    if (psrdn) {
+        *psrdn = srdn;
+    } else {
+        slapi_rdn_free(&srdn);
+    }
+    return 0;
+}
+
+/*
+ * ID -> parent, as entryrdn_get_parent: nothing is returned for a suffix.
+ */
+int
+dntree_get_parent(ldbm_instance *inst, ID id, char **prdn, ID *pid)
+{
+    struct dntree *tree = dntree_get(inst);
+    dntree_node *node = NULL;
+    dntree_node *parent = NULL;
+    int rc = -1;
+
+    if (NULL == tree) {
+        return rc;
+    }
+    slapi_counter_increment(tree->dt_tries);
+    slapi_rwlock_rdlock(tree->dt_lock);
+    if (tree->dt_enabled) {
+        node = dntree_find_id(tree, id);
+    }
+    if (node && 0 == node->dn_pid) {
+        dntree_touch(node);
+        rc = 0;
+    } else if (node && (parent = dntree_find_id(tree, node->dn_pid)) && parent->dn_rdn) {
+        dntree_touch(node);
+        dntree_touch(parent);
+        *pid = parent->dn_id;
+        *prdn = slapi_ch_strdup(parent->dn_rdn);
+        rc = 0;
+    }
+    slapi_rwlock_unlock(tree->dt_lock);
+    if (0 == rc) {
+        slapi_counter_increment(tree->dt_hits);
+    }
+    return rc;
+}
+
+/* Append the subtree of node to idl, in the order of the index */
+static int
+dntree_append_subtree(struct dntree *tree, dntree_node *node, IDList **idl)
+{
+    if (!dntree_has_children(tree, node)) {
+        return -1;
+    }
+    dntree_touch(node);
+    for (size_t i = 0; i < node->dn_nchildren; i++) {
+        dntree_node *child = dntree_find_id(tree, node->dn_children[i]);
+
+        if (NULL == child || child->dn_pid != node->dn_id) {
+            return -1;
+        }
+        idl_append_extend(idl, child->dn_id);
+        if (dntree_append_subtree(tree, child, idl)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * All the subordinates of id, as entryrdn_get_subordinates.  Only found when
+ * the children of every node of the subtree are known.
+ */
+int
+dntree_get_subordinates(ldbm_instance *inst, ID id, IDList **subordinates)
+{
+    struct dntree *tree = dntree_get(inst);
+    dntree_node *node = NULL;
+    int rc = -1;
+
+    if (NULL == tree) {
+        return rc;
+    }
+    slapi_counter_increment(tree->dt_tries);
+    slapi_rwlock_rdlock(tree->dt_lock);
+    if (tree->dt_enabled && (node = dntree_find_id(tree, id))) {
+        rc = dntree_append_subtree(tree, node, subordinates);
+    }
+    slapi_rwlock_unlock(tree->dt_lock);
+    if (rc) {
+        idl_free(subordinates);
+        return rc;
+    }
+    slapi_counter_increment(tree->dt_hits);
+    return rc;
+}
+
+/*
+ * The nodes read from the index are collected in a batch, and added to the
+ * tree by dntree_batch_apply if nothing was removed from the tree since the
+ * batch was created.  Returns NULL if the calling thread cannot add to the
+ * tree.
+ */
+dntree_batch *
+dntree_batch_new(ldbm_instance *inst)
+{
+    struct dntree *tree = dntree_get(inst);
+    dntree_batch *batch;
+
+    if (NULL == tree || !tree->dt_enabled) {
+        return NULL;
+    }
+    batch = (dntree_batch *)slapi_ch_calloc(1, sizeof(dntree_batch));
+    batch->db_tree = tree;
+    batch->db_seq = slapi_atomic_load_64(&tree->dt_seq, __ATOMIC_ACQUIRE);
+    return batch;
+}
+
+/* id is a child of pid (0 for a suffix), its rdn is not always known */
+void
+dntree_batch_add(dntree_batch *batch, ID id, ID pid, const char *nrdn, const char *rdn)
+{
+    dntree_rec *rec;
+
+    if (NULL == batch) {
+        return;
+    }
+    if (batch->db_nrecs == batch->db_maxrecs) {
+        batch->db_maxrecs = batch->db_maxrecs ? batch->db_maxrecs * 2 : 8;
+        batch->db_recs = (dntree_rec *)slapi_ch_realloc((char *)batch->db_recs,
+                                                        batch->db_maxrecs * sizeof(dntree_rec));
+    }
+    rec = &batch->db_recs[batch->db_nrecs];
+    rec->dr_id = id;
+    rec->dr_pid = pid;
+    rec->dr_nrdn = (nrdn && rdn) ? slapi_ch_strdup(nrdn) : NULL;
+    rec->dr_rdn = (nrdn && rdn) ? slapi_ch_strdup(rdn) : NULL;
+    rec->dr_order = batch->db_nrecs++;
+}
+
+/* All the children of pid have been added to the batch */
+void
+dntree_batch_children(dntree_batch *batch, ID pid)
+{
+    if (NULL == batch) {
+        return;
+    }
+    if (batch->db_nparents == batch->db_maxparents) {
+        batch->db_maxparents = batch->db_maxparents ? batch->db_maxparents * 2 : 8;
+        batch->db_parents = (ID *)slapi_ch_realloc((char *)batch->db_parents,
+                                                   batch->db_maxparents * sizeof(ID));
+    }
+    batch->db_parents[batch->db_nparents++] = pid;
+}
+
+static int
+dntree_rec_cmp(const void *a, const void *b)
+{
+    const dntree_rec *ra = (const dntree_rec *)a;
+    const dntree_rec *rb = (const dntree_rec *)b;
+
+    if (ra->dr_pid != rb->dr_pid) {
+        return ra->dr_pid < rb->dr_pid ? -1 : 1;
+    }
+    return ra->dr_order < rb->dr_order ? -1 : (ra->dr_order > rb->dr_order);
+}
+
+/* Called with the write lock */
+static void
+dntree_add_rec(struct dntree *tree, dntree_rec *rec)
+{
+    dntree_node *node = dntree_find_id(tree, rec->dr_id);
+
+    if (node && node->dn_pid != rec->dr_pid) {
+        /* cannot happen unless the tree is out of date */
+        dntree_remove_node(tree, node);
+        node = NULL;
+    }
+    if (NULL == node) {
+        size_t slot = dntree_id_slot(tree, rec->dr_id);
+
+        node = (dntree_node *)slapi_ch_calloc(1, sizeof(dntree_node));
+        node->dn_id = rec->dr_id;
+        node->dn_pid = rec->dr_pid;
+        node->dn_idnext = tree->dt_idtable[slot];
+        tree->dt_idtable[slot] = node;
+        node->dn_prev = tree->dt_clock.dn_prev;
+        node->dn_next = &tree->dt_clock;
+        tree->dt_clock.dn_prev->dn_next = node;
+        tree->dt_clock.dn_prev = node;
+        tree->dt_count++;
+    }
+    if (NULL == node->dn_nrdn && rec->dr_nrdn) {
+        node->dn_nrdn = rec->dr_nrdn;
+        node->dn_rdn = rec->dr_rdn;
+        rec->dr_nrdn = rec->dr_rdn = NULL;
+        dntree_link_rdn(tree, node);
+    }
+    dntree_touch(node);
+    dntree_resize(tree, node);
+}
+
+void
+dntree_batch_apply(dntree_batch *batch)
+{
+    struct dntree *tree;
+
+    if (NULL == batch || 0 == batch->db_nrecs) {
+        return;
+    }
+    tree = batch->db_tree;
+    /* the children of a node are next to each other, in the index order */
+    qsort(batch->db_recs, batch->db_nrecs, sizeof(dntree_rec), dntree_rec_cmp);
+
+    slapi_rwlock_wrlock(tree->dt_lock);
+    if (!tree->dt_enabled || 0 == tree->dt_maxsize ||
+        batch->db_seq != slapi_atomic_load_64(&tree->dt_seq, __ATOMIC_ACQUIRE)) {
+        /* the index may have changed since it was read */
+        slapi_rwlock_unlock(tree->dt_lock);
+        return;
+    }
+    for (size_t i = 0; i < batch->db_nrecs; i++) {
+        dntree_add_rec(tree, &batch->db_recs[i]);
+    }
+    for (size_t p = 0; p < batch->db_nparents; p++) {
+        dntree_node *parent = dntree_find_id(tree, batch->db_parents[p]);
+        size_t lo = 0;
+        size_t hi = batch->db_nrecs;
+
+        if (NULL == parent) {
+            continue;
+        }
+        /* first record of the children */
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (batch->db_recs[mid].dr_pid < parent->dn_id) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (hi = lo; hi < batch->db_nrecs && batch->db_recs[hi].dr_pid == parent->dn_id; hi++)
+            ;
+        slapi_ch_free((void **)&parent->dn_children);
+        parent->dn_nchildren = hi - lo;
+        if (parent->dn_nchildren) {
+            parent->dn_children = (ID *)slapi_ch_malloc(parent->dn_nchildren * sizeof(ID));
+            for (size_t i = lo; i < hi; i++) {
+                parent->dn_children[i - lo] = batch->db_recs[i].dr_id;
+            }
+        }
+        parent->dn_children_gen = tree->dt_children_gen;
+        dntree_resize(tree, parent);
+    }
+    dntree_grow(tree);
+    dntree_evict(tree);
+    slapi_rwlock_unlock(tree->dt_lock);
+}
+
+void
+dntree_batch_free(dntree_batch **batch)
+{
+    if (NULL == batch || NULL == *batch) {
+        return;
+    }
+    for (size_t i = 0; i < (*batch)->db_nrecs; i++) {
+        slapi_ch_free_string(&(*batch)->db_recs[i].dr_nrdn);
+        slapi_ch_free_string(&(*batch)->db_recs[i].dr_rdn);
+    }
+    slapi_ch_free((void **)&(*batch)->db_recs);
+    slapi_ch_free((void **)&(*batch)->db_parents);
+    slapi_ch_free((void **)batch);
+}
+
+static void
+dntree_remove(struct dntree *tree, ID id, ID pid)
+{
+    dntree_node *node;
+
+    slapi_rwlock_wrlock(tree->dt_lock);
+    node = dntree_find_id(tree, id);
+    if (node) {
+        dntree_forget_children(dntree_find_id(tree, node->dn_pid));
+        dntree_remove_node(tree, node);
+    }
+    if (0 == pid) {
+        tree->dt_children_gen++;
+    } else if (NOID != pid) {
+        dntree_forget_children(dntree_find_id(tree, pid));
+    }
+    slapi_atomic_incr_64(&tree->dt_seq, __ATOMIC_RELEASE);
+    slapi_rwlock_unlock(tree->dt_lock);
+}
+
+/*
+ * The entryrdn index of id is about to be written.  pid is its parent, when
+ * the write adds or removes a child of pid; 0 when the parents involved are
+ * not known (all the children lists are forgotten); NOID when no children
+ * list changes (rename in place).
+ */
+void
+dntree_invalidate(ldbm_instance *inst, ID id, ID pid)
+{
+    struct dntree *tree = inst ? inst->inst_dntree : NULL;
+    dntree_pending *pending;
+
+    if (NULL == tree) {
+        return;
+    }
+    dntree_remove(tree, id, pid);
+    if (NULL == dblayer_get_pvt_txn()) {
+        /* not in a transaction: the instance is busy */
+        return;
+    }
+    /* do it again when the transaction is over */
+    pending = (dntree_pending *)slapi_ch_malloc(sizeof(dntree_pending));
+    pending->dp_tree = tree;
+    pending->dp_id = id;
+    pending->dp_pid = pid;
+    pending->dp_next = pthread_getspecific(dntree_pending_key);
+    pthread_setspecific(dntree_pending_key, pending);
+}
+
+/*
+ * Called when the outermost transaction of the thread is committed or
+ * aborted.
+ */
+void
+dntree_txn_done(void)
+{
+    dntree_pending *pending;
+
+    if (pthread_once(&dntree_pending_once, dntree_pending_init) ||
+        NULL == (pending = pthread_getspecific(dntree_pending_key))) {
+        return;
+    }
+    pthread_setspecific(dntree_pending_key, NULL);
+    while (pending) {
+        dntree_pending *next = pending->dp_next;
+
+        dntree_remove(pending->dp_tree, pending->dp_id, pending->dp_pid);
+        slapi_ch_free((void **)&pending);
+        pending = next;
+    }
+}
@@ -0,0 +1,489 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* export.c - parallel, ordered and optionally compressed db2ldif output */
+
+/*
+ * db2ldif reads id2entry with a single cursor, and most of its time is
+ * spent after the read: parsing the stored entry, filtering, decrypting
+ * and formatting it with slapi_entry2str_with_options().  The pipeline
+ * keeps the read in the calling thread, which also decides the order of
+ * the entries (parents first, pending RUV last), and hands the rest to
+ * worker threads:
+ *  - the caller submits items with a sequence number.  An item is either
+ *    an entry, a stored entry still to be parsed, or a string that is
+ *    written as is (the version line).
+ *  - the workers take the items in sequence order and format them into
+ *    their own buffer.
+ *  - a writer thread writes the buffers back in sequence order, so the
+ *    output is the same as the one of a sequential export.
+ * At most EXPORT_WINDOW items per worker are in flight.
+ *
+ * When the LDIF file name ends with ".gz" the output is compressed with
+ * zlib as it is written.  With nsslapd-export-threads set to 1, or on
+ * hosts with few cpus, the items are formatted and written by the caller.
+ */
+
+#include "back-ldbm.h"
+#include <zlib.h>
+
+#define EXPORT_MAX_THREADS 8
+#define EXPORT_WINDOW 64 /* items per worker */
+#define EXPORT_GZIP_SUFFIX ".gz"
+#define EXPORT_PROGRESS_COUNT 1000
+
+typedef enum {
+    EXPORT_ITEM_FREE,
+    EXPORT_ITEM_PENDING,    /* waiting for a worker */
+    EXPORT_ITEM_FORMATTING,
+    EXPORT_ITEM_READY       /* waiting for the writer */
+} export_item_state_t;
+
+typedef struct
+{
+    uint64_t seq;
+    export_item_state_t state;
+    struct backentry *ep; /* entry to format */
+    ID id;                /* stored entry to parse, then format */
+    char *dn;
+    char *data;
+    int flags;
+    int percent;
+    int is_entry;         /* counted as an exported entry */
+    char *out;            /* formatted item, NULL if it is filtered out */
+    size_t outlen;
+} export_item;
+
+struct _export_pipeline
+{
+    ldbm_instance *inst;
+    int fd;
+    gzFile gz;
+    export_format_fn format;
+    export_progress_fn progress;
+    void *arg;
+    int cnt; /* entries written */
+    int err;
+    int stop;
+    uint64_t next_seq;   /* next item to submit */
+    uint64_t work_seq;   /* next item to format */
+    uint64_t write_seq;  /* next item to write */
+    int nbslots;
+    export_item *slots; /* item n is in slot n % nbslots */
+    int nbthreads;
+    PRThread **threads;
+    PRThread *writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;
+};
+
+static int
+export_threads(struct ldbminfo *li)
+{
+    int nbthreads = li->li_export_threads;
+
+    if (nbthreads == 0) {
+        nbthreads = util_get_capped_hardware_threads(0, 0x7fffffff) / 2;
+    }
+    if (nbthreads > EXPORT_MAX_THREADS) {
+        nbthreads = EXPORT_MAX_THREADS;
+    }
+    return nbthreads;
+}
+
+/* Turn an item into its LDIF text, in the calling (worker) thread */
+static void
+export_format_item(export_pipeline *p, export_item *item)
+{
+    struct backentry *ep = item->ep;
+
+    if (ep == NULL && item->data) {
+        ep = backentry_alloc();
+        if (item->dn) {
+            ep->ep_entry = slapi_str2entry_ext(item->dn, NULL, item->data, item->flags);
+        } else {
+            ep->ep_entry = slapi_str2entry(item->data, item->flags);
+        }
+        if (ep->ep_entry == NULL) {
+            slapi_log_err(SLAPI_LOG_WARNING, "export_format_item",
+                          "Skipping badly formatted entry with id %lu\n", (u_long)item->id);
+            backentry_free(&ep);
+        } else {
+            ep->ep_id = item->id;
+        }
+        slapi_ch_free_string(&item->dn);
+        slapi_ch_free_string(&item->data);
+    }
+    if (ep) {
+        int len = 0;
+
+        item->out = p->format(p->arg, ep, &len);
+        item->outlen = item->out ? len : 0;
+        backentry_free(&ep);
+        item->ep = NULL;
+    }
+}
+
+static int
+export_output(export_pipeline *p, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n;
+
+        if (p->gz) {
+            n = gzwrite(p->gz, buf, len > INT_MAX ? INT_MAX : (unsigned)len);
+            if (n <= 0) {
+                int zerr = 0;
+                slapi_log_err(SLAPI_LOG_ERR, "export_output",
+                              "export %s: Failed to compress the export file: %s\n",
+                              p->inst->inst_name, gzerror(p->gz, &zerr));
+                return -1;
+            }
+        } else {
+            n = write(p->fd, buf, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                slapi_log_err(SLAPI_LOG_ERR, "export_output",
+                              "export %s: Failed to write in export file. errno=%d\n",
+                              p->inst->inst_name, errno);
+                return -1;
+            }
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * Write a formatted item and free its buffer.  Nothing is written after an
+ * error, but the items are still consumed.
+ */
+static int
+export_write_item(export_pipeline *p, export_item *item, int err)
+{
+    if (item->out && err == 0 && export_output(p, item->out, item->outlen)) {
+        err = -1;
+    }
+    if (item->out && item->is_entry) {
+        p->cnt++;
+        if (p->cnt % EXPORT_PROGRESS_COUNT == 0 && p->progress) {
+            p->progress(p->arg, p->cnt, item->percent);
+        }
+    }
+    slapi_ch_free_string(&item->out);
+    item->outlen = 0;
+    return err;
+}
+
+static void
+export_worker_thread(void *param)
+{
+    export_pipeline *p = (export_pipeline *)param;
+
+    pthread_mutex_lock(&p->mutex);
+    while (1) {
+        export_item *item = NULL;
+        uint64_t seq;
+
+        while (!p->stop && p->work_seq == p->next_seq) {
+            pthread_cond_wait(&p->cv, &p->mutex);
+        }
+        if (p->work_seq == p->next_seq) {
+            /* stopped and nothing left to format */
+            break;
+        }
+        seq = p->work_seq++;
+        item = &p->slots[seq % p->nbslots];
+        if (item->seq != seq || item->state != EXPORT_ITEM_PENDING) {
+            /* raw string, possibly already written */
+            continue;
+        }
+        item->state = EXPORT_ITEM_FORMATTING;
+        pthread_mutex_unlock(&p->mutex);
+
+        export_format_item(p, item);
+
+        pthread_mutex_lock(&p->mutex);
+        item->state = EXPORT_ITEM_READY;
+        pthread_cond_broadcast(&p->cv);
+    }
+    pthread_mutex_unlock(&p->mutex);
+}
+
+static void
+export_writer_thread(void *param)
+{
+    export_pipeline *p = (export_pipeline *)param;
+
+    pthread_mutex_lock(&p->mutex);
+    while (1) {
+        export_item *item = &p->slots[p->write_seq % p->nbslots];
+        int err = p->err;
+
+        while (p->write_seq < p->next_seq && item->state != EXPORT_ITEM_READY) {
+            pthread_cond_wait(&p->cv, &p->mutex);
+        }
+        if (p->write_seq == p->next_seq) {
+            if (p->stop) {
+                break;
+            }
+            pthread_cond_wait(&p->cv, &p->mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&p->mutex);
+
+        err = export_write_item(p, item, err);
+
+        pthread_mutex_lock(&p->mutex);
+        p->err = err;
+        item->state = EXPORT_ITEM_FREE;
+        p->write_seq++;
+        pthread_cond_broadcast(&p->cv);
+    }
+    pthread_mutex_unlock(&p->mutex);
+}
+
+static PRThread *
+export_create_thread(void (*fn)(void *), export_pipeline *p)
+{
+    PRThread *thread = PR_CreateThread(PR_USER_THREAD, fn, p,
+                                       PR_PRIORITY_NORMAL, PR_GLOBAL_BOUND_THREAD,
+                                       PR_JOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+    if (thread == NULL) {
+        PRErrorCode prerr = PR_GetError();
+        slapi_log_err(SLAPI_LOG_ERR, "export_create_thread",
+                      "Unable to spawn export thread, " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                      prerr, slapd_pr_strerror(prerr));
+    }
+    return thread;
+}
+
+/*
+ * Create the pipeline writing to fd.  format is called on every entry (in
+ * any thread) and returns its LDIF text, or NULL to skip it.  progress is
+ * called from the writer every EXPORT_PROGRESS_COUNT entries.  fname is
+ * only used to select the compression.  Returns NULL if the compressed
+ * stream could not be opened.
+ */
+export_pipeline *
+export_pipeline_new(ldbm_instance *inst, int fd, const char *fname, export_format_fn format, export_progress_fn progress, void *arg)
+{
+    export_pipeline *p = (export_pipeline *)slapi_ch_calloc(1, sizeof(export_pipeline));
+    size_t flen = fname ? strlen(fname) : 0;
+    int nbthreads = export_threads(inst->inst_li);
+
+    p->inst = inst;
+    p->fd = fd;
+    p->format = format;
+    p->progress = progress;
+    p->arg = arg;
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cv, NULL);
+
+    if (flen > strlen(EXPORT_GZIP_SUFFIX) &&
+        strcasecmp(fname + flen - strlen(EXPORT_GZIP_SUFFIX), EXPORT_GZIP_SUFFIX) == 0) {
+        /* gzclose() closes the descriptor, the caller still owns fd */
+        int gzfd = dup(fd);
+
+        if (gzfd < 0 || (p->gz = gzdopen(gzfd, "wb")) == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, "export_pipeline_new",
+                          "export %s: Failed to open the compressed stream on %s. errno=%d\n",
+                          inst->inst_name, fname, errno);
+            if (gzfd >= 0) {
+                close(gzfd);
+            }
+            export_pipeline_done(&p, NULL);
+            return NULL;
+        }
+    }
+
+    if (nbthreads < 2) {
+        return p;
+    }
+    p->nbslots = nbthreads * EXPORT_WINDOW;
+    p->slots = (export_item *)slapi_ch_calloc(p->nbslots, sizeof(export_item));
+    p->threads = (PRThread **)slapi_ch_calloc(nbthreads, sizeof(PRThread *));
+    p->writer = export_create_thread(export_writer_thread, p);
+    for (int i = 0; p->writer && i < nbthreads; i++) {
+        p->threads[i] = export_create_thread(export_worker_thread, p);
+        if (p->threads[i] == NULL) {
+            break;
+        }
+        p->nbthreads++;
+    }
+    if (p->nbthreads == 0) {
+        /* write sequentially */
+        if (p->writer) {
+            pthread_mutex_lock(&p->mutex);
+            p->stop = 1;
+            pthread_cond_broadcast(&p->cv);
+            pthread_mutex_unlock(&p->mutex);
+            PR_JoinThread(p->writer);
+            p->writer = NULL;
+            p->stop = 0;
+        }
+        slapi_ch_free((void **)&p->slots);
+        p->nbslots = 0;
+    } else {
+        slapi_log_err(SLAPI_LOG_INFO, "export_pipeline_new",
+                      "export %s: Formatting the entries with %d threads%s\n",
+                      inst->inst_name, p->nbthreads, p->gz ? ", gzip output" : "");
+    }
+    return p;
+}
+
+/* Queue an item, or format and write it at once in sequential mode */
+static int
+export_pipeline_queue(export_pipeline *p, export_item *src)
+{
+    export_item *item;
+    int rc;
+
+    if (p->nbthreads == 0) {
+        if (src->state == EXPORT_ITEM_PENDING) {
+            export_format_item(p, src);
+        }
+        p->err = export_write_item(p, src, p->err);
+        return p->err;
+    }
+
+    pthread_mutex_lock(&p->mutex);
+    while (p->next_seq - p->write_seq >= (uint64_t)p->nbslots && p->err == 0) {
+        pthread_cond_wait(&p->cv, &p->mutex);
+    }
+    rc = p->err;
+    if (rc == 0) {
+        item = &p->slots[p->next_seq % p->nbslots];
+        *item = *src;
+        item->seq = p->next_seq++;
+        pthread_cond_broadcast(&p->cv);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    if (rc) {
+        backentry_free(&src->ep);
+        slapi_ch_free_string(&src->dn);
+        slapi_ch_free_string(&src->data);
+        slapi_ch_free_string(&src->out);
+    }
+    return rc;
+}
+
+/* Write str as is, after the items already submitted */
+int
+export_pipeline_write(export_pipeline *p, const char *str, size_t len)
+{
+    export_item item = {0};
+
+    item.state = EXPORT_ITEM_READY;
+    item.out = slapi_ch_malloc(len + 1);
+    memcpy(item.out, str, len);
+    item.out[len] = '\0';
+    item.outlen = len;
+    return export_pipeline_queue(p, &item);
+}
+
+/*
+ * Export an entry.  The pipeline owns ep, even on error.  percent is the
+ * progress of the export when the entry is read.
+ */
+int
+export_pipeline_submit(export_pipeline *p, struct backentry *ep, int percent)
+{
+    export_item item = {0};
+
+    item.state = EXPORT_ITEM_PENDING;
+    item.ep = ep;
+    item.percent = percent;
+    item.is_entry = 1;
+    return export_pipeline_queue(p, &item);
+}
+
+/*
+ * Export a stored entry: it is parsed by a worker with slapi_str2entry_ext()
+ * if dn is set, slapi_str2entry() otherwise.  dn and data are copied.
+ */
+int
+export_pipeline_submit_raw(export_pipeline *p, ID id, const char *dn, const char *data, size_t len, int flags, int percent)
+{
+    export_item item = {0};
+
+    item.state = EXPORT_ITEM_PENDING;
+    item.id = id;
+    item.dn = slapi_ch_strdup(dn);
+    item.data = slapi_ch_malloc(len + 1);
+    memcpy(item.data, data, len);
+    item.data[len] = '\0';
+    item.flags = flags;
+    item.percent = percent;
+    item.is_entry = 1;
+    return export_pipeline_queue(p, &item);
+}
+
+/* Formatting is done by worker threads */
+int
+export_pipeline_is_parallel(export_pipeline *p)
+{
+    return p && p->nbthreads > 0;
+}
+
+/*
+ * Flush the submitted items, stop the threads and free the pipeline.
+ * *cnt is set to the number of entries written.  Returns 0 or the first
+ * write error.
+ */
+int
+export_pipeline_done(export_pipeline **pp, int *cnt)
+{
+    export_pipeline *p = *pp;
+    int rc;
+
+    if (p == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&p->mutex);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->cv);
+    pthread_mutex_unlock(&p->mutex);
+    for (int i = 0; i < p->nbthreads; i++) {
+        PR_JoinThread(p->threads[i]);
+    }
+    if (p->writer) {
+        PR_JoinThread(p->writer);
+    }
+    /* items left by a write error */
+    for (uint64_t seq = p->write_seq; seq < p->next_seq; seq++) {
+        export_item *item = &p->slots[seq % p->nbslots];
+        slapi_ch_free_string(&item->out);
+    }
+    if (p->gz) {
+        int zrc = gzclose(p->gz);
+        if (zrc != Z_OK && p->err == 0) {
+            slapi_log_err(SLAPI_LOG_ERR, "export_pipeline_done",
+                          "export %s: Failed to complete the compressed export file (%d)\n",
+                          p->inst->inst_name, zrc);
+            p->err = -1;
+        }
+    }
+    if (cnt) {
+        *cnt = p->cnt;
+    }
+    rc = p->err;
+    pthread_mutex_destroy(&p->mutex);
+    pthread_cond_destroy(&p->cv);
+    slapi_ch_free((void **)&p->threads);
+    slapi_ch_free((void **)&p->slots);
+    slapi_ch_free((void **)pp);
+    return rc;
+}
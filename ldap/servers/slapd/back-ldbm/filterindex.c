@@ -45,6 +45,7 @@ keys2idl(
     int *unindexed,
     back_txn *txn,
     int allidslimit);
+static void keys_lookup_stat(Op_search_stat *search_stat, const char *type, const char *indextype, const struct berval *key, IDList *idl);
 
 IDList *
 filter_candidates_ext(
@@ -408,6 +409,7 @@ presence_candidates(
     } else {
         idl = index_read_ext_allids(pb, be, type, indextype_PRESENCE,
                                     NULL, &txn, err, &unindexed, allidslimit);
+        keys_lookup_stat(op_stat_get_search_stat(pb), type, indextype_PRESENCE, NULL, idl);
     }
 
     if (unindexed) {
@@ -719,6 +721,224 @@ filter_is_subtype(Slapi_Filter *f)
     return issubtype;
 }
 
+/*
+ * Cost based ordering of the components of an AND or an OR, enabled by
+ * nsslapd-filter-cost-optimizer.
+ *
+ * Before any id list is read, the size of each component is estimated from
+ * the index itself: index_estimate positions a cursor on the key and asks
+ * for the number of duplicates, which is much cheaper than reading them.
+ * The components of an AND are then read cheapest first, so that the
+ * intersection shortcut (FILTER_TEST_THRESHOLD) triggers as early as
+ * possible, and the components that would cost more to read than to filter
+ * test the candidates already found are not read at all.  An AND or an OR
+ * that is expected to match nearly the whole database is not worth reading:
+ * the search falls back to allids and the filter test.
+ */
+#define FILTER_COST_ENTRY     32 /* cost of filter testing one candidate, in ids read */
+#define FILTER_COST_SCAN_PCT  90 /* share of the entries above which a scan is cheaper */
+#define FILTER_COST_MAX_DEPTH 3  /* how deep nested AND/OR are estimated */
+
+typedef struct filter_cost
+{
+    Slapi_Filter *fc_filter;
+    uint64_t fc_cost; /* estimated ids, nentries + 1 if unindexed */
+    size_t fc_pos;    /* position in the filter, keeps the sort stable */
+} filter_cost;
+
+static uint64_t
+filter_estimate_keys(Slapi_PBlock *pb, backend *be, char *type, const char *indextype, Slapi_Value **ivals, int allidslimit)
+{
+    uint64_t estimate = IDL_ESTIMATE_ALLIDS;
+    back_txn txn = {NULL};
+
+    slapi_pblock_get(pb, SLAPI_TXN, &txn.back_txn_txn);
+    for (size_t i = 0; ivals && ivals[i]; i++) {
+        uint64_t e = IDL_ESTIMATE_ALLIDS;
+
+        index_estimate(pb, be, type, indextype, slapi_value_get_berval(ivals[i]), &txn, allidslimit, &e);
+        /* the id lists of the keys are intersected (see keys2idl) */
+        if (e < estimate) {
+            estimate = e;
+        }
+    }
+    return estimate;
+}
+
+/*
+ * Estimated number of candidates of a filter component.  Unindexed
+ * components cost nentries + 1, so that they sort after everything else.
+ */
+static uint64_t
+filter_estimate(Slapi_PBlock *pb, backend *be, Slapi_Filter *f, int allidslimit, uint64_t nentries, int depth)
+{
+    uint64_t estimate = IDL_ESTIMATE_UNKNOWN;
+    Slapi_Value **ivals = NULL;
+    Slapi_Filter *sub;
+    Slapi_Attr sattr;
+    Slapi_Value sv;
+    struct berval *bval;
+    char *type;
+    int ftype = slapi_filter_get_choice(f);
+
+    if (f->f_flags & SLAPI_FILTER_INVALID_ATTR_UNDEFINE) {
+        /* rejected by policy, matches nothing */
+        return 0;
+    }
+
+    switch (ftype) {
+    case LDAP_FILTER_EQUALITY:
+    case LDAP_FILTER_APPROX:
+        if (slapi_filter_get_ava(f, &type, &bval) != 0) {
+            break;
+        }
+        slapi_attr_init(&sattr, type);
+        slapi_value_init_berval(&sv, bval);
+        slapi_attr_assertion2keys_ava_sv(&sattr, &sv, &ivals, ftype);
+        value_done(&sv);
+        attr_done(&sattr);
+        estimate = filter_estimate_keys(pb, be, type,
+                                        (ftype == LDAP_FILTER_EQUALITY) ? indextype_EQUALITY : indextype_APPROX,
+                                        ivals, allidslimit);
+        valuearray_free(&ivals);
+        break;
+
+    case LDAP_FILTER_SUBSTRINGS: {
+        char *initial, *final, **any;
+        struct attrinfo *ai = NULL;
+
+        if (slapi_filter_get_subfilt(f, &type, &initial, &any, &final) != 0) {
+            break;
+        }
+        ainfo_get(be, type, &ai);
+        if ((ai->ai_indexmask & INDEX_SUBPOS) && !(ai->ai_indexmask & INDEX_SUBPOS_OFFLINE)) {
+            /* the positional grams are only known once intersected */
+            break;
+        }
+        slapi_attr_init(&sattr, type);
+        slapi_pblock_set(pb, SLAPI_SYNTAX_SUBSTRLENS, ai->ai_substr_lens);
+        slapi_attr_assertion2keys_sub_sv_pb(pb, &sattr, initial, any, final, &ivals);
+        attr_done(&sattr);
+        estimate = filter_estimate_keys(pb, be, type, indextype_SUB, ivals, allidslimit);
+        valuearray_free(&ivals);
+        break;
+    }
+
+    case LDAP_FILTER_PRESENT: {
+        back_txn txn = {NULL};
+
+        if (slapi_filter_get_type(f, &type) != 0) {
+            break;
+        }
+        slapi_pblock_get(pb, SLAPI_TXN, &txn.back_txn_txn);
+        index_estimate(pb, be, type, indextype_PRESENCE, NULL, &txn, allidslimit, &estimate);
+        break;
+    }
+
+    case LDAP_FILTER_AND:
+    case LDAP_FILTER_OR:
+        if (depth >= FILTER_COST_MAX_DEPTH) {
+            break;
+        }
+        estimate = (ftype == LDAP_FILTER_AND) ? nentries + 1 : 0;
+        for (sub = slapi_filter_list_first(f); sub; sub = slapi_filter_list_next(f, sub)) {
+            uint64_t e = filter_estimate(pb, be, sub, allidslimit, nentries, depth + 1);
+            if (ftype == LDAP_FILTER_AND) {
+                estimate = (e < estimate) ? e : estimate;
+            } else {
+                estimate = (e > nentries - estimate) ? nentries + 1 : estimate + e;
+            }
+        }
+        return estimate;
+
+    case LDAP_FILTER_NOT:
+        return nentries;
+
+    default:
+        /* ranges and extensible filters: no cheap way to tell */
+        break;
+    }
+
+    if (estimate == IDL_ESTIMATE_ALLIDS) {
+        return nentries + 1;
+    } else if (estimate == IDL_ESTIMATE_UNKNOWN) {
+        return nentries / 3;
+    }
+    return (estimate > nentries) ? nentries : estimate;
+}
+
+static int
+filter_cost_cmp(const void *a, const void *b)
+{
+    const filter_cost *fa = (const filter_cost *)a;
+    const filter_cost *fb = (const filter_cost *)b;
+
+    if (fa->fc_cost != fb->fc_cost) {
+        return (fa->fc_cost < fb->fc_cost) ? -1 : 1;
+    }
+    return (fa->fc_pos < fb->fc_pos) ? -1 : 1;
+}
+
+/*
+ * Returns the components of flist in the order they should be read, or
+ * NULL if the filter must be evaluated as written.  *scan is set when
+ * reading the indexes is not worth it.
+ */
+static filter_cost *
+filter_cost_plan(Slapi_PBlock *pb, backend *be, Slapi_Filter *flist, int ftype, int allidslimit, size_t *nplan, int *scan)
+{
+    ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
+    Slapi_Filter *search_filter = NULL;
+    Slapi_Operation *op = NULL;
+    filter_cost *plan = NULL;
+    uint64_t nentries;
+    uint64_t total = 0;
+    size_t n = 0;
+    Slapi_Filter *f;
+
+    *nplan = 0;
+    *scan = 0;
+
+    /* Tombstone and RUV searches rely on the filter ordering */
+    slapi_pblock_get(pb, SLAPI_SEARCH_FILTER, &search_filter);
+    if ((flist->f_flags & (SLAPI_FILTER_TOMBSTONE | SLAPI_FILTER_RUV)) ||
+        (search_filter && (search_filter->f_flags & (SLAPI_FILTER_TOMBSTONE | SLAPI_FILTER_RUV)))) {
+        return NULL;
+    }
+
+    for (f = slapi_filter_list_first(flist); f; f = slapi_filter_list_next(flist, f)) {
+        n++;
+    }
+    if (n < 2) {
+        return NULL;
+    }
+
+    nentries = next_id_get(be);
+    nentries = (nentries > 1) ? nentries - 1 : 1;
+    plan = (filter_cost *)slapi_ch_calloc(n, sizeof(filter_cost));
+    n = 0;
+    for (f = slapi_filter_list_first(flist); f; f = slapi_filter_list_next(flist, f)) {
+        plan[n].fc_filter = f;
+        plan[n].fc_pos = n;
+        plan[n].fc_cost = filter_estimate(pb, be, f, allidslimit, nentries, 1);
+        total = (plan[n].fc_cost > nentries - total) ? nentries + 1 : total + plan[n].fc_cost;
+        n++;
+    }
+    qsort(plan, n, sizeof(filter_cost), filter_cost_cmp);
+    *nplan = n;
+
+    /* A scan would show as an unindexed search, which can be refused */
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    if (inst->require_index || (inst->require_internalop_index && op && operation_is_flag_set(op, OP_FLAG_INTERNAL))) {
+        return plan;
+    }
+    if ((ftype == LDAP_FILTER_AND && plan[0].fc_cost > nentries * FILTER_COST_SCAN_PCT / 100) ||
+        (ftype == LDAP_FILTER_OR && total > nentries * FILTER_COST_SCAN_PCT / 100)) {
+        *scan = 1;
+    }
+    return plan;
+}
+
 static IDList *
 list_candidates(
     Slapi_PBlock *pb,
@@ -743,6 +963,11 @@ list_candidates(
     int is_and = 0;
     IDListSet *idl_set = NULL;
     back_search_result_set *sr = NULL;
+    struct ldbminfo *li = (struct ldbminfo *)be->be_database->plg_private;
+    filter_cost *plan = NULL;
+    size_t nplan = 0;
+    size_t i = 0;
+    int scan = 0;
 
     slapi_pblock_get(pb, SLAPI_SEARCH_RESULT_SET, &sr);
 
@@ -840,12 +1065,38 @@ list_candidates(
 
     if (ftype == LDAP_FILTER_OR || ftype == LDAP_FILTER_AND) {
         idl_set = idl_set_create();
+        /* Without a result set the filter test cannot be forced, so the
+         * candidates must be exact */
+        if (li->li_filter_cost_optimizer && sr != NULL && fpairs[0] == NULL) {
+            plan = filter_cost_plan(pb, be, flist, ftype, allidslimit, &nplan, &scan);
+        }
+    }
+
+    if (scan) {
+        slapi_log_err(SLAPI_LOG_FILTER, "list_candidates",
+                      "Estimated cost is higher than a scan - must apply filter test\n");
+        sr->sr_flags |= SR_FLAG_MUST_APPLY_FILTER_TEST;
+        idl = idl_allids(be);
+        goto out;
     }
 
     idl = NULL;
     nextf = NULL;
-    for (f_head = f = slapi_filter_list_first(flist); f != NULL;
-         f = slapi_filter_list_next(flist, f)) {
+    for (f_head = f = (plan ? plan[0].fc_filter : slapi_filter_list_first(flist)); f != NULL;
+         f = (plan ? (++i < nplan ? plan[i].fc_filter : NULL) : slapi_filter_list_next(flist, f))) {
+
+        if (plan && ftype == LDAP_FILTER_AND && idl_set->minimum != NULL &&
+            plan[i].fc_cost > (uint64_t)idl_set->minimum->b_nids * FILTER_COST_ENTRY) {
+            /*
+             * Reading the remaining components costs more than filter
+             * testing the candidates we already have.
+             */
+            slapi_log_err(SLAPI_LOG_FILTER, "list_candidates",
+                          "Skipping %lu components estimated at %" PRIu64 " ids or more - must apply filter test\n",
+                          (u_long)(nplan - i), plan[i].fc_cost);
+            sr->sr_flags |= SR_FLAG_MUST_APPLY_FILTER_TEST;
+            goto apply_set_op;
+        }
 
         /* Look for NOT foo type filter elements where foo is simple equality */
         isnot = (LDAP_FILTER_NOT == slapi_filter_get_choice(f)) &&
@@ -990,6 +1241,7 @@ out:
     slapi_ch_bvfree(&vpairs[0]);
     slapi_ch_free_string(&tpairs[1]);
     slapi_ch_bvfree(&vpairs[1]);
+    slapi_ch_free((void **)&plan);
     return (idl);
 }
 
@@ -1018,6 +1270,22 @@ substring_candidates(
         return (NULL);
     }
 
+    /*
+     * the positional index proves the grams are adjacent, prefer it
+     */
+    if (!(f->f_flags & SLAPI_FILTER_INVALID_ATTR_UNDEFINE)) {
+        idl = index_subpos_candidates(pb, be, type, initial, any, final, err, allidslimit);
+        if (idl != NULL && !ALLIDS(idl)) {
+            if (f->f_flags & SLAPI_FILTER_INVALID_ATTR_WARN) {
+                slapi_pblock_set_flag_operation_notes(pb, SLAPI_OP_NOTE_FILTER_INVALID);
+            }
+            slapi_log_err(SLAPI_LOG_TRACE, "substring_candidates", "<= %lu (subpos)\n",
+                          (u_long)IDL_NIDS(idl));
+            return (idl);
+        }
+        idl_free(&idl);
+    }
+
     /*
      * get the index keys corresponding to the substring
      * assertion values
@@ -1073,6 +1341,44 @@ substring_candidates(
     return (idl);
 }
 
+/*
+ * Gather the statistics of an index lookup, including the ones that
+ * returned ALLIDS because the attribute is not indexed.
+ */
+static void
+keys_lookup_stat(Op_search_stat *search_stat, const char *type, const char *indextype, const struct berval *key, IDList *idl)
+{
+    struct component_keys_lookup *key_stat;
+
+    if (search_stat == NULL) {
+        return;
+    }
+    key_stat = (struct component_keys_lookup *) slapi_ch_calloc(1, sizeof (struct component_keys_lookup));
+
+    /* indextype e.g. "eq" or "sub" (see index.c) */
+    if (indextype) {
+        key_stat->index_type = slapi_ch_strdup(indextype);
+    }
+    /* key value e.g. '^st' or 'smith', none for a presence lookup */
+    key_stat->key = (char *) slapi_ch_calloc(1, (key ? key->bv_len : 0) + 1);
+    if (key && key->bv_len) {
+        memcpy(key_stat->key, key->bv_val, key->bv_len);
+    }
+
+    /* attribute name e.g. 'uid' */
+    if (type) {
+        key_stat->attribute_type = slapi_ch_strdup(type);
+    }
+
+    /* Number of lookup IDs with the key */
+    key_stat->id_lookup_cnt = idl ? idl->b_nids : 0;
+    key_stat->allids = idl && ALLIDS(idl);
+
+    /* add key_stat at the head */
+    key_stat->next = search_stat->keys_lookup;
+    search_stat->keys_lookup = key_stat;
+}
+
 static IDList *
 keys2idl(
     Slapi_PBlock *pb,
@@ -1086,57 +1392,22 @@ keys2idl(
     int allidslimit)
 {
     IDList *idl = NULL;
-    Op_stat *op_stat = NULL;
+    Op_search_stat *search_stat = NULL;
 
     slapi_log_err(SLAPI_LOG_TRACE, "keys2idl", "=> type %s indextype %s\n", type, indextype);
 
     /* Before reading the index take the start time */
-    if (LDAP_STAT_READ_INDEX & config_get_statlog_level()) {
-        op_stat = op_stat_get_operation_extension(pb);
-        if (op_stat->search_stat) {
-            clock_gettime(CLOCK_MONOTONIC, &(op_stat->search_stat->keys_lookup_start));
-        } else {
-            op_stat = NULL;
-        }
+    search_stat = op_stat_get_search_stat(pb);
+    if (search_stat) {
+        clock_gettime(CLOCK_MONOTONIC, &(search_stat->keys_lookup_start));
     }
 
     for (uint32_t i = 0; ivals[i] != NULL; i++) {
         IDList *idl2 = NULL;
-        struct component_keys_lookup *key_stat;
-        int key_len;
 
         idl2 = index_read_ext_allids(pb, be, type, indextype, slapi_value_get_berval(ivals[i]), txn, err, unindexed, allidslimit);
-        if (op_stat) {
-            /* gather the index lookup statistics */
-            key_stat = (struct component_keys_lookup *) slapi_ch_calloc(1, sizeof (struct component_keys_lookup));
-
-            /* indextype e.g. "eq" or "sub" (see index.c) */
-            if (indextype) {
-                key_stat->index_type = slapi_ch_strdup(indextype);
-            }
-            /* key value e.g. '^st' or 'smith'*/
-            key_len = slapi_value_get_length(ivals[i]);
-            if (key_len) {
-                key_stat->key = (char *) slapi_ch_calloc(1, key_len + 1);
-                memcpy(key_stat->key, slapi_value_get_string(ivals[i]), key_len);
-            }
-
-            /* attribute name e.g. 'uid' */
-            if (type) {
-                key_stat->attribute_type = slapi_ch_strdup(type);
-            }
-
-            /* Number of lookup IDs with the key */
-            key_stat->id_lookup_cnt = idl2 ? idl2->b_nids : 0;
-            if (op_stat->search_stat->keys_lookup) {
-                /* it already exist key stat. add key_stat at the head */
-                key_stat->next = op_stat->search_stat->keys_lookup;
-            } else {
-                /* this is the first key stat record */
-                key_stat->next = NULL;
-            }
-            op_stat->search_stat->keys_lookup = key_stat;
-        }
+        /* gather the index lookup statistics */
+        keys_lookup_stat(search_stat, type, indextype, slapi_value_get_berval(ivals[i]), idl2);
 #ifdef LDAP_ERROR_LOGGING
         /* XXX if ( slapd_ldap_debug & LDAP_DEBUG_TRACE ) { XXX */
         {
@@ -1171,8 +1442,9 @@ keys2idl(
     }
 
     /* All the keys have been fetch, time to take the completion time */
-    if (op_stat) {
-        clock_gettime(CLOCK_MONOTONIC, &(op_stat->search_stat->keys_lookup_end));
+    if (search_stat) {
+        clock_gettime(CLOCK_MONOTONIC, &(search_stat->keys_lookup_end));
+        search_stat->index_ns += op_stat_elapsed_ns(&(search_stat->keys_lookup_start));
     }
 
     return (idl);
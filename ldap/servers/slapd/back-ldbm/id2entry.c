@@ -15,6 +15,10 @@
 
 #include "back-ldbm.h"
 
+#ifdef SYSTEMTAP
+#include <sys/sdt.h>
+#endif
+
 #define ID2ENTRY "id2entry"
 
 /*
@@ -274,6 +278,10 @@ id2entry(backend *be, ID id, back_txn *txn, int *err)
     slapi_log_err(SLAPI_LOG_TRACE, ID2ENTRY,
                   "=> id2entry(%lu)\n", (u_long)id);
 
+#ifdef SYSTEMTAP
+    STAP_PROBE1(ns-slapd, id2entry__entry, id);
+#endif
+
     if ((e = cache_find_id(&inst->inst_cache, id)) != NULL) {
         slapi_log_err(SLAPI_LOG_TRACE, ID2ENTRY,
                       "<= id2entry %p, dn \"%s\" (cache)\n",
@@ -285,6 +293,9 @@ id2entry(backend *be, ID id, back_txn *txn, int *err)
     if ((*err != 0) || (NULL == db)) {
         slapi_log_err(SLAPI_LOG_ERR, ID2ENTRY,
                       "Could not open id2entry err %d\n", *err);
+#ifdef SYSTEMTAP
+        STAP_PROBE2(ns-slapd, id2entry__return, id, 0);
+#endif
         return (NULL);
     }
 
@@ -320,6 +331,9 @@ id2entry(backend *be, ID id, back_txn *txn, int *err)
             exit(1);
         }
         dblayer_release_id2entry(be, db);
+#ifdef SYSTEMTAP
+        STAP_PROBE2(ns-slapd, id2entry__return, id, 0);
+#endif
         return (NULL);
     }
 
@@ -477,5 +491,91 @@ bail:
 
     slapi_log_err(SLAPI_LOG_TRACE, ID2ENTRY,
                   "<= id2entry( %lu ) %p (disk)\n", (u_long)id, e);
+#ifdef SYSTEMTAP
+    STAP_PROBE2(ns-slapd, id2entry__return, id, e != NULL);
+#endif
     return (e);
 }
+
+/*
+ * Put the dn of entry id into the dn cache without building the entry
+ * itself.  Used to warm up the dn cache at startup (see cache_snapshot.c).
+ * Returns 0 if the dn is in the dn cache on return.
+ */
+int
+id2entry_cache_dn(backend *be, ID id)
+{
+    ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
+    dbi_db_t *db = NULL;
+    dbi_val_t key = {0};
+    dbi_val_t data = {0};
+    char temp_id[sizeof(ID)];
+    char *rdn = NULL;
+    char *normdn = NULL;
+    Slapi_RDN *srdn = NULL;
+    Slapi_DN *sdn = NULL;
+    struct backdn *bdn = NULL;
+    uint32_t esize;
+    int rc;
+
+    if (!entryrdn_get_switch()) {
+        return -1;
+    }
+    if (cache_has_id(&inst->inst_dncache, id)) {
+        return 0;
+    }
+
+    rc = dblayer_get_id2entry(be, &db);
+    if ((rc != 0) || (NULL == db)) {
+        slapi_log_err(SLAPI_LOG_ERR, "id2entry_cache_dn",
+                      "Could not open id2entry err %d\n", rc);
+        return -1;
+    }
+
+    id_internal_to_stored(id, temp_id);
+    dblayer_value_set_buffer(be, &key, temp_id, sizeof(temp_id));
+    dblayer_value_init(be, &data);
+    do {
+        rc = dblayer_db_op(be, db, NULL, DBI_OP_GET, &key, &data);
+    } while (DBI_RC_RETRY == rc);
+    if ((rc != 0) || (NULL == data.dptr)) {
+        /* The entry is gone */
+        rc = -1;
+        goto bail;
+    }
+
+    esize = (uint32_t)data.dsize;
+    plugin_call_entryfetch_plugins((char **)&data.dptr, &esize);
+    data.dsize = esize;
+
+    if (config_get_return_orig_dn() &&
+        !get_value_from_string((const char *)data.dptr, SLAPI_ATTR_DS_ENTRYDN, &normdn)) {
+        rc = 0;
+    } else if (get_value_from_string((const char *)data.dptr, "rdn", &rdn)) {
+        rc = -1;
+        goto bail;
+    } else {
+        rc = entryrdn_lookup_dn(be, rdn, id, &normdn, &srdn, NULL);
+        if (rc || (NULL == normdn)) {
+            rc = -1;
+            goto bail;
+        }
+    }
+
+    sdn = slapi_sdn_new_normdn_byval((const char *)normdn);
+    bdn = backdn_init(sdn, id, 0);
+    if (CACHE_ADD(&inst->inst_dncache, bdn, NULL)) {
+        /* Somebody else added it in the meantime */
+        backdn_free(&bdn);
+    } else {
+        CACHE_RETURN(&inst->inst_dncache, &bdn);
+    }
+
+bail:
+    slapi_ch_free_string(&rdn);
+    slapi_ch_free_string(&normdn);
+    slapi_rdn_free(&srdn);
+    dblayer_value_free(be, &data);
+    dblayer_release_id2entry(be, db);
+    return rc;
+}
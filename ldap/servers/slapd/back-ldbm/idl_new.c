@@ -303,6 +303,74 @@ error:
     return idl;
 }
 
+/*
+ * Estimate the number of ids stored under a key without reading them:
+ * position a cursor on the key and ask the database for the number of
+ * duplicates.  *count is set to IDL_ESTIMATE_ALLIDS if the key is an
+ * allids key or if reading it would exceed the allidslimit.
+ */
+int
+idl_new_estimate(backend *be, dbi_db_t *db, dbi_val_t *inkey, dbi_txn_t *txn, struct attrinfo *a, int allidslimit, uint64_t *count)
+{
+    int ret = 0;
+    int ret2 = 0;
+    dbi_cursor_t cursor = {0};
+    dbi_val_t key = {0};
+    dbi_val_t data = {0};
+    dbi_recno_t dups = 0;
+    ID id = 0;
+    back_txn s_txn = {0};
+    struct ldbminfo *li = (struct ldbminfo *)be->be_database->plg_private;
+    char *index_id = get_index_name(be, db, a);
+
+    *count = 0;
+    dblayer_txn_init(li, &s_txn);
+    if (txn) {
+        dblayer_read_txn_begin(be, txn, &s_txn);
+    }
+    ret = dblayer_new_cursor(be, db, s_txn.back_txn_txn, &cursor);
+    if (0 != ret) {
+        ldbm_nasty("idl_new_estimate - idl_new.c", index_id, 101, ret);
+        goto error;
+    }
+    dblayer_value_set_buffer(be, &key, inkey->data, inkey->size);
+    dblayer_value_set_buffer(be, &data, &id, sizeof(id));
+    ret = dblayer_cursor_op(&cursor, DBI_OP_MOVE_TO_KEY, &key, &data);
+    if (DBI_RC_NOTFOUND == ret) {
+        /* empty */
+        ret = 0;
+        goto error;
+    } else if (0 != ret) {
+        ldbm_nasty("idl_new_estimate - idl_new.c", index_id, 102, ret);
+        goto error;
+    }
+    if (id == ALLID) {
+        *count = IDL_ESTIMATE_ALLIDS;
+        goto error;
+    }
+    ret = dblayer_cursor_get_count(&cursor, &dups);
+    if (0 != ret) {
+        ldbm_nasty("idl_new_estimate - idl_new.c", index_id, 103, ret);
+        goto error;
+    }
+    *count = (uint64_t)dups;
+    if (idl_new_exceeds_allidslimit(*count, a, allidslimit)) {
+        *count = IDL_ESTIMATE_ALLIDS;
+    }
+
+error:
+    ret2 = dblayer_cursor_op(&cursor, DBI_OP_CLOSE, NULL, NULL);
+    if (ret2 && !ret) {
+        ret = ret2;
+    }
+    if (ret) {
+        dblayer_read_txn_abort(be, &s_txn);
+    } else {
+        dblayer_read_txn_commit(be, &s_txn);
+    }
+    return ret;
+}
+
 
 
 /* This function compares two index keys.  It is assumed
@@ -35,6 +35,7 @@ int idl_new_init_private(backend *be, struct attrinfo *a);
 int idl_new_release_private(struct attrinfo *a);
 size_t idl_new_get_allidslimit(struct attrinfo *a, int allidslimit);
 IDList *idl_new_fetch(backend *be, dbi_db_t *db, dbi_val_t *key, dbi_txn_t *txn, struct attrinfo *a, int *err, int allidslimit);
+int idl_new_estimate(backend *be, dbi_db_t *db, dbi_val_t *key, dbi_txn_t *txn, struct attrinfo *a, int allidslimit, uint64_t *count);
 int idl_new_insert_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, dbi_txn_t *txn, struct attrinfo *a, int *disposition);
 int idl_new_delete_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, dbi_txn_t *txn, struct attrinfo *a);
 int idl_new_store_block(backend *be, dbi_db_t *db, dbi_val_t *key, IDList *idl, dbi_txn_t *txn, struct attrinfo *a);
@@ -117,6 +118,18 @@ idl_fetch(backend *be, dbi_db_t *db, dbi_val_t *key, dbi_txn_t *txn, struct attr
     return idl_fetch_ext(be, db, key, txn, a, err, 0);
 }
 
+/* Only the new idl format can count the ids of a key without reading them */
+int
+idl_estimate(backend *be, dbi_db_t *db, dbi_val_t *key, dbi_txn_t *txn, struct attrinfo *a, int allidslimit, uint64_t *count)
+{
+    if (idl_new) {
+        return idl_new_estimate(be, db, key, txn, a, allidslimit, count);
+    } else {
+        *count = IDL_ESTIMATE_UNKNOWN;
+        return 0;
+    }
+}
+
 int
 idl_insert_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, back_txn *txn, struct attrinfo *a, int *disposition)
 {
@@ -141,6 +141,382 @@ ldbm_back_wire_import(Slapi_PBlock *pb)
     return priv->ldbm_back_wire_import_fn(pb);
 }
 
+/********** parallel LDIF scanning **********/
+
+/*
+ * Reading the LDIF file record by record in the producer thread caps the
+ * import rate on hosts with many cpus.  When the input is a regular file,
+ * it is cut into segments of LDIF_SCAN_SEGMENT_SIZE bytes that are scanned
+ * by several threads:
+ *  - a record starts at the beginning of the file or after a blank line,
+ *    and belongs to the segment where it starts.  So a scanner skips the
+ *    end of the record started in the previous segment and reads past the
+ *    end of its own segment to complete its last record.
+ *  - the prepare callback is called on each record by the scanner, to do
+ *    the parsing and normalization that does not depend on the entry ID.
+ *  - the producer gets the records back in the file order with
+ *    import_ldif_scan_next(), so the IDs are still assigned in the LDIF
+ *    order.
+ * At most LDIF_SCAN_WINDOW segments per scanner are held in memory.
+ */
+
+#define LDIF_SCAN_SEGMENT_SIZE (4 * 1024 * 1024)
+#define LDIF_SCAN_READ_SIZE (64 * 1024)
+#define LDIF_SCAN_WINDOW 2      /* segments per scanner thread */
+#define LDIF_SCAN_MAX_THREADS 8
+
+typedef enum {
+    LDIF_SEG_FREE,
+    LDIF_SEG_SCANNING,
+    LDIF_SEG_READY
+} ldif_seg_state_t;
+
+typedef struct
+{
+    int64_t segno;
+    ldif_seg_state_t state;
+    ImportLdifRecord *recs;
+    size_t nrecs;
+    size_t maxrecs;
+    int nblines; /* lines up to the first record of the next segment */
+    int err;     /* errno of a failed read */
+} ldif_segment;
+
+struct _import_ldif_scan
+{
+    ImportJob *job;
+    int fd;
+    off_t fsize;
+    int64_t nbsegs;
+    int64_t next_seg; /* next segment to scan */
+    int64_t cur_seg;  /* segment read by the producer */
+    size_t cur_rec;   /* next record of cur_seg */
+    int lineno;       /* lines before the first record of cur_seg */
+    int stop;
+    int nbslots;
+    ldif_segment *slots; /* segment n is in slot n % nbslots */
+    int nbthreads;
+    PRThread **threads;
+    import_ldif_prepare_fn prepare;
+    import_ldif_release_fn release;
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;
+};
+
+typedef struct
+{
+    char *b;
+    off_t off;   /* file offset of b[0] */
+    size_t len;  /* bytes read */
+    size_t size; /* bytes allocated */
+} ldif_scan_buf;
+
+/* Read the file until buf holds offset upto (or the end of the file) */
+static int
+ldif_scan_fill(ImportLdifScan *scan, ldif_scan_buf *buf, off_t upto)
+{
+    if (upto > scan->fsize) {
+        upto = scan->fsize;
+    }
+    while (buf->off + (off_t)buf->len < upto) {
+        size_t want = upto - buf->off;
+        ssize_t rc;
+
+        if (want > buf->size) {
+            buf->size = want;
+            buf->b = slapi_ch_realloc(buf->b, buf->size);
+        }
+        rc = pread(scan->fd, buf->b + buf->len, buf->size - buf->len, buf->off + buf->len);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (rc == 0) {
+            /* the file was truncated */
+            scan->fsize = buf->off + buf->len;
+            break;
+        }
+        buf->len += rc;
+    }
+    return 0;
+}
+
+/* A record starts after "\n\n" or "\n\r\n" */
+static int
+ldif_scan_is_record_start(ldif_scan_buf *buf, off_t pos)
+{
+    const char *c = buf->b + (pos - buf->off);
+
+    if (pos == 0) {
+        return 1;
+    }
+    if (pos < 2 || c[-1] != '\n') {
+        return 0;
+    }
+    return (c[-2] == '\n') || (pos >= 3 && c[-2] == '\r' && c[-3] == '\n');
+}
+
+/* Returns the start of the first record after pos, or the end of the file */
+static off_t
+ldif_scan_next_record(ImportLdifScan *scan, ldif_scan_buf *buf, off_t pos, int *err)
+{
+    for (;;) {
+        off_t end = buf->off + buf->len;
+        char *nl;
+
+        if (pos >= end) {
+            *err = ldif_scan_fill(scan, buf, pos + LDIF_SCAN_READ_SIZE);
+            end = buf->off + buf->len;
+            if (*err || pos >= end) {
+                return end;
+            }
+        }
+        nl = memchr(buf->b + (pos - buf->off), '\n', end - pos);
+        if (nl == NULL) {
+            pos = end;
+            continue;
+        }
+        pos = buf->off + (nl - buf->b) + 1;
+        if (ldif_scan_is_record_start(buf, pos)) {
+            return pos;
+        }
+    }
+}
+
+static ImportLdifRecord *
+ldif_segment_add_record(ldif_segment *seg)
+{
+    if (seg->nrecs == seg->maxrecs) {
+        seg->maxrecs = seg->maxrecs ? seg->maxrecs * 2 : 1024;
+        seg->recs = (ImportLdifRecord *)slapi_ch_realloc((char *)seg->recs,
+                                                         seg->maxrecs * sizeof(ImportLdifRecord));
+    }
+    memset(&seg->recs[seg->nrecs], 0, sizeof(ImportLdifRecord));
+    return &seg->recs[seg->nrecs++];
+}
+
+static void
+ldif_scan_segment(ImportLdifScan *scan, ldif_segment *seg)
+{
+    off_t start = seg->segno * LDIF_SCAN_SEGMENT_SIZE;
+    off_t end = start + LDIF_SCAN_SEGMENT_SIZE;
+    ldif_scan_buf buf = {0};
+    int lines = 0;
+    off_t pos;
+
+    /* keep the 3 previous bytes to find out if a record starts at start */
+    buf.off = (start < 3) ? 0 : start - 3;
+    seg->err = ldif_scan_fill(scan, &buf, end + LDIF_SCAN_READ_SIZE);
+    pos = start;
+    if (!seg->err && pos < scan->fsize && !ldif_scan_is_record_start(&buf, pos)) {
+        pos = ldif_scan_next_record(scan, &buf, pos, &seg->err);
+    }
+    while (!seg->err && pos < end && pos < scan->fsize && !(scan->job->flags & FLAG_ABORT)) {
+        off_t next = ldif_scan_next_record(scan, &buf, pos, &seg->err);
+        const char *b = buf.b + (pos - buf.off);
+        size_t len = next - pos;
+        size_t i = 0;
+
+        if (seg->err) {
+            break;
+        }
+        /* skip blank lines at start of entry */
+        for (; i < len && (b[i] == '\r' || b[i] == '\n' || b[i] == ' ' || b[i] == '\t'); i++) {
+            if (b[i] == '\n') {
+                lines++;
+            }
+        }
+        if (i < len) {
+            ImportLdifRecord *rec = ldif_segment_add_record(seg);
+
+            rec->datalen = len - i;
+            rec->data = slapi_ch_malloc(rec->datalen + 1);
+            memcpy(rec->data, b + i, rec->datalen);
+            rec->data[rec->datalen] = '\0';
+            rec->lineno = lines + 1;
+            for (const char *p = rec->data; (p = strchr(p, '\n')); p++) {
+                rec->nblines++;
+            }
+            rec->first = (pos == 0);
+            lines += rec->nblines;
+            if (scan->prepare) {
+                scan->prepare(scan->job, rec);
+            }
+        }
+        pos = next;
+    }
+    seg->nblines = lines;
+    slapi_ch_free((void **)&buf.b);
+}
+
+static void
+ldif_scan_thread(void *arg)
+{
+    ImportLdifScan *scan = (ImportLdifScan *)arg;
+
+    for (;;) {
+        ldif_segment *seg = NULL;
+
+        pthread_mutex_lock(&scan->mutex);
+        /* wait until the producer has consumed the previous user of the slot */
+        while (!scan->stop && scan->next_seg < scan->nbsegs &&
+               scan->slots[scan->next_seg % scan->nbslots].state != LDIF_SEG_FREE) {
+            pthread_cond_wait(&scan->cv, &scan->mutex);
+        }
+        if (scan->stop || scan->next_seg >= scan->nbsegs) {
+            pthread_mutex_unlock(&scan->mutex);
+            break;
+        }
+        seg = &scan->slots[scan->next_seg % scan->nbslots];
+        seg->segno = scan->next_seg++;
+        seg->state = LDIF_SEG_SCANNING;
+        seg->nrecs = 0;
+        seg->nblines = 0;
+        seg->err = 0;
+        pthread_mutex_unlock(&scan->mutex);
+
+        ldif_scan_segment(scan, seg);
+
+        pthread_mutex_lock(&scan->mutex);
+        seg->state = LDIF_SEG_READY;
+        pthread_cond_broadcast(&scan->cv);
+        pthread_mutex_unlock(&scan->mutex);
+    }
+}
+
+/*
+ * Start the scanner threads on fd.  Returns NULL if the input is not worth
+ * scanning in parallel (not a regular file, small file or few cpus): the
+ * caller then reads the file sequentially.
+ */
+ImportLdifScan *
+import_ldif_scan_start(ImportJob *job, int fd, import_ldif_prepare_fn prepare, import_ldif_release_fn release)
+{
+    int nbthreads = util_get_capped_hardware_threads(0, 0x7fffffff) / 4;
+    ImportLdifScan *scan = NULL;
+    struct stat st = {0};
+
+    if (nbthreads > LDIF_SCAN_MAX_THREADS) {
+        nbthreads = LDIF_SCAN_MAX_THREADS;
+    }
+    if (nbthreads < 2 || fstat(fd, &st) || !S_ISREG(st.st_mode) ||
+        st.st_size < 2 * LDIF_SCAN_SEGMENT_SIZE) {
+        return NULL;
+    }
+
+    scan = CALLOC(ImportLdifScan);
+    scan->job = job;
+    scan->fd = fd;
+    scan->fsize = st.st_size;
+    scan->nbsegs = (st.st_size + LDIF_SCAN_SEGMENT_SIZE - 1) / LDIF_SCAN_SEGMENT_SIZE;
+    scan->nbslots = nbthreads * LDIF_SCAN_WINDOW;
+    scan->slots = (ldif_segment *)slapi_ch_calloc(scan->nbslots, sizeof(ldif_segment));
+    scan->threads = (PRThread **)slapi_ch_calloc(nbthreads, sizeof(PRThread *));
+    scan->prepare = prepare;
+    scan->release = release;
+    pthread_mutex_init(&scan->mutex, NULL);
+    pthread_cond_init(&scan->cv, NULL);
+
+    for (int i = 0; i < nbthreads; i++) {
+        scan->threads[i] = PR_CreateThread(PR_USER_THREAD, ldif_scan_thread, scan,
+                                           PR_PRIORITY_NORMAL, PR_GLOBAL_BOUND_THREAD,
+                                           PR_JOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (scan->threads[i] == NULL) {
+            PRErrorCode prerr = PR_GetError();
+            slapi_log_err(SLAPI_LOG_ERR, "import_ldif_scan_start",
+                          "Unable to spawn LDIF scanner thread, " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                          prerr, slapd_pr_strerror(prerr));
+            break;
+        }
+        scan->nbthreads++;
+    }
+    if (scan->nbthreads == 0) {
+        import_ldif_scan_stop(&scan);
+        return NULL;
+    }
+    import_log_notice(job, SLAPI_LOG_INFO, "import_ldif_scan_start",
+                      "Scanning the LDIF file with %d threads", scan->nbthreads);
+    return scan;
+}
+
+/*
+ * Get the next record of the file.  Returns 1 if rec is set, 0 at the end
+ * of the file and -1 (with errno set) if the file could not be read.
+ */
+int
+import_ldif_scan_next(ImportLdifScan *scan, ImportLdifRecord *rec)
+{
+    int rc = 0;
+
+    pthread_mutex_lock(&scan->mutex);
+    while (scan->cur_seg < scan->nbsegs) {
+        ldif_segment *seg = &scan->slots[scan->cur_seg % scan->nbslots];
+
+        while (seg->state != LDIF_SEG_READY) {
+            pthread_cond_wait(&scan->cv, &scan->mutex);
+        }
+        if (seg->err) {
+            errno = seg->err;
+            rc = -1;
+            break;
+        }
+        if (scan->cur_rec < seg->nrecs) {
+            *rec = seg->recs[scan->cur_rec];
+            memset(&seg->recs[scan->cur_rec], 0, sizeof(ImportLdifRecord));
+            rec->lineno += scan->lineno;
+            scan->cur_rec++;
+            rc = 1;
+            break;
+        }
+        /* The segment is consumed, let a scanner reuse its slot */
+        scan->lineno += seg->nblines;
+        seg->nrecs = 0;
+        seg->state = LDIF_SEG_FREE;
+        scan->cur_seg++;
+        scan->cur_rec = 0;
+        pthread_cond_broadcast(&scan->cv);
+    }
+    pthread_mutex_unlock(&scan->mutex);
+    return rc;
+}
+
+/* Stop the scanner threads and free the records that were not consumed */
+void
+import_ldif_scan_stop(ImportLdifScan **pscan)
+{
+    ImportLdifScan *scan = *pscan;
+
+    if (scan == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&scan->mutex);
+    scan->stop = 1;
+    pthread_cond_broadcast(&scan->cv);
+    pthread_mutex_unlock(&scan->mutex);
+    for (int i = 0; i < scan->nbthreads; i++) {
+        PR_JoinThread(scan->threads[i]);
+    }
+
+    for (int i = 0; i < scan->nbslots; i++) {
+        ldif_segment *seg = &scan->slots[i];
+
+        for (size_t r = 0; r < seg->nrecs; r++) {
+            if (seg->recs[r].prepared && scan->release) {
+                scan->release(&seg->recs[r]);
+            }
+            slapi_ch_free_string(&seg->recs[r].data);
+        }
+        slapi_ch_free((void **)&seg->recs);
+    }
+    pthread_mutex_destroy(&scan->mutex);
+    pthread_cond_destroy(&scan->cv);
+    slapi_ch_free((void **)&scan->slots);
+    slapi_ch_free((void **)&scan->threads);
+    slapi_ch_free((void **)pscan);
+}
+
 /* Threads management */
 
 /* tell all the threads to abort */
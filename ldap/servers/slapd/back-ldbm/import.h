@@ -205,9 +205,30 @@ struct _import_worker_info
 #define FREE(x) slapi_ch_free((void **)&(x))
 
 
+/* A record of the LDIF file, as returned by import_ldif_scan_next() */
+typedef struct
+{
+    char *data;     /* the record string (caller frees it) */
+    size_t datalen; /* length of data */
+    int lineno;     /* line number of the first line of the record */
+    int nblines;    /* number of lines of the record */
+    int first;      /* first record of the file */
+    void *prepared; /* set by the prepare callback (caller frees it) */
+} ImportLdifRecord;
+
+typedef struct _import_ldif_scan ImportLdifScan;
+
+/* Called by the scanner threads on each record */
+typedef void (*import_ldif_prepare_fn)(ImportJob *job, ImportLdifRecord *rec);
+/* Frees rec->prepared of the records that were not consumed */
+typedef void (*import_ldif_release_fn)(ImportLdifRecord *rec);
+
 /* import.c */
 void import_log_notice(ImportJob *job, int log_level, char *subsystem, char *format, ...);
 int import_main_offline(void *arg);
+ImportLdifScan *import_ldif_scan_start(ImportJob *job, int fd, import_ldif_prepare_fn prepare, import_ldif_release_fn release);
+int import_ldif_scan_next(ImportLdifScan *scan, ImportLdifRecord *rec);
+void import_ldif_scan_stop(ImportLdifScan **scan);
 
 /* ldif2ldbm.c */
 void reset_progress(void);
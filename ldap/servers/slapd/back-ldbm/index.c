@@ -17,6 +17,10 @@
 #include <assert.h>
 #include "back-ldbm.h"
 
+#ifdef SYSTEMTAP
+#include <sys/sdt.h>
+#endif
+
 static const char *errmsg = "database index operation failed";
 #define NASTY_MSG(n) ((char*)(#n " - database index operation failed"))
 
@@ -34,11 +38,13 @@ const char *indextype_PRESENCE = "pres";
 const char *indextype_EQUALITY = "eq";
 const char *indextype_APPROX = "approx";
 const char *indextype_SUB = "sub";
+const char *indextype_SUBPOS = "subpos";
 
 static char prefix_PRESENCE[2] = {PRES_PREFIX, 0};
 static char prefix_EQUALITY[2] = {EQ_PREFIX, 0};
 static char prefix_APPROX[2] = {APPROX_PREFIX, 0};
 static char prefix_SUB[2] = {SUB_PREFIX, 0};
+static char prefix_SUBPOS[2] = {SUBPOS_PREFIX, 0};
 
 /* Yes, prefix_PRESENCE and prefix_SUB are identical.
  * It works because SUB is always followed by a key value,
@@ -1068,6 +1074,9 @@ index_read_ext_allids(
     if (NULL != txn) {
         db_txn = txn->back_txn_txn;
     }
+#ifdef SYSTEMTAP
+    STAP_PROBE2(ns-slapd, index_read__entry, basetype, indextype);
+#endif
     for (retry_count = 0; retry_count < IDL_FETCH_RETRY_COUNT; retry_count++) {
         *err = NEW_IDL_DEFAULT;
         PRIntervalTime interval;
@@ -1097,6 +1106,9 @@ index_read_ext_allids(
     } else if (*err != 0 && *err != DBI_RC_NOTFOUND) {
         ldbm_nasty("index_read_ext_allids", errmsg, 1050, *err);
     }
+#ifdef SYSTEMTAP
+    STAP_PROBE2(ns-slapd, index_read__return, *err, IDL_NIDS(idl));
+#endif
     slapi_ch_free_string(&basetmp);
     dblayer_value_free(be, &key);
 
@@ -1116,6 +1128,110 @@ index_read_ext_allids(
     return (idl);
 }
 
+/*
+ * Estimate how many ids index_read_ext_allids would return for the same
+ * arguments, without reading the id list.  *estimate is set to
+ * IDL_ESTIMATE_ALLIDS when the attribute is not indexed for indextype or
+ * when the key is over the allids limit, and to IDL_ESTIMATE_UNKNOWN when
+ * the index format cannot tell.  Used by the search filter optimizer.
+ */
+int
+index_estimate(
+    Slapi_PBlock *pb,
+    backend *be,
+    char *type,
+    const char *indextype,
+    const struct berval *val,
+    back_txn *txn,
+    int allidslimit,
+    uint64_t *estimate)
+{
+    dbi_db_t *db = NULL;
+    dbi_val_t key = {0};
+    char *prefix;
+    char buf[BUFSIZ];
+    char typebuf[SLAPD_TYPICAL_ATTRIBUTE_NAME_MAX_LENGTH];
+    struct attrinfo *ai = NULL;
+    char *basetmp, *basetype;
+    struct berval *encrypted_val = NULL;
+    struct berval *hashed_val = NULL;
+    struct ldbminfo *li = (struct ldbminfo *)be->be_database->plg_private;
+    int is_and = 0;
+    int err = 0;
+
+    *estimate = IDL_ESTIMATE_ALLIDS;
+    if ((prefix = index_index2prefix(indextype)) == NULL) {
+        return -1;
+    }
+    basetype = typebuf;
+    if ((basetmp = slapi_attr_basetype(type, typebuf, sizeof(typebuf))) != NULL) {
+        basetype = basetmp;
+    }
+    ainfo_get(be, basetype, &ai);
+    if (ai == NULL) {
+        goto done;
+    }
+    if (entryrdn_get_switch() && (*prefix == '=') &&
+        (0 == PL_strcasecmp(basetype, LDBM_ENTRYDN_STR))) {
+        /* resolved through entryrdn, at most one entry */
+        *estimate = 1;
+        goto done;
+    }
+    if (!is_indexed(indextype, ai->ai_indexmask, ai->ai_index_rules)) {
+        goto done;
+    }
+    if (pb) {
+        slapi_pblock_get(pb, SLAPI_SEARCH_IS_AND, &is_and);
+    }
+    if (index_get_allids(&allidslimit, indextype, ai, val, is_and ? INDEX_ALLIDS_FLAG_AND : 0) &&
+        (allidslimit == 0)) {
+        /* the index must not be used */
+        goto done;
+    }
+    if ((err = dblayer_get_index_file(be, ai, &db, DBOPEN_CREATE)) != 0) {
+        goto done;
+    }
+
+    if (val != NULL) {
+        if (val->bv_len >= li->li_max_key_len) {
+            if (attrcrypt_hash_large_index_key(be, &prefix, ai, val, &hashed_val)) {
+                err = DBI_RC_OTHER;
+                goto release;
+            }
+            if (hashed_val) {
+                val = hashed_val;
+            }
+        }
+        attrcrypt_encrypt_index_key(be, ai, val, &encrypted_val);
+        if (encrypted_val) {
+            val = encrypted_val;
+        }
+        dblayer_value_concat(be, &key, buf, sizeof(buf),
+            prefix, strlen(prefix), val->bv_val, val->bv_len, "", 1);
+    } else {
+        dblayer_value_concat(be, &key, buf, sizeof(buf), prefix, strlen(prefix),
+            "", 1, NULL, 0);
+    }
+    err = idl_estimate(be, db, &key, txn ? txn->back_txn_txn : NULL, ai, allidslimit, estimate);
+    if (err) {
+        *estimate = IDL_ESTIMATE_UNKNOWN;
+    }
+    dblayer_value_free(be, &key);
+
+release:
+    dblayer_release_index_file(be, ai, db);
+done:
+    slapi_ch_free_string(&basetmp);
+    index_free_prefix(prefix);
+    if (hashed_val) {
+        ber_bvfree(hashed_val);
+    }
+    if (encrypted_val) {
+        ber_bvfree(encrypted_val);
+    }
+    return err;
+}
+
 IDList *
 index_read_ext(
     backend *be,
@@ -2032,10 +2148,8 @@ index_addordel_values_ext_sv(
     int *idl_disposition,
     void *buffer_handle)
 {
-    dbi_db_t *db = NULL;
     struct attrinfo *ai = NULL;
-    int err = -1;
-    Slapi_Value **ivals;
+    int err = 0;
     char buf[SLAPD_TYPICAL_ATTRIBUTE_NAME_MAX_LENGTH];
     char *basetmp, *basetype;
 
@@ -2048,17 +2162,55 @@ index_addordel_values_ext_sv(
     }
 
     ainfo_get(be, basetype, &ai);
-    if (ai == NULL || ai->ai_indexmask == 0 || ai->ai_indexmask == INDEX_OFFLINE) {
+    if (ai == NULL) {
         slapi_ch_free_string(&basetmp);
         return (0);
     }
+    /*
+     * The index is being rebuilt online: the entries that the rebuild has
+     * already read must also be updated in the new index.  ai_shadow and
+     * ai_shadow_next_id only change while the rebuild holds the write txn,
+     * so they are stable while we hold ours.
+     */
+    if (ai->ai_shadow && id < ai->ai_shadow_next_id) {
+        err = index_addordel_ainfo_values_sv(be, ai->ai_shadow, basetype, vals, evals,
+                                             id, flags, txn, NULL, NULL);
+    }
+    if (err == 0 && ai->ai_indexmask != 0 && ai->ai_indexmask != INDEX_OFFLINE) {
+        err = index_addordel_ainfo_values_sv(be, ai, basetype, vals, evals,
+                                             id, flags, txn, idl_disposition, buffer_handle);
+    }
+    slapi_ch_free_string(&basetmp);
+    return err;
+}
+
+/*
+ * Update the keys of the given index (which may not be the one returned
+ * by ainfo_get, e.g. during an online reindex) for the values of an entry.
+ */
+int
+index_addordel_ainfo_values_sv(
+    backend *be,
+    struct attrinfo *ai,
+    const char *basetype,
+    Slapi_Value **vals,
+    Slapi_Value **evals,
+    ID id,
+    int flags,
+    back_txn *txn,
+    int *idl_disposition,
+    void *buffer_handle)
+{
+    dbi_db_t *db = NULL;
+    int err = -1;
+    Slapi_Value **ivals;
+
     slapi_log_err(SLAPI_LOG_ARGS, "index_addordel_values_ext_sv", "indexmask 0x%x\n",
                   ai->ai_indexmask);
     if ((err = dblayer_get_index_file(be, ai, &db, DBOPEN_CREATE)) != 0) {
         slapi_log_err(SLAPI_LOG_ERR,
                       "index_addordel_values_ext_sv", "index_read NULL (could not open index attr %s)\n",
                       basetype);
-        slapi_ch_free_string(&basetmp);
         if (err != 0) {
             ldbm_nasty("index_addordel_values_ext_sv", errmsg, 1210, err);
         }
@@ -2161,6 +2313,37 @@ index_addordel_values_ext_sv(
         }
     }
 
+    /*
+     * positional substrings index entry
+     */
+    if (ai->ai_indexmask & INDEX_SUBPOS) {
+        Slapi_Value **esubvals = NULL;
+        Slapi_Value **origvals = NULL;
+
+        index_subpos_values2keys(&ai->ai_sattr, vals, &ivals);
+        origvals = ivals;
+        /* delete only: keep the grams still produced by the remaining values */
+        if (evals != NULL && ivals != NULL) {
+            index_subpos_values2keys(&ai->ai_sattr, evals, &esubvals);
+            ivals = valuearray_minus_valuearray(&ai->ai_sattr, ivals, esubvals);
+            valuearray_free(&esubvals);
+        }
+        if (ivals != NULL) {
+            err = addordel_values_sv(be, db, basetype, indextype_SUBPOS,
+                                     ivals, id, flags, txn, ai, idl_disposition, NULL);
+            if (ivals != origvals) {
+                valuearray_free(&origvals);
+            }
+            valuearray_free(&ivals);
+            if (err != 0) {
+                ldbm_nasty("index_addordel_values_ext_sv", errmsg, 1255, err);
+                goto bad;
+            }
+        } else {
+            valuearray_free(&origvals);
+        }
+    }
+
     /*
      * matching rule index entries
      */
@@ -2197,9 +2380,6 @@ index_addordel_values_ext_sv(
     }
 
     dblayer_release_index_file(be, ai, db);
-    if (basetmp != NULL) {
-        slapi_ch_free((void **)&basetmp);
-    }
 
     slapi_log_err(SLAPI_LOG_TRACE, "index_addordel_values_ext_sv", "<=\n");
     return (0);
@@ -2231,6 +2411,8 @@ is_indexed(const char *indextype, int indexmask, char **index_rules)
         indexed = INDEX_APPROX & indexmask;
     else if (indextype == indextype_SUB)
         indexed = INDEX_SUB & indexmask;
+    else if (indextype == indextype_SUBPOS)
+        indexed = (INDEX_SUBPOS & indexmask) && !(INDEX_SUBPOS_OFFLINE & indexmask);
     else { /* matching rule */
         indexed = 0;
         if (INDEX_RULES & indexmask) {
@@ -2265,6 +2447,8 @@ index_index2prefix(const char *indextype)
         prefix = prefix_APPROX;
     else if (indextype == indextype_SUB)
         prefix = prefix_SUB;
+    else if (indextype == indextype_SUBPOS)
+        prefix = prefix_SUBPOS;
     else { /* indextype is a matching rule name */
         const size_t len = strlen(indextype);
         char *p = slapi_ch_malloc(len + 3);
@@ -2284,7 +2468,8 @@ index_free_prefix(char *prefix)
         prefix == prefix_PRESENCE ||
         prefix == prefix_EQUALITY ||
         prefix == prefix_APPROX ||
-        prefix == prefix_SUB) {
+        prefix == prefix_SUB ||
+        prefix == prefix_SUBPOS) {
         /* do nothing */
     } else {
         slapi_ch_free_string(&prefix);
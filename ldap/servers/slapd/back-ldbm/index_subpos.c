@@ -0,0 +1,307 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* index_subpos.c - positional n-gram substring index (nsIndexType: subpos) */
+
+/*
+ * The "sub" index stores every n-gram of a value as a key and the server
+ * intersects the id lists of the grams of the assertion.  That only proves
+ * that an entry contains each gram somewhere: for common grams the lists are
+ * huge (or allids) and most of the candidates fail the filter test.
+ *
+ * The "subpos" index also records where a gram was found.  The key of a gram
+ * is the gram followed by its offset in the value modulo SUBPOS_SLOTS:
+ *
+ *     "^smith$"  ->  %^sm0 %smi1 %mit2 %ith3 %th$4
+ *
+ * Splitting a gram across SUBPOS_SLOTS keys makes each id list smaller, and
+ * an assertion value only matches the grams found at consecutive offsets:
+ * for "*mith*" the offset of "mit" is unknown, so each of the SUBPOS_SLOTS
+ * possible offsets s is tried, intersecting %mit<s> with %ith<s+1>, and the
+ * results are unioned.  An initial substring is anchored at offset 0, so a
+ * single intersection is enough.  Only the grams needed to cover the
+ * assertion value are read.
+ *
+ * The candidates are still a superset (offsets modulo SUBPOS_SLOTS, grams
+ * coming from different values of a multi-valued attribute), the filter test
+ * is always applied to substring filters.
+ */
+
+#include "back-ldbm.h"
+
+#define SUBPOS_GRAM  3 /* length of a gram, in bytes */
+#define SUBPOS_SLOTS 8 /* offsets are recorded modulo SUBPOS_SLOTS */
+#define SUBPOS_KEYLEN (SUBPOS_GRAM + 1)
+
+/*
+ * Normalize a value the way the substring keys of the syntax are built:
+ * stored values trim their leading blanks, assertion values do not.
+ */
+static char *
+subpos_normalize(Slapi_Attr *sattr, const char *s, unsigned long flags, int trim)
+{
+    char *norm = slapi_ch_strdup(s);
+    char *alt = NULL;
+
+    if (!(flags & SLAPI_ATTR_FLAG_NORMALIZED)) {
+        slapi_attr_value_normalize_ext(NULL, sattr, NULL, norm, trim, &alt, LDAP_FILTER_SUBSTRINGS);
+        if (alt) {
+            slapi_ch_free_string(&norm);
+            norm = alt;
+        }
+    } else if (flags & SLAPI_ATTR_FLAG_NORMALIZED_CES) {
+        /* normalized, but not case-normalized dn */
+        slapi_dn_ignore_case(norm);
+    }
+    return norm;
+}
+
+static void
+subpos_make_key(char key[SUBPOS_KEYLEN + 1], const char *gram, size_t offset)
+{
+    memcpy(key, gram, SUBPOS_GRAM);
+    key[SUBPOS_GRAM] = '0' + (offset % SUBPOS_SLOTS);
+    key[SUBPOS_KEYLEN] = '\0';
+}
+
+static int
+subpos_key_cmp(const void *a, const void *b)
+{
+    const Slapi_Value *va = *(const Slapi_Value **)a;
+    const Slapi_Value *vb = *(const Slapi_Value **)b;
+
+    return memcmp(slapi_value_get_string(va), slapi_value_get_string(vb), SUBPOS_KEYLEN);
+}
+
+/*
+ * Build the positional gram keys of vals.  *ivals is set to NULL when
+ * there is none.
+ */
+void
+index_subpos_values2keys(Slapi_Attr *sattr, Slapi_Value **vals, Slapi_Value ***ivals)
+{
+    Slapi_Value **keys = NULL;
+    size_t nkeys = 0;
+    size_t maxkeys = 0;
+
+    *ivals = NULL;
+    for (size_t v = 0; vals && vals[v]; v++) {
+        char *norm = subpos_normalize(sattr, slapi_value_get_string(vals[v]),
+                                      slapi_value_get_flags(vals[v]), 1);
+        size_t len = strlen(norm);
+        char *ext;
+
+        if (len == 0) {
+            slapi_ch_free_string(&norm);
+            continue;
+        }
+        /* anchor the value, as the "sub" keys do */
+        ext = slapi_ch_malloc(len + 3);
+        ext[0] = '^';
+        memcpy(ext + 1, norm, len);
+        ext[len + 1] = '$';
+        ext[len + 2] = '\0';
+        len += 2;
+        slapi_ch_free_string(&norm);
+
+        if (nkeys + len > maxkeys) {
+            maxkeys = (nkeys + len) * 2;
+            keys = (Slapi_Value **)slapi_ch_realloc((char *)keys, (maxkeys + 1) * sizeof(Slapi_Value *));
+        }
+        for (size_t i = 0; i + SUBPOS_GRAM <= len; i++) {
+            char key[SUBPOS_KEYLEN + 1];
+
+            subpos_make_key(key, ext + i, i);
+            keys[nkeys] = slapi_value_new_string(key);
+            slapi_value_set_flags(keys[nkeys], SLAPI_ATTR_FLAG_NORMALIZED);
+            nkeys++;
+        }
+        slapi_ch_free_string(&ext);
+    }
+    if (nkeys == 0) {
+        slapi_ch_free((void **)&keys);
+        return;
+    }
+
+    /* the same gram can appear twice at the same offset, keep one */
+    qsort(keys, nkeys, sizeof(Slapi_Value *), subpos_key_cmp);
+    size_t n = 1;
+    for (size_t i = 1; i < nkeys; i++) {
+        if (subpos_key_cmp(&keys[n - 1], &keys[i]) == 0) {
+            slapi_value_free(&keys[i]);
+        } else {
+            keys[n++] = keys[i];
+        }
+    }
+    keys[n] = NULL;
+    *ivals = keys;
+}
+
+static IDList *
+subpos_read_key(Slapi_PBlock *pb, backend *be, char *type, const char *gram, size_t offset, back_txn *txn, int *err, int allidslimit)
+{
+    char key[SUBPOS_KEYLEN + 1];
+    struct berval bv;
+    int unindexed = 0;
+    IDList *idl;
+
+    subpos_make_key(key, gram, offset);
+    bv.bv_val = key;
+    bv.bv_len = SUBPOS_KEYLEN;
+    idl = index_read_ext_allids(pb, be, type, indextype_SUBPOS, &bv, txn, err, &unindexed, allidslimit);
+    if (idl == NULL) {
+        idl = idl_alloc(0);
+    }
+    return idl;
+}
+
+/*
+ * Candidates of one component of the assertion.  ext is the normalized
+ * component, with its anchors.  Returns NULL when the component is too short
+ * to be looked up.
+ */
+static IDList *
+subpos_component_candidates(Slapi_PBlock *pb, backend *be, char *type, const char *ext, int anchored, back_txn *txn, int *err, int allidslimit)
+{
+    size_t len = strlen(ext);
+    size_t nshifts = anchored ? 1 : SUBPOS_SLOTS;
+    size_t *grams;
+    size_t ngrams = 0;
+    IDList *idl = NULL;
+
+    if (len < SUBPOS_GRAM) {
+        return NULL;
+    }
+
+    /* Non overlapping grams, plus the last one, cover the whole component */
+    grams = (size_t *)slapi_ch_malloc((len / SUBPOS_GRAM + 1) * sizeof(size_t));
+    for (size_t i = 0; i + SUBPOS_GRAM < len; i += SUBPOS_GRAM) {
+        grams[ngrams++] = i;
+    }
+    grams[ngrams++] = len - SUBPOS_GRAM;
+
+    /* An initial component starts at offset 0, the others can start anywhere */
+    for (size_t s = 0; s < nshifts; s++) {
+        IDList *shift = NULL;
+
+        for (size_t g = 0; g < ngrams; g++) {
+            IDList *idl2 = subpos_read_key(pb, be, type, ext + grams[g], s + grams[g], txn, err, allidslimit);
+
+            if (*err) {
+                idl_free(&idl2);
+                idl_free(&shift);
+                idl_free(&idl);
+                slapi_ch_free((void **)&grams);
+                return NULL;
+            }
+            if (shift == NULL) {
+                shift = idl2;
+            } else {
+                IDList *tmp = shift;
+                shift = idl_intersection(be, shift, idl2);
+                idl_free(&tmp);
+                idl_free(&idl2);
+            }
+            if (!ALLIDS(shift) && IDL_NIDS(shift) == 0) {
+                /* the grams are not found at these offsets */
+                break;
+            }
+        }
+        if (idl == NULL) {
+            idl = shift;
+        } else {
+            IDList *tmp = idl;
+            idl = idl_union(be, idl, shift);
+            idl_free(&tmp);
+            idl_free(&shift);
+        }
+        if (ALLIDS(idl)) {
+            break;
+        }
+    }
+    slapi_ch_free((void **)&grams);
+    return idl;
+}
+
+/*
+ * Candidates of a substring assertion from the positional index.  Returns
+ * NULL when no component of the assertion is long enough to be looked up:
+ * the caller then uses the "sub" index, if any.
+ */
+IDList *
+index_subpos_candidates(Slapi_PBlock *pb, backend *be, char *type, char *initial, char **any, char *final, int *err, int allidslimit)
+{
+    struct attrinfo *ai = NULL;
+    back_txn txn = {NULL};
+    IDList *idl = NULL;
+    size_t ncomp = 0;
+    char **comps;
+    int *anchors;
+
+    ainfo_get(be, type, &ai);
+    if (ai == NULL || !(ai->ai_indexmask & INDEX_SUBPOS) || (ai->ai_indexmask & (INDEX_OFFLINE | INDEX_SUBPOS_OFFLINE))) {
+        return NULL;
+    }
+    slapi_pblock_get(pb, SLAPI_TXN, &txn.back_txn_txn);
+
+    for (size_t i = 0; any && any[i]; i++) {
+        ncomp++;
+    }
+    comps = (char **)slapi_ch_calloc(ncomp + 2, sizeof(char *));
+    anchors = (int *)slapi_ch_calloc(ncomp + 2, sizeof(int));
+    ncomp = 0;
+    if (initial) {
+        char *norm = subpos_normalize(&ai->ai_sattr, initial, 0, 0);
+        comps[ncomp] = slapi_ch_smprintf("^%s", norm);
+        anchors[ncomp++] = 1;
+        slapi_ch_free_string(&norm);
+    }
+    for (size_t i = 0; any && any[i]; i++) {
+        comps[ncomp++] = subpos_normalize(&ai->ai_sattr, any[i], 0, 0);
+    }
+    if (final) {
+        char *norm = subpos_normalize(&ai->ai_sattr, final, 0, 0);
+        comps[ncomp++] = slapi_ch_smprintf("%s$", norm);
+        slapi_ch_free_string(&norm);
+    }
+
+    for (size_t i = 0; i < ncomp; i++) {
+        IDList *idl2 = subpos_component_candidates(pb, be, type, comps[i], anchors[i], &txn, err, allidslimit);
+
+        if (*err) {
+            idl_free(&idl);
+            break;
+        }
+        if (idl2 == NULL) {
+            /* too short to be looked up */
+            continue;
+        }
+        if (idl == NULL) {
+            idl = idl2;
+        } else {
+            IDList *tmp = idl;
+            idl = idl_intersection(be, idl, idl2);
+            idl_free(&tmp);
+            idl_free(&idl2);
+        }
+        if (!ALLIDS(idl) && IDL_NIDS(idl) == 0) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < ncomp; i++) {
+        slapi_ch_free_string(&comps[i]);
+    }
+    slapi_ch_free((void **)&comps);
+    slapi_ch_free((void **)&anchors);
+    return idl;
+}
@@ -93,6 +93,8 @@ ldbm_back_init(Slapi_PBlock *pb)
                            (void *)ldbm_back_prev_search_results);
     rc |= slapi_pblock_set(pb, SLAPI_PLUGIN_DB_SEARCH_RESULTS_RELEASE_FN,
                            (void *)ldbm_back_search_results_release);
+    rc |= slapi_pblock_set(pb, SLAPI_PLUGIN_DB_SEARCH_RESULTS_PACK_FN,
+                           (void *)ldbm_back_search_results_pack);
     rc |= slapi_pblock_set(pb, SLAPI_PLUGIN_DB_COMPARE_FN,
                            (void *)ldbm_back_compare);
     rc |= slapi_pblock_set(pb, SLAPI_PLUGIN_DB_MODIFY_FN,
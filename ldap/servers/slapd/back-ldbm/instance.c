@@ -58,6 +58,9 @@ ldbm_instance_create(backend *be, char *name)
         goto error;
     }
 
+    /* in memory copy of the entryrdn index, see dntree.c */
+    inst->inst_dntree = dntree_new();
+
     /* Lock for the list of open db handles */
     inst->inst_handle_list_mutex = PR_NewLock();
     if (NULL == inst->inst_handle_list_mutex) {
@@ -313,6 +316,7 @@ ldbm_instance_startall(struct ldbminfo *li)
             ldbm_instance_register_modify_callback(inst);
             vlv_init(inst);
             slapi_mtn_be_started(inst->inst_be);
+            ldbm_cache_preload_start(inst);
         }
         if (slapi_exist_referral(inst->inst_be)) {
             slapi_be_set_flag(inst->inst_be, SLAPI_BE_FLAG_CONTAINS_REFERRAL);
@@ -400,6 +404,7 @@ ldbm_instance_destructor(void **arg)
     PR_DestroyLock(inst->inst_nextid_mutex);
     PR_DestroyCondVar(inst->inst_indexer_cv);
     attrinfo_deletetree(inst);
+    dntree_destroy(&inst->inst_dntree);
     slapi_ch_free((void **)&inst->inst_dataversion);
     /* cache has already been destroyed */
 
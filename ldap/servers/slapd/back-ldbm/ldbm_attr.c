@@ -718,6 +718,8 @@ attr_index_config(
                 dblayer_set_dup_cmp_fn(be, a, DBI_DUP_CMP_ENTRYRDN);
             } else if (strcasecmp(attrValue->bv_val, "sub") == 0) {
                 a->ai_indexmask |= INDEX_SUB;
+            } else if (strcasecmp(attrValue->bv_val, "subpos") == 0) {
+                a->ai_indexmask |= INDEX_SUBPOS;
             } else if (strcasecmp(attrValue->bv_val, "none") == 0) {
                 if (a->ai_indexmask != 0) {
                     slapi_log_err(SLAPI_LOG_WARNING,
@@ -728,11 +730,11 @@ attr_index_config(
             } else {
                 slapi_create_errormsg(err_buf, SLAPI_DSE_RETURNTEXT_SIZE,
                                       "Error: %s: line %d: unknown index type \"%s\" (ignored) in entry (%s), "
-                                      "valid index types are \"pres\", \"eq\", \"approx\", or \"sub\"\n",
+                                      "valid index types are \"pres\", \"eq\", \"approx\", \"sub\", or \"subpos\"\n",
                                       fname, lineno, attrValue->bv_val, slapi_entry_get_dn(e));
                 slapi_log_err(SLAPI_LOG_ERR, "attr_index_config",
                               "%s: line %d: unknown index type \"%s\" (ignored) in entry (%s), "
-                              "valid index types are \"pres\", \"eq\", \"approx\", or \"sub\"\n",
+                              "valid index types are \"pres\", \"eq\", \"approx\", \"sub\", or \"subpos\"\n",
                               fname, lineno, attrValue->bv_val, slapi_entry_get_dn(e));
                 attrinfo_delete(&a);
                 return -1;
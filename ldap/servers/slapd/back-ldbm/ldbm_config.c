@@ -333,6 +333,181 @@ ldbm_config_backend_opt_level_set(void *arg, void *value, char *errorbuf __attri
 
     return retval;
 }
+static void *
+ldbm_config_search_prefetch_depth_get(void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    return (void *)((uintptr_t)(li->li_search_prefetch_depth));
+}
+
+static int
+ldbm_config_search_prefetch_depth_set(void *arg,
+                                      void *value,
+                                      char *errorbuf,
+                                      int phase __attribute__((unused)),
+                                      int apply)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+    int retval = LDAP_SUCCESS;
+    int val = (int)((uintptr_t)value);
+
+    if (val < 0 || val > LDBM_SEARCH_PREFETCH_DEPTH_MAX) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "Error: Invalid value for %s (%d). Value must be between 0 and %d.",
+                              CONFIG_SEARCH_PREFETCH_DEPTH, val, LDBM_SEARCH_PREFETCH_DEPTH_MAX);
+        return LDAP_UNWILLING_TO_PERFORM;
+    }
+
+    if (apply) {
+        li->li_search_prefetch_depth = val;
+    }
+
+    return retval;
+}
+
+static void *
+ldbm_config_cache_preload_get(void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    return (void *)((uintptr_t)(li->li_cache_preload));
+}
+
+static int
+ldbm_config_cache_preload_set(void *arg,
+                              void *value,
+                              char *errorbuf __attribute__((unused)),
+                              int phase __attribute__((unused)),
+                              int apply)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+    int val = (int)((uintptr_t)value);
+
+    if (apply) {
+        li->li_cache_preload = val;
+    }
+
+    return LDAP_SUCCESS;
+}
+
+static void *
+ldbm_config_cache_preload_rate_get(void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    return (void *)((uintptr_t)(li->li_cache_preload_rate));
+}
+
+static int
+ldbm_config_cache_preload_rate_set(void *arg,
+                                   void *value,
+                                   char *errorbuf,
+                                   int phase __attribute__((unused)),
+                                   int apply)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+    int val = (int)((uintptr_t)value);
+
+    if (val < 0) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "Error: Invalid value for %s (%d). Value must be 0 (no limit) or a positive number of entries per second.",
+                              CONFIG_CACHE_PRELOAD_RATE, val);
+        return LDAP_UNWILLING_TO_PERFORM;
+    }
+
+    if (apply) {
+        li->li_cache_preload_rate = val;
+    }
+
+    return LDAP_SUCCESS;
+}
+
+static void *
+ldbm_config_cache_snapshot_interval_get(void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    return (void *)((uintptr_t)(li->li_cache_snapshot_interval));
+}
+
+static int
+ldbm_config_cache_snapshot_interval_set(void *arg,
+                                        void *value,
+                                        char *errorbuf,
+                                        int phase __attribute__((unused)),
+                                        int apply)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+    int val = (int)((uintptr_t)value);
+
+    if (val < 0) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "Error: Invalid value for %s (%d). Value must be 0 (only at shutdown) or a positive number of seconds.",
+                              CONFIG_CACHE_SNAPSHOT_INTERVAL, val);
+        return LDAP_UNWILLING_TO_PERFORM;
+    }
+
+    if (apply) {
+        li->li_cache_snapshot_interval = val;
+    }
+
+    return LDAP_SUCCESS;
+}
+
+static void *
+ldbm_config_filter_cost_optimizer_get(void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    return (void *)((uintptr_t)(li->li_filter_cost_optimizer));
+}
+
+static int
+ldbm_config_filter_cost_optimizer_set(void *arg,
+                                      void *value,
+                                      char *errorbuf __attribute__((unused)),
+                                      int phase __attribute__((unused)),
+                                      int apply)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+    int val = (int)((uintptr_t)value);
+
+    if (apply) {
+        li->li_filter_cost_optimizer = val;
+    }
+
+    return LDAP_SUCCESS;
+}
+
+static void *
+ldbm_config_export_threads_get(void *arg)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+
+    return (void *)((uintptr_t)(li->li_export_threads));
+}
+
+static int
+ldbm_config_export_threads_set(void *arg, void *value, char *errorbuf, int phase __attribute__((unused)), int apply)
+{
+    struct ldbminfo *li = (struct ldbminfo *)arg;
+    int val = (int)((uintptr_t)value);
+
+    if (val < 0) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "Error: Invalid value for %s (%d). Value must be 0 (automatic) or a number of threads.",
+                              CONFIG_EXPORT_THREADS, val);
+        return LDAP_UNWILLING_TO_PERFORM;
+    }
+
+    if (apply) {
+        li->li_export_threads = val;
+    }
+
+    return LDAP_SUCCESS;
+}
+
 static void *
 ldbm_config_mode_get(void *arg)
 {
@@ -986,6 +1161,12 @@ static config_info ldbm_config[] = {
     {CONFIG_PAGEDIDLISTSCANLIMIT, CONFIG_TYPE_INT, "0", &ldbm_config_pagedallidsthreshold_get, &ldbm_config_pagedallidsthreshold_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {CONFIG_RANGELOOKTHROUGHLIMIT, CONFIG_TYPE_INT, "5000", &ldbm_config_rangelookthroughlimit_get, &ldbm_config_rangelookthroughlimit_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {CONFIG_BACKEND_OPT_LEVEL, CONFIG_TYPE_INT, "1", &ldbm_config_backend_opt_level_get, &ldbm_config_backend_opt_level_set, CONFIG_FLAG_ALWAYS_SHOW},
+    {CONFIG_SEARCH_PREFETCH_DEPTH, CONFIG_TYPE_INT, "0", &ldbm_config_search_prefetch_depth_get, &ldbm_config_search_prefetch_depth_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
+    {CONFIG_CACHE_PRELOAD, CONFIG_TYPE_ONOFF, "off", &ldbm_config_cache_preload_get, &ldbm_config_cache_preload_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
+    {CONFIG_CACHE_PRELOAD_RATE, CONFIG_TYPE_INT, "0", &ldbm_config_cache_preload_rate_get, &ldbm_config_cache_preload_rate_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
+    {CONFIG_CACHE_SNAPSHOT_INTERVAL, CONFIG_TYPE_INT, "0", &ldbm_config_cache_snapshot_interval_get, &ldbm_config_cache_snapshot_interval_set, CONFIG_FLAG_ALWAYS_SHOW},
+    {CONFIG_FILTER_COST_OPTIMIZER, CONFIG_TYPE_ONOFF, "off", &ldbm_config_filter_cost_optimizer_get, &ldbm_config_filter_cost_optimizer_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
+    {CONFIG_EXPORT_THREADS, CONFIG_TYPE_INT, "0", &ldbm_config_export_threads_get, &ldbm_config_export_threads_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {CONFIG_BACKEND_IMPLEMENT, CONFIG_TYPE_STRING, "bdb", &ldbm_config_backend_implement_get, &ldbm_config_backend_implement_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {NULL, 0, NULL, NULL, NULL, 0}};
 
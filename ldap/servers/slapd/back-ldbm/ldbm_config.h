@@ -125,6 +125,13 @@ struct config_info
 #define CONFIG_USE_VLV_INDEX "nsslapd-search-use-vlv-index"
 #define CONFIG_SERIAL_LOCK "nsslapd-serial-lock"
 #define CONFIG_BACKEND_OPT_LEVEL "nsslapd-backend-opt-level"
+#define CONFIG_SEARCH_PREFETCH_DEPTH "nsslapd-search-prefetch-depth"
+#define LDBM_SEARCH_PREFETCH_DEPTH_MAX 4096
+#define CONFIG_CACHE_PRELOAD "nsslapd-cache-preload"
+#define CONFIG_CACHE_PRELOAD_RATE "nsslapd-cache-preload-rate"
+#define CONFIG_CACHE_SNAPSHOT_INTERVAL "nsslapd-cache-snapshot-interval"
+#define CONFIG_FILTER_COST_OPTIMIZER "nsslapd-filter-cost-optimizer"
+#define CONFIG_EXPORT_THREADS "nsslapd-export-threads"
 
 #define CONFIG_ENTRYRDN_SWITCH "nsslapd-subtree-rename-switch"
 /* nsslapd-noancestorid is ignored unless nsslapd-subtree-rename-switch is on */
@@ -134,6 +141,7 @@ struct config_info
 #define CONFIG_INSTANCE_CACHESIZE "nsslapd-cachesize"
 #define CONFIG_INSTANCE_CACHEMEMSIZE "nsslapd-cachememsize"
 #define CONFIG_INSTANCE_DNCACHEMEMSIZE "nsslapd-dncachememsize"
+#define CONFIG_INSTANCE_DNTREECACHEMEMSIZE "nsslapd-dntreecachememsize"
 #define CONFIG_INSTANCE_SUFFIX "nsslapd-suffix"
 #define CONFIG_INSTANCE_READONLY "nsslapd-readonly"
 #define CONFIG_INSTANCE_DIR "nsslapd-directory"
@@ -104,7 +104,7 @@ static int _entryrdn_put_data(dbi_cursor_t *cursor, dbi_val_t *key, dbi_val_t *d
 static int _entryrdn_del_data(dbi_cursor_t *cursor, dbi_val_t *key, dbi_val_t *data, dbi_txn_t *db_txn);
 static int _entryrdn_insert_key_elems(backend *be, dbi_cursor_t *cursor, Slapi_RDN *srdn, dbi_val_t *key, rdn_elem *elem, rdn_elem *childelem, size_t childelemlen, dbi_txn_t *db_txn);
 static int _entryrdn_index_read(backend *be, dbi_cursor_t *cursor, Slapi_RDN *srdn, rdn_elem **elem, rdn_elem **parentelem, rdn_elem ***childelems, int flags, dbi_txn_t *db_txn);
-static int _entryrdn_append_childidl(dbi_cursor_t *cursor, const char *nrdn, ID id, IDList **affectedidl, dbi_txn_t *db_txn);
+static int _entryrdn_append_childidl(dbi_cursor_t *cursor, const char *nrdn, ID id, IDList **affectedidl, dntree_batch *batch, dbi_txn_t *db_txn);
 static void _entryrdn_cursor_print_error(char *fn, void *key, size_t need, size_t actual, int rc);
 
 
@@ -246,6 +246,9 @@ entryrdn_index_entry(backend *be,
         goto bail;
     }
 
+    /* the DN tree drops the entry and the children list of its parent */
+    dntree_invalidate((ldbm_instance *)be->be_instance_info, e->ep_id,
+                      (ID)slapi_entry_attr_get_ulong(e->ep_entry, LDBM_PARENTID_STR));
     if (flags & BE_INDEX_ADD) {
         rc = entryrdn_insert_key(be, &cursor, srdn, e->ep_id, txn);
     } else if (flags & BE_INDEX_DEL) {
@@ -369,6 +372,9 @@ entryrdn_index_read_ext(backend *be,
     dbi_txn_t *db_txn = (txn != NULL) ? txn->back_txn_txn : NULL;
     dbi_cursor_t cursor = {0};
     rdn_elem *elem = NULL;
+    rdn_elem *parentelem = NULL;
+    ldbm_instance *inst = NULL;
+    dntree_batch *batch = NULL;
     int db_retry = 0;
 
     slapi_log_err(SLAPI_LOG_TRACE, "entryrdn_index_read",
@@ -382,6 +388,7 @@ entryrdn_index_read_ext(backend *be,
     }
 
     *id = 0;
+    inst = (ldbm_instance *)be->be_instance_info;
 
     rc = slapi_rdn_init_all_sdn(&srdn, sdn);
     if (rc < 0) {
@@ -397,6 +404,13 @@ entryrdn_index_read_ext(backend *be,
         goto bail;
     }
 
+    if (0 == flags && NULL == db_txn) {
+        if (0 == dntree_dn2id(inst, &srdn, id)) {
+            goto bail;
+        }
+        batch = dntree_batch_new(inst);
+    }
+
     /* Open the entryrdn index */
     rc = _entryrdn_open_index(be, &ai, &db);
     if (rc || (NULL == db)) {
@@ -429,12 +443,15 @@ entryrdn_index_read_ext(backend *be,
         goto bail;
     }
 
-    rc = _entryrdn_index_read(be, &cursor, &srdn, &elem, NULL, NULL,
-                              flags, db_txn);
+    rc = _entryrdn_index_read(be, &cursor, &srdn, &elem,
+                              batch ? &parentelem : NULL, NULL, flags, db_txn);
     if (rc) {
         goto bail;
     }
     *id = id_stored_to_internal(elem->rdn_elem_id);
+    dntree_batch_add(batch, *id, parentelem ? id_stored_to_internal(parentelem->rdn_elem_id) : 0,
+                     elem->rdn_elem_nrdn_rdn, RDN_ADDR(elem));
+    dntree_batch_apply(batch);
 
 bail:
     /* Close the cursor */
@@ -467,6 +484,8 @@ bail:
     }
     slapi_rdn_done(&srdn);
     slapi_ch_free((void **)&elem);
+    slapi_ch_free((void **)&parentelem);
+    dntree_batch_free(&batch);
     slapi_log_err(SLAPI_LOG_TRACE, "entryrdn_index_read",
                   "<-- entryrdn_index_read\n");
     return rc;
@@ -559,7 +578,10 @@ entryrdn_rename_subtree(backend *be,
             mynewsrdn = newsrdn;
         }
     }
-    if (NULL == mynewsrdn && NULL == mynewsupsdn) {
+    if (mynewsrdn || mynewsupsdn) {
+        /* a move changes the children lists of the old and new superiors */
+        dntree_invalidate((ldbm_instance *)be->be_instance_info, id, mynewsupsdn ? 0 : NOID);
+    } else {
         /* E.g., rename dn: cn=ABC    DEF,... --> cn=ABC DEF,... */
         slapi_log_err(SLAPI_LOG_BACKLDBM, "entryrdn_rename_subtree",
                       "No new superior is given "
@@ -883,8 +905,10 @@ entryrdn_get_subordinates(backend *be,
     const char *nrdn = NULL; /* normalized rdn */
     int rdnidx = -1;
     rdn_elem *elem = NULL;
+    rdn_elem *parentelem = NULL;
     rdn_elem **childelems = NULL;
     rdn_elem **cep = NULL;
+    dntree_batch *batch = NULL;
     int db_retry = 0;
 
     slapi_log_err(SLAPI_LOG_TRACE, "entryrdn_get_subordinates",
@@ -927,6 +951,13 @@ entryrdn_get_subordinates(backend *be,
         goto bail;
     }
 
+    if (0 == flags && NULL == db_txn) {
+        if (0 == dntree_get_subordinates((ldbm_instance *)be->be_instance_info, id, subordinates)) {
+            goto bail;
+        }
+        batch = dntree_batch_new((ldbm_instance *)be->be_instance_info);
+    }
+
     /* Open the entryrdn index */
     rc = _entryrdn_open_index(be, &ai, &db);
     if (rc || (NULL == db)) {
@@ -960,13 +991,20 @@ entryrdn_get_subordinates(backend *be,
     }
 
     rc = _entryrdn_index_read(be, &cursor, &srdn, &elem,
-                              NULL, &childelems, 0 /*flags*/, db_txn);
+                              batch ? &parentelem : NULL, &childelems, 0 /*flags*/, db_txn);
     if ((rc == DBI_RC_RETRY) && db_txn) {
         goto bail;
     }
+    if (rc || NULL == elem || id != id_stored_to_internal(elem->rdn_elem_id)) {
+        /* only a complete subtree goes to the DN tree */
+        dntree_batch_free(&batch);
+    }
+    dntree_batch_add(batch, id, parentelem ? id_stored_to_internal(parentelem->rdn_elem_id) : 0,
+                     elem ? elem->rdn_elem_nrdn_rdn : NULL, elem ? RDN_ADDR(elem) : NULL);
 
     for (cep = childelems; cep && *cep; cep++) {
         ID childid = id_stored_to_internal((*cep)->rdn_elem_id);
+        dntree_batch_add(batch, childid, id, (*cep)->rdn_elem_nrdn_rdn, RDN_ADDR(*cep));
         /* set direct children to the idlist */
         rc = idl_append_extend(subordinates, childid);
         if (rc) {
@@ -978,7 +1016,7 @@ entryrdn_get_subordinates(backend *be,
 
         /* set indirect subordinates to the idlist */
         rc = _entryrdn_append_childidl(&cursor, (*cep)->rdn_elem_nrdn_rdn,
-                                       childid, subordinates, db_txn);
+                                       childid, subordinates, batch, db_txn);
         if (rc) {
             slapi_log_err(SLAPI_LOG_ERR, "entryrdn_get_subordinates",
                           "Appending %d to idl for indirect children failed (%d)\n",
@@ -986,12 +1024,18 @@ entryrdn_get_subordinates(backend *be,
             goto bail;
         }
     }
+    if (0 == rc) {
+        dntree_batch_children(batch, id);
+        dntree_batch_apply(batch);
+    }
 
 bail:
     if (rc && subordinates && *subordinates) {
         idl_free(subordinates);
     }
+    dntree_batch_free(&batch);
     slapi_ch_free((void **)&elem);
+    slapi_ch_free((void **)&parentelem);
     slapi_rdn_done(&srdn);
     if (childelems) {
         for (cep = childelems; *cep; cep++) {
@@ -1063,6 +1107,9 @@ entryrdn_lookup_dn(backend *be,
     ID workid = id; /* starting from the given id */
     rdn_elem *elem = NULL;
     int maybesuffix = 0;
+    char *worknrdn = NULL; /* rdn of workid, for the DN tree */
+    char *workrdn = NULL;
+    dntree_batch *batch = NULL;
     int db_retry = 0;
 
     slapi_log_err(SLAPI_LOG_TRACE, "entryrdn_lookup_dn",
@@ -1078,9 +1125,16 @@ entryrdn_lookup_dn(backend *be,
     *dn = NULL;
     if (psrdn)
         *psrdn = NULL;
+    if (NULL == db_txn) {
+        if (0 == dntree_id2dn((ldbm_instance *)be->be_instance_info, id, rdn, dn, psrdn)) {
+            return 0;
+        }
+        batch = dntree_batch_new((ldbm_instance *)be->be_instance_info);
+    }
     /* Open the entryrdn index */
     rc = _entryrdn_open_index(be, &ai, &db);
     if (rc || (NULL == db)) {
+        dntree_batch_free(&batch);
         slapi_log_err(SLAPI_LOG_ERR, "entryrdn_lookup_dn",
                       "Opening the index failed: %s(%d)\n",
                       rc < 0 ? dblayer_strerror(rc) : "Invalid parameter", rc);
@@ -1180,6 +1234,9 @@ entryrdn_lookup_dn(backend *be,
             /* it is a suffix, indeed.  done. */
             /* generate sdn to return */
             slapi_rdn_get_dn(srdn, dn);
+            dntree_batch_add(batch, id_stored_to_internal(((rdn_elem *)data.data)->rdn_elem_id), 0,
+                             worknrdn, workrdn);
+            dntree_batch_apply(batch);
             rc = 0;
             goto bail;
         }
@@ -1188,6 +1245,13 @@ entryrdn_lookup_dn(backend *be,
         _ENTRYRDN_DUMP_RDN_ELEM(elem);
         slapi_ch_free_string(&nrdn);
         nrdn = slapi_ch_strdup(elem->rdn_elem_nrdn_rdn);
+        dntree_batch_add(batch, workid, id_stored_to_internal(elem->rdn_elem_id), worknrdn, workrdn);
+        slapi_ch_free_string(&worknrdn);
+        slapi_ch_free_string(&workrdn);
+        if (batch) {
+            worknrdn = slapi_ch_strdup(elem->rdn_elem_nrdn_rdn);
+            workrdn = slapi_ch_strdup(RDN_ADDR(elem));
+        }
         workid = id_stored_to_internal(elem->rdn_elem_id);
         /* 1 is byref, and the dup'ed rdn is freed with srdn */
         slapi_rdn_add_rdn_to_all_rdns(srdn, slapi_ch_strdup(RDN_ADDR(elem)), 1);
@@ -1233,6 +1297,9 @@ bail:
         slapi_rdn_free(&srdn);
     }
     slapi_ch_free_string(&nrdn);
+    slapi_ch_free_string(&worknrdn);
+    slapi_ch_free_string(&workrdn);
+    dntree_batch_free(&batch);
     slapi_log_err(SLAPI_LOG_TRACE, "entryrdn_lookup_dn",
                   "<-- entryrdn_lookup_dn\n");
     return rc;
@@ -1266,6 +1333,7 @@ entryrdn_get_parent(backend *be,
     char *nrdn = NULL;
     size_t nrdn_len = 0;
     rdn_elem *elem = NULL;
+    dntree_batch *batch = NULL;
     int db_retry = 0;
 
     slapi_log_err(SLAPI_LOG_TRACE, "entryrdn_get_parent",
@@ -1282,10 +1350,17 @@ entryrdn_get_parent(backend *be,
     }
     *prdn = NULL;
     *pid = 0;
+    if (NULL == db_txn) {
+        if (0 == dntree_get_parent((ldbm_instance *)be->be_instance_info, id, prdn, pid)) {
+            return 0;
+        }
+        batch = dntree_batch_new((ldbm_instance *)be->be_instance_info);
+    }
 
     /* Open the entryrdn index */
     rc = _entryrdn_open_index(be, &ai, &db);
     if (rc || (NULL == db)) {
+        dntree_batch_free(&batch);
         slapi_log_err(SLAPI_LOG_ERR, "entryrdn_get_parent",
                       "Opening the index failed: %s(%d)\n",
                       rc < 0 ? dblayer_strerror(rc) : "Invalid parameter", rc);
@@ -1376,7 +1451,10 @@ retry_get0:
     _ENTRYRDN_DUMP_RDN_ELEM(elem);
     *pid = id_stored_to_internal(elem->rdn_elem_id);
     *prdn = slapi_ch_strdup(RDN_ADDR(elem));
+    dntree_batch_add(batch, id, *pid, NULL, NULL);
+    dntree_batch_apply(batch);
 bail:
+    dntree_batch_free(&batch);
     slapi_ch_free_string(&nrdn);
     dblayer_value_free(be, &key);
     dblayer_value_free(be, &data);
@@ -3168,6 +3246,7 @@ _entryrdn_append_childidl(dbi_cursor_t *cursor,
                           const char *nrdn __attribute__((unused)),
                           ID id,
                           IDList **affectedidl,
+                          dntree_batch *batch, /* collects the subtree for the DN tree */
                           dbi_txn_t *db_txn)
 {
     /* E.g., C5 */
@@ -3218,9 +3297,10 @@ retry_get0:
                               "Appending %d to affected idl failed (%d)\n", myid, rc);
                 goto bail;
             }
+            dntree_batch_add(batch, myid, id, myelem->rdn_elem_nrdn_rdn, RDN_ADDR(myelem));
             rc = _entryrdn_append_childidl(cursor,
                                            (const char *)myelem->rdn_elem_nrdn_rdn,
-                                           myid, affectedidl, db_txn);
+                                           myid, affectedidl, batch, db_txn);
             if (rc) {
                 goto bail;
             }
@@ -3248,6 +3328,9 @@ retry_get0:
     } while (0 == rc);
 
 bail:
+    if (0 == rc) {
+        dntree_batch_children(batch, id);
+    }
     dblayer_value_free(be, &key);
     return rc;
 }
@@ -294,6 +294,13 @@ ldbm_instance_index_config_modify_callback(Slapi_PBlock *pb __attribute__((unuse
         return SLAPI_DSE_CALLBACK_ERROR;
     }
 
+    /* The subpos keys only exist once the index is rebuilt: until then the
+     * substring lookups keep using the "sub" keys (or are unindexed) */
+    if (!(ainfo->ai_indexmask & INDEX_SUBPOS) &&
+        slapi_entry_attr_hasvalue(entryAfter, "nsIndexType", "subpos")) {
+        ainfo->ai_indexmask |= INDEX_SUBPOS_OFFLINE;
+    }
+
     if (attr_index_config(inst->inst_be, "from DSE modify", 0, entryAfter, 0, 0, returntext)) {
         *returncode = LDAP_UNWILLING_TO_PERFORM;
         return SLAPI_DSE_CALLBACK_ERROR;
@@ -415,7 +422,7 @@ ldbm_instance_index_config_enable_index(ldbm_instance *inst, Slapi_Entry *e)
             ainfo_get(inst->inst_be, index_name, &ai);
         }
         PR_ASSERT(ai != NULL);
-        ai->ai_indexmask &= ~INDEX_OFFLINE;
+        ai->ai_indexmask &= ~(INDEX_OFFLINE | INDEX_SUBPOS_OFFLINE);
     }
     slapi_ch_free_string(&index_name);
     return rc;
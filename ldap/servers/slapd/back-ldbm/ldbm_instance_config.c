@@ -231,6 +231,49 @@ ldbm_instance_config_dncachememsize_set(void *arg,
     return retval;
 }
 
+static void *
+ldbm_instance_config_dntreecachememsize_get(void *arg)
+{
+    ldbm_instance *inst = (ldbm_instance *)arg;
+
+    return (void *)((uintptr_t)dntree_get_max_size(inst->inst_dntree));
+}
+
+static int
+ldbm_instance_config_dntreecachememsize_set(void *arg,
+                                            void *value,
+                                            char *errorbuf,
+                                            int phase __attribute__((unused)),
+                                            int apply)
+{
+    ldbm_instance *inst = (ldbm_instance *)arg;
+    uint64_t val = (uint64_t)((uintptr_t)value);
+    uint64_t delta = 0;
+
+    /* 0 disables the DN tree; as for the dn cache, only check a growth */
+    if (apply) {
+        if (val > dntree_get_max_size(inst->inst_dntree)) {
+            delta = val - dntree_get_max_size(inst->inst_dntree);
+
+            util_cachesize_result sane;
+            slapi_pal_meminfo *mi = spal_meminfo_get();
+            sane = util_is_cachesize_sane(mi, &delta);
+            spal_meminfo_destroy(mi);
+
+            if (sane != UTIL_CACHESIZE_VALID) {
+                slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                                      "Error: dntreecachememsize value is too large.");
+                slapi_log_err(SLAPI_LOG_ERR, "ldbm_instance_config_dntreecachememsize_set",
+                              "dntreecachememsize value is too large.\n");
+                return LDAP_UNWILLING_TO_PERFORM;
+            }
+        }
+        dntree_set_max_size(inst->inst_dntree, val);
+    }
+
+    return LDAP_SUCCESS;
+}
+
 static void *
 ldbm_instance_config_readonly_get(void *arg)
 {
@@ -335,6 +378,7 @@ static config_info ldbm_instance_config[] = {
     {CONFIG_INSTANCE_REQUIRE_INDEX, CONFIG_TYPE_ONOFF, "off", &ldbm_instance_config_require_index_get, &ldbm_instance_config_require_index_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {CONFIG_INSTANCE_REQUIRE_INTERNALOP_INDEX, CONFIG_TYPE_ONOFF, "off", &ldbm_instance_config_require_internalop_index_get, &ldbm_instance_config_require_internalop_index_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {CONFIG_INSTANCE_DNCACHEMEMSIZE, CONFIG_TYPE_UINT64, DEFAULT_DNCACHE_SIZE_STR, &ldbm_instance_config_dncachememsize_get, &ldbm_instance_config_dncachememsize_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
+    {CONFIG_INSTANCE_DNTREECACHEMEMSIZE, CONFIG_TYPE_UINT64, DEFAULT_DNTREE_SIZE_STR, &ldbm_instance_config_dntreecachememsize_get, &ldbm_instance_config_dntreecachememsize_set, CONFIG_FLAG_ALWAYS_SHOW | CONFIG_FLAG_ALLOW_RUNNING_CHANGE},
     {NULL, 0, NULL, NULL, NULL, 0}};
 
 void
@@ -28,6 +28,9 @@
  */
 #define LDBM_SRCH_DEFAULT_RESULT (-1)
 
+/* Candidates sorted up front for a paged search without size limit */
+#define SORT_PAGED_TOPK 1000
+
 /* prototypes */
 static int build_candidate_list(Slapi_PBlock *pb, backend *be, struct backentry *e, const char *base, int scope, int *lookup_returned_allidsp, IDList **candidates);
 static IDList *base_candidates(Slapi_PBlock *pb, struct backentry *e);
@@ -35,7 +38,7 @@ static IDList *onelevel_candidates(Slapi_PBlock *pb, backend *be, const char *ba
 static back_search_result_set *new_search_result_set(IDList *idl, int vlv, int lookthroughlimit);
 static void delete_search_result_set(Slapi_PBlock *pb, back_search_result_set **sr);
 static int can_skip_filter_test(Slapi_PBlock *pb, struct slapi_filter *f, int scope, IDList *idl);
-static void stat_add_srch_lookup(Op_stat *op_stat, char * attribute_type, const char* index_type, char *key_value, int lookup_cnt);
+static void stat_add_srch_lookup(Op_search_stat *search_stat, char * attribute_type, const char* index_type, char *key_value, int lookup_cnt);
 
 /* This is for performance testing, allows us to disable ACL checking altogether */
 #if defined(DISABLE_ACL_CHECK)
@@ -723,6 +726,7 @@ ldbm_back_search(Slapi_PBlock *pb)
 
                     char *sort_error_type = NULL;
                     int sort_return_value = 0;
+                    int sort_topk = 0;
 
                     /* Don't log internal operations */
                     if (!operation_is_flag_set(operation, OP_FLAG_INTERNAL)) {
@@ -732,10 +736,20 @@ ldbm_back_search(Slapi_PBlock *pb)
                      * input to ldapsearch> <#candidates> | <unsortable> */
                         sort_log_access(pb, sort_control, candidates);
                     }
+                    /* Only the first entries are returned with a size limit
+                     * or a page size: sort them first, the rest is sorted
+                     * if the search gets that far.  VLV needs the whole list. */
+                    if (!virtual_list_view && !operation_is_flag_set(operation, OP_FLAG_REVERSE_CANDIDATE_ORDER)) {
+                        slapi_pblock_get(pb, SLAPI_SEARCH_SIZELIMIT, &sort_topk);
+                        if (sort_topk <= 0 && op_is_pagedresults(operation)) {
+                            sort_topk = SORT_PAGED_TOPK;
+                        }
+                    }
                     sort_return_value = sort_candidates(be, lookthrough_limit,
                                                         &expire_time, pb, candidates,
                                                         sort_control,
-                                                        &sort_error_type);
+                                                        &sort_error_type,
+                                                        sort_topk, &sr->sr_sort_tail);
                     /* Fix for bugid # 394184, SD, 20 Jul 00 */
                     /* replace the hard coded return value by the appropriate
                  * LDAP error code */
@@ -917,6 +931,12 @@ ldbm_back_search(Slapi_PBlock *pb)
     sr->sr_candidates = candidates;
     sr->sr_virtuallistview = virtual_list_view;
 
+    /* Entries read by a full scan or by a bulk task must not push the
+     * working set out of the entry cache */
+    if ((NULL != candidates && ALLIDS(candidates)) || operation_is_flag_set(operation, OP_FLAG_SCAN)) {
+        sr->sr_flags |= SR_FLAG_SCAN;
+    }
+
     /* Set the estimated search result count for simple paged results */
     if (sr->sr_candidates && !ALLIDS(sr->sr_candidates)) {
         estimate = IDL_NIDS(sr->sr_candidates);
@@ -984,6 +1004,18 @@ ldbm_back_search(Slapi_PBlock *pb)
     } else {
         slapi_log_err(SLAPI_LOG_FILTER, "ldbm_back_search", "Skipped Filter Test\n");
     }
+
+    /* search explain control: the candidate list and the filter test decision */
+    if (operation_is_flag_set(operation, OP_FLAG_EXPLAIN)) {
+        Op_search_stat *explain = op_stat_get_search_stat(pb);
+
+        if (explain && candidates) {
+            explain->candidates += IDL_NIDS(candidates);
+            /* the subtree candidates are already scoped, look at the lookup itself */
+            explain->candidates_allids |= lookup_returned_allids || ALLIDS(candidates);
+            explain->filter_test_bypassed |= !(sr->sr_flags & SR_FLAG_MUST_APPLY_FILTER_TEST);
+        }
+    }
 bail:
     /* Fix for bugid #394184, SD, 05 Jul 00 */
     /* tmp_err == LDBM_SRCH_DEFAULT_RESULT: no error */
@@ -1013,6 +1045,8 @@ build_candidate_list(Slapi_PBlock *pb, backend *be, struct backentry *e, const c
     int r = 0;
     char logbuf[1024] = {0};
     Slapi_Operation *operation;
+    Op_search_stat *explain = NULL;
+    struct timespec start;
 
     slapi_pblock_get(pb, SLAPI_SEARCH_FILTER, &filter);
     if (NULL == filter) {
@@ -1023,6 +1057,13 @@ build_candidate_list(Slapi_PBlock *pb, backend *be, struct backentry *e, const c
 
     slapi_pblock_get(pb, SLAPI_MANAGEDSAIT, &managedsait);
 
+    /* search explain control: time the index lookups and keep the filter as run */
+    slapi_pblock_get(pb, SLAPI_OPERATION, &operation);
+    if (operation && operation_is_flag_set(operation, OP_FLAG_EXPLAIN)) {
+        explain = op_stat_get_search_stat(pb);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+
     switch (scope) {
     case LDAP_SCOPE_BASE:
         *candidates = base_candidates(pb, e);
@@ -1103,6 +1144,17 @@ bail:
     slapi_log_err(SLAPI_LOG_TRACE, "build_candidate_list", "Candidate list has %lu ids\n",
                   *candidates ? (*candidates)->b_nids : 0L);
 
+    if (explain) {
+        explain->candidates_ns += op_stat_elapsed_ns(&start);
+        /* With several backends, the first one tells how the filter was optimised */
+        if (explain->filter_executed == NULL) {
+            if (filter_exec == NULL) {
+                slapi_filter_to_string(filter, logbuf, sizeof(logbuf));
+            }
+            explain->filter_executed = slapi_ch_strdup(logbuf);
+        }
+    }
+
     return r;
 }
 
@@ -1208,11 +1260,11 @@ create_subtree_filter(Slapi_Filter *filter, int managedsait)
 }
 
 static void
-stat_add_srch_lookup(Op_stat *op_stat, char * attribute_type, const char* index_type, char *key_value, int lookup_cnt)
+stat_add_srch_lookup(Op_search_stat *search_stat, char * attribute_type, const char* index_type, char *key_value, int lookup_cnt)
 {
     struct component_keys_lookup *key_stat;
 
-    if ((op_stat == NULL) || (op_stat->search_stat == NULL)) {
+    if (search_stat == NULL) {
         return;
     }
 
@@ -1237,14 +1289,14 @@ stat_add_srch_lookup(Op_stat *op_stat, char * attribute_type, const char* index_
 
     /* Number of lookup IDs with the key */
     key_stat->id_lookup_cnt = lookup_cnt;
-    if (op_stat->search_stat->keys_lookup) {
+    if (search_stat->keys_lookup) {
         /* it already exist key stat. add key_stat at the head */
-        key_stat->next = op_stat->search_stat->keys_lookup;
+        key_stat->next = search_stat->keys_lookup;
     } else {
         /* this is the first key stat record */
         key_stat->next = NULL;
     }
-    op_stat->search_stat->keys_lookup = key_stat;
+    search_stat->keys_lookup = key_stat;
 }
 
 /*
@@ -1294,16 +1346,14 @@ subtree_candidates(
     if (candidates != NULL && (idl_length(candidates) > FILTER_TEST_THRESHOLD) && e) {
         IDList *tmp = candidates, *descendants = NULL;
         back_txn txn = {NULL};
-        Op_stat *op_stat = NULL;
+        Op_search_stat *search_stat = NULL;
         char key_value[32] = {0};
 
         /* statistics for index lookup is enabled */
-        if (LDAP_STAT_READ_INDEX & config_get_statlog_level()) {
-            op_stat = op_stat_get_operation_extension(pb);
-            if (op_stat) {
-                /* easier to just record the entry ID */
-                PR_snprintf(key_value, sizeof(key_value), "%lu", (u_long) e->ep_id);
-            }
+        search_stat = op_stat_get_search_stat(pb);
+        if (search_stat) {
+            /* easier to just record the entry ID */
+            PR_snprintf(key_value, sizeof(key_value), "%lu", (u_long) e->ep_id);
         }
 
         slapi_pblock_get(pb, SLAPI_TXN, &txn.back_txn_txn);
@@ -1312,9 +1362,9 @@ subtree_candidates(
             *err = entryrdn_get_subordinates(be,
                                              slapi_entry_get_sdn_const(e->ep_entry),
                                              e->ep_id, &descendants, &txn, 0);
-            if (op_stat) {
+            if (search_stat) {
                 /* record entryrdn lookups */
-                stat_add_srch_lookup(op_stat, LDBM_ENTRYRDN_STR, indextype_EQUALITY, key_value, descendants ? descendants->b_nids : 0);
+                stat_add_srch_lookup(search_stat, LDBM_ENTRYRDN_STR, indextype_EQUALITY, key_value, descendants ? descendants->b_nids : 0);
             }
             idl_insert(&descendants, e->ep_id);
             candidates = idl_intersection(be, candidates, descendants);
@@ -1322,9 +1372,9 @@ subtree_candidates(
             idl_free(&descendants);
         } else if (!has_tombstone_filter && !is_bulk_import) {
             *err = ldbm_ancestorid_read_ext(be, &txn, e->ep_id, &descendants, allidslimit);
-            if (op_stat) {
+            if (search_stat) {
                 /* records ancestorid lookups */
-                stat_add_srch_lookup(op_stat, LDBM_ANCESTORID_STR, indextype_EQUALITY, key_value, descendants ? descendants->b_nids : 0);
+                stat_add_srch_lookup(search_stat, LDBM_ANCESTORID_STR, indextype_EQUALITY, key_value, descendants ? descendants->b_nids : 0);
             }
             idl_insert(&descendants, e->ep_id);
             candidates = idl_intersection(be, candidates, descendants);
@@ -1469,10 +1519,14 @@ can_skip_filter_test(
  * completes
  */
 static void
-non_target_cache_return(Slapi_Operation *op, struct cache *cache, struct backentry **e)
+non_target_cache_return(Slapi_Operation *op, back_search_result_set *sr, struct cache *cache, struct backentry **e)
 {
     if (e && (*e != operation_get_target_entry(op))) {
-        CACHE_RETURN(cache, e);
+        if (sr->sr_flags & SR_FLAG_SCAN) {
+            CACHE_RETURN_SCAN(cache, e);
+        } else {
+            CACHE_RETURN(cache, e);
+        }
     }
 }
 
@@ -1511,8 +1565,10 @@ ldbm_back_next_search_entry(Slapi_PBlock *pb)
     back_txn txn = {NULL};
     int pr_idx = -1;
     Slapi_Connection *conn;
-    Slapi_Operation *op;
+    Slapi_Operation *op = NULL;
     int reverse_list = 0;
+    Op_search_stat *explain = NULL;
+    struct timespec scan_start;
 
     slapi_pblock_get(pb, SLAPI_SEARCH_TARGET_SDN, &basesdn);
     if (NULL == basesdn) {
@@ -1540,6 +1596,10 @@ ldbm_back_next_search_entry(Slapi_PBlock *pb)
     slapi_pblock_get(pb, SLAPI_CONNECTION, &conn);
     slapi_pblock_get(pb, SLAPI_OPERATION, &op);
 
+    /* search explain control: account the candidates and the time to go through them */
+    if (operation_is_flag_set(op, OP_FLAG_EXPLAIN) && (explain = op_stat_get_search_stat(pb))) {
+        clock_gettime(CLOCK_MONOTONIC, &scan_start);
+    }
 
     if ((reverse_list = operation_is_flag_set(op, OP_FLAG_REVERSE_CANDIDATE_ORDER))) {
         /*
@@ -1594,7 +1654,7 @@ ldbm_back_next_search_entry(Slapi_PBlock *pb)
     /* If we are using the extension, the front end will tell
      * us when to do this so we don't do it now */
     if (sr->sr_entry) {
-        non_target_cache_return(op, &inst->inst_cache, &(sr->sr_entry));
+        non_target_cache_return(op, sr, &inst->inst_cache, &(sr->sr_entry));
         sr->sr_entry = NULL;
     }
 
@@ -1678,6 +1738,13 @@ ldbm_back_next_search_entry(Slapi_PBlock *pb)
             }
         } else {
             /* Process the candidate list in the normal order. */
+            if (sr->sr_sort_tail) {
+                /* a top-K sort left the end of the candidates unsorted */
+                sort_candidates_next(pb, sr->sr_candidates, sr->sr_current, &sr->sr_sort_tail);
+            }
+            if (li->li_search_prefetch_depth > 0 && !operation_is_flag_set(op, OP_FLAG_NEVER_CACHE)) {
+                ldbm_prefetch_schedule(be, li, sr);
+            }
             id = idl_iterator_dereference_increment(&(sr->sr_current), sr->sr_candidates);
         }
 
@@ -1710,7 +1777,17 @@ ldbm_back_next_search_entry(Slapi_PBlock *pb)
             /* if the entry is not the target_entry (base search)
              * we need to fetch it from the entry cache (it was not
              * referenced in the operation) */
-            e = id2entry(be, id, &txn, &err);
+            if (explain) {
+                /* same lookup as id2entry does first, to tell hits from misses */
+                if ((e = cache_find_id(&inst->inst_cache, id)) != NULL) {
+                    explain->cache_hits++;
+                } else {
+                    explain->cache_misses++;
+                }
+            }
+            if (e == NULL || explain == NULL) {
+                e = id2entry(be, id, &txn, &err);
+            }
         }
         if (e == NULL) {
             if (err != 0 && err != DBI_RC_NOTFOUND) {
@@ -1765,6 +1842,10 @@ ldbm_back_next_search_entry(Slapi_PBlock *pb)
             int filter_test = -1;
             int is_bulk_import = operation_is_flag_set(op, OP_FLAG_BULK_IMPORT);
 
+            if (explain) {
+                explain->entries_tested++;
+            }
+
             if (is_bulk_import) {
                 /* If it is from bulk import, no need to check. */
                 filter_test = 0;
@@ -1876,7 +1957,7 @@ ldbm_back_next_search_entry(Slapi_PBlock *pb)
                     /* check size limit */
                     if (slimit >= 0) {
                         if (--slimit < 0) {
-                            non_target_cache_return(op, &inst->inst_cache, &e);
+                            non_target_cache_return(op, sr, &inst->inst_cache, &e);
                             slapi_pblock_set(pb, SLAPI_SEARCH_RESULT_SET_SIZE_ESTIMATE, &estimate);
                             delete_search_result_set(pb, &sr);
                             slapi_send_ldap_result(pb, LDAP_SIZELIMIT_EXCEEDED, NULL, NULL, nentries, urls);
@@ -1905,15 +1986,18 @@ ldbm_back_next_search_entry(Slapi_PBlock *pb)
                     } else {
                         slapi_pblock_set(pb, SLAPI_SEARCH_RESULT_ENTRY, e->ep_entry);
                     }
+                    if (explain) {
+                        explain->entries_matched++;
+                    }
                     rc = 0;
                     goto bail;
                 } else {
-                    non_target_cache_return(op, &inst->inst_cache, &(sr->sr_entry));
+                    non_target_cache_return(op, sr, &inst->inst_cache, &(sr->sr_entry));
                     sr->sr_entry = NULL;
                 }
             } else {
                 /* Failed the filter test, and this isn't a VLV Search */
-                non_target_cache_return(op, &inst->inst_cache, &(sr->sr_entry));
+                non_target_cache_return(op, sr, &inst->inst_cache, &(sr->sr_entry));
                 sr->sr_entry = NULL;
                 if (LDAP_UNWILLING_TO_PERFORM == filter_test) {
                     /* Need to catch this error to detect the vattr loop */
@@ -1941,6 +2025,9 @@ bail:
     if (rc && op) {
         op->o_reverse_search_state = 0;
     }
+    if (explain) {
+        explain->scan_ns += op_stat_elapsed_ns(&scan_start);
+    }
     return rc;
 }
 
@@ -2014,6 +2101,10 @@ delete_search_result_set(Slapi_PBlock *pb, back_search_result_set **sr)
         pagedresults_set_search_result_pb(pb, NULL, 0);
         slapi_pblock_set(pb, SLAPI_SEARCH_RESULT_SET, NULL);
     }
+    /* Wait for the prefetch helpers before the candidates go away */
+    ldbm_prefetch_done(*sr);
+    sort_keys_free(&(*sr)->sr_sort_tail);
+    slapi_ch_free((void **)&(*sr)->sr_packed);
     if (NULL != (*sr)->sr_candidates) {
         idl_free(&((*sr)->sr_candidates));
     }
@@ -2049,6 +2140,134 @@ ldbm_back_search_results_release(void **sr)
     delete_search_result_set(NULL, (back_search_result_set **)sr);
 }
 
+/*
+ * The candidates of a paged search are packed while its cursor is parked in
+ * the server wide store (see pagedresults.c).  Only the candidates that are
+ * not returned yet are kept, each one as a varint of the zigzag encoded
+ * difference with the previous one: an ascending list costs about a byte per
+ * id, and a list sorted on an attribute still packs into less than its IDList.
+ * Paged searches read their candidates forward, the ids before sr_current are
+ * not needed anymore.
+ */
+struct _ldbm_packed_candidates
+{
+    NIDS pc_nmax;  /* b_nmax of the candidate list */
+    NIDS pc_nids;  /* b_nids of the candidate list */
+    NIDS pc_first; /* position of the first packed id */
+    size_t pc_len; /* bytes used in pc_data */
+    unsigned char pc_data[1];
+};
+
+#define PACKED_ID_MAXLEN 5 /* bytes of a varint of a 33 bits zigzag delta */
+
+static void
+search_results_pack(back_search_result_set *sr)
+{
+    IDList *idl = sr->sr_candidates;
+    ldbm_packed_candidates *pc;
+    NIDS first;
+    ID prev = 0;
+    size_t len = 0;
+
+    if (sr->sr_packed || NULL == idl || ALLIDS(idl)) {
+        return;
+    }
+    /* the read ahead of the entries is scheduled again after the unpack */
+    ldbm_prefetch_done(sr);
+
+    first = (sr->sr_current < idl->b_nids) ? (NIDS)sr->sr_current : idl->b_nids;
+    pc = (ldbm_packed_candidates *)slapi_ch_malloc(sizeof(ldbm_packed_candidates) +
+                                                   (size_t)(idl->b_nids - first) * PACKED_ID_MAXLEN);
+    for (NIDS i = first; i < idl->b_nids; i++) {
+        int64_t delta = (int64_t)idl->b_ids[i] - (int64_t)prev;
+        uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+
+        do {
+            unsigned char byte = zz & 0x7f;
+            zz >>= 7;
+            pc->pc_data[len++] = zz ? (byte | 0x80) : byte;
+        } while (zz);
+        prev = idl->b_ids[i];
+    }
+    pc = (ldbm_packed_candidates *)slapi_ch_realloc((char *)pc, sizeof(ldbm_packed_candidates) + len);
+    pc->pc_nmax = idl->b_nmax;
+    pc->pc_nids = idl->b_nids;
+    pc->pc_first = first;
+    pc->pc_len = len;
+
+    idl_free(&sr->sr_candidates);
+    sr->sr_packed = pc;
+}
+
+static void
+search_results_unpack(back_search_result_set *sr)
+{
+    ldbm_packed_candidates *pc = sr->sr_packed;
+    IDList *idl;
+    ID prev = 0;
+    size_t pos = 0;
+
+    if (NULL == pc) {
+        return;
+    }
+    /* the ids are kept at their position, sr_current is still valid */
+    idl = idl_alloc(pc->pc_nmax);
+    idl->b_nids = pc->pc_nids;
+    for (NIDS i = pc->pc_first; i < pc->pc_nids && pos < pc->pc_len; i++) {
+        uint64_t zz = 0;
+        int shift = 0;
+        unsigned char byte;
+
+        do {
+            byte = pc->pc_data[pos++];
+            zz |= (uint64_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while ((byte & 0x80) && pos < pc->pc_len);
+        prev = (ID)((int64_t)prev + (int64_t)((zz >> 1) ^ (~(zz & 1) + 1)));
+        idl->b_ids[i] = prev;
+    }
+    sr->sr_candidates = idl;
+    slapi_ch_free((void **)&sr->sr_packed);
+}
+
+static size_t
+search_results_size(back_search_result_set *sr)
+{
+    size_t size = sizeof(back_search_result_set);
+
+    if (sr->sr_packed) {
+        size += sizeof(ldbm_packed_candidates) + sr->sr_packed->pc_len;
+    } else {
+        size += idl_sizeof(sr->sr_candidates);
+    }
+    return size + sort_keys_size(sr->sr_sort_tail);
+}
+
+/*
+ * This function is called from the paged results cursor store: it returns the
+ * memory used by the search result set, once packed or unpacked if requested.
+ */
+size_t
+ldbm_back_search_results_pack(void *search_results, int request)
+{
+    back_search_result_set *sr = (back_search_result_set *)search_results;
+
+    if (NULL == sr) {
+        return 0;
+    }
+    switch (request) {
+    case SLAPI_SEARCH_RESULTS_PACK:
+        search_results_pack(sr);
+        break;
+    case SLAPI_SEARCH_RESULTS_UNPACK:
+        search_results_unpack(sr);
+        break;
+    default:
+        break;
+    }
+    return search_results_size(sr);
+}
+
 int
 ldbm_back_entry_release(Slapi_PBlock *pb, void *backend_info_ptr)
 {
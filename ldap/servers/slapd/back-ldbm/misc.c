@@ -172,6 +172,7 @@ instance_set_busy(ldbm_instance *inst)
 
     inst->inst_flags |= INST_FLAG_BUSY;
     PR_Unlock(inst->inst_config_mutex);
+    dntree_set_enabled(inst->inst_dntree, 0);
     return 0;
 }
 
@@ -185,6 +186,7 @@ instance_set_busy_and_readonly(ldbm_instance *inst)
     }
 
     inst->inst_flags |= INST_FLAG_BUSY;
+    dntree_set_enabled(inst->inst_dntree, 0);
 
     /* save old readonly state */
     if (slapi_be_get_readonly(inst->inst_be)) {
@@ -211,6 +213,8 @@ instance_set_not_busy(ldbm_instance *inst)
 
     PR_Lock(inst->inst_config_mutex);
     inst->inst_flags &= ~INST_FLAG_BUSY;
+    /* the index may have been rebuilt while the instance was busy */
+    dntree_set_enabled(inst->inst_dntree, 1);
     /* set backend readonly flag to match instance flags again
      * (sometimes the instance changes the readonly status when it's busy)
      */
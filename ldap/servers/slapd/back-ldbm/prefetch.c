@@ -0,0 +1,266 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* prefetch.c - read ahead the candidate entries of a search */
+
+/*
+ * While ldbm_back_next_search_entry walks the candidate list one id at a
+ * time, each entry missing from the entry cache costs a synchronous
+ * id2entry read on the worker thread.  When nsslapd-search-prefetch-depth
+ * is not zero, the search hands the next window of candidate ids to a small
+ * pool of helper threads.  The helpers simply call id2entry() and return the
+ * entry to the cache, so that by the time the worker reaches the id the
+ * entry is usually already decoded and cached.
+ *
+ * A window is owned by the search result set.  The worker never refills a
+ * window while a helper is still loading it, and delete_search_result_set
+ * cancels the window and waits for the helper to let go of it before the
+ * result set (and the backend reference) can go away.
+ */
+
+#include "back-ldbm.h"
+
+#define LDBM_PREFETCH_THREADS 2
+
+struct _ldbm_prefetch
+{
+    backend *pf_be;
+    ID *pf_ids;                      /* ids of the window being loaded */
+    size_t pf_size;                  /* allocated size of pf_ids */
+    size_t pf_count;                 /* number of ids in the window */
+    idl_iterator pf_next;            /* next candidate not yet handed to a helper */
+    int32_t pf_busy;                 /* queued or being loaded by a helper */
+    int32_t pf_cancelled;            /* the result set is going away */
+    struct _ldbm_prefetch *pf_qnext; /* work queue link */
+};
+
+static pthread_mutex_t prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prefetch_work_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t prefetch_done_cv = PTHREAD_COND_INITIALIZER;
+static ldbm_prefetch *prefetch_qhead = NULL;
+static ldbm_prefetch *prefetch_qtail = NULL;
+static PRThread *prefetch_threads[LDBM_PREFETCH_THREADS];
+static int prefetch_nthreads = 0;
+static int prefetch_stopping = 0;
+
+static void
+ldbm_prefetch_load(ldbm_prefetch *pf)
+{
+    backend *be = pf->pf_be;
+    ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
+    struct backentry *e;
+    int err = 0;
+
+    for (size_t i = 0; i < pf->pf_count; i++) {
+        if (slapi_atomic_load_32(&pf->pf_cancelled, __ATOMIC_ACQUIRE) ||
+            be->be_state != BE_STATE_STARTED || prefetch_stopping) {
+            break;
+        }
+        /* Already cached: nothing to read */
+        if (cache_has_id(&inst->inst_cache, pf->pf_ids[i])) {
+            continue;
+        }
+        if ((e = id2entry(be, pf->pf_ids[i], NULL, &err)) != NULL) {
+            cache_return_prefetch(&inst->inst_cache, (void **)&e);
+            slapi_atomic_incr_64(&inst->inst_prefetch_loaded, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void
+ldbm_prefetch_thread(void *arg __attribute__((unused)))
+{
+    ldbm_prefetch *pf;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    while (!prefetch_stopping) {
+        if ((pf = prefetch_qhead) == NULL) {
+            pthread_cond_wait(&prefetch_work_cv, &prefetch_mutex);
+            continue;
+        }
+        prefetch_qhead = pf->pf_qnext;
+        if (prefetch_qhead == NULL) {
+            prefetch_qtail = NULL;
+        }
+        pf->pf_qnext = NULL;
+        pthread_mutex_unlock(&prefetch_mutex);
+
+        ldbm_prefetch_load(pf);
+
+        pthread_mutex_lock(&prefetch_mutex);
+        slapi_atomic_store_32(&pf->pf_busy, 0, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&prefetch_done_cv);
+    }
+    /* Release whatever is left so that waiters do not hang */
+    while ((pf = prefetch_qhead) != NULL) {
+        prefetch_qhead = pf->pf_qnext;
+        pf->pf_qnext = NULL;
+        slapi_atomic_store_32(&pf->pf_busy, 0, __ATOMIC_RELEASE);
+    }
+    prefetch_qtail = NULL;
+    pthread_cond_broadcast(&prefetch_done_cv);
+    pthread_mutex_unlock(&prefetch_mutex);
+}
+
+/*
+ * Start the prefetch helpers.  Called once from ldbm_back_start.
+ */
+void
+ldbm_prefetch_start(struct ldbminfo *li __attribute__((unused)))
+{
+    pthread_mutex_lock(&prefetch_mutex);
+    prefetch_stopping = 0;
+    while (prefetch_nthreads < LDBM_PREFETCH_THREADS) {
+        PRThread *thr = PR_CreateThread(PR_USER_THREAD, ldbm_prefetch_thread, NULL,
+                                        PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                        PR_JOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (thr == NULL) {
+            PRErrorCode prerr = PR_GetError();
+            slapi_log_err(SLAPI_LOG_ERR, "ldbm_prefetch_start",
+                          "Unable to spawn search prefetch thread, " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                          prerr, slapd_pr_strerror(prerr));
+            break;
+        }
+        prefetch_threads[prefetch_nthreads++] = thr;
+    }
+    pthread_mutex_unlock(&prefetch_mutex);
+}
+
+/*
+ * Stop the prefetch helpers.  Called from ldbm_back_close before the
+ * databases are closed.
+ */
+void
+ldbm_prefetch_stop(struct ldbminfo *li __attribute__((unused)))
+{
+    int nthreads;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    prefetch_stopping = 1;
+    nthreads = prefetch_nthreads;
+    prefetch_nthreads = 0;
+    pthread_cond_broadcast(&prefetch_work_cv);
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    for (int i = 0; i < nthreads; i++) {
+        PR_JoinThread(prefetch_threads[i]);
+        prefetch_threads[i] = NULL;
+    }
+}
+
+/*
+ * Called by ldbm_back_next_search_entry before it dereferences the next
+ * candidate.  When the helpers are close to falling behind the search,
+ * queue the next window of candidate ids.
+ */
+void
+ldbm_prefetch_schedule(backend *be, struct ldbminfo *li, back_search_result_set *sr)
+{
+    int depth = li->li_search_prefetch_depth;
+    ldbm_prefetch *pf = sr->sr_prefetch;
+    IDList *idl = sr->sr_candidates;
+    idl_iterator it;
+    size_t n = 0;
+
+    if (depth <= 0 || prefetch_nthreads == 0 || idl == NULL || ALLIDS(idl)) {
+        return;
+    }
+    if (pf == NULL) {
+        pf = (ldbm_prefetch *)slapi_ch_calloc(1, sizeof(ldbm_prefetch));
+        pf->pf_be = be;
+        pf->pf_next = sr->sr_current;
+        sr->sr_prefetch = pf;
+    }
+    if (slapi_atomic_load_32(&pf->pf_busy, __ATOMIC_ACQUIRE)) {
+        /* The previous window is still being loaded */
+        return;
+    }
+    if (pf->pf_next < sr->sr_current) {
+        /* The search overtook the helpers */
+        pf->pf_next = sr->sr_current;
+    }
+    if (pf->pf_next - sr->sr_current > (size_t)(depth / 2)) {
+        /* Enough entries are already ahead of the search */
+        return;
+    }
+
+    if (pf->pf_size < (size_t)depth) {
+        pf->pf_ids = (ID *)slapi_ch_realloc((char *)pf->pf_ids, depth * sizeof(ID));
+        pf->pf_size = depth;
+    }
+    it = pf->pf_next;
+    while (n < (size_t)depth) {
+        ID id = idl_iterator_dereference_increment(&it, idl);
+        if (id == NOID) {
+            break;
+        }
+        pf->pf_ids[n++] = id;
+    }
+    if (n == 0) {
+        return;
+    }
+    pf->pf_count = n;
+    pf->pf_next = it;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    if (!prefetch_stopping) {
+        slapi_atomic_store_32(&pf->pf_busy, 1, __ATOMIC_RELEASE);
+        if (prefetch_qtail) {
+            prefetch_qtail->pf_qnext = pf;
+        } else {
+            prefetch_qhead = pf;
+        }
+        prefetch_qtail = pf;
+        pthread_cond_signal(&prefetch_work_cv);
+    }
+    pthread_mutex_unlock(&prefetch_mutex);
+}
+
+/*
+ * Cancel any pending window of the result set and free it.  Waits for a
+ * helper that is currently loading the window.
+ */
+void
+ldbm_prefetch_done(back_search_result_set *sr)
+{
+    ldbm_prefetch *pf = sr->sr_prefetch;
+
+    if (pf == NULL) {
+        return;
+    }
+    slapi_atomic_store_32(&pf->pf_cancelled, 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&prefetch_mutex);
+    if (pf->pf_busy) {
+        /* Still on the queue: unlink it ourselves */
+        ldbm_prefetch **pp = &prefetch_qhead;
+        ldbm_prefetch *prev = NULL;
+        while (*pp && *pp != pf) {
+            prev = *pp;
+            pp = &(*pp)->pf_qnext;
+        }
+        if (*pp) {
+            *pp = pf->pf_qnext;
+            if (prefetch_qtail == pf) {
+                prefetch_qtail = prev;
+            }
+            slapi_atomic_store_32(&pf->pf_busy, 0, __ATOMIC_RELEASE);
+        }
+    }
+    while (pf->pf_busy) {
+        pthread_cond_wait(&prefetch_done_cv, &prefetch_mutex);
+    }
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    slapi_ch_free((void **)&pf->pf_ids);
+    slapi_ch_free((void **)&sr->sr_prefetch);
+}
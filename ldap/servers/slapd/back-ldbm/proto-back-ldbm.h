@@ -48,10 +48,14 @@ void cache_get_stats(struct cache *cache, uint64_t *hits, uint64_t *tries, uint6
 void cache_debug_hash(struct cache *cache, char **out);
 int cache_remove(struct cache *cache, void *e);
 void cache_return(struct cache *cache, void **bep);
+void cache_return_scan(struct cache *cache, void **bep);
+void cache_return_prefetch(struct cache *cache, void **bep);
 void cache_lock(struct cache *cache);
 void cache_unlock(struct cache *cache);
 struct backentry *cache_find_dn(struct cache *cache, const char *dn, unsigned long ndnlen);
 struct backentry *cache_find_id(struct cache *cache, ID id);
+int cache_has_id(struct cache *cache, ID id);
+size_t cache_get_lru_ids(struct cache *cache, ID **ids, size_t max);
 struct backentry *cache_find_uuid(struct cache *cache, const char *uuid);
 int cache_add(struct cache *cache, void *ptr, void **alt);
 int cache_add_tentative(struct cache *cache, struct backentry *e, struct backentry **alt);
@@ -183,6 +187,7 @@ int id2entry_add(backend *be, struct backentry *e, back_txn *txn);
 int id2entry_add_ext(backend *be, struct backentry *e, back_txn *txn, int encrypt, int *cache_res);
 int id2entry_delete(backend *be, struct backentry *e, back_txn *txn);
 struct backentry *id2entry(backend *be, ID id, back_txn *txn, int *err);
+int id2entry_cache_dn(backend *be, ID id);
 
 /*
  * idl.c
@@ -207,6 +212,7 @@ int idl_delete(IDList **idl, ID id);
 IDList *idl_allids(backend *be);
 IDList *idl_fetch(backend *be, dbi_db_t *db, dbi_val_t *key, dbi_txn_t *txn, struct attrinfo *a, int *err);
 IDList *idl_fetch_ext(backend *be, dbi_db_t *db, dbi_val_t *key, dbi_txn_t *txn, struct attrinfo *a, int *err, int allidslimit);
+int idl_estimate(backend *be, dbi_db_t *db, dbi_val_t *key, dbi_txn_t *txn, struct attrinfo *a, int allidslimit, uint64_t *count);
 int idl_insert_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, back_txn *txn, struct attrinfo *a, int *disposition);
 int idl_delete_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, back_txn *txn, struct attrinfo *a);
 IDList *idl_intersection(backend *be, IDList *a, IDList *b);
@@ -255,11 +261,13 @@ int index_add_mods(backend *be, /*const*/ LDAPMod **mods, struct backentry *olde
 int index_addordel_string(backend *be, const char *type, const char *s, ID id, int flags, back_txn *txn);
 int index_addordel_values_sv(backend *be, const char *type, Slapi_Value **vals, Slapi_Value **evals, ID id, int flags, back_txn *txn);
 int index_addordel_values_ext_sv(backend *be, const char *type, Slapi_Value **vals, Slapi_Value **evals, ID id, int flags, back_txn *txn, int *idl_disposition, void *buffer_handle);
+int index_addordel_ainfo_values_sv(backend *be, struct attrinfo *ai, const char *basetype, Slapi_Value **vals, Slapi_Value **evals, ID id, int flags, back_txn *txn, int *idl_disposition, void *buffer_handle);
 int id_array_init(Id_Array *new_guy, int size);
 
 IDList *index_read(backend *be, const char *type, const char *indextype, const struct berval *val, back_txn *txn, int *err);
 IDList *index_read_ext(backend *be, char *type, const char *indextype, const struct berval *val, back_txn *txn, int *err, int *unindexed);
 IDList *index_read_ext_allids(Slapi_PBlock *pb, backend *be, char *type, const char *indextype, const struct berval *val, back_txn *txn, int *err, int *unindexed, int allidslimit);
+int index_estimate(Slapi_PBlock *pb, backend *be, char *type, const char *indextype, const struct berval *val, back_txn *txn, int allidslimit, uint64_t *estimate);
 IDList *index_range_read(Slapi_PBlock *pb, backend *be, char *type, const char *indextype, int ftype, struct berval *val, struct berval *nextval, int range, back_txn *txn, int *err);
 IDList *index_range_read_ext(Slapi_PBlock *pb, backend *be, char *type, const char *indextype, int ftype, struct berval *val, struct berval *nextval, int range, back_txn *txn, int *err, int allidslimit);
 const char *encode(const struct berval *data, char buf[BUFSIZ]);
@@ -269,6 +277,7 @@ extern const char *indextype_PRESENCE;
 extern const char *indextype_EQUALITY;
 extern const char *indextype_APPROX;
 extern const char *indextype_SUB;
+extern const char *indextype_SUBPOS;
 
 int index_buffer_init(size_t size, int flags, void **h);
 int index_buffer_flush(void *h, backend *be, dbi_txn_t *txn, struct attrinfo *a);
@@ -279,6 +288,12 @@ int set_suffix_key(Slapi_Backend *be, struct _back_info_index_key *info);
 char *index_index2prefix(const char *indextype);
 void index_free_prefix(char *);
 
+/*
+ * index_subpos.c
+ */
+void index_subpos_values2keys(Slapi_Attr *sattr, Slapi_Value **vals, Slapi_Value ***ivals);
+IDList *index_subpos_candidates(Slapi_PBlock *pb, backend *be, char *type, char *initial, char **any, char *final, int *err, int allidslimit);
+
 /*
  * instance.c
  */
@@ -410,7 +425,10 @@ typedef struct sort_spec_thing sort_spec_thing;
 typedef struct sort_spec_thing sort_spec;
 
 void sort_spec_free(sort_spec *s);
-int sort_candidates(backend *be, int lookthrough_limit, struct timespec *expire_time, Slapi_PBlock *pb, IDList *candidates, sort_spec_thing *sort_spec, char **sort_error_type);
+int sort_candidates(backend *be, int lookthrough_limit, struct timespec *expire_time, Slapi_PBlock *pb, IDList *candidates, sort_spec_thing *sort_spec, char **sort_error_type, int topk, ldbm_sort_keys **tail);
+void sort_candidates_next(Slapi_PBlock *pb, IDList *candidates, idl_iterator current, ldbm_sort_keys **tail);
+void sort_keys_free(ldbm_sort_keys **sk);
+size_t sort_keys_size(ldbm_sort_keys *sk);
 int make_sort_response_control(Slapi_PBlock *pb, int code, char *error_type);
 int parse_sort_spec(struct berval *sort_spec_ber, sort_spec **ps);
 struct berval *attr_value_lowest(struct berval **values, value_compare_fn_type compare_fn);
@@ -451,6 +469,7 @@ int ldbm_back_upgradedb(Slapi_PBlock *pb);
 int ldbm_back_dbverify(Slapi_PBlock *pb);
 int ldbm_back_next_search_entry(Slapi_PBlock *pb);
 void ldbm_back_search_results_release(void **search_results);
+size_t ldbm_back_search_results_pack(void *search_results, int request);
 int ldbm_back_init(Slapi_PBlock *pb);
 void ldbm_back_prev_search_results(Slapi_PBlock *pb);
 int ldbm_back_isinitialized(void);
@@ -533,6 +552,54 @@ int search_get_tune(struct ldbminfo *li);
 int compute_lookthrough_limit(Slapi_PBlock *pb, struct ldbminfo *li);
 int compute_allids_limit(Slapi_PBlock *pb, struct ldbminfo *li);
 
+/*
+ * prefetch.c
+ */
+void ldbm_prefetch_start(struct ldbminfo *li);
+void ldbm_prefetch_stop(struct ldbminfo *li);
+void ldbm_prefetch_schedule(backend *be, struct ldbminfo *li, back_search_result_set *sr);
+void ldbm_prefetch_done(back_search_result_set *sr);
+
+/*
+ * cache_snapshot.c
+ */
+void ldbm_cache_snapshot_start(struct ldbminfo *li);
+void ldbm_cache_snapshot_stop(struct ldbminfo *li);
+void ldbm_cache_preload_start(ldbm_instance *inst);
+const char *ldbm_cache_preload_status(ldbm_instance *inst);
+
+/*
+ * dntree.c
+ */
+struct dntree *dntree_new(void);
+void dntree_destroy(struct dntree **tree);
+void dntree_set_max_size(struct dntree *tree, uint64_t size);
+uint64_t dntree_get_max_size(struct dntree *tree);
+void dntree_set_enabled(struct dntree *tree, int enabled);
+void dntree_clear(struct dntree *tree);
+void dntree_get_stats(struct dntree *tree, uint64_t *hits, uint64_t *tries, uint64_t *count, uint64_t *size, uint64_t *maxsize, uint64_t *evictions);
+int dntree_dn2id(ldbm_instance *inst, Slapi_RDN *srdn, ID *id);
+int dntree_id2dn(ldbm_instance *inst, ID id, const char *rdn, char **dn, Slapi_RDN **psrdn);
+int dntree_get_parent(ldbm_instance *inst, ID id, char **prdn, ID *pid);
+int dntree_get_subordinates(ldbm_instance *inst, ID id, IDList **subordinates);
+dntree_batch *dntree_batch_new(ldbm_instance *inst);
+void dntree_batch_add(dntree_batch *batch, ID id, ID pid, const char *nrdn, const char *rdn);
+void dntree_batch_children(dntree_batch *batch, ID pid);
+void dntree_batch_apply(dntree_batch *batch);
+void dntree_batch_free(dntree_batch **batch);
+void dntree_invalidate(ldbm_instance *inst, ID id, ID pid);
+void dntree_txn_done(void);
+
+
+/*
+ * export.c
+ */
+export_pipeline *export_pipeline_new(ldbm_instance *inst, int fd, const char *fname, export_format_fn format, export_progress_fn progress, void *arg);
+int export_pipeline_write(export_pipeline *p, const char *str, size_t len);
+int export_pipeline_submit(export_pipeline *p, struct backentry *ep, int percent);
+int export_pipeline_submit_raw(export_pipeline *p, ID id, const char *dn, const char *data, size_t len, int flags, int percent);
+int export_pipeline_is_parallel(export_pipeline *p);
+int export_pipeline_done(export_pipeline **p, int *cnt);
 
 /*
  * matchrule.c
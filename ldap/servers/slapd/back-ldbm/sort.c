@@ -28,7 +28,55 @@ struct baggage_carrier
 };
 typedef struct baggage_carrier baggage_carrier;
 
-static int slapd_qsort(baggage_carrier *bc, IDList *list, sort_spec *s);
+/*
+ * Sort keys of the candidates.
+ *
+ * The keys are computed once per candidate, before any comparison:
+ * sk_keys[level][i] is the key of sk_ids[i] for the level-th attribute of
+ * the sort spec, NULL when the entry has no value for it (it sorts last).
+ * The comparisons then run on the keys only.
+ *
+ * When every attribute of the sort spec is sorted in ascending order and
+ * has an equality index, the keys are read from the index rather than from
+ * the entries.  An index key is only a lower bound of the sort key (the
+ * index also holds the values of the subtypes), so the candidates selected
+ * from index keys are checked against their entries (sk_checked) before
+ * they are returned, and selected again if a key changed.
+ */
+struct _ldbm_sort_keys
+{
+    NIDS sk_nids;                /* number of candidates */
+    ID *sk_ids;                  /* the candidates, in their original order */
+    NIDS *sk_pos;                /* positions in sk_ids, in sort order */
+    NIDS sk_sorted;              /* sk_pos[0 .. sk_sorted) is sorted */
+    NIDS sk_chunk;               /* size of the last sorted part */
+    int sk_nlevels;              /* number of attributes in the sort spec */
+    char **sk_types;             /* attribute of each level */
+    int *sk_order;               /* 0 == ascending, 1 == decending */
+    value_compare_fn_type *sk_cmp;
+    struct berval ***sk_keys;    /* sk_keys[level][position] */
+    unsigned char *sk_checked;   /* NULL if all the keys come from the entries */
+    struct berval **sk_pool;     /* the keys, freed with sk */
+    size_t sk_npool;
+    size_t sk_maxpool;
+};
+
+/* Candidate position of an ID, to match the IDs found in an index */
+typedef struct sort_id_pos
+{
+    ID id;
+    NIDS pos;
+} sort_id_pos;
+
+/* Read the keys from the index only if the candidates are a good part of the
+ * backend: the whole equality index of the attribute is read */
+#define SORT_INDEX_RATIO 16
+
+static int sort_check(baggage_carrier *bc);
+static ldbm_sort_keys *sort_keys_new(IDList *candidates, sort_spec_thing *s);
+static int sort_keys_build(baggage_carrier *bc, ldbm_sort_keys *sk, sort_spec_thing *s);
+static int sort_keys_step(baggage_carrier *bc, ldbm_sort_keys *sk, NIDS k);
+static void sort_keys_apply(ldbm_sort_keys *sk, IDList *candidates);
 static int print_out_sort_spec(char *buffer, sort_spec *s, int *size);
 
 static void
@@ -136,7 +184,11 @@ sort_log_access(Slapi_PBlock *pb, sort_spec_thing *s, IDList *candidates)
  */
 /*
  * So here's the plan:
- * Plan A:  We do a regular quicksort on the entries.
+ * Plan A:  We compute the sort keys of the candidates once, then
+ *            select and sort the first topk of them.  When topk is
+ *            smaller than the candidate list, the rest is left in *tail
+ *            and sorted by sort_candidates_next() if the search gets
+ *            that far.  topk == 0 sorts the whole list.
  * Plan B:  Through some hint given us from on high, we
  *            determine that the entries are _already_
  *            sorted as requested, thus we do nothing !
@@ -144,11 +196,13 @@ sort_log_access(Slapi_PBlock *pb, sort_spec_thing *s, IDList *candidates)
  *            far too hard for us to even try, so we refuse.
  */
 int
-sort_candidates(backend *be, int lookthrough_limit, struct timespec *expire_time, Slapi_PBlock *pb, IDList *candidates, sort_spec_thing *s, char **sort_error_type)
+sort_candidates(backend *be, int lookthrough_limit, struct timespec *expire_time, Slapi_PBlock *pb, IDList *candidates, sort_spec_thing *s, char **sort_error_type, int topk, ldbm_sort_keys **tail)
 {
     int return_value = LDAP_SUCCESS;
     baggage_carrier bc = {0};
     sort_spec_thing *this_s = NULL;
+    ldbm_sort_keys *sk = NULL;
+    NIDS k;
 
     /* We refuse to sort a non-existent IDlist */
     if (NULL == candidates) {
@@ -188,19 +242,81 @@ sort_candidates(backend *be, int lookthrough_limit, struct timespec *expire_time
         }
     }
 
+    if (candidates->b_nids < 2) {
+        return LDAP_SUCCESS; /* nothing to do */
+    }
+    /* Fix for bugid #394184, SD, 20 Jul 00 */
+    if (lookthrough_limit != -1 && (lookthrough_limit <= (int)candidates->b_nids)) {
+        return LDAP_ADMINLIMIT_EXCEEDED;
+    }
+    /* end Fix for bugid #394184 */
+
     bc.be = be;
     bc.pb = pb;
     bc.expire_time = expire_time;
     bc.lookthrough_limit = lookthrough_limit;
     bc.check_counter = 1;
 
-    return_value = slapd_qsort(&bc, candidates, s);
+    sk = sort_keys_new(candidates, s);
+    return_value = sort_keys_build(&bc, sk, s);
+    if (LDAP_SUCCESS == return_value) {
+        k = (topk > 0 && (NIDS)topk < sk->sk_nids) ? (NIDS)topk : sk->sk_nids;
+        return_value = sort_keys_step(&bc, sk, k);
+        sort_keys_apply(sk, candidates);
+    }
+    if (LDAP_SUCCESS == return_value && sk->sk_sorted < sk->sk_nids && tail) {
+        slapi_log_err(SLAPI_LOG_TRACE, "sort_candidates", "Sorted %lu of %lu candidates\n",
+                      (u_long)sk->sk_sorted, (u_long)sk->sk_nids);
+        *tail = sk;
+    } else {
+        sort_keys_free(&sk);
+    }
     slapi_log_err(SLAPI_LOG_TRACE, "Sorting done", "<=\n");
 
     return return_value;
 }
 /* End  fix for bug # 394184 */
 
+/*
+ * Sort the next part of the candidates left unsorted by sort_candidates(),
+ * once the search has returned all the sorted ones.  Each step sorts twice
+ * as many candidates as the previous one.
+ */
+void
+sort_candidates_next(Slapi_PBlock *pb, IDList *candidates, idl_iterator current, ldbm_sort_keys **tail)
+{
+    ldbm_sort_keys *sk = *tail;
+    struct timespec no_expire = {0};
+    baggage_carrier bc = {0};
+    NIDS k;
+    int rc;
+
+    if (NULL == sk || (NIDS)current < sk->sk_sorted) {
+        return;
+    }
+    slapi_pblock_get(pb, SLAPI_BACKEND, &bc.be);
+    bc.pb = pb;
+    bc.expire_time = &no_expire;
+    bc.lookthrough_limit = -1;
+    bc.check_counter = 1;
+
+    k = sk->sk_chunk * 2;
+    if (k > sk->sk_nids - sk->sk_sorted) {
+        k = sk->sk_nids - sk->sk_sorted;
+    }
+    rc = sort_keys_step(&bc, sk, k);
+    sort_keys_apply(sk, candidates);
+    sk->sk_chunk = k;
+    if (LDAP_SUCCESS != rc) {
+        /* the rest of the candidates is returned as is */
+        slapi_log_err(SLAPI_LOG_TRACE, "sort_candidates_next",
+                      "Failed to sort the remaining candidates (%d)\n", rc);
+        sort_keys_free(tail);
+    } else if (sk->sk_sorted == sk->sk_nids) {
+        sort_keys_free(tail);
+    }
+}
+
 static int
 term_tag(ber_tag_t tag)
 {
@@ -439,147 +555,6 @@ sort_attr_compare(struct berval **value_a, struct berval **value_b, value_compar
     return compare_fn(compare_value_a, compare_value_b);
 }
 
-/* Comparison routine, called by qsort.
- * The job here is to return the correct value
- * for the operation a < b
- * Returns:
- * <0 when  a < b
- * 0  when a == b
- * >0 when a > b
- */
-static int
-compare_entries_sv(ID *id_a, ID *id_b, sort_spec *s, baggage_carrier *bc, int *error)
-{
-    /* We get passed the IDs, but need to fetch the entries in order to
-     * perform the comparison .
-     */
-    struct backentry *a = NULL;
-    struct backentry *b = NULL;
-    int result = 0;
-    sort_spec_thing *this_one = NULL;
-    backend *be = bc->be;
-    ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
-    int err;
-    back_txn txn = {NULL};
-
-    slapi_pblock_get(bc->pb, SLAPI_TXN, &txn.back_txn_txn);
-    *error = 1;
-    a = id2entry(be, *id_a, &txn, &err);
-    if (NULL == a) {
-        if (0 != err) {
-            slapi_log_err(SLAPI_LOG_TRACE, "compare_entries_sv", "db err %d\n", err);
-        }
-        /* Were up a creek without paddle here */
-        /* Best to log error and set some flag */
-        return 0;
-    }
-    b = id2entry(be, *id_b, &txn, &err);
-    if (NULL == b) {
-        if (0 != err) {
-            slapi_log_err(SLAPI_LOG_TRACE, "compare_entries_sv", "db err %d\n", err);
-        }
-        CACHE_RETURN(&inst->inst_cache, &a);
-        return 0;
-    }
-    /* OK, now we have the entries, so we work our way down the attribute list comparing as we go */
-    for (this_one = (sort_spec_thing *)s; this_one; this_one = this_one->next) {
-
-        char *type = this_one->type;
-        int order = this_one->order;
-        Slapi_Attr *attr_a = NULL;
-        Slapi_Attr *attr_b = NULL;
-        struct berval **value_a = NULL;
-        struct berval **value_b = NULL;
-
-        /* Get the two attribute values from the entries */
-        slapi_entry_attr_find(a->ep_entry, type, &attr_a);
-        slapi_entry_attr_find(b->ep_entry, type, &attr_b);
-        /* What do we do if one or more of the entries lacks this attribute ? */
-        /* if one lacks the attribute */
-        if (NULL == attr_a) {
-            /* then if the other does too, they're equal */
-            if (NULL == attr_b) {
-                result = 0;
-                continue;
-            } else {
-                /* If one has the attribute, and the other
-                 * doesn't, the missing attribute is the
-                 * LARGER one.  (bug #108154)  -robey
-                 */
-                result = 1;
-                break;
-            }
-        }
-        if (NULL == attr_b) {
-            result = -1;
-            break;
-        }
-        /* Somewhere in here, we need to go sideways for match rule case
-         * we need to call the match rule plugin to get the attribute values
-         * converted into ordering keys. Then we proceed as usual to use those,
-         * but ensuring that we don't leak memory anywhere. This works as follows:
-         * the code assumes that the attrs are references into the entry, so
-         * doesn't try to free them. We need to note at the right place that
-         * we're on the matchrule path, and accordingly free the keys---this turns out
-         * to be when we free the indexer */
-        if (NULL == this_one->matchrule) {
-            /* Non-match rule case */
-            valuearray_get_bervalarray(valueset_get_valuearray(&attr_a->a_present_values), &value_a);
-            valuearray_get_bervalarray(valueset_get_valuearray(&attr_b->a_present_values), &value_b);
-        } else {
-            /* Match rule case */
-            struct berval **actual_value_a = NULL;
-            struct berval **actual_value_b = NULL;
-            struct berval **temp_value = NULL;
-
-            valuearray_get_bervalarray(valueset_get_valuearray(&attr_a->a_present_values), &actual_value_a);
-            valuearray_get_bervalarray(valueset_get_valuearray(&attr_b->a_present_values), &actual_value_b);
-            matchrule_values_to_keys(this_one->mr_pb, actual_value_a, &temp_value);
-            /* Now copy it, so the second call doesn't crap on it */
-            value_a = slapi_ch_bvecdup(temp_value); /* Really, we'd prefer to not call the chXXX variant...*/
-            matchrule_values_to_keys(this_one->mr_pb, actual_value_b, &value_b);
-
-            if ((actual_value_a && !value_a) ||
-                (actual_value_b && !value_b)) {
-                ber_bvecfree(actual_value_a);
-                ber_bvecfree(actual_value_b);
-                CACHE_RETURN(&inst->inst_cache, &a);
-                CACHE_RETURN(&inst->inst_cache, &b);
-                *error = 1;
-                return 0;
-            }
-            if (actual_value_a)
-                ber_bvecfree(actual_value_a);
-            if (actual_value_b)
-                ber_bvecfree(actual_value_b);
-        }
-        /* Compare them */
-        if (!order) {
-            result = sort_attr_compare(value_a, value_b, this_one->compare_fn);
-        } else {
-            /* If reverse, invert the sense of the comparison */
-            result = sort_attr_compare(value_b, value_a, this_one->compare_fn);
-        }
-        /* Time to free up the attributes allocated above */
-        if (NULL != this_one->matchrule) {
-            ber_bvecfree(value_a);
-        } else {
-            ber_bvecfree(value_a);
-            ber_bvecfree(value_b);
-        }
-        /* Are they equal ? */
-        if (0 != result) {
-            /* If not, we're done */
-            break;
-        }
-        /* If so, proceed to the next attribute for comparison */
-    }
-    CACHE_RETURN(&inst->inst_cache, &a);
-    CACHE_RETURN(&inst->inst_cache, &b);
-    *error = 0;
-    return result;
-}
-
 /* Fix for bug # 394184, SD, 20 Jul 00 */
 /* replace the hard coded return value by the appropriate LDAP error code */
 /*
@@ -611,9 +586,9 @@ sort_check(baggage_carrier *bc)
 
         /* Fix for bugid #394184, SD, 05 Jul 00 */
         /*  not sure this is the appropriate place to do this;
-           since the entries are swaped in slapd_qsort, some of them are most
+           since the entries are compared many times, some of them are most
            probably counted more than once */
-        /* hence commenting out the following test and moving it into slapd_qsort */
+        /* hence commenting out the following test and moving it into sort_candidates */
         /* check lookthrough limit */
         /* if ( bc->lookthrough_limit != -1 && (bc->lookthrough_limit -= CHECK_INTERVAL) < 0 ) {
            return LDAP_ADMINLIMIT_EXCEEDED;
@@ -624,241 +599,537 @@ sort_check(baggage_carrier *bc)
 }
 /* End fix for bug # 394184 */
 
-/* prototypes for local routines */
-static void shortsort(baggage_carrier *bc, ID *lo, ID *hi, sort_spec *s);
-static void swap(ID *a, ID *b);
+static int
+sort_id_pos_cmp(const void *a, const void *b)
+{
+    ID ida = ((const sort_id_pos *)a)->id;
+    ID idb = ((const sort_id_pos *)b)->id;
+
+    return (ida > idb) - (ida < idb);
+}
+
+static ldbm_sort_keys *
+sort_keys_new(IDList *candidates, sort_spec_thing *s)
+{
+    ldbm_sort_keys *sk = (ldbm_sort_keys *)slapi_ch_calloc(1, sizeof(ldbm_sort_keys));
+    sort_spec_thing *this_s;
+    int level = 0;
+
+    for (this_s = s; this_s; this_s = this_s->next) {
+        sk->sk_nlevels++;
+    }
+    sk->sk_nids = candidates->b_nids;
+    sk->sk_ids = (ID *)slapi_ch_malloc(sk->sk_nids * sizeof(ID));
+    memcpy(sk->sk_ids, candidates->b_ids, sk->sk_nids * sizeof(ID));
+    sk->sk_pos = (NIDS *)slapi_ch_malloc(sk->sk_nids * sizeof(NIDS));
+    for (NIDS i = 0; i < sk->sk_nids; i++) {
+        sk->sk_pos[i] = i;
+    }
+    sk->sk_types = (char **)slapi_ch_calloc(sk->sk_nlevels, sizeof(char *));
+    sk->sk_order = (int *)slapi_ch_calloc(sk->sk_nlevels, sizeof(int));
+    sk->sk_cmp = (value_compare_fn_type *)slapi_ch_calloc(sk->sk_nlevels, sizeof(value_compare_fn_type));
+    sk->sk_keys = (struct berval ***)slapi_ch_calloc(sk->sk_nlevels, sizeof(struct berval **));
+    for (this_s = s; this_s; this_s = this_s->next, level++) {
+        sk->sk_types[level] = slapi_ch_strdup(this_s->type);
+        sk->sk_order[level] = this_s->order;
+        sk->sk_cmp[level] = this_s->compare_fn;
+        sk->sk_keys[level] = (struct berval **)slapi_ch_calloc(sk->sk_nids, sizeof(struct berval *));
+    }
+    return sk;
+}
 
-/* this parameter defines the cutoff between using quick sort and
-   insertion sort for arrays; arrays with lengths shorter or equal to the
-   below value use insertion sort */
+void
+sort_keys_free(ldbm_sort_keys **psk)
+{
+    ldbm_sort_keys *sk = *psk;
 
-#define CUTOFF 8 /* testing shows that this is good value */
+    if (NULL == sk) {
+        return;
+    }
+    for (int level = 0; level < sk->sk_nlevels; level++) {
+        slapi_ch_free_string(&sk->sk_types[level]);
+        slapi_ch_free((void **)&sk->sk_keys[level]);
+    }
+    for (size_t i = 0; i < sk->sk_npool; i++) {
+        ber_bvfree(sk->sk_pool[i]);
+    }
+    slapi_ch_free((void **)&sk->sk_pool);
+    slapi_ch_free((void **)&sk->sk_types);
+    slapi_ch_free((void **)&sk->sk_order);
+    slapi_ch_free((void **)&sk->sk_cmp);
+    slapi_ch_free((void **)&sk->sk_keys);
+    slapi_ch_free((void **)&sk->sk_checked);
+    slapi_ch_free((void **)&sk->sk_ids);
+    slapi_ch_free((void **)&sk->sk_pos);
+    slapi_ch_free((void **)psk);
+}
 
+/* Approximate memory held by the keys, for the paged results cursor store */
+size_t
+sort_keys_size(ldbm_sort_keys *sk)
+{
+    size_t size;
+
+    if (NULL == sk) {
+        return 0;
+    }
+    size = sizeof(ldbm_sort_keys);
+    size += (size_t)sk->sk_nids * (sizeof(ID) + sizeof(NIDS) + 1);
+    size += (size_t)sk->sk_nlevels * sk->sk_nids * sizeof(struct berval *);
+    for (size_t i = 0; i < sk->sk_npool; i++) {
+        if (sk->sk_pool[i]) {
+            size += sizeof(struct berval) + sk->sk_pool[i]->bv_len;
+        }
+    }
+    return size;
+}
+
+/* Keep a key until sk is freed */
+static struct berval *
+sort_keys_keep(ldbm_sort_keys *sk, struct berval *key)
+{
+    if (sk->sk_npool == sk->sk_maxpool) {
+        sk->sk_maxpool = sk->sk_maxpool ? sk->sk_maxpool * 2 : 64;
+        sk->sk_pool = (struct berval **)slapi_ch_realloc((char *)sk->sk_pool,
+                                                         sk->sk_maxpool * sizeof(struct berval *));
+    }
+    sk->sk_pool[sk->sk_npool++] = key;
+    return key;
+}
+
+/* Sort key of an entry for one level: its lowest value (per X.511 edict) */
+static int
+sort_keys_from_entry(ldbm_sort_keys *sk, int level, Slapi_PBlock *mr_pb, Slapi_Entry *e, struct berval **key)
+{
+    Slapi_Attr *attr = NULL;
+    struct berval **values = NULL;
+    struct berval **mr_keys = NULL;
+    struct berval *lowest = NULL;
+
+    *key = NULL;
+    slapi_entry_attr_find(e, sk->sk_types[level], &attr);
+    if (NULL == attr) {
+        /* the missing attribute is the LARGER one (bug #108154) */
+        return LDAP_SUCCESS;
+    }
+    valuearray_get_bervalarray(valueset_get_valuearray(&attr->a_present_values), &values);
+    if (NULL == values) {
+        return LDAP_SUCCESS;
+    }
+    if (NULL != mr_pb) {
+        /* The keys belong to the indexer, they are copied below */
+        matchrule_values_to_keys(mr_pb, values, &mr_keys);
+        if (NULL == mr_keys) {
+            ber_bvecfree(values);
+            return LDAP_OPERATIONS_ERROR;
+        }
+        lowest = attr_value_lowest(mr_keys, sk->sk_cmp[level]);
+    } else {
+        lowest = attr_value_lowest(values, sk->sk_cmp[level]);
+    }
+    if (lowest) {
+        *key = sort_keys_keep(sk, ber_bvdup(lowest));
+    }
+    ber_bvecfree(values);
+    return LDAP_SUCCESS;
+}
 
-/* Fix for bug # 394184, SD, 20 Jul 00 */
-/* replace the hard coded return value by the appropriate LDAP error code */
-/* Our qsort needs to police the client timeout and lookthrough limit ?
- * It knows how to compare entries, so we don't bother with all the void * stuff.
- */
 /*
- * Returns:
- *  0: Everything OK         now is: LDAP_SUCCESS (fix for bug #394184)
- * -1: A protocol error      now is: LDAP_PROTOCOL_ERROR
- * -2: Too hard              now is: LDAP_UNWILLING_TO_PERFORM
- * -3: Operation error       now is: LDAP_OPERATIONS_ERROR
- * -4: Timeout               now is: LDAP_TIMELIMIT_EXCEEDED
- * -5: Admin limit exceeded  now is: LDAP_ADMINLIMIT_EXCEEDED
- * -6: Abandoned             now is: LDAP_OTHER
+ * Compute the keys of the candidate at position pos from its entry.  s is
+ * NULL once the search spec is gone: the matching rule levels are never
+ * recomputed.  *changed tells whether a key differs from the previous one.
  */
 static int
-slapd_qsort(baggage_carrier *bc, IDList *list, sort_spec *s)
+sort_keys_load(baggage_carrier *bc, ldbm_sort_keys *sk, sort_spec_thing *s, NIDS pos, int *changed)
 {
-    ID *lo, *hi;       /* ends of sub-array currently sorting */
-    ID *mid;           /* points to middle of subarray */
-    ID *loguy, *higuy; /* traveling pointers for partition step */
-    NIDS size;         /* size of the sub-array */
-    ID *lostk[30], *histk[30];
-    int stkptr; /* stack for saving sub-array to be processed */
-    NIDS num = list->b_nids;
+    ldbm_instance *inst = (ldbm_instance *)bc->be->be_instance_info;
+    back_txn txn = {NULL};
+    struct backentry *e = NULL;
     int return_value = LDAP_SUCCESS;
-    int error = 0;
+    int err = 0;
 
-    /* Note: the number of stack entries required is no more than
-       1 + log2(size), so 30 is sufficient for any array */
-    if (num < 2)
-        return LDAP_SUCCESS; /* nothing to do */
+    slapi_pblock_get(bc->pb, SLAPI_TXN, &txn.back_txn_txn);
+    e = id2entry(bc->be, sk->sk_ids[pos], &txn, &err);
+    if (NULL == e) {
+        if (0 != err) {
+            slapi_log_err(SLAPI_LOG_TRACE, "sort_keys_load", "db err %d\n", err);
+            return LDAP_OPERATIONS_ERROR;
+        }
+        /* The entry is gone, it sorts last and will not be returned */
+        for (int level = 0; level < sk->sk_nlevels; level++) {
+            *changed |= (NULL != sk->sk_keys[level][pos]);
+            sk->sk_keys[level][pos] = NULL;
+        }
+        return LDAP_SUCCESS;
+    }
+    for (int level = 0; level < sk->sk_nlevels; level++, s = s ? s->next : NULL) {
+        struct berval *old = sk->sk_keys[level][pos];
+        struct berval *key = NULL;
 
-    stkptr = 0; /* initialize stack */
+        return_value = sort_keys_from_entry(sk, level, s ? s->mr_pb : NULL, e->ep_entry, &key);
+        if (LDAP_SUCCESS != return_value) {
+            break;
+        }
+        if ((NULL == old) != (NULL == key) ||
+            (key && sk->sk_cmp[level](old, key) != 0)) {
+            *changed = 1;
+        }
+        sk->sk_keys[level][pos] = key;
+    }
+    CACHE_RETURN(&inst->inst_cache, &e);
+    return return_value;
+}
 
-    lo = &(list->b_ids[0]);
-    hi = &(list->b_ids[num - 1]); /* initialize limits */
+/*
+ * Can the keys be read from the equality indexes ?  Every level must be in
+ * ascending order (an index key is a lower bound) and use the syntax
+ * ordering of an attribute with an equality index.
+ */
+static int
+sort_keys_use_index(backend *be, ldbm_sort_keys *sk, sort_spec_thing *s)
+{
+    sort_spec_thing *this_s;
 
-    /* Fix for bugid #394184, SD, 20 Jul 00 */
-    if (bc->lookthrough_limit != -1 && (bc->lookthrough_limit <= (int)list->b_nids)) {
-        return LDAP_ADMINLIMIT_EXCEEDED;
+    if (!idl_get_idl_new() || (ID)sk->sk_nids * SORT_INDEX_RATIO < next_id_get(be)) {
+        return 0;
     }
-/* end Fix for bugid #394184 */
+    for (this_s = s; this_s; this_s = this_s->next) {
+        struct attrinfo *ai = NULL;
 
-/* this entry point is for pseudo-recursion calling: setting
-       lo and hi and jumping to here is like recursion, but stkptr is
-       prserved, locals aren't, so we preserve stuff on the stack */
-recurse:
+        if (this_s->order || this_s->matchrule || this_s->sattr.a_mr_ord_plugin ||
+            strchr(this_s->type, ';')) {
+            return 0;
+        }
+        ainfo_get(be, this_s->type, &ai);
+        if (NULL == ai || !(ai->ai_indexmask & INDEX_EQUALITY) ||
+            (ai->ai_indexmask & INDEX_OFFLINE) || ai->ai_attrcrypt || ai->ai_index_rules || ai->ai_key_cmp_fn ||
+            0 == strcasecmp(ai->ai_type, LDBM_PSEUDO_ATTR_DEFAULT)) {
+            return 0;
+        }
+    }
+    return 1;
+}
 
-    size = (hi - lo) + 1; /* number of el's to sort */
+/*
+ * Read the keys of one level from the equality index: for each candidate,
+ * the lowest equality key holding its id.  The candidates having a hashed
+ * key (too long to be stored as is) are flagged in need_entry.
+ * *usable is cleared if the index cannot be used.
+ */
+static int
+sort_keys_from_index(baggage_carrier *bc, ldbm_sort_keys *sk, int level, sort_id_pos *byid, unsigned char *need_entry, int *usable)
+{
+    backend *be = bc->be;
+    struct ldbminfo *li = (struct ldbminfo *)be->be_database->plg_private;
+    value_compare_fn_type cmp = sk->sk_cmp[level];
+    struct berval **keys = sk->sk_keys[level];
+    struct attrinfo *ai = NULL;
+    dbi_db_t *db = NULL;
+    dbi_cursor_t dbc = {0};
+    dbi_val_t key = {0};
+    dbi_val_t data = {0};
+    back_txn txn = {NULL};
+    struct berval *cur = NULL; /* the current index key */
+    int cur_kept = 0;
+    int return_value = LDAP_SUCCESS;
+    int rc;
 
-    /* below a certain size, it is faster to use a O(n^2) sorting method */
-    if (size <= CUTOFF) {
-        shortsort(bc, lo, hi, s);
-    } else {
-        /* First we pick a partititioning element.  The efficiency of the
-           algorithm demands that we find one that is approximately the
-           median of the values, but also that we select one fast.  Using
-           the first one produces bad performace if the array is already
-           sorted, so we use the middle one, which would require a very
-           wierdly arranged array for worst case performance.  Testing shows
-           that a median-of-three algorithm does not, in general, increase
-           performance. */
-
-        mid = lo + (size / 2); /* find middle element */
-        swap(mid, lo);         /* swap it to beginning of array */
-
-        /* We now wish to partition the array into three pieces, one
-           consisiting of elements <= partition element, one of elements
-           equal to the parition element, and one of element >= to it.  This
-           is done below; comments indicate conditions established at every
-           step. */
-
-        loguy = lo;
-        higuy = hi + 1;
-
-        /* Note that higuy decreases and loguy increases on every iteration,
-           so loop must terminate. */
-        for (;;) {
-            /* lo <= loguy < hi, lo < higuy <= hi + 1,
-               A[i] <= A[lo] for lo <= i <= loguy,
-               A[i] >= A[lo] for higuy <= i <= hi */
-
-            do {
-                if (error)
-                    return LDAP_OPERATIONS_ERROR;
-                loguy++;
-            } while (loguy <= hi && compare_entries_sv(loguy, lo, s, bc, &error) <= 0);
-
-            /* lo < loguy <= hi+1, A[i] <= A[lo] for lo <= i < loguy,
-               either loguy > hi or A[loguy] > A[lo] */
-
-            do {
-                if (error)
-                    return LDAP_OPERATIONS_ERROR;
-                higuy--;
-            } while (higuy > lo && compare_entries_sv(higuy, lo, s, bc, &error) >= 0);
-
-            /* lo-1 <= higuy <= hi, A[i] >= A[lo] for higuy < i <= hi,
-               either higuy <= lo or A[higuy] < A[lo] */
-
-            if (higuy < loguy)
-                break;
+    ainfo_get(be, sk->sk_types[level], &ai);
+    if (dblayer_get_index_file(be, ai, &db, 0) != 0) {
+        *usable = 0;
+        return LDAP_SUCCESS;
+    }
+    slapi_pblock_get(bc->pb, SLAPI_TXN, &txn.back_txn_txn);
+    if (dblayer_new_cursor(be, db, txn.back_txn_txn, &dbc) != 0) {
+        dblayer_release_index_file(be, ai, db);
+        *usable = 0;
+        return LDAP_SUCCESS;
+    }
 
-            /* if loguy > hi or higuy <= lo, then we would have exited, so
-               A[loguy] > A[lo], A[higuy] < A[lo],
-               loguy < hi, highy > lo */
+    dblayer_value_strdup(be, &key, "=");
+    dblayer_value_init(be, &data);
+    rc = dblayer_cursor_op(&dbc, DBI_OP_MOVE_NEAR_KEY, &key, &data);
+    while (0 == rc && key.size > 1 && *(char *)key.data == EQ_PREFIX) {
+        ber_len_t len = key.size - 1;
+        sort_id_pos *found;
+        ID id;
 
-            swap(loguy, higuy);
+        if (((char *)key.data)[key.size - 1] == '\0') {
+            len--;
+        }
+        if (NULL == cur || cur->bv_len != len || memcmp(cur->bv_val, (char *)key.data + 1, len)) {
+            struct berval bv = {len, (char *)key.data + 1};
 
-            /* Check admin and time limits here on the sort */
-            if (LDAP_SUCCESS != (return_value = sort_check(bc))) {
-                return return_value;
+            if (!cur_kept) {
+                ber_bvfree(cur);
             }
-
-            /* A[loguy] < A[lo], A[higuy] > A[lo]; so condition at top
-               of loop is re-established */
+            cur = ber_bvdup(&bv);
+            cur_kept = 0;
         }
+        if (data.size != sizeof(ID)) {
+            *usable = 0;
+            break;
+        }
+        memcpy(&id, data.data, sizeof(ID));
+        if (ALLID == id) {
+            /* the ids of this key are not stored */
+            *usable = 0;
+            break;
+        }
+        found = (sort_id_pos *)bsearch(&id, byid, sk->sk_nids, sizeof(sort_id_pos), sort_id_pos_cmp);
+        if (found && (NULL == keys[found->pos] || cmp(cur, keys[found->pos]) < 0)) {
+            if (!cur_kept) {
+                sort_keys_keep(sk, cur);
+                cur_kept = 1;
+            }
+            keys[found->pos] = cur;
+        }
+        if (LDAP_SUCCESS != (return_value = sort_check(bc))) {
+            break;
+        }
+        rc = dblayer_cursor_op(&dbc, DBI_OP_NEXT, &key, &data);
+    }
+    if (!cur_kept) {
+        ber_bvfree(cur);
+    }
+    if (0 != rc && DBI_RC_NOTFOUND != rc) {
+        *usable = 0;
+    }
 
-        /*     A[i] >= A[lo] for higuy < i <= hi,
-               A[i] <= A[lo] for lo <= i < loguy,
-               higuy < loguy, lo <= higuy <= hi
-           implying:
-               A[i] >= A[lo] for loguy <= i <= hi,
-               A[i] <= A[lo] for lo <= i <= higuy,
-               A[i] = A[lo] for higuy < i < loguy */
-
-        swap(lo, higuy); /* put partition element in place */
-
-        /* OK, now we have the following:
-              A[i] >= A[higuy] for loguy <= i <= hi,
-              A[i] <= A[higuy] for lo <= i < higuy
-              A[i] = A[lo] for higuy <= i < loguy    */
+    /* The values too long for the index are stored as hashes */
+    if (*usable && LDAP_SUCCESS == return_value && li->li_max_key_len < UINT_MAX) {
+        char hkeybuf[3] = {HASH_PREFIX, EQ_PREFIX, 0};
+
+        dblayer_value_free(be, &key);
+        dblayer_value_strdup(be, &key, hkeybuf);
+        rc = dblayer_cursor_op(&dbc, DBI_OP_MOVE_NEAR_KEY, &key, &data);
+        while (0 == rc && key.size >= 2 && strncmp(key.data, hkeybuf, 2) == 0) {
+            sort_id_pos *found;
+            ID id;
+
+            if (data.size == sizeof(ID)) {
+                memcpy(&id, data.data, sizeof(ID));
+                found = (sort_id_pos *)bsearch(&id, byid, sk->sk_nids, sizeof(sort_id_pos), sort_id_pos_cmp);
+                if (found) {
+                    need_entry[found->pos] = 1;
+                }
+            }
+            rc = dblayer_cursor_op(&dbc, DBI_OP_NEXT, &key, &data);
+        }
+        if (0 != rc && DBI_RC_NOTFOUND != rc) {
+            *usable = 0;
+        }
+    }
+    dblayer_value_free(be, &key);
+    dblayer_value_free(be, &data);
+    dblayer_cursor_op(&dbc, DBI_OP_CLOSE, NULL, NULL);
+    dblayer_release_index_file(be, ai, db);
+    return return_value;
+}
 
-        /* We've finished the partition, now we want to sort the subarrays
-           [lo, higuy-1] and [loguy, hi].
-           We do the smaller one first to minimize stack usage.
-           We only sort arrays of length 2 or more.*/
+/* Compute the keys of all the candidates */
+static int
+sort_keys_build(baggage_carrier *bc, ldbm_sort_keys *sk, sort_spec_thing *s)
+{
+    unsigned char *need_entry = NULL;
+    int usable = 0;
+    int return_value = LDAP_SUCCESS;
 
-        if (higuy - 1 - lo >= hi - loguy) {
-            if (lo + 1 < higuy) {
-                lostk[stkptr] = lo;
-                histk[stkptr] = higuy - 1;
-                ++stkptr;
-            } /* save big recursion for later */
+    if (sort_keys_use_index(bc->be, sk, s)) {
+        sort_id_pos *byid = (sort_id_pos *)slapi_ch_malloc(sk->sk_nids * sizeof(sort_id_pos));
 
-            if (loguy < hi) {
-                lo = loguy;
-                goto recurse; /* do small recursion */
+        for (NIDS i = 0; i < sk->sk_nids; i++) {
+            byid[i].id = sk->sk_ids[i];
+            byid[i].pos = i;
+        }
+        qsort(byid, sk->sk_nids, sizeof(sort_id_pos), sort_id_pos_cmp);
+        need_entry = (unsigned char *)slapi_ch_calloc(sk->sk_nids, sizeof(unsigned char));
+        usable = 1;
+        for (int level = 0; usable && level < sk->sk_nlevels; level++) {
+            return_value = sort_keys_from_index(bc, sk, level, byid, need_entry, &usable);
+            if (LDAP_SUCCESS != return_value) {
+                break;
             }
-        } else {
-            if (loguy < hi) {
-                lostk[stkptr] = loguy;
-                histk[stkptr] = hi;
-                ++stkptr; /* save big recursion for later */
+        }
+        slapi_ch_free((void **)&byid);
+        if (LDAP_SUCCESS != return_value) {
+            slapi_ch_free((void **)&need_entry);
+            return return_value;
+        }
+        if (usable) {
+            /* A candidate missing from an index has no value or a hashed
+             * one, its keys come from its entry */
+            for (NIDS i = 0; i < sk->sk_nids; i++) {
+                for (int level = 0; level < sk->sk_nlevels; level++) {
+                    if (NULL == sk->sk_keys[level][i]) {
+                        need_entry[i] = 1;
+                    }
+                }
             }
-
-            if (lo + 1 < higuy) {
-                hi = higuy - 1;
-                goto recurse; /* do small recursion */
+            sk->sk_checked = (unsigned char *)slapi_ch_calloc(sk->sk_nids, sizeof(unsigned char));
+        } else {
+            slapi_log_err(SLAPI_LOG_TRACE, "sort_keys_build", "Equality index not usable, reading the entries\n");
+            for (int level = 0; level < sk->sk_nlevels; level++) {
+                memset(sk->sk_keys[level], 0, sk->sk_nids * sizeof(struct berval *));
             }
+            slapi_ch_free((void **)&need_entry);
         }
     }
 
-    /* We have sorted the array, except for any pending sorts on the stack.
-       Check if there are any, and do them. */
+    for (NIDS i = 0; i < sk->sk_nids; i++) {
+        int changed = 0;
 
-    --stkptr;
-    if (stkptr >= 0) {
-        lo = lostk[stkptr];
-        hi = histk[stkptr];
-        goto recurse; /* pop subarray from stack */
-    } else
-        return LDAP_SUCCESS; /* all subarrays done */
+        if (need_entry && !need_entry[i]) {
+            continue;
+        }
+        return_value = sort_keys_load(bc, sk, s, i, &changed);
+        if (LDAP_SUCCESS == return_value) {
+            return_value = sort_check(bc);
+        }
+        if (LDAP_SUCCESS != return_value) {
+            break;
+        }
+        if (sk->sk_checked) {
+            sk->sk_checked[i] = 1;
+        }
+    }
+    slapi_ch_free((void **)&need_entry);
+    return return_value;
 }
-/* End  fix for bug # 394184 */
 
+/* Compare the candidates at positions a and b */
+static int
+sort_keys_compare(ldbm_sort_keys *sk, NIDS a, NIDS b)
+{
+    for (int level = 0; level < sk->sk_nlevels; level++) {
+        struct berval *key_a = sk->sk_keys[level][a];
+        struct berval *key_b = sk->sk_keys[level][b];
+        int result;
+
+        /* If one has the attribute, and the other doesn't, the
+         * missing attribute is the LARGER one */
+        if (NULL == key_a) {
+            if (NULL == key_b) {
+                continue;
+            }
+            return 1;
+        }
+        if (NULL == key_b) {
+            return -1;
+        }
+        if (!sk->sk_order[level]) {
+            result = sk->sk_cmp[level](key_a, key_b);
+        } else {
+            /* If reverse, invert the sense of the comparison */
+            result = sk->sk_cmp[level](key_b, key_a);
+        }
+        if (0 != result) {
+            return result;
+        }
+    }
+    /* keep the order of the candidate list for equal keys */
+    return (a > b) - (a < b);
+}
 
 static void
-shortsort(
-    baggage_carrier *bc,
-    ID *lo,
-    ID *hi,
-    sort_spec *s)
+sort_keys_heap_down(ldbm_sort_keys *sk, NIDS *heap, NIDS size, NIDS i)
 {
-    ID *p, *max;
-    int error = 0;
-
-    /* Note: in assertions below, i and j are alway inside original bound of
-       array to sort. */
-
-    while (hi > lo) {
-        /* A[i] <= A[j] for i <= j, j > hi */
-        max = lo;
-        for (p = lo + 1; p <= hi; p++) {
-            /* A[i] <= A[max] for lo <= i < p */
-            if (compare_entries_sv(p, max, s, bc, &error) > 0) {
-                max = p;
-            }
-            /* A[i] <= A[max] for lo <= i <= p */
+    NIDS top = heap[i];
+
+    for (;;) {
+        NIDS child = 2 * i + 1;
+
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && sort_keys_compare(sk, heap[child + 1], heap[child]) > 0) {
+            child++;
+        }
+        if (sort_keys_compare(sk, heap[child], top) <= 0) {
+            break;
         }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = top;
+}
 
-        /* A[i] <= A[max] for lo <= i <= hi */
+/*
+ * Move the k smallest of the unsorted positions to the front, in order,
+ * using a bounded heap: O(n log k) comparisons of keys.
+ */
+static int
+sort_keys_select(baggage_carrier *bc, ldbm_sort_keys *sk, NIDS k)
+{
+    NIDS *heap = sk->sk_pos + sk->sk_sorted;
+    NIDS n = sk->sk_nids - sk->sk_sorted;
+    NIDS i;
+    int return_value;
 
-        swap(max, hi);
+    if (0 == k) {
+        return LDAP_SUCCESS;
+    }
+    /* max-heap of the k smallest seen so far */
+    for (i = k / 2; i-- > 0;) {
+        sort_keys_heap_down(sk, heap, k, i);
+    }
+    for (i = k; i < n; i++) {
+        if (sort_keys_compare(sk, heap[i], heap[0]) < 0) {
+            NIDS tmp = heap[0];
 
-        /* A[i] <= A[hi] for i <= hi, so A[i] <= A[j] for i <= j, j >= hi */
+            heap[0] = heap[i];
+            heap[i] = tmp;
+            sort_keys_heap_down(sk, heap, k, 0);
+        }
+        if (0 == (i % 1024) && LDAP_SUCCESS != (return_value = sort_check(bc))) {
+            return return_value;
+        }
+    }
+    /* and sort them */
+    for (i = k; i-- > 1;) {
+        NIDS tmp = heap[0];
 
-        hi--;
+        heap[0] = heap[i];
+        heap[i] = tmp;
+        sort_keys_heap_down(sk, heap, i, 0);
+    }
+    return LDAP_SUCCESS;
+}
+
+/*
+ * Sort the next k candidates.  The keys read from an index are checked
+ * against the entries of the selected candidates, which are about to be
+ * returned anyway; if one was too low the selection is done again.
+ */
+static int
+sort_keys_step(baggage_carrier *bc, ldbm_sort_keys *sk, NIDS k)
+{
+    int return_value;
+    int changed;
 
-        /* A[i] <= A[j] for i <= j, j > hi, loop top condition established */
+    do {
+        return_value = sort_keys_select(bc, sk, k);
+        changed = 0;
+        for (NIDS i = sk->sk_sorted; LDAP_SUCCESS == return_value && sk->sk_checked && i < sk->sk_sorted + k; i++) {
+            NIDS pos = sk->sk_pos[i];
+
+            if (!sk->sk_checked[pos]) {
+                return_value = sort_keys_load(bc, sk, NULL, pos, &changed);
+                sk->sk_checked[pos] = 1;
+            }
+        }
+    } while (LDAP_SUCCESS == return_value && changed);
+    if (LDAP_SUCCESS == return_value) {
+        sk->sk_sorted += k;
     }
-    /* A[i] <= A[j] for i <= j, j > lo, which implies A[i] <= A[j] for i < j,
-       so array is sorted */
+    return return_value;
 }
 
+/* Put the candidates in the sort order */
 static void
-swap(ID *a, ID *b)
+sort_keys_apply(ldbm_sort_keys *sk, IDList *candidates)
 {
-    ID tmp;
-
-    if (a != b) {
-        tmp = *a;
-        *a = *b;
-        *b = tmp;
+    for (NIDS i = 0; i < sk->sk_nids; i++) {
+        candidates->b_ids[i] = sk->sk_ids[sk->sk_pos[i]];
     }
 }
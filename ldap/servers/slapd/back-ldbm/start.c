@@ -162,6 +162,8 @@ ldbm_back_start(Slapi_PBlock *pb)
     /* dynamically created. Code below should only be called once */
     if (!initialized) {
         ldbm_compute_init();
+        ldbm_prefetch_start(li);
+        ldbm_cache_snapshot_start(li);
 
         initialized = 1;
     }
@@ -80,6 +80,7 @@ be_init(Slapi_Backend *be, const char *type, const char *name, int isprivate, in
     be->be_name = slapi_ch_strdup(name);
     be->be_mapped = 0;
     be->be_usn_counter = NULL;
+    be->be_latency = isprivate ? NULL : op_latency_backend_new();
 }
 
 void
@@ -96,6 +97,7 @@ be_done(Slapi_Backend *be)
     if (!config_get_entryusn_global()) {
         slapi_counter_destroy(&be->be_usn_counter);
     }
+    op_latency_backend_free(&be->be_latency);
     PR_DestroyLock(be->be_state_lock);
     if (be->be_lock != NULL) {
         slapi_destroy_rwlock(be->be_lock);
@@ -474,6 +476,9 @@ slapi_be_getentrypoint(Slapi_Backend *be, int entrypoint, void **ret_fnptr, Slap
     case SLAPI_PLUGIN_DB_PREV_SEARCH_RESULTS_FN:
         *ret_fnptr = be->be_prev_search_results;
         break;
+    case SLAPI_PLUGIN_DB_SEARCH_RESULTS_PACK_FN:
+        *ret_fnptr = (void *)be->be_search_results_pack;
+        break;
     case SLAPI_PLUGIN_DB_TEST_FN:
         *ret_fnptr = (void *)be->be_dbtest;
         break;
@@ -574,6 +579,9 @@ slapi_be_setentrypoint(Slapi_Backend *be, int entrypoint, void *ret_fnptr, Slapi
     case SLAPI_PLUGIN_DB_PREV_SEARCH_RESULTS_FN:
         be->be_prev_search_results = (VFP)ret_fnptr;
         break;
+    case SLAPI_PLUGIN_DB_SEARCH_RESULTS_PACK_FN:
+        be->be_search_results_pack = (SFPI)ret_fnptr;
+        break;
     case SLAPI_PLUGIN_DB_TEST_FN:
         be->be_dbtest = (IFP)ret_fnptr;
         break;
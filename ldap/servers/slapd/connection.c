@@ -26,6 +26,9 @@
 #if defined(LINUX)
 #include <netinet/tcp.h> /* for TCP_CORK */
 #endif
+#ifdef SYSTEMTAP
+#include <sys/sdt.h>
+#endif
 
 typedef Connection work_q_item;
 static void connection_threadmain(void *arg);
@@ -278,6 +281,10 @@ connection_reset(Connection *conn, int ns, PRNetAddr *from, int fromLen __attrib
     /* bump our count of connections and update SNMP stats */
     conn->c_connid = slapi_counter_increment(num_conns);
 
+#ifdef SYSTEMTAP
+    STAP_PROBE2(ns-slapd, conn__accept, conn->c_connid, conn->c_sd);
+#endif
+
     if (!in_referral_mode) {
         slapi_counter_increment(g_get_per_thread_snmp_vars()->ops_tbl.dsConnectionSeq);
         slapi_counter_increment(g_get_per_thread_snmp_vars()->ops_tbl.dsConnections);
@@ -463,6 +470,7 @@ init_op_threads()
     op_stack = PR_CreateStack("connection_operation");
     alloc_per_thread_snmp_vars(max_threads);
     init_thread_private_snmp_vars();
+    op_latency_init(max_threads + 1);
     
 
     threads_indexes = (int32_t *) slapi_ch_calloc(max_threads, sizeof(int32_t));
@@ -800,6 +808,8 @@ struct Conn_private
     char *c_buffer;                   /* pointer to the socket read buffer */
     size_t c_buffer_bytes;            /* number of bytes currently stored in the buffer */
     size_t c_buffer_offset;           /* offset to the location of new data in the buffer */
+    size_t c_buffer_max;              /* upper bound of c_buffer_size in CONNECTION_BUFFER_ADAPT mode */
+    uint32_t c_pdus_claimed;          /* buffered PDUs already promised to a worker thread */
     int use_buffer;                   /* if true, use the buffer - if false, ber_get_next reads directly from socket */
 };
 
@@ -894,6 +904,7 @@ connection_new_private(Connection *conn)
         conn->c_private->c_buffer = c_buffer;
         conn->c_private->c_buffer_size = c_buffer_size;
         conn->c_private->use_buffer = use_buffer;
+        conn->c_private->c_buffer_max = config_get_connection_buffer_max();
     }
 
     return 0;
@@ -1085,6 +1096,7 @@ get_next_from_buffer(void *buffer __attribute__((unused)), size_t buffer_size __
                       "ber_get_next failed for connection %" PRIu64 "\n", conn->c_connid);
         /* reset private buffer */
         conn->c_private->c_buffer_bytes = conn->c_private->c_buffer_offset = 0;
+        conn->c_private->c_pdus_claimed = 0;
 
         /* drop connection */
         disconnect_server_nomutex(conn, conn->c_connid, -1, err, syserr);
@@ -1109,12 +1121,22 @@ connection_read_ldap_data(Connection *conn, PRInt32 *err)
     if (ret < 0) {
         *err = PR_GetError();
     } else if (CONNECTION_BUFFER_ADAPT == conn->c_private->use_buffer) {
-        if ((ret == conn->c_private->c_buffer_size) && (conn->c_private->c_buffer_size < BUFSIZ)) {
+        if ((ret == conn->c_private->c_buffer_size) && (conn->c_private->c_buffer_size < conn->c_private->c_buffer_max)) {
             /* we read exactly what we requested - there could be more that we could have read */
             /* so increase the buffer size */
             conn->c_private->c_buffer_size *= 2;
-            if (conn->c_private->c_buffer_size > BUFSIZ) {
-                conn->c_private->c_buffer_size = BUFSIZ;
+            if (conn->c_private->c_buffer_size > conn->c_private->c_buffer_max) {
+                conn->c_private->c_buffer_size = conn->c_private->c_buffer_max;
+            }
+            conn->c_private->c_buffer = slapi_ch_realloc(conn->c_private->c_buffer, conn->c_private->c_buffer_size);
+        } else if ((ret < conn->c_private->c_buffer_size / 4) &&
+                   (conn->c_private->c_buffer_size > LDAP_SOCKET_IO_BUFFER_SIZE)) {
+            /* the client went back to small requests - give the memory back.
+             * What we just read still fits in the smaller buffer.
+             */
+            conn->c_private->c_buffer_size /= 2;
+            if (conn->c_private->c_buffer_size < LDAP_SOCKET_IO_BUFFER_SIZE) {
+                conn->c_private->c_buffer_size = LDAP_SOCKET_IO_BUFFER_SIZE;
             }
             conn->c_private->c_buffer = slapi_ch_realloc(conn->c_private->c_buffer, conn->c_private->c_buffer_size);
         }
@@ -1135,6 +1157,97 @@ conn_buffered_data_avail_nolock(Connection *conn, int *conn_closed)
     }
 }
 
+/*
+ * Count the complete LDAPMessage PDUs sitting in the connection buffer,
+ * without consuming them.  Stops after max PDUs.  If the buffer ends with
+ * the beginning of a PDU (or with something we cannot parse, that
+ * ber_get_next will reject later on) *partial is set to 1.
+ *
+ * Must be called with conn->c_mutex held, while the buffer offset is on a
+ * PDU boundary - which is always the case outside connection_read_operation.
+ */
+static uint32_t
+conn_count_buffered_pdus_nolock(Connection *conn, uint32_t max, int *partial)
+{
+    const unsigned char *p = (unsigned char *)conn->c_private->c_buffer + conn->c_private->c_buffer_offset;
+    const unsigned char *end = (unsigned char *)conn->c_private->c_buffer + conn->c_private->c_buffer_bytes;
+    uint32_t count = 0;
+
+    *partial = 0;
+    while ((p < end) && (count < max)) {
+        size_t avail = end - p;
+        size_t hdr_len = 2;
+        ber_len_t pdu_len = 0;
+
+        /* An LDAPMessage is a SEQUENCE: single octet tag, then the length */
+        if ((avail < hdr_len) || (p[0] != LDAP_TAG_MESSAGE)) {
+            *partial = 1;
+            break;
+        }
+        if (p[1] & 0x80) {
+            /* long form: the low bits give the number of length octets */
+            size_t nbytes = p[1] & 0x7f;
+            if ((nbytes == 0) || (nbytes > sizeof(ber_len_t)) || (avail < hdr_len + nbytes)) {
+                *partial = 1;
+                break;
+            }
+            for (size_t i = 0; i < nbytes; i++) {
+                pdu_len = (pdu_len << 8) | p[hdr_len + i];
+            }
+            hdr_len += nbytes;
+        } else {
+            pdu_len = p[1];
+        }
+        if (pdu_len > avail - hdr_len) {
+            *partial = 1;
+            break;
+        }
+        p += hdr_len + pdu_len;
+        count++;
+    }
+    return count;
+}
+
+/*
+ * Number of buffered PDUs (a trailing incomplete one counts as one) that
+ * no worker thread has been queued for yet, up to max.
+ * Caller must hold conn->c_mutex
+ */
+static uint32_t
+conn_unclaimed_pdus_nolock(Connection *conn, uint32_t max)
+{
+    uint32_t claimed = conn->c_private->c_pdus_claimed;
+    int partial = 0;
+    uint32_t pdus;
+
+    if (CONNECTION_BUFFER_OFF == conn->c_private->use_buffer) {
+        return 0;
+    }
+    pdus = conn_count_buffered_pdus_nolock(conn, max + claimed, &partial) + partial;
+    if (pdus <= claimed) {
+        return 0;
+    }
+    pdus -= claimed;
+    return (pdus > max) ? max : pdus;
+}
+
+/*
+ * If some buffered data is not yet owned by a worker, claim it for
+ * the calling thread.  Returns 1 if the caller must read it.
+ * Caller must hold conn->c_mutex
+ */
+static int
+conn_claim_buffered_pdu_nolock(Connection *conn)
+{
+    int conn_closed = 0;
+
+    if (conn_buffered_data_avail_nolock(conn, &conn_closed) && conn_unclaimed_pdus_nolock(conn, 1)) {
+        conn->c_private->c_pdus_claimed++;
+        return 1;
+    }
+    return 0;
+}
+
 /* Function to convert a PRNetAddr to a normalized IPv4 string and keep original address string. */
 static void
 normalize_IPv4(const PRNetAddr *addr, char *normalizedAddr, size_t normalizedAddrSize, char *originalAddr, size_t originalAddrSize)
@@ -1205,6 +1318,10 @@ connection_read_operation(Connection *conn, Operation *op, ber_tag_t *tag, int *
     }
 
     *tag = LBER_DEFAULT;
+    /* If we were queued for an already buffered PDU, we are now consuming it */
+    if (conn->c_private->c_pdus_claimed > 0) {
+        conn->c_private->c_pdus_claimed--;
+    }
     /* First check to see if we have buffered data from "before" */
     if ((buffer_data_avail = conn_buffered_data_avail_nolock(conn, &conn_closed))) {
         /* If so, use that data first */
@@ -1465,6 +1582,9 @@ connection_read_operation(Connection *conn, Operation *op, ber_tag_t *tag, int *
         break;
     }
     op->o_tag = *tag;
+#ifdef SYSTEMTAP
+    STAP_PROBE3(ns-slapd, op__pdu_read, conn->c_connid, op->o_opid, *tag);
+#endif
 done:
     pthread_mutex_unlock(&(conn->c_mutex));
     return ret;
@@ -1854,19 +1974,37 @@ connection_threadmain(void *arg)
                  * so need locking from here on */
                 signal_listner(conn->c_ct_list);
             } else { /* more data in conn - just put back on work_q - bypass poll */
+                uint32_t free_slots;
+                uint32_t pdus;
+
                 bypasspollcnt++;
                 pthread_mutex_lock(&(conn->c_mutex));
-                /* don't do this if it would put us over the max threads per conn */
-                if (conn->c_threadnumber < maxthreads) {
+                /*
+                 * A single read may have brought in several pipelined requests:
+                 * queue one work item per buffered PDU in one pass, rather than
+                 * one per trip through the work queue. Don't do this if it would
+                 * put us over the max threads per conn.
+                 */
+                free_slots = (conn->c_threadnumber < maxthreads) ? maxthreads - conn->c_threadnumber : 0;
+                pdus = conn_unclaimed_pdus_nolock(conn, free_slots ? free_slots : 1);
+                if (pdus == 0) {
+                    /* Everything buffered is already owned by queued workers */
+                } else if (free_slots) {
+                    uint32_t queued = 0;
                     /* for turbo, c_idlesince is set above - for !turbo and
                      * !more_data, we put the conn back in the poll loop and
                      * c_idlesince is set in handle_pr_read_ready - since we
                      * are bypassing both of those, we set idlesince here
                      */
                     conn->c_idlesince = curtime;
-                    connection_activity(conn, maxthreads);
-                    slapi_log_err(SLAPI_LOG_CONNS, "connection_threadmain", "conn %" PRIu64 " queued because more_data\n",
-                                  conn->c_connid);
+                    for (; queued < pdus; queued++) {
+                        if (connection_activity(conn, maxthreads)) {
+                            break;
+                        }
+                        conn->c_private->c_pdus_claimed++;
+                    }
+                    slapi_log_err(SLAPI_LOG_CONNS, "connection_threadmain", "conn %" PRIu64 " queued %" PRIu32 " buffered operations because more_data\n",
+                                  conn->c_connid, queued);
                 } else {
                     /* keep count of how many times maxthreads has blocked an operation */
                     conn->c_maxthreadsblocked++;
@@ -1953,9 +2091,13 @@ connection_threadmain(void *arg)
              * more_data (continue reading buffered req) this thread
              * continues to hold the connection
              */
-            if (!thread_turbo_flag && !more_data) {
+            if (!thread_turbo_flag) {
                 pthread_mutex_lock(&(conn->c_mutex));
-                connection_release_nolock(conn); /* psearch acquires ref to conn - release this one now */
+                /* Only keep looping on the buffered data nobody else was queued for */
+                more_data = conn_claim_buffered_pdu_nolock(conn);
+                if (!more_data) {
+                    connection_release_nolock(conn); /* psearch acquires ref to conn - release this one now */
+                }
                 pthread_mutex_unlock(&(conn->c_mutex));
             }
             /* ps_add makes a shallow copy of the pb - so we
@@ -1968,7 +2110,6 @@ connection_threadmain(void *arg)
             slapi_pblock_init(pb);
         } else {
             /* delete from connection operation queue & decr refcnt */
-            int conn_closed = 0;
             pthread_mutex_lock(&(conn->c_mutex));
             connection_remove_operation_ext(pb, conn, op);
 
@@ -1982,8 +2123,9 @@ connection_threadmain(void *arg)
                 /* it a connection that was just flagged as replication connection */
                 more_data = 0;
             } else {
-                /* normal connection or already established replication connection */
-                more_data = conn_buffered_data_avail_nolock(conn, &conn_closed) ? 1 : 0;
+                /* normal connection or already established replication connection,
+                 * loop on the buffered data unless other workers are queued for it */
+                more_data = conn_claim_buffered_pdu_nolock(conn);
             }
             if (!more_data) {
                 if (!thread_turbo_flag) {
@@ -2081,6 +2223,10 @@ add_work_q(work_q_item *wqitem, struct Slapi_op_stack *op_stack_obj)
     new_work_q->op_stack_obj = op_stack_obj;
     new_work_q->next_work_item = NULL;
 
+#ifdef SYSTEMTAP
+    STAP_PROBE1(ns-slapd, workq__enqueue, ((Connection *)wqitem)->c_connid);
+#endif
+
     pthread_mutex_lock(&work_q_lock);
     if (tail_work_q == NULL) {
         tail_work_q = new_work_q;
@@ -2125,6 +2271,10 @@ get_work_q(struct Slapi_op_stack **op_stack_obj)
     /* Free the memory used by the item found. */
     destroy_work_q(&tmp);
 
+#ifdef SYSTEMTAP
+    STAP_PROBE1(ns-slapd, workq__dequeue, ((Connection *)wqitem)->c_connid);
+#endif
+
     return (wqitem);
 }
 
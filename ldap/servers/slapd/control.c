@@ -91,6 +91,10 @@ init_controls(void)
     /* LDAP_CONTROL_PAGEDRESULTS is shared by request and response */
     slapi_register_supported_control(LDAP_CONTROL_PAGEDRESULTS,
                                      SLAPI_OPERATION_SEARCH);
+
+    /* LDAP_CONTROL_SEARCH_EXPLAIN is shared by request and response */
+    slapi_register_supported_control(LDAP_CONTROL_SEARCH_EXPLAIN,
+                                     SLAPI_OPERATION_SEARCH);
 }
 
 
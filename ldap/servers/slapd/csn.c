@@ -46,9 +46,9 @@ static Slapi_Counter *slapi_csn_counter_exist;
 static void
 csn_create_counters(void)
 {
-    slapi_csn_counter_created = slapi_counter_new();
-    slapi_csn_counter_deleted = slapi_counter_new();
-    slapi_csn_counter_exist = slapi_counter_new();
+    slapi_csn_counter_created = slapi_counter_new_sharded();
+    slapi_csn_counter_deleted = slapi_counter_new_sharded();
+    slapi_csn_counter_exist = slapi_counter_new_sharded();
     counters_created = 1;
 }
 #endif
@@ -2280,6 +2280,25 @@ slapi_entrycache_vattrcache_watermark_invalidate()
     if (slapi_atomic_incr_32(&g_virtual_watermark, __ATOMIC_RELEASE) == 0) {
         slapi_atomic_incr_32(&g_virtual_watermark, __ATOMIC_RELEASE);
     }
+    slapi_vattr_generation_bump();
+}
+
+/* Unlike the watermark, the generation changes each time a service provider
+ * changes the values it computes, whether or not they are cacheable in the
+ * entries. It lets a plugin keep results derived from virtual attributes.
+ */
+static uint64_t g_vattr_generation = 1;
+
+uint64_t
+slapi_vattr_generation(void)
+{
+    return slapi_atomic_load_64(&g_vattr_generation, __ATOMIC_ACQUIRE);
+}
+
+void
+slapi_vattr_generation_bump(void)
+{
+    slapi_atomic_incr_64(&g_vattr_generation, __ATOMIC_RELEASE);
 }
 
 /* The following functions control the virtual attribute cache
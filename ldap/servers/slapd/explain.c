@@ -0,0 +1,165 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* explain.c - routines for dealing with the search explain control */
+
+#include <ldap.h>
+#include <json-c/json.h>
+
+#include "slap.h"
+
+/*
+ * The request control value is optional:
+ *
+ *   ExplainRequestValue ::= SEQUENCE {
+ *       dryRun  BOOLEAN DEFAULT FALSE }
+ *
+ * With dryRun, the search runs to its end but the entries are not sent:
+ * only the result, with the plan, is returned.
+ *
+ * The response control, with the same OID, is attached to the search
+ * result. Its value is a JSON object (see explain_add_response_control),
+ * the information is the same as in the index "stat" log, plus the
+ * candidate list, the entries and the time spent in each phase.
+ *
+ * Returns 0 and sets dryrun, or -1 if the value can't be decoded.
+ */
+int
+explain_parse_request_control(struct berval *explain_spec_ber, int *dryrun)
+{
+    BerElement *ber = NULL;
+    ber_len_t len = 0;
+    ber_int_t value = 0;
+    int rc = 0;
+
+    *dryrun = 0;
+    if (!BV_HAS_DATA(explain_spec_ber)) {
+        /* no value: explain, and return the entries */
+        return 0;
+    }
+
+    ber = ber_init(explain_spec_ber);
+    if (ber == NULL) {
+        return -1;
+    }
+    if (ber_scanf(ber, "{") == LBER_ERROR) {
+        rc = -1;
+    } else if (ber_peek_tag(ber, &len) == LBER_BOOLEAN) {
+        if (ber_scanf(ber, "b", &value) == LBER_ERROR) {
+            rc = -1;
+        } else {
+            *dryrun = value ? 1 : 0;
+        }
+    }
+    if (rc == 0 && ber_scanf(ber, "}") == LBER_ERROR) {
+        rc = -1;
+    }
+    ber_free(ber, 1);
+
+    slapi_log_err(SLAPI_LOG_TRACE, "explain_parse_request_control",
+                  "rc=%d dryrun=%d\n", rc, *dryrun);
+    return rc;
+}
+
+static json_object *
+explain_index_lookups(struct component_keys_lookup *keys_lookup)
+{
+    json_object *lookups = json_object_new_array();
+    struct component_keys_lookup *key_info;
+    size_t nkeys = 0;
+    size_t i = 0;
+
+    /* the lookups are stacked, put them back in the order they were done */
+    for (key_info = keys_lookup; key_info; key_info = key_info->next) {
+        nkeys++;
+    }
+    for (key_info = keys_lookup; key_info; key_info = key_info->next) {
+        json_object *lookup = json_object_new_object();
+
+        json_object_object_add(lookup, "attribute", json_object_new_string(key_info->attribute_type ? key_info->attribute_type : ""));
+        json_object_object_add(lookup, "index", json_object_new_string(key_info->index_type ? key_info->index_type : ""));
+        json_object_object_add(lookup, "key", json_object_new_string(key_info->key ? key_info->key : ""));
+        json_object_object_add(lookup, "ids", json_object_new_int64(key_info->allids ? 0 : key_info->id_lookup_cnt));
+        json_object_object_add(lookup, "allids", json_object_new_boolean(key_info->allids));
+        json_object_array_put_idx(lookups, nkeys - 1 - i++, lookup);
+    }
+    return lookups;
+}
+
+/*
+ * Attach the plan of the search to its result, if the client asked for it.
+ *
+ *   {"filter": "(&(uid=jdoe)(objectclass=person))",
+ *    "dry_run": false,
+ *    "candidates": 1, "allids": false, "filter_test": "applied",
+ *    "unindexed": false,
+ *    "index_lookups": [{"attribute": "uid", "index": "eq", "key": "jdoe",
+ *                       "ids": 1, "allids": false}, ...],
+ *    "entries": {"tested": 1, "matched": 1, "returned": 1},
+ *    "entry_cache": {"hits": 1, "misses": 0},
+ *    "time_usec": {"index": 12, "candidates": 20, "scan": 8, "total": 65}}
+ *
+ * "candidates" and the entry counts add up the backends of the search,
+ * "filter" is the filter as run by the first backend.
+ */
+void
+explain_add_response_control(Slapi_PBlock *pb, Slapi_Operation *op)
+{
+    Op_search_stat *explain = op_stat_get_search_stat(pb);
+    json_object *plan, *obj;
+    struct timespec elapsed;
+    uint32_t notes = slapi_pblock_get_operation_notes(pb);
+    const char *value;
+    LDAPControl ctrl = {0};
+
+    if (explain == NULL) {
+        return;
+    }
+
+    slapi_operation_op_time_elapsed(op, &elapsed);
+
+    plan = json_object_new_object();
+    json_object_object_add(plan, "filter", json_object_new_string(explain->filter_executed ? explain->filter_executed : ""));
+    json_object_object_add(plan, "dry_run", json_object_new_boolean(operation_is_flag_set(op, OP_FLAG_EXPLAIN_DRYRUN)));
+    json_object_object_add(plan, "candidates", json_object_new_int64(explain->candidates_allids ? 0 : explain->candidates));
+    json_object_object_add(plan, "allids", json_object_new_boolean(explain->candidates_allids));
+    json_object_object_add(plan, "filter_test", json_object_new_string(explain->filter_test_bypassed ? "bypassed" : "applied"));
+    json_object_object_add(plan, "unindexed", json_object_new_boolean(notes & (SLAPI_OP_NOTE_UNINDEXED | SLAPI_OP_NOTE_FULL_UNINDEXED)));
+    json_object_object_add(plan, "index_lookups", explain_index_lookups(explain->keys_lookup));
+
+    obj = json_object_new_object();
+    json_object_object_add(obj, "tested", json_object_new_int64(explain->entries_tested));
+    json_object_object_add(obj, "matched", json_object_new_int64(explain->entries_matched));
+    json_object_object_add(obj, "returned", json_object_new_int64(explain->entries_returned));
+    json_object_object_add(plan, "entries", obj);
+
+    obj = json_object_new_object();
+    json_object_object_add(obj, "hits", json_object_new_int64(explain->cache_hits));
+    json_object_object_add(obj, "misses", json_object_new_int64(explain->cache_misses));
+    json_object_object_add(plan, "entry_cache", obj);
+
+    obj = json_object_new_object();
+    json_object_object_add(obj, "index", json_object_new_int64(explain->index_ns / 1000));
+    json_object_object_add(obj, "candidates", json_object_new_int64(explain->candidates_ns / 1000));
+    json_object_object_add(obj, "scan", json_object_new_int64(explain->scan_ns / 1000));
+    json_object_object_add(obj, "total", json_object_new_int64((int64_t)elapsed.tv_sec * 1000000 + elapsed.tv_nsec / 1000));
+    json_object_object_add(plan, "time_usec", obj);
+
+    value = json_object_to_json_string_ext(plan, JSON_C_TO_STRING_PLAIN);
+    ctrl.ldctl_oid = LDAP_CONTROL_SEARCH_EXPLAIN;
+    ctrl.ldctl_value.bv_val = (char *)value;
+    ctrl.ldctl_value.bv_len = strlen(value);
+    ctrl.ldctl_iscritical = 0;
+    slapi_pblock_set(pb, SLAPI_ADD_RESCONTROL, &ctrl);
+
+    json_object_put(plan);
+}
@@ -98,6 +98,11 @@ static const char *internal_entries[] =
         "objectclass:extensibleObject\n"
         "cn:snmp\n",
 
+        "dn:cn=latency,cn=monitor\n"
+        "objectclass:top\n"
+        "objectclass:extensibleObject\n"
+        "cn:latency\n",
+
         "dn:cn=counters,cn=monitor\n"
         "objectclass:top\n"
         "objectclass:extensibleObject\n"
@@ -2863,6 +2868,18 @@ search_snmp(Slapi_PBlock *pb __attribute__((unused)),
     return SLAPI_DSE_CALLBACK_OK;
 }
 
+int
+search_latency(Slapi_PBlock *pb __attribute__((unused)),
+               Slapi_Entry *entryBefore,
+               Slapi_Entry *e __attribute__((unused)),
+               int *returncode __attribute__((unused)),
+               char *returntext __attribute__((unused)),
+               void *arg __attribute__((unused)))
+{
+    op_latency_as_entry(entryBefore);
+    return SLAPI_DSE_CALLBACK_OK;
+}
+
 /*
  * Called from main.c to install the internal backends
  */
@@ -2882,6 +2899,7 @@ setup_internal_backends(char *configdir)
         Slapi_DN monitor;
         Slapi_DN counters;
         Slapi_DN snmp;
+        Slapi_DN latency;
         Slapi_DN root;
         Slapi_Backend *be;
         Slapi_DN encryption;
@@ -2892,6 +2910,7 @@ setup_internal_backends(char *configdir)
         slapi_sdn_init_ndn_byref(&monitor, "cn=monitor");
         slapi_sdn_init_ndn_byref(&counters, "cn=counters,cn=monitor");
         slapi_sdn_init_ndn_byref(&snmp, "cn=snmp,cn=monitor");
+        slapi_sdn_init_ndn_byref(&latency, "cn=latency,cn=monitor");
         slapi_sdn_init_ndn_byref(&diskspace, "cn=disk space,cn=monitor");
         slapi_sdn_init_ndn_byref(&root, "");
 
@@ -2907,6 +2926,7 @@ setup_internal_backends(char *configdir)
         dse_register_callback(pfedse, SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, &monitor, LDAP_SCOPE_SUBTREE, EGG_FILTER, search_easter_egg, NULL, NULL); /* Egg */
         dse_register_callback(pfedse, SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, &counters, LDAP_SCOPE_BASE, "(objectclass=*)", search_counters, NULL, NULL);
         dse_register_callback(pfedse, SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, &snmp, LDAP_SCOPE_BASE, "(objectclass=*)", search_snmp, NULL, NULL);
+        dse_register_callback(pfedse, SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, &latency, LDAP_SCOPE_BASE, "(objectclass=*)", search_latency, NULL, NULL);
         dse_register_callback(pfedse, SLAPI_OPERATION_SEARCH, DSE_FLAG_PREOP, &encryption, LDAP_SCOPE_BASE, "(objectclass=*)", search_encryption, NULL, NULL);
 
         /* Modify */
@@ -2921,6 +2941,7 @@ setup_internal_backends(char *configdir)
         dse_register_callback(pfedse, SLAPI_OPERATION_DELETE, DSE_FLAG_PREOP, &monitor, LDAP_SCOPE_BASE, "(objectclass=*)", dont_allow_that, NULL, NULL);
         dse_register_callback(pfedse, SLAPI_OPERATION_DELETE, DSE_FLAG_PREOP, &counters, LDAP_SCOPE_BASE, "(objectclass=*)", dont_allow_that, NULL, NULL);
         dse_register_callback(pfedse, SLAPI_OPERATION_DELETE, DSE_FLAG_PREOP, &snmp, LDAP_SCOPE_BASE, "(objectclass=*)", dont_allow_that, NULL, NULL);
+        dse_register_callback(pfedse, SLAPI_OPERATION_DELETE, DSE_FLAG_PREOP, &latency, LDAP_SCOPE_BASE, "(objectclass=*)", dont_allow_that, NULL, NULL);
         dse_register_callback(pfedse, SLAPI_OPERATION_DELETE, DSE_FLAG_PREOP, &root, LDAP_SCOPE_BASE, "(objectclass=*)", dont_allow_that, NULL, NULL);
         dse_register_callback(pfedse, SLAPI_OPERATION_DELETE, DSE_FLAG_PREOP, &encryption, LDAP_SCOPE_BASE, "(objectclass=*)", dont_allow_that, NULL, NULL);
         dse_register_callback(pfedse, SLAPI_OPERATION_DELETE, DSE_FLAG_PREOP, &saslmapping, LDAP_SCOPE_SUBTREE, "(objectclass=nsSaslMapping)", sasl_map_config_delete, NULL, NULL);
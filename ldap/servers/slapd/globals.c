@@ -73,8 +73,8 @@ set_entry_points()
     /* To apply the nsslapd-counters config value properly,
        these values are initialized here after config file is read */
     if (config_get_slapi_counters()) {
-        max_threads_count = slapi_counter_new();
-        conns_in_maxthreads = slapi_counter_new();
+        max_threads_count = slapi_counter_new_sharded();
+        conns_in_maxthreads = slapi_counter_new_sharded();
     } else {
         max_threads_count = NULL;
         conns_in_maxthreads = NULL;
@@ -1202,6 +1202,22 @@ static struct config_get_and_set
      NULL, 0,
      (void **)&global_slapdFrontendConfig.connection_buffer,
      CONFIG_INT, (ConfigGetFunc)config_get_connection_buffer, &init_connection_buffer, NULL},
+    {CONFIG_CONNECTION_BUFFER_MAX, config_set_connection_buffer_max,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.connection_buffer_max, CONFIG_INT,
+     (ConfigGetFunc)config_get_connection_buffer_max, SLAPD_DEFAULT_CONNECTION_BUFFER_MAX_STR, NULL},
+    {CONFIG_PAGEDRESULTS_CURSOR_CACHE_SIZE, config_set_pagedresults_cursor_cache_size,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.pagedresults_cursor_cache_size, CONFIG_INT,
+     (ConfigGetFunc)config_get_pagedresults_cursor_cache_size, SLAPD_DEFAULT_PAGEDRESULTS_CURSOR_CACHE_SIZE_STR, NULL},
+    {CONFIG_PSEARCH_THREADS, config_set_psearch_threads,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.psearch_threads, CONFIG_INT,
+     (ConfigGetFunc)config_get_psearch_threads, SLAPD_DEFAULT_PSEARCH_THREADS_STR, NULL},
+    {CONFIG_PSEARCH_MAX_QUEUE, config_set_psearch_max_queue,
+     NULL, 0,
+     (void **)&global_slapdFrontendConfig.psearch_max_queue, CONFIG_INT,
+     (ConfigGetFunc)config_get_psearch_max_queue, SLAPD_DEFAULT_PSEARCH_MAX_QUEUE_STR, NULL},
     {CONFIG_CONNECTION_NOCANON, config_set_connection_nocanon,
      NULL, 0,
      (void **)&global_slapdFrontendConfig.connection_nocanon,
@@ -1971,6 +1987,10 @@ FrontendConfig_init(void)
     init_return_orig_type = cfg->return_orig_type = LDAP_OFF;
     init_enable_turbo_mode = cfg->enable_turbo_mode = LDAP_ON;
     init_connection_buffer = cfg->connection_buffer = CONNECTION_BUFFER_ON;
+    cfg->connection_buffer_max = SLAPD_DEFAULT_CONNECTION_BUFFER_MAX;
+    cfg->pagedresults_cursor_cache_size = SLAPD_DEFAULT_PAGEDRESULTS_CURSOR_CACHE_SIZE;
+    cfg->psearch_threads = SLAPD_DEFAULT_PSEARCH_THREADS;
+    cfg->psearch_max_queue = SLAPD_DEFAULT_PSEARCH_MAX_QUEUE;
     init_connection_nocanon = cfg->connection_nocanon = LDAP_ON;
     init_plugin_logging = cfg->plugin_logging = LDAP_OFF;
     cfg->listen_backlog_size = DAEMON_LISTEN_SIZE;
@@ -8510,6 +8530,140 @@ config_set_connection_buffer(const char *attrname, char *value, char *errorbuf,
     return retVal;
 }
 
+int32_t
+config_get_connection_buffer_max(void)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    return slapi_atomic_load_32(&(slapdFrontendConfig->connection_buffer_max), __ATOMIC_ACQUIRE);
+}
+
+int32_t
+config_set_connection_buffer_max(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long buffer_max;
+    char *endp = NULL;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    buffer_max = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE ||
+        buffer_max < CONNECTION_BUFFER_MAX_MIN || buffer_max > CONNECTION_BUFFER_MAX_MAX) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "%s: invalid value \"%s\", the maximum read buffer size must range from %d to %d",
+                              attrname, value, CONNECTION_BUFFER_MAX_MIN, CONNECTION_BUFFER_MAX_MAX);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32(&(slapdFrontendConfig->connection_buffer_max), buffer_max, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
+int32_t
+config_get_pagedresults_cursor_cache_size(void)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    return slapi_atomic_load_32(&(slapdFrontendConfig->pagedresults_cursor_cache_size), __ATOMIC_ACQUIRE);
+}
+
+int32_t
+config_set_pagedresults_cursor_cache_size(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long size;
+    char *endp = NULL;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    size = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || size < 0 || size > INT32_MAX) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "%s: invalid value \"%s\", the size of the paged results cursor cache must range from 0 (disabled) to %d",
+                              attrname, value, INT32_MAX);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32(&(slapdFrontendConfig->pagedresults_cursor_cache_size), size, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
+int32_t
+config_get_psearch_threads(void)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    return slapi_atomic_load_32(&(slapdFrontendConfig->psearch_threads), __ATOMIC_ACQUIRE);
+}
+
+/* Read when the first persistent search starts, a change needs a restart */
+int32_t
+config_set_psearch_threads(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long nthreads;
+    char *endp = NULL;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    nthreads = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || nthreads < 1 || nthreads > PSEARCH_THREADS_MAX) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "%s: invalid value \"%s\", the number of persistent search threads must range from 1 to %d",
+                              attrname, value, PSEARCH_THREADS_MAX);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32(&(slapdFrontendConfig->psearch_threads), nthreads, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
+int32_t
+config_get_psearch_max_queue(void)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    return slapi_atomic_load_32(&(slapdFrontendConfig->psearch_max_queue), __ATOMIC_ACQUIRE);
+}
+
+int32_t
+config_set_psearch_max_queue(const char *attrname, char *value, char *errorbuf, int apply)
+{
+    slapdFrontendConfig_t *slapdFrontendConfig = getFrontendConfig();
+    long maxqueue;
+    char *endp = NULL;
+
+    if (config_value_is_null(attrname, value, errorbuf, 0)) {
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    errno = 0;
+    maxqueue = strtol(value, &endp, 10);
+    if (*endp != '\0' || errno == ERANGE || maxqueue < 0 || maxqueue > INT32_MAX) {
+        slapi_create_errormsg(errorbuf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "%s: invalid value \"%s\", the persistent search queue limit must range from 0 (no limit) to %d",
+                              attrname, value, INT32_MAX);
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    if (apply) {
+        slapi_atomic_store_32(&(slapdFrontendConfig->psearch_max_queue), maxqueue, __ATOMIC_RELEASE);
+    }
+    return LDAP_SUCCESS;
+}
+
 int
 config_set_listen_backlog_size(const char *attrname, char *value, char *errorbuf, int apply)
 {
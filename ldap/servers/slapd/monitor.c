@@ -61,6 +61,7 @@ monitor_info(Slapi_PBlock *pb __attribute__((unused)),
     attrlist_replace(&e->e_attrs, "threads", vals);
 
     connection_table_as_entry(the_connection_table, e);
+    pagedresults_cursor_store_as_entry(e);
 
     val.bv_len = snprintf(buf, sizeof(buf), "%" PRIu64, g_get_num_ops_initiated());
     val.bv_val = buf;
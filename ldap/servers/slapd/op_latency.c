@@ -0,0 +1,347 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2024 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/*
+ * op_latency.c - per operation type latency histograms
+ *
+ * Each worker thread records the wtime and optime of the operations it
+ * completes in its own set of histograms (the slot is the one of its
+ * snmp_vars), so the hot path only does uncontended relaxed atomic
+ * increments.  Every backend also has one set per thread slot, allocated
+ * when the thread completes its first operation on the backend.  The sets
+ * are summed when cn=latency,cn=monitor or the SNMP stats file are
+ * refreshed.
+ */
+
+#include "slap.h"
+
+static const char *op_latency_type_names[OP_LATENCY_NB_TYPES] = {
+    "bind",
+    "search-base",
+    "search-onelevel",
+    "search-subtree",
+    "add",
+    "modify",
+    "delete",
+    "modrdn",
+    "compare",
+    "extended",
+};
+
+static const char *op_latency_kind_names[OP_LATENCY_NB_KINDS] = {
+    "wtime",
+    "optime",
+};
+
+static op_latency_set *op_latency_slots = NULL; /* one set per snmp_vars slot */
+static int32_t op_latency_nb_slots = 0;
+
+/*
+ * Allocates the per thread histograms.  Slot 0 is shared by the
+ * threads that are not workers, like in the snmp_vars.
+ */
+void
+op_latency_init(int32_t nb_slots)
+{
+    if (op_latency_slots == NULL && nb_slots > 0) {
+        op_latency_slots = (op_latency_set *)slapi_ch_calloc(nb_slots, sizeof(op_latency_set));
+        op_latency_nb_slots = nb_slots;
+    }
+}
+
+op_latency_backend *
+op_latency_backend_new(void)
+{
+    return (op_latency_backend *)slapi_ch_calloc(1, sizeof(op_latency_backend));
+}
+
+void
+op_latency_backend_free(op_latency_backend **latency)
+{
+    if (*latency && (*latency)->slots) {
+        for (int32_t slot = 0; slot < op_latency_nb_slots; slot++) {
+            slapi_ch_free((void **)&(*latency)->slots[slot]);
+        }
+        slapi_ch_free((void **)&(*latency)->slots);
+    }
+    slapi_ch_free((void **)latency);
+}
+
+/*
+ * Returns the set of the thread slot in the backend histograms.  Only the
+ * threads sharing slot 0 may race to allocate it: the loser frees its copy.
+ */
+static op_latency_set *
+op_latency_backend_slot(op_latency_backend *latency, int32_t slot)
+{
+    op_latency_set **slots = __atomic_load_n(&latency->slots, __ATOMIC_ACQUIRE);
+    op_latency_set *set = NULL;
+
+    if (slots == NULL) {
+        op_latency_set **new_slots = (op_latency_set **)slapi_ch_calloc(op_latency_nb_slots, sizeof(op_latency_set *));
+        if (__atomic_compare_exchange_n(&latency->slots, &slots, new_slots, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            slots = new_slots;
+        } else {
+            slapi_ch_free((void **)&new_slots);
+        }
+    }
+    set = __atomic_load_n(&slots[slot], __ATOMIC_ACQUIRE);
+    if (set == NULL) {
+        op_latency_set *new_set = (op_latency_set *)slapi_ch_calloc(1, sizeof(op_latency_set));
+        if (__atomic_compare_exchange_n(&slots[slot], &set, new_set, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            set = new_set;
+        } else {
+            slapi_ch_free((void **)&new_set);
+        }
+    }
+    return set;
+}
+
+static inline uint32_t
+op_latency_bucket(uint64_t usec)
+{
+    uint32_t msb;
+
+    if (usec < OP_LATENCY_SUB_COUNT) {
+        return (uint32_t)usec;
+    }
+    msb = 63 - __builtin_clzll(usec);
+    if (msb >= OP_LATENCY_MAX_BITS) {
+        return OP_LATENCY_NB_BUCKETS - 1;
+    }
+    return ((msb - OP_LATENCY_SUB_BITS + 1) << OP_LATENCY_SUB_BITS) +
+           (uint32_t)((usec >> (msb - OP_LATENCY_SUB_BITS)) & (OP_LATENCY_SUB_COUNT - 1));
+}
+
+/* Highest value that falls in a bucket */
+static uint64_t
+op_latency_bucket_value(uint32_t idx)
+{
+    uint32_t group = idx >> OP_LATENCY_SUB_BITS;
+    uint32_t sub = idx & (OP_LATENCY_SUB_COUNT - 1);
+
+    if (group == 0) {
+        return idx;
+    }
+    return ((uint64_t)(OP_LATENCY_SUB_COUNT | sub) << (group - 1)) + ((uint64_t)1 << (group - 1)) - 1;
+}
+
+static inline uint64_t
+op_latency_usec(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000 + (uint64_t)ts->tv_nsec / 1000;
+}
+
+static void
+op_latency_set_record(op_latency_set *set, op_latency_type type, uint64_t wtime, uint64_t optime)
+{
+    slapi_atomic_incr_64(&set->hist[type][OP_LATENCY_WTIME].buckets[op_latency_bucket(wtime)], __ATOMIC_RELAXED);
+    slapi_atomic_incr_64(&set->hist[type][OP_LATENCY_OPTIME].buckets[op_latency_bucket(optime)], __ATOMIC_RELAXED);
+}
+
+/*
+ * Records the latency of an operation whose result is being sent.
+ * Internal operations are ignored, their time is part of the
+ * operation that triggered them.
+ */
+void
+op_latency_record(Slapi_PBlock *pb, Operation *op)
+{
+    op_latency_type type;
+    struct timespec wtime;
+    struct timespec optime;
+    Slapi_Backend *be = NULL;
+    int scope = LDAP_SCOPE_BASE;
+    int32_t slot;
+
+    if (op_latency_slots == NULL || op == NULL || operation_is_flag_set(op, OP_FLAG_INTERNAL)) {
+        return;
+    }
+
+    switch (operation_get_type(op)) {
+    case SLAPI_OPERATION_BIND:
+        type = OP_LATENCY_BIND;
+        break;
+    case SLAPI_OPERATION_SEARCH:
+        slapi_pblock_get(pb, SLAPI_SEARCH_SCOPE, &scope);
+        if (scope == LDAP_SCOPE_ONELEVEL) {
+            type = OP_LATENCY_SEARCH_ONELEVEL;
+        } else if (scope == LDAP_SCOPE_SUBTREE) {
+            type = OP_LATENCY_SEARCH_SUBTREE;
+        } else {
+            type = OP_LATENCY_SEARCH_BASE;
+        }
+        break;
+    case SLAPI_OPERATION_ADD:
+        type = OP_LATENCY_ADD;
+        break;
+    case SLAPI_OPERATION_MODIFY:
+        type = OP_LATENCY_MODIFY;
+        break;
+    case SLAPI_OPERATION_DELETE:
+        type = OP_LATENCY_DELETE;
+        break;
+    case SLAPI_OPERATION_MODRDN:
+        type = OP_LATENCY_MODRDN;
+        break;
+    case SLAPI_OPERATION_COMPARE:
+        type = OP_LATENCY_COMPARE;
+        break;
+    case SLAPI_OPERATION_EXTENDED:
+        type = OP_LATENCY_EXTENDED;
+        break;
+    default:
+        return;
+    }
+
+    slapi_operation_workq_time_elapsed(op, &wtime);
+    slapi_operation_op_time_elapsed(op, &optime);
+
+    slot = thread_private_snmp_vars_get_idx();
+    if (slot < 0 || slot >= op_latency_nb_slots) {
+        slot = 0;
+    }
+    op_latency_set_record(&op_latency_slots[slot], type, op_latency_usec(&wtime), op_latency_usec(&optime));
+
+    slapi_pblock_get(pb, SLAPI_BACKEND, &be);
+    if (be && be->be_latency) {
+        op_latency_set_record(op_latency_backend_slot(be->be_latency, slot), type,
+                              op_latency_usec(&wtime), op_latency_usec(&optime));
+    }
+}
+
+static void
+op_latency_hist_add(op_latency_hist *total, op_latency_hist *h)
+{
+    for (size_t i = 0; i < OP_LATENCY_NB_BUCKETS; i++) {
+        total->buckets[i] += slapi_atomic_load_64(&h->buckets[i], __ATOMIC_RELAXED);
+    }
+}
+
+static void
+op_latency_hist_summarize(const op_latency_hist *h, op_latency_summary *summary)
+{
+    uint64_t *percentiles[] = {&summary->p50, &summary->p90, &summary->p99, &summary->p999};
+    uint64_t ranks[4];
+    uint64_t seen = 0;
+    size_t next = 0;
+
+    memset(summary, 0, sizeof(*summary));
+    for (size_t i = 0; i < OP_LATENCY_NB_BUCKETS; i++) {
+        summary->count += h->buckets[i];
+    }
+    if (summary->count == 0) {
+        return;
+    }
+    /* rank of the p-th percentile is ceil(count * p) */
+    ranks[0] = (summary->count * 500 + 999) / 1000;
+    ranks[1] = (summary->count * 900 + 999) / 1000;
+    ranks[2] = (summary->count * 990 + 999) / 1000;
+    ranks[3] = (summary->count * 999 + 999) / 1000;
+
+    for (size_t i = 0; i < OP_LATENCY_NB_BUCKETS; i++) {
+        if (h->buckets[i] == 0) {
+            continue;
+        }
+        seen += h->buckets[i];
+        while (next < 4 && seen >= ranks[next]) {
+            *percentiles[next++] = op_latency_bucket_value(i);
+        }
+        summary->max = op_latency_bucket_value(i);
+    }
+}
+
+/*
+ * Summarizes the histograms of a backend, or of the whole server
+ * if be is NULL.
+ */
+void
+op_latency_summarize(Slapi_Backend *be, op_latency_summary summary[OP_LATENCY_NB_TYPES][OP_LATENCY_NB_KINDS])
+{
+    op_latency_set **be_slots = NULL;
+    op_latency_hist total;
+
+    if (be && be->be_latency) {
+        be_slots = __atomic_load_n(&be->be_latency->slots, __ATOMIC_ACQUIRE);
+    }
+    for (size_t type = 0; type < OP_LATENCY_NB_TYPES; type++) {
+        for (size_t kind = 0; kind < OP_LATENCY_NB_KINDS; kind++) {
+            memset(&total, 0, sizeof(total));
+            for (int32_t slot = 0; slot < op_latency_nb_slots; slot++) {
+                if (be == NULL) {
+                    op_latency_hist_add(&total, &op_latency_slots[slot].hist[type][kind]);
+                } else if (be_slots) {
+                    op_latency_set *set = __atomic_load_n(&be_slots[slot], __ATOMIC_ACQUIRE);
+                    if (set) {
+                        op_latency_hist_add(&total, &set->hist[type][kind]);
+                    }
+                }
+            }
+            op_latency_hist_summarize(&total, &summary[type][kind]);
+        }
+    }
+}
+
+static void
+op_latency_summary_format(const op_latency_summary *summary, char *buf, size_t bufsize)
+{
+    snprintf(buf, bufsize, "count=%" PRIu64 " p50=%" PRIu64 " p90=%" PRIu64
+                           " p99=%" PRIu64 " p999=%" PRIu64 " max=%" PRIu64,
+             summary->count, summary->p50, summary->p90,
+             summary->p99, summary->p999, summary->max);
+}
+
+/*
+ * Fills cn=latency,cn=monitor.  Times are in microseconds.
+ *
+ *   search-subtree-optime: count=12 p50=95 p90=151 p99=431 p999=431 max=431
+ *   backend-latency: userRoot search-subtree-optime count=12 p50=95 ...
+ */
+void
+op_latency_as_entry(Slapi_Entry *e)
+{
+    op_latency_summary summary[OP_LATENCY_NB_TYPES][OP_LATENCY_NB_KINDS];
+    Slapi_Backend *be;
+    char *cookie = NULL;
+    char attr[64];
+    char value[256];
+
+    op_latency_summarize(NULL, summary);
+    for (size_t type = 0; type < OP_LATENCY_NB_TYPES; type++) {
+        for (size_t kind = 0; kind < OP_LATENCY_NB_KINDS; kind++) {
+            snprintf(attr, sizeof(attr), "%s-%s", op_latency_type_names[type], op_latency_kind_names[kind]);
+            op_latency_summary_format(&summary[type][kind], value, sizeof(value));
+            slapi_entry_attr_set_charptr(e, attr, value);
+        }
+    }
+
+    slapi_entry_attr_delete(e, "backend-latency");
+    for (be = slapi_get_first_backend(&cookie); be; be = slapi_get_next_backend(cookie)) {
+        if (be->be_latency == NULL) {
+            continue;
+        }
+        op_latency_summarize(be, summary);
+        for (size_t type = 0; type < OP_LATENCY_NB_TYPES; type++) {
+            for (size_t kind = 0; kind < OP_LATENCY_NB_KINDS; kind++) {
+                char stats[200];
+                if (summary[type][kind].count == 0) {
+                    continue;
+                }
+                op_latency_summary_format(&summary[type][kind], stats, sizeof(stats));
+                snprintf(value, sizeof(value), "%s %s-%s %s", be->be_name,
+                         op_latency_type_names[type], op_latency_kind_names[kind], stats);
+                slapi_entry_add_string(e, "backend-latency", value);
+            }
+        }
+    }
+    slapi_ch_free((void **)&cookie);
+}
@@ -685,6 +685,39 @@ op_stat_set_operation_extension(Slapi_PBlock *pb, Op_stat *op_stat)
                                op_stat_handle, (void *)op_stat);
 }
 
+/*
+ * Returns the search statistics to fill in, when they are wanted for this
+ * operation: index reads in the stat log, or a search explain control.
+ * Returns NULL otherwise.
+ */
+Op_search_stat *
+op_stat_get_search_stat(Slapi_PBlock *pb)
+{
+    Slapi_Operation *op;
+    Op_stat *op_stat;
+
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    if (op == NULL) {
+        return NULL;
+    }
+    if (!operation_is_flag_set(op, OP_FLAG_EXPLAIN) &&
+        !(LDAP_STAT_READ_INDEX & config_get_statlog_level())) {
+        return NULL;
+    }
+    op_stat = (Op_stat *)slapi_get_object_extension(op_stat_objtype, op, op_stat_handle);
+    return op_stat ? op_stat->search_stat : NULL;
+}
+
+/* Nanoseconds elapsed since start, to account the time of the search phases */
+uint64_t
+op_stat_elapsed_ns(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000000ULL + now.tv_nsec - start->tv_nsec;
+}
+
 /*
  * constructor for the operation object extension.
  */
@@ -722,6 +755,7 @@ op_stat_destructor(void *extension, void *object __attribute__((unused)), void *
             slapi_ch_free((void **) &keys);
             keys = next;
         }
+        slapi_ch_free_string(&op_statp->search_stat->filter_executed);
         slapi_ch_free((void **) &op_statp->search_stat);
     }
     slapi_ch_free((void **) &op_statp);
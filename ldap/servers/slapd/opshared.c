@@ -1006,6 +1006,12 @@ op_shared_search(Slapi_PBlock *pb, int send_result)
         plugin_call_plugins(pb, SLAPI_PLUGIN_POST_SEARCH_FAIL_FN);
     }
 
+    /* PAGED RESULTS: the cursor waits for the next page in the server wide
+     * store, if enabled; before the result so that any connection can ask for it */
+    if (op_is_pagedresults(operation)) {
+        pagedresults_park(pb);
+    }
+
     if (send_result) {
         if (rc == 0) {
             /* at least one backend returned something and there was no critical error
@@ -1134,6 +1140,11 @@ process_entry(Slapi_PBlock *pb, Slapi_Entry *e, int send_result)
 static void
 send_entry(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Operation *operation, char **attrs, int attrsonly, int *pnentries)
 {
+    /* dry run of the search explain control: the plan only, no entries */
+    if (operation_is_flag_set(operation, OP_FLAG_EXPLAIN_DRYRUN)) {
+        return;
+    }
+
     /*
      * It's a regular entry, or it's a referral and
      * managedsait control is on.  In either case, send
@@ -1143,6 +1154,12 @@ send_entry(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Operation *operation, char **
     case 0: /* entry sent ok */
         (*pnentries)++;
         slapi_pblock_set(pb, SLAPI_NENTRIES, pnentries);
+        if (operation_is_flag_set(operation, OP_FLAG_EXPLAIN)) {
+            Op_search_stat *explain = op_stat_get_search_stat(pb);
+            if (explain) {
+                explain->entries_returned++;
+            }
+        }
         break;
     case 1: /* entry not sent */
         break;
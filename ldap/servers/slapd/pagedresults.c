@@ -16,6 +16,8 @@
 
 static pthread_mutex_t *lock_hash = NULL;
 
+static void pr_store_cleanup(void);
+
 void
 pageresult_lock_init()
 {
@@ -28,6 +30,8 @@ pageresult_lock_init()
 void
 pageresult_lock_cleanup()
 {
+    /* the backends are still started, release the parked cursors */
+    pr_store_cleanup();
     for (size_t i=0; i<LOCK_HASH_SIZE; i++) {
         pthread_mutex_destroy(&lock_hash[i]);
     }
@@ -65,6 +69,439 @@ _pr_cleanup_one_slot(PagedResults *prp)
     prp->pr_mutex = prmutex;
 }
 
+/*
+ * Server wide store of the paged results cursors.
+ *
+ * By default a cursor (the search result set of the backend) stays in a slot
+ * of the connection between two pages, and the cookie is the index of the
+ * slot: the next page must be requested on the same connection.
+ *
+ * When nsslapd-pagedresults-cursor-cache-size is set, the cookie is an
+ * opaque random string instead, and the cursor is parked in this store when
+ * a page is sent.  The next page can then be requested on any connection
+ * bound with the same identity: the cursor is moved to a slot of that
+ * connection for the time of the operation.
+ *
+ * The parked cursors are bounded by the configured size.  Over it, the least
+ * recently used cursors are packed first (the backend compresses the
+ * candidates that are left), then released.  A client that comes back with
+ * a released cursor gets an invalid cookie error, as when its connection is
+ * closed.  Only the cursors of the inactive clients are packed: a client
+ * that reads its pages in a row does not pay for the compression.
+ *
+ * Packing and unpacking are linear in the size of the result set, so they
+ * are never done under the store lock: a cursor being packed stays in the
+ * store but is marked busy, and is neither taken nor released until it is
+ * done.
+ */
+typedef struct _pr_cursor
+{
+    char prc_cookie[PAGEDRESULTS_COOKIE_LEN + 1];
+    char *prc_ndn;                /* bind identity of the owner */
+    uint64_t prc_connid;          /* connection that parked the cursor */
+    PagedResults prc_pr;          /* the slot, without its pr_mutex */
+    size_t prc_size;              /* bytes accounted for in the store */
+    int prc_packed;               /* the backend packed the result set */
+    int prc_busy;                 /* being packed, out of the store lock */
+    struct _pr_cursor *prc_prev;  /* LRU list, most recently parked first */
+    struct _pr_cursor *prc_next;
+    struct _pr_cursor *prc_pack_next; /* cursors picked to be packed */
+} pr_cursor;
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t packed_cv; /* signaled when a busy cursor is packed */
+    PLHashTable *cookies;     /* cookie -> pr_cursor */
+    pr_cursor *head;
+    pr_cursor *tail;
+    uint64_t count;
+    uint64_t bytes;
+    time_t last_sweep;
+    /* monitor counters */
+    uint64_t parked;
+    uint64_t resumed;
+    uint64_t moved; /* resumed on another connection */
+    uint64_t packed;
+    uint64_t evicted;
+    uint64_t expired;
+} pr_store = {.lock = PTHREAD_MUTEX_INITIALIZER, .packed_cv = PTHREAD_COND_INITIALIZER};
+
+static int
+pr_cursor_is_cookie(struct berval *cookie)
+{
+    if (cookie->bv_len != PAGEDRESULTS_COOKIE_LEN) {
+        return 0;
+    }
+    for (size_t i = 0; i < cookie->bv_len; i++) {
+        if (!isxdigit((unsigned char)cookie->bv_val[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void
+pr_cursor_new_cookie(char cookie[PAGEDRESULTS_COOKIE_LEN + 1])
+{
+    unsigned char rnd[PAGEDRESULTS_COOKIE_LEN / 2];
+
+    slapi_rand_array(rnd, sizeof(rnd));
+    for (size_t i = 0; i < sizeof(rnd); i++) {
+        sprintf(cookie + 2 * i, "%02x", rnd[i]);
+    }
+    cookie[PAGEDRESULTS_COOKIE_LEN] = '\0';
+}
+
+static void
+pr_cursor_free(pr_cursor **cursor)
+{
+    _pr_cleanup_one_slot(&(*cursor)->prc_pr);
+    slapi_ch_free_string(&(*cursor)->prc_ndn);
+    slapi_ch_free((void **)cursor);
+}
+
+/* Release a list of cursors chained by prc_next, out of the store lock */
+static void
+pr_cursor_free_list(pr_cursor *list)
+{
+    while (list) {
+        pr_cursor *next = list->prc_next;
+        pr_cursor_free(&list);
+        list = next;
+    }
+}
+
+static void
+pr_store_unlink_nolock(pr_cursor *cursor)
+{
+    PL_HashTableRemove(pr_store.cookies, cursor->prc_cookie);
+    if (cursor->prc_prev) {
+        cursor->prc_prev->prc_next = cursor->prc_next;
+    } else {
+        pr_store.head = cursor->prc_next;
+    }
+    if (cursor->prc_next) {
+        cursor->prc_next->prc_prev = cursor->prc_prev;
+    } else {
+        pr_store.tail = cursor->prc_prev;
+    }
+    cursor->prc_prev = cursor->prc_next = NULL;
+    pr_store.count--;
+    pr_store.bytes -= cursor->prc_size;
+}
+
+/* Unlink the cursors whose time limit is exceeded, at most once a second */
+static void
+pr_store_expire_nolock(pr_cursor **released)
+{
+    time_t now = slapi_current_rel_time_t();
+    pr_cursor *cursor = pr_store.head;
+
+    if (now == pr_store.last_sweep) {
+        return;
+    }
+    pr_store.last_sweep = now;
+    while (cursor) {
+        pr_cursor *next = cursor->prc_next;
+        if (!cursor->prc_busy &&
+            slapi_timespec_expire_check(&(cursor->prc_pr.pr_timelimit_hr)) == TIMER_EXPIRED) {
+            pr_store_unlink_nolock(cursor);
+            cursor->prc_next = *released;
+            *released = cursor;
+            pr_store.expired++;
+        }
+        cursor = next;
+    }
+}
+
+static void
+pr_store_add(pr_cursor *cursor, uint64_t maxsize)
+{
+    pr_cursor *released = NULL;
+    pr_cursor *topack = NULL;
+    uint64_t topack_bytes = 0;
+
+    pthread_mutex_lock(&pr_store.lock);
+    if (NULL == pr_store.cookies) {
+        pr_store.cookies = PL_NewHashTable(0, PL_HashString, PL_CompareStrings,
+                                           PL_CompareValues, NULL, NULL);
+    }
+    pr_store_expire_nolock(&released);
+
+    PL_HashTableAdd(pr_store.cookies, cursor->prc_cookie, cursor);
+    cursor->prc_next = pr_store.head;
+    if (pr_store.head) {
+        pr_store.head->prc_prev = cursor;
+    } else {
+        pr_store.tail = cursor;
+    }
+    pr_store.head = cursor;
+    pr_store.count++;
+    pr_store.bytes += cursor->prc_size;
+    pr_store.parked++;
+
+    /* Over the limit: pick the least recently used cursors to pack ... */
+    for (pr_cursor *c = pr_store.tail; c && pr_store.bytes > maxsize + topack_bytes; c = c->prc_prev) {
+        if (c->prc_packed || c->prc_busy || NULL == c->prc_pr.pr_search_result_set ||
+            NULL == c->prc_pr.pr_current_be->be_search_results_pack) {
+            continue;
+        }
+        c->prc_busy = 1;
+        c->prc_pack_next = topack;
+        topack = c;
+        topack_bytes += c->prc_size;
+    }
+    pthread_mutex_unlock(&pr_store.lock);
+
+    /* ... pack them out of the lock ... */
+    while (topack) {
+        pr_cursor *c = topack;
+        Slapi_Backend *be = c->prc_pr.pr_current_be;
+        size_t size = sizeof(pr_cursor) + strlen(c->prc_ndn) + 1 +
+                      be->be_search_results_pack(c->prc_pr.pr_search_result_set, SLAPI_SEARCH_RESULTS_PACK);
+
+        /* c may be taken as soon as it is no longer busy */
+        topack = c->prc_pack_next;
+        pthread_mutex_lock(&pr_store.lock);
+        pr_store.bytes = pr_store.bytes - c->prc_size + size;
+        c->prc_size = size;
+        c->prc_packed = 1;
+        c->prc_busy = 0;
+        c->prc_pack_next = NULL;
+        pr_store.packed++;
+        pthread_cond_broadcast(&pr_store.packed_cv);
+        pthread_mutex_unlock(&pr_store.lock);
+    }
+
+    /* ... and release them if it is not enough.  The most recent is kept. */
+    pthread_mutex_lock(&pr_store.lock);
+    for (pr_cursor *c = pr_store.tail; c && c != pr_store.head && pr_store.bytes > maxsize;) {
+        pr_cursor *prev = c->prc_prev;
+        if (!c->prc_busy) {
+            pr_store_unlink_nolock(c);
+            c->prc_next = released;
+            released = c;
+            pr_store.evicted++;
+        }
+        c = prev;
+    }
+    pthread_mutex_unlock(&pr_store.lock);
+
+    pr_cursor_free_list(released);
+}
+
+/*
+ * Take the cursor of cookie out of the store, if it is owned by ndn.  The
+ * cursors of the anonymous clients can only be taken on the connection that
+ * parked them: anyone can bind anonymously.  The result set is unpacked.
+ */
+static pr_cursor *
+pr_store_take(const char *cookie, const char *ndn, uint64_t connid)
+{
+    pr_cursor *released = NULL;
+    pr_cursor *cursor = NULL;
+
+    pthread_mutex_lock(&pr_store.lock);
+    if (pr_store.cookies) {
+        pr_store_expire_nolock(&released);
+        while ((cursor = (pr_cursor *)PL_HashTableLookup(pr_store.cookies, cookie)) &&
+               cursor->prc_busy) {
+            /* being packed by another thread */
+            pthread_cond_wait(&pr_store.packed_cv, &pr_store.lock);
+        }
+    }
+    if (cursor && (strcmp(cursor->prc_ndn, ndn) ||
+                   ('\0' == *ndn && cursor->prc_connid != connid))) {
+        slapi_log_err(SLAPI_LOG_ERR, "pr_store_take",
+                      "conn=%" PRIu64 " paged results cookie of \"%s\" (conn=%" PRIu64 ") used by \"%s\"\n",
+                      connid, cursor->prc_ndn, cursor->prc_connid, ndn);
+        cursor = NULL;
+    } else if (cursor) {
+        pr_store_unlink_nolock(cursor);
+        pr_store.resumed++;
+        if (cursor->prc_connid != connid) {
+            pr_store.moved++;
+        }
+    }
+    pthread_mutex_unlock(&pr_store.lock);
+    pr_cursor_free_list(released);
+
+    if (cursor && cursor->prc_packed) {
+        Slapi_Backend *be = cursor->prc_pr.pr_current_be;
+        be->be_search_results_pack(cursor->prc_pr.pr_search_result_set, SLAPI_SEARCH_RESULTS_UNPACK);
+        cursor->prc_packed = 0;
+    }
+    return cursor;
+}
+
+/*
+ * Park again a cursor taken by pr_store_take that could not be resumed, so
+ * that the client can retry.
+ */
+static void
+pr_store_return(pr_cursor *cursor)
+{
+    Slapi_Backend *be = cursor->prc_pr.pr_current_be;
+
+    cursor->prc_size = sizeof(pr_cursor) + strlen(cursor->prc_ndn) + 1;
+    if (cursor->prc_pr.pr_search_result_set && be->be_search_results_pack) {
+        cursor->prc_size += be->be_search_results_pack(cursor->prc_pr.pr_search_result_set,
+                                                       SLAPI_SEARCH_RESULTS_SIZE);
+    }
+    pr_store_add(cursor, (uint64_t)config_get_pagedresults_cursor_cache_size());
+}
+
+/* Release the parked cursor of an abandoned request of conn */
+static int
+pr_store_abandon(uint64_t connid, ber_int_t msgid)
+{
+    pr_cursor *cursor = NULL;
+
+    pthread_mutex_lock(&pr_store.lock);
+    for (;;) {
+        for (cursor = pr_store.head; cursor; cursor = cursor->prc_next) {
+            if (cursor->prc_connid == connid && cursor->prc_pr.pr_msgid == msgid) {
+                break;
+            }
+        }
+        if (NULL == cursor || !cursor->prc_busy) {
+            break;
+        }
+        /* being packed by another thread: wait and look again */
+        pthread_cond_wait(&pr_store.packed_cv, &pr_store.lock);
+    }
+    if (cursor) {
+        pr_store_unlink_nolock(cursor);
+    }
+    pthread_mutex_unlock(&pr_store.lock);
+
+    if (cursor) {
+        pr_cursor_free(&cursor);
+        return 0;
+    }
+    return -1;
+}
+
+static void
+pr_store_cleanup(void)
+{
+    pr_cursor *list;
+
+    pthread_mutex_lock(&pr_store.lock);
+    list = pr_store.head;
+    pr_store.head = pr_store.tail = NULL;
+    pr_store.count = pr_store.bytes = 0;
+    if (pr_store.cookies) {
+        PL_HashTableDestroy(pr_store.cookies);
+        pr_store.cookies = NULL;
+    }
+    pthread_mutex_unlock(&pr_store.lock);
+
+    pr_cursor_free_list(list);
+}
+
+/*
+ * Move the cursor of a paged search that has more pages to the server wide
+ * store.  Called when all the backends are done with the current page.
+ */
+void
+pagedresults_park(Slapi_PBlock *pb)
+{
+    Connection *conn = NULL;
+    Operation *op = NULL;
+    pr_cursor *cursor = NULL;
+    int32_t maxsize = config_get_pagedresults_cursor_cache_size();
+    int index = -1;
+    int cookie = -1;
+    const char *ndn;
+
+    if (maxsize <= 0) {
+        return;
+    }
+    slapi_pblock_get(pb, SLAPI_OPERATION, &op);
+    slapi_pblock_get(pb, SLAPI_CONNECTION, &conn);
+    slapi_pblock_get(pb, SLAPI_PAGED_RESULTS_INDEX, &index);
+    slapi_pblock_get(pb, SLAPI_PAGED_RESULTS_COOKIE, &cookie);
+    if (!op_is_pagedresults(op) || NULL == conn || index < 0 || cookie < 0) {
+        /* not paged, or the search is over */
+        return;
+    }
+
+    pagedresults_lock(conn, index);
+    pthread_mutex_lock(pageresult_lock_get_addr(conn));
+    if (index < conn->c_pagedresults.prl_maxlen) {
+        PagedResults *prp = conn->c_pagedresults.prl_list + index;
+        if (prp->pr_current_be && prp->pr_cookie[0] &&
+            !(prp->pr_flags & CONN_FLAG_PAGEDRESULTS_ABANDONED)) {
+            PRLock *prmutex = prp->pr_mutex;
+            cursor = (pr_cursor *)slapi_ch_calloc(1, sizeof(pr_cursor));
+            cursor->prc_pr = *prp;
+            cursor->prc_pr.pr_mutex = NULL;
+            /* the slot is free again; pr_mutex is reused */
+            memset(prp, '\0', sizeof(PagedResults));
+            prp->pr_mutex = prmutex;
+            conn->c_pagedresults.prl_count--;
+        }
+    }
+    pthread_mutex_unlock(pageresult_lock_get_addr(conn));
+    pagedresults_unlock(conn, index);
+    if (NULL == cursor) {
+        return;
+    }
+
+    ndn = slapi_sdn_get_ndn(&op->o_sdn);
+    memcpy(cursor->prc_cookie, cursor->prc_pr.pr_cookie, sizeof(cursor->prc_cookie));
+    cursor->prc_ndn = slapi_ch_strdup(ndn ? ndn : "");
+    cursor->prc_connid = conn->c_connid;
+    cursor->prc_size = sizeof(pr_cursor) + strlen(cursor->prc_ndn) + 1;
+    if (cursor->prc_pr.pr_search_result_set && cursor->prc_pr.pr_current_be->be_search_results_pack) {
+        cursor->prc_size += cursor->prc_pr.pr_current_be->be_search_results_pack(
+            cursor->prc_pr.pr_search_result_set, SLAPI_SEARCH_RESULTS_SIZE);
+    }
+    pr_store_add(cursor, (uint64_t)maxsize);
+}
+
+/* cn=monitor attributes of the cursor store */
+void
+pagedresults_cursor_store_as_entry(Slapi_Entry *e)
+{
+    char buf[32];
+    struct berval val;
+    struct berval *vals[2] = {&val, NULL};
+    struct
+    {
+        const char *type;
+        uint64_t value;
+    } counters[8];
+    size_t n = 0;
+
+    pthread_mutex_lock(&pr_store.lock);
+    counters[n].type = "pagedresultscursors";
+    counters[n++].value = pr_store.count;
+    counters[n].type = "pagedresultscursorbytes";
+    counters[n++].value = pr_store.bytes;
+    counters[n].type = "pagedresultscursorsparked";
+    counters[n++].value = pr_store.parked;
+    counters[n].type = "pagedresultscursorsresumed";
+    counters[n++].value = pr_store.resumed;
+    counters[n].type = "pagedresultscursorsmoved";
+    counters[n++].value = pr_store.moved;
+    counters[n].type = "pagedresultscursorspacked";
+    counters[n++].value = pr_store.packed;
+    counters[n].type = "pagedresultscursorsevicted";
+    counters[n++].value = pr_store.evicted;
+    counters[n].type = "pagedresultscursorsexpired";
+    counters[n++].value = pr_store.expired;
+    pthread_mutex_unlock(&pr_store.lock);
+
+    for (size_t i = 0; i < n; i++) {
+        val.bv_len = snprintf(buf, sizeof(buf), "%" PRIu64, counters[i].value);
+        val.bv_val = buf;
+        attrlist_replace(&e->e_attrs, counters[i].type, vals);
+    }
+}
+
 /*
  * Parse the value from an LDAPv3 "Simple Paged Results" control.  They look
  * like this:
@@ -92,6 +529,8 @@ pagedresults_parse_control_value(Slapi_PBlock *pb,
     Operation *op = NULL;
     BerElement *ber = NULL;
     PagedResults *prp = NULL;
+    pr_cursor *cursor = NULL;
+    pr_cursor *returned = NULL;
     int i;
     int maxreqs = config_get_maxsimplepaged_per_conn();
 
@@ -129,12 +568,21 @@ pagedresults_parse_control_value(Slapi_PBlock *pb,
                       maxreqs);
         return LDAP_UNWILLING_TO_PERFORM;
     }
+    if (pr_cursor_is_cookie(&cookie)) {
+        /* the cursor may be parked in the server wide store */
+        char key[PAGEDRESULTS_COOKIE_LEN + 1];
+        const char *ndn = slapi_sdn_get_ndn(&op->o_sdn);
+
+        memcpy(key, cookie.bv_val, PAGEDRESULTS_COOKIE_LEN);
+        key[PAGEDRESULTS_COOKIE_LEN] = '\0';
+        cursor = pr_store_take(key, ndn ? ndn : "", conn->c_connid);
+    }
 
     pthread_mutex_lock(pageresult_lock_get_addr(conn));
     /* the ber encoding is no longer needed */
     ber_free(ber, 1);
-    if (cookie.bv_len <= 0) {
-        /* first time? */
+    if (cookie.bv_len <= 0 || cursor) {
+        /* first time, or a parked cursor that needs a slot */
         int maxlen = conn->c_pagedresults.prl_maxlen;
         if (conn->c_pagedresults.prl_count == maxlen) {
             if (0 == maxlen) { /* first time */
@@ -183,6 +631,32 @@ pagedresults_parse_control_value(Slapi_PBlock *pb,
             conn->c_pagedresults.prl_list[*index].pr_mutex = PR_NewLock();
         }
         conn->c_pagedresults.prl_count++;
+        if (cursor && (*index > -1) && (*index < conn->c_pagedresults.prl_maxlen)) {
+            /* resume the parked cursor in the slot */
+            prp = conn->c_pagedresults.prl_list + *index;
+            cursor->prc_pr.pr_mutex = prp->pr_mutex;
+            *prp = cursor->prc_pr;
+            memset(&cursor->prc_pr, '\0', sizeof(PagedResults));
+        }
+    } else if (pr_cursor_is_cookie(&cookie)) {
+        /* Not parked: the cursor is still in a slot of this connection. */
+        prp = conn->c_pagedresults.prl_list;
+        for (i = 0; i < conn->c_pagedresults.prl_maxlen; i++, prp++) {
+            if (prp->pr_current_be &&
+                !strncmp(prp->pr_cookie, cookie.bv_val, PAGEDRESULTS_COOKIE_LEN)) {
+                *index = i;
+                break;
+            }
+        }
+        if (*index < 0) {
+            rc = LDAP_PROTOCOL_ERROR;
+            slapi_log_err(SLAPI_LOG_ERR, "pagedresults_parse_control_value",
+                          "Invalid cookie: %.*s\n", (int)cookie.bv_len, cookie.bv_val);
+            goto bail;
+        }
+        if (!(prp->pr_search_result_set)) { /* freed and reused for the next backend. */
+            conn->c_pagedresults.prl_count++;
+        }
     } else {
         /* Repeated paged results request.
          * PagedResults is already allocated. */
@@ -223,6 +697,15 @@ pagedresults_parse_control_value(Slapi_PBlock *pb,
     }
 bail:
     slapi_ch_free((void **)&cookie.bv_val);
+    if (cursor && cursor->prc_pr.pr_current_be && LDAP_UNWILLING_TO_PERFORM == rc) {
+        /* too many paged searches on this connection: park it again,
+         * the client can resume it later */
+        returned = cursor;
+        cursor = NULL;
+    } else if (cursor) {
+        /* no slot for it; the result set is released if it was not resumed */
+        pr_cursor_free(&cursor);
+    }
     /* cleaning up the rest of the timedout or abandoned if any */
     prp = conn->c_pagedresults.prl_list;
     for (i = 0; i < conn->c_pagedresults.prl_maxlen; i++, prp++) {
@@ -239,12 +722,43 @@ bail:
         }
     }
     pthread_mutex_unlock(pageresult_lock_get_addr(conn));
+    if (returned) {
+        pr_store_return(returned);
+    }
 
     slapi_log_err(SLAPI_LOG_TRACE, "pagedresults_parse_control_value",
                   "<= idx %d\n", *index);
     return rc;
 }
 
+/*
+ * Cookie of the cursor store for the slot, created when the store is enabled.
+ * Returns NULL if the slot index is the cookie.
+ */
+static char *
+pagedresults_get_cookie(Slapi_PBlock *pb, int index)
+{
+    Connection *conn = NULL;
+    char *cookie = NULL;
+
+    slapi_pblock_get(pb, SLAPI_CONNECTION, &conn);
+    if (NULL == conn || index < 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(pageresult_lock_get_addr(conn));
+    if (index < conn->c_pagedresults.prl_maxlen) {
+        PagedResults *prp = conn->c_pagedresults.prl_list + index;
+        if ('\0' == prp->pr_cookie[0] && config_get_pagedresults_cursor_cache_size() > 0) {
+            pr_cursor_new_cookie(prp->pr_cookie);
+        }
+        if (prp->pr_cookie[0]) {
+            cookie = slapi_ch_strdup(prp->pr_cookie);
+        }
+    }
+    pthread_mutex_unlock(pageresult_lock_get_addr(conn));
+    return cookie;
+}
+
 /*
  * controlType = LDAP_CONTROL_PAGEDRESULTS;
  * criticality = n/a;
@@ -281,7 +795,10 @@ pagedresults_set_response_control(Slapi_PBlock *pb, int iscritical, ber_int_t es
         cookie_str = slapi_ch_strdup("");
     } else {
         cookie = index;
-        cookie_str = slapi_ch_smprintf("%d", index);
+        cookie_str = pagedresults_get_cookie(pb, index);
+        if (NULL == cookie_str) {
+            cookie_str = slapi_ch_smprintf("%d", index);
+        }
     }
     slapi_pblock_set(pb, SLAPI_PAGED_RESULTS_COOKIE, &cookie);
     ber_printf(ber, "{io}", estimate, cookie_str, strlen(cookie_str));
@@ -339,7 +856,11 @@ pagedresults_free_one(Connection *conn, Operation *op, int index)
                           conn->c_connid, conn->c_pagedresults.prl_count);
         } else if (index < conn->c_pagedresults.prl_maxlen) {
             PagedResults *prp = conn->c_pagedresults.prl_list + index;
+            char cookie[PAGEDRESULTS_COOKIE_LEN + 1];
+            /* the slot may be set for the next backend, keep its cookie */
+            memcpy(cookie, prp->pr_cookie, sizeof(cookie));
             _pr_cleanup_one_slot(prp);
+            memcpy(prp->pr_cookie, cookie, sizeof(cookie));
             conn->c_pagedresults.prl_count--;
             rc = 0;
         }
@@ -384,6 +905,10 @@ pagedresults_free_one_msgid(Connection *conn, ber_int_t msgid, pthread_mutex_t *
             slapi_log_err(SLAPI_LOG_TRACE,
                           "pagedresults_free_one_msgid_nolock", "<= %d\n", rc);
         }
+        if (rc) {
+            /* the request may wait for its next page in the cursor store */
+            rc = pr_store_abandon(conn->c_connid, msgid);
+        }
     }
 
     return rc;
@@ -818,6 +818,12 @@ slapi_pblock_get(Slapi_PBlock *pblock, int arg, void *value)
         }
         (*(VFP *)value) = pblock->pb_plugin->plg_prev_search_results;
         break;
+    case SLAPI_PLUGIN_DB_SEARCH_RESULTS_PACK_FN:
+        if (pblock->pb_plugin->plg_type != SLAPI_PLUGIN_DATABASE) {
+            return (-1);
+        }
+        (*(SFPI *)value) = pblock->pb_plugin->plg_search_results_pack;
+        break;
     case SLAPI_PLUGIN_DB_COMPARE_FN:
         if (pblock->pb_plugin->plg_type != SLAPI_PLUGIN_DATABASE) {
             return (-1);
@@ -2124,6 +2130,15 @@ slapi_pblock_get(Slapi_PBlock *pblock, int arg, void *value)
         }
         break;
 
+    /* db2archive */
+    case SLAPI_DB2ARCHIVE_BASE_DIR:
+        if (pblock->pb_task != NULL) {
+            (*(char **)value) = pblock->pb_task->backup_base_dir;
+        } else {
+            (*(char **)value) = NULL;
+        }
+        break;
+
 
     /* transaction arguments */
     case SLAPI_PARENT_TXN:
@@ -2748,6 +2763,12 @@ slapi_pblock_set(Slapi_PBlock *pblock, int arg, void *value)
         }
         pblock->pb_plugin->plg_prev_search_results = (VFP)value;
         break;
+    case SLAPI_PLUGIN_DB_SEARCH_RESULTS_PACK_FN:
+        if (pblock->pb_plugin->plg_type != SLAPI_PLUGIN_DATABASE) {
+            return (-1);
+        }
+        pblock->pb_plugin->plg_search_results_pack = (SFPI)value;
+        break;
     case SLAPI_PLUGIN_DB_COMPARE_FN:
         if (pblock->pb_plugin->plg_type != SLAPI_PLUGIN_DATABASE) {
             return (-1);
@@ -3932,6 +3953,12 @@ slapi_pblock_set(Slapi_PBlock *pblock, int arg, void *value)
         pblock->pb_task->dbverify_dbdir = (char *)value;
         break;
 
+    /* db2archive */
+    case SLAPI_DB2ARCHIVE_BASE_DIR:
+        _pblock_assert_pb_task(pblock);
+        pblock->pb_task->backup_base_dir = (char *)value;
+        break;
+
 
     /* transaction arguments */
     case SLAPI_PARENT_TXN:
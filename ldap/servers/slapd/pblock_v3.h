@@ -46,6 +46,7 @@ typedef struct _slapi_pblock_task
     char *seq_attrname;
     char *seq_val;
     char *dbverify_dbdir;
+    char *backup_base_dir;
     char *ldif_file;
     char **db2index_attrs;
 
@@ -594,6 +594,14 @@ int config_get_enable_turbo_mode(void);
 int config_set_enable_turbo_mode(const char *attrname, char *value, char *errorbuf, int apply);
 int config_get_connection_buffer(void);
 int config_set_connection_buffer(const char *attrname, char *value, char *errorbuf, int apply);
+int32_t config_get_connection_buffer_max(void);
+int32_t config_set_connection_buffer_max(const char *attrname, char *value, char *errorbuf, int apply);
+int32_t config_get_pagedresults_cursor_cache_size(void);
+int32_t config_set_pagedresults_cursor_cache_size(const char *attrname, char *value, char *errorbuf, int apply);
+int32_t config_get_psearch_threads(void);
+int32_t config_set_psearch_threads(const char *attrname, char *value, char *errorbuf, int apply);
+int32_t config_get_psearch_max_queue(void);
+int32_t config_set_psearch_max_queue(const char *attrname, char *value, char *errorbuf, int apply);
 int config_get_connection_nocanon(void);
 int config_get_plugin_logging(void);
 int config_set_connection_nocanon(const char *attrname, char *value, char *errorbuf, int apply);
@@ -1312,6 +1320,7 @@ struct snmp_vars_t *g_get_global_snmp_vars(void);
 void alloc_global_snmp_vars(void);
 void alloc_per_thread_snmp_vars(int32_t maxthread);
 void thread_private_snmp_vars_set_idx(int32_t idx);
+int thread_private_snmp_vars_get_idx(void);
 struct snmp_vars_t *g_get_per_thread_snmp_vars(void);
 struct snmp_vars_t *g_get_first_thread_snmp_vars(int *cookie);
 struct snmp_vars_t *g_get_next_thread_snmp_vars(int *cookie);
@@ -1339,7 +1348,7 @@ int modify_root_dse(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *entryAfter, i
  */
 void ps_init_psearch_system(void);
 void ps_stop_psearch_system(void);
-void ps_add(Slapi_PBlock *pb, ber_int_t changetypes, int send_entchg_controls);
+int ps_add(Slapi_PBlock *pb, ber_int_t changetypes, int send_entchg_controls);
 void ps_wakeup_all(void);
 void ps_service_persistent_searches(Slapi_Entry *e, Slapi_Entry *eprev, ber_int_t chgtype, ber_int_t chgnum);
 int ps_parse_control_value(struct berval *psbvp, ber_int_t *changetypesp, int *changesonlyp, int *returnecsp);
@@ -1505,6 +1514,16 @@ void counters_to_errors_log(const char *text);
  */
 void snmp_as_entry(Slapi_Entry *e);
 
+/*
+ * op_latency.c
+ */
+void op_latency_init(int32_t nb_slots);
+op_latency_backend *op_latency_backend_new(void);
+void op_latency_backend_free(op_latency_backend **latency);
+void op_latency_record(Slapi_PBlock *pb, Operation *op);
+void op_latency_summarize(Slapi_Backend *be, op_latency_summary summary[OP_LATENCY_NB_TYPES][OP_LATENCY_NB_KINDS]);
+void op_latency_as_entry(Slapi_Entry *e);
+
 /*
  * subentry.c
  */
@@ -1517,6 +1536,7 @@ void subentry_create_filter(Slapi_Filter **filter);
 void vattr_init(void);
 void vattr_cleanup(void);
 void vattr_check(void);
+int vattr_map_has_type(const Slapi_DN *namespace_dn, const char *type);
 
 /*
  * slapd_plhash.c - supplement to NSPR plhash
@@ -1629,6 +1649,8 @@ void pagedresults_lock(Connection *conn, int index);
 void pagedresults_unlock(Connection *conn, int index);
 int pagedresults_is_abandoned_or_notavailable(Connection *conn, int locked, int index);
 int pagedresults_set_search_result_pb(Slapi_PBlock *pb, void *sr, int locked);
+void pagedresults_park(Slapi_PBlock *pb);
+void pagedresults_cursor_store_as_entry(Slapi_Entry *e);
 
 /*
  * sort.c
@@ -1640,4 +1662,10 @@ int sort_make_sort_response_control(Slapi_PBlock *pb, int code, char *error_type
  */
 int subentries_parse_request_control(struct berval *subentries_spec_ber);
 
+/*
+ * explain.c
+ */
+int explain_parse_request_control(struct berval *explain_spec_ber, int *dryrun);
+void explain_add_response_control(Slapi_PBlock *pb, Slapi_Operation *op);
+
 #endif /* _PROTO_SLAP */
@@ -28,7 +28,7 @@
 /*
  * A structure used to create a linked list
  * of entries being sent by a particular persistent
- * search result thread.
+ * search.
  * The ctrl is an "Entry Modify Notification" control
  * which we may send back with entries.
  */
@@ -47,23 +47,62 @@ typedef struct _psearch
     Slapi_PBlock *ps_pblock;
     PRLock *ps_lock;
     uint64_t ps_complete;
+    uint64_t ps_overflow; /* the entry queue hit nsslapd-psearch-max-queue */
     PSEQNode *ps_eq_head;
     PSEQNode *ps_eq_tail;
+    int32_t ps_eq_len; /* entries in the queue, protected by ps_lock */
     time_t ps_lasttime;
     ber_int_t ps_changetypes;
     int ps_send_entchg_controls;
-    struct _psearch *ps_next;
+    int ps_conn_acq_flag; /* non zero if the connection could not be acquired */
+    int ps_scheduled;     /* queued or being served, protected by pl_cvarlock */
+    int ps_pending;       /* woken up while being served, protected by pl_cvarlock */
+    struct timespec ps_blocked_since; /* first failed attempt to write to the client, or 0 */
+    struct _psearch_group *ps_group;
+    struct _psearch *ps_next;  /* next persistent search of the group */
+    struct _psearch *ps_rnext; /* next persistent search ready to be served */
 } PSearch;
 
 /*
- * A list of outstanding persistent searches.
+ * The persistent searches with the same base and the same required
+ * attribute type.  A change to an entry that has neither this type nor
+ * a virtual attribute of this type cannot match their filters.
+ */
+typedef struct _psearch_group
+{
+    char *pg_type; /* normalized type, or NULL if the filter requires none */
+    PSearch *pg_head;
+    struct _psearch_base *pg_base;
+    struct _psearch_group *pg_next;
+} PSearch_Group;
+
+/*
+ * The persistent searches on a given base DN
+ */
+typedef struct _psearch_base
+{
+    char *pbs_ndn;
+    PSearch_Group *pbs_groups;
+} PSearch_Base;
+
+/*
+ * The outstanding persistent searches, indexed by their base DN,
+ * and the queue of the ones with work for the dispatcher threads.
  */
 typedef struct _psearch_list
 {
     Slapi_RWLock *pl_rwlock;     /* R/W lock struct to serialize access */
-    PSearch *pl_head;            /* Head of list */
-    pthread_mutex_t pl_cvarlock; /* Lock for cvar */
-    pthread_cond_t pl_cvar;      /* ps threads sleep on this */
+    PLHashTable *pl_bases;       /* normalized base DN -> PSearch_Base */
+    int32_t pl_count;            /* number of persistent searches */
+    pthread_mutex_t pl_cvarlock; /* Lock for cvar and the ready queue */
+    pthread_cond_t pl_cvar;      /* dispatcher threads sleep on this */
+    PSearch *pl_ready_head;      /* persistent searches to serve */
+    PSearch *pl_ready_tail;
+    PSearch *pl_blocked_head;    /* persistent searches whose client is not reading */
+    PSearch *pl_blocked_tail;
+    struct timespec pl_retry_at; /* when the blocked ones are tried again */
+    int32_t pl_nthreads; /* running dispatcher threads */
+    int pl_stopping;
 } PSearch_List;
 
 /*
@@ -74,6 +113,17 @@ typedef struct _psearch_list
 #define PSL_LOCK_WRITE() slapi_rwlock_wrlock(psearch_list->pl_rwlock)
 #define PSL_UNLOCK_WRITE() slapi_rwlock_unlock(psearch_list->pl_rwlock)
 
+/*
+ * Maximum number of entries a dispatcher thread sends to a client
+ * before it serves the other persistent searches.
+ */
+#define PS_BATCH 64
+
+/*
+ * How long a persistent search whose client output would block is set
+ * aside before the dispatcher threads try it again, in milliseconds.
+ */
+#define PS_BLOCKED_RETRY 100
 
 /*
  * Convenience macro for checking if the Persistent Search subsystem has
@@ -85,10 +135,11 @@ typedef struct _psearch_list
 static PSearch_List *psearch_list = NULL;
 
 /* Forward declarations */
-static void ps_send_results(void *arg);
+static void ps_dispatch(void *arg);
 static PSearch *psearch_alloc(void);
 static void ps_add_ps(PSearch *ps);
 static void ps_remove(PSearch *dps);
+static void ps_schedule(PSearch *ps);
 static void pe_ch_free(PSEQNode **pe);
 static int create_entrychange_control(ber_int_t chgtype, ber_int_t chgnum, const char *prevdn, LDAPControl **ctrlp);
 
@@ -102,6 +153,7 @@ void
 ps_init_psearch_system()
 {
     if (!PS_IS_INITIALIZED()) {
+        pthread_condattr_t condAttr;
         int32_t rc = 0;
 
         psearch_list = (PSearch_List *)slapi_ch_calloc(1, sizeof(PSearch_List));
@@ -117,16 +169,60 @@ ps_init_psearch_system()
                           rc, strerror(rc));
             exit(1);
         }
-        if ((rc = pthread_cond_init(&(psearch_list->pl_cvar), NULL)) != 0) {
-            slapi_log_err(SLAPI_LOG_ERR, "housekeeping_start",
-                          "housekeeping cannot create new condition variable.  error %d (%s)\n",
+        if ((rc = pthread_condattr_init(&condAttr)) != 0) {
+            slapi_log_err(SLAPI_LOG_ERR, "ps_init_psearch_system",
+                          "Cannot create new condition attribute variable.  error %d (%s)\n",
+                          rc, strerror(rc));
+            exit(1);
+        }
+        if ((rc = pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC)) != 0) {
+            slapi_log_err(SLAPI_LOG_ERR, "ps_init_psearch_system",
+                          "Cannot set condition attr clock.  error %d (%s)\n",
+                          rc, strerror(rc));
+            exit(1);
+        }
+        if ((rc = pthread_cond_init(&(psearch_list->pl_cvar), &condAttr)) != 0) {
+            slapi_log_err(SLAPI_LOG_ERR, "ps_init_psearch_system",
+                          "Cannot create new condition variable.  error %d (%s)\n",
                           rc, strerror(rc));
             exit(1);
         }
-        psearch_list->pl_head = NULL;
+        pthread_condattr_destroy(&condAttr);
+        psearch_list->pl_bases = PL_NewHashTable(0, PL_HashString, PL_CompareStrings,
+                                                 PL_CompareValues, NULL, NULL);
     }
 }
 
+typedef void (*ps_foreach_fn)(PSearch *ps);
+
+static PRIntn
+ps_foreach_base(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg)
+{
+    PSearch_Base *pbs = (PSearch_Base *)he->value;
+    ps_foreach_fn fn = (ps_foreach_fn)arg;
+
+    for (PSearch_Group *pg = pbs->pbs_groups; pg; pg = pg->pg_next) {
+        for (PSearch *ps = pg->pg_head; ps; ps = ps->ps_next) {
+            fn(ps);
+        }
+    }
+    return HT_ENUMERATE_NEXT;
+}
+
+/*
+ * Call fn on every persistent search.  The caller holds pl_rwlock.
+ */
+static void
+ps_foreach(ps_foreach_fn fn)
+{
+    PL_HashTableEnumerateEntries(psearch_list->pl_bases, ps_foreach_base, (void *)fn);
+}
+
+static void
+ps_set_complete(PSearch *ps)
+{
+    slapi_atomic_incr_64(&(ps->ps_complete), __ATOMIC_RELEASE);
+}
 
 /*
  * Close all outstanding persistent searches.
@@ -135,95 +231,164 @@ ps_init_psearch_system()
 void
 ps_stop_psearch_system()
 {
-    PSearch *ps;
-
     if (PS_IS_INITIALIZED()) {
         PSL_LOCK_WRITE();
-        for (ps = psearch_list->pl_head; NULL != ps; ps = ps->ps_next) {
-            slapi_atomic_incr_64(&(ps->ps_complete), __ATOMIC_RELEASE);
-        }
+        ps_foreach(ps_set_complete);
         PSL_UNLOCK_WRITE();
         ps_wakeup_all();
+
+        /* The dispatcher threads exit once the ready queue is drained */
+        pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+        psearch_list->pl_stopping = 1;
+        pthread_cond_broadcast(&(psearch_list->pl_cvar));
+        pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+    }
+}
+
+/*
+ * Start the dispatcher threads, the first time a persistent search
+ * is added.  Returns the number of running dispatcher threads.
+ */
+static int32_t
+ps_start_dispatchers(void)
+{
+    int32_t nthreads;
+
+    pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+    if (psearch_list->pl_nthreads == 0 && !psearch_list->pl_stopping) {
+        int32_t maxthreads = config_get_psearch_threads();
+
+        for (int32_t i = 0; i < maxthreads; i++) {
+            PRThread *ps_tid = PR_CreateThread(PR_USER_THREAD, ps_dispatch,
+                                               NULL, PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                               PR_UNJOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+            if (NULL == ps_tid) {
+                int prerr = PR_GetError();
+                slapi_log_err(SLAPI_LOG_ERR, "ps_start_dispatchers",
+                              "PR_CreateThread() failed, %d of %d dispatcher threads started: " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                              i, maxthreads, prerr, slapd_pr_strerror(prerr));
+                break;
+            }
+            psearch_list->pl_nthreads++;
+        }
+    }
+    nthreads = psearch_list->pl_nthreads;
+    pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+
+    return nthreads;
+}
+
+/*
+ * The persistent search can't be registered: end the operation with an
+ * error, as a regular search, instead of leaving the client waiting.
+ */
+static void
+ps_add_failed(Slapi_PBlock *pb, Operation *pb_op, const char *msg)
+{
+    slapi_log_err(SLAPI_LOG_ERR, "ps_add", "%s - psearch aborted\n", msg);
+    if (pb_op) {
+        pb_op->o_flags &= ~OP_FLAG_PS;
     }
+    send_ldap_result(pb, LDAP_UNWILLING_TO_PERFORM, NULL, (char *)msg, 0, NULL);
 }
 
 /*
  * Add the given pblock to the list of outstanding persistent searches.
- * Then, start a thread to send the results to the client as they
+ * The results are sent to the client by the dispatcher threads as they
  * are dispatched by add, modify, and modrdn operations.
+ *
+ * Returns 0 on success.  Otherwise the result was sent, the operation is no
+ * longer a persistent search and the caller still owns the pblock content.
  */
-void
+int
 ps_add(Slapi_PBlock *pb, ber_int_t changetypes, int send_entchg_controls)
 {
     PSearch *ps;
-    PRThread *ps_tid;
+    Connection *pb_conn = NULL;
+    Operation *pb_op = NULL;
 
     if (PS_IS_INITIALIZED() && NULL != pb) {
+        slapi_pblock_get(pb, SLAPI_CONNECTION, &pb_conn);
+        slapi_pblock_get(pb, SLAPI_OPERATION, &pb_op);
+        if (ps_start_dispatchers() == 0) {
+            ps_add_failed(pb, pb_op, "No persistent search dispatcher thread");
+            return -1;
+        }
+        if (pb_conn == NULL) {
+            ps_add_failed(pb, pb_op, "No connection for the persistent search");
+            return -1;
+        }
+
         /* Create the new node */
         ps = psearch_alloc();
         if (!ps) {
-            return; /* Error is logged by psearch_alloc */
+            ps_add_failed(pb, pb_op, "Can not allocate the persistent search");
+            return -1;
         }
         ps->ps_pblock = slapi_pblock_clone(pb);
         ps->ps_changetypes = changetypes;
         ps->ps_send_entchg_controls = send_entchg_controls;
 
-        /* Add it to the head of the list of persistent searches */
-        ps_add_ps(ps);
+        /* need to acquire a reference to this connection so that it will not
+           be released or cleaned up out from under us */
+        pthread_mutex_lock(&(pb_conn->c_mutex));
+        ps->ps_conn_acq_flag = connection_acquire_nolock(pb_conn);
+        pthread_mutex_unlock(&(pb_conn->c_mutex));
 
-        /* Start a thread to send the results */
-        ps_tid = PR_CreateThread(PR_USER_THREAD, ps_send_results,
-                                 (void *)ps, PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
-                                 PR_UNJOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
-
-        /* Checking if the thread is succesfully created and
-         * if the thread is not created succesfully.... we send
-         * error messages to the Log file
-         */
-        if (NULL == ps_tid) {
-            int prerr;
-            prerr = PR_GetError();
-            slapi_log_err(SLAPI_LOG_ERR, "ps_add", "PR_CreateThread()failed in the "
-                                                   "ps_add function: " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
-                          prerr, slapd_pr_strerror(prerr));
+        ps_add_ps(ps);
 
-            /* Now remove the ps from the list so call the function ps_remove */
-            ps_remove(ps);
-            PR_DestroyLock(ps->ps_lock);
-            ps->ps_lock = NULL;
-            slapi_ch_free((void **)&ps->ps_pblock);
-            slapi_ch_free((void **)&ps);
+        if (ps->ps_conn_acq_flag) {
+            slapi_log_err(SLAPI_LOG_CONNS, "ps_add",
+                          "conn=%" PRIu64 " op=%d Could not acquire the connection - psearch aborted\n",
+                          pb_conn->c_connid, pb_op ? pb_op->o_opid : -1);
+            /* a dispatcher thread releases it */
+            ps_schedule(ps);
         }
     }
+    return 0;
 }
 
-
 /*
  * Remove the given PSearch from the list of outstanding persistent
- * searches and delete its resources.
+ * searches.
  */
 static void
 ps_remove(PSearch *dps)
 {
-    PSearch *ps;
+    PSearch_Group *pg;
+    PSearch_Base *pbs;
+    PSearch **psp;
 
     if (PS_IS_INITIALIZED() && NULL != dps) {
         PSL_LOCK_WRITE();
-        if (dps == psearch_list->pl_head) {
-            /* Remove from head */
-            psearch_list->pl_head = psearch_list->pl_head->ps_next;
-        } else {
-            /* Find and remove from list */
-            ps = psearch_list->pl_head;
-            while (NULL != ps->ps_next) {
-                if (ps->ps_next == dps) {
-                    ps->ps_next = ps->ps_next->ps_next;
+        pg = dps->ps_group;
+        for (psp = &pg->pg_head; *psp; psp = &(*psp)->ps_next) {
+            if (*psp == dps) {
+                *psp = dps->ps_next;
+                psearch_list->pl_count--;
+                break;
+            }
+        }
+        if (pg->pg_head == NULL) {
+            PSearch_Group **pgp;
+
+            pbs = pg->pg_base;
+            for (pgp = &pbs->pbs_groups; *pgp; pgp = &(*pgp)->pg_next) {
+                if (*pgp == pg) {
+                    *pgp = pg->pg_next;
                     break;
-                } else {
-                    ps = ps->ps_next;
                 }
             }
+            slapi_ch_free_string(&pg->pg_type);
+            slapi_ch_free((void **)&pg);
+            if (pbs->pbs_groups == NULL) {
+                PL_HashTableRemove(psearch_list->pl_bases, pbs->pbs_ndn);
+                slapi_ch_free_string(&pbs->pbs_ndn);
+                slapi_ch_free((void **)&pbs);
+            }
         }
+        dps->ps_group = NULL;
+        dps->ps_next = NULL;
         PSL_UNLOCK_WRITE();
     }
 }
@@ -249,131 +414,25 @@ pe_ch_free(PSEQNode **pe)
     }
 }
 
-
 /*
- * Thread routine for sending search results to a client
- * which is persistently waiting for them.
- *
- * This routine will terminate when either (a) the ps_complete
- * flag is set, or (b) the associated operation is abandoned.
- * In any case, the thread won't notice until it wakes from
- * sleeping on the ps_list condition variable, so it needs
- * to be awakened.
+ * End a persistent search: remove it from the list, release its
+ * operation and connection and free it.
  */
 static void
-ps_send_results(void *arg)
+ps_finish(PSearch *ps)
 {
-    PSearch *ps = (PSearch *)arg;
     PSEQNode *peq, *peqnext;
     struct slapi_filter *filter = 0;
     char *base = NULL;
     Slapi_DN *sdn = NULL;
     char *fstr = NULL;
     char **pbattrs = NULL;
-    int conn_acq_flag = 0;
     Slapi_Connection *conn = NULL;
-    Connection *pb_conn = NULL;
     Operation *pb_op = NULL;
 
-    g_incr_active_threadcnt();
-
-    slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &pb_conn);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &conn);
     slapi_pblock_get(ps->ps_pblock, SLAPI_OPERATION, &pb_op);
 
-    if (pb_conn == NULL) {
-        slapi_log_err(SLAPI_LOG_ERR, "ps_send_results", "pb_conn is NULL\n");
-        return;
-    }
-
-    /* need to acquire a reference to this connection so that it will not
-       be released or cleaned up out from under us */
-    pthread_mutex_lock(&(pb_conn->c_mutex));
-    conn_acq_flag = connection_acquire_nolock(pb_conn);
-    pthread_mutex_unlock(&(pb_conn->c_mutex));
-
-    if (conn_acq_flag) {
-        slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
-                      "conn=%" PRIu64 " op=%d Could not acquire the connection - psearch aborted\n",
-                      pb_conn->c_connid, pb_op ? pb_op->o_opid : -1);
-    }
-
-    pthread_mutex_lock(&(psearch_list->pl_cvarlock));
-
-    while ((conn_acq_flag == 0) && slapi_atomic_load_64(&(ps->ps_complete), __ATOMIC_ACQUIRE) == 0) {
-        /* Check for an abandoned operation */
-        if (pb_op == NULL || slapi_op_abandoned(ps->ps_pblock)) {
-            slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
-                          "conn=%" PRIu64 " op=%d The operation has been abandoned\n",
-                          pb_conn->c_connid, pb_op ? pb_op->o_opid : -1);
-            break;
-        }
-        if (NULL == ps->ps_eq_head) {
-            /* Nothing to do */
-            pthread_cond_wait(&(psearch_list->pl_cvar), &(psearch_list->pl_cvarlock));
-        } else {
-            /* dequeue the item */
-            int attrsonly;
-            char **attrs;
-            LDAPControl **ectrls;
-            Slapi_Entry *ec;
-            Slapi_Filter *f = NULL;
-
-            PR_Lock(ps->ps_lock);
-
-            peq = ps->ps_eq_head;
-            ps->ps_eq_head = peq->pe_next;
-            if (NULL == ps->ps_eq_head) {
-                ps->ps_eq_tail = NULL;
-            }
-
-            PR_Unlock(ps->ps_lock);
-
-            /* Get all the information we need to send the result */
-            ec = peq->pe_entry;
-            slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_ATTRS, &attrs);
-            slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_ATTRSONLY, &attrsonly);
-            if (!ps->ps_send_entchg_controls || peq->pe_ctrls[0] == NULL) {
-                ectrls = NULL;
-            } else {
-                ectrls = peq->pe_ctrls;
-            }
-
-            /*
-             * Send the result.  Since send_ldap_search_entry can block for
-             * up to 30 minutes, we relinquish all locks before calling it.
-             */
-            pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
-
-            /*
-             * The entry is in the right scope and matches the filter
-             * but we need to redo the filter test here to check access
-             * controls. See the comments at the slapi_filter_test()
-             * call in ps_service_persistent_searches().
-            */
-            slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
-
-            /* See if the entry meets the filter and ACL criteria */
-            if (slapi_vattr_filter_test(ps->ps_pblock, ec, f,
-                                        1 /* verify_access */) == 0) {
-                int rc = 0;
-                slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_RESULT_ENTRY, ec);
-                rc = send_ldap_search_entry(ps->ps_pblock, ec,
-                                            ectrls, attrs, attrsonly);
-                if (rc) {
-                    slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
-                                  "conn=%" PRIu64 " op=%d Error %d sending entry %s with op status %d\n",
-                                  pb_conn->c_connid, pb_op ? pb_op->o_opid: -1,
-                                  rc, slapi_entry_get_dn_const(ec), pb_op ? pb_op->o_status : -1);
-                }
-            }
-
-            pthread_mutex_lock(&(psearch_list->pl_cvarlock));
-
-            /* Deallocate our wrapper for this entry */
-            pe_ch_free(&peq);
-        }
-    }
-    pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
     ps_remove(ps);
 
     /* indicate the end of search */
@@ -404,18 +463,17 @@ ps_send_results(void *arg)
     slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_FILTER, NULL);
     slapi_filter_free(filter, 1);
 
-    conn = pb_conn; /* save to release later - connection_remove_operation_ext will NULL the pb_conn */
-    /* Clean up the connection structure */
+    /* Clean up the connection structure, connection_remove_operation_ext will NULL the pb_conn */
     pthread_mutex_lock(&(conn->c_mutex));
 
-    slapi_log_err(SLAPI_LOG_CONNS, "ps_send_results",
+    slapi_log_err(SLAPI_LOG_CONNS, "ps_finish",
                   "conn=%" PRIu64 " op=%d Releasing the connection and operation\n",
                   conn->c_connid, pb_op ? pb_op->o_opid : -1);
     /* Delete this op from the connection's list */
     connection_remove_operation_ext(ps->ps_pblock, conn, pb_op);
 
     /* Decrement the connection refcnt */
-    if (conn_acq_flag == 0) { /* we acquired it, so release it */
+    if (ps->ps_conn_acq_flag == 0) { /* we acquired it, so release it */
         connection_release_nolock(conn);
     }
     pthread_mutex_unlock(&(conn->c_mutex));
@@ -430,6 +488,342 @@ ps_send_results(void *arg)
         pe_ch_free(&peq);
     }
     slapi_ch_free((void **)&ps);
+}
+
+/*
+ * Check, without waiting, that a result can be written to the client.
+ */
+static int
+ps_conn_writable(Connection *conn)
+{
+    PRPollDesc pr_pd;
+
+    pr_pd.fd = conn->c_prfd;
+    pr_pd.in_flags = PR_POLL_WRITE;
+    pr_pd.out_flags = 0;
+    if (pr_pd.fd == NULL || PR_Poll(&pr_pd, 1, PR_INTERVAL_NO_WAIT) != 0) {
+        /* writable, or an error that the write will report */
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * The client output would block: returns 1 once it has been blocked for
+ * longer than nsslapd-ioblocktimeout, as a regular write would have.
+ */
+static int
+ps_blocked_expired(PSearch *ps)
+{
+    struct timespec now = slapi_current_rel_time_hr();
+    struct timespec elapsed;
+    int32_t ioblocktimeout = config_get_ioblocktimeout();
+
+    if (ps->ps_blocked_since.tv_sec == 0 && ps->ps_blocked_since.tv_nsec == 0) {
+        ps->ps_blocked_since = now;
+        return 0;
+    }
+    slapi_timespec_diff(&now, &(ps->ps_blocked_since), &elapsed);
+    return ioblocktimeout > 0 &&
+           (elapsed.tv_sec * 1000 + elapsed.tv_nsec / 1000000) >= ioblocktimeout;
+}
+
+/*
+ * Send a batch of the entries queued on a persistent search.
+ *
+ * Returns 1 when the persistent search is over: either (a) the
+ * ps_complete flag is set, (b) the associated operation is abandoned,
+ * (c) the client did not keep up and its queue overflowed, or (d) the
+ * client output has been blocked for longer than the ioblocktimeout.
+ * It is then freed.  Otherwise returns 0, *more being set if entries
+ * are left in the queue, and *blocked if the client output would block.
+ *
+ * Nothing is written to a client whose output would block, so that a
+ * client which stops reading does not hold a dispatcher thread.
+ */
+static int
+ps_serve(PSearch *ps, int *more, int *blocked)
+{
+    Connection *pb_conn = NULL;
+    Operation *pb_op = NULL;
+    PSEQNode *peq;
+
+    *more = 0;
+    *blocked = 0;
+    slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &pb_conn);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_OPERATION, &pb_op);
+
+    if (ps->ps_conn_acq_flag || slapi_atomic_load_64(&(ps->ps_complete), __ATOMIC_ACQUIRE)) {
+        ps_finish(ps);
+        return 1;
+    }
+    /* Check for an abandoned operation */
+    if (pb_op == NULL || slapi_op_abandoned(ps->ps_pblock)) {
+        slapi_log_err(SLAPI_LOG_CONNS, "ps_serve",
+                      "conn=%" PRIu64 " op=%d The operation has been abandoned\n",
+                      pb_conn->c_connid, pb_op ? pb_op->o_opid : -1);
+        ps_finish(ps);
+        return 1;
+    }
+    if (!ps_conn_writable(pb_conn)) {
+        if (ps_blocked_expired(ps)) {
+            slapi_log_err(SLAPI_LOG_WARNING, "ps_serve",
+                          "conn=%" PRIu64 " op=%d The client does not read the changes, "
+                          "the connection is closed.\n",
+                          pb_conn->c_connid, pb_op->o_opid);
+            disconnect_server(pb_conn, pb_conn->c_connid, pb_op->o_opid,
+                              SLAPD_DISCONNECT_IO_TIMEOUT, EAGAIN);
+            ps_finish(ps);
+            return 1;
+        }
+        *more = 1;
+        *blocked = 1;
+        return 0;
+    }
+    ps->ps_blocked_since.tv_sec = 0;
+    ps->ps_blocked_since.tv_nsec = 0;
+    if (slapi_atomic_load_64(&(ps->ps_overflow), __ATOMIC_ACQUIRE)) {
+        slapi_log_err(SLAPI_LOG_WARNING, "ps_serve",
+                      "conn=%" PRIu64 " op=%d More than %d entries are waiting to be sent "
+                      "to the client, the persistent search is ended.\n",
+                      pb_conn->c_connid, pb_op->o_opid, config_get_psearch_max_queue());
+        send_ldap_result(ps->ps_pblock, LDAP_ADMINLIMIT_EXCEEDED, NULL,
+                         "Persistent search queue limit exceeded", 0, NULL);
+        ps_finish(ps);
+        return 1;
+    }
+
+    for (size_t sent = 0; sent < PS_BATCH; sent++) {
+        int attrsonly;
+        char **attrs;
+        LDAPControl **ectrls;
+        Slapi_Entry *ec;
+        Slapi_Filter *f = NULL;
+
+        if (sent > 0 && !ps_conn_writable(pb_conn)) {
+            /* let the client catch up */
+            *blocked = 1;
+            break;
+        }
+
+        /* dequeue the item */
+        PR_Lock(ps->ps_lock);
+        peq = ps->ps_eq_head;
+        if (NULL == peq) {
+            PR_Unlock(ps->ps_lock);
+            break;
+        }
+        ps->ps_eq_head = peq->pe_next;
+        if (NULL == ps->ps_eq_head) {
+            ps->ps_eq_tail = NULL;
+        }
+        ps->ps_eq_len--;
+        PR_Unlock(ps->ps_lock);
+
+        /* Get all the information we need to send the result */
+        ec = peq->pe_entry;
+        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_ATTRS, &attrs);
+        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_ATTRSONLY, &attrsonly);
+        if (!ps->ps_send_entchg_controls || peq->pe_ctrls[0] == NULL) {
+            ectrls = NULL;
+        } else {
+            ectrls = peq->pe_ctrls;
+        }
+
+        /*
+         * The entry is in the right scope and matches the filter
+         * but we need to redo the filter test here to check access
+         * controls. See the comments at the slapi_filter_test()
+         * call in ps_service_persistent_searches().
+         */
+        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
+
+        /* See if the entry meets the filter and ACL criteria */
+        if (slapi_vattr_filter_test(ps->ps_pblock, ec, f,
+                                    1 /* verify_access */) == 0) {
+            int rc = 0;
+            slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_RESULT_ENTRY, ec);
+            rc = send_ldap_search_entry(ps->ps_pblock, ec,
+                                        ectrls, attrs, attrsonly);
+            if (rc) {
+                slapi_log_err(SLAPI_LOG_CONNS, "ps_serve",
+                              "conn=%" PRIu64 " op=%d Error %d sending entry %s with op status %d\n",
+                              pb_conn->c_connid, pb_op->o_opid,
+                              rc, slapi_entry_get_dn_const(ec), pb_op->o_status);
+            }
+        }
+
+        /* Deallocate our wrapper for this entry */
+        pe_ch_free(&peq);
+    }
+
+    PR_Lock(ps->ps_lock);
+    *more = (ps->ps_eq_head != NULL);
+    PR_Unlock(ps->ps_lock);
+
+    return 0;
+}
+
+/*
+ * Put a persistent search on the ready queue of the dispatcher
+ * threads, unless it is already there or being served.
+ */
+static void
+ps_schedule(PSearch *ps)
+{
+    pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+    if (ps->ps_scheduled) {
+        /* The thread serving it will have another look */
+        ps->ps_pending = 1;
+    } else {
+        ps->ps_scheduled = 1;
+        ps->ps_rnext = NULL;
+        if (psearch_list->pl_ready_tail) {
+            psearch_list->pl_ready_tail->ps_rnext = ps;
+        } else {
+            psearch_list->pl_ready_head = ps;
+        }
+        psearch_list->pl_ready_tail = ps;
+        pthread_cond_signal(&(psearch_list->pl_cvar));
+    }
+    pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+}
+
+/*
+ * Append a persistent search to the ready queue, or to the blocked
+ * list.  The caller holds pl_cvarlock.
+ */
+static void
+ps_requeue(PSearch *ps, int blocked)
+{
+    PSearch **head = blocked ? &(psearch_list->pl_blocked_head) : &(psearch_list->pl_ready_head);
+    PSearch **tail = blocked ? &(psearch_list->pl_blocked_tail) : &(psearch_list->pl_ready_tail);
+
+    ps->ps_rnext = NULL;
+    if (*tail) {
+        (*tail)->ps_rnext = ps;
+    } else {
+        *head = ps;
+        if (blocked) {
+            struct timespec *retry_at = &(psearch_list->pl_retry_at);
+
+            clock_gettime(CLOCK_MONOTONIC, retry_at);
+            retry_at->tv_nsec += PS_BLOCKED_RETRY * 1000000L;
+            if (retry_at->tv_nsec >= 1000000000L) {
+                retry_at->tv_sec++;
+                retry_at->tv_nsec -= 1000000000L;
+            }
+        }
+    }
+    *tail = ps;
+}
+
+/*
+ * Move the blocked persistent searches back to the ready queue, once
+ * their retry delay is over or unconditionally if force is set.
+ * The caller holds pl_cvarlock.
+ */
+static void
+ps_retry_blocked(int force)
+{
+    struct timespec now;
+
+    if (NULL == psearch_list->pl_blocked_head) {
+        return;
+    }
+    if (!force) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec < psearch_list->pl_retry_at.tv_sec ||
+            (now.tv_sec == psearch_list->pl_retry_at.tv_sec &&
+             now.tv_nsec < psearch_list->pl_retry_at.tv_nsec)) {
+            return;
+        }
+    }
+    if (psearch_list->pl_ready_tail) {
+        psearch_list->pl_ready_tail->ps_rnext = psearch_list->pl_blocked_head;
+    } else {
+        psearch_list->pl_ready_head = psearch_list->pl_blocked_head;
+    }
+    psearch_list->pl_ready_tail = psearch_list->pl_blocked_tail;
+    psearch_list->pl_blocked_head = NULL;
+    psearch_list->pl_blocked_tail = NULL;
+}
+
+/*
+ * Thread routine of the dispatchers, sending the changes to the
+ * clients which are persistently waiting for them.
+ *
+ * A persistent search is served by one thread at a time, a batch of
+ * entries at a time, so that a slow client does not hold up the others.
+ * The ones whose client output would block are set aside on the blocked
+ * list, and tried again every PS_BLOCKED_RETRY ms.
+ * The threads exit when the server shuts down, once all persistent
+ * searches are over.
+ */
+static void
+ps_dispatch(void *arg __attribute__((unused)))
+{
+    g_incr_active_threadcnt();
+
+    pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+    while (1) {
+        PSearch *ps;
+        int more = 0;
+        int blocked = 0;
+
+        while (1) {
+            /* The blocked ones are ended as well when stopping */
+            ps_retry_blocked(psearch_list->pl_stopping);
+            if (psearch_list->pl_ready_head || psearch_list->pl_stopping) {
+                break;
+            }
+            if (NULL == psearch_list->pl_blocked_head) {
+                /* Nothing to do */
+                pthread_cond_wait(&(psearch_list->pl_cvar), &(psearch_list->pl_cvarlock));
+            } else {
+                /* Only clients that are not reading, give them some time */
+                pthread_cond_timedwait(&(psearch_list->pl_cvar), &(psearch_list->pl_cvarlock),
+                                       &(psearch_list->pl_retry_at));
+            }
+        }
+        ps = psearch_list->pl_ready_head;
+        if (NULL == ps) {
+            break;
+        }
+        psearch_list->pl_ready_head = ps->ps_rnext;
+        if (NULL == psearch_list->pl_ready_head) {
+            psearch_list->pl_ready_tail = NULL;
+        }
+        ps->ps_rnext = NULL;
+        ps->ps_pending = 0;
+
+        /*
+         * Send the results.  Since send_ldap_search_entry can block for
+         * up to 30 minutes, we relinquish all locks before calling it.
+         */
+        pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+        if (ps_serve(ps, &more, &blocked)) {
+            /* over and freed */
+            pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+            continue;
+        }
+        pthread_mutex_lock(&(psearch_list->pl_cvarlock));
+
+        if (blocked) {
+            /* woken up again once the retry delay is over */
+            ps->ps_pending = 0;
+            ps_requeue(ps, 1);
+        } else if (more || ps->ps_pending) {
+            /* back to the end of the queue */
+            ps->ps_pending = 0;
+            ps_requeue(ps, 0);
+        } else {
+            ps->ps_scheduled = 0;
+        }
+    }
+    psearch_list->pl_nthreads--;
+    pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+
     g_decr_active_threadcnt();
 }
 
@@ -452,43 +846,263 @@ psearch_alloc(void)
         return (NULL);
     }
     slapi_atomic_store_64(&(ps->ps_complete), 0, __ATOMIC_RELEASE);
+    slapi_atomic_store_64(&(ps->ps_overflow), 0, __ATOMIC_RELEASE);
     ps->ps_eq_head = ps->ps_eq_tail = (PSEQNode *)NULL;
     ps->ps_lasttime = (time_t)0L;
     ps->ps_next = NULL;
     return ps;
 }
 
+/*
+ * Return an attribute type that an entry must have to match the filter,
+ * or NULL.  objectclass, that all entries have, and the operational
+ * attributes, that may be computed, are not used.
+ */
+static char *
+ps_filter_type(Slapi_Filter *f)
+{
+    char buf[SLAPD_TYPICAL_ATTRIBUTE_NAME_MAX_LENGTH];
+    struct asyntaxinfo *asi;
+    char *ftype = NULL;
+    char *basetype;
+    char *type = NULL;
+
+    switch (slapi_filter_get_choice(f)) {
+    case LDAP_FILTER_AND:
+        for (Slapi_Filter *fi = slapi_filter_list_first(f); fi && !type; fi = slapi_filter_list_next(f, fi)) {
+            type = ps_filter_type(fi);
+        }
+        return type;
+    case LDAP_FILTER_EQUALITY:
+    case LDAP_FILTER_GE:
+    case LDAP_FILTER_LE:
+    case LDAP_FILTER_APPROX:
+    case LDAP_FILTER_SUBSTRINGS:
+    case LDAP_FILTER_PRESENT:
+        break;
+    default:
+        return NULL;
+    }
+
+    if (slapi_filter_get_attribute_type(f, &ftype) != 0 || ftype == NULL) {
+        return NULL;
+    }
+    basetype = slapi_attr_basetype(ftype, buf, sizeof(buf));
+    asi = attr_syntax_get_by_name(basetype ? basetype : buf, 0);
+    if (asi && !(asi->asi_flags & SLAPI_ATTR_FLAG_OPATTR) &&
+        strcasecmp(asi->asi_name, SLAPI_ATTR_OBJECTCLASS) != 0) {
+        type = slapi_ch_strdup(asi->asi_name);
+    }
+    attr_syntax_return(asi);
+    slapi_ch_free_string(&basetype);
+
+    return type;
+}
 
 /*
- * Add the given persistent search to the
- * head of the list of persistent searches.
+ * Add the given persistent search to the list of persistent searches,
+ * under its base DN and the attribute type required by its filter.
  */
 static void
 ps_add_ps(PSearch *ps)
 {
+    char *origbase = NULL;
+    Slapi_DN *base = NULL;
+    Slapi_Filter *f = NULL;
+    PSearch_Base *pbs;
+    PSearch_Group *pg;
+    const char *ndn;
+    char *type;
+
     if (PS_IS_INITIALIZED() && NULL != ps) {
+        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
+        slapi_pblock_get(ps->ps_pblock, SLAPI_ORIGINAL_TARGET_DN, &origbase);
+        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, &base);
+        if (NULL == base) {
+            base = slapi_sdn_new_dn_byref(origbase);
+            slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, base);
+        }
+        ndn = slapi_sdn_get_ndn(base);
+        if (ndn == NULL) {
+            ndn = "";
+        }
+        type = f ? ps_filter_type(f) : NULL;
+
         PSL_LOCK_WRITE();
-        ps->ps_next = psearch_list->pl_head;
-        psearch_list->pl_head = ps;
+        pbs = (PSearch_Base *)PL_HashTableLookup(psearch_list->pl_bases, ndn);
+        if (pbs == NULL) {
+            pbs = (PSearch_Base *)slapi_ch_calloc(1, sizeof(PSearch_Base));
+            pbs->pbs_ndn = slapi_ch_strdup(ndn);
+            PL_HashTableAdd(psearch_list->pl_bases, pbs->pbs_ndn, pbs);
+        }
+        for (pg = pbs->pbs_groups; pg; pg = pg->pg_next) {
+            if ((pg->pg_type == NULL && type == NULL) ||
+                (pg->pg_type && type && strcasecmp(pg->pg_type, type) == 0)) {
+                break;
+            }
+        }
+        if (pg == NULL) {
+            pg = (PSearch_Group *)slapi_ch_calloc(1, sizeof(PSearch_Group));
+            pg->pg_type = type;
+            type = NULL;
+            pg->pg_base = pbs;
+            pg->pg_next = pbs->pbs_groups;
+            pbs->pbs_groups = pg;
+        }
+        ps->ps_group = pg;
+        ps->ps_next = pg->pg_head;
+        pg->pg_head = ps;
+        psearch_list->pl_count++;
         PSL_UNLOCK_WRITE();
+
+        slapi_ch_free_string(&type);
     }
 }
 
 
 /*
- * Wake up all threads sleeping on
- * the psearch_list condition variable.
+ * Have the dispatcher threads look at all the persistent searches,
+ * for the abandoned or completed ones.
  */
 void
 ps_wakeup_all()
 {
     if (PS_IS_INITIALIZED()) {
-        pthread_mutex_lock(&(psearch_list->pl_cvarlock));
-        pthread_cond_broadcast(&(psearch_list->pl_cvar));
-        pthread_mutex_unlock(&(psearch_list->pl_cvarlock));
+        PSL_LOCK_READ();
+        ps_foreach(ps_schedule);
+        PSL_UNLOCK_READ();
+    }
+}
+
+/*
+ * Does the entry have a value of the type, real or virtual?
+ */
+static int
+ps_entry_may_have_type(Slapi_Entry *e, const char *type, const Slapi_DN **namespace_dn)
+{
+    Slapi_Attr *a = NULL;
+
+    for (int rc = slapi_entry_first_attr(e, &a); rc == 0 && a; rc = slapi_entry_next_attr(e, a, &a)) {
+        char *atype = NULL;
+
+        slapi_attr_get_type(a, &atype);
+        if (slapi_attr_type_cmp(atype, type, SLAPI_TYPE_CMP_BASE) == 0) {
+            return 1;
+        }
+    }
+
+    /* get the namespace this entry belongs to, once */
+    if (*namespace_dn == NULL) {
+        Slapi_Backend *be = slapi_be_select(slapi_entry_get_sdn(e));
+        *namespace_dn = be ? slapi_be_getsuffix(be, 0) : NULL;
     }
+    return vattr_map_has_type(*namespace_dn, type);
 }
 
+/*
+ * Queue an entry on a persistent search if it is in its scope and
+ * matches its filter.  Returns 1 if the entry was queued.
+ */
+static int
+ps_service_one(PSearch *ps, Slapi_Entry *e, Slapi_Entry *eprev, ber_int_t chgtype, ber_int_t chgnum, LDAPControl **ctrl, int32_t maxqueue)
+{
+    Slapi_DN *base = NULL;
+    Slapi_Filter *f;
+    int scope;
+    Connection *pb_conn = NULL;
+    Operation *pb_op = NULL;
+    PSEQNode *pe = NULL;
+    PSEQNode *pOldtail;
+
+    slapi_pblock_get(ps->ps_pblock, SLAPI_OPERATION, &pb_op);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &pb_conn);
+
+    /* Skip the node that doesn't meet the changetype,
+     * or is unable to use the change in ps_serve()
+     */
+    if ((ps->ps_changetypes & chgtype) == 0 || pb_op == NULL ||
+        slapi_op_abandoned(ps->ps_pblock) ||
+        slapi_atomic_load_64(&(ps->ps_overflow), __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    slapi_log_err(SLAPI_LOG_CONNS, "ps_service_persistent_searches",
+                  "conn=%" PRIu64 " op=%d entry %s with chgtype %d "
+                  "matches the ps changetype %d\n",
+                  pb_conn ? pb_conn->c_connid : -1,
+                  pb_op->o_opid,
+                  slapi_entry_get_dn_const(e), chgtype, ps->ps_changetypes);
+
+    slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, &base);
+    slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_SCOPE, &scope);
+
+    /*
+     * See if the entry meets the scope and filter criteria.
+     * We cannot do the acl check here as this thread
+     * would then potentially clash with the dispatcher
+     * thread on the aclpb in ps->ps_pblock.
+     * By avoiding the acl check in this thread, and leaving all the acl
+     * checking to the dispatcher thread we avoid
+     * the ps_pblock contention problem.
+     * The lesson here is "Do not give multiple threads arbitary access
+     * to the same pblock" this kind of muti-threaded access
+     * to the same pblock must be done carefully--there is currently no
+     * generic satisfactory way to do this.
+    */
+    if (!slapi_sdn_scope_test(slapi_entry_get_sdn_const(e), base, scope) ||
+        slapi_vattr_filter_test(ps->ps_pblock, e, f, 0 /* verify_access */) != 0) {
+        return 0;
+    }
+
+    /* The scope and the filter match - enqueue it */
+    pe = (PSEQNode *)slapi_ch_calloc(1, sizeof(PSEQNode));
+    pe->pe_entry = slapi_entry_dup(e);
+    if (ps->ps_send_entchg_controls) {
+        /* create_entrychange_control() is more
+         * expensive than slapi_dup_control()
+         */
+        if (*ctrl == NULL) {
+            int rc;
+            rc = create_entrychange_control(chgtype, chgnum,
+                                            eprev ? slapi_entry_get_dn_const(eprev) : NULL,
+                                            ctrl);
+            if (rc != LDAP_SUCCESS) {
+                slapi_log_err(SLAPI_LOG_ERR, "ps_service_persistent_searches",
+                              "Unable to create EntryChangeNotification control for"
+                              " entry \"%s\" -- control won't be sent.\n",
+                              slapi_entry_get_dn_const(e));
+            }
+        }
+        if (*ctrl) {
+            pe->pe_ctrls[0] = slapi_dup_control(*ctrl);
+        }
+    }
+
+    /* Put it on the end of the list for this pers search */
+    PR_Lock(ps->ps_lock);
+    if (maxqueue > 0 && ps->ps_eq_len >= maxqueue) {
+        /* The client does not read its changes, end the search */
+        PR_Unlock(ps->ps_lock);
+        pe_ch_free(&pe);
+        slapi_atomic_store_64(&(ps->ps_overflow), 1, __ATOMIC_RELEASE);
+        ps_schedule(ps);
+        return 0;
+    }
+    pOldtail = ps->ps_eq_tail;
+    ps->ps_eq_tail = pe;
+    if (NULL == ps->ps_eq_head) {
+        ps->ps_eq_head = ps->ps_eq_tail;
+    } else {
+        pOldtail->pe_next = ps->ps_eq_tail;
+    }
+    ps->ps_eq_len++;
+    PR_Unlock(ps->ps_lock);
+
+    /* Turn it loose */
+    ps_schedule(ps);
+    return 1;
+}
 
 /*
  * Check if there are any persistent searches.  If so,
@@ -498,6 +1112,10 @@ ps_wakeup_all()
  * If so, then enqueue the entry on that persistent search's
  * ps_entryqueue and signal it to wake up and send the entry.
  *
+ * Only the persistent searches based on the entry DN or one of
+ * its ancestors are looked at, and among them the ones whose filter
+ * requires an attribute type the entry does not have are skipped.
+ *
  * Note that if eprev is NULL we assume that the entry's DN
  * was not changed by the op. that called this function.  If
  * chgnum is 0 it is unknown so we won't ever send it to a
@@ -507,10 +1125,10 @@ void
 ps_service_persistent_searches(Slapi_Entry *e, Slapi_Entry *eprev, ber_int_t chgtype, ber_int_t chgnum)
 {
     LDAPControl *ctrl = NULL;
-    PSearch *ps = NULL;
-    PSEQNode *pe = NULL;
+    const Slapi_DN *namespace_dn = NULL;
+    int32_t maxqueue;
     int matched = 0;
-    const char *edn;
+    const char *ndn;
 
     if (!PS_IS_INITIALIZED()) {
         return;
@@ -523,107 +1141,37 @@ ps_service_persistent_searches(Slapi_Entry *e, Slapi_Entry *eprev, ber_int_t chg
 
     assert(psearch_list);
     assert(psearch_list->pl_rwlock);
+    maxqueue = config_get_psearch_max_queue();
     PSL_LOCK_READ();
-    edn = slapi_entry_get_dn_const(e);
-
-    for (ps = psearch_list ? psearch_list->pl_head : NULL; NULL != ps; ps = ps->ps_next) {
-        char *origbase = NULL;
-        Slapi_DN *base = NULL;
-        Slapi_Filter *f;
-        int scope;
-        Connection *pb_conn = NULL;
-        Operation *pb_op = NULL;
-
-        slapi_pblock_get(ps->ps_pblock, SLAPI_OPERATION, &pb_op);
-        slapi_pblock_get(ps->ps_pblock, SLAPI_CONNECTION, &pb_conn);
-
-        /* Skip the node that doesn't meet the changetype,
-         * or is unable to use the change in ps_send_results()
-         */
-        if ((ps->ps_changetypes & chgtype) == 0 || pb_op == NULL ||
-            slapi_op_abandoned(ps->ps_pblock)) {
-            continue;
-        }
 
-        slapi_log_err(SLAPI_LOG_CONNS, "ps_service_persistent_searches",
-                      "conn=%" PRIu64 " op=%d entry %s with chgtype %d "
-                      "matches the ps changetype %d\n",
-                      pb_conn ? pb_conn->c_connid : -1,
-                      pb_op->o_opid,
-                      edn, chgtype, ps->ps_changetypes);
+    ndn = psearch_list->pl_count ? slapi_entry_get_ndn(e) : NULL;
+    while (ndn) {
+        PSearch_Base *pbs = (PSearch_Base *)PL_HashTableLookup(psearch_list->pl_bases, ndn);
 
-        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_FILTER, &f);
-        slapi_pblock_get(ps->ps_pblock, SLAPI_ORIGINAL_TARGET_DN, &origbase);
-        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, &base);
-        slapi_pblock_get(ps->ps_pblock, SLAPI_SEARCH_SCOPE, &scope);
-        if (NULL == base) {
-            base = slapi_sdn_new_dn_byref(origbase);
-            slapi_pblock_set(ps->ps_pblock, SLAPI_SEARCH_TARGET_SDN, base);
-        }
-
-        /*
-         * See if the entry meets the scope and filter criteria.
-         * We cannot do the acl check here as this thread
-         * would then potentially clash with the ps_send_results()
-         * thread on the aclpb in ps->ps_pblock.
-         * By avoiding the acl check in this thread, and leaving all the acl
-         * checking to the ps_send_results() thread we avoid
-         * the ps_pblock contention problem.
-         * The lesson here is "Do not give multiple threads arbitary access
-         * to the same pblock" this kind of muti-threaded access
-         * to the same pblock must be done carefully--there is currently no
-         * generic satisfactory way to do this.
-        */
-        if (slapi_sdn_scope_test(slapi_entry_get_sdn_const(e), base, scope) &&
-            slapi_vattr_filter_test(ps->ps_pblock, e, f, 0 /* verify_access */) == 0) {
-            PSEQNode *pOldtail;
-
-            /* The scope and the filter match - enqueue it */
-
-            matched++;
-            pe = (PSEQNode *)slapi_ch_calloc(1, sizeof(PSEQNode));
-            pe->pe_entry = slapi_entry_dup(e);
-            if (ps->ps_send_entchg_controls) {
-                /* create_entrychange_control() is more
-                 * expensive than slapi_dup_control()
-                 */
-                if (ctrl == NULL) {
-                    int rc;
-                    rc = create_entrychange_control(chgtype, chgnum,
-                                                    eprev ? slapi_entry_get_dn_const(eprev) : NULL,
-                                                    &ctrl);
-                    if (rc != LDAP_SUCCESS) {
-                        slapi_log_err(SLAPI_LOG_ERR, "ps_service_persistent_searches",
-                                      "Unable to create EntryChangeNotification control for"
-                                      " entry \"%s\" -- control won't be sent.\n",
-                                      slapi_entry_get_dn_const(e));
-                    }
-                }
-                if (ctrl) {
-                    pe->pe_ctrls[0] = slapi_dup_control(ctrl);
-                }
+        for (PSearch_Group *pg = pbs ? pbs->pbs_groups : NULL; pg; pg = pg->pg_next) {
+            if (pg->pg_type && !ps_entry_may_have_type(e, pg->pg_type, &namespace_dn)) {
+                continue;
             }
-
-            /* Put it on the end of the list for this pers search */
-            PR_Lock(ps->ps_lock);
-            pOldtail = ps->ps_eq_tail;
-            ps->ps_eq_tail = pe;
-            if (NULL == ps->ps_eq_head) {
-                ps->ps_eq_head = ps->ps_eq_tail;
-            } else {
-                pOldtail->pe_next = ps->ps_eq_tail;
+            for (PSearch *ps = pg->pg_head; NULL != ps; ps = ps->ps_next) {
+                matched += ps_service_one(ps, e, eprev, chgtype, chgnum, &ctrl, maxqueue);
             }
-            PR_Unlock(ps->ps_lock);
+        }
+
+        /* next ancestor, up to the root DSE */
+        if (*ndn == '\0') {
+            ndn = NULL;
+        } else if ((ndn = slapi_dn_find_parent(ndn)) == NULL) {
+            ndn = "";
         }
     }
 
     PSL_UNLOCK_READ();
+    if (ctrl) {
+        ldap_control_free(ctrl);
+    }
 
     /* Were there any matches? */
     if (matched) {
-        ldap_control_free(ctrl);
-        /* Turn 'em loose */
-        ps_wakeup_all();
         slapi_log_err(SLAPI_LOG_TRACE, "ps_service_persistent_searches", "Enqueued entry "
                       "\"%s\" on %d persistent search lists\n",
                       slapi_entry_get_dn_const(e), matched);
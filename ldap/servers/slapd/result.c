@@ -29,6 +29,10 @@
 #include "slapi-plugin.h"
 #include <ssl.h>
 
+#ifdef SYSTEMTAP
+#include <sys/sdt.h>
+#endif
+
 static long current_conn_count;
 static PRLock *current_conn_count_mutex;
 static int flush_ber(Slapi_PBlock *pb, Connection *conn, Operation *op, BerElement *ber, int type);
@@ -672,6 +676,10 @@ send_ldap_result_ext(
             goto log_and_return;
         }
     }
+    /* the search explain control: the plan goes with the search result */
+    if (tag == LDAP_RES_SEARCH_RESULT && operation_is_flag_set(operation, OP_FLAG_EXPLAIN)) {
+        explain_add_response_control(pb, operation);
+    }
     if (operation->o_results.result_controls != NULL && conn->c_ldapversion >= LDAP_VERSION3 && write_controls(ber, operation->o_results.result_controls) != 0) {
         rc = (int)LBER_ERROR;
     }
@@ -699,6 +707,15 @@ send_ldap_result_ext(
 log_and_return:
     operation->o_status = SLAPI_OP_STATUS_RESULT_SENT; /* in case this has not yet been set */
 
+    /* not done in log_result() so that it does not depend on the access log level */
+    op_latency_record(pb, operation);
+
+#ifdef SYSTEMTAP
+    if (!internal_op) {
+        STAP_PROBE4(ns-slapd, op__result, operation->o_connid, operation->o_opid, tag, err);
+    }
+#endif
+
     if (logit && (operation_is_flag_set(operation, OP_FLAG_ACTION_LOG_ACCESS) ||
                   (internal_op && config_get_plugin_logging()))) {
         log_result(pb, operation, err, tag, nentries);
@@ -1759,6 +1776,9 @@ send_ldap_search_entry_ext(
     /* write only one pdu at a time - wait til it's our turn */
     if ((rc = flush_ber(pb, conn, operation, ber, _LDAP_SEND_ENTRY)) == 0) {
         logit = 1;
+#ifdef SYSTEMTAP
+        STAP_PROBE2(ns-slapd, entry__send, operation->o_connid, operation->o_opid);
+#endif
     }
     ber = NULL; /* flush_ber will always free the ber */
 
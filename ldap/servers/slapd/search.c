@@ -52,6 +52,7 @@ do_search(Slapi_PBlock *pb)
     int psearch = 0;
     struct berval *psbvp;
     struct berval *sebvp;
+    struct berval *explainbvp;
     ber_int_t changetypes;
     int send_entchg_controls;
     int changesonly = 0;
@@ -387,6 +388,33 @@ do_search(Slapi_PBlock *pb)
         }
     }
 
+    /* Return the search plan with the result, it tells about entries that
+     * may not be readable by the requestor: for the directory manager only */
+    int is_explain_critical = 0;
+    if (slapi_control_present(operation->o_params.request_controls,
+                              LDAP_CONTROL_SEARCH_EXPLAIN, &explainbvp, &is_explain_critical)) {
+        int dryrun = 0;
+
+        if (explain_parse_request_control(explainbvp, &dryrun) < 0) {
+            log_search_access(pb, base, scope, fstr, "failed to decode search explain control");
+            if (is_explain_critical) {
+                send_ldap_result(pb, LDAP_PROTOCOL_ERROR, NULL, NULL, 0, NULL);
+                goto free_and_return;
+            }
+        } else if (!operation->o_isroot) {
+            if (is_explain_critical) {
+                log_search_access(pb, base, scope, fstr, "search explain control not allowed");
+                send_ldap_result(pb, LDAP_UNAVAILABLE_CRITICAL_EXTENSION, NULL, NULL, 0, NULL);
+                goto free_and_return;
+            }
+        } else {
+            operation_set_flag(operation, OP_FLAG_EXPLAIN);
+            if (dryrun) {
+                operation_set_flag(operation, OP_FLAG_EXPLAIN_DRYRUN);
+            }
+        }
+    }
+
     slapi_pblock_set(pb, SLAPI_ORIGINAL_TARGET_DN, rawbase);
     rawbase_set_in_pb = 1; /* rawbase is now owned by pb */
     slapi_pblock_set(pb, SLAPI_SEARCH_SCOPE, &scope);
@@ -412,8 +440,9 @@ do_search(Slapi_PBlock *pb)
     slapi_pblock_get(pb, SLAPI_PLUGIN_OPRETURN, &rc);
     slapi_pblock_get(pb, SLAPI_SEARCH_FILTER, &filter);
 
-    if (psearch && rc == 0) {
-        ps_add(pb, changetypes, send_entchg_controls);
+    if (psearch && rc == 0 && ps_add(pb, changetypes, send_entchg_controls) != 0) {
+        /* the error was sent: free the resources, as for a failed search */
+        rc = -1;
     }
 
 free_and_return:
@@ -169,12 +169,16 @@ typedef struct symbol_t
 #define LDAP_CONTROL_SUBENTRIES	"1.3.6.1.4.1.4203.1.10.1"
 #endif
 
+/* Search explain control: the search plan is returned with the result (shared by request and response) */
+#define LDAP_CONTROL_SEARCH_EXPLAIN "2.16.840.1.113730.3.4.21"
+
 #define SLAPD_VENDOR_NAME VENDOR
 #define SLAPD_VERSION_STR CAPBRAND "-Directory/" DS_PACKAGE_VERSION
 #define SLAPD_SHORT_VERSION_STR DS_PACKAGE_VERSION
 
 typedef void (*VFP)(void *);
 typedef void (*VFPP)(void **);
+typedef size_t (*SFPI)(void *, int);
 typedef void (*VFP0)(void);
 
 #if defined(__GNUC__) && (((__GNUC__ == 4) && (__GNUC_MINOR__ >= 4)) || (__GNUC__ > 4))
@@ -1057,6 +1061,7 @@ struct slapdplugin
             IFP plg_un_db_next_search_entry_ext;
             VFPP plg_un_db_search_results_release; /* PAGED RESULTS */
             VFP plg_un_db_prev_search_results;     /* PAGED RESULTS */
+            SFPI plg_un_db_search_results_pack;    /* PAGED RESULTS */
             IFP plg_un_db_entry_release;
             IFP plg_un_db_compare;              /* compare */
             IFP plg_un_db_modify;               /* modify */
@@ -1100,6 +1105,7 @@ struct slapdplugin
 #define plg_next_search_entry_ext plg_un.plg_un_db.plg_un_db_next_search_entry_ext
 #define plg_search_results_release plg_un.plg_un_db.plg_un_db_search_results_release
 #define plg_prev_search_results plg_un.plg_un_db.plg_un_db_prev_search_results
+#define plg_search_results_pack plg_un.plg_un_db.plg_un_db_search_results_pack
 #define plg_entry_release plg_un.plg_un_db.plg_un_db_entry_release
 #define plg_compare plg_un.plg_un_db.plg_un_db_compare
 #define plg_modify plg_un.plg_un_db.plg_un_db_modify
@@ -1451,6 +1457,7 @@ typedef struct backend
 #define be_entry_release be_database->plg_entry_release
 #define be_search_results_release be_database->plg_search_results_release
 #define be_prev_search_results be_database->plg_prev_search_results
+#define be_search_results_pack be_database->plg_search_results_pack
 #define be_compare be_database->plg_compare
 #define be_modify be_database->plg_modify
 #define be_modrdn be_database->plg_modrdn
@@ -1502,6 +1509,7 @@ typedef struct backend
     void *vlvSearchList;
     Slapi_Counter *be_usn_counter; /* USN counter; one counter per backend */
     int be_pagedsizelimit;         /* size limit for this backend for simple paged result searches */
+    struct op_latency_backend *be_latency; /* latency histograms, NULL for private backends */
 } backend;
 
 enum
@@ -1631,6 +1639,9 @@ typedef struct op
 
 
 /* simple paged structure */
+/* length of the opaque cookies of the paged results cursor store */
+#define PAGEDRESULTS_COOKIE_LEN 32
+
 typedef struct _paged_results
 {
     Slapi_Backend *pr_current_be;           /* backend being used */
@@ -1642,6 +1653,7 @@ typedef struct _paged_results
     int pr_flags;
     ber_int_t pr_msgid; /* msgid of the request; to abandon */
     PRLock *pr_mutex;   /* protect each conn structure    */
+    char pr_cookie[PAGEDRESULTS_COOKIE_LEN + 1]; /* cursor store cookie, or "" */
 } PagedResults;
 
 /* array of simple paged structure stashed in connection */
@@ -1966,6 +1978,67 @@ typedef int (*value_compare_fn_type)(const struct berval *, const struct berval
 /* Definition for plugin syntax validate routine */
 typedef int (*value_validate_fn_type)(const struct berval *);
 
+/*
+ * Operation latency histograms (op_latency.c)
+ *
+ * Log-linear histograms of the wait time (wtime) and operation time
+ * (optime) of the operations, in microseconds.  Every power of two is
+ * split in OP_LATENCY_SUB_COUNT buckets, so a value is known within
+ * 1/OP_LATENCY_SUB_COUNT.  Larger values are clamped into the last bucket.
+ */
+#define OP_LATENCY_SUB_BITS 4
+#define OP_LATENCY_SUB_COUNT (1 << OP_LATENCY_SUB_BITS)
+#define OP_LATENCY_MAX_BITS 32 /* 2^32 usec, a bit more than one hour */
+#define OP_LATENCY_NB_BUCKETS ((OP_LATENCY_MAX_BITS - OP_LATENCY_SUB_BITS + 1) * OP_LATENCY_SUB_COUNT)
+
+/* Keep in sync with op_latency_type_names and NUM_SNMP_LATENCY_OPS */
+typedef enum {
+    OP_LATENCY_BIND = 0,
+    OP_LATENCY_SEARCH_BASE,
+    OP_LATENCY_SEARCH_ONELEVEL,
+    OP_LATENCY_SEARCH_SUBTREE,
+    OP_LATENCY_ADD,
+    OP_LATENCY_MODIFY,
+    OP_LATENCY_DELETE,
+    OP_LATENCY_MODRDN,
+    OP_LATENCY_COMPARE,
+    OP_LATENCY_EXTENDED,
+    OP_LATENCY_NB_TYPES
+} op_latency_type;
+
+typedef enum {
+    OP_LATENCY_WTIME = 0,
+    OP_LATENCY_OPTIME,
+    OP_LATENCY_NB_KINDS
+} op_latency_kind;
+
+typedef struct op_latency_hist
+{
+    uint64_t buckets[OP_LATENCY_NB_BUCKETS];
+} op_latency_hist;
+
+typedef struct op_latency_set
+{
+    op_latency_hist hist[OP_LATENCY_NB_TYPES][OP_LATENCY_NB_KINDS];
+} op_latency_set;
+
+/* Histograms of a backend: one set per thread slot, allocated by the
+ * first operation of that thread on the backend */
+typedef struct op_latency_backend
+{
+    op_latency_set **slots;
+} op_latency_backend;
+
+typedef struct op_latency_summary
+{
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} op_latency_summary;
+
 #include "proto-slap.h"
 LDAPMod **entry2mods(Slapi_Entry *, LDAPMod **, int *, int);
 
@@ -2359,6 +2432,10 @@ typedef struct _slapdEntryPoints
 #define CONFIG_SEARCH_RETURN_ORIGINAL_TYPE "nsslapd-search-return-original-type-switch"
 #define CONFIG_ENABLE_TURBO_MODE "nsslapd-enable-turbo-mode"
 #define CONFIG_CONNECTION_BUFFER "nsslapd-connection-buffer"
+#define CONFIG_CONNECTION_BUFFER_MAX "nsslapd-connection-buffer-max"
+#define CONFIG_PAGEDRESULTS_CURSOR_CACHE_SIZE "nsslapd-pagedresults-cursor-cache-size"
+#define CONFIG_PSEARCH_THREADS "nsslapd-psearch-threads"
+#define CONFIG_PSEARCH_MAX_QUEUE "nsslapd-psearch-max-queue"
 #define CONFIG_CONNECTION_NOCANON "nsslapd-connection-nocanon"
 #define CONFIG_PLUGIN_LOGGING "nsslapd-plugin-logging"
 #define CONFIG_LISTEN_BACKLOG_SIZE "nsslapd-listen-backlog-size"
@@ -2688,6 +2765,10 @@ typedef struct _slapdFrontendConfig
     slapi_onoff_t unhashed_pw_switch; /* switch to on/off/nolog unhashed pw */
     slapi_onoff_t enable_turbo_mode;
     slapi_int_t connection_buffer;    /* values are CONNECTION_BUFFER_* below */
+    slapi_int_t connection_buffer_max; /* upper bound of an adaptive read buffer */
+    slapi_int_t pagedresults_cursor_cache_size; /* bytes of parked paged results cursors, 0: off */
+    slapi_int_t psearch_threads;                /* threads sending the persistent search results */
+    slapi_int_t psearch_max_queue;              /* entries queued per persistent search, 0: no limit */
     slapi_onoff_t connection_nocanon; /* if "on" sets LDAP_OPT_X_SASL_NOCANON */
     slapi_onoff_t plugin_logging;     /* log all internal plugin operations */
     slapi_onoff_t ignore_time_skew;
@@ -2773,6 +2854,23 @@ typedef struct _slapdFrontendConfig
 #define CONNECTION_BUFFER_ON 1
 #define CONNECTION_BUFFER_ADAPT 2
 
+/* Bounds of the adaptive (CONNECTION_BUFFER_ADAPT) socket read buffer */
+#define CONNECTION_BUFFER_MAX_MIN 512
+#define CONNECTION_BUFFER_MAX_MAX (4 * 1024 * 1024)
+#define SLAPD_DEFAULT_CONNECTION_BUFFER_MAX 65536
+#define SLAPD_DEFAULT_CONNECTION_BUFFER_MAX_STR "65536"
+
+/* Server wide store of the paged results cursors, disabled by default */
+#define SLAPD_DEFAULT_PAGEDRESULTS_CURSOR_CACHE_SIZE 0
+#define SLAPD_DEFAULT_PAGEDRESULTS_CURSOR_CACHE_SIZE_STR "0"
+
+/* Persistent searches are served by a pool of threads */
+#define PSEARCH_THREADS_MAX 1024
+#define SLAPD_DEFAULT_PSEARCH_THREADS 4
+#define SLAPD_DEFAULT_PSEARCH_THREADS_STR "4"
+#define SLAPD_DEFAULT_PSEARCH_MAX_QUEUE 0
+#define SLAPD_DEFAULT_PSEARCH_MAX_QUEUE_STR "0"
+
 
 slapdFrontendConfig_t *getFrontendConfig(void);
 
@@ -179,6 +179,7 @@ PR_fprintf(struct PRFileDesc *fd, const char *fmt, ...) __ATTRIBUTE__((format(pr
 #define SLAPI_OP_FLAG_NEVER_CACHE      0x0200000  /* added entry should not be kept in cache */
 #define SLAPI_OP_FLAG_IGNORE_UNINDEXED 0x0800000  /* Do not log unindexed search */
 #define SLAPI_OP_FLAG_FIXUP            0x1000000  /* Fix up operation, bypass restrictions */
+#define SLAPI_OP_FLAG_SCAN             0x10000000 /* Bulk read: do not let the entries evict the entry cache working set */
 
 #define SLAPI_OC_FLAG_REQUIRED 0x0001
 #define SLAPI_OC_FLAG_ALLOWED  0x0002
@@ -6726,6 +6727,7 @@ void slapi_destroy_task(void *arg);
 
 /* Slapi_Counter Interface */
 Slapi_Counter *slapi_counter_new(void);
+Slapi_Counter *slapi_counter_new_sharded(void);
 void slapi_counter_init(Slapi_Counter *counter);
 void slapi_counter_destroy(Slapi_Counter **counter);
 uint64_t slapi_counter_increment(Slapi_Counter *counter);
@@ -7538,6 +7540,9 @@ typedef enum _slapi_op_note_t {
 /* dbverify */
 #define SLAPI_DBVERIFY_DBDIR 1947
 
+/* db2archive: backup an incremental backup is based on */
+#define SLAPI_DB2ARCHIVE_BASE_DIR 1951
+
 /* convenience macros for checking modify operation types */
 #define SLAPI_IS_MOD_ADD(x)     (((x) & ~LDAP_MOD_BVALUES) == LDAP_MOD_ADD)
 #define SLAPI_IS_MOD_DELETE(x)  (((x) & ~LDAP_MOD_BVALUES) == LDAP_MOD_DELETE)
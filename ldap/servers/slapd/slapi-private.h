@@ -441,6 +441,9 @@ void slapi_filter_optimise(Slapi_Filter *f);
                                                   * bind rather than a normal password change */
 #define OP_FLAG_SUBENTRIES_FALSE 0x04000000      /* Normal entries are visible and subentries are not */
 #define OP_FLAG_SUBENTRIES_TRUE 0x08000000       /* Subentries are visible and normal entries are not */
+#define OP_FLAG_SCAN SLAPI_OP_FLAG_SCAN           /* 0x10000000 */
+#define OP_FLAG_EXPLAIN 0x20000000               /* Search explain control: gather the search plan */
+#define OP_FLAG_EXPLAIN_DRYRUN 0x40000000        /* Search explain control: do not return the entries */
 
 /* reverse search states */
 #define REV_STARTED 1
@@ -462,6 +465,7 @@ struct component_keys_lookup
     char *attribute_type;
     char *key;
     int id_lookup_cnt;
+    int allids;
     struct component_keys_lookup *next;
 };
 typedef struct op_search_stat
@@ -469,6 +473,19 @@ typedef struct op_search_stat
     struct component_keys_lookup *keys_lookup;
     struct timespec keys_lookup_start;
     struct timespec keys_lookup_end;
+    /* used for the search explain control (OP_FLAG_EXPLAIN) */
+    char *filter_executed;     /* filter after the optimiser, as run by the backend */
+    int candidates_allids;     /* the candidate list is ALLIDS */
+    int filter_test_bypassed;  /* the candidates matched the filter, no filter test */
+    uint64_t candidates;       /* size of the candidate lists */
+    uint64_t entries_tested;   /* candidates fetched and tested against the filter */
+    uint64_t entries_matched;  /* entries that passed the filter and scope tests */
+    uint64_t entries_returned; /* entries sent to the client */
+    uint64_t cache_hits;       /* candidates found in the entry cache */
+    uint64_t cache_misses;     /* candidates read from id2entry */
+    uint64_t index_ns;         /* time reading the index keys */
+    uint64_t candidates_ns;    /* time building the candidate lists, index reads included */
+    uint64_t scan_ns;          /* time fetching and testing the candidates */
 } Op_search_stat;
 
 /* structure store in the operation extension */
@@ -480,6 +497,8 @@ typedef struct op_stat
 void op_stat_init(void);
 Op_stat *op_stat_get_operation_extension(Slapi_PBlock *pb);
 void op_stat_set_operation_extension(Slapi_PBlock *pb, Op_stat *op_stat);
+Op_search_stat *op_stat_get_search_stat(Slapi_PBlock *pb);
+uint64_t op_stat_elapsed_ns(const struct timespec *start);
 
 /*
  * From ldap.h
@@ -546,6 +565,8 @@ int slapi_entry_vattrcache_findAndTest(const Slapi_Entry *e, const char *type, S
 int slapi_vattrcache_iscacheable(const char *type);
 void slapi_vattrcache_cache_all(void);
 void slapi_vattrcache_cache_none(void);
+uint64_t slapi_vattr_generation(void);
+void slapi_vattr_generation_bump(void);
 
 int vattr_test_filter(Slapi_PBlock *pb,
                       /* Entry we're interested in */ Slapi_Entry *e,
@@ -950,6 +971,12 @@ int proxyauth_get_dn(Slapi_PBlock *pb, char **proxydnp, char **errtextp);
 #define SLAPI_PLUGIN_DB_SEARCH_RESULTS_RELEASE_FN 238
 #define SLAPI_PLUGIN_DB_PREV_SEARCH_RESULTS_FN    239
 #define SLAPI_PLUGIN_DB_UPGRADEDNFORMAT_FN        240
+#define SLAPI_PLUGIN_DB_SEARCH_RESULTS_PACK_FN    241
+/* requests of the SLAPI_PLUGIN_DB_SEARCH_RESULTS_PACK_FN, that returns the
+ * number of bytes held by the search result set afterwards */
+#define SLAPI_SEARCH_RESULTS_SIZE   0
+#define SLAPI_SEARCH_RESULTS_PACK   1
+#define SLAPI_SEARCH_RESULTS_UNPACK 2
 /* database plugin-specific parameters */
 #define SLAPI_PLUGIN_DB_NO_ACL                    250
 #define SLAPI_PLUGIN_DB_RMDB_FN                   280
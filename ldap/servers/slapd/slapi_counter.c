@@ -17,16 +17,35 @@
 
 #include "slap.h"
 
-#ifndef ATOMIC_64BIT_OPERATIONS
 #include <pthread.h>
+#include <unistd.h>
+#ifdef LINUX
+#include <sched.h>
 #endif
 
 #ifdef HPUX
 #include <machine/sys/inline.h>
 #endif
 
+#define SLAPI_COUNTER_CACHELINE 64
+#define SLAPI_COUNTER_MAX_SHARDS 64
+
+/*
+ * A shard of a sharded counter. Each shard is alone in its cache line
+ * so that threads running on different CPUs never write the same line.
+ */
+typedef struct slapi_counter_shard
+{
+    uint64_t value;
+    char _pad[SLAPI_COUNTER_CACHELINE - sizeof(uint64_t)];
+} slapi_counter_shard;
+
 /*
  * Counter Structure
+ *
+ * A sharded counter adds to the shard of the CPU the caller runs on and
+ * only folds the shards when the value is read.  value then holds the
+ * base set by slapi_counter_set_value().
  */
 typedef struct slapi_counter
 {
@@ -34,8 +53,52 @@ typedef struct slapi_counter
 #ifndef ATOMIC_64BIT_OPERATIONS
     pthread_mutex_t _lock;
 #endif
+    slapi_counter_shard *shards; /* NULL unless the counter is sharded */
+    void *shards_mem;            /* unaligned allocation holding shards */
+    uint32_t shard_mask;
 } slapi_counter;
 
+#ifdef ATOMIC_64BIT_OPERATIONS
+static uint32_t slapi_counter_nshards = 0;
+
+/*
+ * Number of shards of a sharded counter: the number of CPUs rounded up
+ * to a power of two, so a CPU id can be masked into a shard index.
+ */
+static uint32_t
+slapi_counter_get_nshards(void)
+{
+    uint32_t nshards = slapi_counter_nshards;
+
+    if (nshards == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+        nshards = 1;
+        while (nshards < ncpus && nshards < SLAPI_COUNTER_MAX_SHARDS) {
+            nshards <<= 1;
+        }
+        slapi_counter_nshards = nshards;
+    }
+    return nshards;
+}
+
+/*
+ * Index of the shard the calling thread should update.  Threads moving
+ * to another CPU between two updates is harmless: every shard is updated
+ * atomically, sharding only keeps the common case contention free.
+ */
+static inline uint32_t
+slapi_counter_shard_index(const Slapi_Counter *counter)
+{
+#ifdef LINUX
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        return (uint32_t)cpu & counter->shard_mask;
+    }
+#endif
+    return (uint32_t)(((uintptr_t)pthread_self() >> 6) * 2654435761U) & counter->shard_mask;
+}
+#endif
+
 /*
  * slapi_counter_new()
  *
@@ -55,6 +118,35 @@ slapi_counter_new()
     return counter;
 }
 
+/*
+ * slapi_counter_new_sharded()
+ *
+ * Allocates a Slapi_Counter for statistics that are updated very often
+ * from many threads.  Updates go to a per-CPU shard and the shards are
+ * summed by slapi_counter_get_value(), so reading it is more expensive
+ * and the value returned by the add/subtract functions is always 0.
+ * Do not use it when the result of an update is needed (sequence
+ * numbers, reference counts that are tested against 0).
+ *
+ * Without 64-bit atomics this is a regular counter.
+ */
+Slapi_Counter *
+slapi_counter_new_sharded()
+{
+    Slapi_Counter *counter = slapi_counter_new();
+
+#ifdef ATOMIC_64BIT_OPERATIONS
+    uint32_t nshards = slapi_counter_get_nshards();
+
+    counter->shards_mem = slapi_ch_calloc(nshards + 1, sizeof(slapi_counter_shard));
+    counter->shards = (slapi_counter_shard *)(((uintptr_t)counter->shards_mem + SLAPI_COUNTER_CACHELINE - 1) &
+                                              ~(uintptr_t)(SLAPI_COUNTER_CACHELINE - 1));
+    counter->shard_mask = nshards - 1;
+#endif
+
+    return counter;
+}
+
 /*
  * slapi_counter_init()
  *
@@ -85,6 +177,7 @@ slapi_counter_destroy(Slapi_Counter **counter)
 #ifndef ATOMIC_64BIT_OPERATIONS
         pthread_mutex_destroy(&((*counter)->_lock));
 #endif
+        slapi_ch_free(&((*counter)->shards_mem));
         slapi_ch_free((void **)counter);
     }
 }
@@ -127,6 +220,10 @@ slapi_counter_add(Slapi_Counter *counter, uint64_t addvalue)
         return newvalue;
     }
 #ifdef ATOMIC_64BIT_OPERATIONS
+    if (counter->shards) {
+        __atomic_add_fetch_8(&(counter->shards[slapi_counter_shard_index(counter)].value), addvalue, __ATOMIC_RELAXED);
+        return newvalue;
+    }
     newvalue = __atomic_add_fetch_8(&(counter->value), addvalue, __ATOMIC_RELAXED);
 #else
 #ifdef HPUX
@@ -181,6 +278,10 @@ slapi_counter_subtract(Slapi_Counter *counter, uint64_t subvalue)
     }
 
 #ifdef ATOMIC_64BIT_OPERATIONS
+    if (counter->shards) {
+        __atomic_sub_fetch_8(&(counter->shards[slapi_counter_shard_index(counter)].value), subvalue, __ATOMIC_RELAXED);
+        return newvalue;
+    }
     newvalue = __atomic_sub_fetch_8(&(counter->value), subvalue, __ATOMIC_RELAXED);
 #else
 #ifdef HPUX
@@ -234,6 +335,13 @@ slapi_counter_set_value(Slapi_Counter *counter, uint64_t newvalue)
     }
 
 #ifdef ATOMIC_64BIT_OPERATIONS
+    if (counter->shards) {
+        /* Not atomic with regard to concurrent updates, which is fine
+         * for the statistics sharded counters are meant for. */
+        for (uint32_t i = 0; i <= counter->shard_mask; i++) {
+            __atomic_store_8(&(counter->shards[i].value), 0, __ATOMIC_RELAXED);
+        }
+    }
     __atomic_store_8(&(counter->value), newvalue, __ATOMIC_RELAXED);
 #else /* HPUX */
 #ifdef HPUX
@@ -267,6 +375,11 @@ slapi_counter_get_value(Slapi_Counter *counter)
 
 #ifdef ATOMIC_64BIT_OPERATIONS
     value = __atomic_load_8(&(counter->value), __ATOMIC_RELAXED);
+    if (counter->shards) {
+        for (uint32_t i = 0; i <= counter->shard_mask; i++) {
+            value += __atomic_load_8(&(counter->shards[i].value), __ATOMIC_RELAXED);
+        }
+    }
 #else /* HPUX */
 #ifdef HPUX
     do {
@@ -54,8 +54,9 @@ static int search_interaction_table(char *dsURL, int *isnew);
 static void loadConfigStats(void);
 static Slapi_Entry *getConfigEntry(Slapi_Entry **e);
 static void freeConfigEntry(Slapi_Entry **e);
-static void snmp_update_ops_table(void);
-static void snmp_update_entries_table(void);
+static void snmp_fold_counters(struct ops_stats_t *ops, struct entries_stats_t *entries);
+static void snmp_update_counters_tables(void);
+static void snmp_update_latency_tables(void);
 static void snmp_update_interactions_table(void);
 static void snmp_update_cache_stats(void);
 static void snmp_collator_create_semaphore(void);
@@ -98,43 +99,48 @@ snmp_collator_init(void)
      * Create the per threads SNMP counters
      */
     for (snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        snmp_vars->ops_tbl.dsAnonymousBinds = slapi_counter_new();
-        snmp_vars->ops_tbl.dsUnAuthBinds = slapi_counter_new();
-        snmp_vars->ops_tbl.dsSimpleAuthBinds = slapi_counter_new();
-        snmp_vars->ops_tbl.dsStrongAuthBinds = slapi_counter_new();
-        snmp_vars->ops_tbl.dsBindSecurityErrors = slapi_counter_new();
-        snmp_vars->ops_tbl.dsInOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsReadOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsCompareOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsAddEntryOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsRemoveEntryOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsModifyEntryOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsModifyRDNOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsListOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsSearchOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsOneLevelSearchOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsWholeSubtreeSearchOps = slapi_counter_new();
-        snmp_vars->ops_tbl.dsReferrals = slapi_counter_new();
-        snmp_vars->ops_tbl.dsChainings = slapi_counter_new();
-        snmp_vars->ops_tbl.dsSecurityErrors = slapi_counter_new();
-        snmp_vars->ops_tbl.dsErrors = slapi_counter_new();
-        snmp_vars->ops_tbl.dsConnections = slapi_counter_new();
-        snmp_vars->ops_tbl.dsConnectionSeq = slapi_counter_new();
-        snmp_vars->ops_tbl.dsBytesRecv = slapi_counter_new();
-        snmp_vars->ops_tbl.dsBytesSent = slapi_counter_new();
-        snmp_vars->ops_tbl.dsEntriesReturned = slapi_counter_new();
-        snmp_vars->ops_tbl.dsReferralsReturned = slapi_counter_new();
-        snmp_vars->ops_tbl.dsConnectionsInMaxThreads = slapi_counter_new();
-        snmp_vars->ops_tbl.dsMaxThreadsHits = slapi_counter_new();
-        snmp_vars->entries_tbl.dsSupplierEntries = slapi_counter_new();
-        snmp_vars->entries_tbl.dsCopyEntries = slapi_counter_new();
-        snmp_vars->entries_tbl.dsCacheEntries = slapi_counter_new();
-        snmp_vars->entries_tbl.dsCacheHits = slapi_counter_new();
-        snmp_vars->entries_tbl.dsConsumerHits = slapi_counter_new();
-        snmp_vars->server_tbl.dsOpInitiated = slapi_counter_new();
-        snmp_vars->server_tbl.dsOpCompleted = slapi_counter_new();
-        snmp_vars->server_tbl.dsEntriesSent = slapi_counter_new();
-        snmp_vars->server_tbl.dsBytesSent = slapi_counter_new();
+        /* The first slot is shared by all the threads that are not workers
+         * (listener, persistent searches, replication, tasks...): shard its
+         * counters so that they do not bounce between CPUs. */
+        Slapi_Counter *(*counter_new)(void) = (cookie == 0) ? slapi_counter_new_sharded : slapi_counter_new;
+
+        snmp_vars->ops_tbl.dsAnonymousBinds = counter_new();
+        snmp_vars->ops_tbl.dsUnAuthBinds = counter_new();
+        snmp_vars->ops_tbl.dsSimpleAuthBinds = counter_new();
+        snmp_vars->ops_tbl.dsStrongAuthBinds = counter_new();
+        snmp_vars->ops_tbl.dsBindSecurityErrors = counter_new();
+        snmp_vars->ops_tbl.dsInOps = counter_new();
+        snmp_vars->ops_tbl.dsReadOps = counter_new();
+        snmp_vars->ops_tbl.dsCompareOps = counter_new();
+        snmp_vars->ops_tbl.dsAddEntryOps = counter_new();
+        snmp_vars->ops_tbl.dsRemoveEntryOps = counter_new();
+        snmp_vars->ops_tbl.dsModifyEntryOps = counter_new();
+        snmp_vars->ops_tbl.dsModifyRDNOps = counter_new();
+        snmp_vars->ops_tbl.dsListOps = counter_new();
+        snmp_vars->ops_tbl.dsSearchOps = counter_new();
+        snmp_vars->ops_tbl.dsOneLevelSearchOps = counter_new();
+        snmp_vars->ops_tbl.dsWholeSubtreeSearchOps = counter_new();
+        snmp_vars->ops_tbl.dsReferrals = counter_new();
+        snmp_vars->ops_tbl.dsChainings = counter_new();
+        snmp_vars->ops_tbl.dsSecurityErrors = counter_new();
+        snmp_vars->ops_tbl.dsErrors = counter_new();
+        snmp_vars->ops_tbl.dsConnections = counter_new();
+        snmp_vars->ops_tbl.dsConnectionSeq = counter_new();
+        snmp_vars->ops_tbl.dsBytesRecv = counter_new();
+        snmp_vars->ops_tbl.dsBytesSent = counter_new();
+        snmp_vars->ops_tbl.dsEntriesReturned = counter_new();
+        snmp_vars->ops_tbl.dsReferralsReturned = counter_new();
+        snmp_vars->ops_tbl.dsConnectionsInMaxThreads = counter_new();
+        snmp_vars->ops_tbl.dsMaxThreadsHits = counter_new();
+        snmp_vars->entries_tbl.dsSupplierEntries = counter_new();
+        snmp_vars->entries_tbl.dsCopyEntries = counter_new();
+        snmp_vars->entries_tbl.dsCacheEntries = counter_new();
+        snmp_vars->entries_tbl.dsCacheHits = counter_new();
+        snmp_vars->entries_tbl.dsConsumerHits = counter_new();
+        snmp_vars->server_tbl.dsOpInitiated = counter_new();
+        snmp_vars->server_tbl.dsOpCompleted = counter_new();
+        snmp_vars->server_tbl.dsEntriesSent = counter_new();
+        snmp_vars->server_tbl.dsBytesSent = counter_new();
 
         /* Initialize the global interaction table */
         for (i = 0; i < NUM_SNMP_INT_TBL_ROWS; i++) {
@@ -166,8 +172,8 @@ snmp_collator_init(void)
     loadConfigStats();
 
     /* update the mmap'd tables */
-    snmp_update_ops_table();
-    snmp_update_entries_table();
+    snmp_update_counters_tables();
+    snmp_update_latency_tables();
     snmp_update_interactions_table();
 
     /* Release the semaphore */
@@ -575,8 +581,8 @@ snmp_collator_update(time_t start_time __attribute__((unused)), void *arg __attr
     }
 
     /* update the mmap'd tables */
-    snmp_update_ops_table();
-    snmp_update_entries_table();
+    snmp_update_counters_tables();
+    snmp_update_latency_tables();
     snmp_update_interactions_table();
 
     /* release the semaphore */
@@ -584,196 +590,96 @@ snmp_collator_update(time_t start_time __attribute__((unused)), void *arg __attr
 }
 
 /*
- * snmp_update_ops_table()
+ * snmp_fold_counters()
  *
- * Updates the mmap'd operations table.  The semaphore
- * should be acquired before you call this.
+ * Sums the counters of all the per thread slots in a single pass.
+ * Sharded counters are folded by slapi_counter_get_value().
  */
 static void
-snmp_update_ops_table(void)
+snmp_fold_counters(struct ops_stats_t *ops, struct entries_stats_t *entries)
 {
     int cookie;
     struct snmp_vars_t *snmp_vars;
-    int32_t total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsAnonymousBinds);
-    }
-    stats->ops_stats.dsAnonymousBinds = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsUnAuthBinds);
-    }
-    stats->ops_stats.dsUnAuthBinds = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsSimpleAuthBinds);
-    }
-    stats->ops_stats.dsSimpleAuthBinds = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsStrongAuthBinds);
-    }
-    stats->ops_stats.dsStrongAuthBinds = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsBindSecurityErrors);
-    }
-    stats->ops_stats.dsBindSecurityErrors = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsInOps);
-    }
-    stats->ops_stats.dsInOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsReadOps);
-    }
-    stats->ops_stats.dsReadOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsCompareOps);
-    }
-    stats->ops_stats.dsCompareOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsAddEntryOps);
-    }
-    stats->ops_stats.dsAddEntryOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsRemoveEntryOps);
-    }
-    stats->ops_stats.dsRemoveEntryOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsModifyEntryOps);
-    }
-    stats->ops_stats.dsModifyEntryOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsModifyRDNOps);
-    }
-    stats->ops_stats.dsModifyRDNOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsListOps);
-    }
-    stats->ops_stats.dsListOps = total;
 
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsSearchOps);
-    }
-    stats->ops_stats.dsSearchOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsOneLevelSearchOps);
-    }
-    stats->ops_stats.dsOneLevelSearchOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsWholeSubtreeSearchOps);
-    }
-    stats->ops_stats.dsWholeSubtreeSearchOps = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsReferrals);
-    }
-    stats->ops_stats.dsReferrals = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsChainings);
-    }
-    stats->ops_stats.dsChainings = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsSecurityErrors);
-    }
-    stats->ops_stats.dsSecurityErrors = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsErrors);
-    }
-    stats->ops_stats.dsErrors = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnections);
-    }
-    stats->ops_stats.dsConnections = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnectionSeq);
-    }
-    stats->ops_stats.dsConnectionSeq = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnectionsInMaxThreads);
-    }
-    stats->ops_stats.dsConnectionsInMaxThreads = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsMaxThreadsHits);
-    }
-    stats->ops_stats.dsMaxThreadsHits = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsBytesRecv);
-    }
-    stats->ops_stats.dsBytesRecv = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsBytesSent);
+    memset(ops, 0, sizeof(*ops));
+    memset(entries, 0, sizeof(*entries));
+    for (snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
+        ops->dsAnonymousBinds += slapi_counter_get_value(snmp_vars->ops_tbl.dsAnonymousBinds);
+        ops->dsUnAuthBinds += slapi_counter_get_value(snmp_vars->ops_tbl.dsUnAuthBinds);
+        ops->dsSimpleAuthBinds += slapi_counter_get_value(snmp_vars->ops_tbl.dsSimpleAuthBinds);
+        ops->dsStrongAuthBinds += slapi_counter_get_value(snmp_vars->ops_tbl.dsStrongAuthBinds);
+        ops->dsBindSecurityErrors += slapi_counter_get_value(snmp_vars->ops_tbl.dsBindSecurityErrors);
+        ops->dsInOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsInOps);
+        ops->dsReadOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsReadOps);
+        ops->dsCompareOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsCompareOps);
+        ops->dsAddEntryOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsAddEntryOps);
+        ops->dsRemoveEntryOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsRemoveEntryOps);
+        ops->dsModifyEntryOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsModifyEntryOps);
+        ops->dsModifyRDNOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsModifyRDNOps);
+        ops->dsListOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsListOps);
+        ops->dsSearchOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsSearchOps);
+        ops->dsOneLevelSearchOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsOneLevelSearchOps);
+        ops->dsWholeSubtreeSearchOps += slapi_counter_get_value(snmp_vars->ops_tbl.dsWholeSubtreeSearchOps);
+        ops->dsReferrals += slapi_counter_get_value(snmp_vars->ops_tbl.dsReferrals);
+        ops->dsChainings += slapi_counter_get_value(snmp_vars->ops_tbl.dsChainings);
+        ops->dsSecurityErrors += slapi_counter_get_value(snmp_vars->ops_tbl.dsSecurityErrors);
+        ops->dsErrors += slapi_counter_get_value(snmp_vars->ops_tbl.dsErrors);
+        ops->dsConnections += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnections);
+        ops->dsConnectionSeq += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnectionSeq);
+        ops->dsMaxThreadsHits += slapi_counter_get_value(snmp_vars->ops_tbl.dsMaxThreadsHits);
+        ops->dsConnectionsInMaxThreads += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnectionsInMaxThreads);
+        ops->dsBytesRecv += slapi_counter_get_value(snmp_vars->ops_tbl.dsBytesRecv);
+        ops->dsBytesSent += slapi_counter_get_value(snmp_vars->ops_tbl.dsBytesSent);
+        ops->dsEntriesReturned += slapi_counter_get_value(snmp_vars->ops_tbl.dsEntriesReturned);
+        ops->dsReferralsReturned += slapi_counter_get_value(snmp_vars->ops_tbl.dsReferralsReturned);
+        entries->dsSupplierEntries += slapi_counter_get_value(snmp_vars->entries_tbl.dsSupplierEntries);
+        entries->dsCopyEntries += slapi_counter_get_value(snmp_vars->entries_tbl.dsCopyEntries);
+        entries->dsCacheEntries += slapi_counter_get_value(snmp_vars->entries_tbl.dsCacheEntries);
+        entries->dsCacheHits += slapi_counter_get_value(snmp_vars->entries_tbl.dsCacheHits);
+        entries->dsConsumerHits += slapi_counter_get_value(snmp_vars->entries_tbl.dsConsumerHits);
     }
-    stats->ops_stats.dsBytesSent = total;
+}
 
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsEntriesReturned);
-    }
-    stats->ops_stats.dsEntriesReturned = total;
+/*
+ * snmp_update_counters_tables()
+ *
+ * Updates the mmap'd operations and entries tables.  The semaphore
+ * should be acquired before you call this.
+ */
+static void
+snmp_update_counters_tables(void)
+{
+    struct ops_stats_t ops;
+    struct entries_stats_t entries;
 
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsReferralsReturned);
-    }
-    stats->ops_stats.dsReferralsReturned = total;
+    snmp_fold_counters(&ops, &entries);
+    stats->ops_stats = ops;
+    stats->entries_stats = entries;
 }
 
 /*
- * snmp_update_entries_table()
+ * snmp_update_latency_tables()
  *
- * Updated the mmap'd entries table.  The semaphore should
+ * Updates the mmap'd latency percentiles.  The semaphore should
  * be acquired before you call this.
  */
 static void
-snmp_update_entries_table(void)
+snmp_update_latency_tables(void)
 {
-    int cookie;
-    struct snmp_vars_t *snmp_vars;
-    int32_t total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsSupplierEntries);
-    }
-    stats->entries_stats.dsSupplierEntries = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsCopyEntries);
-    }
-    stats->entries_stats.dsCopyEntries = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsCacheEntries);
-    }
-    stats->entries_stats.dsCacheEntries = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsCacheHits);
-    }
-    stats->entries_stats.dsCacheHits = total;
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsConsumerHits);
+    op_latency_summary summary[OP_LATENCY_NB_TYPES][OP_LATENCY_NB_KINDS];
+
+    op_latency_summarize(NULL, summary);
+    for (size_t type = 0; type < OP_LATENCY_NB_TYPES && type < NUM_SNMP_LATENCY_OPS; type++) {
+        struct latency_stats_t *out[OP_LATENCY_NB_KINDS] = {&stats->wtime_stats[type], &stats->optime_stats[type]};
+        for (size_t kind = 0; kind < OP_LATENCY_NB_KINDS; kind++) {
+            out[kind]->count = summary[type][kind].count;
+            out[kind]->p50 = summary[type][kind].p50;
+            out[kind]->p90 = summary[type][kind].p90;
+            out[kind]->p99 = summary[type][kind].p99;
+            out[kind]->p999 = summary[type][kind].p999;
+            out[kind]->max = summary[type][kind].max;
+        }
     }
-    stats->entries_stats.dsConsumerHits = total;
 }
 
 /*
@@ -886,174 +792,43 @@ add_counter_to_value(Slapi_Entry *e, const char *type, PRUint64 countervalue)
 void
 snmp_as_entry(Slapi_Entry *e)
 {
-    int cookie;
-    uint64_t total;
-    struct snmp_vars_t *snmp_vars;
-    
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsAnonymousBinds);
-    }
-    add_counter_to_value(e, "AnonymousBinds", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsUnAuthBinds);
-    }
-    add_counter_to_value(e, "UnAuthBinds", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsSimpleAuthBinds);
-    }
-    add_counter_to_value(e, "SimpleAuthBinds", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsStrongAuthBinds);
-    }
-    add_counter_to_value(e, "StrongAuthBinds", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsBindSecurityErrors);
-    }
-    add_counter_to_value(e, "BindSecurityErrors", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsInOps);
-    }
-    add_counter_to_value(e, "InOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsReadOps);
-    }
-    add_counter_to_value(e, "ReadOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsCompareOps);
-    }
-    add_counter_to_value(e, "CompareOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsAddEntryOps);
-    }
-    add_counter_to_value(e, "AddEntryOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsRemoveEntryOps);
-    }
-    add_counter_to_value(e, "RemoveEntryOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsModifyEntryOps);
-    }
-    add_counter_to_value(e, "ModifyEntryOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsModifyRDNOps);
-    }
-    add_counter_to_value(e, "ModifyRDNOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsListOps);
-    }
-    add_counter_to_value(e, "ListOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsSearchOps);
-    }
-    add_counter_to_value(e, "SearchOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsOneLevelSearchOps);
-    }
-    add_counter_to_value(e, "OneLevelSearchOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsWholeSubtreeSearchOps);
-    }
-    add_counter_to_value(e, "WholeSubtreeSearchOps", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsReferrals);
-    }
-    add_counter_to_value(e, "Referrals", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsChainings);
-    }
-    add_counter_to_value(e, "Chainings", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsSecurityErrors);
-    }
-    add_counter_to_value(e, "SecurityErrors", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsErrors);
-    }
-    add_counter_to_value(e, "Errors", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnections);
-    }
-    add_counter_to_value(e, "Connections", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnectionSeq);
-    }
-    add_counter_to_value(e, "ConnectionSeq", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsConnectionsInMaxThreads);
-    }
-    add_counter_to_value(e, "ConnectionsInMaxThreads", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsMaxThreadsHits);
-    }
-    add_counter_to_value(e, "ConnectionsMaxThreadsCount", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsBytesRecv);
-    }
-    add_counter_to_value(e, "BytesRecv", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsBytesSent);
-    }
-    add_counter_to_value(e, "BytesSent", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsEntriesReturned);
-    }
-    add_counter_to_value(e, "EntriesReturned", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->ops_tbl.dsReferralsReturned);
-    }
-    add_counter_to_value(e, "ReferralsReturned", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsSupplierEntries);
-    }
-    add_counter_to_value(e, "SupplierEntries", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsCopyEntries);
-    }
-    add_counter_to_value(e, "CopyEntries", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsCacheEntries);
-    }
-    add_counter_to_value(e, "CacheEntries", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsCacheHits);
-    }
-    add_counter_to_value(e, "CacheHits", total);
-
-    for (total = 0, snmp_vars = g_get_first_thread_snmp_vars(&cookie); snmp_vars; snmp_vars = g_get_next_thread_snmp_vars(&cookie)) {
-        total += slapi_counter_get_value(snmp_vars->entries_tbl.dsConsumerHits);
-    }
-    add_counter_to_value(e, "ConsumerHits", total);
+    struct ops_stats_t ops;
+    struct entries_stats_t entries;
+
+    snmp_fold_counters(&ops, &entries);
+    add_counter_to_value(e, "AnonymousBinds", ops.dsAnonymousBinds);
+    add_counter_to_value(e, "UnAuthBinds", ops.dsUnAuthBinds);
+    add_counter_to_value(e, "SimpleAuthBinds", ops.dsSimpleAuthBinds);
+    add_counter_to_value(e, "StrongAuthBinds", ops.dsStrongAuthBinds);
+    add_counter_to_value(e, "BindSecurityErrors", ops.dsBindSecurityErrors);
+    add_counter_to_value(e, "InOps", ops.dsInOps);
+    add_counter_to_value(e, "ReadOps", ops.dsReadOps);
+    add_counter_to_value(e, "CompareOps", ops.dsCompareOps);
+    add_counter_to_value(e, "AddEntryOps", ops.dsAddEntryOps);
+    add_counter_to_value(e, "RemoveEntryOps", ops.dsRemoveEntryOps);
+    add_counter_to_value(e, "ModifyEntryOps", ops.dsModifyEntryOps);
+    add_counter_to_value(e, "ModifyRDNOps", ops.dsModifyRDNOps);
+    add_counter_to_value(e, "ListOps", ops.dsListOps);
+    add_counter_to_value(e, "SearchOps", ops.dsSearchOps);
+    add_counter_to_value(e, "OneLevelSearchOps", ops.dsOneLevelSearchOps);
+    add_counter_to_value(e, "WholeSubtreeSearchOps", ops.dsWholeSubtreeSearchOps);
+    add_counter_to_value(e, "Referrals", ops.dsReferrals);
+    add_counter_to_value(e, "Chainings", ops.dsChainings);
+    add_counter_to_value(e, "SecurityErrors", ops.dsSecurityErrors);
+    add_counter_to_value(e, "Errors", ops.dsErrors);
+    add_counter_to_value(e, "Connections", ops.dsConnections);
+    add_counter_to_value(e, "ConnectionSeq", ops.dsConnectionSeq);
+    add_counter_to_value(e, "ConnectionsInMaxThreads", ops.dsConnectionsInMaxThreads);
+    add_counter_to_value(e, "ConnectionsMaxThreadsCount", ops.dsMaxThreadsHits);
+    add_counter_to_value(e, "BytesRecv", ops.dsBytesRecv);
+    add_counter_to_value(e, "BytesSent", ops.dsBytesSent);
+    add_counter_to_value(e, "EntriesReturned", ops.dsEntriesReturned);
+    add_counter_to_value(e, "ReferralsReturned", ops.dsReferralsReturned);
+    add_counter_to_value(e, "SupplierEntries", entries.dsSupplierEntries);
+    add_counter_to_value(e, "CopyEntries", entries.dsCopyEntries);
+    add_counter_to_value(e, "CacheEntries", entries.dsCacheEntries);
+    add_counter_to_value(e, "CacheHits", entries.dsCacheHits);
+    add_counter_to_value(e, "ConsumerHits", entries.dsConsumerHits);
 }
 
 /*
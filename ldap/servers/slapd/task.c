@@ -1511,8 +1511,11 @@ task_backup_thread(void *arg)
 
     slapi_task_finish(task, rv);
     char *seq_val = NULL;
+    char *base_dir = NULL;
     slapi_pblock_get(pb, SLAPI_SEQ_VAL, &seq_val);
+    slapi_pblock_get(pb, SLAPI_DB2ARCHIVE_BASE_DIR, &base_dir);
     slapi_ch_free((void **)&seq_val);
+    slapi_ch_free_string(&base_dir);
     slapi_pblock_destroy(pb);
     g_decr_active_threadcnt();
 }
@@ -1528,6 +1531,7 @@ task_backup_add(Slapi_PBlock *pb __attribute__((unused)),
     Slapi_Backend *be = NULL;
     PRThread *thread = NULL;
     const char *archive_dir = NULL;
+    const char *base_dir = NULL;
     const char *my_database_type = NULL;
     const char *database_type = "ldbm database";
     char *cookie = NULL;
@@ -1549,6 +1553,9 @@ task_backup_add(Slapi_PBlock *pb __attribute__((unused)),
         goto out;
     }
 
+    /* optional: only store what changed since this backup */
+    base_dir = slapi_entry_attr_get_ref(e, "nsArchiveBaseDir");
+
     /* database type */
     my_database_type = slapi_entry_attr_get_ref(e, "nsDatabaseType");
     if (NULL != my_database_type)
@@ -1600,6 +1607,9 @@ task_backup_add(Slapi_PBlock *pb __attribute__((unused)),
     }
     char *seq_val = slapi_ch_strdup(archive_dir);
     slapi_pblock_set(mypb, SLAPI_SEQ_VAL, seq_val);
+    if (base_dir) {
+        slapi_pblock_set(mypb, SLAPI_DB2ARCHIVE_BASE_DIR, slapi_ch_strdup(base_dir));
+    }
     slapi_pblock_set(mypb, SLAPI_PLUGIN, (be->be_database));
     slapi_pblock_set(mypb, SLAPI_BACKEND_TASK, task);
     int32_t task_flags = SLAPI_TASK_RUNNING_AS_TASK;
@@ -1615,6 +1625,11 @@ task_backup_add(Slapi_PBlock *pb __attribute__((unused)),
         *returncode = LDAP_OPERATIONS_ERROR;
         rv = SLAPI_DSE_CALLBACK_ERROR;
         slapi_ch_free((void **)&seq_val);
+        if (base_dir) {
+            char *base_copy = NULL;
+            slapi_pblock_get(mypb, SLAPI_DB2ARCHIVE_BASE_DIR, &base_copy);
+            slapi_ch_free_string(&base_copy);
+        }
         slapi_pblock_destroy(mypb);
         goto out;
     }
@@ -0,0 +1,422 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2024 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/*
+    FILE :        latency.c
+    DESCRIPTION :
+            This file implements the latency histograms of the
+            operations (-e latency) and the open loop mode (-e rate).
+            In open loop mode, each thread issues its operations on
+            a fixed schedule, whatever the response time of the
+            server is, and the latency of an operation is measured
+            from the time it should have been sent. This way, the
+            time an operation waits because the previous ones are
+            late (aka coordinated omission) is accounted for.
+            The histograms are private to each thread, and are only
+            merged for the reports.
+    LOCAL :        None.
+*/
+
+#include <stdio.h>                              /* printf(), etc... */
+#include <string.h>                             /* strerror(), etc... */
+#include <stdlib.h>                             /* calloc(), etc... */
+#include <errno.h>                              /* errno, etc... */
+#include <time.h>                               /* clock_gettime(), etc... */
+#include <lber.h>                               /* ldap C-API BER declarations */
+#include <ldap.h>                               /* ldap C-API declarations */
+#include <pthread.h>                            /* pthreads(), etc... */
+#include "port.h" /* Portability definitions */
+#include "ldclt.h"                              /* This tool's include file */
+
+
+static const char *latencyNames[LAT_NB_OPS] = {
+    "bind",
+    "search",
+    "add",
+    "modify",
+    "delete",
+    "rename",
+};
+
+static struct timespec latencyStartTime; /* Start of the run */
+static long long latencyInterval = 0;    /* ns between two ops of a thread */
+
+
+static long long
+tsDiffNs(
+    const struct timespec *a,
+    const struct timespec *b)
+{
+    return (long long)(a->tv_sec - b->tv_sec) * 1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+static void
+tsAddNs(
+    struct timespec *ts,
+    long long ns)
+{
+    ns += ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+static int
+latencyBucket(
+    unsigned long long usec)
+{
+    int msb;
+
+    if (usec < LAT_SUB_COUNT)
+        return ((int)usec);
+    msb = 63 - __builtin_clzll(usec);
+    if (msb >= LAT_MAX_BITS)
+        return (LAT_NB_BUCKETS - 1);
+    return (((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) +
+            (int)((usec >> (msb - LAT_SUB_BITS)) & (LAT_SUB_COUNT - 1)));
+}
+
+/*
+ * Highest value that falls in a bucket
+ */
+static unsigned long long
+latencyBucketValue(
+    int idx)
+{
+    int group = idx >> LAT_SUB_BITS;
+    int sub = idx & (LAT_SUB_COUNT - 1);
+
+    if (group == 0)
+        return (idx);
+    return (((unsigned long long)(LAT_SUB_COUNT | sub) << (group - 1)) +
+            ((1ULL << (group - 1)) - 1));
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    latencyInit
+    PURPOSE :    Initiates the latency measurement.
+    INPUT :        None.
+    OUTPUT :    None.
+    RETURN :    -1 if error, 0 else.
+    DESCRIPTION :
+ *****************************************************************************/
+int
+latencyInit(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &latencyStartTime);
+    if (mctx.mod2 & M2_OPEN_LOOP) {
+        latencyInterval = (long long)(1000000000.0 * mctx.nbThreads / mctx.rate);
+        if (latencyInterval < 1)
+            latencyInterval = 1;
+    }
+    return (0);
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    latencyThreadInit
+    PURPOSE :    Allocates the histograms of a thread, and starts its
+            schedule in open loop mode. The threads start shifted
+            so that the operations are evenly spread.
+    INPUT :        tttctx    = thread context
+    OUTPUT :    None.
+    RETURN :    -1 if error, 0 else.
+    DESCRIPTION :
+ *****************************************************************************/
+int
+latencyThreadInit(
+    thread_context *tttctx)
+{
+    tttctx->latency = (lat_hist *)calloc(LAT_NB_OPS, sizeof(lat_hist));
+    if (tttctx->latency == NULL) {
+        printf("ldclt[%d]: T%03d: cannot calloc(tttctx->latency), error=%d (%s)\n",
+               mctx.pid, tttctx->thrdNum, errno, strerror(errno));
+        return (-1);
+    }
+    tttctx->latNext = 0;
+    clock_gettime(CLOCK_MONOTONIC, &(tttctx->latOrigin));
+    tsAddNs(&(tttctx->latOrigin), latencyInterval * tttctx->thrdNum / mctx.nbThreads);
+    return (0);
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    latencyOperStart
+    PURPOSE :    Called before each operation. In open loop mode, waits
+            for the time the operation is scheduled. The results of
+            the pending asynchronous operations are read meanwhile,
+            and if the max pending operations is reached, we wait
+            for one of them to complete before sending.
+    INPUT :        tttctx    = thread context
+            type    = operation type (LAT_xxx)
+    OUTPUT :    None.
+    RETURN :    -1 if error, 0 else.
+    DESCRIPTION :
+ *****************************************************************************/
+int
+latencyOperStart(
+    thread_context *tttctx,
+    int type)
+{
+    struct timespec now;
+    long long remaining;
+    int status;
+
+    tttctx->latType = type;
+    tttctx->latPending = 0;
+    if (!(mctx.mod2 & M2_OPEN_LOOP)) {
+        clock_gettime(CLOCK_MONOTONIC, &(tttctx->latStart));
+        return (0);
+    }
+
+    /*
+   * The intended start time only depends on the schedule, not on the
+   * time the previous operations took.
+   */
+    tttctx->latStart = tttctx->latOrigin;
+    tsAddNs(&(tttctx->latStart), latencyInterval * tttctx->latNext);
+    tttctx->latNext++;
+
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remaining = tsDiffNs(&(tttctx->latStart), &now);
+        if (!(mctx.mode & ASYNC)) {
+            if (remaining <= 0)
+                break;
+            now.tv_sec = remaining / 1000000000LL;
+            now.tv_nsec = remaining % 1000000000LL;
+            nanosleep(&now, NULL);
+            continue;
+        }
+        if ((remaining <= 0) && (tttctx->pendingNb < mctx.asyncMax))
+            break;
+        if (remaining <= 0) {
+            /*
+       * The pool is full and we are late: don't wait forever if
+       * we are asked to shutdown.
+       */
+            if (getThreadStatus(tttctx, &status) < 0)
+                return (-1);
+            if (status == MUST_SHUTDOWN)
+                break;
+            remaining = 100000000LL;
+        }
+        if (waitPending(tttctx, (long)(remaining / 1000)) < 0)
+            return (-1);
+    }
+    return (0);
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    latencyOperEnd
+    PURPOSE :    Called after each operation. Records the latency of
+            the operations that completed synchronously, whatever
+            the running mode. The ones registered by msgIdAdd() are
+            recorded when their result is received, see msgIdDel().
+    INPUT :        tttctx    = thread context
+    OUTPUT :    None.
+    RETURN :    None.
+    DESCRIPTION :
+ *****************************************************************************/
+void
+latencyOperEnd(
+    thread_context *tttctx)
+{
+    if (!tttctx->latPending)
+        latencyRecord(tttctx, tttctx->latType, &(tttctx->latStart));
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    latencyRecord
+    PURPOSE :    Records the latency of an operation that completes now.
+    INPUT :        tttctx    = thread context
+            type    = operation type (LAT_xxx)
+            start    = intended start time of the operation
+    OUTPUT :    None.
+    RETURN :    None.
+    DESCRIPTION :
+ *****************************************************************************/
+void
+latencyRecord(
+    thread_context *tttctx,
+    int type,
+    struct timespec *start)
+{
+    struct timespec now;
+    long long ns;
+    unsigned long long usec;
+    lat_hist *h;
+
+    if ((tttctx->latency == NULL) || (type < 0) || (type >= LAT_NB_OPS))
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = tsDiffNs(&now, start);
+    usec = (ns > 0) ? (unsigned long long)(ns / 1000) : 0;
+
+    h = &(tttctx->latency[type]);
+    if ((h->count == 0) || (usec < h->min))
+        h->min = usec;
+    if (usec > h->max)
+        h->max = usec;
+    h->count++;
+    h->sum += usec;
+    h->buckets[latencyBucket(usec)]++;
+}
+
+
+/*
+ * Merges the histograms of all the threads for an operation type.
+ */
+static void
+latencyMerge(
+    int type,
+    lat_hist *total)
+{
+    lat_hist *h;
+
+    memset(total, 0, sizeof(lat_hist));
+    for (int i = 0; i < mctx.nbThreads; i++) {
+        if (tctx[i].latency == NULL)
+            continue;
+        h = &(tctx[i].latency[type]);
+        if (h->count == 0)
+            continue;
+        if ((total->count == 0) || (h->min < total->min))
+            total->min = h->min;
+        if (h->max > total->max)
+            total->max = h->max;
+        total->count += h->count;
+        total->sum += h->sum;
+        for (int b = 0; b < LAT_NB_BUCKETS; b++)
+            total->buckets[b] += h->buckets[b];
+    }
+}
+
+/*
+ * Value at the given percentile (per thousand), never above the max.
+ */
+static unsigned long long
+latencyPercentile(
+    lat_hist *h,
+    int permil)
+{
+    unsigned long long rank;
+    unsigned long long seen = 0;
+    unsigned long long val;
+
+    if (h->count == 0)
+        return (0);
+    rank = (h->count * permil + 999) / 1000;
+    for (int b = 0; b < LAT_NB_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if ((seen > 0) && (seen >= rank)) {
+            val = latencyBucketValue(b);
+            return ((val > h->max) ? h->max : val);
+        }
+    }
+    return (h->max);
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    latencyPrint
+    PURPOSE :    Prints the latency percentiles of each operation type.
+    INPUT :        None.
+    OUTPUT :    None.
+    RETURN :    None.
+    DESCRIPTION :
+ *****************************************************************************/
+void
+latencyPrint(void)
+{
+    lat_hist *total;
+
+    if (!(mctx.mod2 & M2_LATENCY))
+        return;
+    if ((total = (lat_hist *)malloc(sizeof(lat_hist))) == NULL)
+        return;
+
+    for (int type = 0; type < LAT_NB_OPS; type++) {
+        latencyMerge(type, total);
+        if (total->count == 0)
+            continue;
+        printf("ldclt[%d]: Global %s latency (usec): count=%llu mean=%llu p50=%llu p90=%llu p99=%llu p999=%llu max=%llu\n",
+               mctx.pid, latencyNames[type], total->count, total->sum / total->count,
+               latencyPercentile(total, 500), latencyPercentile(total, 900),
+               latencyPercentile(total, 990),
+               latencyPercentile(total, 999), total->max);
+    }
+    free(total);
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    latencyDumpJson
+    PURPOSE :    Writes the latency results in the file given by
+            -e latencyjson, to compare runs.
+    INPUT :        None.
+    OUTPUT :    None.
+    RETURN :    -1 if error, 0 else.
+    DESCRIPTION :
+ *****************************************************************************/
+int
+latencyDumpJson(void)
+{
+    struct timespec now;
+    lat_hist *total;
+    FILE *fp;
+    int first = 1;
+
+    if ((mctx.latencyJson == NULL) || (latencyStartTime.tv_sec == 0))
+        return (0);
+    if ((total = (lat_hist *)malloc(sizeof(lat_hist))) == NULL)
+        return (-1);
+    if ((fp = fopen(mctx.latencyJson, "w")) == NULL) {
+        printf("ldclt[%d]: Cannot open %s, error=%d (%s)\n",
+               mctx.pid, mctx.latencyJson, errno, strerror(errno));
+        free(total);
+        return (-1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"mode\": \"%s\",\n", (mctx.mod2 & M2_OPEN_LOOP) ? "open-loop" : "closed-loop");
+    fprintf(fp, "  \"rate\": %.2f,\n", (mctx.mod2 & M2_OPEN_LOOP) ? mctx.rate : 0.0);
+    fprintf(fp, "  \"threads\": %d,\n", mctx.nbThreads);
+    fprintf(fp, "  \"async_max_pending\": %d,\n", (mctx.mode & ASYNC) ? mctx.asyncMax : 0);
+    fprintf(fp, "  \"duration_sec\": %.3f,\n", tsDiffNs(&now, &latencyStartTime) / 1e9);
+    fprintf(fp, "  \"unit\": \"usec\",\n");
+    fprintf(fp, "  \"operations\": {");
+    for (int type = 0; type < LAT_NB_OPS; type++) {
+        latencyMerge(type, total);
+        if (total->count == 0)
+            continue;
+        fprintf(fp, "%s\n    \"%s\": {\"count\": %llu, \"min\": %llu, \"mean\": %llu, "
+                    "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+                first ? "" : ",", latencyNames[type], total->count, total->min,
+                total->sum / total->count, latencyPercentile(total, 500),
+                latencyPercentile(total, 900), latencyPercentile(total, 990),
+                latencyPercentile(total, 999), total->max);
+        first = 0;
+    }
+    fprintf(fp, "%s}\n}\n", first ? "" : "\n  ");
+    fclose(fp);
+    free(total);
+    return (0);
+}
+
+
+/* End of file */
@@ -34,6 +34,8 @@
 #include <proto-ldap.h> /* ldap C-API prototypes */
 #endif
 #include <unistd.h>                             /* close(), etc... */
+#include <poll.h>                               /* poll(), etc... */
+#include <time.h>                               /* nanosleep(), etc... */
 #include <pthread.h>                            /* pthreads(), etc... */
 #include "port.h" /* Portability definitions */ /*JLS 29-11-00*/
 #include "ldclt.h"                              /* This tool's include file */
@@ -2062,6 +2064,98 @@ getPending(
 }
 
 
+/* ****************************************************************************
+    FUNCTION :    readPending
+    PURPOSE :    Read, without waiting, all the results already received
+            for the pending requests.
+    INPUT :        tttctx    = thread context
+    OUTPUT :    None.
+    RETURN :    -1 if error, 0 else.
+    DESCRIPTION :
+            The search results are not checked, like in the
+            asynchronous branch of doExactSearch().
+ *****************************************************************************/
+static int
+readPending(
+    thread_context *tttctx)
+{
+    LDAPMessage *res; /* LDAP async results */
+    int ret;          /* Return values */
+
+    if (!(tttctx->mode & EXACT_SEARCH))
+        return (getPending(tttctx, &(mctx.timevalZero)));
+
+    while (tttctx->pendingNb > 0) {
+        ret = ldap_result(tttctx->ldapCtx, LDAP_RES_ANY, 1, &(mctx.timevalZero), &res);
+        if (ret == 0)
+            break;
+        if (ret < 0) {
+            if (!((mctx.mode & QUIET) && ignoreError(ret)))
+                (void)printErrorFromLdap(tttctx, res, ret, "Cannot ldap_result()");
+            if (addErrorStat(ret) < 0)
+                return (-1);
+            break;
+        }
+        tttctx->pendingNb--;
+        if (mctx.mod2 & M2_LATENCY)
+            (void)msgIdDel(tttctx, ldap_msgid(res), 0);
+        if ((ret = ldap_msgfree(res)) < 0) {
+            if (!((mctx.mode & QUIET) && ignoreError(ret))) {
+                printf("ldclt[%d]: T%03d: Cannot ldap_msgfree(), error=%d (%s)\n",
+                       mctx.pid, tttctx->thrdNum, ret, my_ldap_err2string(ret));
+                fflush(stdout);
+            }
+            if (addErrorStat(ret) < 0)
+                return (-1);
+        }
+    }
+    return (0);
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    waitPending
+    PURPOSE :    Wait at most usec micro-seconds, reading the results
+            of the pending requests as soon as they arrive.
+    INPUT :        tttctx    = thread context
+            usec    = how long to wait
+    OUTPUT :    None.
+    RETURN :    -1 if error, 0 else.
+    DESCRIPTION :
+            Used by the open loop mode (-e rate) in asynchronous
+            mode, so that the results are read while waiting for
+            the time to send the next request.
+ *****************************************************************************/
+int
+waitPending(
+    thread_context *tttctx,
+    long usec)
+{
+    struct pollfd pfd;   /* To wait for the results */
+    struct timespec ts;  /* To sleep */
+    int fd = -1;         /* Connection's socket */
+
+    if (readPending(tttctx) < 0)
+        return (-1);
+
+    if ((tttctx->pendingNb > 0) && (tttctx->ldapCtx != NULL) &&
+        (ldap_get_option(tttctx->ldapCtx, LDAP_OPT_DESC, &fd) == LDAP_OPT_SUCCESS) &&
+        (fd >= 0)) {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, (int)((usec + 999) / 1000)) > 0)
+            return (readPending(tttctx));
+        return (0);
+    }
+
+    ts.tv_sec = usec / 1000000;
+    ts.tv_nsec = (usec % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+    return (0);
+}
+
+
 /* ****************************************************************************
     FUNCTION :    doRename
     PURPOSE :    Perform an ldap_rename() operation.
@@ -3060,6 +3154,8 @@ doDeleteEntry(
             /*
        * Memorize the operation
        */
+            if (msgIdAdd(tttctx, msgid, delDn, delDn, NULL) < 0)
+                return (-1);
             if (incrementNbOpers(tttctx) < 0)
                 return (-1);
             tttctx->pendingNb++;
@@ -3332,6 +3428,8 @@ doExactSearch(
             }
         } else {
             tttctx->pendingNb--;
+            if ((ret > 0) && (mctx.mod2 & M2_LATENCY))
+                (void)msgIdDel(tttctx, ldap_msgid(res), 0);
 
             /*
        * Don't forget to free the returned message !
@@ -3409,6 +3507,13 @@ doExactSearch(
                 goto bail;
             }
             tttctx->pendingNb++;
+
+            /*
+       * The search results are not tracked, except for the latency
+       */
+            if (mctx.mod2 & M2_LATENCY)
+                if (msgIdAdd(tttctx, msgid, tttctx->bufFilter, tttctx->bufBaseDN, NULL) < 0)
+                    goto bail;
         }
     }
 
@@ -112,6 +112,8 @@ ldcltExit(
         printf("Undocumented error - update source code.\n"); /*JLS 25-08-00*/
         break;                                                /*JLS 25-08-00*/
     }                                                         /*JLS 25-08-00*/
+    if (mctx.mod2 & M2_LATENCY)
+        (void)latencyDumpJson();
     exit(status);
 }
 
@@ -656,6 +658,11 @@ printGlobalStatistics(void)
            (float)mctx.totNbOpers / (float)(mctx.sampling * mctx.totNbSamples),
            mctx.totNbOpers);
 
+    /*
+   * Latency statistics
+   */
+    latencyPrint();
+
     /*
    * No activity reports.
    */
@@ -954,6 +961,22 @@ basicInit(void)
         return (-1);                                       /*JLS 14-11-00*/
     }                                                      /*JLS 14-11-00*/
 
+    /*
+   * Latency histograms and open loop schedule
+   */
+    if (mctx.mod2 & M2_LATENCY)
+        if (latencyInit() < 0) {
+            fprintf(stderr, "Cannot initialize latency measurement.\n");
+            return (-1);
+        }
+
+    /*
+   * Access log to replay ?
+   */
+    if (mctx.mod2 & M2_REPLAY)
+        if (replayLoad() < 0)
+            return (-1);
+
     /*
    * Maybe random data to be read from file ?
    */
@@ -1446,6 +1469,14 @@ dumpModeValues(void)
         printf(" object=%s", mctx.object.fname);               /*JLS 19-03-01*/
     if (mctx.mod2 & M2_RNDBINDFILE)                            /*JLS 04-05-01*/
         printf(" randombinddnfromfile=%s", mctx.rndBindFname); /*JLS 04-05-01*/
+    if (mctx.mod2 & M2_OPEN_LOOP)
+        printf(" rate=%.2f", mctx.rate);
+    else if (mctx.mod2 & M2_LATENCY)
+        printf(" latency");
+    if (mctx.latencyJson != NULL)
+        printf(" latencyjson=%s", mctx.latencyJson);
+    if (mctx.mod2 & M2_REPLAY)
+        printf(" replay=%s replayspeed=%.2f", mctx.replayFile, mctx.replaySpeed);
     return;
 }
 
@@ -1849,6 +1880,16 @@ char *execParams[] = {
     "timestamp",
 #define EP_NOZEROPAD 55 /* do not zero pad numbers created by XXX patterns in values and RDNs */
     "nozeropad",
+#define EP_LATENCY 56 /* latency histograms */
+    "latency",
+#define EP_LATENCY_JSON 57 /* dump the latency histograms in a json file */
+    "latencyjson",
+#define EP_RATE 58 /* open loop mode, ops per second */
+    "rate",
+#define EP_REPLAY 59 /* replay an access log */
+    "replay",
+#define EP_REPLAY_SPEED 60 /* replay speedup factor */
+    "replayspeed",
     NULL};
 
 /* ****************************************************************************
@@ -2164,6 +2205,40 @@ decodeExecParams(
                 mctx.tsfmt = strdup(DEFAULT_TIMESTAMP_FMT);
             }
             break;
+        case EP_LATENCY:
+            mctx.mod2 |= M2_LATENCY;
+            break;
+        case EP_LATENCY_JSON:
+            if (subvalue == NULL) {
+                fprintf(stderr, "Error: missing latency json filename\n");
+                return (-1);
+            }
+            mctx.mod2 |= M2_LATENCY;
+            mctx.latencyJson = strdup(subvalue);
+            break;
+        case EP_RATE:
+            if ((subvalue == NULL) || (atof(subvalue) <= 0)) {
+                fprintf(stderr, "Error: missing or invalid rate value\n");
+                return (-1);
+            }
+            mctx.mod2 |= M2_OPEN_LOOP | M2_LATENCY;
+            mctx.rate = atof(subvalue);
+            break;
+        case EP_REPLAY:
+            if (subvalue == NULL) {
+                fprintf(stderr, "Error: missing access log filename\n");
+                return (-1);
+            }
+            mctx.mod2 |= M2_REPLAY;
+            mctx.replayFile = strdup(subvalue);
+            break;
+        case EP_REPLAY_SPEED:
+            if ((subvalue == NULL) || (atof(subvalue) < 0)) {
+                fprintf(stderr, "Error: missing or invalid replay speed\n");
+                return (-1);
+            }
+            mctx.replaySpeed = atof(subvalue);
+            break;
         default:
             fprintf(stderr, "Error: illegal option -e %s\n", subvalue);
             return (-1);
@@ -2282,6 +2357,7 @@ main(
     mctx.imagesDir = DEF_IMAGES_PATH; /*JLS 16-11-00*/
     mctx.inactivMax = DEF_INACTIV_MAX;
     mctx.incr = 1;
+    mctx.latencyJson = NULL;
     mctx.maxErrors = DEF_MAX_ERRORS;
     mctx.mode = NOTHING;
     mctx.mod2 = NOTHING;
@@ -2294,6 +2370,10 @@ main(
     mctx.port = DEF_PORT;
     mctx.randomLow = -1;
     mctx.randomHigh = -1;
+    mctx.rate = 0;
+    mctx.replayFile = NULL;
+    mctx.replayOps = NULL;
+    mctx.replaySpeed = 1;
     mctx.referral = DEF_REFERRAL; /*JLS 08-03-01*/
     mctx.sampling = DEF_SAMPLING;
     mctx.sasl_authid = NULL;
@@ -2590,6 +2670,27 @@ main(
         fprintf(stderr, "Error: -W should have a positive value.\n");
         ldcltExit(EXIT_PARAMS); /*JLS 13-11-00*/
     }
+    if ((mctx.mod2 & M2_OPEN_LOOP) && (mctx.waitSec > 0)) {
+        fprintf(stderr, "Error: exclusive -e rate and -W\n");
+        ldcltExit(EXIT_PARAMS);
+    }
+    if ((mctx.mod2 & M2_REPLAY) &&
+        ((mctx.mode & (ADD_ENTRIES | ATTR_REPLACE | DELETE_ENTRIES | EXACT_SEARCH | RENAME_ENTRIES | SCALAB01)) ||
+         (mctx.mod2 & (M2_ATTR_REPLACE_FILE | M2_BINDONLY | M2_GENLDIF | M2_ABANDON)))) {
+        fprintf(stderr, "Error: -e replay cannot be used with another operation\n");
+        ldcltExit(EXIT_PARAMS);
+    }
+    if ((mctx.mod2 & M2_REPLAY) && ((mctx.mode & ASYNC) || (mctx.mod2 & M2_OPEN_LOOP))) {
+        fprintf(stderr, "Error: -e replay is exclusive with -a and -e rate\n");
+        ldcltExit(EXIT_PARAMS);
+    }
+    if ((mctx.mod2 & M2_OPEN_LOOP) && (mctx.mode & ASYNC)) {
+        /*
+     * The results are read while waiting for the next request to send,
+     * so the operations must never wait for them.
+     */
+        mctx.asyncMin = mctx.asyncMax + 1;
+    }
     if ((mctx.mode & RANDOM_BASE) &&                                /*JLS 13-11-00*/
         ((mctx.baseDNLow < 0) || (mctx.baseDNHigh < 0)))            /*JLS 13-11-00*/
     {                                                               /*JLS 13-11-00*/
@@ -2841,6 +2942,8 @@ main(
             printf("Async max pending  = %d\n", mctx.asyncMax);
             printf("Async min pending  = %d\n", mctx.asyncMin);
         }
+        if (mctx.mod2 & M2_OPEN_LOOP)
+            printf("Open loop rate     = %.2f ops/sec\n", mctx.rate);
         for (size_t i = 0; i < mctx.ignErrNb; i++)
             printf("Ignore error       = %d (%s)\n",
                    mctx.ignErr[i], my_ldap_err2string(mctx.ignErr[i]));
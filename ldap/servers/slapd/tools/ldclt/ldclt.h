@@ -106,6 +106,9 @@
 #define M2_DEREF 0x00000200                                     /* -e deref */
 #define M2_ATTR_REPLACE_FILE 0x00000400                         /* -e attreplacefile */
 #define M2_NOZEROPAD 0x00000800                                 /* -e nozeropad */
+#define M2_LATENCY 0x00001000                                   /* -e latency */
+#define M2_OPEN_LOOP 0x00002000                                 /* -e rate */
+#define M2_REPLAY 0x00004000                                    /* -e replay */
 
 /*
  * Combinatory defines
@@ -119,7 +122,7 @@
 #define NEED_RANGE (INCREMENTAL | RANDOM)
 #define NEED_RND_INCR (ADD_ENTRIES | DELETE_ENTRIES | RENAME_ENTRIES)
 #define VALID_OPERS (ADD_ENTRIES | DELETE_ENTRIES | EXACT_SEARCH | RENAME_ENTRIES | ATTR_REPLACE | SCALAB01)
-#define M2_VALID_OPERS (M2_GENLDIF | M2_BINDONLY | M2_ABANDON | M2_ATTR_REPLACE_FILE | M2_DEREF)
+#define M2_VALID_OPERS (M2_GENLDIF | M2_BINDONLY | M2_ABANDON | M2_ATTR_REPLACE_FILE | M2_DEREF | M2_REPLAY)
 #define NEED_CLASSES (ADD_ENTRIES)
 #define THE_CLASSES (OC_PERSON | OC_EMAILPERSON | OC_INETORGPRSON)
 
@@ -204,6 +207,68 @@
 #endif
 #endif
 
+/*
+ * Latency histograms (-e latency, -e rate).
+ * The buckets are log-linear in microseconds, with LAT_SUB_BITS bits of
+ * precision (about 1.5%) up to 2^LAT_MAX_BITS microseconds (1h11).
+ */
+#define LAT_SUB_BITS 6
+#define LAT_SUB_COUNT (1 << LAT_SUB_BITS)
+#define LAT_MAX_BITS 32
+#define LAT_NB_BUCKETS ((LAT_MAX_BITS - LAT_SUB_BITS + 1) * LAT_SUB_COUNT)
+
+#define LAT_BIND 0
+#define LAT_SEARCH 1
+#define LAT_ADD 2
+#define LAT_MODIFY 3
+#define LAT_DELETE 4
+#define LAT_RENAME 5
+#define LAT_NB_OPS 6
+
+typedef struct lat_hist
+{
+    unsigned long long count;                   /* Nb of operations */
+    unsigned long long sum;                     /* Sum of latencies */
+    unsigned long long min;                     /* Min latency */
+    unsigned long long max;                     /* Max latency */
+    unsigned long long buckets[LAT_NB_BUCKETS]; /* The histogram */
+} lat_hist;
+
+/*
+ * Access log replay (-e replay).
+ * The operations of a connection of the log are all replayed by the
+ * same thread, in the order of the log, on their own LDAP connection.
+ * They are sent asynchronously: an operation only waits for the result
+ * of the previous one of the same connection.
+ */
+#define REPLAY_CLOSE LAT_NB_OPS   /* UNBIND or connection closed */
+#define REPLAY_DEF_MOD_ATTR "description"
+
+typedef struct replay_op
+{
+    long long when;         /* usec since the first op of the log */
+    unsigned long long cnx; /* Connection in the log */
+    int type;               /* LAT_xxx or REPLAY_CLOSE */
+    char *dn;               /* Bind DN, base or target entry */
+    char *filter;           /* Search filter */
+    int scope;              /* Search scope */
+    char **attrs;           /* Search attributes */
+    char *newRdn;           /* Rename new rdn */
+    char *newParent;        /* Rename new superior */
+    struct timespec sched;  /* Intended start time */
+    struct replay_op *next; /* Next op of this thread, then of its connection */
+} replay_op;
+
+typedef struct replay_cnx
+{
+    unsigned long long cnx; /* Connection in the log */
+    LDAP *ld;               /* Our connection */
+    replay_op *head;        /* Ops whose time has come, not sent yet */
+    replay_op *tail;
+    replay_op *sent;        /* Op waiting for its result */
+    int msgid;              /* Its message id */
+} replay_cnx;
+
 /*
  * This structure is the internal representation of an image
  */
@@ -391,6 +456,7 @@ typedef struct main_context
     char *keydbpin; /* key DB password */                /* BK 23-11-00*/
     int lastVal; /* To build filters */                  /*JLS 14-03-01*/
     ldclt_mutex_t lastVal_mutex; /* Protect lastVal */   /*JLS 14-03-01*/
+    char *latencyJson;                                   /* Latency results file */
     int ldapauth;                                        /* Used to indicate auth type */
     int maxErrors;                                       /* Max allowed errors */
     unsigned int mode;                                   /* Running mode */
@@ -407,6 +473,11 @@ typedef struct main_context
     char *passwdTail; /* Passwd's tail */                /*JLS 05-01-01*/
     int pid;                                             /* Process ID */
     int port;                                            /* Port to use */
+    double rate;                                         /* Open loop target rate */
+    char *replayFile;                                    /* Access log to replay */
+    replay_op **replayOps;                               /* Ops to replay per thread */
+    double replaySpeed;                                  /* Replay speedup factor */
+    struct timespec replayStart;                         /* Start of the replay */
     int randomLow;                                       /* Rnd's low value */
     int randomHigh;                                      /* Rnd's high val */
     int randomNbDigit;                                   /* Rnd's nb of digits */
@@ -455,6 +526,8 @@ typedef struct msgid_cell
 {
     LDAPMod **attribs;       /* Attributes */
     char dn[MAX_DN_LENGTH];  /* entry's dn */
+    int latType;             /* Latency histogram */
+    struct timespec latStart; /* Intended start */
     int msgid;               /* msg id */
     char str[MAX_DN_LENGTH]; /* free str */
     struct msgid_cell *next; /* next cell */
@@ -474,6 +547,12 @@ typedef struct thread_context
     int exitStatus; /* Exit status */                  /*JLS 25-08-00*/
     int fd;                                            /* fd to the server */
     int lastVal;                                       /* To build filters */
+    lat_hist *latency;                                 /* Latency histograms */
+    unsigned long long latNext;                        /* Next scheduled op */
+    struct timespec latOrigin;                         /* Schedule origin */
+    struct timespec latStart;                          /* Intended start */
+    int latType;                                       /* Current op type */
+    int latPending;                                    /* Result awaited */
     LDAP *ldapCtx;                                     /* LDAP context */
     unsigned int mode;                                 /* Running mode */
     int nbInactRow; /* Nb inactive in row */           /*JLS 04-08-00*/
@@ -514,6 +593,9 @@ typedef struct thread_context
     int startSaslAuthid;                      /* Insert random here */
     msgid_cell *firstMsgId;                   /* pending messages */
     msgid_cell *lastMsgId;                    /* last one */
+    replay_op *replayNext;                    /* Next op to replay */
+    replay_cnx *replayCnx;                    /* Replayed connections */
+    int replayCnxNb;                          /* Nb replayed connections */
 } thread_context;
 
 /*
@@ -581,6 +663,7 @@ extern void *threadMain(void *);
 extern LDAP *connectToLDAP(thread_context *tttctx, const char *bufBindDN, const char *bufPasswd, unsigned int mode, unsigned int mod2);
 extern int connectToServer(thread_context *tttctx); /*JLS 14-03-01*/
 extern char *dnFromMessage(thread_context *tttctx, LDAPMessage *res);
+extern int waitPending(thread_context *tttctx, long usec);
 extern int doAddEntry(thread_context *tttctx);
 extern int doAttrReplace(thread_context *tttctx); /*JLS 21-11-00*/
 extern int doAttrFileReplace(thread_context *tttctx);
@@ -607,6 +690,17 @@ extern void *opCheckMain(void *);
 extern void *opCheckLoop(void *);
 extern int opNext(check_context *ctctx, oper **op);
 extern int opRead(check_context *ctctx, int num, oper **op);
+/* From latency.c */
+extern int latencyInit(void);
+extern int latencyThreadInit(thread_context *tttctx);
+extern int latencyOperStart(thread_context *tttctx, int type);
+extern void latencyOperEnd(thread_context *tttctx);
+extern void latencyRecord(thread_context *tttctx, int type, struct timespec *start);
+extern void latencyPrint(void);
+extern int latencyDumpJson(void);
+/* From replay.c */
+extern int replayLoad(void);
+extern int doReplay(thread_context *tttctx);
 /* From parser.c */
 extern int parseAttribValue(char *fname, /*JLS 23-03-01*/
                             vers_object *obj,
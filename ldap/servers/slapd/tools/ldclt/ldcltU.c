@@ -69,10 +69,13 @@
  *         inetOrgPerson         : objectclass=inetOrgPerson (-e add only).
  *         keydbfile=file        : filename of the key database
  *         keydbpin=password     : password for accessing the key database
+ *         latency               : print the latency percentiles.
+ *         latencyjson=filename  : also dump them in a json file.
  *         noglobalstats         : don't print periodical global statistics
  *         noloop                  : does not loop the incremental numbers.
  *         object=filename       : build object from input file
  *         person                  : objectclass=person (-e add only).
+ *         rate=value            : open loop mode, value ops/sec in total.
  *         random                  : random filters, etc...
  *         randomattrlist=name:name:name : random select attrib in the list
  *         randombase             : random base DN.
@@ -84,6 +87,8 @@
  *         randombinddnhigh=value : high value for random generator.
  *         rdn=attrname:value     : alternate for -f.
  *         referral=on|off|rebind : change referral behaviour.
+ *         replay=filename        : replay an access log.
+ *         replayspeed=factor     : replay speedup factor, 0 = no wait.
  *         scalab01               : activates scalab01 scenario.
  *         scalab01_cnxduration   : maximum connection duration.
  *         scalab01_maxcnxnb      : modem pool size.
@@ -174,10 +179,13 @@ usage(void)
     (void)printf("        inetOrgPerson     : objectclass=inetOrgPerson (-e add only).\n");
     (void)printf("        keydbfile=file    : filename of the key database\n");
     (void)printf("        keydbpin=password : password for accessing the key database\n");
+    (void)printf("        latency           : print the latency percentiles.\n");
+    (void)printf("        latencyjson=filename : also dump them in a json file.\n");
     (void)printf("        noglobalstats     : don't print periodical global statistics\n");
     (void)printf("        noloop            : does not loop the incremental numbers.\n");
     (void)printf("        object=filename   : build object from input file\n");
     (void)printf("        person            : objectclass=person (-e add only).\n");
+    (void)printf("        rate=value        : open loop mode, value ops/sec in total.\n");
     (void)printf("        random            : random filters, etc...\n");
     (void)printf("        randomattrlist=name:name:name : random select attrib in the list\n");
     (void)printf("        randombase        : random base DN.\n");
@@ -189,6 +197,8 @@ usage(void)
     (void)printf("        randombinddnhigh=value : high value for random generator.\n");
     (void)printf("        rdn=attrname:value     : alternate for -f.\n");
     (void)printf("        referral=on|off|rebind : change referral behaviour.\n");
+    (void)printf("        replay=filename        : replay an access log.\n");
+    (void)printf("        replayspeed=factor     : replay speedup factor, 0 = no wait.\n");
     (void)printf("        scalab01               : activates scalab01 scenario.\n");
     (void)printf("        scalab01_cnxduration   : maximum connection duration.\n");
     (void)printf("        scalab01_maxcnxnb      : modem pool size.\n");
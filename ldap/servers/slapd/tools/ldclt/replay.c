@@ -0,0 +1,709 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2024 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/*
+    FILE :        replay.c
+    DESCRIPTION :
+            This file implements the replay of a server access log
+            (-e replay=file). The BIND, SRCH, ADD, MOD, DEL and
+            MODRDN operations of the log are sent again to the
+            server, with the same relative timing, optionally
+            accelerated (-e replayspeed=factor).
+            Each connection of the log is replayed on its own
+            connection to the server, and all its operations are
+            sent by the same thread, so their order is preserved.
+            The operations are asynchronous: a slow operation only
+            delays the next ones of its own connection, not the
+            other connections replayed by the thread.
+            The access log does not contain the passwords nor the
+            values of the add and modify operations, so:
+            - the binds are done with the password given by -w,
+            - the entries added only have the rdn's attribute,
+              with the extensibleObject objectclass,
+            - the modifies replace the description attribute.
+    LOCAL :        None.
+*/
+
+#include <stdio.h>                              /* printf(), etc... */
+#include <string.h>                             /* strerror(), etc... */
+#include <stdlib.h>                             /* malloc(), etc... */
+#include <errno.h>                              /* errno, etc... */
+#include <time.h>                               /* timegm(), etc... */
+#include <lber.h>                               /* ldap C-API BER declarations */
+#include <ldap.h>                               /* ldap C-API declarations */
+#include <pthread.h>                            /* pthreads(), etc... */
+#include <poll.h>                               /* poll(), etc... */
+#include "port.h" /* Portability definitions */
+#include "ldclt.h"                              /* This tool's include file */
+
+
+static const char *replayMonths[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+
+/*
+ * Returns the time of an access log line in micro-seconds since
+ * the epoch, or -1 if the line doesn't start with a time stamp.
+ *   [18/Oct/2024:10:11:12.123456789 +0200] conn=...
+ */
+static long long
+replayParseTime(
+    char *line)
+{
+    struct tm tm;
+    char month[4];
+    long long usec = 0;
+    int digits = 0;
+    int tz;
+    int n = 0;
+    char *pt;
+
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(line, "[%d/%3[A-Za-z]/%d:%d:%d:%d%n", &tm.tm_mday, month, &tm.tm_year,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &n) != 6)
+        return (-1);
+    for (tm.tm_mon = 0; tm.tm_mon < 12; tm.tm_mon++)
+        if (!strcmp(month, replayMonths[tm.tm_mon]))
+            break;
+    if (tm.tm_mon == 12)
+        return (-1);
+    tm.tm_year -= 1900;
+
+    pt = line + n;
+    if (*pt == '.')
+        for (pt++; (*pt >= '0') && (*pt <= '9'); pt++, digits++)
+            if (digits < 6)
+                usec = usec * 10 + (*pt - '0');
+    for (; digits < 6; digits++)
+        usec *= 10;
+
+    /*
+   * The time zone doesn't change in a log, but let's be safe
+   */
+    if (sscanf(pt, " %d", &tz) == 1)
+        tm.tm_sec -= ((tz / 100) * 3600) + ((tz % 100) * 60);
+
+    return ((long long)timegm(&tm) * 1000000LL + usec);
+}
+
+/*
+ * Returns a copy of the value of key="value" in the line, or NULL.
+ * The value ends with the first quote followed by a separator.
+ */
+static char *
+replayGetValue(
+    char *line,
+    const char *key)
+{
+    char pattern[32];
+    char *start;
+    char *end;
+    char *value;
+
+    snprintf(pattern, sizeof(pattern), " %s=\"", key);
+    if ((start = strstr(line, pattern)) == NULL)
+        return (NULL);
+    start += strlen(pattern);
+    for (end = start; *end != '\0'; end++)
+        if ((*end == '"') &&
+            ((end[1] == ' ') || (end[1] == ',') || (end[1] == '\n') || (end[1] == '\0')))
+            break;
+    if (*end == '\0')
+        return (NULL);
+    if ((value = (char *)malloc(end - start + 1)) == NULL)
+        return (NULL);
+    memcpy(value, start, end - start);
+    value[end - start] = '\0';
+    return (value);
+}
+
+/*
+ * Returns the attributes list of a SRCH line, NULL for ALL.
+ */
+static char **
+replayGetAttrs(
+    char *line)
+{
+    char *list;
+    char **attrs;
+    char *name;
+    char *last = NULL;
+    int nb = 0;
+
+    if ((list = replayGetValue(line, "attrs")) == NULL)
+        return (NULL);
+    if ((attrs = (char **)calloc(strlen(list) / 2 + 2, sizeof(char *))) == NULL) {
+        free(list);
+        return (NULL);
+    }
+    for (name = strtok_r(list, " ", &last); name != NULL; name = strtok_r(NULL, " ", &last))
+        attrs[nb++] = strdup(name);
+    free(list);
+    return (attrs);
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    replayLoad
+    PURPOSE :    Parses the access log to replay, and dispatches its
+            operations to the threads.
+    INPUT :        None.
+    OUTPUT :    None.
+    RETURN :    -1 if error, 0 else.
+    DESCRIPTION :
+            The connection number of the log decides which thread
+            will replay an operation. Internal operations, and the
+            operations that cannot be replayed (compare, extended,
+            SASL binds...) are ignored.
+ *****************************************************************************/
+int
+replayLoad(void)
+{
+    FILE *fp;                   /* The access log */
+    char *line = NULL;          /* Line read */
+    size_t lineSize = 0;        /* Line buffer size */
+    replay_op **tails;          /* Last op of each thread */
+    replay_op *op;              /* Op decoded */
+    long long first = -1;       /* Time of the first op */
+    long long when;             /* Time of this op */
+    unsigned long long cnx;     /* Connection number */
+    int opNum;                  /* Operation number */
+    int n;                      /* Chars read */
+    int nbOps = 0;              /* Ops loaded */
+    int nbIgnored = 0;          /* Ops ignored */
+    char *verb;                 /* The operation */
+    char *pt;
+
+    if ((fp = fopen(mctx.replayFile, "r")) == NULL) {
+        fprintf(stderr, "Error: cannot open %s, error=%d (%s)\n",
+                mctx.replayFile, errno, strerror(errno));
+        return (-1);
+    }
+    mctx.replayOps = (replay_op **)calloc(mctx.nbThreads, sizeof(replay_op *));
+    tails = (replay_op **)calloc(mctx.nbThreads, sizeof(replay_op *));
+    if ((mctx.replayOps == NULL) || (tails == NULL)) {
+        fprintf(stderr, "Error: cannot calloc(replayOps), error=%d (%s)\n",
+                errno, strerror(errno));
+        fclose(fp);
+        return (-1);
+    }
+
+    while (getline(&line, &lineSize, fp) != -1) {
+        if (((when = replayParseTime(line)) < 0) ||
+            ((pt = strstr(line, "] conn=")) == NULL) ||
+            (strstr(line, "(Internal)") != NULL))
+            continue;
+        if (sscanf(pt, "] conn=%llu op=%d %n", &cnx, &opNum, &n) != 2)
+            continue;
+        verb = pt + n;
+
+        if ((op = (replay_op *)calloc(1, sizeof(replay_op))) == NULL) {
+            fprintf(stderr, "Error: cannot calloc(replay_op), error=%d (%s)\n",
+                    errno, strerror(errno));
+            fclose(fp);
+            return (-1);
+        }
+        op->cnx = cnx;
+        if (!strncmp(verb, "BIND ", 5)) {
+            op->type = LAT_BIND;
+            op->dn = replayGetValue(verb, "dn");
+            if (strstr(verb, "method=sasl") != NULL) {
+                nbIgnored++;
+                op->type = -1;
+            }
+        } else if (!strncmp(verb, "SRCH ", 5)) {
+            op->type = LAT_SEARCH;
+            op->dn = replayGetValue(verb, "base");
+            op->filter = replayGetValue(verb, "filter");
+            op->attrs = replayGetAttrs(verb);
+            op->scope = LDAP_SCOPE_SUBTREE;
+            if ((pt = strstr(verb, " scope=")) != NULL)
+                op->scope = atoi(pt + 7);
+        } else if (!strncmp(verb, "ADD ", 4)) {
+            op->type = LAT_ADD;
+            op->dn = replayGetValue(verb, "dn");
+        } else if (!strncmp(verb, "MOD ", 4)) {
+            op->type = LAT_MODIFY;
+            op->dn = replayGetValue(verb, "dn");
+        } else if (!strncmp(verb, "DEL ", 4)) {
+            op->type = LAT_DELETE;
+            op->dn = replayGetValue(verb, "dn");
+        } else if (!strncmp(verb, "MODRDN ", 7)) {
+            op->type = LAT_RENAME;
+            op->dn = replayGetValue(verb, "dn");
+            op->newRdn = replayGetValue(verb, "newrdn");
+            op->newParent = replayGetValue(verb, "newsuperior");
+            if ((op->newParent != NULL) && (!strcmp(op->newParent, "(null)"))) {
+                free(op->newParent);
+                op->newParent = NULL;
+            }
+        } else if ((!strncmp(verb, "UNBIND", 6)) ||
+                   ((!strncmp(verb, "fd=", 3)) && (strstr(verb, " closed") != NULL))) {
+            op->type = REPLAY_CLOSE;
+        } else {
+            /*
+       * RESULT, connection, and the operations we don't replay
+       */
+            if ((!strncmp(verb, "CMP ", 4)) || (!strncmp(verb, "EXT ", 4)))
+                nbIgnored++;
+            free(op);
+            continue;
+        }
+
+        /*
+     * Malformed or truncated lines
+     */
+        if ((op->type < 0) ||
+            ((op->type != REPLAY_CLOSE) && (op->dn == NULL)) ||
+            ((op->type == LAT_SEARCH) && (op->filter == NULL)) ||
+            ((op->type == LAT_RENAME) && (op->newRdn == NULL))) {
+            if (op->type >= 0)
+                nbIgnored++;
+            free(op->dn);
+            free(op->filter);
+            free(op->newRdn);
+            free(op->newParent);
+            free(op);
+            continue;
+        }
+
+        if (first < 0)
+            first = when;
+        op->when = when - first;
+        if (tails[cnx % mctx.nbThreads] == NULL)
+            mctx.replayOps[cnx % mctx.nbThreads] = op;
+        else
+            tails[cnx % mctx.nbThreads]->next = op;
+        tails[cnx % mctx.nbThreads] = op;
+        if (op->type != REPLAY_CLOSE)
+            nbOps++;
+    }
+    free(line);
+    free(tails);
+    fclose(fp);
+
+    if (nbOps == 0) {
+        fprintf(stderr, "Error: no operation to replay in %s\n", mctx.replayFile);
+        return (-1);
+    }
+    printf("ldclt[%d]: Replay: %d operations loaded from %s, %d ignored\n",
+           mctx.pid, nbOps, mctx.replayFile, nbIgnored);
+    fflush(stdout);
+    return (0);
+}
+
+
+/*
+ * The log times are relative to the start of the threads, not to the
+ * end of the log parsing.
+ */
+static pthread_once_t replayStartOnce = PTHREAD_ONCE_INIT;
+
+static void
+replaySetStart(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &(mctx.replayStart));
+}
+
+
+/*
+ * Returns our connection for a connection of the log. If create is
+ * set, it is opened if needed, else NULL is returned.
+ */
+static replay_cnx *
+replayGetCnx(
+    thread_context *tttctx,
+    unsigned long long cnx,
+    int create)
+{
+    replay_cnx *slot = NULL;
+
+    for (int i = 0; i < tttctx->replayCnxNb; i++) {
+        if ((tttctx->replayCnx[i].ld != NULL) && (tttctx->replayCnx[i].cnx == cnx))
+            return (&(tttctx->replayCnx[i]));
+        if ((tttctx->replayCnx[i].ld == NULL) && (slot == NULL))
+            slot = &(tttctx->replayCnx[i]);
+    }
+    if (!create)
+        return (NULL);
+
+    if (slot == NULL) {
+        slot = (replay_cnx *)realloc(tttctx->replayCnx,
+                                     (tttctx->replayCnxNb + 1) * sizeof(replay_cnx));
+        if (slot == NULL) {
+            printf("ldclt[%d]: T%03d: cannot realloc(replayCnx), error=%d (%s)\n",
+                   mctx.pid, tttctx->thrdNum, errno, strerror(errno));
+            return (NULL);
+        }
+        tttctx->replayCnx = slot;
+        slot = &(tttctx->replayCnx[tttctx->replayCnxNb++]);
+    }
+
+    slot->cnx = cnx;
+    slot->head = NULL;
+    slot->tail = NULL;
+    slot->sent = NULL;
+    slot->msgid = -1;
+    slot->ld = connectToLDAP(NULL, NULL, NULL, mctx.mode & ~BIND_EACH_OPER, mctx.mod2);
+    if (slot->ld == NULL)
+        return (NULL);
+    return (slot);
+}
+
+/*
+ * Builds the entry to add: the rdn's attribute, with the
+ * extensibleObject objectclass.
+ */
+static int
+replayBuildEntry(
+    char *dn,
+    char *rdnBuf,
+    LDAPMod *mods,
+    LDAPMod **attrs,
+    char **ocValues,
+    char **rdnValues)
+{
+    char *pt;
+
+    strncpy(rdnBuf, dn, MAX_DN_LENGTH - 1);
+    rdnBuf[MAX_DN_LENGTH - 1] = '\0';
+    for (pt = rdnBuf; *pt != '\0'; pt++) {
+        if ((*pt == '\\') && (pt[1] != '\0'))
+            pt++;
+        else if ((*pt == ',') || (*pt == '+'))
+            break;
+    }
+    *pt = '\0';
+    if ((pt = strchr(rdnBuf, '=')) == NULL)
+        return (-1);
+    *pt = '\0';
+
+    /*
+   * Unescape the value: uid=a\,b is added as uid: a,b
+   */
+    rdnValues[0] = pt + 1;
+    for (char *src = pt + 1, *dst = pt + 1;; src++, dst++) {
+        if ((*src == '\\') && (src[1] != '\0'))
+            src++;
+        *dst = *src;
+        if (*src == '\0')
+            break;
+    }
+
+    ocValues[0] = "top";
+    ocValues[1] = "extensibleObject";
+    ocValues[2] = NULL;
+    rdnValues[1] = NULL;
+    mods[0].mod_op = LDAP_MOD_ADD;
+    mods[0].mod_type = "objectclass";
+    mods[0].mod_values = ocValues;
+    mods[1].mod_op = LDAP_MOD_ADD;
+    mods[1].mod_type = rdnBuf;
+    mods[1].mod_values = rdnValues;
+    attrs[0] = &(mods[0]);
+    attrs[1] = &(mods[1]);
+    attrs[2] = NULL;
+    return (0);
+}
+
+
+/*
+ * Accounts the result of a replayed operation.
+ * Returns -1 if the thread must stop, 0 else.
+ */
+static int
+replayCheck(
+    thread_context *tttctx,
+    replay_op *op,
+    int ret)
+{
+    if ((ret != LDAP_SUCCESS) && (ret != LDAP_SIZELIMIT_EXCEEDED)) {
+        if (!((mctx.mode & QUIET) && ignoreError(ret))) {
+            printf("ldclt[%d]: T%03d: Cannot replay conn=%llu type=%d dn=\"%s\", error=%d (%s)\n",
+                   mctx.pid, tttctx->thrdNum, op->cnx, op->type, op->dn,
+                   ret, my_ldap_err2string(ret));
+            fflush(stdout);
+        }
+        if (addErrorStat(ret) < 0)
+            return (-1);
+        if (!(mctx.mode & COUNT_EACH))
+            return (0);
+    }
+
+    if (incrementNbOpers(tttctx) < 0)
+        return (-1);
+    return (0);
+}
+
+/*
+ * Sends the operation on its connection.
+ * Returns -1 if the thread must stop, 0 else.
+ */
+static int
+replaySend(
+    thread_context *tttctx,
+    replay_cnx *cnx,
+    replay_op *op)
+{
+    struct berval cred;    /* Bind password */
+    LDAPMod mods[2];       /* Add & modify */
+    LDAPMod *attrs[3];     /* Add & modify */
+    char *ocValues[3];     /* Add */
+    char *values[2];       /* Add & modify */
+    char buf[MAX_DN_LENGTH];
+    int msgid = -1;
+    int ret = LDAP_SUCCESS;
+
+    if (mctx.mode & VERY_VERBOSE)
+        printf("ldclt[%d]: T%03d: replay conn=%llu type=%d dn=\"%s\"\n",
+               mctx.pid, tttctx->thrdNum, op->cnx, op->type, op->dn);
+
+    switch (op->type) {
+    case LAT_BIND:
+        if ((op->dn[0] != '\0') && (mctx.passwd != NULL)) {
+            cred.bv_val = mctx.passwd;
+            cred.bv_len = strlen(mctx.passwd);
+        } else {
+            cred.bv_val = NULL;
+            cred.bv_len = 0;
+        }
+        ret = ldap_sasl_bind(cnx->ld, op->dn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, &msgid);
+        break;
+    case LAT_SEARCH:
+        ret = ldap_search_ext(cnx->ld, op->dn, op->scope, op->filter, op->attrs,
+                              mctx.attrsonly, NULL, NULL, NULL, LDAP_NO_LIMIT, &msgid);
+        break;
+    case LAT_ADD:
+        if (replayBuildEntry(op->dn, buf, mods, attrs, ocValues, values) < 0) {
+            ret = LDAP_INVALID_DN_SYNTAX;
+            break;
+        }
+        ret = ldap_add_ext(cnx->ld, op->dn, attrs, NULL, NULL, &msgid);
+        break;
+    case LAT_MODIFY:
+        snprintf(buf, sizeof(buf), "ldclt replay %s %d", tttctx->thrdId, tttctx->totOpers);
+        values[0] = buf;
+        values[1] = NULL;
+        mods[0].mod_op = LDAP_MOD_REPLACE;
+        mods[0].mod_type = REPLAY_DEF_MOD_ATTR;
+        mods[0].mod_values = values;
+        attrs[0] = &(mods[0]);
+        attrs[1] = NULL;
+        ret = ldap_modify_ext(cnx->ld, op->dn, attrs, NULL, NULL, &msgid);
+        break;
+    case LAT_DELETE:
+        ret = ldap_delete_ext(cnx->ld, op->dn, NULL, NULL, &msgid);
+        break;
+    case LAT_RENAME:
+        ret = ldap_rename(cnx->ld, op->dn, op->newRdn, op->newParent, 1, NULL, NULL, &msgid);
+        break;
+    }
+
+    if (ret != LDAP_SUCCESS)
+        return (replayCheck(tttctx, op, ret));
+    cnx->sent = op;
+    cnx->msgid = msgid;
+    return (0);
+}
+
+/*
+ * Gets the result of the operation sent on the connection, if it has
+ * arrived. Returns -1 if the thread must stop, 0 else.
+ */
+static int
+replayResult(
+    thread_context *tttctx,
+    replay_cnx *cnx)
+{
+    struct timeval zero = {0, 0};
+    LDAPMessage *res = NULL;
+    replay_op *op = cnx->sent;
+    int ret;
+
+    switch (ldap_result(cnx->ld, cnx->msgid, LDAP_MSG_ALL, &zero, &res)) {
+    case 0:
+        return (0);
+    case -1:
+        if (ldap_get_option(cnx->ld, LDAP_OPT_RESULT_CODE, &ret) != LDAP_OPT_SUCCESS)
+            ret = LDAP_OTHER;
+        break;
+    default:
+        if (ldap_parse_result(cnx->ld, res, &ret, NULL, NULL, NULL, NULL, 1) != LDAP_SUCCESS)
+            ret = LDAP_DECODING_ERROR;
+        break;
+    }
+    cnx->sent = NULL;
+    cnx->msgid = -1;
+
+    if (mctx.mod2 & M2_LATENCY)
+        latencyRecord(tttctx, op->type, &(op->sched));
+    return (replayCheck(tttctx, op, ret));
+}
+
+/*
+ * Returns the delay before the time of the operation, in nsec.
+ */
+static long long
+replayDelay(
+    replay_op *op,
+    struct timespec *now)
+{
+    long long ns;
+
+    if (mctx.replaySpeed <= 0) {
+        op->sched = *now;
+        return (0);
+    }
+    ns = (long long)(op->when * 1000.0 / mctx.replaySpeed);
+    op->sched.tv_sec = mctx.replayStart.tv_sec + (mctx.replayStart.tv_nsec + ns) / 1000000000LL;
+    op->sched.tv_nsec = (mctx.replayStart.tv_nsec + ns) % 1000000000LL;
+    return ((long long)(op->sched.tv_sec - now->tv_sec) * 1000000000LL +
+            (op->sched.tv_nsec - now->tv_nsec));
+}
+
+
+/* ****************************************************************************
+    FUNCTION :    doReplay
+    PURPOSE :    Collects the results of the operations of this thread,
+            and sends the ones whose time has come.
+    INPUT :        tttctx    = thread context
+    OUTPUT :    None.
+    RETURN :    -1 if error or end of replay, 0 else.
+    DESCRIPTION :
+            An operation is queued on its connection when its time
+            has come, and sent once the previous operation of the
+            connection has completed.
+            We don't wait more than one second at a time, to
+            be able to notice a shutdown request.
+            With -e latency, the latency is measured from the time
+            the operation should have been sent.
+ *****************************************************************************/
+int
+doReplay(
+    thread_context *tttctx)
+{
+    replay_op *op;           /* Op to replay */
+    replay_cnx *cnx;         /* Our connection */
+    struct timespec now;     /* Current time */
+    struct pollfd *fds;      /* Connections waiting for a result */
+    long long ns = -1;       /* Delay before the next op */
+    int nfds = 0;
+    int timeout;
+    int i;
+
+    pthread_once(&replayStartOnce, replaySetStart);
+
+    /*
+   * The results that have arrived
+   */
+    for (i = 0; i < tttctx->replayCnxNb; i++)
+        if ((tttctx->replayCnx[i].sent != NULL) &&
+            (replayResult(tttctx, &(tttctx->replayCnx[i])) < 0))
+            return (-1);
+
+    /*
+   * Queue the operations whose time has come on their connection
+   */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while (((op = tttctx->replayNext) != NULL) && ((ns = replayDelay(op, &now)) <= 0)) {
+        tttctx->replayNext = op->next;
+        op->next = NULL;
+        if ((cnx = replayGetCnx(tttctx, op->cnx, op->type != REPLAY_CLOSE)) == NULL) {
+            if (op->type == REPLAY_CLOSE)
+                continue;
+            return (-1);
+        }
+        if (cnx->tail == NULL)
+            cnx->head = op;
+        else
+            cnx->tail->next = op;
+        cnx->tail = op;
+    }
+
+    /*
+   * Send them, unless their connection is still busy
+   */
+    for (i = 0; i < tttctx->replayCnxNb; i++) {
+        cnx = &(tttctx->replayCnx[i]);
+        while ((cnx->ld != NULL) && (cnx->sent == NULL) && ((op = cnx->head) != NULL)) {
+            if ((cnx->head = op->next) == NULL)
+                cnx->tail = NULL;
+            if (op->type == REPLAY_CLOSE) {
+                /*
+         * End of a connection of the log
+         */
+                ldap_unbind_ext(cnx->ld, NULL, NULL);
+                cnx->ld = NULL;
+                if (cnx->head != NULL) {
+                    /*
+           * The log reused the connection number
+           */
+                    cnx->ld = connectToLDAP(NULL, NULL, NULL, mctx.mode & ~BIND_EACH_OPER, mctx.mod2);
+                    if (cnx->ld == NULL)
+                        return (-1);
+                }
+            } else if (replaySend(tttctx, cnx, op) < 0)
+                return (-1);
+        }
+        if (cnx->sent != NULL)
+            nfds++;
+    }
+
+    if ((tttctx->replayNext == NULL) && (nfds == 0)) {
+        /*
+     * Well, there is no clean way to exit. Let's use the error
+     * condition, like -e noloop.
+     */
+        printf("ldclt[%d]: T%03d: End of replay.\n", mctx.pid, tttctx->thrdNum);
+        fflush(stdout);
+        return (-1);
+    }
+
+    /*
+   * Wait for a result or for the time of the next operation
+   */
+    timeout = 1000;
+    if ((tttctx->replayNext != NULL) && (ns < 1000000000LL))
+        timeout = (int)((ns + 999999) / 1000000);
+    if (nfds == 0) {
+        if (timeout >= 1000)
+            ldclt_sleep(1);
+        else if (ns > 0) {
+            now.tv_sec = 0;
+            now.tv_nsec = ns;
+            nanosleep(&now, NULL);
+        }
+        return (0);
+    }
+    if ((fds = (struct pollfd *)calloc(nfds, sizeof(struct pollfd))) == NULL) {
+        printf("ldclt[%d]: T%03d: cannot calloc(pollfd), error=%d (%s)\n",
+               mctx.pid, tttctx->thrdNum, errno, strerror(errno));
+        return (-1);
+    }
+    for (i = 0, nfds = 0; i < tttctx->replayCnxNb; i++) {
+        cnx = &(tttctx->replayCnx[i]);
+        if ((cnx->sent != NULL) &&
+            (ldap_get_option(cnx->ld, LDAP_OPT_DESC, &(fds[nfds].fd)) == LDAP_OPT_SUCCESS)) {
+            fds[nfds].events = POLLIN;
+            nfds++;
+        }
+    }
+    poll(fds, nfds, timeout);
+    free(fds);
+    return (0);
+}
+
+
+/* End of file */
@@ -535,11 +535,14 @@ msgIdAdd(
    */
     tttctx->lastMsgId->next = NULL;
     tttctx->lastMsgId->msgid = msgid;
-    memcpy(tttctx->lastMsgId->str, str, sizeof(tttctx->lastMsgId->str));
+    strncpy(tttctx->lastMsgId->str, str, sizeof(tttctx->lastMsgId->str));
     tttctx->lastMsgId->str[sizeof(tttctx->lastMsgId->str) - 1] = '\0';
-    memcpy(tttctx->lastMsgId->dn, dn, sizeof(tttctx->lastMsgId->dn));
+    strncpy(tttctx->lastMsgId->dn, dn, sizeof(tttctx->lastMsgId->dn));
     tttctx->lastMsgId->dn[sizeof(tttctx->lastMsgId->dn) - 1] = '\0';
     tttctx->lastMsgId->attribs = attribs;
+    tttctx->lastMsgId->latType = tttctx->latType;
+    tttctx->lastMsgId->latStart = tttctx->latStart;
+    tttctx->latPending = 1;
 
     return (0);
 }
@@ -660,6 +663,8 @@ msgIdDel(
             tttctx->firstMsgId = tttctx->firstMsgId->next;
             if (tttctx->firstMsgId == NULL)
                 tttctx->lastMsgId = NULL;
+            if (mctx.mod2 & M2_LATENCY)
+                latencyRecord(tttctx, ptToFree->latType, &(ptToFree->latStart));
             free(ptToFree);
             return (0);
         }
@@ -679,6 +684,8 @@ msgIdDel(
                 if (freeAttr)
                     if (freeAttrib(ptToFree->attribs) < 0)
                         return (-1);
+                if (mctx.mod2 & M2_LATENCY)
+                    latencyRecord(tttctx, ptToFree->latType, &(ptToFree->latStart));
 
                 /*
      * Free the pointer itself
@@ -772,6 +779,36 @@ setThreadStatus(
 }
 
 
+/* ****************************************************************************
+    FUNCTION :    doOper
+    PURPOSE :    Runs one operation, and measures its latency if
+            requested (-e latency or -e rate).
+    INPUT :        tttctx    = thread context
+            type    = operation type (LAT_xxx)
+            fct    = the function that performs the operation
+    OUTPUT :    None.
+    RETURN :    -1 if error, 0 else.
+    DESCRIPTION :
+ *****************************************************************************/
+static int
+doOper(
+    thread_context *tttctx,
+    int type,
+    int (*fct)(thread_context *))
+{
+    int ret; /* Return code */
+
+    if (!(mctx.mod2 & M2_LATENCY))
+        return (fct(tttctx));
+
+    if (latencyOperStart(tttctx, type) < 0)
+        return (-1);
+    ret = fct(tttctx);
+    latencyOperEnd(tttctx);
+    return (ret);
+}
+
+
 /* ****************************************************************************
     FUNCTION :    threadMain
     PURPOSE :    This function is the main function of the client threads
@@ -977,6 +1014,17 @@ threadMain(
     }
 
 
+    /*
+   * Latency histograms and open loop schedule
+   */
+    tttctx->latency = NULL;
+    tttctx->replayNext = (mctx.mod2 & M2_REPLAY) ? mctx.replayOps[tttctx->thrdNum] : NULL;
+    tttctx->replayCnx = NULL;
+    tttctx->replayCnxNb = 0;
+    if (mctx.mod2 & M2_LATENCY)
+        if (latencyThreadInit(tttctx) < 0)
+            ldcltExit(EXIT_INIT);
+
     /*
    * We are ready to go !
    */
@@ -1005,41 +1053,41 @@ threadMain(
      * Do a LDAP request
      */
         if (tttctx->mode & ADD_ENTRIES)
-            if (doAddEntry(tttctx) < 0) {
+            if (doOper(tttctx, LAT_ADD, doAddEntry) < 0) {
                 go = 0;
                 continue;
             }
         if (tttctx->mode & ATTR_REPLACE)   /*JLS 21-11-00*/
-            if (doAttrReplace(tttctx) < 0) /*JLS 21-11-00*/
+            if (doOper(tttctx, LAT_MODIFY, doAttrReplace) < 0) /*JLS 21-11-00*/
             {                              /*JLS 21-11-00*/
                 go = 0;                    /*JLS 21-11-00*/
                 continue;                  /*JLS 21-11-00*/
             }                              /*JLS 21-11-00*/
 
         if (mctx.mod2 & M2_ATTR_REPLACE_FILE)
-            if (doAttrFileReplace(tttctx) < 0) {
+            if (doOper(tttctx, LAT_MODIFY, doAttrFileReplace) < 0) {
                 go = 0;
                 continue;
             }
 
         if (tttctx->mode & DELETE_ENTRIES)
-            if (doDeleteEntry(tttctx) < 0) {
+            if (doOper(tttctx, LAT_DELETE, doDeleteEntry) < 0) {
                 go = 0;
                 continue;
             }
         if (mctx.mod2 & M2_BINDONLY)    /*JLS 04-05-01*/
-            if (doBindOnly(tttctx) < 0) /*JLS 04-05-01*/
+            if (doOper(tttctx, LAT_BIND, doBindOnly) < 0) /*JLS 04-05-01*/
             {                           /*JLS 04-05-01*/
                 go = 0;                 /*JLS 04-05-01*/
                 continue;               /*JLS 04-05-01*/
             }                           /*JLS 04-05-01*/
         if (tttctx->mode & EXACT_SEARCH)
-            if (doExactSearch(tttctx) < 0) {
+            if (doOper(tttctx, LAT_SEARCH, doExactSearch) < 0) {
                 go = 0;
                 continue;
             }
         if (tttctx->mode & RENAME_ENTRIES)
-            if (doRename(tttctx) < 0) {
+            if (doOper(tttctx, LAT_RENAME, doRename) < 0) {
                 go = 0;
                 continue;
             }
@@ -1072,6 +1120,15 @@ threadMain(
             }
         }
 
+        /*
+     * Maybe replay mode ?
+     */
+        if (mctx.mod2 & M2_REPLAY)
+            if (doReplay(tttctx) < 0) {
+                go = 0;
+                continue;
+            }
+
         /*
      * Check the thread's status
      */
@@ -2368,6 +2368,16 @@ vattr_map_namespace_sp_getlist(Slapi_DN *dn, const char *type_to_find)
     return return_list;
 }
 
+/*
+ * Is there a service provider for the type, globally or in the namespace
+ * of namespace_dn?
+ */
+int
+vattr_map_has_type(const Slapi_DN *namespace_dn, const char *type)
+{
+    return vattr_map_namespace_sp_getlist((Slapi_DN *)namespace_dn, type) != NULL;
+}
+
 
 /* Iterator function for the list */
 vattr_sp_handle *
@@ -3505,8 +3505,12 @@ class DirSrv(SimpleLDAPObject, object):
             self.log.debug("Delete entry children %s", ent.dn)
             self.delete_ext_s(ent.dn, serverctrls=serverctrls, clientctrls=clientctrls, escapehatch='i am sure')
 
-    def backup_online(self, archive=None, db_type=None):
-        """Creates a backup of the database"""
+    def backup_online(self, archive=None, db_type=None, base_dir=None):
+        """Creates a backup of the database
+
+        If base_dir is set, the backup is incremental and only stores what
+        changed since the backup found in base_dir (mdb only).
+        """
 
         if archive is None:
             # Use the instance name and date/time as the default backup name
@@ -3524,6 +3528,10 @@ class DirSrv(SimpleLDAPObject, object):
         task_properties = {'nsArchiveDir': archive}
         if db_type is not None:
             task_properties['nsDatabaseType'] = db_type
+        if base_dir is not None:
+            if base_dir[0] != "/":
+                base_dir = os.path.join(self.ds_paths.backup_dir, base_dir)
+            task_properties['nsArchiveBaseDir'] = base_dir
         task.create(properties=task_properties)
 
         return task
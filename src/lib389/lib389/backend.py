@@ -725,7 +725,7 @@ class Backend(DSLdapObject):
         """ Add an index.
 
         :param attr_name - name of the attribute to index
-        :param types - a List of index types(eq, pres, sub, approx)
+        :param types - a List of index types(eq, pres, sub, subpos, approx)
         :param matching_rules - a List of matching rules for the index
         :param reindex - If set to True then index the attribute after creating it.
         """
@@ -771,7 +771,57 @@ class Backend(DSLdapObject):
             args = {TASK_WAIT: True}
         bename = self.get_attr_val_utf8('cn')
         reindex_task = Tasks(self._instance)
-        reindex_task.reindex(benamebase=bename, attrname=attrs, args=args)
+        return reindex_task.reindex(benamebase=bename, attrname=attrs, args=args)
+
+    def migrate_substr_index(self, attrs=None, drop_sub=False):
+        """Add the positional n-gram index type (subpos) to the substring
+        indexes and rebuild them.  Waits for the reindex task to complete.
+        The server keeps using the "sub" keys until the rebuild is done, so
+        "sub" is only dropped once the new keys exist.
+
+        subpos can not serve a substring component shorter than its 3 bytes
+        grams: an "any" component of 1 or 2 characters ("*ab*"), or an
+        initial or final component of 1 character ("a*", "*a").  A filter
+        made only of such components is unindexed without the "sub" type,
+        and is refused when nsslapd-require-index is on.
+
+        :param attrs - an optional list of attributes, by default every index
+                       with the "sub" type is migrated
+        :param drop_sub - If set to True the "sub" type is removed, see above
+        :returns - the list of migrated attributes
+        """
+        wanted = None
+        if attrs is not None:
+            wanted = [attr.lower() for attr in attrs]
+        indexes = []
+        for index in self.get_indexes().list():
+            name = index.get_attr_val_utf8_l('cn')
+            if wanted is not None and name not in wanted:
+                continue
+            types = [t.lower() for t in index.get_attr_vals_utf8('nsIndexType')]
+            if 'sub' in types:
+                indexes.append((name, index, types))
+            elif wanted is not None:
+                raise ValueError(f"Index {name} has no substring index type")
+        if wanted is not None:
+            missing = set(wanted) - set([name for (name, index, types) in indexes])
+            if missing:
+                raise ValueError("Can not migrate missing index: {}".format(", ".join(sorted(missing))))
+
+        migrated = []
+        for (name, index, types) in indexes:
+            if 'subpos' not in types:
+                index.add('nsIndexType', 'subpos')
+            migrated.append(name)
+        if migrated and self.reindex(attrs=migrated, wait=True) != 0:
+            raise ValueError("Failed to rebuild the substring indexes: {}".format(", ".join(migrated)))
+        if drop_sub and migrated:
+            for (name, index, types) in indexes:
+                index.remove('nsIndexType', 'sub')
+            self._log.warning("Removed the \"sub\" index type of: {}. Substring filters with "
+                              "components shorter than 3 characters (\"*ab*\", \"a*\", \"*a\") "
+                              "are no longer indexed".format(", ".join(migrated)))
+        return migrated
 
     def get_encrypted_attrs(self, just_names=False):
         """Get a list of the excrypted attributes
@@ -1064,6 +1114,12 @@ class DatabaseConfig(DSLdapObject):
             'nsslapd-pagedidlistscanlimit',
             'nsslapd-rangelookthroughlimit',
             'nsslapd-backend-opt-level',
+            'nsslapd-search-prefetch-depth',
+            'nsslapd-cache-preload',
+            'nsslapd-cache-preload-rate',
+            'nsslapd-cache-snapshot-interval',
+            'nsslapd-filter-cost-optimizer',
+            'nsslapd-export-threads',
             'nsslapd-backend-implement',
             'nsslapd-db-durable-transaction',
             'nsslapd-search-bypass-filter-test',
@@ -1099,6 +1155,8 @@ class DatabaseConfig(DSLdapObject):
                     'nsslapd-mdb-max-size',
                     'nsslapd-mdb-max-readers',
                     'nsslapd-mdb-max-dbs',
+                    'nsslapd-mdb-online-reindex',
+                    'nsslapd-mdb-online-reindex-rate',
                 ]
         }
         self._create_objectclasses = ['top', 'extensibleObject']
@@ -1164,6 +1222,7 @@ class BackendSuffixView(CompositeDSLdapObject):
             'nsslapd-cachememsize',
             'nsslapd-cachesize',
             'nsslapd-dncachememsize',
+            'nsslapd-dntreecachememsize',
             'nsslapd-readonly',
             'nsslapd-require-index',
             'nsslapd-suffix'
@@ -63,12 +63,20 @@ arg_to_attr = {
         'pagedidlistscanlimit': 'nsslapd-pagedidlistscanlimit',
         'rangelookthroughlimit': 'nsslapd-rangelookthroughlimit',
         'backend_opt_level': 'nsslapd-backend-opt-level',
+        'search_prefetch_depth': 'nsslapd-search-prefetch-depth',
+        'cache_preload': 'nsslapd-cache-preload',
+        'cache_preload_rate': 'nsslapd-cache-preload-rate',
+        'cache_snapshot_interval': 'nsslapd-cache-snapshot-interval',
+        'filter_cost_optimizer': 'nsslapd-filter-cost-optimizer',
+        'export_threads': 'nsslapd-export-threads',
         'deadlock_policy': 'nsslapd-db-deadlock-policy',
         'db_home_directory': 'nsslapd-db-home-directory',
         'db_lib': 'nsslapd-backend-implement',
         'mdb_max_size': 'nsslapd-mdb-max-size',
         'mdb_max_readers': 'nsslapd-mdb-max-readers',
         'mdb_max_dbs': 'nsslapd-mdb-max-dbs',
+        'mdb_online_reindex': 'nsslapd-mdb-online-reindex',
+        'mdb_online_reindex_rate': 'nsslapd-mdb-online-reindex-rate',
         # VLV attributes
         'search_base': 'vlvbase',
         'search_scope': 'vlvscope',
@@ -506,6 +514,8 @@ def backend_set(inst, basedn, log, args):
         bev.set('nsslapd-cachememsize', args.cache_memsize)
     if args.dncache_memsize:
         bev.set('nsslapd-dncachememsize', args.dncache_memsize)
+    if args.dntreecache_memsize:
+        bev.set('nsslapd-dntreecachememsize', args.dntreecache_memsize)
     if args.require_index:
         bev.set('nsslapd-require-index', 'on')
     if args.ignore_index:
@@ -646,6 +656,15 @@ def backend_reindex(inst, basedn, log, args):
     log.info("Successfully reindexed database")
 
 
+def backend_migrate_substr_index(inst, basedn, log, args):
+    be = _get_backend(inst, args.be_name)
+    migrated = be.migrate_substr_index(attrs=args.attr, drop_sub=args.drop_sub)
+    if migrated:
+        log.info("Successfully migrated the substring index of: {}".format(", ".join(migrated)))
+    else:
+        log.info("No substring index to migrate")
+
+
 def backend_attr_encrypt(inst, basedn, log, args):
     # add/remove/list
     be = _get_backend(inst, args.be_name)
@@ -887,6 +906,7 @@ def create_parser(subparsers):
     set_backend_parser.add_argument('--cache-size', help='Sets the maximum number of entries to keep in the entry cache')
     set_backend_parser.add_argument('--cache-memsize', help='Sets the maximum size in bytes that the entry cache can grow to')
     set_backend_parser.add_argument('--dncache-memsize', help='Sets the maximum size in bytes that the DN cache can grow to')
+    set_backend_parser.add_argument('--dntreecache-memsize', help='Sets the maximum size in bytes that the DN tree cache can grow to (0 disables it)')
     set_backend_parser.add_argument('--state', help='Changes the backend state to: "backend", "disabled", "referral", or "referral on update"')
     set_backend_parser.add_argument('be_name', help='The backend name or suffix')
 
@@ -899,7 +919,7 @@ def create_parser(subparsers):
     # Create index
     add_index_parser = index_subcommands.add_parser('add', help='Add an index', formatter_class=CustomHelpFormatter)
     add_index_parser.set_defaults(func=backend_add_index)
-    add_index_parser.add_argument('--index-type', required=True, action='append', help='Sets the indexing type (eq, sub, pres, or approx)')
+    add_index_parser.add_argument('--index-type', required=True, action='append', help='Sets the indexing type (eq, sub, subpos, pres, or approx)')
     add_index_parser.add_argument('--matching-rule', action='append', help='Sets the matching rule for the index')
     add_index_parser.add_argument('--reindex', action='store_true', help='Re-indexes the database after adding a new index')
     add_index_parser.add_argument('--attr', required=True, help='Sets the attribute name to index')
@@ -909,8 +929,8 @@ def create_parser(subparsers):
     edit_index_parser = index_subcommands.add_parser('set', help='Update an index', formatter_class=CustomHelpFormatter)
     edit_index_parser.set_defaults(func=backend_set_index)
     edit_index_parser.add_argument('--attr', required=True, help='Sets the indexed attribute to update')
-    edit_index_parser.add_argument('--add-type', action='append', help='Adds an index type to the index (eq, sub, pres, or approx)')
-    edit_index_parser.add_argument('--del-type', action='append', help='Removes an index type from the index: (eq, sub, pres, or approx)')
+    edit_index_parser.add_argument('--add-type', action='append', help='Adds an index type to the index (eq, sub, subpos, pres, or approx)')
+    edit_index_parser.add_argument('--del-type', action='append', help='Removes an index type from the index: (eq, sub, subpos, pres, or approx)')
     edit_index_parser.add_argument('--add-mr', action='append', help='Adds a matching-rule to the index')
     edit_index_parser.add_argument('--del-mr', action='append', help='Removes a matching-rule from the index')
     edit_index_parser.add_argument('--reindex', action='store_true', help='Re-indexes the database after editing the index')
@@ -941,6 +961,16 @@ def create_parser(subparsers):
     reindex_parser.add_argument('--wait', action='store_true', help='Waits for the index task to complete and reports the status')
     reindex_parser.add_argument('be_name', help='The backend name or suffix')
 
+    # migrate substring indexes
+    migrate_substr_parser = index_subcommands.add_parser('migrate-substr', help='Adds the positional n-gram index type (subpos) to substring indexes and rebuilds them', formatter_class=CustomHelpFormatter)
+    migrate_substr_parser.set_defaults(func=backend_migrate_substr_index)
+    migrate_substr_parser.add_argument('--attr', action='append', help='Sets the name of the attribute to migrate. Omit this argument to migrate every substring index')
+    migrate_substr_parser.add_argument('--drop-sub', action='store_true',
+                                       help='Removes the "sub" index type. Substring filters with only components '
+                                            'shorter than 3 characters ("*ab*", "a*", "*a") are then unindexed, '
+                                            'and refused when nsslapd-require-index is on')
+    migrate_substr_parser.add_argument('be_name', help='The backend name or suffix')
+
     #############################################
     # VLV parser
     #############################################
@@ -1082,12 +1112,28 @@ def create_parser(subparsers):
                                                                       'range search request.')
     set_db_config_parser.add_argument('--backend-opt-level', help='Sets the backend optimization level for write performance (0, 1, 2, or 4). '
                                                                   'WARNING: This parameter can trigger experimental code.')
+    set_db_config_parser.add_argument('--search-prefetch-depth', help='Sets the number of candidate entries a search reads ahead into the entry '
+                                                                      'cache using background threads (0 disables prefetching)')
+    set_db_config_parser.add_argument('--cache-preload', help='Saves the entry and DN cache contents at shutdown and reloads them in the '
+                                                              'background at startup (on/off)')
+    set_db_config_parser.add_argument('--cache-preload-rate', help='Sets the maximum number of entries per second loaded into the caches '
+                                                                   'at startup (0 means no limit)')
+    set_db_config_parser.add_argument('--cache-snapshot-interval', help='Sets how often, in seconds, the cache contents are saved while the '
+                                                                        'server runs (0 saves them only at shutdown). Requires a restart.')
+    set_db_config_parser.add_argument('--filter-cost-optimizer', help='Orders the components of AND and OR search filters by their estimated '
+                                                                      'number of matching entries, read from the indexes (on/off)')
+    set_db_config_parser.add_argument('--export-threads', help='Sets the number of threads formatting the entries during an export '
+                                                               '(0 means automatic, 1 disables the parallel export)')
     set_db_config_parser.add_argument('--deadlock-policy', help='Adjusts the backend database deadlock policy (Advanced setting)')
     set_db_config_parser.add_argument('--db-home-directory', help='Sets the directory for the database mmapped files (Advanced setting)')
     set_db_config_parser.add_argument('--db-lib', help='Sets which db lib is used. Valid values are: bdb or mdb')
     set_db_config_parser.add_argument('--mdb-max-size', help='Sets the lmdb database maximum size (in bytes).')
     set_db_config_parser.add_argument('--mdb-max-readers', help='Sets the lmdb database maximum number of readers (Advanced setting)')
     set_db_config_parser.add_argument('--mdb-max-dbs', help='Sets the lmdb database maximum number of sub databases (Advanced setting)')
+    set_db_config_parser.add_argument('--mdb-online-reindex', help='Rebuilds the indexes of the reindex tasks while the backend stays '
+                                                                   'writable (on/off)')
+    set_db_config_parser.add_argument('--mdb-online-reindex-rate', help='Sets the maximum number of entries per second read by an online '
+                                                                        'reindex (0 means no limit)')
 
 
     #######################################################
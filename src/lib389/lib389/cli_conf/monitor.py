@@ -10,7 +10,7 @@
 import datetime
 import json
 import os
-from lib389.monitor import (Monitor, MonitorLDBM, MonitorSNMP, MonitorDiskSpace)
+from lib389.monitor import (Monitor, MonitorLDBM, MonitorSNMP, MonitorLatency, MonitorDiskSpace)
 from lib389.chaining import (ChainingLinks)
 from lib389.backend import Backends
 from lib389.utils import convert_bytes
@@ -44,6 +44,11 @@ def snmp_monitor(inst, basedn, log, args):
     _format_status(log, snmp_monitor, args.json)
 
 
+def latency_monitor(inst, basedn, log, args):
+    latency_monitor = MonitorLatency(inst)
+    _format_status(log, latency_monitor, args.json)
+
+
 def chaining_monitor(inst, basedn, log, args):
     links = ChainingLinks(inst)
     if args.backend:
@@ -318,6 +323,9 @@ def create_parser(subparsers):
     snmp_parser = subcommands.add_parser('snmp', help="Displays the SNMP statistics", formatter_class=CustomHelpFormatter)
     snmp_parser.set_defaults(func=snmp_monitor)
 
+    latency_parser = subcommands.add_parser('latency', help="Displays the operation latency percentiles, in microseconds", formatter_class=CustomHelpFormatter)
+    latency_parser.set_defaults(func=latency_monitor)
+
     chaining_parser = subcommands.add_parser('chaining', help="Monitor database chaining statistics", formatter_class=CustomHelpFormatter)
     chaining_parser.add_argument('backend', nargs='?', help="The optional name of the chaining backend to monitor")
     chaining_parser.set_defaults(func=chaining_monitor)
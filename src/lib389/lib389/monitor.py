@@ -411,6 +411,50 @@ class MonitorSNMP(DSLdapObject):
         return self.get_attrs_vals_utf8(self._snmp_keys)
 
 
+class MonitorLatency(DSLdapObject):
+    """A class for representing "cn=latency,cn=monitor" entry
+
+    Values are the count and the percentiles, in microseconds, of the wait
+    time (wtime) and operation time (optime) of each operation type.
+    """
+
+    OP_TYPES = ['bind', 'search-base', 'search-onelevel', 'search-subtree',
+                'add', 'modify', 'delete', 'modrdn', 'compare', 'extended']
+
+    def __init__(self, instance, dn=None):
+        super(MonitorLatency, self).__init__(instance=instance, dn=dn)
+        self._dn = DN_MONITOR_LATENCY
+        self._latency_keys = [f'{op}-{kind}' for op in self.OP_TYPES for kind in ('wtime', 'optime')]
+        self._latency_keys.append('backend-latency')
+
+    @staticmethod
+    def _parse(value):
+        return {k: int(v) for k, v in (item.split('=') for item in value.split())}
+
+    def get_latency(self, backend=None):
+        """Get the latency statistics
+
+        :param backend: the name of a backend, or None for the whole server
+        :type backend: str
+        :returns: a dict like {'search-subtree-optime': {'count': 12, 'p50': 95, ...}}
+        """
+        result = {}
+        if backend is None:
+            for key in self._latency_keys[:-1]:
+                value = self.get_attr_val_utf8(key)
+                if value:
+                    result[key] = self._parse(value)
+        else:
+            for value in self.get_attr_vals_utf8('backend-latency'):
+                be_name, key, stats = value.split(' ', 2)
+                if be_name.lower() == backend.lower():
+                    result[key] = self._parse(stats)
+        return result
+
+    def get_status(self, use_json=False):
+        return self.get_attrs_vals_utf8(self._latency_keys)
+
+
 class MonitorDiskSpace(DSLdapObject):
     """A class for representing "cn=disk space,cn=monitor" entry"""
 
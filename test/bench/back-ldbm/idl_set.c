@@ -0,0 +1,97 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../bench_slapd.h"
+
+#include <back-ldbm.h>
+#include <string.h>
+
+/*
+ * idl_set_intersect of the candidate lists of an AND filter, such as
+ * (&(objectClass=person)(ou=Sales)(l=Paris)(manager=...)): a list holding
+ * almost every ID of the backend down to a small one.
+ *
+ * The intersection consumes its IDLs, so each iteration works on copies,
+ * like the index lookups hand fresh IDLs to the filter code.
+ */
+
+#define BENCH_IDL_MAX_ID 16384
+#define BENCH_IDL_NB_LISTS 4
+
+/* Per mille of the IDs present in each list */
+static const uint64_t bench_idl_density[BENCH_IDL_NB_LISTS] = {900, 300, 50, 4};
+
+typedef struct bench_idl_ctx
+{
+    IDList *idl[BENCH_IDL_NB_LISTS];
+} bench_idl_ctx;
+
+static IDList *
+bench_idl_dup(IDList *idl)
+{
+    IDList *new = idl_alloc(idl->b_nmax);
+
+    new->b_nids = idl->b_nids;
+    memcpy(new->b_ids, idl->b_ids, idl->b_nids * sizeof(ID));
+    return new;
+}
+
+static void *
+bench_idl_set_intersect_setup(void)
+{
+    bench_idl_ctx *ctx = (bench_idl_ctx *)slapi_ch_calloc(1, sizeof(bench_idl_ctx));
+
+    for (size_t i = 0; i < BENCH_IDL_NB_LISTS; i++) {
+        ctx->idl[i] = idl_alloc(BENCH_IDL_MAX_ID);
+        for (ID id = 1; id <= BENCH_IDL_MAX_ID; id++) {
+            if (bench_rand_range(1000) < bench_idl_density[i]) {
+                idl_append(ctx->idl[i], id);
+            }
+        }
+    }
+    return ctx;
+}
+
+static void
+bench_idl_set_intersect_run(void *arg, uint64_t iterations)
+{
+    bench_idl_ctx *ctx = (bench_idl_ctx *)arg;
+    uint64_t found = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        IDListSet *idl_set = idl_set_create();
+        IDList *result;
+
+        for (size_t j = 0; j < BENCH_IDL_NB_LISTS; j++) {
+            idl_set_insert_idl(idl_set, bench_idl_dup(ctx->idl[j]));
+        }
+        /* The backend is only needed to build an allids result */
+        result = idl_set_intersect(idl_set, NULL);
+        found += result->b_nids;
+        idl_free(&result);
+        idl_set_destroy(idl_set);
+    }
+    bench_sink += found;
+}
+
+static void
+bench_idl_set_intersect_teardown(void *arg)
+{
+    bench_idl_ctx *ctx = (bench_idl_ctx *)arg;
+
+    for (size_t i = 0; i < BENCH_IDL_NB_LISTS; i++) {
+        idl_free(&ctx->idl[i]);
+    }
+    slapi_ch_free((void **)&ctx);
+}
+
+const bench_case bench_back_ldbm_idl_set_intersect = {
+    "back-ldbm/idl_set_intersect",
+    bench_idl_set_intersect_setup,
+    bench_idl_set_intersect_run,
+    bench_idl_set_intersect_teardown};
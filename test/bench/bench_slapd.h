@@ -0,0 +1,56 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#pragma once
+
+#include <config.h>
+#include <slapi-plugin.h>
+#include <stdint.h>
+
+/*
+ * A benchmark is a setup function building its data set, a run function
+ * executing the measured code "iterations" times over that data set, and
+ * a teardown function. Only run() is timed. The data sets are generated
+ * with a fixed seed, so two runs of the same binary measure the same work.
+ */
+typedef struct bench_case
+{
+    const char *name;
+    void *(*setup)(void);
+    void (*run)(void *ctx, uint64_t iterations);
+    void (*teardown)(void *ctx);
+} bench_case;
+
+/* Results are accumulated here so the compiler can not drop the work */
+extern volatile uint64_t bench_sink;
+
+/* Deterministic data generator (data.c) */
+void bench_seed(uint64_t seed);
+uint64_t bench_rand(void);
+uint64_t bench_rand_range(uint64_t max);
+char *bench_gen_word(char *buf, size_t len);
+char *bench_gen_dn(uint64_t id);
+char *bench_gen_ldif(uint64_t id);
+
+/* == The benchmarks == */
+
+/* libslapd-filter */
+extern const bench_case bench_libslapd_filter_test_and;
+extern const bench_case bench_libslapd_filter_test_or;
+
+/* libslapd-entry */
+extern const bench_case bench_libslapd_str2entry;
+
+/* libslapd-dn */
+extern const bench_case bench_libslapd_dn_normalize;
+
+/* libslapd-encode */
+extern const bench_case bench_libslapd_encode_attr;
+
+/* back-ldbm-idl_set */
+extern const bench_case bench_back_ldbm_idl_set_intersect;
@@ -0,0 +1,140 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "bench_slapd.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * xorshift64* generator: we don't want random(), because the libc may
+ * change its sequence, and the data sets must be the same from one run
+ * (and one machine) to the other for the results to be comparable.
+ */
+static uint64_t bench_state = 0x9e3779b97f4a7c15ULL;
+
+void
+bench_seed(uint64_t seed)
+{
+    bench_state = seed ? seed : 0x9e3779b97f4a7c15ULL;
+}
+
+uint64_t
+bench_rand(void)
+{
+    bench_state ^= bench_state >> 12;
+    bench_state ^= bench_state << 25;
+    bench_state ^= bench_state >> 27;
+    return bench_state * 0x2545f4914f6cdd1dULL;
+}
+
+uint64_t
+bench_rand_range(uint64_t max)
+{
+    return max ? bench_rand() % max : 0;
+}
+
+static const char *bench_given_names[] = {
+    "Alice", "Bob", "Carol", "David", "Eve", "Frank", "Grace", "Heidi",
+    "Ivan", "Judy", "Mallory", "Niaj", "Olivia", "Peggy", "Rupert", "Sybil",
+    "Trent", "Victor", "Walter", "Yolanda"};
+#define BENCH_NB_GIVEN_NAMES (sizeof(bench_given_names) / sizeof(bench_given_names[0]))
+
+static const char *bench_ous[] = {
+    "People", "Engineering", "Sales", "Support", "Marketing", "Human Resources",
+    "Finance", "Legal"};
+#define BENCH_NB_OUS (sizeof(bench_ous) / sizeof(bench_ous[0]))
+
+/*
+ * Fill buf with a lower case word of 3 to len - 1 characters.
+ */
+char *
+bench_gen_word(char *buf, size_t len)
+{
+    size_t n = 3 + bench_rand_range(len - 3);
+
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = 'a' + bench_rand_range(26);
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+/*
+ * A user DN as the clients send them: mixed case attribute types, some
+ * spaces around the separators, and an escaped comma now and then, so
+ * that the normalization has some work to do.
+ */
+char *
+bench_gen_dn(uint64_t id)
+{
+    const char *ou = bench_ous[bench_rand_range(BENCH_NB_OUS)];
+    const char *given = bench_given_names[bench_rand_range(BENCH_NB_GIVEN_NAMES)];
+    char sn[16];
+
+    bench_gen_word(sn, sizeof(sn));
+    switch (bench_rand_range(4)) {
+    case 0:
+        return slapi_ch_smprintf("uid=user%" PRIu64 ",ou=%s,dc=example,dc=com", id, ou);
+    case 1:
+        return slapi_ch_smprintf("UID=User%" PRIu64 ", OU=%s, DC=Example, DC=COM", id, ou);
+    case 2:
+        return slapi_ch_smprintf("cn=%s %s\\, %" PRIu64 " , ou=%s ,dc=example,dc=com", given, sn, id, ou);
+    default:
+        return slapi_ch_smprintf("cn=%s %s+uid=user%" PRIu64 ",ou=%s,o=Example Corp,c=US", given, sn, id, ou);
+    }
+}
+
+/*
+ * An inetOrgPerson entry, in the LDIF form id2entry stores them.
+ */
+char *
+bench_gen_ldif(uint64_t id)
+{
+    const char *ou = bench_ous[bench_rand_range(BENCH_NB_OUS)];
+    const char *given = bench_given_names[bench_rand_range(BENCH_NB_GIVEN_NAMES)];
+    char sn[16];
+    char desc[64];
+    uint64_t phone, gid, uniqueid[4];
+
+    /* Draw everything first: the argument evaluation order is unspecified */
+    bench_gen_word(sn, sizeof(sn));
+    bench_gen_word(desc, sizeof(desc));
+    phone = bench_rand_range(10000);
+    gid = 1000 + bench_rand_range(10);
+    for (size_t i = 0; i < 4; i++) {
+        uniqueid[i] = bench_rand() & 0xffffffff;
+    }
+    return slapi_ch_smprintf("dn: uid=user%" PRIu64 ",ou=%s,dc=example,dc=com\n"
+                             "objectClass: top\n"
+                             "objectClass: person\n"
+                             "objectClass: organizationalPerson\n"
+                             "objectClass: inetOrgPerson\n"
+                             "objectClass: posixAccount\n"
+                             "uid: user%" PRIu64 "\n"
+                             "cn: %s %s\n"
+                             "sn: %s\n"
+                             "givenName: %s\n"
+                             "mail: user%" PRIu64 "@example.com\n"
+                             "telephoneNumber: +1 555 %04" PRIu64 "\n"
+                             "uidNumber: %" PRIu64 "\n"
+                             "gidNumber: %" PRIu64 "\n"
+                             "homeDirectory: /home/user%" PRIu64 "\n"
+                             "loginShell: /bin/bash\n"
+                             "description: %s\n"
+                             "ou: %s\n"
+                             "creatorsName: cn=directory manager\n"
+                             "modifiersName: cn=directory manager\n"
+                             "createTimestamp: 20260101000000Z\n"
+                             "modifyTimestamp: 20260101000000Z\n"
+                             "nsUniqueId: %08" PRIx64 "-%08" PRIx64 "-%08" PRIx64 "-%08" PRIx64 "\n",
+                             id, ou, id, given, sn, sn, given, id,
+                             phone, 1000 + id, gid, id, desc, ou,
+                             uniqueid[0], uniqueid[1], uniqueid[2], uniqueid[3]);
+}
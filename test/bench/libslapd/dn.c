@@ -0,0 +1,74 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../bench_slapd.h"
+
+#include <slap.h>
+#include <string.h>
+
+/*
+ * slapi_dn_normalize_ext on user DNs, a quarter of them already
+ * normalized (the source is returned as is), the others needing a copy.
+ */
+
+#define BENCH_DN_NB_DNS 1024
+
+typedef struct bench_dn_ctx
+{
+    char *dn[BENCH_DN_NB_DNS];
+    size_t len[BENCH_DN_NB_DNS];
+} bench_dn_ctx;
+
+static void *
+bench_dn_normalize_setup(void)
+{
+    bench_dn_ctx *ctx = (bench_dn_ctx *)slapi_ch_calloc(1, sizeof(bench_dn_ctx));
+
+    for (size_t i = 0; i < BENCH_DN_NB_DNS; i++) {
+        ctx->dn[i] = bench_gen_dn(i);
+        ctx->len[i] = strlen(ctx->dn[i]);
+    }
+    return ctx;
+}
+
+static void
+bench_dn_normalize_run(void *arg, uint64_t iterations)
+{
+    bench_dn_ctx *ctx = (bench_dn_ctx *)arg;
+    uint64_t total_len = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t n = i % BENCH_DN_NB_DNS;
+        char *dest = NULL;
+        size_t dest_len = 0;
+        int rc = slapi_dn_normalize_ext(ctx->dn[n], ctx->len[n], &dest, &dest_len);
+
+        total_len += dest_len;
+        if (rc > 0) {
+            slapi_ch_free_string(&dest);
+        }
+    }
+    bench_sink += total_len;
+}
+
+static void
+bench_dn_normalize_teardown(void *arg)
+{
+    bench_dn_ctx *ctx = (bench_dn_ctx *)arg;
+
+    for (size_t i = 0; i < BENCH_DN_NB_DNS; i++) {
+        slapi_ch_free_string(&ctx->dn[i]);
+    }
+    slapi_ch_free((void **)&ctx);
+}
+
+const bench_case bench_libslapd_dn_normalize = {
+    "libslapd/dn_normalize_ext",
+    bench_dn_normalize_setup,
+    bench_dn_normalize_run,
+    bench_dn_normalize_teardown};
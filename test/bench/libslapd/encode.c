@@ -0,0 +1,90 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../bench_slapd.h"
+
+#include <slap.h>
+
+/*
+ * BER encoding of the attributes of a search result entry, through
+ * encode_attr (the encode_attr_2 wrapper used by send_ldap_search_entry).
+ * The operation is internal, so the access check is skipped as it would
+ * be with no ACI plugin to consult.
+ */
+
+#define BENCH_ENCODE_NB_ENTRIES 64
+
+typedef struct bench_encode_ctx
+{
+    Slapi_Entry *entries[BENCH_ENCODE_NB_ENTRIES];
+    Slapi_Operation *op;
+    Slapi_PBlock *pb;
+} bench_encode_ctx;
+
+static void *
+bench_encode_attr_setup(void)
+{
+    bench_encode_ctx *ctx = (bench_encode_ctx *)slapi_ch_calloc(1, sizeof(bench_encode_ctx));
+
+    for (size_t i = 0; i < BENCH_ENCODE_NB_ENTRIES; i++) {
+        char *ldif = bench_gen_ldif(i);
+        ctx->entries[i] = slapi_str2entry(ldif, 0);
+        slapi_ch_free_string(&ldif);
+    }
+    ctx->op = slapi_operation_new(SLAPI_OP_FLAG_INTERNAL);
+    ctx->pb = slapi_pblock_new();
+    slapi_pblock_set(ctx->pb, SLAPI_OPERATION, ctx->op);
+    return ctx;
+}
+
+/* One iteration encodes all the attributes of one entry */
+static void
+bench_encode_attr_run(void *arg, uint64_t iterations)
+{
+    bench_encode_ctx *ctx = (bench_encode_ctx *)arg;
+    uint64_t encoded = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        Slapi_Entry *e = ctx->entries[i % BENCH_ENCODE_NB_ENTRIES];
+        BerElement *ber = ber_alloc();
+        Slapi_Attr *a = NULL;
+
+        for (int rc = slapi_entry_first_attr(e, &a); rc == 0; rc = slapi_entry_next_attr(e, a, &a)) {
+            if (encode_attr(ctx->pb, ber, e, a, 0, NULL) != 0) {
+                /* encode_attr has freed the ber */
+                ber = NULL;
+                break;
+            }
+            encoded++;
+        }
+        if (ber) {
+            ber_free(ber, 1);
+        }
+    }
+    bench_sink += encoded;
+}
+
+static void
+bench_encode_attr_teardown(void *arg)
+{
+    bench_encode_ctx *ctx = (bench_encode_ctx *)arg;
+
+    for (size_t i = 0; i < BENCH_ENCODE_NB_ENTRIES; i++) {
+        slapi_entry_free(ctx->entries[i]);
+    }
+    slapi_pblock_set(ctx->pb, SLAPI_OPERATION, NULL);
+    slapi_pblock_destroy(ctx->pb);
+    operation_free(&ctx->op, NULL);
+    slapi_ch_free((void **)&ctx);
+}
+
+const bench_case bench_libslapd_encode_attr = {
+    "libslapd/encode_attr",
+    bench_encode_attr_setup,
+    bench_encode_attr_run,
+    bench_encode_attr_teardown};
@@ -0,0 +1,81 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../bench_slapd.h"
+
+#include <slap.h>
+#include <string.h>
+
+/*
+ * slapi_str2entry on the entries as id2entry stores them. With no flag,
+ * it goes straight to str2entry_fast, which parses the LDIF in place:
+ * each iteration works on a fresh copy, as id2entry does with the
+ * buffer it got from the database.
+ */
+
+#define BENCH_ENTRY_NB_ENTRIES 256
+
+typedef struct bench_entry_ctx
+{
+    char *ldif[BENCH_ENTRY_NB_ENTRIES];
+    size_t len[BENCH_ENTRY_NB_ENTRIES];
+    char *buf;
+} bench_entry_ctx;
+
+static void *
+bench_str2entry_setup(void)
+{
+    bench_entry_ctx *ctx = (bench_entry_ctx *)slapi_ch_calloc(1, sizeof(bench_entry_ctx));
+    size_t maxlen = 0;
+
+    for (size_t i = 0; i < BENCH_ENTRY_NB_ENTRIES; i++) {
+        ctx->ldif[i] = bench_gen_ldif(i);
+        ctx->len[i] = strlen(ctx->ldif[i]) + 1;
+        if (ctx->len[i] > maxlen) {
+            maxlen = ctx->len[i];
+        }
+    }
+    ctx->buf = slapi_ch_malloc(maxlen);
+    return ctx;
+}
+
+static void
+bench_str2entry_run(void *arg, uint64_t iterations)
+{
+    bench_entry_ctx *ctx = (bench_entry_ctx *)arg;
+    uint64_t parsed = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t n = i % BENCH_ENTRY_NB_ENTRIES;
+        Slapi_Entry *e;
+
+        memcpy(ctx->buf, ctx->ldif[n], ctx->len[n]);
+        e = slapi_str2entry(ctx->buf, 0);
+        parsed += (e != NULL);
+        slapi_entry_free(e);
+    }
+    bench_sink += parsed;
+}
+
+static void
+bench_str2entry_teardown(void *arg)
+{
+    bench_entry_ctx *ctx = (bench_entry_ctx *)arg;
+
+    for (size_t i = 0; i < BENCH_ENTRY_NB_ENTRIES; i++) {
+        slapi_ch_free_string(&ctx->ldif[i]);
+    }
+    slapi_ch_free_string(&ctx->buf);
+    slapi_ch_free((void **)&ctx);
+}
+
+const bench_case bench_libslapd_str2entry = {
+    "libslapd/str2entry",
+    bench_str2entry_setup,
+    bench_str2entry_run,
+    bench_str2entry_teardown};
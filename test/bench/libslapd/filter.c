@@ -0,0 +1,98 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../bench_slapd.h"
+
+#include <slap.h>
+
+/*
+ * slapi_filter_test over a set of inetOrgPerson entries.
+ *
+ * No syntax plugin is loaded in the benchmark, so the value assertions
+ * would all fail the same way: we use presence components, which still
+ * go through the filter walk, the attribute lookups and the access check
+ * entry points of a real search.
+ */
+
+#define BENCH_FILTER_NB_ENTRIES 256
+
+typedef struct bench_filter_ctx
+{
+    Slapi_Entry *entries[BENCH_FILTER_NB_ENTRIES];
+    Slapi_Filter *filter;
+    Slapi_PBlock *pb;
+} bench_filter_ctx;
+
+static void *
+bench_filter_setup(const char *fstr)
+{
+    bench_filter_ctx *ctx = (bench_filter_ctx *)slapi_ch_calloc(1, sizeof(bench_filter_ctx));
+    char *fdup = slapi_ch_strdup(fstr);
+
+    for (size_t i = 0; i < BENCH_FILTER_NB_ENTRIES; i++) {
+        char *ldif = bench_gen_ldif(i);
+        ctx->entries[i] = slapi_str2entry(ldif, 0);
+        slapi_ch_free_string(&ldif);
+    }
+    ctx->filter = slapi_str2filter(fdup);
+    ctx->pb = slapi_pblock_new();
+    slapi_ch_free_string(&fdup);
+    return ctx;
+}
+
+/* Mostly matching: every component is evaluated */
+static void *
+bench_filter_and_setup(void)
+{
+    return bench_filter_setup("(&(objectClass=*)(uid=*)(mail=*)(!(nsAccountLock=*))(telephoneNumber=*))");
+}
+
+/* Mostly failing: every attribute of the entry is scanned, then the last component matches */
+static void *
+bench_filter_or_setup(void)
+{
+    return bench_filter_setup("(|(memberOf=*)(nsRoleDN=*)(userPassword=*)(seeAlso=*)(mail=*))");
+}
+
+static void
+bench_filter_run(void *arg, uint64_t iterations)
+{
+    bench_filter_ctx *ctx = (bench_filter_ctx *)arg;
+    uint64_t matched = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        Slapi_Entry *e = ctx->entries[i % BENCH_FILTER_NB_ENTRIES];
+        matched += (slapi_filter_test(ctx->pb, e, ctx->filter, 0) == 0);
+    }
+    bench_sink += matched;
+}
+
+static void
+bench_filter_teardown(void *arg)
+{
+    bench_filter_ctx *ctx = (bench_filter_ctx *)arg;
+
+    for (size_t i = 0; i < BENCH_FILTER_NB_ENTRIES; i++) {
+        slapi_entry_free(ctx->entries[i]);
+    }
+    slapi_filter_free(ctx->filter, 1);
+    slapi_pblock_destroy(ctx->pb);
+    slapi_ch_free((void **)&ctx);
+}
+
+const bench_case bench_libslapd_filter_test_and = {
+    "libslapd/filter_test_and",
+    bench_filter_and_setup,
+    bench_filter_run,
+    bench_filter_teardown};
+
+const bench_case bench_libslapd_filter_test_or = {
+    "libslapd/filter_test_or",
+    bench_filter_or_setup,
+    bench_filter_run,
+    bench_filter_teardown};
@@ -0,0 +1,293 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+/*
+ * Micro benchmarks of the server hot paths.
+ *
+ *   make bench BENCH_ARGS="-f tsv" > baseline.tsv
+ *   ... change the code ...
+ *   make bench BENCH_ARGS="-b baseline.tsv"
+ *
+ * Each benchmark is calibrated so that one round lasts about -T
+ * milliseconds, run once to warm the caches, then run -r times. The
+ * median time per operation of the rounds is reported, with the min and
+ * max to show the noise. With -b, the results are compared to a file
+ * previously written with -f tsv, and the exit code is 1 if a benchmark
+ * is more than -t percent slower than its baseline.
+ */
+
+#include "bench_slapd.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_FORMAT_VERSION 1
+#define BENCH_MAX_ROUNDS 101
+#define BENCH_NAME_LEN 128
+
+volatile uint64_t bench_sink = 0;
+
+static const bench_case *bench_cases[] = {
+    &bench_libslapd_filter_test_and,
+    &bench_libslapd_filter_test_or,
+    &bench_libslapd_str2entry,
+    &bench_libslapd_dn_normalize,
+    &bench_libslapd_encode_attr,
+    &bench_back_ldbm_idl_set_intersect,
+    NULL};
+
+typedef struct bench_result
+{
+    char name[BENCH_NAME_LEN];
+    double median;
+    double min;
+    double max;
+    uint64_t iterations;
+    int rounds;
+} bench_result;
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t
+bench_time_run(const bench_case *bc, void *ctx, uint64_t iterations)
+{
+    uint64_t start = bench_now_ns();
+
+    bc->run(ctx, iterations);
+    return bench_now_ns() - start;
+}
+
+static int
+bench_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void
+bench_run_case(const bench_case *bc, int rounds, uint64_t round_ns, bench_result *res)
+{
+    double ns_per_op[BENCH_MAX_ROUNDS];
+    uint64_t iterations = 1;
+    void *ctx;
+
+    /* Same data set whatever benchmarks were selected before this one */
+    bench_seed(0);
+    ctx = bc->setup ? bc->setup() : NULL;
+
+    /* Calibrate: grow the iteration count until a run lasts a round */
+    while (bench_time_run(bc, ctx, iterations) < round_ns && iterations < (1ULL << 32)) {
+        iterations *= 2;
+    }
+    /* Warm up */
+    bench_time_run(bc, ctx, iterations);
+
+    for (int i = 0; i < rounds; i++) {
+        ns_per_op[i] = (double)bench_time_run(bc, ctx, iterations) / iterations;
+    }
+    if (bc->teardown) {
+        bc->teardown(ctx);
+    }
+
+    qsort(ns_per_op, rounds, sizeof(double), bench_cmp_double);
+    snprintf(res->name, sizeof(res->name), "%s", bc->name);
+    res->median = ns_per_op[rounds / 2];
+    res->min = ns_per_op[0];
+    res->max = ns_per_op[rounds - 1];
+    res->iterations = iterations;
+    res->rounds = rounds;
+}
+
+/*
+ * Read a file written with -f tsv. Returns the number of results, or -1
+ * if the file can't be read.
+ */
+static int
+bench_load_baseline(const char *path, bench_result **results)
+{
+    FILE *fp = fopen(path, "r");
+    char line[512];
+    int nb = 0;
+
+    *results = NULL;
+    if (fp == NULL) {
+        fprintf(stderr, "bench_slapd: can't open baseline %s\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        bench_result r = {0};
+
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%127s %lf %lf %lf %" SCNu64 " %d", r.name, &r.median,
+                   &r.min, &r.max, &r.iterations, &r.rounds) != 6) {
+            fprintf(stderr, "bench_slapd: ignoring malformed baseline line: %s", line);
+            continue;
+        }
+        *results = (bench_result *)slapi_ch_realloc((char *)*results, (nb + 1) * sizeof(bench_result));
+        (*results)[nb++] = r;
+    }
+    fclose(fp);
+    return nb;
+}
+
+static const bench_result *
+bench_find_result(const bench_result *results, int nb, const char *name)
+{
+    for (int i = 0; i < nb; i++) {
+        if (strcmp(results[i].name, name) == 0) {
+            return &results[i];
+        }
+    }
+    return NULL;
+}
+
+static int
+bench_selected(const char *name, int argc, char **argv)
+{
+    if (argc == 0) {
+        return 1;
+    }
+    for (int i = 0; i < argc; i++) {
+        if (strncmp(name, argv[i], strlen(argv[i])) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void
+bench_usage(void)
+{
+    fprintf(stderr,
+            "usage: bench_slapd [-l] [-f text|tsv] [-r rounds] [-T msec] [-b baseline [-t percent]] [name-prefix...]\n"
+            "  -l            list the benchmarks\n"
+            "  -f format     output format, text (default) or tsv (machine readable)\n"
+            "  -r rounds     measured rounds per benchmark (default 7)\n"
+            "  -T msec       target duration of one round (default 200)\n"
+            "  -b baseline   compare to a file written with -f tsv\n"
+            "  -t percent    regression threshold for -b (default 10)\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_result *baseline = NULL;
+    char *baseline_path = NULL;
+    int nb_baseline = 0;
+    int tsv = 0;
+    int rounds = 7;
+    long round_ms = 200;
+    double threshold = 10.0;
+    int regressions = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "lf:r:T:b:t:h")) != -1) {
+        switch (c) {
+        case 'l':
+            for (int i = 0; bench_cases[i]; i++) {
+                printf("%s\n", bench_cases[i]->name);
+            }
+            return 0;
+        case 'f':
+            if (strcmp(optarg, "tsv") == 0) {
+                tsv = 1;
+            } else if (strcmp(optarg, "text") != 0) {
+                bench_usage();
+                return 2;
+            }
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 'T':
+            round_ms = atol(optarg);
+            break;
+        case 'b':
+            baseline_path = optarg;
+            break;
+        case 't':
+            threshold = atof(optarg);
+            break;
+        default:
+            bench_usage();
+            return 2;
+        }
+    }
+    if (rounds < 1 || rounds > BENCH_MAX_ROUNDS || round_ms < 1 || threshold < 0) {
+        bench_usage();
+        return 2;
+    }
+    if (baseline_path && (nb_baseline = bench_load_baseline(baseline_path, &baseline)) < 0) {
+        return 2;
+    }
+
+    if (tsv) {
+        printf("# bench_slapd %d\n", BENCH_FORMAT_VERSION);
+        printf("# name\tns_per_op\tmin\tmax\titerations\trounds\n");
+    } else {
+        printf("%-32s %12s %12s %12s %12s", "benchmark", "ns/op", "min", "max", "iterations");
+        if (baseline) {
+            printf(" %12s %8s", "baseline", "delta");
+        }
+        printf("\n");
+    }
+
+    for (int i = 0; bench_cases[i]; i++) {
+        const bench_result *ref;
+        bench_result res;
+        double delta = 0.0;
+
+        if (!bench_selected(bench_cases[i]->name, argc - optind, argv + optind)) {
+            continue;
+        }
+        bench_run_case(bench_cases[i], rounds, round_ms * 1000000ULL, &res);
+        ref = bench_find_result(baseline, nb_baseline, res.name);
+        if (ref && ref->median > 0) {
+            delta = (res.median - ref->median) * 100.0 / ref->median;
+            if (delta > threshold) {
+                regressions++;
+            }
+        }
+
+        if (tsv) {
+            printf("%s\t%.2f\t%.2f\t%.2f\t%" PRIu64 "\t%d\n", res.name, res.median,
+                   res.min, res.max, res.iterations, res.rounds);
+        } else {
+            printf("%-32s %12.2f %12.2f %12.2f %12" PRIu64, res.name, res.median,
+                   res.min, res.max, res.iterations);
+            if (ref) {
+                printf(" %12.2f %+7.1f%%%s", ref->median, delta, delta > threshold ? " REGRESSION" : "");
+            }
+            printf("\n");
+        }
+        fflush(stdout);
+    }
+
+    if (baseline) {
+        fprintf(stderr, "bench_slapd: %d benchmark(s) more than %.1f%% slower than %s\n",
+                regressions, threshold, baseline_path);
+        slapi_ch_free((void **)&baseline);
+    }
+    PR_Cleanup();
+    return regressions ? 1 : 0;
+}
@@ -7,6 +7,7 @@
  * END COPYRIGHT BLOCK **/
 
 #include "../../test_slapd.h"
+#include <pthread.h>
 
 void
 test_libslapd_counters_atomic_usage(void **state __attribute__((unused)))
@@ -67,3 +68,46 @@ test_libslapd_counters_atomic_overflow(void **state __attribute__((unused)))
 
     slapi_counter_destroy(&tc);
 }
+
+#define SHARDED_THREADS 8
+#define SHARDED_LOOPS 100000
+
+static void *
+sharded_worker(void *arg)
+{
+    Slapi_Counter *tc = arg;
+    for (size_t i = 0; i < SHARDED_LOOPS; i++) {
+        slapi_counter_increment(tc);
+    }
+    slapi_counter_subtract(tc, 10);
+    return NULL;
+}
+
+void
+test_libslapd_counters_atomic_sharded(void **state __attribute__((unused)))
+{
+    Slapi_Counter *tc = slapi_counter_new_sharded();
+    pthread_t threads[SHARDED_THREADS];
+    uint64_t value = 0;
+
+    assert_true(slapi_counter_get_value(tc) == 0);
+    slapi_counter_set_value(tc, 5);
+
+    for (size_t i = 0; i < SHARDED_THREADS; i++) {
+        assert_int_equal(pthread_create(&threads[i], NULL, sharded_worker, tc), 0);
+    }
+    for (size_t i = 0; i < SHARDED_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    /* Updates done on any CPU are folded by get_value */
+    value = slapi_counter_get_value(tc);
+    assert_true(value == 5 + (uint64_t)SHARDED_THREADS * (SHARDED_LOOPS - 10));
+
+    /* set discards what the shards hold */
+    slapi_counter_set_value(tc, 42);
+    assert_true(slapi_counter_get_value(tc) == 42);
+    slapi_counter_init(tc);
+    assert_true(slapi_counter_get_value(tc) == 0);
+
+    slapi_counter_destroy(&tc);
+}
@@ -49,6 +49,7 @@ void test_libslapd_operation_v3c_target_spec(void **state);
 
 void test_libslapd_counters_atomic_usage(void **state);
 void test_libslapd_counters_atomic_overflow(void **state);
+void test_libslapd_counters_atomic_sharded(void **state);
 
 /* libslapd-pal-meminfo */
 